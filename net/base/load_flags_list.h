@@ -84,3 +84,7 @@ LOAD_FLAG(SUPPORT_ASYNC_REVALIDATION, 1 << 17)
 // Indicates that this request is not to be migrated to a new network when QUIC
 // connection migration is enabled.
 LOAD_FLAG(DISABLE_CONNECTION_MIGRATION, 1 << 18)
+
+// This load is only satisfied by a stream the server pushed: it fails rather
+// than sending the request when there is no push to claim.
+LOAD_FLAG(ONLY_FROM_PUSH, 1 << 19)
@@ -4,6 +4,7 @@
 
 #include <stdint.h>
 
+#include "base/bind.h"
 #include "base/files/file.h"
 #include "base/files/file_util.h"
 #include "base/metrics/field_trial.h"
@@ -13,8 +14,10 @@
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
 #include "base/test/mock_entropy_provider.h"
+#include "base/test/scoped_feature_list.h"
 #include "base/third_party/dynamic_annotations/dynamic_annotations.h"
 #include "base/threading/platform_thread.h"
+#include "base/threading/thread.h"
 #include "base/threading/thread_restrictions.h"
 #include "base/threading/thread_task_runner_handle.h"
 #include "net/base/cache_type.h"
@@ -31,6 +34,7 @@
 #include "net/disk_cache/disk_cache_test_util.h"
 #include "net/disk_cache/memory/mem_backend_impl.h"
 #include "net/disk_cache/simple/simple_backend_impl.h"
+#include "net/disk_cache/simple/simple_cache_warmer.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
 #include "net/disk_cache/simple/simple_index.h"
 #include "net/disk_cache/simple/simple_synchronous_entry.h"
@@ -372,6 +376,29 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyBasics) {
   BackendBasics();
 }
 
+TEST_F(DiskCacheBackendTest, MemoryOnlyShardedBasics) {
+  SetMemoryOnlyMode();
+  SetMemoryShardCount(8);
+  BackendBasics();
+}
+
+TEST_F(DiskCacheBackendTest, LogCacheBasics) {
+  SetLogCacheMode();
+  BackendBasics();
+}
+
+TEST_F(DiskCacheBackendTest, CompressedCacheBasics) {
+  SetSimpleCacheMode();
+  SetCompressedCacheMode();
+  BackendBasics();
+}
+
+TEST_F(DiskCacheBackendTest, DedupCacheBasics) {
+  SetSimpleCacheMode();
+  SetDedupCacheMode();
+  BackendBasics();
+}
+
 TEST_F(DiskCacheBackendTest, AppCacheBasics) {
   SetCacheType(net::APP_CACHE);
   BackendBasics();
@@ -437,6 +464,23 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyKeying) {
   BackendKeying();
 }
 
+TEST_F(DiskCacheBackendTest, LogCacheKeying) {
+  SetLogCacheMode();
+  BackendKeying();
+}
+
+TEST_F(DiskCacheBackendTest, CompressedCacheKeying) {
+  SetSimpleCacheMode();
+  SetCompressedCacheMode();
+  BackendKeying();
+}
+
+TEST_F(DiskCacheBackendTest, DedupCacheKeying) {
+  SetSimpleCacheMode();
+  SetDedupCacheMode();
+  BackendKeying();
+}
+
 TEST_F(DiskCacheBackendTest, AppCacheKeying) {
   SetCacheType(net::APP_CACHE);
   BackendKeying();
@@ -896,6 +940,19 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyLoad) {
   BackendLoad();
 }
 
+TEST_F(DiskCacheBackendTest, MemoryOnlyShardedLoad) {
+  SetMaxSize(0x100000);
+  SetMemoryOnlyMode();
+  SetMemoryShardCount(8);
+  BackendLoad();
+}
+
+TEST_F(DiskCacheBackendTest, LogCacheLoad) {
+  SetMaxSize(0x100000);
+  SetLogCacheMode();
+  BackendLoad();
+}
+
 TEST_F(DiskCacheBackendTest, AppCacheLoad) {
   SetCacheType(net::APP_CACHE);
   // Work with a tiny index table (16 entries)
@@ -1627,6 +1684,17 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyDoomRecent) {
   BackendDoomRecent();
 }
 
+TEST_F(DiskCacheBackendTest, DedupCacheDoomRecent) {
+  SetMemoryOnlyMode();
+  SetDedupCacheMode();
+  BackendDoomRecent();
+}
+
+TEST_F(DiskCacheBackendTest, LogCacheDoomRecent) {
+  SetLogCacheMode();
+  BackendDoomRecent();
+}
+
 TEST_F(DiskCacheBackendTest, MemoryOnlyDoomEntriesSinceSparse) {
   SetMemoryOnlyMode();
   base::Time start;
@@ -1715,6 +1783,12 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyDoomBetween) {
   BackendDoomBetween();
 }
 
+TEST_F(DiskCacheBackendTest, DedupCacheDoomBetween) {
+  SetMemoryOnlyMode();
+  SetDedupCacheMode();
+  BackendDoomBetween();
+}
+
 TEST_F(DiskCacheBackendTest, MemoryOnlyDoomEntriesBetweenSparse) {
   SetMemoryOnlyMode();
   base::Time start, end;
@@ -1809,6 +1883,40 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyCalculateSizeOfAllEntries) {
   BackendCalculateSizeOfAllEntries();
 }
 
+TEST_F(DiskCacheBackendTest, MemoryOnlyShardedCalculateSizeOfAllEntries) {
+  SetMemoryOnlyMode();
+  SetMemoryShardCount(8);
+  BackendCalculateSizeOfAllEntries();
+}
+
+// The memory cache counts the blocks taken by large streams, and the blocks
+// it keeps for reuse, against its size.
+TEST_F(DiskCacheBackendTest, MemoryOnlyCalculateSizeOfAllEntriesInBlocks) {
+  SetMemoryOnlyMode();
+  InitCache();
+
+  const std::string key("the first key");
+  const int kKeySize = static_cast<int>(key.size());
+  const int kBlockSize = disk_cache::MemBlockPool::kBlockSize;
+  disk_cache::Entry* entry;
+  ASSERT_THAT(CreateEntry(key, &entry), IsOk());
+
+  const int kSize = kBlockSize + kBlockSize / 2;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+  ASSERT_EQ(kSize, WriteData(entry, 1, 0, buffer.get(), kSize, true));
+  EXPECT_EQ(kKeySize + 2 * kBlockSize, CalculateSizeOfAllEntries());
+
+  // A stream smaller than a block takes its size, and its blocks are kept.
+  ASSERT_EQ(100, WriteData(entry, 1, 0, buffer.get(), 100, true));
+  EXPECT_EQ(kKeySize + 100 + 2 * kBlockSize, CalculateSizeOfAllEntries());
+
+  // Growing the stream again takes the kept blocks.
+  ASSERT_EQ(kSize, WriteData(entry, 1, 0, buffer.get(), kSize, true));
+  EXPECT_EQ(kKeySize + 2 * kBlockSize, CalculateSizeOfAllEntries());
+  entry->Close();
+}
+
 TEST_F(DiskCacheBackendTest, SimpleCacheCalculateSizeOfAllEntries) {
   // Use net::APP_CACHE to make size estimations deterministic via
   // non-optimistic writes.
@@ -2956,6 +3064,12 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyBackendEviction) {
   BackendEviction();
 }
 
+TEST_F(DiskCacheBackendTest, MemoryOnlyShardedBackendEviction) {
+  SetMemoryOnlyMode();
+  SetMemoryShardCount(8);
+  BackendEviction();
+}
+
 // TODO(gavinp): Enable BackendEviction test for simple cache after performance
 // problems are addressed. See crbug.com/588184 for more information.
 
@@ -3116,6 +3230,110 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyDoomAll) {
   BackendDoomAll();
 }
 
+TEST_F(DiskCacheBackendTest, MemoryOnlyShardedDoomAll) {
+  SetMemoryOnlyMode();
+  SetMemoryShardCount(8);
+  BackendDoomAll();
+}
+
+namespace {
+
+// Creates, writes, reads back and dooms entries of |cache|, some only used by
+// this thread and some shared by all threads. Counts unexpected results in
+// |failures|.
+void ExerciseShardedMemoryCache(disk_cache::Backend* cache,
+                                int thread_index,
+                                int* failures) {
+  const int kSize = 3000;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  scoped_refptr<net::IOBuffer> buffer2(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+
+  for (int i = 0; i < 500; ++i) {
+    std::string key = base::StringPrintf("thread%d-%d", thread_index, i);
+    disk_cache::Entry* entry = nullptr;
+    if (cache->CreateEntry(key, &entry, net::CompletionCallback()) !=
+        net::OK) {
+      ++*failures;
+      continue;
+    }
+    if (entry->WriteData(1, 0, buffer.get(), kSize, net::CompletionCallback(),
+                         false) != kSize) {
+      ++*failures;
+    }
+    entry->Close();
+
+    if (cache->OpenEntry(key, &entry, net::CompletionCallback()) != net::OK) {
+      ++*failures;
+      continue;
+    }
+    if (entry->ReadData(1, 0, buffer2.get(), kSize,
+                        net::CompletionCallback()) != kSize ||
+        memcmp(buffer->data(), buffer2->data(), kSize)) {
+      ++*failures;
+    }
+    if (i % 2)
+      entry->Doom();
+    entry->Close();
+
+    // Other threads race for the shared keys, so any result goes.
+    std::string shared_key = base::StringPrintf("shared-%d", i % 10);
+    if (cache->OpenEntry(shared_key, &entry, net::CompletionCallback()) ==
+            net::OK ||
+        cache->CreateEntry(shared_key, &entry, net::CompletionCallback()) ==
+            net::OK) {
+      entry->WriteData(0, 0, buffer.get(), kSize / 3,
+                       net::CompletionCallback(), false);
+      entry->Close();
+    }
+  }
+}
+
+}  // namespace
+
+// Tests that a sharded memory cache can be used from several threads at once.
+TEST_F(DiskCacheBackendTest, MemoryOnlyShardedConcurrentAccess) {
+  std::unique_ptr<disk_cache::Backend> cache =
+      disk_cache::MemBackendImpl::CreateShardedBackend(10 * 1024 * 1024, 8,
+                                                       nullptr);
+  ASSERT_TRUE(cache);
+
+  const int kThreadCount = 4;
+  std::unique_ptr<base::Thread> threads[kThreadCount];
+  int failures[kThreadCount] = {};
+  for (int i = 0; i < kThreadCount; ++i) {
+    threads[i].reset(new base::Thread(base::StringPrintf("Cache%d", i)));
+    ASSERT_TRUE(threads[i]->Start());
+    threads[i]->task_runner()->PostTask(
+        FROM_HERE, base::Bind(&ExerciseShardedMemoryCache, cache.get(), i,
+                              &failures[i]));
+  }
+  for (int i = 0; i < kThreadCount; ++i) {
+    threads[i]->Stop();
+    EXPECT_EQ(0, failures[i]);
+  }
+
+  // Every thread kept half of its own entries, and there are 10 shared ones.
+  EXPECT_EQ(kThreadCount * 250 + 10, cache->GetEntryCount());
+}
+
+TEST_F(DiskCacheBackendTest, LogCacheDoomAll) {
+  SetLogCacheMode();
+  BackendDoomAll();
+}
+
+TEST_F(DiskCacheBackendTest, CompressedCacheDoomAll) {
+  SetSimpleCacheMode();
+  SetCompressedCacheMode();
+  BackendDoomAll();
+}
+
+TEST_F(DiskCacheBackendTest, DedupCacheDoomAll) {
+  SetSimpleCacheMode();
+  SetDedupCacheMode();
+  BackendDoomAll();
+}
+
 TEST_F(DiskCacheBackendTest, AppCacheOnlyDoomAll) {
   SetCacheType(net::APP_CACHE);
   BackendDoomAll();
@@ -3813,3 +4031,191 @@ TEST_F(DiskCacheBackendTest, SimpleCacheLateDoom) {
   EXPECT_EQ(disk_cache::SimpleIndex::INITIALIZE_METHOD_LOADED,
             simple_cache_impl_->index()->init_method());
 }
+
+// Tests that the entries requested the most are kept open after a restart,
+// until they are requested again.
+TEST_F(DiskCacheBackendTest, SimpleCacheWarmUp) {
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndEnableFeature(disk_cache::kSimpleCacheWarmUp);
+  SetSimpleCacheMode();
+  InitCache();
+
+  const int kSize = 1000;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+
+  disk_cache::Entry* entry;
+  ASSERT_THAT(CreateEntry("first", &entry), IsOk());
+  EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer.get(), kSize, false));
+  entry->Close();
+  ASSERT_THAT(CreateEntry("second", &entry), IsOk());
+  entry->Close();
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_THAT(OpenEntry("first", &entry), IsOk());
+    entry->Close();
+  }
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+
+  cache_.reset();
+  DisableFirstCleanup();
+  InitCache();
+  disk_cache::SimpleCacheWarmer* warmer = simple_cache_impl_->warmer();
+  ASSERT_TRUE(warmer);
+  base::RunLoop run_loop;
+  warmer->SetDoneCallbackForTesting(run_loop.QuitClosure());
+  run_loop.Run();
+  EXPECT_EQ(2u, warmer->warm_entry_count());
+
+  // The warm entry is handed over to the request.
+  ASSERT_THAT(OpenEntry("first", &entry), IsOk());
+  EXPECT_EQ(1u, warmer->warm_entry_count());
+  scoped_refptr<net::IOBuffer> buffer2(new net::IOBuffer(kSize));
+  EXPECT_EQ(kSize, ReadData(entry, 1, 0, buffer2.get(), kSize));
+  EXPECT_EQ(0, memcmp(buffer->data(), buffer2->data(), kSize));
+  entry->Close();
+}
+
+// Tests that the entries of a log cache, and the removal of doomed ones,
+// survive restarting the cache.
+TEST_F(DiskCacheBackendTest, LogCacheRestart) {
+  SetLogCacheMode();
+  InitCache();
+
+  const int kSize = 1000;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+
+  disk_cache::Entry* entry;
+  ASSERT_THAT(CreateEntry("first", &entry), IsOk());
+  EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer.get(), kSize, false));
+  entry->Close();
+  ASSERT_THAT(CreateEntry("second", &entry), IsOk());
+  entry->Close();
+  ASSERT_THAT(CreateEntry("third", &entry), IsOk());
+  entry->Close();
+  EXPECT_THAT(DoomEntry("second"), IsOk());
+
+  cache_.reset();
+  DisableFirstCleanup();
+  InitCache();
+  EXPECT_EQ(2, cache_->GetEntryCount());
+
+  ASSERT_THAT(OpenEntry("first", &entry), IsOk());
+  scoped_refptr<net::IOBuffer> buffer2(new net::IOBuffer(kSize));
+  EXPECT_EQ(kSize, ReadData(entry, 1, 0, buffer2.get(), kSize));
+  EXPECT_EQ(0, memcmp(buffer->data(), buffer2->data(), kSize));
+  entry->Close();
+  EXPECT_NE(net::OK, OpenEntry("second", &entry));
+  ASSERT_THAT(OpenEntry("third", &entry), IsOk());
+  entry->Close();
+}
+
+// Tests that a log cache rebuilds its index from the log when the index file
+// is missing.
+TEST_F(DiskCacheBackendTest, LogCacheReplayWithoutIndex) {
+  SetLogCacheMode();
+  UseCurrentThread();
+  InitCache();
+
+  disk_cache::Entry* entry;
+  ASSERT_THAT(CreateEntry("first", &entry), IsOk());
+  entry->Close();
+  ASSERT_THAT(CreateEntry("second", &entry), IsOk());
+  entry->Close();
+  EXPECT_THAT(DoomEntry("first"), IsOk());
+
+  // Let the log and the index be written out before removing the index.
+  cache_.reset();
+  base::RunLoop().RunUntilIdle();
+  ASSERT_TRUE(base::DeleteFile(cache_path_.AppendASCII("log-index"), false));
+
+  DisableFirstCleanup();
+  InitCache();
+  EXPECT_EQ(1, cache_->GetEntryCount());
+  EXPECT_NE(net::OK, OpenEntry("first", &entry));
+  ASSERT_THAT(OpenEntry("second", &entry), IsOk());
+  entry->Close();
+}
+
+// Tests that rewriting the same entries over and over keeps the log cache
+// within its size by compacting segments, without losing any live entry.
+TEST_F(DiskCacheBackendTest, LogCacheCompaction) {
+  const int kMaxSize = 0x100000;
+  SetMaxSize(kMaxSize);
+  SetLogCacheMode();
+  InitCache();
+
+  const int kSize = 20000;
+  const int kNumEntries = 10;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  for (int round = 0; round < 20; ++round) {
+    CacheTestFillBuffer(buffer->data(), kSize, false);
+    buffer->data()[0] = static_cast<char>(round);
+    for (int i = 0; i < kNumEntries; ++i) {
+      std::string key = base::StringPrintf("key%d", i);
+      disk_cache::Entry* entry;
+      if (OpenEntry(key, &entry) != net::OK) {
+        ASSERT_THAT(CreateEntry(key, &entry), IsOk());
+      }
+      EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer.get(), kSize, true));
+      entry->Close();
+    }
+  }
+  EXPECT_EQ(kNumEntries, cache_->GetEntryCount());
+
+  base::StringPairs stats;
+  cache_->GetStats(&stats);
+  uint64_t disk_size = 0;
+  for (const auto& stat : stats) {
+    if (stat.first == "Disk size")
+      ASSERT_TRUE(base::StringToUint64(stat.second, &disk_size));
+  }
+  EXPECT_GT(disk_size, 0u);
+  EXPECT_LE(disk_size, static_cast<uint64_t>(kMaxSize));
+
+  scoped_refptr<net::IOBuffer> buffer2(new net::IOBuffer(kSize));
+  for (int i = 0; i < kNumEntries; ++i) {
+    disk_cache::Entry* entry;
+    ASSERT_THAT(OpenEntry(base::StringPrintf("key%d", i), &entry), IsOk());
+    EXPECT_EQ(kSize, ReadData(entry, 1, 0, buffer2.get(), kSize));
+    EXPECT_EQ(0, memcmp(buffer->data(), buffer2->data(), kSize));
+    entry->Close();
+  }
+}
+
+// Tests that opens waiting for an entry to be read from the log fail once the
+// backend is destroyed.
+TEST_F(DiskCacheBackendTest, LogCacheDestroyedWhileOpening) {
+  SetLogCacheMode();
+  InitCache();
+
+  disk_cache::Entry* entry;
+  ASSERT_THAT(CreateEntry("key", &entry), IsOk());
+  entry->Close();
+
+  cache_.reset();
+  DisableFirstCleanup();
+  InitCache();
+
+  net::TestCompletionCallback cb;
+  entry = nullptr;
+  ASSERT_EQ(net::ERR_IO_PENDING,
+            cache_->OpenEntry("key", &entry, cb.callback()));
+  cache_.reset();
+  EXPECT_EQ(net::ERR_ABORTED, cb.WaitForResult());
+  EXPECT_FALSE(entry);
+}
+
+TEST_F(DiskCacheBackendTest, LogCacheSparseNotSupported) {
+  SetLogCacheMode();
+  InitCache();
+
+  disk_cache::Entry* entry;
+  ASSERT_THAT(CreateEntry("sparse", &entry), IsOk());
+  EXPECT_FALSE(entry->CouldBeSparse());
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(100));
+  EXPECT_EQ(net::ERR_CACHE_OPERATION_NOT_SUPPORTED,
+            WriteSparseData(entry, 0, buffer.get(), 100));
+  entry->Close();
+}
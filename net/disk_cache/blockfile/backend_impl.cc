@@ -1229,6 +1229,13 @@ int BackendImpl::OpenEntry(const std::string& key, Entry** entry,
   return net::ERR_IO_PENDING;
 }
 
+int BackendImpl::OpenEntryWithReadAhead(const std::string& key,
+                                        int read_ahead_size,
+                                        Entry** entry,
+                                        const CompletionCallback& callback) {
+  return OpenEntry(key, entry, callback);
+}
+
 int BackendImpl::CreateEntry(const std::string& key, Entry** entry,
                              const CompletionCallback& callback) {
   DCHECK(!callback.is_null());
@@ -1333,6 +1340,11 @@ void BackendImpl::OnExternalCacheHit(const std::string& key) {
   background_queue_.OnExternalCacheHit(key);
 }
 
+bool BackendImpl::MayHaveEntry(const std::string& key) const {
+  // The index is only read on the cache thread.
+  return true;
+}
+
 // ------------------------------------------------------------------------
 
 // We just created a new file so we're going to write the header and set the
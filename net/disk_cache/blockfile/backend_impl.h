@@ -269,6 +269,10 @@ class NET_EXPORT_PRIVATE BackendImpl : public Backend {
   int OpenEntry(const std::string& key,
                 Entry** entry,
                 const CompletionCallback& callback) override;
+  int OpenEntryWithReadAhead(const std::string& key,
+                             int read_ahead_size,
+                             Entry** entry,
+                             const CompletionCallback& callback) override;
   int CreateEntry(const std::string& key,
                   Entry** entry,
                   const CompletionCallback& callback) override;
@@ -292,6 +296,7 @@ class NET_EXPORT_PRIVATE BackendImpl : public Backend {
   std::unique_ptr<Iterator> CreateIterator() override;
   void GetStats(StatsItems* stats) override;
   void OnExternalCacheHit(const std::string& key) override;
+  bool MayHaveEntry(const std::string& key) const override;
 
  private:
   using EntriesMap = std::unordered_map<CacheAddr, EntryImpl*>;
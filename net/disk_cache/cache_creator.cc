@@ -4,6 +4,7 @@
 
 #include <utility>
 
+#include "base/feature_list.h"
 #include "base/files/file_path.h"
 #include "base/macros.h"
 #include "base/metrics/field_trial.h"
@@ -13,9 +14,13 @@
 #include "net/base/net_errors.h"
 #include "net/disk_cache/blockfile/backend_impl.h"
 #include "net/disk_cache/cache_util.h"
+#include "net/disk_cache/compressed/compressed_backend_impl.h"
+#include "net/disk_cache/dedup/dedup_backend_impl.h"
 #include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/log/log_backend_impl.h"
 #include "net/disk_cache/memory/mem_backend_impl.h"
 #include "net/disk_cache/simple/simple_backend_impl.h"
+#include "net/disk_cache/tiered/tiered_backend_impl.h"
 
 namespace {
 
@@ -109,6 +114,14 @@ int CacheCreator::Run() {
         base::Bind(&CacheCreator::OnIOComplete, base::Unretained(this)));
   }
 
+  if (backend_type_ == net::CACHE_BACKEND_LOG) {
+    disk_cache::LogBackendImpl* log_cache = new disk_cache::LogBackendImpl(
+        path_, max_bytes_, type_, thread_);
+    created_cache_.reset(log_cache);
+    return log_cache->Init(
+        base::Bind(&CacheCreator::OnIOComplete, base::Unretained(this)));
+  }
+
   // Avoid references to blockfile functions on Android to reduce binary size.
 #if defined(OS_ANDROID)
   return net::ERR_FAILED;
@@ -129,6 +142,24 @@ int CacheCreator::Run() {
 void CacheCreator::DoCallback(int result) {
   DCHECK_NE(net::ERR_IO_PENDING, result);
   if (result == net::OK) {
+    if (type_ == net::DISK_CACHE &&
+        base::FeatureList::IsEnabled(disk_cache::kDiskCacheCompression)) {
+      created_cache_.reset(new disk_cache::CompressedBackendImpl(
+          std::move(created_cache_), disk_cache::kCompressedStreamMask));
+    }
+    // Above compression, so that bodies are hashed before they are compressed.
+    if (type_ == net::DISK_CACHE &&
+        base::FeatureList::IsEnabled(disk_cache::kDiskCacheDeduplication)) {
+      created_cache_.reset(
+          new disk_cache::DedupBackendImpl(std::move(created_cache_)));
+    }
+    // Outermost, so that the hits in memory skip the work of the others.
+    if (type_ == net::DISK_CACHE &&
+        base::FeatureList::IsEnabled(disk_cache::kDiskCacheMemoryTier)) {
+      created_cache_.reset(new disk_cache::TieredBackendImpl(
+          std::move(created_cache_), disk_cache::kDefaultMemoryTierSize,
+          net_log_));
+    }
     *backend_ = std::move(created_cache_);
   } else {
     LOG(ERROR) << "Unable to create cache";
@@ -0,0 +1,38 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/compressed/compressed_backend_impl.h"
+
+#include <utility>
+
+#include "net/disk_cache/compressed/compressed_entry_impl.h"
+
+namespace disk_cache {
+
+namespace {
+
+// Prefixes the keys of the entries of the wrapped backend. The keys of the
+// HTTP cache never start with it.
+const char kWrappedKeyPrefix[] = "compressed/";
+
+}  // namespace
+
+const base::Feature kDiskCacheCompression{"DiskCacheCompression",
+                                          base::FEATURE_DISABLED_BY_DEFAULT};
+
+CompressedBackendImpl::CompressedBackendImpl(std::unique_ptr<Backend> backend,
+                                             uint32_t stream_mask)
+    : WrappingBackend(std::move(backend), kWrappedKeyPrefix),
+      stream_mask_(stream_mask),
+      weak_factory_(this) {}
+
+CompressedBackendImpl::~CompressedBackendImpl() {}
+
+WrappingEntry* CompressedBackendImpl::NewEntry(const std::string& key,
+                                               Entry* wrapped_entry) {
+  return new CompressedEntryImpl(weak_factory_.GetWeakPtr(), key,
+                                 wrapped_entry, stream_mask_);
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,70 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_COMPRESSED_COMPRESSED_BACKEND_IMPL_H_
+#define NET_DISK_CACHE_COMPRESSED_COMPRESSED_BACKEND_IMPL_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+#include "base/feature_list.h"
+#include "base/macros.h"
+#include "base/memory/weak_ptr.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/wrapping_backend.h"
+
+namespace disk_cache {
+
+// Makes CreateCacheBackend() store the bodies of disk cache entries
+// compressed, with a CompressedBackendImpl.
+NET_EXPORT_PRIVATE extern const base::Feature kDiskCacheCompression;
+
+// The streams CreateCacheBackend() compresses: the bodies of HTTP cache
+// entries, but not their headers, which are small.
+const uint32_t kCompressedStreamMask = 1 << 1;
+
+// This class implements the Backend interface on top of another backend,
+// storing the data streams of its entries compressed with zlib when that
+// saves space. Streams are compressed as they are written, and decompressed as
+// they are read.
+//
+// Whether a stream is compressed is decided on its first write: the data
+// written is compressed, and kept that way only if it shrinks enough. Data
+// that is already compressed, like images or responses with a
+// Content-Encoding, is thus stored as is, whatever its content type.
+//
+// Compressed streams only support writes that append to them, or that
+// truncate them to be written again from the start, which is how the HTTP
+// cache writes bodies. They are read fastest from start to end.
+//
+// Entries are stored in the wrapped backend under keys with a prefix, so that
+// the entries written with and without compression never mix.
+class NET_EXPORT_PRIVATE CompressedBackendImpl final : public WrappingBackend {
+ public:
+  // Compresses the streams of the entries of |backend| that have their bit set
+  // in |stream_mask|.
+  CompressedBackendImpl(std::unique_ptr<Backend> backend,
+                        uint32_t stream_mask);
+  ~CompressedBackendImpl() override;
+
+ private:
+  // WrappingBackend implementation.
+  WrappingEntry* NewEntry(const std::string& key,
+                          Entry* wrapped_entry) override;
+
+  const uint32_t stream_mask_;
+
+  base::WeakPtrFactory<CompressedBackendImpl> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompressedBackendImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_COMPRESSED_COMPRESSED_BACKEND_IMPL_H_
@@ -0,0 +1,389 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/compressed/compressed_backend_impl.h"
+
+#include <memory>
+#include <string>
+
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/disk_cache_test_base.h"
+#include "net/disk_cache/disk_cache_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+const int kBodyIndex = 1;
+
+// Returns |size| bytes of text that compresses well.
+std::string MakeCompressibleData(int size) {
+  std::string data;
+  for (int i = 0; static_cast<int>(data.size()) < size; ++i)
+    data += "<p>Paragraph " + std::to_string(i) + " of the document.</p>\n";
+  data.resize(size);
+  return data;
+}
+
+// Returns |size| bytes that do not compress.
+std::string MakeRandomData(int size) {
+  std::string data(size, '\0');
+  CacheTestFillBuffer(&data[0], size, false);
+  return data;
+}
+
+class CompressedBackendTest : public DiskCacheTestWithCache {
+ protected:
+  void InitCompressedCache() {
+    SetSimpleCacheMode();
+    SetCompressedCacheMode();
+    InitCache();
+  }
+
+  Backend* wrapped_backend() const {
+    return compressed_cache_impl_->wrapped_backend();
+  }
+
+  Entry* CreateEntry(const std::string& key) {
+    Entry* entry = nullptr;
+    EXPECT_EQ(net::OK, DiskCacheTestWithCache::CreateEntry(key, &entry));
+    return entry;
+  }
+
+  Entry* OpenEntry(const std::string& key) {
+    Entry* entry = nullptr;
+    if (DiskCacheTestWithCache::OpenEntry(key, &entry) != net::OK)
+      return nullptr;
+    return entry;
+  }
+
+  // Returns the stored size of stream |index| of the entry under |key|.
+  int GetStoredSize(const std::string& key, int index) {
+    Entry* wrapped_entry = nullptr;
+    net::TestCompletionCallback cb;
+    int rv = cb.GetResult(wrapped_backend()->OpenEntry(
+        compressed_cache_impl_->GetWrappedKey(key), &wrapped_entry,
+        cb.callback()));
+    if (rv != net::OK)
+      return rv;
+    int size = wrapped_entry->GetDataSize(index);
+    wrapped_entry->Close();
+    return size;
+  }
+
+  int WriteString(Entry* entry,
+                  int index,
+                  int offset,
+                  const std::string& data,
+                  bool truncate) {
+    scoped_refptr<net::StringIOBuffer> buffer(new net::StringIOBuffer(data));
+    return WriteData(entry, index, offset, buffer.get(), data.size(),
+                     truncate);
+  }
+
+  std::string ReadString(Entry* entry, int index, int offset, int len) {
+    scoped_refptr<net::IOBufferWithSize> buffer(
+        new net::IOBufferWithSize(len));
+    int rv = ReadData(entry, index, offset, buffer.get(), len);
+    if (rv < 0)
+      return std::string();
+    return std::string(buffer->data(), rv);
+  }
+
+  // Writes |data| to the body of |entry| in chunks of |chunk_size|.
+  void WriteBody(Entry* entry, const std::string& data, int chunk_size) {
+    for (size_t offset = 0; offset < data.size(); offset += chunk_size) {
+      const std::string chunk = data.substr(offset, chunk_size);
+      EXPECT_EQ(static_cast<int>(chunk.size()),
+                WriteString(entry, kBodyIndex, offset, chunk, false));
+    }
+  }
+};
+
+}  // namespace
+
+TEST_F(CompressedBackendTest, CompressibleBody) {
+  InitCompressedCache();
+  const std::string kHeaders = MakeCompressibleData(200);
+  const std::string kBody = MakeCompressibleData(100 * 1024);
+
+  Entry* entry = CreateEntry("key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ("key", entry->GetKey());
+  EXPECT_EQ(static_cast<int>(kHeaders.size()),
+            WriteString(entry, 0, 0, kHeaders, true));
+  WriteBody(entry, kBody, 10000);
+  EXPECT_EQ(static_cast<int>(kBody.size()), entry->GetDataSize(kBodyIndex));
+  EXPECT_EQ(kBody.substr(50000, 3000),
+            ReadString(entry, kBodyIndex, 50000, 3000));
+  entry->Close();
+
+  // The headers are stored as is, the body is stored compressed.
+  EXPECT_EQ(static_cast<int>(kHeaders.size()), GetStoredSize("key", 0));
+  EXPECT_LT(GetStoredSize("key", kBodyIndex),
+            static_cast<int>(kBody.size()) / 2);
+
+  entry = OpenEntry("key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(static_cast<int>(kBody.size()), entry->GetDataSize(kBodyIndex));
+  EXPECT_EQ(kHeaders, ReadString(entry, 0, 0, kHeaders.size()));
+
+  std::string body;
+  while (body.size() < kBody.size())
+    body += ReadString(entry, kBodyIndex, body.size(), 7000);
+  EXPECT_EQ(kBody, body);
+
+  // Reads at arbitrary offsets, including before the ones read last.
+  const int kOffsets[] = {90000, 100, 65000, 32767, 102399, 0};
+  for (int offset : kOffsets) {
+    EXPECT_EQ(kBody.substr(offset, 1000),
+              ReadString(entry, kBodyIndex, offset, 1000))
+        << offset;
+  }
+  EXPECT_EQ(std::string(), ReadString(entry, kBodyIndex, kBody.size(), 1000));
+  entry->Close();
+}
+
+TEST_F(CompressedBackendTest, IncompressibleBody) {
+  InitCompressedCache();
+  const std::string kBody = MakeRandomData(50000);
+
+  Entry* entry = CreateEntry("key");
+  ASSERT_TRUE(entry);
+  WriteBody(entry, kBody, kBody.size());
+  entry->Close();
+
+  // Only the header is added.
+  EXPECT_GE(GetStoredSize("key", kBodyIndex), static_cast<int>(kBody.size()));
+  EXPECT_LT(GetStoredSize("key", kBodyIndex),
+            static_cast<int>(kBody.size()) + 100);
+
+  entry = OpenEntry("key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(static_cast<int>(kBody.size()), entry->GetDataSize(kBodyIndex));
+  EXPECT_EQ(kBody.substr(1234, 5000),
+            ReadString(entry, kBodyIndex, 1234, 5000));
+  // Stored streams can be written anywhere.
+  EXPECT_EQ(3, WriteString(entry, kBodyIndex, 10, "abc", false));
+  EXPECT_EQ("abc", ReadString(entry, kBodyIndex, 10, 3));
+  entry->Close();
+}
+
+TEST_F(CompressedBackendTest, AppendAfterReopen) {
+  InitCompressedCache();
+  const std::string kBody = MakeCompressibleData(80000);
+
+  Entry* entry = CreateEntry("key");
+  ASSERT_TRUE(entry);
+  WriteBody(entry, kBody.substr(0, 30000), 30000);
+  entry->Close();
+
+  entry = OpenEntry("key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(30000, entry->GetDataSize(kBodyIndex));
+  EXPECT_EQ(50000,
+            WriteString(entry, kBodyIndex, 30000, kBody.substr(30000), false));
+  entry->Close();
+
+  entry = OpenEntry("key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(static_cast<int>(kBody.size()), entry->GetDataSize(kBodyIndex));
+  EXPECT_EQ(kBody, ReadString(entry, kBodyIndex, 0, kBody.size()));
+  entry->Close();
+}
+
+TEST_F(CompressedBackendTest, TruncateAndRewrite) {
+  InitCompressedCache();
+  const std::string kFirstBody = MakeCompressibleData(40000);
+  const std::string kSecondBody = MakeRandomData(1000);
+
+  Entry* entry = CreateEntry("key");
+  ASSERT_TRUE(entry);
+  WriteBody(entry, kFirstBody, 4000);
+  EXPECT_EQ(1000, WriteString(entry, kBodyIndex, 0, kSecondBody, true));
+  EXPECT_EQ(1000, entry->GetDataSize(kBodyIndex));
+  EXPECT_EQ(kSecondBody, ReadString(entry, kBodyIndex, 0, 5000));
+  EXPECT_EQ(0, WriteString(entry, kBodyIndex, 0, std::string(), true));
+  EXPECT_EQ(0, entry->GetDataSize(kBodyIndex));
+  entry->Close();
+
+  entry = OpenEntry("key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(0, entry->GetDataSize(kBodyIndex));
+  entry->Close();
+}
+
+TEST_F(CompressedBackendTest, RestartPoints) {
+  InitCompressedCache();
+  const std::string kBody = MakeCompressibleData(400 * 1024);
+
+  Entry* entry = CreateEntry("key");
+  ASSERT_TRUE(entry);
+  // A first write larger than the interval between restart points, then
+  // appends across them.
+  WriteBody(entry, kBody.substr(0, 150000), 150000);
+  EXPECT_EQ(100000,
+            WriteString(entry, kBodyIndex, 150000, kBody.substr(150000, 100000),
+                        false));
+  entry->Close();
+
+  entry = OpenEntry("key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(250000, entry->GetDataSize(kBodyIndex));
+  // A new deflate stream starts after the reopen.
+  EXPECT_EQ(static_cast<int>(kBody.size()) - 250000,
+            WriteString(entry, kBodyIndex, 250000, kBody.substr(250000),
+                        false));
+  entry->Close();
+
+  entry = OpenEntry("key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(static_cast<int>(kBody.size()), entry->GetDataSize(kBodyIndex));
+  const int kOffsets[] = {300000, 10, 200000, 65535, 65536, 131072,
+                          400000, 249999, 250000, 0,     409599};
+  for (int offset : kOffsets) {
+    EXPECT_EQ(kBody.substr(offset, 1000),
+              ReadString(entry, kBodyIndex, offset, 1000))
+        << offset;
+  }
+  EXPECT_EQ(kBody, ReadString(entry, kBodyIndex, 0, kBody.size()));
+  entry->Close();
+}
+
+TEST_F(CompressedBackendTest, CorruptRestartPoints) {
+  InitCompressedCache();
+  const std::string kBody = MakeCompressibleData(200 * 1024);
+
+  Entry* entry = CreateEntry("key");
+  ASSERT_TRUE(entry);
+  WriteBody(entry, kBody, 10000);
+  entry->Close();
+
+  // Drops the last restart point.
+  const int stored_size = GetStoredSize("key", kBodyIndex);
+  Entry* wrapped_entry = nullptr;
+  net::TestCompletionCallback cb;
+  ASSERT_EQ(net::OK, cb.GetResult(wrapped_backend()->OpenEntry(
+                         compressed_cache_impl_->GetWrappedKey("key"),
+                         &wrapped_entry, cb.callback())));
+  EXPECT_EQ(0, WriteData(wrapped_entry, kBodyIndex, stored_size - 8, nullptr,
+                         0, true));
+  wrapped_entry->Close();
+
+  EXPECT_FALSE(OpenEntry("key"));
+}
+
+TEST_F(CompressedBackendTest, WritesInsideDeflatedStream) {
+  InitCompressedCache();
+  const std::string kBody = MakeCompressibleData(100 * 1024);
+
+  Entry* entry = CreateEntry("key");
+  ASSERT_TRUE(entry);
+  WriteBody(entry, kBody, 10000);
+  EXPECT_LT(GetStoredSize("key", kBodyIndex), static_cast<int>(kBody.size()));
+
+  // An overwrite stores the stream as is from then on.
+  std::string body = kBody;
+  body.replace(70000, 3, "abc");
+  EXPECT_EQ(3, WriteString(entry, kBodyIndex, 70000, "abc", false));
+  EXPECT_EQ(static_cast<int>(body.size()), entry->GetDataSize(kBodyIndex));
+  EXPECT_EQ(body, ReadString(entry, kBodyIndex, 0, body.size()));
+  EXPECT_GT(GetStoredSize("key", kBodyIndex), static_cast<int>(body.size()));
+
+  // So do writes past the end, and truncations.
+  body += std::string(1, '\0') + "def";
+  EXPECT_EQ(3, WriteString(entry, kBodyIndex, kBody.size() + 1, "def", false));
+  EXPECT_EQ(body, ReadString(entry, kBodyIndex, 0, body.size()));
+  EXPECT_EQ(0, WriteString(entry, kBodyIndex, 5000, std::string(), true));
+  EXPECT_EQ(5000, entry->GetDataSize(kBodyIndex));
+  entry->Close();
+
+  entry = OpenEntry("key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(5000, entry->GetDataSize(kBodyIndex));
+  EXPECT_EQ(body.substr(0, 5000), ReadString(entry, kBodyIndex, 0, 10000));
+  entry->Close();
+}
+
+TEST_F(CompressedBackendTest, WriteInsideDeflatedStreamAfterReopen) {
+  InitCompressedCache();
+  const std::string kBody = MakeCompressibleData(100 * 1024);
+
+  Entry* entry = CreateEntry("key");
+  ASSERT_TRUE(entry);
+  WriteBody(entry, kBody, kBody.size());
+  entry->Close();
+
+  // The stream is read back from the wrapped entry before the overwrite.
+  entry = OpenEntry("key");
+  ASSERT_TRUE(entry);
+  std::string body = kBody;
+  body.replace(10, 3, "abc");
+  EXPECT_EQ(3, WriteString(entry, kBodyIndex, 10, "abc", false));
+  EXPECT_EQ(body, ReadString(entry, kBodyIndex, 0, body.size()));
+  entry->Close();
+
+  entry = OpenEntry("key");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(body, ReadString(entry, kBodyIndex, 0, body.size()));
+  entry->Close();
+}
+
+TEST_F(CompressedBackendTest, CorruptHeader) {
+  InitCompressedCache();
+  const std::string kWrappedKey = compressed_cache_impl_->GetWrappedKey("key");
+  Entry* wrapped_entry = nullptr;
+  net::TestCompletionCallback cb;
+  ASSERT_EQ(net::OK, cb.GetResult(wrapped_backend()->CreateEntry(
+                         kWrappedKey, &wrapped_entry, cb.callback())));
+  EXPECT_EQ(50, WriteString(wrapped_entry, kBodyIndex, 0, MakeRandomData(50),
+                            false));
+  wrapped_entry->Close();
+
+  EXPECT_FALSE(OpenEntry("key"));
+  // The entry is doomed.
+  EXPECT_EQ(net::ERR_FAILED, cb.GetResult(wrapped_backend()->OpenEntry(
+                                 kWrappedKey, &wrapped_entry, cb.callback())));
+}
+
+TEST_F(CompressedBackendTest, Iterator) {
+  InitCompressedCache();
+  Entry* wrapped_entry = nullptr;
+  net::TestCompletionCallback cb;
+  ASSERT_EQ(net::OK, cb.GetResult(wrapped_backend()->CreateEntry(
+                         "uncompressed", &wrapped_entry, cb.callback())));
+  wrapped_entry->Close();
+  Entry* entry = CreateEntry("key");
+  ASSERT_TRUE(entry);
+  entry->Close();
+
+  std::unique_ptr<Backend::Iterator> iter = cache_->CreateIterator();
+  ASSERT_EQ(net::OK,
+            cb.GetResult(iter->OpenNextEntry(&entry, cb.callback())));
+  EXPECT_EQ("key", entry->GetKey());
+  entry->Close();
+  EXPECT_EQ(net::ERR_FAILED,
+            cb.GetResult(iter->OpenNextEntry(&entry, cb.callback())));
+}
+
+TEST_F(CompressedBackendTest, SharedEntry) {
+  InitCompressedCache();
+  const std::string kBody = MakeCompressibleData(20000);
+
+  Entry* entry1 = CreateEntry("key");
+  ASSERT_TRUE(entry1);
+  Entry* entry2 = OpenEntry("key");
+  ASSERT_TRUE(entry2);
+  EXPECT_EQ(entry1, entry2);
+  WriteBody(entry1, kBody, 5000);
+  entry1->Close();
+  EXPECT_EQ(kBody, ReadString(entry2, kBodyIndex, 0, kBody.size()));
+  entry2->Close();
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,941 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/compressed/compressed_entry_impl.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/compressed/compressed_backend_impl.h"
+#include "third_party/zlib/zlib.h"
+
+namespace disk_cache {
+
+namespace {
+
+const uint32_t kCompressedStreamMagicNumber = 0x7a6c6962;
+
+// The header at the start of each compressed stream of a wrapped entry.
+struct CompressedStreamHeader {
+  uint32_t magic_number;
+  uint32_t mode;
+  // The size of the data, before compression.
+  int32_t data_size;
+  // The size of the deflated data, which is followed by
+  // |restart_point_count| RestartPoints. Unused for stored data.
+  int32_t stored_size;
+  int32_t restart_point_count;
+};
+
+const int kHeaderSize = sizeof(CompressedStreamHeader);
+
+// A point of a deflated stream from which the rest of it decodes on its own:
+// the data from |data_offset| on is deflated from |stored_offset| in the
+// stored data, without reference to the data before it.
+struct RestartPoint {
+  int32_t data_offset;
+  int32_t stored_offset;
+};
+
+const int kRestartPointSize = sizeof(RestartPoint);
+
+// The size of the window of decoded data, and of the reads of deflated data.
+const int kChunkSize = 32 * 1024;
+
+// A deflated stream gets a restart point every time this much data is
+// written after the last one.
+const int kRestartPointInterval = 2 * kChunkSize;
+
+// The data of a stream is stored deflated if that takes at most this fraction
+// of its size, in percent.
+const int kMaxDeflatedSizePercent = 90;
+
+// Returns the result of a write of |data_len| bytes, stored as |stored_len|
+// bytes, for the |result| of the write to the wrapped entry.
+int GetWriteResult(int stored_len, int data_len, int result) {
+  if (result == stored_len)
+    return data_len;
+  return result < 0 ? result : net::ERR_CACHE_WRITE_FAILURE;
+}
+
+void OnStoredDataWritten(const net::CompletionCallback& callback,
+                         int stored_len,
+                         int data_len,
+                         int result) {
+  if (!callback.is_null())
+    callback.Run(GetWriteResult(stored_len, data_len, result));
+}
+
+// Deflates |data_len| bytes of |data| with |deflate_stream|, and flushes the
+// output to a byte boundary. The data goes at |start| in the stream, which has
+// the restart points |restart_points|: the output is fully flushed whenever
+// the data reaches |kRestartPointInterval| bytes after the last one, and the
+// new restart points are added. Returns the output.
+scoped_refptr<net::IOBufferWithSize> Deflate(
+    z_stream* deflate_stream,
+    const char* data,
+    int data_len,
+    const RestartPoint& start,
+    std::vector<RestartPoint>* restart_points) {
+  std::string output;
+  deflate_stream->next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  const int end_offset = start.data_offset + data_len;
+  int offset = start.data_offset;
+  do {
+    const int restart_offset =
+        (restart_points->empty() ? 0 : restart_points->back().data_offset) +
+        kRestartPointInterval;
+    DCHECK_GT(restart_offset, offset);
+    const int len = std::min(end_offset, restart_offset) - offset;
+    const int flush = offset + len == restart_offset ? Z_FULL_FLUSH
+                                                     : Z_SYNC_FLUSH;
+    deflate_stream->avail_in = len;
+    char out_chunk[4096];
+    do {
+      deflate_stream->next_out = reinterpret_cast<Bytef*>(out_chunk);
+      deflate_stream->avail_out = sizeof(out_chunk);
+      int rv = deflate(deflate_stream, flush);
+      DCHECK(rv == Z_OK || rv == Z_BUF_ERROR);
+      output.append(out_chunk, sizeof(out_chunk) - deflate_stream->avail_out);
+    } while (deflate_stream->avail_out == 0);
+    DCHECK_EQ(0u, deflate_stream->avail_in);
+    offset += len;
+    if (flush == Z_FULL_FLUSH) {
+      RestartPoint restart_point;
+      restart_point.data_offset = offset;
+      restart_point.stored_offset = start.stored_offset + output.size();
+      restart_points->push_back(restart_point);
+    }
+  } while (offset < end_offset);
+
+  scoped_refptr<net::IOBufferWithSize> buffer =
+      new net::IOBufferWithSize(output.size());
+  memcpy(buffer->data(), output.data(), output.size());
+  return buffer;
+}
+
+}  // namespace
+
+struct CompressedEntryImpl::Stream {
+  Stream()
+      : mode(MODE_EMPTY),
+        data_size(0),
+        stored_size(0),
+        header_dirty(false),
+        read_offset(0),
+        decoded_offset(0),
+        decoded_len(0) {}
+
+  ~Stream() {
+    if (deflate_stream)
+      deflateEnd(deflate_stream.get());
+    if (inflate_stream)
+      inflateEnd(inflate_stream.get());
+  }
+
+  // Returns the last restart point at or before |offset|, or the start of
+  // the stream.
+  RestartPoint GetRestartPoint(int offset) const {
+    auto it = std::upper_bound(
+        restart_points.begin(), restart_points.end(), offset,
+        [](int data_offset, const RestartPoint& restart_point) {
+          return data_offset < restart_point.data_offset;
+        });
+    if (it != restart_points.begin())
+      return *(it - 1);
+    RestartPoint start;
+    start.data_offset = 0;
+    start.stored_offset = 0;
+    return start;
+  }
+
+  Mode mode;
+  int data_size;
+  // The size of the stored data, after the header, and before the restart
+  // points.
+  int stored_size;
+  // True if |data_size| changed since the header was written.
+  bool header_dirty;
+  // The restart points of a deflated stream, by increasing offsets.
+  std::vector<RestartPoint> restart_points;
+
+  // Used to append to a deflated stream.
+  std::unique_ptr<z_stream> deflate_stream;
+
+  // Used to read a deflated stream: the stored data is read from
+  // |read_offset| into |inflate_input|, and decoded into |decoded|, which
+  // holds |decoded_len| bytes of data from |decoded_offset|.
+  std::unique_ptr<z_stream> inflate_stream;
+  scoped_refptr<net::IOBufferWithSize> inflate_input;
+  int read_offset;
+  scoped_refptr<net::IOBufferWithSize> decoded;
+  int decoded_offset;
+  int decoded_len;
+};
+
+CompressedEntryImpl::QueuedOperation::QueuedOperation(
+    const base::Callback<int()>& operation,
+    const CompletionCallback& callback)
+    : operation(operation), callback(callback) {}
+
+CompressedEntryImpl::QueuedOperation::QueuedOperation(
+    const QueuedOperation& other) = default;
+
+CompressedEntryImpl::QueuedOperation::~QueuedOperation() {}
+
+CompressedEntryImpl::ReadOperation::ReadOperation()
+    : index(0), offset(0), buf_len(0) {}
+
+CompressedEntryImpl::ReadOperation::ReadOperation(const ReadOperation& other) =
+    default;
+
+CompressedEntryImpl::ReadOperation::~ReadOperation() {}
+
+CompressedEntryImpl::RewriteOperation::RewriteOperation()
+    : index(0), data_len(0) {}
+
+CompressedEntryImpl::RewriteOperation::RewriteOperation(
+    const RewriteOperation& other) = default;
+
+CompressedEntryImpl::RewriteOperation::~RewriteOperation() {}
+
+CompressedEntryImpl::CompressedEntryImpl(
+    base::WeakPtr<CompressedBackendImpl> backend,
+    const std::string& key,
+    Entry* wrapped_entry,
+    uint32_t stream_mask)
+    : backend_(backend),
+      entry_(wrapped_entry),
+      stream_mask_(stream_mask),
+      key_(key),
+      state_(STATE_UNINITIALIZED),
+      open_count_(0),
+      header_buffer_(new net::IOBufferWithSize(kHeaderSize)),
+      reading_(false),
+      rewriting_(false) {
+  for (int i = 0; i < kCompressedEntryStreamCount; ++i)
+    streams_[i].reset(new Stream());
+}
+
+int CompressedEntryImpl::Open(Entry** out_entry,
+                              const CompletionCallback& callback) {
+  ++open_count_;
+  if (state_ == STATE_READY) {
+    *out_entry = this;
+    return net::OK;
+  }
+  if (state_ == STATE_UNINITIALIZED) {
+    state_ = STATE_READING_HEADERS;
+    int rv = ReadHeaders(0);
+    if (rv == net::OK) {
+      state_ = STATE_READY;
+      *out_entry = this;
+      return net::OK;
+    }
+    if (rv != net::ERR_IO_PENDING) {
+      FailOpen();
+      return rv;
+    }
+  }
+  pending_opens_.push_back(PendingOpen(out_entry, callback));
+  return net::ERR_IO_PENDING;
+}
+
+void CompressedEntryImpl::Doom() {
+  entry_->Doom();
+}
+
+void CompressedEntryImpl::Close() {
+  DCHECK_GT(open_count_, 0);
+  if (--open_count_ > 0) {
+    entry_->Close();
+    return;
+  }
+  MaybeFinishClose();
+}
+
+std::string CompressedEntryImpl::GetKey() const {
+  return key_;
+}
+
+base::Time CompressedEntryImpl::GetLastUsed() const {
+  return entry_->GetLastUsed();
+}
+
+base::Time CompressedEntryImpl::GetLastModified() const {
+  return entry_->GetLastModified();
+}
+
+int32_t CompressedEntryImpl::GetDataSize(int index) const {
+  if (!IsCompressedStream(index))
+    return entry_->GetDataSize(index);
+  return streams_[index]->data_size;
+}
+
+int CompressedEntryImpl::ReadData(int index,
+                                  int offset,
+                                  IOBuffer* buf,
+                                  int buf_len,
+                                  const CompletionCallback& callback) {
+  if (!IsCompressedStream(index))
+    return entry_->ReadData(index, offset, buf, buf_len, callback);
+  if (reading_ || rewriting_) {
+    queued_operations_.push_back(QueuedOperation(
+        base::Bind(&CompressedEntryImpl::ReadStreamData,
+                   base::Unretained(this), index, offset,
+                   base::RetainedRef(buf), buf_len, callback),
+        callback));
+    return net::ERR_IO_PENDING;
+  }
+  return ReadStreamData(index, offset, buf, buf_len, callback);
+}
+
+int CompressedEntryImpl::WriteData(int index,
+                                   int offset,
+                                   IOBuffer* buf,
+                                   int buf_len,
+                                   const CompletionCallback& callback,
+                                   bool truncate) {
+  if (!IsCompressedStream(index))
+    return entry_->WriteData(index, offset, buf, buf_len, callback, truncate);
+  if (reading_ || rewriting_) {
+    queued_operations_.push_back(QueuedOperation(
+        base::Bind(&CompressedEntryImpl::WriteStreamData,
+                   base::Unretained(this), index, offset,
+                   base::RetainedRef(buf), buf_len, callback, truncate),
+        callback));
+    return net::ERR_IO_PENDING;
+  }
+  return WriteStreamData(index, offset, buf, buf_len, callback, truncate);
+}
+
+int CompressedEntryImpl::ReadSparseData(int64_t offset,
+                                        IOBuffer* buf,
+                                        int buf_len,
+                                        const CompletionCallback& callback) {
+  return entry_->ReadSparseData(offset, buf, buf_len, callback);
+}
+
+int CompressedEntryImpl::WriteSparseData(int64_t offset,
+                                         IOBuffer* buf,
+                                         int buf_len,
+                                         const CompletionCallback& callback) {
+  return entry_->WriteSparseData(offset, buf, buf_len, callback);
+}
+
+int CompressedEntryImpl::GetAvailableRange(int64_t offset,
+                                           int len,
+                                           int64_t* start,
+                                           const CompletionCallback& callback) {
+  return entry_->GetAvailableRange(offset, len, start, callback);
+}
+
+bool CompressedEntryImpl::CouldBeSparse() const {
+  return entry_->CouldBeSparse();
+}
+
+void CompressedEntryImpl::CancelSparseIO() {
+  entry_->CancelSparseIO();
+}
+
+int CompressedEntryImpl::ReadyForSparseIO(const CompletionCallback& callback) {
+  return entry_->ReadyForSparseIO(callback);
+}
+
+CompressedEntryImpl::~CompressedEntryImpl() {}
+
+bool CompressedEntryImpl::IsCompressedStream(int index) const {
+  return index >= 0 && index < kCompressedEntryStreamCount &&
+         (stream_mask_ & (1 << index));
+}
+
+int CompressedEntryImpl::ReadHeaders(int index) {
+  for (; index < kCompressedEntryStreamCount; ++index) {
+    if (!IsCompressedStream(index) || !entry_->GetDataSize(index))
+      continue;
+    int rv = entry_->ReadData(
+        index, 0, header_buffer_.get(), kHeaderSize,
+        base::Bind(&CompressedEntryImpl::OnHeaderRead, base::Unretained(this),
+                   index));
+    if (rv == net::ERR_IO_PENDING)
+      return rv;
+    rv = ParseHeader(index, rv);
+    if (rv != net::OK)
+      return rv;
+  }
+  return net::OK;
+}
+
+void CompressedEntryImpl::OnHeaderRead(int index, int result) {
+  int rv = ParseHeader(index, result);
+  if (rv == net::OK)
+    rv = ReadHeaders(index + 1);
+  if (rv != net::ERR_IO_PENDING)
+    DidReadHeaders(rv);
+}
+
+int CompressedEntryImpl::ParseHeader(int index, int result) {
+  if (result != kHeaderSize)
+    return result < 0 ? result : net::ERR_FAILED;
+  CompressedStreamHeader header;
+  memcpy(&header, header_buffer_->data(), kHeaderSize);
+  Stream* stream = streams_[index].get();
+  const int wrapped_size = entry_->GetDataSize(index);
+  if (header.magic_number != kCompressedStreamMagicNumber)
+    return net::ERR_FAILED;
+  if (header.mode == MODE_STORED) {
+    stream->mode = MODE_STORED;
+    stream->stored_size = wrapped_size - kHeaderSize;
+    stream->data_size = stream->stored_size;
+    return net::OK;
+  }
+  if (header.mode != MODE_DEFLATED || header.data_size < 0 ||
+      header.stored_size < 0 || header.restart_point_count < 0 ||
+      kHeaderSize + static_cast<int64_t>(header.stored_size) +
+              static_cast<int64_t>(header.restart_point_count) *
+                  kRestartPointSize !=
+          wrapped_size) {
+    return net::ERR_FAILED;
+  }
+  stream->mode = MODE_DEFLATED;
+  stream->data_size = header.data_size;
+  stream->stored_size = header.stored_size;
+  if (!header.restart_point_count)
+    return net::OK;
+  return ReadRestartPoints(index, header.restart_point_count);
+}
+
+int CompressedEntryImpl::ReadRestartPoints(int index, int count) {
+  scoped_refptr<net::IOBufferWithSize> buffer =
+      new net::IOBufferWithSize(count * kRestartPointSize);
+  int rv = entry_->ReadData(
+      index, kHeaderSize + streams_[index]->stored_size, buffer.get(),
+      buffer->size(),
+      base::Bind(&CompressedEntryImpl::OnRestartPointsRead,
+                 base::Unretained(this), index, buffer));
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return ParseRestartPoints(index, buffer.get(), rv);
+}
+
+void CompressedEntryImpl::OnRestartPointsRead(
+    int index,
+    const scoped_refptr<net::IOBufferWithSize>& buffer,
+    int result) {
+  int rv = ParseRestartPoints(index, buffer.get(), result);
+  if (rv == net::OK)
+    rv = ReadHeaders(index + 1);
+  if (rv != net::ERR_IO_PENDING)
+    DidReadHeaders(rv);
+}
+
+int CompressedEntryImpl::ParseRestartPoints(int index,
+                                            net::IOBufferWithSize* buffer,
+                                            int result) {
+  if (result != buffer->size())
+    return result < 0 ? result : net::ERR_FAILED;
+  Stream* stream = streams_[index].get();
+  RestartPoint previous = stream->GetRestartPoint(0);
+  for (int offset = 0; offset < result; offset += kRestartPointSize) {
+    RestartPoint restart_point;
+    memcpy(&restart_point, buffer->data() + offset, kRestartPointSize);
+    if (restart_point.data_offset <= previous.data_offset ||
+        restart_point.data_offset > stream->data_size ||
+        restart_point.stored_offset <= previous.stored_offset ||
+        restart_point.stored_offset > stream->stored_size) {
+      return net::ERR_FAILED;
+    }
+    stream->restart_points.push_back(restart_point);
+    previous = restart_point;
+  }
+  return net::OK;
+}
+
+void CompressedEntryImpl::DidReadHeaders(int result) {
+  std::vector<PendingOpen> pending_opens;
+  pending_opens.swap(pending_opens_);
+  if (result == net::OK) {
+    state_ = STATE_READY;
+    for (const PendingOpen& pending_open : pending_opens)
+      *pending_open.first = this;
+  } else {
+    FailOpen();
+  }
+  for (const PendingOpen& pending_open : pending_opens)
+    pending_open.second.Run(result);
+}
+
+void CompressedEntryImpl::FailOpen() {
+  DLOG(WARNING) << "Invalid compressed entry " << key_;
+  entry_->Doom();
+  for (; open_count_ > 0; --open_count_)
+    entry_->Close();
+  if (backend_)
+    backend_->OnEntryClosed(entry_);
+  delete this;
+}
+
+void CompressedEntryImpl::MaybeFinishClose() {
+  if (open_count_ > 0 || reading_ || rewriting_)
+    return;
+  DCHECK(queued_operations_.empty());
+  for (int i = 0; i < kCompressedEntryStreamCount; ++i) {
+    if (streams_[i]->header_dirty) {
+      WriteRestartPoints(i);
+      WriteHeader(i, CompletionCallback());
+    }
+  }
+  if (backend_)
+    backend_->OnEntryClosed(entry_);
+  entry_->Close();
+  delete this;
+}
+
+int CompressedEntryImpl::ReadStreamData(int index,
+                                        int offset,
+                                        IOBuffer* buf,
+                                        int buf_len,
+                                        const CompletionCallback& callback) {
+  DCHECK(!reading_);
+  Stream* stream = streams_[index].get();
+  if (offset < 0 || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+  if (offset >= stream->data_size || !buf_len)
+    return 0;
+  buf_len = std::min(buf_len, stream->data_size - offset);
+  if (stream->mode == MODE_STORED) {
+    return entry_->ReadData(index, kHeaderSize + offset, buf, buf_len,
+                            callback);
+  }
+
+  DCHECK_EQ(MODE_DEFLATED, stream->mode);
+  read_operation_.index = index;
+  read_operation_.offset = offset;
+  read_operation_.buf = buf;
+  read_operation_.buf_len = buf_len;
+  read_operation_.callback = callback;
+  int rv = Decode();
+  if (rv == net::ERR_IO_PENDING) {
+    reading_ = true;
+    return rv;
+  }
+  if (rv == net::OK)
+    rv = CopyDecodedData();
+  read_operation_ = ReadOperation();
+  return rv;
+}
+
+int CompressedEntryImpl::WriteStreamData(int index,
+                                         int offset,
+                                         IOBuffer* buf,
+                                         int buf_len,
+                                         const CompletionCallback& callback,
+                                         bool truncate) {
+  DCHECK(!reading_);
+  Stream* stream = streams_[index].get();
+  if (offset < 0 || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+
+  if (offset == 0 && truncate && stream->mode != MODE_EMPTY) {
+    // The stream is written again from the start.
+    streams_[index].reset(new Stream());
+    stream = streams_[index].get();
+    if (!buf_len)
+      return entry_->WriteData(index, 0, nullptr, 0, callback, true);
+  }
+
+  if (stream->mode == MODE_EMPTY) {
+    if (offset == 0 && buf_len > 0)
+      return WriteFirstData(index, buf, buf_len, callback);
+    if (offset == 0)
+      return 0;
+    // Only data written from the start is worth compressing.
+    stream->mode = MODE_STORED;
+    int rv = WriteHeader(index, CompletionCallback());
+    if (rv != kHeaderSize && rv != net::ERR_IO_PENDING)
+      return rv < 0 ? rv : net::ERR_CACHE_WRITE_FAILURE;
+  }
+
+  if (stream->mode == MODE_STORED) {
+    int rv = entry_->WriteData(index, kHeaderSize + offset, buf, buf_len,
+                               callback, truncate);
+    if (truncate)
+      stream->data_size = offset + buf_len;
+    else
+      stream->data_size = std::max(stream->data_size, offset + buf_len);
+    stream->stored_size = stream->data_size;
+    return rv;
+  }
+
+  DCHECK_EQ(MODE_DEFLATED, stream->mode);
+  if (offset != stream->data_size) {
+    // Only appends can be deflated.
+    return RewriteStored(
+        index, base::Bind(&CompressedEntryImpl::WriteStreamData,
+                          base::Unretained(this), index, offset,
+                          base::RetainedRef(buf), buf_len, callback, truncate),
+        callback);
+  }
+  if (!buf_len)
+    return 0;
+  RestartPoint start;
+  start.data_offset = stream->data_size;
+  start.stored_offset = stream->stored_size;
+  if (!stream->deflate_stream) {
+    // Appends a new deflate stream to the one written before the entry was
+    // last closed, which makes a restart point.
+    stream->deflate_stream.reset(new z_stream());
+    if (deflateInit2(stream->deflate_stream.get(), Z_DEFAULT_COMPRESSION,
+                     Z_DEFLATED, -MAX_WBITS, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      stream->deflate_stream.reset();
+      return net::ERR_FAILED;
+    }
+    if (stream->GetRestartPoint(start.data_offset).data_offset !=
+        start.data_offset) {
+      stream->restart_points.push_back(start);
+    }
+  }
+  scoped_refptr<net::IOBufferWithSize> deflated =
+      Deflate(stream->deflate_stream.get(), buf->data(), buf_len, start,
+              &stream->restart_points);
+  int rv = entry_->WriteData(
+      index, kHeaderSize + stream->stored_size, deflated.get(),
+      deflated->size(),
+      base::Bind(&OnStoredDataWritten, callback, deflated->size(), buf_len),
+      true);
+  stream->data_size += buf_len;
+  stream->stored_size += deflated->size();
+  stream->header_dirty = true;
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return GetWriteResult(deflated->size(), buf_len, rv);
+}
+
+int CompressedEntryImpl::WriteFirstData(int index,
+                                        IOBuffer* buf,
+                                        int buf_len,
+                                        const CompletionCallback& callback) {
+  Stream* stream = streams_[index].get();
+  std::unique_ptr<z_stream> deflate_stream(new z_stream());
+  scoped_refptr<net::IOBufferWithSize> deflated;
+  if (deflateInit2(deflate_stream.get(), Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                   -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK) {
+    std::vector<RestartPoint> restart_points;
+    deflated = Deflate(deflate_stream.get(), buf->data(), buf_len,
+                       stream->GetRestartPoint(0), &restart_points);
+    if (static_cast<int64_t>(deflated->size()) * 100 <=
+        static_cast<int64_t>(buf_len) * kMaxDeflatedSizePercent) {
+      stream->deflate_stream = std::move(deflate_stream);
+      // The restart points are written when the entry is closed.
+      stream->restart_points.swap(restart_points);
+      stream->header_dirty = !stream->restart_points.empty();
+    } else {
+      deflateEnd(deflate_stream.get());
+      deflated = nullptr;
+    }
+  } else {
+    deflate_stream.reset();
+  }
+
+  const char* data = deflated ? deflated->data() : buf->data();
+  const int stored_len = deflated ? deflated->size() : buf_len;
+  stream->mode = deflated ? MODE_DEFLATED : MODE_STORED;
+  stream->data_size = buf_len;
+  stream->stored_size = stored_len;
+
+  // The header and the data are written together.
+  CompressedStreamHeader header;
+  header.magic_number = kCompressedStreamMagicNumber;
+  header.mode = stream->mode;
+  header.data_size = buf_len;
+  header.stored_size = stored_len;
+  header.restart_point_count = 0;
+  scoped_refptr<net::IOBufferWithSize> stored =
+      new net::IOBufferWithSize(kHeaderSize + stored_len);
+  memcpy(stored->data(), &header, kHeaderSize);
+  memcpy(stored->data() + kHeaderSize, data, stored_len);
+  int rv = entry_->WriteData(
+      index, 0, stored.get(), stored->size(),
+      base::Bind(&OnStoredDataWritten, callback, stored->size(), buf_len),
+      true);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return GetWriteResult(stored->size(), buf_len, rv);
+}
+
+int CompressedEntryImpl::WriteHeader(int index,
+                                     const CompletionCallback& callback) {
+  Stream* stream = streams_[index].get();
+  CompressedStreamHeader header;
+  header.magic_number = kCompressedStreamMagicNumber;
+  header.mode = stream->mode;
+  header.data_size = stream->data_size;
+  header.stored_size = stream->stored_size;
+  header.restart_point_count =
+      stream->mode == MODE_DEFLATED
+          ? static_cast<int32_t>(stream->restart_points.size())
+          : 0;
+  scoped_refptr<net::IOBufferWithSize> buffer =
+      new net::IOBufferWithSize(kHeaderSize);
+  memcpy(buffer->data(), &header, kHeaderSize);
+  stream->header_dirty = false;
+  return entry_->WriteData(index, 0, buffer.get(), kHeaderSize, callback,
+                           false);
+}
+
+void CompressedEntryImpl::WriteRestartPoints(int index) {
+  const Stream* stream = streams_[index].get();
+  if (stream->mode != MODE_DEFLATED || stream->restart_points.empty())
+    return;
+  scoped_refptr<net::IOBufferWithSize> buffer = new net::IOBufferWithSize(
+      stream->restart_points.size() * kRestartPointSize);
+  memcpy(buffer->data(), stream->restart_points.data(), buffer->size());
+  entry_->WriteData(index, kHeaderSize + stream->stored_size, buffer.get(),
+                    buffer->size(), CompletionCallback(), true);
+}
+
+int CompressedEntryImpl::RewriteStored(int index,
+                                       const base::Callback<int()>& operation,
+                                       const CompletionCallback& callback) {
+  DCHECK(!rewriting_);
+  rewriting_ = true;
+  rewrite_operation_.index = index;
+  rewrite_operation_.data =
+      new net::IOBufferWithSize(streams_[index]->data_size);
+  rewrite_operation_.data_len = 0;
+  rewrite_operation_.operation = operation;
+  rewrite_operation_.callback = callback;
+  int rv = ReadForRewrite();
+  if (rewriting_)
+    return rv;
+  rewrite_operation_ = RewriteOperation();
+  return rv;
+}
+
+int CompressedEntryImpl::ReadForRewrite() {
+  const int data_size = rewrite_operation_.data->size();
+  while (rewrite_operation_.data_len < data_size) {
+    scoped_refptr<net::WrappedIOBuffer> buf = new net::WrappedIOBuffer(
+        rewrite_operation_.data->data() + rewrite_operation_.data_len);
+    int rv = ReadStreamData(
+        rewrite_operation_.index, rewrite_operation_.data_len, buf.get(),
+        data_size - rewrite_operation_.data_len,
+        base::Bind(&CompressedEntryImpl::OnReadForRewrite,
+                   base::Unretained(this)));
+    if (rv == net::ERR_IO_PENDING)
+      return rv;
+    if (rv <= 0)
+      return FinishRewrite(rv < 0 ? rv : net::ERR_CACHE_READ_FAILURE);
+    rewrite_operation_.data_len += rv;
+  }
+  return WriteRewrite();
+}
+
+void CompressedEntryImpl::OnReadForRewrite(int result) {
+  int rv;
+  if (result > 0) {
+    rewrite_operation_.data_len += result;
+    rv = ReadForRewrite();
+  } else {
+    rv = FinishRewrite(result < 0 ? result : net::ERR_CACHE_READ_FAILURE);
+  }
+  if (!rewriting_)
+    OnRewriteDone(rv);
+}
+
+int CompressedEntryImpl::WriteRewrite() {
+  const int index = rewrite_operation_.index;
+  const int data_len = rewrite_operation_.data_len;
+  streams_[index].reset(new Stream());
+  Stream* stream = streams_[index].get();
+  stream->mode = MODE_STORED;
+  stream->data_size = data_len;
+  stream->stored_size = data_len;
+
+  CompressedStreamHeader header;
+  header.magic_number = kCompressedStreamMagicNumber;
+  header.mode = MODE_STORED;
+  header.data_size = data_len;
+  header.stored_size = data_len;
+  header.restart_point_count = 0;
+  scoped_refptr<net::IOBufferWithSize> stored =
+      new net::IOBufferWithSize(kHeaderSize + data_len);
+  memcpy(stored->data(), &header, kHeaderSize);
+  memcpy(stored->data() + kHeaderSize, rewrite_operation_.data->data(),
+         data_len);
+  rewrite_operation_.data = nullptr;
+  int rv = entry_->WriteData(
+      index, 0, stored.get(), stored->size(),
+      base::Bind(&CompressedEntryImpl::OnRewriteWritten,
+                 base::Unretained(this), stored->size()),
+      true);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return DidWriteRewrite(stored->size(), rv);
+}
+
+void CompressedEntryImpl::OnRewriteWritten(int stored_len, int result) {
+  int rv = DidWriteRewrite(stored_len, result);
+  if (!rewriting_)
+    OnRewriteDone(rv);
+}
+
+int CompressedEntryImpl::DidWriteRewrite(int stored_len, int result) {
+  if (result == stored_len)
+    return FinishRewrite(net::OK);
+  // The stream is left half written.
+  entry_->Doom();
+  return FinishRewrite(result < 0 ? result : net::ERR_CACHE_WRITE_FAILURE);
+}
+
+int CompressedEntryImpl::FinishRewrite(int result) {
+  DCHECK(rewriting_);
+  rewriting_ = false;
+  rewrite_operation_.data = nullptr;
+  if (result != net::OK)
+    return result;
+  return rewrite_operation_.operation.Run();
+}
+
+void CompressedEntryImpl::OnRewriteDone(int result) {
+  CompletionCallback callback = rewrite_operation_.callback;
+  rewrite_operation_ = RewriteOperation();
+  RunQueuedOperations();
+  // Last, as the callback may close the entry. If the operation is pending,
+  // it runs the callback itself.
+  if (result != net::ERR_IO_PENDING && !callback.is_null())
+    callback.Run(result);
+}
+
+int CompressedEntryImpl::Decode() {
+  Stream* stream = streams_[read_operation_.index].get();
+  const int offset = read_operation_.offset;
+  while (true) {
+    if (offset >= stream->decoded_offset &&
+        offset < stream->decoded_offset + stream->decoded_len) {
+      return net::OK;
+    }
+    const RestartPoint restart_point = stream->GetRestartPoint(offset);
+    if (!stream->inflate_stream || offset < stream->decoded_offset ||
+        restart_point.data_offset >
+            stream->decoded_offset + stream->decoded_len) {
+      // Decode from the last restart point before |offset|.
+      if (!stream->inflate_stream) {
+        stream->inflate_stream.reset(new z_stream());
+        if (inflateInit2(stream->inflate_stream.get(), -MAX_WBITS) != Z_OK) {
+          stream->inflate_stream.reset();
+          return net::ERR_FAILED;
+        }
+        stream->inflate_input = new net::IOBufferWithSize(kChunkSize);
+        stream->decoded = new net::IOBufferWithSize(kChunkSize);
+      } else {
+        inflateReset(stream->inflate_stream.get());
+      }
+      stream->inflate_stream->avail_in = 0;
+      stream->read_offset = restart_point.stored_offset;
+      stream->decoded_offset = restart_point.data_offset;
+      stream->decoded_len = 0;
+    }
+    if (stream->decoded_len == kChunkSize) {
+      stream->decoded_offset += kChunkSize;
+      stream->decoded_len = 0;
+    }
+
+    z_stream* inflate_stream = stream->inflate_stream.get();
+    // Once all the stored data is read, |inflate_stream| may still hold
+    // decoded data that did not fit in |decoded|.
+    if (!inflate_stream->avail_in &&
+        stream->read_offset < stream->stored_size) {
+      const int len =
+          std::min(kChunkSize, stream->stored_size - stream->read_offset);
+      int rv = entry_->ReadData(
+          read_operation_.index, kHeaderSize + stream->read_offset,
+          stream->inflate_input.get(), len,
+          base::Bind(&CompressedEntryImpl::OnDeflatedDataRead,
+                     base::Unretained(this)));
+      if (rv == net::ERR_IO_PENDING)
+        return rv;
+      rv = DidReadDeflatedData(rv);
+      if (rv != net::OK)
+        return rv;
+    }
+
+    const uInt avail_in = inflate_stream->avail_in;
+    inflate_stream->next_out = reinterpret_cast<Bytef*>(
+        stream->decoded->data() + stream->decoded_len);
+    inflate_stream->avail_out = kChunkSize - stream->decoded_len;
+    int rv = inflate(inflate_stream, Z_SYNC_FLUSH);
+    const int decoded_len =
+        kChunkSize - stream->decoded_len - inflate_stream->avail_out;
+    if ((rv != Z_OK && rv != Z_BUF_ERROR) ||
+        (!decoded_len && inflate_stream->avail_in == avail_in)) {
+      return net::ERR_CACHE_READ_FAILURE;
+    }
+    stream->decoded_len += decoded_len;
+  }
+}
+
+int CompressedEntryImpl::DidReadDeflatedData(int result) {
+  if (result <= 0)
+    return result < 0 ? result : net::ERR_CACHE_READ_FAILURE;
+  Stream* stream = streams_[read_operation_.index].get();
+  stream->inflate_stream->next_in =
+      reinterpret_cast<Bytef*>(stream->inflate_input->data());
+  stream->inflate_stream->avail_in = result;
+  stream->read_offset += result;
+  return net::OK;
+}
+
+void CompressedEntryImpl::OnDeflatedDataRead(int result) {
+  DCHECK(reading_);
+  int rv = DidReadDeflatedData(result);
+  if (rv == net::OK)
+    rv = Decode();
+  if (rv == net::ERR_IO_PENDING)
+    return;
+  if (rv == net::OK)
+    rv = CopyDecodedData();
+  CompletionCallback callback = read_operation_.callback;
+  read_operation_ = ReadOperation();
+  reading_ = false;
+  RunQueuedOperations();
+  // Last, as the callback may close the entry.
+  callback.Run(rv);
+}
+
+int CompressedEntryImpl::CopyDecodedData() {
+  const Stream* stream = streams_[read_operation_.index].get();
+  const int decoded_start = read_operation_.offset - stream->decoded_offset;
+  const int len =
+      std::min(read_operation_.buf_len, stream->decoded_len - decoded_start);
+  memcpy(read_operation_.buf->data(),
+         stream->decoded->data() + decoded_start, len);
+  return len;
+}
+
+void CompressedEntryImpl::RunQueuedOperations() {
+  while (!reading_ && !rewriting_ && !queued_operations_.empty()) {
+    QueuedOperation queued_operation = queued_operations_.front();
+    queued_operations_.pop_front();
+    int rv = queued_operation.operation.Run();
+    if (rv != net::ERR_IO_PENDING && !queued_operation.callback.is_null()) {
+      base::ThreadTaskRunnerHandle::Get()->PostTask(
+          FROM_HERE, base::Bind(queued_operation.callback, rv));
+    }
+  }
+  if (!reading_ && !rewriting_)
+    MaybeFinishClose();
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,269 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_COMPRESSED_COMPRESSED_ENTRY_IMPL_H_
+#define NET_DISK_CACHE_COMPRESSED_COMPRESSED_ENTRY_IMPL_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/wrapping_backend.h"
+
+namespace net {
+class IOBuffer;
+class IOBufferWithSize;
+}
+
+namespace disk_cache {
+
+class CompressedBackendImpl;
+
+// The number of streams of an entry that can be compressed.
+const int kCompressedEntryStreamCount = 3;
+
+// This class implements the Entry interface for CompressedBackendImpl, on top
+// of an entry of the wrapped backend.
+//
+// Each compressed stream of the wrapped entry starts with a header, which
+// tells whether the rest of the stream is the data as is, or the data as a
+// raw deflate stream, and the size of the data. Every write to a deflated
+// stream is flushed to a byte boundary, so that the data written so far can
+// always be read back, and so that a later write can append a new deflate
+// stream after it. Every 64 KB of data, the deflate stream is fully flushed
+// instead, which makes a restart point from which the rest of the stream
+// decodes on its own. The offsets of the restart points follow the deflated
+// data. The header and the restart points are updated when the entry is
+// closed.
+//
+// Reading a deflated stream decompresses it into a window of the last 32 KB
+// decoded, from which reads are served. Reads outside of the window decode
+// from the last restart point before them when that skips data.
+//
+// Only appends are deflated: any other write to a deflated stream first
+// rewrites the stream as is, after which it is stored uncompressed.
+class NET_EXPORT_PRIVATE CompressedEntryImpl final : public WrappingEntry {
+ public:
+  // Wraps |wrapped_entry|, the entry of |key|, compressing the streams that
+  // have their bit set in |stream_mask|.
+  CompressedEntryImpl(base::WeakPtr<CompressedBackendImpl> backend,
+                      const std::string& key,
+                      Entry* wrapped_entry,
+                      uint32_t stream_mask);
+
+  // From WrappingEntry. The handle is returned once the headers of the
+  // streams are read. If the headers are invalid, the wrapped entry is
+  // doomed, and this entry is deleted.
+  int Open(Entry** out_entry, const CompletionCallback& callback) override;
+
+  // From disk_cache::Entry:
+  void Doom() override;
+  void Close() override;
+  std::string GetKey() const override;
+  base::Time GetLastUsed() const override;
+  base::Time GetLastModified() const override;
+  int32_t GetDataSize(int index) const override;
+  int ReadData(int index,
+               int offset,
+               IOBuffer* buf,
+               int buf_len,
+               const CompletionCallback& callback) override;
+  int WriteData(int index,
+                int offset,
+                IOBuffer* buf,
+                int buf_len,
+                const CompletionCallback& callback,
+                bool truncate) override;
+  int ReadSparseData(int64_t offset,
+                     IOBuffer* buf,
+                     int buf_len,
+                     const CompletionCallback& callback) override;
+  int WriteSparseData(int64_t offset,
+                      IOBuffer* buf,
+                      int buf_len,
+                      const CompletionCallback& callback) override;
+  int GetAvailableRange(int64_t offset,
+                        int len,
+                        int64_t* start,
+                        const CompletionCallback& callback) override;
+  bool CouldBeSparse() const override;
+  void CancelSparseIO() override;
+  int ReadyForSparseIO(const CompletionCallback& callback) override;
+
+ private:
+  enum State {
+    STATE_UNINITIALIZED,
+    STATE_READING_HEADERS,
+    STATE_READY,
+  };
+
+  // How the data of a stream is stored.
+  enum Mode {
+    MODE_EMPTY,
+    MODE_STORED,
+    MODE_DEFLATED,
+  };
+
+  struct Stream;
+
+  // A read or write waiting for a read of a deflated stream, or for a
+  // rewrite, to complete.
+  struct QueuedOperation {
+    QueuedOperation(const base::Callback<int()>& operation,
+                    const CompletionCallback& callback);
+    QueuedOperation(const QueuedOperation& other);
+    ~QueuedOperation();
+
+    base::Callback<int()> operation;
+    CompletionCallback callback;
+  };
+
+  // The read of a deflated stream in progress.
+  struct ReadOperation {
+    ReadOperation();
+    ReadOperation(const ReadOperation& other);
+    ~ReadOperation();
+
+    int index;
+    int offset;
+    scoped_refptr<IOBuffer> buf;
+    int buf_len;
+    CompletionCallback callback;
+  };
+
+  // The rewrite of a deflated stream as is, before |operation|, the write
+  // which needs it. |callback| is the callback of |operation|.
+  struct RewriteOperation {
+    RewriteOperation();
+    RewriteOperation(const RewriteOperation& other);
+    ~RewriteOperation();
+
+    int index;
+    // The data of the stream, read into the first |data_len| bytes.
+    scoped_refptr<net::IOBufferWithSize> data;
+    int data_len;
+    base::Callback<int()> operation;
+    CompletionCallback callback;
+  };
+
+  using PendingOpen = std::pair<Entry**, CompletionCallback>;
+
+  ~CompressedEntryImpl() override;
+
+  bool IsCompressedStream(int index) const;
+
+  // Reads the headers of the streams from |index| on. Returns a net error
+  // code.
+  int ReadHeaders(int index);
+  void OnHeaderRead(int index, int result);
+  int ParseHeader(int index, int result);
+  int ReadRestartPoints(int index, int count);
+  void OnRestartPointsRead(int index,
+                           const scoped_refptr<net::IOBufferWithSize>& buffer,
+                           int result);
+  int ParseRestartPoints(int index, net::IOBufferWithSize* buffer, int result);
+  void DidReadHeaders(int result);
+
+  // Closes all the handles to the wrapped entry after the headers could not
+  // be read, and deletes this entry.
+  void FailOpen();
+
+  // Deletes this entry once its last handle is closed and no operation is in
+  // progress, after updating the headers of the streams.
+  void MaybeFinishClose();
+
+  // Reads and writes of compressed streams.
+  int ReadStreamData(int index,
+                     int offset,
+                     IOBuffer* buf,
+                     int buf_len,
+                     const CompletionCallback& callback);
+  int WriteStreamData(int index,
+                      int offset,
+                      IOBuffer* buf,
+                      int buf_len,
+                      const CompletionCallback& callback,
+                      bool truncate);
+
+  // Writes |buf_len| bytes of |buf| at the start of the empty stream |index|,
+  // deciding whether to store them deflated.
+  int WriteFirstData(int index,
+                     IOBuffer* buf,
+                     int buf_len,
+                     const CompletionCallback& callback);
+
+  // Writes the header of stream |index|, with |callback| if it is not null.
+  int WriteHeader(int index, const CompletionCallback& callback);
+
+  // Writes the restart points of stream |index| after its deflated data.
+  void WriteRestartPoints(int index);
+
+  // Rewrites the deflated stream |index| as is, then runs |operation|.
+  // Returns the result of |operation|, which is passed to |callback| instead
+  // if the rewrite does not complete synchronously.
+  int RewriteStored(int index,
+                    const base::Callback<int()>& operation,
+                    const CompletionCallback& callback);
+  int ReadForRewrite();
+  void OnReadForRewrite(int result);
+  int WriteRewrite();
+  void OnRewriteWritten(int stored_len, int result);
+  int DidWriteRewrite(int stored_len, int result);
+  // Ends |rewrite_operation_| with |result|, running its operation if the
+  // rewrite succeeded.
+  int FinishRewrite(int result);
+  void OnRewriteDone(int result);
+
+  // Decompresses the stream of |read_operation_| until its offset is in the
+  // decoded window. Returns a net error code.
+  int Decode();
+  int DidReadDeflatedData(int result);
+  void OnDeflatedDataRead(int result);
+
+  // Copies the decoded data of |read_operation_| to its buffer, and returns
+  // the number of bytes copied.
+  int CopyDecodedData();
+
+  // Runs the operations queued while a read of a deflated stream, or a
+  // rewrite, was in progress.
+  void RunQueuedOperations();
+
+  base::WeakPtr<CompressedBackendImpl> backend_;
+  Entry* const entry_;
+  const uint32_t stream_mask_;
+  const std::string key_;
+
+  State state_;
+  int open_count_;
+
+  std::unique_ptr<Stream> streams_[kCompressedEntryStreamCount];
+  scoped_refptr<net::IOBufferWithSize> header_buffer_;
+  std::vector<PendingOpen> pending_opens_;
+
+  // True while |read_operation_| is in progress, during which other
+  // operations are queued in |queued_operations_|.
+  bool reading_;
+  ReadOperation read_operation_;
+  // True while |rewrite_operation_| is in progress, during which other
+  // operations are queued as well.
+  bool rewriting_;
+  RewriteOperation rewrite_operation_;
+  std::deque<QueuedOperation> queued_operations_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompressedEntryImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_COMPRESSED_COMPRESSED_ENTRY_IMPL_H_
@@ -0,0 +1,268 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/dedup/dedup_backend_impl.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/rand_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/dedup/dedup_blob.h"
+#include "net/disk_cache/dedup/dedup_entry_impl.h"
+
+namespace disk_cache {
+
+namespace {
+
+// Prefixes the keys of the entries of the wrapped backend that store entries.
+// The keys of the HTTP cache never start with it, nor do those of blobs.
+const char kWrappedKeyPrefix[] = "dedup/";
+
+}  // namespace
+
+const base::Feature kDiskCacheDeduplication{"DiskCacheDeduplication",
+                                            base::FEATURE_DISABLED_BY_DEFAULT};
+
+// Dooms the entries last used between two times like DoomEntry() does, so
+// that they unlink their blobs, which are doomed with their last link. Finds
+// the entries first, and then dooms them.
+class DedupBackendImpl::RangeDoomer {
+ public:
+  RangeDoomer(base::WeakPtr<DedupBackendImpl> backend,
+              base::Time initial_time,
+              base::Time end_time,
+              const CompletionCallback& callback)
+      : backend_(backend),
+        initial_time_(initial_time),
+        end_time_(end_time),
+        callback_(callback),
+        entry_(nullptr) {}
+
+  // Returns a net error code. If it is ERR_IO_PENDING, the doomer runs the
+  // callback, and deletes itself, once done.
+  int Start() {
+    iterator_ = backend_->wrapped_backend()->CreateIterator();
+    return OpenNextEntry();
+  }
+
+ private:
+  int OpenNextEntry() {
+    while (true) {
+      int rv = iterator_->OpenNextEntry(
+          &entry_,
+          base::Bind(&RangeDoomer::OnEntryOpened, base::Unretained(this)));
+      if (rv == net::ERR_IO_PENDING)
+        return rv;
+      if (rv != net::OK)
+        return DoomNextEntry();
+      CheckEntry();
+    }
+  }
+
+  void OnEntryOpened(int result) {
+    int rv;
+    if (result == net::OK) {
+      CheckEntry();
+      rv = OpenNextEntry();
+    } else {
+      rv = DoomNextEntry();
+    }
+    if (rv != net::ERR_IO_PENDING)
+      Finish(rv);
+  }
+
+  // Keeps the key of |entry_| if it stores an entry in the range. Blobs are
+  // left out.
+  void CheckEntry() {
+    std::string key;
+    if (backend_ &&
+        backend_->GetKeyFromWrappedKey(entry_->GetKey(), &key) &&
+        entry_->GetLastUsed() >= initial_time_ &&
+        entry_->GetLastUsed() < end_time_) {
+      keys_.push_back(key);
+    }
+    entry_->Close();
+    entry_ = nullptr;
+  }
+
+  int DoomNextEntry() {
+    iterator_.reset();
+    while (!keys_.empty()) {
+      if (!backend_)
+        return net::ERR_FAILED;
+      const std::string key = keys_.back();
+      keys_.pop_back();
+      // The entry may be gone since, which is not an error.
+      int rv = backend_->DoomEntry(
+          key,
+          base::Bind(&RangeDoomer::OnEntryDoomed, base::Unretained(this)));
+      if (rv == net::ERR_IO_PENDING)
+        return rv;
+    }
+    return net::OK;
+  }
+
+  void OnEntryDoomed(int result) {
+    int rv = DoomNextEntry();
+    if (rv != net::ERR_IO_PENDING)
+      Finish(rv);
+  }
+
+  void Finish(int result) {
+    CompletionCallback callback = callback_;
+    delete this;
+    callback.Run(result);
+  }
+
+  base::WeakPtr<DedupBackendImpl> backend_;
+  const base::Time initial_time_;
+  const base::Time end_time_;
+  const CompletionCallback callback_;
+
+  std::unique_ptr<Backend::Iterator> iterator_;
+  Entry* entry_;
+  std::vector<std::string> keys_;
+
+  DISALLOW_COPY_AND_ASSIGN(RangeDoomer);
+};
+
+DedupBackendImpl::DedupBackendImpl(std::unique_ptr<Backend> backend)
+    : WrappingBackend(std::move(backend), kWrappedKeyPrefix),
+      deduplicated_bytes_(0),
+      weak_factory_(this) {}
+
+DedupBackendImpl::~DedupBackendImpl() {
+  // The blobs whose links are checked outlive the backend, but their entries
+  // must not outlive the wrapped backend.
+  for (const auto& it : active_blobs_)
+    it.second->CloseEntry();
+}
+
+scoped_refptr<DedupBlob> DedupBackendImpl::GetBlob(uint64_t id) {
+  DedupBlob*& blob = active_blobs_[id];
+  if (!blob)
+    blob = new DedupBlob(weak_factory_.GetWeakPtr(), id);
+  return blob;
+}
+
+scoped_refptr<DedupBlob> DedupBackendImpl::NewBlob() {
+  uint64_t id;
+  do {
+    id = base::RandUint64();
+  } while (active_blobs_.count(id) || stored_blobs_.count(id));
+  return GetBlob(id);
+}
+
+bool DedupBackendImpl::FindBlob(const net::SHA256HashValue& hash,
+                                uint64_t* id) const {
+  auto it = blob_ids_.find(hash);
+  if (it == blob_ids_.end())
+    return false;
+  *id = it->second;
+  return true;
+}
+
+void DedupBackendImpl::OnBlobSealed(const net::SHA256HashValue& hash,
+                                    uint64_t id) {
+  blob_ids_[hash] = id;
+}
+
+void DedupBackendImpl::OnBlobUnsealed(const net::SHA256HashValue& hash,
+                                      uint64_t id) {
+  auto it = blob_ids_.find(hash);
+  if (it != blob_ids_.end() && it->second == id)
+    blob_ids_.erase(it);
+}
+
+void DedupBackendImpl::OnBlobStored(uint64_t id) {
+  stored_blobs_.insert(id);
+}
+
+void DedupBackendImpl::OnBlobDoomed(uint64_t id) {
+  stored_blobs_.erase(id);
+}
+
+void DedupBackendImpl::OnBlobClosed(uint64_t id) {
+  active_blobs_.erase(id);
+}
+
+void DedupBackendImpl::OnBodyDeduplicated(int size) {
+  deduplicated_bytes_ += size;
+}
+
+int32_t DedupBackendImpl::GetEntryCount() const {
+  // Blobs stored before the backend was created are only left out once they
+  // are opened.
+  return std::max(0, WrappingBackend::GetEntryCount() -
+                         static_cast<int32_t>(stored_blobs_.size()));
+}
+
+int DedupBackendImpl::DoomEntry(const std::string& key,
+                                const CompletionCallback& callback) {
+  // The entry is opened to unlink its body from its blob.
+  Entry** entry = new Entry*(nullptr);
+  int rv = OpenEntry(
+      key, entry,
+      base::Bind(&DedupBackendImpl::OnEntryOpenedForDoom,
+                 weak_factory_.GetWeakPtr(), base::Owned(entry), callback));
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return DoomOpenedEntry(*entry, rv);
+}
+
+int DedupBackendImpl::DoomAllEntries(const CompletionCallback& callback) {
+  blob_ids_.clear();
+  stored_blobs_.clear();
+  return WrappingBackend::DoomAllEntries(callback);
+}
+
+int DedupBackendImpl::DoomEntriesBetween(base::Time initial_time,
+                                         base::Time end_time,
+                                         const CompletionCallback& callback) {
+  if (end_time.is_null())
+    end_time = base::Time::Max();
+  std::unique_ptr<RangeDoomer> doomer(new RangeDoomer(
+      weak_factory_.GetWeakPtr(), initial_time, end_time, callback));
+  int rv = doomer->Start();
+  if (rv == net::ERR_IO_PENDING)
+    ignore_result(doomer.release());
+  return rv;
+}
+
+int DedupBackendImpl::DoomEntriesSince(base::Time initial_time,
+                                       const CompletionCallback& callback) {
+  return DoomEntriesBetween(initial_time, base::Time::Max(), callback);
+}
+
+void DedupBackendImpl::GetStats(base::StringPairs* stats) {
+  WrappingBackend::GetStats(stats);
+  stats->push_back(std::make_pair("Deduplicated bytes",
+                                  base::Int64ToString(deduplicated_bytes_)));
+}
+
+WrappingEntry* DedupBackendImpl::NewEntry(const std::string& key,
+                                          Entry* wrapped_entry) {
+  return new DedupEntryImpl(weak_factory_.GetWeakPtr(), key, wrapped_entry);
+}
+
+int DedupBackendImpl::DoomOpenedEntry(Entry* entry, int result) {
+  if (result != net::OK)
+    return result;
+  entry->Doom();
+  entry->Close();
+  return net::OK;
+}
+
+void DedupBackendImpl::OnEntryOpenedForDoom(Entry** entry,
+                                            const CompletionCallback& callback,
+                                            int result) {
+  callback.Run(DoomOpenedEntry(*entry, result));
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,135 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_DEDUP_DEDUP_BACKEND_IMPL_H_
+#define NET_DISK_CACHE_DEDUP_DEDUP_BACKEND_IMPL_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "base/feature_list.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "net/base/hash_value.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/wrapping_backend.h"
+
+namespace disk_cache {
+
+class DedupBlob;
+
+// Makes CreateCacheBackend() store identical bodies of disk cache entries
+// once, with a DedupBackendImpl.
+NET_EXPORT_PRIVATE extern const base::Feature kDiskCacheDeduplication;
+
+// This class implements the Backend interface on top of another backend,
+// storing identical bodies (stream 1) of its entries once.
+//
+// A body of at least kMinDedupBodySize bytes is written to a DedupBlob, an
+// entry of the wrapped backend of its own, and hashed as it is written. When
+// the entry is closed, its body is looked up by hash: if another entry has
+// the same body, the entry links to the blob of that body, and its own blob is
+// doomed; otherwise its blob is sealed, for later entries to link to. Smaller
+// bodies are stored in their entry, as are bodies not written in order.
+//
+// Each blob counts once towards the size of the wrapped backend, which thus
+// evicts entries by the space they really take. Blobs are evicted like other
+// entries, but are read whenever an entry linking to them is, so they stay as
+// long as their most used entry. An entry whose blob is gone fails to open,
+// and is doomed. Blobs keep the keys of the entries linking to them, and are
+// doomed when their last link is removed. The wrapped backend evicts entries
+// without removing their links: those are found, and removed, when another
+// link of their blob is. A blob whose entries are all evicted is left for
+// eviction.
+//
+// The hashes of the sealed blobs are kept in memory, so that bodies only
+// match those stored since the backend was created, or read since.
+class NET_EXPORT_PRIVATE DedupBackendImpl final : public WrappingBackend {
+ public:
+  explicit DedupBackendImpl(std::unique_ptr<Backend> backend);
+  ~DedupBackendImpl() override;
+
+  // The size of the bodies which were not stored, as they linked to the blob
+  // of an identical body.
+  int64_t deduplicated_bytes() const { return deduplicated_bytes_; }
+
+  // Returns the DedupBlob for blob |id|, or for a new blob.
+  scoped_refptr<DedupBlob> GetBlob(uint64_t id);
+  scoped_refptr<DedupBlob> NewBlob();
+
+  // Returns whether a sealed blob holds a body hashing to |hash|, and if so
+  // returns its id to |id|.
+  bool FindBlob(const net::SHA256HashValue& hash, uint64_t* id) const;
+
+  // Called by DedupBlob when it is sealed, unsealed or doomed.
+  void OnBlobSealed(const net::SHA256HashValue& hash, uint64_t id);
+  void OnBlobUnsealed(const net::SHA256HashValue& hash, uint64_t id);
+
+  // Called by DedupBlob when its entry is created or opened, and when it is
+  // doomed or found missing.
+  void OnBlobStored(uint64_t id);
+  void OnBlobDoomed(uint64_t id);
+
+  // Called by DedupBlob when it is deleted.
+  void OnBlobClosed(uint64_t id);
+
+  // Called by DedupEntryImpl when it links to the blob of an identical body
+  // of |size| bytes.
+  void OnBodyDeduplicated(int size);
+
+  // Backend implementation.
+  int32_t GetEntryCount() const override;
+  int DoomEntry(const std::string& key,
+                const CompletionCallback& callback) override;
+  int DoomAllEntries(const CompletionCallback& callback) override;
+  int DoomEntriesBetween(base::Time initial_time,
+                         base::Time end_time,
+                         const CompletionCallback& callback) override;
+  int DoomEntriesSince(base::Time initial_time,
+                       const CompletionCallback& callback) override;
+  void GetStats(base::StringPairs* stats) override;
+
+ private:
+  class RangeDoomer;
+
+  // WrappingBackend implementation.
+  WrappingEntry* NewEntry(const std::string& key,
+                          Entry* wrapped_entry) override;
+
+  // Dooms the entry opened for DoomEntry(), so that it unlinks its blob.
+  int DoomOpenedEntry(Entry* entry, int result);
+  void OnEntryOpenedForDoom(Entry** entry,
+                            const CompletionCallback& callback,
+                            int result);
+
+  // The blobs in use.
+  std::unordered_map<uint64_t, DedupBlob*> active_blobs_;
+
+  // The ids of the sealed blobs, by the hash of their body.
+  std::map<net::SHA256HashValue, uint64_t, net::SHA256HashValueLessThan>
+      blob_ids_;
+
+  // The ids of the blobs created or opened since the backend was created, and
+  // not doomed since, which GetEntryCount() leaves out.
+  std::unordered_set<uint64_t> stored_blobs_;
+
+  int64_t deduplicated_bytes_;
+
+  base::WeakPtrFactory<DedupBackendImpl> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(DedupBackendImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_DEDUP_DEDUP_BACKEND_IMPL_H_
@@ -0,0 +1,341 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/dedup/dedup_backend_impl.h"
+
+#include <memory>
+#include <string>
+
+#include "base/run_loop.h"
+#include "base/time/time.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/disk_cache/dedup/dedup_blob.h"
+#include "net/disk_cache/dedup/dedup_entry_impl.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/disk_cache_test_base.h"
+#include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+const int kBodyIndex = 1;
+
+std::string MakeBody(int size) {
+  std::string data(size, '\0');
+  CacheTestFillBuffer(&data[0], size, false);
+  return data;
+}
+
+class DedupBackendTest : public DiskCacheTestWithCache {
+ protected:
+  void InitDedupCache() {
+    SetSimpleCacheMode();
+    SetDedupCacheMode();
+    InitCache();
+  }
+
+  Backend* wrapped_backend() const {
+    return dedup_cache_impl_->wrapped_backend();
+  }
+
+  Entry* CreateEntry(const std::string& key) {
+    Entry* entry = nullptr;
+    EXPECT_EQ(net::OK, DiskCacheTestWithCache::CreateEntry(key, &entry));
+    return entry;
+  }
+
+  Entry* OpenEntry(const std::string& key) {
+    Entry* entry = nullptr;
+    if (DiskCacheTestWithCache::OpenEntry(key, &entry) != net::OK)
+      return nullptr;
+    return entry;
+  }
+
+  // Dooms the entry of the wrapped backend storing |key|, like its eviction.
+  void EvictEntry(const std::string& key) {
+    net::TestCompletionCallback cb;
+    EXPECT_EQ(net::OK,
+              cb.GetResult(wrapped_backend()->DoomEntry(
+                  dedup_cache_impl_->GetWrappedKey(key), cb.callback())));
+  }
+
+  int WriteBody(Entry* entry,
+                int offset,
+                const std::string& data,
+                bool truncate) {
+    scoped_refptr<net::StringIOBuffer> buffer(new net::StringIOBuffer(data));
+    return WriteData(entry, kBodyIndex, offset, buffer.get(), data.size(),
+                     truncate);
+  }
+
+  std::string ReadBody(Entry* entry) {
+    const int size = entry->GetDataSize(kBodyIndex);
+    scoped_refptr<net::IOBufferWithSize> buffer(
+        new net::IOBufferWithSize(size));
+    int rv = ReadData(entry, kBodyIndex, 0, buffer.get(), size);
+    if (rv < 0)
+      return std::string();
+    return std::string(buffer->data(), rv);
+  }
+
+  // Runs the operations of the simple cache, like the open of the blob that
+  // the body of a closed entry is linked to.
+  void RunUntilIdle() {
+    base::RunLoop().RunUntilIdle();
+    SimpleBackendImpl::FlushWorkerPoolForTesting();
+    base::RunLoop().RunUntilIdle();
+  }
+
+  // Creates entry |key| with |body|, written in chunks of 10000 bytes.
+  void CreateEntryWithBody(const std::string& key, const std::string& body) {
+    Entry* entry = CreateEntry(key);
+    ASSERT_TRUE(entry);
+    for (size_t offset = 0; offset < body.size(); offset += 10000) {
+      const std::string chunk = body.substr(offset, 10000);
+      EXPECT_EQ(static_cast<int>(chunk.size()),
+                WriteBody(entry, offset, chunk, false));
+    }
+    entry->Close();
+    RunUntilIdle();
+  }
+
+  std::string GetBody(const std::string& key) {
+    Entry* entry = OpenEntry(key);
+    if (!entry)
+      return std::string();
+    std::string body = ReadBody(entry);
+    entry->Close();
+    return body;
+  }
+};
+
+}  // namespace
+
+TEST_F(DedupBackendTest, IdenticalBodiesStoredOnce) {
+  InitDedupCache();
+  const std::string kBody = MakeBody(100000);
+  CreateEntryWithBody("http://a/?v=1", kBody);
+  CreateEntryWithBody("http://a/?v=2", kBody);
+  CreateEntryWithBody("http://mirror/a", kBody);
+
+  // Three entries, and a single blob, which is not counted as an entry.
+  EXPECT_EQ(4, wrapped_backend()->GetEntryCount());
+  EXPECT_EQ(3, cache_->GetEntryCount());
+  EXPECT_EQ(2 * static_cast<int64_t>(kBody.size()),
+            dedup_cache_impl_->deduplicated_bytes());
+  EXPECT_LT(CalculateSizeOfAllEntries(), 2 * static_cast<int>(kBody.size()));
+
+  EXPECT_EQ(kBody, GetBody("http://a/?v=1"));
+  EXPECT_EQ(kBody, GetBody("http://a/?v=2"));
+  EXPECT_EQ(kBody, GetBody("http://mirror/a"));
+}
+
+TEST_F(DedupBackendTest, DifferentBodies) {
+  InitDedupCache();
+  const std::string kBody1 = MakeBody(50000);
+  const std::string kBody2 = MakeBody(50000);
+  CreateEntryWithBody("a", kBody1);
+  CreateEntryWithBody("b", kBody2);
+
+  EXPECT_EQ(4, wrapped_backend()->GetEntryCount());
+  EXPECT_EQ(2, cache_->GetEntryCount());
+  EXPECT_EQ(0, dedup_cache_impl_->deduplicated_bytes());
+  EXPECT_EQ(kBody1, GetBody("a"));
+  EXPECT_EQ(kBody2, GetBody("b"));
+}
+
+TEST_F(DedupBackendTest, SmallBodies) {
+  InitDedupCache();
+  const std::string kBody = MakeBody(kMinDedupBodySize - 1);
+  CreateEntryWithBody("a", kBody);
+  CreateEntryWithBody("b", kBody);
+
+  // Stored in their entries.
+  EXPECT_EQ(2, wrapped_backend()->GetEntryCount());
+  EXPECT_EQ(kBody, GetBody("a"));
+  EXPECT_EQ(kBody, GetBody("b"));
+}
+
+TEST_F(DedupBackendTest, ReadWhileWriting) {
+  InitDedupCache();
+  const std::string kBody = MakeBody(30000);
+  Entry* entry = CreateEntry("a");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(1000, WriteBody(entry, 0, kBody.substr(0, 1000), false));
+  EXPECT_EQ(kBody.substr(0, 1000), ReadBody(entry));
+  EXPECT_EQ(29000, WriteBody(entry, 1000, kBody.substr(1000), false));
+  EXPECT_EQ(kBody, ReadBody(entry));
+  entry->Close();
+}
+
+TEST_F(DedupBackendTest, OutOfOrderWrites) {
+  InitDedupCache();
+  const std::string kBody = MakeBody(40000);
+  Entry* entry = CreateEntry("a");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(20000, WriteBody(entry, 20000, kBody.substr(20000), false));
+  EXPECT_EQ(20000, WriteBody(entry, 0, kBody.substr(0, 20000), false));
+  entry->Close();
+
+  // Stored in the entry.
+  EXPECT_EQ(1, wrapped_backend()->GetEntryCount());
+  EXPECT_EQ(kBody, GetBody("a"));
+}
+
+TEST_F(DedupBackendTest, DoomUnlinksBlob) {
+  InitDedupCache();
+  const std::string kBody = MakeBody(50000);
+  CreateEntryWithBody("a", kBody);
+  CreateEntryWithBody("b", kBody);
+  EXPECT_EQ(3, wrapped_backend()->GetEntryCount());
+
+  // Removing the link of "a" checks the link of "b", which is kept open so
+  // that it is checked in a single round trip.
+  Entry* entry = OpenEntry("b");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(net::OK, DoomEntry("a"));
+  RunUntilIdle();
+  EXPECT_EQ(2, wrapped_backend()->GetEntryCount());
+  EXPECT_EQ(kBody, ReadBody(entry));
+  entry->Close();
+
+  // The last link is gone, and so is the blob.
+  EXPECT_EQ(net::OK, DoomEntry("b"));
+  EXPECT_EQ(0, wrapped_backend()->GetEntryCount());
+  EXPECT_EQ(0, cache_->GetEntryCount());
+  EXPECT_EQ(net::ERR_FAILED, DoomEntry("b"));
+}
+
+TEST_F(DedupBackendTest, EvictedLinksRemoved) {
+  InitDedupCache();
+  const std::string kBody = MakeBody(50000);
+  CreateEntryWithBody("a", kBody);
+  CreateEntryWithBody("b", kBody);
+  CreateEntryWithBody("c", kBody);
+  EXPECT_EQ(4, wrapped_backend()->GetEntryCount());
+
+  // The wrapped backend evicts "a", which stays linked to the blob.
+  EvictEntry("a");
+  EXPECT_EQ(3, wrapped_backend()->GetEntryCount());
+
+  // Removing the link of "b" checks the other links; "c" is kept open so that
+  // it is checked in a single round trip.
+  Entry* entry = OpenEntry("c");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(net::OK, DoomEntry("b"));
+  RunUntilIdle();
+  entry->Close();
+  EXPECT_EQ(kBody, GetBody("c"));
+
+  // The link of "c" was the last one.
+  EXPECT_EQ(net::OK, DoomEntry("c"));
+  EXPECT_EQ(0, wrapped_backend()->GetEntryCount());
+}
+
+TEST_F(DedupBackendTest, DoomEntriesSinceKeepsSharedBlob) {
+  // The times of the entries of the memory backend are exact.
+  SetMemoryOnlyMode();
+  SetDedupCacheMode();
+  InitCache();
+  const std::string kBody = MakeBody(50000);
+  CreateEntryWithBody("a", kBody);
+
+  AddDelay();
+  const base::Time middle = base::Time::Now();
+
+  // The blob of "a" is read as the body of "b" is linked to it, after
+  // |middle|.
+  CreateEntryWithBody("b", kBody);
+  EXPECT_EQ(3, wrapped_backend()->GetEntryCount());
+
+  // "b" unlinks the blob, which stays for "a".
+  EXPECT_EQ(net::OK, DoomEntriesSince(middle));
+  EXPECT_EQ(2, wrapped_backend()->GetEntryCount());
+  EXPECT_EQ(1, cache_->GetEntryCount());
+  EXPECT_EQ(kBody, GetBody("a"));
+
+  EXPECT_EQ(net::OK, DoomEntry("a"));
+  EXPECT_EQ(0, wrapped_backend()->GetEntryCount());
+}
+
+TEST_F(DedupBackendTest, RewriteSharedBody) {
+  InitDedupCache();
+  const std::string kBody = MakeBody(50000);
+  const std::string kNewBody = MakeBody(60000);
+  CreateEntryWithBody("a", kBody);
+  CreateEntryWithBody("b", kBody);
+
+  Entry* entry = OpenEntry("b");
+  ASSERT_TRUE(entry);
+  // Only a write from the start is possible.
+  EXPECT_EQ(net::ERR_NOT_IMPLEMENTED,
+            WriteBody(entry, kBody.size(), "more", false));
+  EXPECT_EQ(static_cast<int>(kNewBody.size()),
+            WriteBody(entry, 0, kNewBody, true));
+  entry->Close();
+
+  EXPECT_EQ(kBody, GetBody("a"));
+  EXPECT_EQ(kNewBody, GetBody("b"));
+  EXPECT_EQ(4, wrapped_backend()->GetEntryCount());
+  EXPECT_EQ(2, cache_->GetEntryCount());
+}
+
+TEST_F(DedupBackendTest, AppendToPrivateBody) {
+  InitDedupCache();
+  const std::string kBody = MakeBody(50000);
+  CreateEntryWithBody("a", kBody.substr(0, 30000));
+
+  Entry* entry = OpenEntry("a");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(20000, WriteBody(entry, 30000, kBody.substr(30000), false));
+  entry->Close();
+  EXPECT_EQ(kBody, GetBody("a"));
+
+  // The body changed after it was hashed, so it is not shared.
+  CreateEntryWithBody("b", kBody.substr(0, 30000));
+  EXPECT_EQ(0, dedup_cache_impl_->deduplicated_bytes());
+}
+
+TEST_F(DedupBackendTest, MissingBlob) {
+  InitDedupCache();
+  const std::string kBody = MakeBody(50000);
+  CreateEntryWithBody("a", kBody);
+
+  // Evicts the blob.
+  std::unique_ptr<Backend::Iterator> iter = wrapped_backend()->CreateIterator();
+  Entry* wrapped_entry = nullptr;
+  net::TestCompletionCallback cb;
+  while (cb.GetResult(iter->OpenNextEntry(&wrapped_entry, cb.callback())) ==
+         net::OK) {
+    if (DedupBlob::IsWrappedKey(wrapped_entry->GetKey()))
+      wrapped_entry->Doom();
+    wrapped_entry->Close();
+  }
+
+  EXPECT_FALSE(OpenEntry("a"));
+  EXPECT_EQ(0, wrapped_backend()->GetEntryCount());
+  EXPECT_EQ(0, cache_->GetEntryCount());
+}
+
+TEST_F(DedupBackendTest, Iterator) {
+  InitDedupCache();
+  const std::string kBody = MakeBody(50000);
+  CreateEntryWithBody("a", kBody);
+  EXPECT_EQ(2, wrapped_backend()->GetEntryCount());
+
+  std::unique_ptr<TestIterator> iter = CreateIterator();
+  Entry* entry = nullptr;
+  ASSERT_EQ(net::OK, iter->OpenNextEntry(&entry));
+  EXPECT_EQ("a", entry->GetKey());
+  EXPECT_EQ(kBody, ReadBody(entry));
+  entry->Close();
+  EXPECT_EQ(net::ERR_FAILED, iter->OpenNextEntry(&entry));
+}
+
+}  // namespace disk_cache
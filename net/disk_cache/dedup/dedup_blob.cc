@@ -0,0 +1,318 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/dedup/dedup_blob.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/pickle.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/dedup/dedup_backend_impl.h"
+#include "net/disk_cache/dedup/dedup_entry_impl.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace disk_cache {
+
+namespace {
+
+const char kBlobKeyPrefix[] = "dedup-blob/";
+
+const uint32_t kBlobMagicNumber = 0x626c6f62;
+
+// The streams of the entry of a blob. The header is a pickle of the magic
+// number, whether the blob is sealed, the hash of the body, the number of
+// links, and the key of each linked entry.
+const int kHeaderIndex = 0;
+const int kBodyIndex = 1;
+
+}  // namespace
+
+DedupBlob::DedupBlob(base::WeakPtr<DedupBackendImpl> backend, uint64_t id)
+    : backend_(backend),
+      id_(id),
+      state_(STATE_UNINITIALIZED),
+      entry_(nullptr),
+      sealed_(false),
+      links_checked_(false),
+      linked_entry_(nullptr) {
+  memset(&hash_, 0, sizeof(hash_));
+}
+
+// static
+std::string DedupBlob::GetWrappedKey(uint64_t id) {
+  return base::StringPrintf("%s%016" PRIx64, kBlobKeyPrefix, id);
+}
+
+// static
+bool DedupBlob::IsWrappedKey(const std::string& wrapped_key) {
+  return base::StartsWith(wrapped_key, kBlobKeyPrefix,
+                          base::CompareCase::SENSITIVE);
+}
+
+int DedupBlob::Open(const net::CompletionCallback& callback) {
+  return Start(false, callback);
+}
+
+int DedupBlob::Create(const std::string& key,
+                      const net::CompletionCallback& callback) {
+  DCHECK(links_.empty());
+  links_.insert(key);
+  return Start(true, callback);
+}
+
+int32_t DedupBlob::GetDataSize() const {
+  DCHECK_EQ(STATE_READY, state_);
+  return entry_->GetDataSize(kBodyIndex);
+}
+
+int DedupBlob::ReadData(int offset,
+                        net::IOBuffer* buf,
+                        int buf_len,
+                        const net::CompletionCallback& callback) {
+  DCHECK_EQ(STATE_READY, state_);
+  return entry_->ReadData(kBodyIndex, offset, buf, buf_len, callback);
+}
+
+int DedupBlob::WriteData(int offset,
+                         net::IOBuffer* buf,
+                         int buf_len,
+                         const net::CompletionCallback& callback,
+                         bool truncate) {
+  DCHECK_EQ(STATE_READY, state_);
+  DCHECK(!sealed_);
+  return entry_->WriteData(kBodyIndex, offset, buf, buf_len, callback,
+                           truncate);
+}
+
+void DedupBlob::AddLink(const std::string& key) {
+  DCHECK_EQ(STATE_READY, state_);
+  if (links_.insert(key).second)
+    WriteHeader();
+}
+
+void DedupBlob::RemoveLink(const std::string& key) {
+  DCHECK_EQ(STATE_READY, state_);
+  if (!links_.erase(key))
+    return;
+  if (!links_.empty()) {
+    WriteHeader();
+    if (!links_checked_) {
+      links_checked_ = true;
+      unchecked_links_.assign(links_.begin(), links_.end());
+      // The callback holds a reference to the blob until the links are
+      // checked.
+      base::ThreadTaskRunnerHandle::Get()->PostTask(
+          FROM_HERE, base::Bind(&DedupBlob::CheckNextLink, this));
+    }
+    return;
+  }
+  if (sealed_)
+    Unseal();
+  entry_->Doom();
+  if (backend_)
+    backend_->OnBlobDoomed(id_);
+}
+
+void DedupBlob::Seal(const net::SHA256HashValue& hash) {
+  DCHECK_EQ(STATE_READY, state_);
+  DCHECK(!sealed_);
+  sealed_ = true;
+  hash_ = hash;
+  WriteHeader();
+  if (backend_)
+    backend_->OnBlobSealed(hash_, id_);
+}
+
+void DedupBlob::Unseal() {
+  DCHECK(sealed_);
+  sealed_ = false;
+  if (!links_.empty())
+    WriteHeader();
+  if (backend_)
+    backend_->OnBlobUnsealed(hash_, id_);
+}
+
+void DedupBlob::CloseEntry() {
+  if (entry_)
+    entry_->Close();
+  entry_ = nullptr;
+  state_ = STATE_FAILED;
+}
+
+DedupBlob::~DedupBlob() {
+  if (entry_)
+    entry_->Close();
+  if (backend_)
+    backend_->OnBlobClosed(id_);
+}
+
+int DedupBlob::Start(bool create, const net::CompletionCallback& callback) {
+  switch (state_) {
+    case STATE_READY:
+      return net::OK;
+    case STATE_FAILED:
+      return net::ERR_FAILED;
+    case STATE_OPENING:
+      pending_opens_.push_back(callback);
+      return net::ERR_IO_PENDING;
+    case STATE_UNINITIALIZED:
+      break;
+  }
+  if (!backend_)
+    return net::ERR_FAILED;
+
+  state_ = STATE_OPENING;
+  // The callbacks hold a reference to the blob until they run.
+  const net::CompletionCallback open_callback =
+      base::Bind(&DedupBlob::OnEntryOpened, this, create);
+  Backend* backend = backend_->wrapped_backend();
+  int rv = create
+               ? backend->CreateEntry(GetWrappedKey(id_), &entry_,
+                                      open_callback)
+               : backend->OpenEntry(GetWrappedKey(id_), &entry_,
+                                    open_callback);
+  if (rv != net::ERR_IO_PENDING)
+    OnEntryOpened(create, rv);
+  if (state_ == STATE_OPENING) {
+    pending_opens_.push_back(callback);
+    return net::ERR_IO_PENDING;
+  }
+  return state_ == STATE_READY ? net::OK : net::ERR_FAILED;
+}
+
+void DedupBlob::OnEntryOpened(bool create, int result) {
+  if (result != net::OK) {
+    entry_ = nullptr;
+    if (backend_)
+      backend_->OnBlobDoomed(id_);
+    FinishOpen(result);
+    return;
+  }
+  if (create) {
+    WriteHeader();
+    if (backend_)
+      backend_->OnBlobStored(id_);
+    FinishOpen(net::OK);
+    return;
+  }
+  header_buffer_ =
+      new net::IOBufferWithSize(entry_->GetDataSize(kHeaderIndex));
+  int rv = entry_->ReadData(kHeaderIndex, 0, header_buffer_.get(),
+                            header_buffer_->size(),
+                            base::Bind(&DedupBlob::OnHeaderRead, this));
+  if (rv != net::ERR_IO_PENDING)
+    OnHeaderRead(rv);
+}
+
+void DedupBlob::OnHeaderRead(int result) {
+  int rv = ParseHeader(result);
+  header_buffer_ = nullptr;
+  if (rv != net::OK) {
+    DLOG(WARNING) << "Invalid blob " << GetWrappedKey(id_);
+    entry_->Doom();
+    entry_->Close();
+    entry_ = nullptr;
+    links_.clear();
+    if (backend_)
+      backend_->OnBlobDoomed(id_);
+  } else if (backend_) {
+    backend_->OnBlobStored(id_);
+  }
+  FinishOpen(rv);
+}
+
+int DedupBlob::ParseHeader(int result) {
+  if (result != header_buffer_->size())
+    return result < 0 ? result : net::ERR_FAILED;
+  base::Pickle pickle(header_buffer_->data(), header_buffer_->size());
+  if (!pickle.data())
+    return net::ERR_FAILED;
+  base::PickleIterator pickle_it(pickle);
+  uint32_t magic_number;
+  const char* hash_data;
+  int link_count;
+  if (!pickle_it.ReadUInt32(&magic_number) ||
+      magic_number != kBlobMagicNumber || !pickle_it.ReadBool(&sealed_) ||
+      !pickle_it.ReadBytes(&hash_data, sizeof(hash_.data)) ||
+      !pickle_it.ReadInt(&link_count) || link_count <= 0) {
+    return net::ERR_FAILED;
+  }
+  memcpy(hash_.data, hash_data, sizeof(hash_.data));
+  for (int i = 0; i < link_count; ++i) {
+    std::string key;
+    if (!pickle_it.ReadString(&key))
+      return net::ERR_FAILED;
+    links_.insert(key);
+  }
+  if (sealed_ && backend_)
+    backend_->OnBlobSealed(hash_, id_);
+  return net::OK;
+}
+
+void DedupBlob::FinishOpen(int result) {
+  state_ = result == net::OK ? STATE_READY : STATE_FAILED;
+  std::vector<net::CompletionCallback> pending_opens;
+  pending_opens.swap(pending_opens_);
+  for (const net::CompletionCallback& callback : pending_opens)
+    callback.Run(result);
+}
+
+void DedupBlob::WriteHeader() {
+  base::Pickle pickle;
+  pickle.WriteUInt32(kBlobMagicNumber);
+  pickle.WriteBool(sealed_);
+  pickle.WriteBytes(hash_.data, sizeof(hash_.data));
+  pickle.WriteInt(static_cast<int>(links_.size()));
+  for (const std::string& key : links_)
+    pickle.WriteString(key);
+  scoped_refptr<net::IOBufferWithSize> buffer =
+      new net::IOBufferWithSize(pickle.size());
+  memcpy(buffer->data(), pickle.data(), pickle.size());
+  entry_->WriteData(kHeaderIndex, 0, buffer.get(), buffer->size(),
+                    net::CompletionCallback(), true);
+}
+
+void DedupBlob::CheckNextLink() {
+  while (!unchecked_links_.empty() && !links_.empty() && backend_) {
+    const std::string key = unchecked_links_.back();
+    unchecked_links_.pop_back();
+    if (!links_.count(key))
+      continue;
+    // Opening the entry opens its blob, which is this one if the entry still
+    // links to it.
+    int rv = backend_->OpenEntry(
+        key, &linked_entry_,
+        base::Bind(&DedupBlob::OnLinkedEntryOpened, this, key));
+    if (rv == net::ERR_IO_PENDING)
+      return;
+    CheckLink(key, rv);
+  }
+  unchecked_links_.clear();
+}
+
+void DedupBlob::OnLinkedEntryOpened(const std::string& key, int result) {
+  CheckLink(key, result);
+  CheckNextLink();
+}
+
+void DedupBlob::CheckLink(const std::string& key, int result) {
+  bool linked = false;
+  if (result == net::OK) {
+    linked = static_cast<DedupEntryImpl*>(linked_entry_)->LinksTo(this);
+    linked_entry_->Close();
+  }
+  linked_entry_ = nullptr;
+  if (!linked && links_.count(key))
+    RemoveLink(key);
+}
+
+}  // namespace disk_cache
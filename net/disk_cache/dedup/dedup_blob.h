@@ -0,0 +1,146 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_DEDUP_DEDUP_BLOB_H_
+#define NET_DISK_CACHE_DEDUP_DEDUP_BLOB_H_
+
+#include <stdint.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "net/base/completion_callback.h"
+#include "net/base/hash_value.h"
+#include "net/base/net_export.h"
+
+namespace net {
+class IOBuffer;
+class IOBufferWithSize;
+}
+
+namespace disk_cache {
+
+class DedupBackendImpl;
+class Entry;
+
+// A body stored once for all the entries of a DedupBackendImpl that link to
+// it, in an entry of the wrapped backend. Stream 0 of that entry holds the
+// keys of the entries linking to the blob and the hash of the body, and
+// stream 1 holds the body.
+//
+// A blob is private to the entry that created it until it is sealed, after
+// which its body does not change, and other entries with the same body can
+// link to it. The blob is doomed when its last link is removed.
+//
+// The wrapped backend does not remove the links of the entries it evicts.
+// The first time a link is removed while others remain, the entries of the
+// others are opened, and the links of those that are gone, or that no longer
+// link to the blob, are removed too.
+//
+// There is at most one DedupBlob for each blob at a time; see
+// DedupBackendImpl::GetBlob(). The wrapped entry stays open while the
+// DedupBlob is referenced.
+class NET_EXPORT_PRIVATE DedupBlob : public base::RefCounted<DedupBlob> {
+ public:
+  DedupBlob(base::WeakPtr<DedupBackendImpl> backend, uint64_t id);
+
+  // Returns the key of the entry of the wrapped backend storing blob |id|.
+  static std::string GetWrappedKey(uint64_t id);
+
+  // Returns whether |wrapped_key| is the key of an entry storing a blob.
+  static bool IsWrappedKey(const std::string& wrapped_key);
+
+  uint64_t id() const { return id_; }
+  int32_t link_count() const { return static_cast<int32_t>(links_.size()); }
+  bool sealed() const { return sealed_; }
+  const net::SHA256HashValue& hash() const { return hash_; }
+
+  // Opens the existing blob, or creates a new blob linked to by entry |key|,
+  // in the wrapped backend. Returns a net error code. Opens after the first
+  // one complete with it.
+  int Open(const net::CompletionCallback& callback);
+  int Create(const std::string& key, const net::CompletionCallback& callback);
+
+  // The body, once the blob is open.
+  int32_t GetDataSize() const;
+  int ReadData(int offset,
+               net::IOBuffer* buf,
+               int buf_len,
+               const net::CompletionCallback& callback);
+  int WriteData(int offset,
+                net::IOBuffer* buf,
+                int buf_len,
+                const net::CompletionCallback& callback,
+                bool truncate);
+
+  // Adds and removes the link of entry |key| to the blob. The blob is doomed
+  // when its last link is removed.
+  void AddLink(const std::string& key);
+  void RemoveLink(const std::string& key);
+
+  // Makes the body of the blob, which hashes to |hash|, available to other
+  // entries, or private again.
+  void Seal(const net::SHA256HashValue& hash);
+  void Unseal();
+
+  // Closes the entry of the blob, which fails from then on. Called by the
+  // backend when it is destroyed, as the blob may outlive it.
+  void CloseEntry();
+
+ private:
+  friend class base::RefCounted<DedupBlob>;
+
+  enum State {
+    STATE_UNINITIALIZED,
+    STATE_OPENING,
+    STATE_READY,
+    STATE_FAILED,
+  };
+
+  ~DedupBlob();
+
+  int Start(bool create, const net::CompletionCallback& callback);
+  void OnEntryOpened(bool create, int result);
+  void OnHeaderRead(int result);
+  int ParseHeader(int result);
+
+  // Completes the pending opens with |result|.
+  void FinishOpen(int result);
+
+  // Writes the header of the blob.
+  void WriteHeader();
+
+  // Checks the links in |unchecked_links_| one at a time, and removes those
+  // of the entries that do not link to the blob.
+  void CheckNextLink();
+  void OnLinkedEntryOpened(const std::string& key, int result);
+  void CheckLink(const std::string& key, int result);
+
+  base::WeakPtr<DedupBackendImpl> backend_;
+  const uint64_t id_;
+
+  State state_;
+  Entry* entry_;
+  scoped_refptr<net::IOBufferWithSize> header_buffer_;
+  std::vector<net::CompletionCallback> pending_opens_;
+
+  std::set<std::string> links_;
+  bool sealed_;
+  net::SHA256HashValue hash_;
+
+  // Set once the links are checked, which is done once.
+  bool links_checked_;
+  std::vector<std::string> unchecked_links_;
+  Entry* linked_entry_;
+
+  DISALLOW_COPY_AND_ASSIGN(DedupBlob);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_DEDUP_DEDUP_BLOB_H_
@@ -0,0 +1,564 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/dedup/dedup_entry_impl.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "crypto/secure_hash.h"
+#include "net/base/hash_value.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/dedup/dedup_backend_impl.h"
+#include "net/disk_cache/dedup/dedup_blob.h"
+
+namespace disk_cache {
+
+namespace {
+
+const int kBodyIndex = 1;
+
+const uint32_t kBodyMagicNumber = 0x64647570;
+
+// The header at the start of stream 1 of the wrapped entry, when the body is
+// not empty.
+struct BodyHeader {
+  uint32_t magic_number;
+  uint32_t mode;
+  // The size of the body, when it is linked to a blob.
+  int32_t body_size;
+  uint32_t unused;
+  uint64_t blob_id;
+};
+
+const int kHeaderSize = sizeof(BodyHeader);
+
+void OnBlobDataWritten(const net::CompletionCallback& callback,
+                       int data_len,
+                       int body_len,
+                       int result) {
+  callback.Run(result == data_len ? body_len : result);
+}
+
+}  // namespace
+
+DedupEntryImpl::QueuedOperation::QueuedOperation(
+    const base::Callback<int()>& operation,
+    const CompletionCallback& callback)
+    : operation(operation), callback(callback) {}
+
+DedupEntryImpl::QueuedOperation::QueuedOperation(
+    const QueuedOperation& other) = default;
+
+DedupEntryImpl::QueuedOperation::~QueuedOperation() {}
+
+DedupEntryImpl::DedupEntryImpl(base::WeakPtr<DedupBackendImpl> backend,
+                               const std::string& key,
+                               Entry* wrapped_entry)
+    : backend_(backend),
+      entry_(wrapped_entry),
+      key_(key),
+      state_(STATE_UNINITIALIZED),
+      open_count_(0),
+      doomed_(false),
+      header_buffer_(new net::IOBufferWithSize(kHeaderSize)),
+      body_mode_(BODY_EMPTY),
+      body_size_(0),
+      body_written_(false),
+      waiting_for_blob_(false),
+      weak_factory_(this) {}
+
+bool DedupEntryImpl::LinksTo(const DedupBlob* blob) const {
+  return body_mode_ == BODY_LINKED && blob_.get() == blob;
+}
+
+int DedupEntryImpl::Open(Entry** out_entry,
+                         const CompletionCallback& callback) {
+  ++open_count_;
+  if (state_ == STATE_CLOSING) {
+    // Opened again while the body is linked on close: the handle to the
+    // wrapped entry kept for the close serves this one.
+    entry_->Close();
+    state_ = STATE_READY;
+  }
+  if (state_ == STATE_READY) {
+    *out_entry = this;
+    return net::OK;
+  }
+  if (state_ == STATE_UNINITIALIZED) {
+    state_ = STATE_OPENING;
+    int rv = ReadHeader();
+    if (rv == net::OK) {
+      state_ = STATE_READY;
+      *out_entry = this;
+      return net::OK;
+    }
+    if (rv != net::ERR_IO_PENDING) {
+      FinishOpen(rv);
+      return rv;
+    }
+  }
+  pending_opens_.push_back(PendingOpen(out_entry, callback));
+  return net::ERR_IO_PENDING;
+}
+
+void DedupEntryImpl::Doom() {
+  doomed_ = true;
+  entry_->Doom();
+}
+
+void DedupEntryImpl::Close() {
+  DCHECK_GT(open_count_, 0);
+  if (--open_count_ > 0) {
+    entry_->Close();
+    return;
+  }
+  MaybeFinishClose();
+}
+
+std::string DedupEntryImpl::GetKey() const {
+  return key_;
+}
+
+base::Time DedupEntryImpl::GetLastUsed() const {
+  return entry_->GetLastUsed();
+}
+
+base::Time DedupEntryImpl::GetLastModified() const {
+  return entry_->GetLastModified();
+}
+
+int32_t DedupEntryImpl::GetDataSize(int index) const {
+  if (index != kBodyIndex)
+    return entry_->GetDataSize(index);
+  return body_size_;
+}
+
+int DedupEntryImpl::ReadData(int index,
+                             int offset,
+                             IOBuffer* buf,
+                             int buf_len,
+                             const CompletionCallback& callback) {
+  if (index != kBodyIndex)
+    return entry_->ReadData(index, offset, buf, buf_len, callback);
+  if (waiting_for_blob_) {
+    queued_operations_.push_back(QueuedOperation(
+        base::Bind(&DedupEntryImpl::ReadBody, base::Unretained(this), offset,
+                   base::RetainedRef(buf), buf_len, callback),
+        callback));
+    return net::ERR_IO_PENDING;
+  }
+  return ReadBody(offset, buf, buf_len, callback);
+}
+
+int DedupEntryImpl::WriteData(int index,
+                              int offset,
+                              IOBuffer* buf,
+                              int buf_len,
+                              const CompletionCallback& callback,
+                              bool truncate) {
+  if (index != kBodyIndex)
+    return entry_->WriteData(index, offset, buf, buf_len, callback, truncate);
+  if (waiting_for_blob_) {
+    queued_operations_.push_back(QueuedOperation(
+        base::Bind(&DedupEntryImpl::WriteBody, base::Unretained(this), offset,
+                   base::RetainedRef(buf), buf_len, callback, truncate),
+        callback));
+    return net::ERR_IO_PENDING;
+  }
+  return WriteBody(offset, buf, buf_len, callback, truncate);
+}
+
+int DedupEntryImpl::ReadSparseData(int64_t offset,
+                                   IOBuffer* buf,
+                                   int buf_len,
+                                   const CompletionCallback& callback) {
+  return entry_->ReadSparseData(offset, buf, buf_len, callback);
+}
+
+int DedupEntryImpl::WriteSparseData(int64_t offset,
+                                    IOBuffer* buf,
+                                    int buf_len,
+                                    const CompletionCallback& callback) {
+  return entry_->WriteSparseData(offset, buf, buf_len, callback);
+}
+
+int DedupEntryImpl::GetAvailableRange(int64_t offset,
+                                      int len,
+                                      int64_t* start,
+                                      const CompletionCallback& callback) {
+  return entry_->GetAvailableRange(offset, len, start, callback);
+}
+
+bool DedupEntryImpl::CouldBeSparse() const {
+  return entry_->CouldBeSparse();
+}
+
+void DedupEntryImpl::CancelSparseIO() {
+  entry_->CancelSparseIO();
+}
+
+int DedupEntryImpl::ReadyForSparseIO(const CompletionCallback& callback) {
+  return entry_->ReadyForSparseIO(callback);
+}
+
+DedupEntryImpl::~DedupEntryImpl() {}
+
+int DedupEntryImpl::ReadHeader() {
+  if (!entry_->GetDataSize(kBodyIndex))
+    return net::OK;
+  int rv = entry_->ReadData(
+      kBodyIndex, 0, header_buffer_.get(), kHeaderSize,
+      base::Bind(&DedupEntryImpl::OnHeaderRead, base::Unretained(this)));
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return ParseHeader(rv);
+}
+
+void DedupEntryImpl::OnHeaderRead(int result) {
+  int rv = ParseHeader(result);
+  if (rv != net::ERR_IO_PENDING)
+    FinishOpen(rv);
+}
+
+int DedupEntryImpl::ParseHeader(int result) {
+  if (result != kHeaderSize)
+    return result < 0 ? result : net::ERR_FAILED;
+  BodyHeader header;
+  memcpy(&header, header_buffer_->data(), kHeaderSize);
+  if (header.magic_number != kBodyMagicNumber)
+    return net::ERR_FAILED;
+  const int stored_size = entry_->GetDataSize(kBodyIndex);
+  if (header.mode == BODY_STORED) {
+    body_mode_ = BODY_STORED;
+    body_size_ = stored_size - kHeaderSize;
+    return net::OK;
+  }
+  if (header.mode != BODY_LINKED || header.body_size < 0 ||
+      stored_size != kHeaderSize || !backend_) {
+    return net::ERR_FAILED;
+  }
+
+  body_mode_ = BODY_LINKED;
+  body_size_ = header.body_size;
+  blob_ = backend_->GetBlob(header.blob_id);
+  int rv = blob_->Open(
+      base::Bind(&DedupEntryImpl::OnBlobOpened, base::Unretained(this)));
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  if (rv == net::OK && blob_->GetDataSize() != body_size_)
+    rv = net::ERR_FAILED;
+  return rv;
+}
+
+void DedupEntryImpl::OnBlobOpened(int result) {
+  if (result == net::OK && blob_->GetDataSize() != body_size_)
+    result = net::ERR_FAILED;
+  FinishOpen(result);
+}
+
+void DedupEntryImpl::FinishOpen(int result) {
+  std::vector<PendingOpen> pending_opens;
+  pending_opens.swap(pending_opens_);
+  if (result == net::OK) {
+    state_ = STATE_READY;
+    for (const PendingOpen& pending_open : pending_opens)
+      *pending_open.first = this;
+  } else {
+    // The blob is gone, or the entry is corrupt: the entry is a miss.
+    DLOG(WARNING) << "Invalid deduplicated entry " << key_;
+    blob_ = nullptr;
+    entry_->Doom();
+    for (; open_count_ > 0; --open_count_)
+      entry_->Close();
+    if (backend_)
+      backend_->OnEntryClosed(entry_);
+    delete this;
+  }
+  for (const PendingOpen& pending_open : pending_opens)
+    pending_open.second.Run(result);
+}
+
+int DedupEntryImpl::ReadBody(int offset,
+                             IOBuffer* buf,
+                             int buf_len,
+                             const CompletionCallback& callback) {
+  DCHECK(!waiting_for_blob_);
+  if (offset < 0 || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+  if (offset >= body_size_ || !buf_len)
+    return 0;
+  buf_len = std::min(buf_len, body_size_ - offset);
+  switch (body_mode_) {
+    case BODY_EMPTY:
+      return 0;
+    case BODY_BUFFERED:
+      memcpy(buf->data(), buffer_.data() + offset, buf_len);
+      return buf_len;
+    case BODY_STORED:
+      return entry_->ReadData(kBodyIndex, kHeaderSize + offset, buf, buf_len,
+                              callback);
+    case BODY_LINKED:
+      return blob_->ReadData(offset, buf, buf_len, callback);
+  }
+  NOTREACHED();
+  return net::ERR_FAILED;
+}
+
+int DedupEntryImpl::WriteBody(int offset,
+                              IOBuffer* buf,
+                              int buf_len,
+                              const CompletionCallback& callback,
+                              bool truncate) {
+  DCHECK(!waiting_for_blob_);
+  if (offset < 0 || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+
+  if (offset == 0 && truncate) {
+    ResetBody();
+  } else if (body_mode_ == BODY_LINKED && blob_->sealed()) {
+    // The body of a shared blob cannot change.
+    if (blob_->link_count() > 1)
+      return net::ERR_NOT_IMPLEMENTED;
+    blob_->Unseal();
+  }
+
+  if (body_mode_ == BODY_EMPTY && offset == 0) {
+    if (!buf_len)
+      return 0;
+    body_mode_ = BODY_BUFFERED;
+    hash_ = crypto::SecureHash::Create(crypto::SecureHash::SHA256);
+  }
+
+  if (body_mode_ == BODY_BUFFERED && offset == body_size_) {
+    if (body_size_ + buf_len < kMinDedupBodySize) {
+      buffer_.append(buf->data(), buf_len);
+      hash_->Update(buf->data(), buf_len);
+      body_size_ += buf_len;
+      return buf_len;
+    }
+    return MoveBodyToBlob(buf, buf_len, callback);
+  }
+
+  // Bodies not written in order are stored in the wrapped entry.
+  if (body_mode_ == BODY_EMPTY || body_mode_ == BODY_BUFFERED)
+    StoreBufferedBody();
+
+  int rv;
+  if (body_mode_ == BODY_STORED) {
+    rv = entry_->WriteData(kBodyIndex, kHeaderSize + offset, buf, buf_len,
+                           callback, truncate);
+  } else {
+    DCHECK_EQ(BODY_LINKED, body_mode_);
+    if (hash_ && offset == body_size_)
+      hash_->Update(buf->data(), buf_len);
+    else
+      hash_.reset();
+    rv = blob_->WriteData(offset, buf, buf_len, callback, truncate);
+    body_written_ = true;
+  }
+  if (truncate)
+    body_size_ = offset + buf_len;
+  else
+    body_size_ = std::max(body_size_, offset + buf_len);
+  return rv;
+}
+
+void DedupEntryImpl::ResetBody() {
+  switch (body_mode_) {
+    case BODY_EMPTY:
+      return;
+    case BODY_BUFFERED:
+      buffer_.clear();
+      break;
+    case BODY_LINKED:
+      blob_->RemoveLink(key_);
+      blob_ = nullptr;
+      // Fall through.
+    case BODY_STORED:
+      entry_->WriteData(kBodyIndex, 0, nullptr, 0, CompletionCallback(), true);
+      break;
+  }
+  body_mode_ = BODY_EMPTY;
+  body_size_ = 0;
+  body_written_ = false;
+  hash_.reset();
+}
+
+void DedupEntryImpl::StoreBufferedBody() {
+  BodyHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic_number = kBodyMagicNumber;
+  header.mode = BODY_STORED;
+  scoped_refptr<net::IOBufferWithSize> data =
+      new net::IOBufferWithSize(kHeaderSize + buffer_.size());
+  memcpy(data->data(), &header, kHeaderSize);
+  memcpy(data->data() + kHeaderSize, buffer_.data(), buffer_.size());
+  entry_->WriteData(kBodyIndex, 0, data.get(), data->size(),
+                    CompletionCallback(), true);
+  buffer_.clear();
+  body_mode_ = BODY_STORED;
+  hash_.reset();
+}
+
+int DedupEntryImpl::MoveBodyToBlob(IOBuffer* buf,
+                                   int buf_len,
+                                   const CompletionCallback& callback) {
+  if (!backend_)
+    return net::ERR_FAILED;
+  scoped_refptr<net::IOBufferWithSize> data =
+      new net::IOBufferWithSize(buffer_.size() + buf_len);
+  memcpy(data->data(), buffer_.data(), buffer_.size());
+  memcpy(data->data() + buffer_.size(), buf->data(), buf_len);
+
+  blob_ = backend_->NewBlob();
+  waiting_for_blob_ = true;
+  int rv = blob_->Create(key_, base::Bind(&DedupEntryImpl::OnBlobCreated,
+                                          base::Unretained(this), data,
+                                          buf_len, callback));
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  waiting_for_blob_ = false;
+  return DidCreateBlob(data, buf_len, callback, rv);
+}
+
+int DedupEntryImpl::DidCreateBlob(scoped_refptr<net::IOBufferWithSize> data,
+                                  int buf_len,
+                                  const CompletionCallback& callback,
+                                  int result) {
+  if (result != net::OK) {
+    // The body stays buffered.
+    blob_ = nullptr;
+    return result;
+  }
+  hash_->Update(data->data() + buffer_.size(), buf_len);
+  buffer_.clear();
+  body_mode_ = BODY_LINKED;
+  body_size_ = data->size();
+  body_written_ = true;
+  int rv = blob_->WriteData(
+      0, data.get(), data->size(),
+      base::Bind(&OnBlobDataWritten, callback, data->size(), buf_len), true);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return rv == data->size() ? buf_len : rv;
+}
+
+void DedupEntryImpl::OnBlobCreated(scoped_refptr<net::IOBufferWithSize> data,
+                                   int buf_len,
+                                   const CompletionCallback& callback,
+                                   int result) {
+  waiting_for_blob_ = false;
+  int rv = DidCreateBlob(data, buf_len, callback, result);
+  RunQueuedOperations();
+  // Last, as the callback may close the entry.
+  if (rv != net::ERR_IO_PENDING)
+    callback.Run(rv);
+}
+
+void DedupEntryImpl::WriteHeader() {
+  DCHECK_EQ(BODY_LINKED, body_mode_);
+  BodyHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic_number = kBodyMagicNumber;
+  header.mode = BODY_LINKED;
+  header.body_size = body_size_;
+  header.blob_id = blob_->id();
+  scoped_refptr<net::IOBufferWithSize> buffer =
+      new net::IOBufferWithSize(kHeaderSize);
+  memcpy(buffer->data(), &header, kHeaderSize);
+  entry_->WriteData(kBodyIndex, 0, buffer.get(), kHeaderSize,
+                    CompletionCallback(), true);
+}
+
+void DedupEntryImpl::RunQueuedOperations() {
+  while (!waiting_for_blob_ && !queued_operations_.empty()) {
+    QueuedOperation queued_operation = queued_operations_.front();
+    queued_operations_.pop_front();
+    int rv = queued_operation.operation.Run();
+    if (rv != net::ERR_IO_PENDING && !queued_operation.callback.is_null()) {
+      base::ThreadTaskRunnerHandle::Get()->PostTask(
+          FROM_HERE, base::Bind(queued_operation.callback, rv));
+    }
+  }
+  if (!waiting_for_blob_)
+    MaybeFinishClose();
+}
+
+void DedupEntryImpl::MaybeFinishClose() {
+  if (open_count_ > 0 || waiting_for_blob_ || state_ == STATE_CLOSING)
+    return;
+  DCHECK(queued_operations_.empty());
+  state_ = STATE_CLOSING;
+
+  if (doomed_) {
+    if (body_mode_ == BODY_LINKED)
+      blob_->RemoveLink(key_);
+    body_written_ = false;
+  } else if (body_mode_ == BODY_BUFFERED) {
+    StoreBufferedBody();
+  } else if (body_mode_ == BODY_LINKED && hash_ && backend_ &&
+             blob_->GetDataSize() == body_size_) {
+    net::SHA256HashValue hash;
+    hash_->Finish(hash.data, sizeof(hash.data));
+    hash_.reset();
+    uint64_t identical_blob_id;
+    if (!backend_->FindBlob(hash, &identical_blob_id) ||
+        identical_blob_id == blob_->id()) {
+      blob_->Seal(hash);
+    } else {
+      scoped_refptr<DedupBlob> identical_blob =
+          backend_->GetBlob(identical_blob_id);
+      // The entry may be opened again, and closed, before the blob is open.
+      int rv = identical_blob->Open(
+          base::Bind(&DedupEntryImpl::OnIdenticalBlobOpened,
+                     weak_factory_.GetWeakPtr(), identical_blob, hash));
+      if (rv == net::ERR_IO_PENDING)
+        return;
+      OnIdenticalBlobOpened(identical_blob, hash, rv);
+      return;
+    }
+  }
+  FinishClose();
+}
+
+void DedupEntryImpl::OnIdenticalBlobOpened(
+    scoped_refptr<DedupBlob> identical_blob,
+    const net::SHA256HashValue& hash,
+    int result) {
+  // The entry was opened again, and its body stays in its own blob.
+  if (state_ != STATE_CLOSING)
+    return;
+
+  if (result == net::OK && identical_blob->sealed() &&
+      identical_blob->hash() == hash &&
+      identical_blob->GetDataSize() == body_size_) {
+    identical_blob->AddLink(key_);
+    blob_->RemoveLink(key_);
+    blob_ = identical_blob;
+    if (backend_)
+      backend_->OnBodyDeduplicated(body_size_);
+  } else {
+    blob_->Seal(hash);
+  }
+  FinishClose();
+}
+
+void DedupEntryImpl::FinishClose() {
+  if (body_written_ && body_mode_ == BODY_LINKED)
+    WriteHeader();
+  blob_ = nullptr;
+  if (backend_)
+    backend_->OnEntryClosed(entry_);
+  entry_->Close();
+  delete this;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,219 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_DEDUP_DEDUP_ENTRY_IMPL_H_
+#define NET_DISK_CACHE_DEDUP_DEDUP_ENTRY_IMPL_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "net/base/hash_value.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/wrapping_backend.h"
+
+namespace crypto {
+class SecureHash;
+}
+
+namespace net {
+class IOBuffer;
+class IOBufferWithSize;
+}
+
+namespace disk_cache {
+
+class DedupBackendImpl;
+class DedupBlob;
+
+// Bodies smaller than this are stored in their entry.
+const int kMinDedupBodySize = 16 * 1024;
+
+// This class implements the Entry interface for DedupBackendImpl, on top of an
+// entry of the wrapped backend. Streams 0 and 2, and the sparse data, are
+// those of the wrapped entry.
+//
+// The body (stream 1) is kept in memory until it reaches kMinDedupBodySize
+// bytes, and then written to a new private DedupBlob. Once the last handle to
+// the entry is closed, the body is either written to stream 1 of the wrapped
+// entry if it is small, or linked to: stream 1 of the wrapped entry then holds
+// the id of the blob.
+//
+// A body linked to a blob shared with other entries can only be written again
+// from its start, which unlinks it.
+class NET_EXPORT_PRIVATE DedupEntryImpl final : public WrappingEntry {
+ public:
+  DedupEntryImpl(base::WeakPtr<DedupBackendImpl> backend,
+                 const std::string& key,
+                 Entry* wrapped_entry);
+
+  // Returns whether the body is linked to |blob|.
+  bool LinksTo(const DedupBlob* blob) const;
+
+  // From WrappingEntry. The body is found before the entry is returned: if it
+  // is missing, the wrapped entry is doomed, and this entry is deleted.
+  int Open(Entry** out_entry, const CompletionCallback& callback) override;
+
+  // From disk_cache::Entry:
+  void Doom() override;
+  void Close() override;
+  std::string GetKey() const override;
+  base::Time GetLastUsed() const override;
+  base::Time GetLastModified() const override;
+  int32_t GetDataSize(int index) const override;
+  int ReadData(int index,
+               int offset,
+               IOBuffer* buf,
+               int buf_len,
+               const CompletionCallback& callback) override;
+  int WriteData(int index,
+                int offset,
+                IOBuffer* buf,
+                int buf_len,
+                const CompletionCallback& callback,
+                bool truncate) override;
+  int ReadSparseData(int64_t offset,
+                     IOBuffer* buf,
+                     int buf_len,
+                     const CompletionCallback& callback) override;
+  int WriteSparseData(int64_t offset,
+                      IOBuffer* buf,
+                      int buf_len,
+                      const CompletionCallback& callback) override;
+  int GetAvailableRange(int64_t offset,
+                        int len,
+                        int64_t* start,
+                        const CompletionCallback& callback) override;
+  bool CouldBeSparse() const override;
+  void CancelSparseIO() override;
+  int ReadyForSparseIO(const CompletionCallback& callback) override;
+
+ private:
+  enum State {
+    STATE_UNINITIALIZED,
+    STATE_OPENING,
+    STATE_READY,
+    STATE_CLOSING,
+  };
+
+  // Where the body is.
+  enum BodyMode {
+    BODY_EMPTY,
+    // In |buffer_|, not stored yet.
+    BODY_BUFFERED,
+    // In stream 1 of the wrapped entry, after the header.
+    BODY_STORED,
+    // In |blob_|.
+    BODY_LINKED,
+  };
+
+  // A read or write of the body waiting for |blob_| to be created.
+  struct QueuedOperation {
+    QueuedOperation(const base::Callback<int()>& operation,
+                    const CompletionCallback& callback);
+    QueuedOperation(const QueuedOperation& other);
+    ~QueuedOperation();
+
+    base::Callback<int()> operation;
+    CompletionCallback callback;
+  };
+
+  using PendingOpen = std::pair<Entry**, CompletionCallback>;
+
+  ~DedupEntryImpl() override;
+
+  // Reads the header of the body, then opens the blob it links to.
+  int ReadHeader();
+  void OnHeaderRead(int result);
+  int ParseHeader(int result);
+  void OnBlobOpened(int result);
+  void FinishOpen(int result);
+
+  // Reads and writes of the body.
+  int ReadBody(int offset,
+               IOBuffer* buf,
+               int buf_len,
+               const CompletionCallback& callback);
+  int WriteBody(int offset,
+                IOBuffer* buf,
+                int buf_len,
+                const CompletionCallback& callback,
+                bool truncate);
+
+  // Unlinks the body from its blob, and empties it.
+  void ResetBody();
+
+  // Writes the buffered body to stream 1 of the wrapped entry.
+  void StoreBufferedBody();
+
+  // Moves the buffered body, followed by |buf_len| bytes of |buf|, to a new
+  // blob.
+  int MoveBodyToBlob(IOBuffer* buf,
+                     int buf_len,
+                     const CompletionCallback& callback);
+  int DidCreateBlob(scoped_refptr<net::IOBufferWithSize> data,
+                    int buf_len,
+                    const CompletionCallback& callback,
+                    int result);
+  void OnBlobCreated(scoped_refptr<net::IOBufferWithSize> data,
+                     int buf_len,
+                     const CompletionCallback& callback,
+                     int result);
+
+  // Writes the header of a body linked to |blob_| to the wrapped entry.
+  void WriteHeader();
+
+  // Runs the operations queued while |blob_| was created.
+  void RunQueuedOperations();
+
+  // Once the last handle is closed, links the body to the blob of an
+  // identical body if there is one, and deletes this entry.
+  void MaybeFinishClose();
+  void OnIdenticalBlobOpened(scoped_refptr<DedupBlob> identical_blob,
+                             const net::SHA256HashValue& hash,
+                             int result);
+  void FinishClose();
+
+  base::WeakPtr<DedupBackendImpl> backend_;
+  Entry* const entry_;
+  const std::string key_;
+
+  State state_;
+  int open_count_;
+  bool doomed_;
+  std::vector<PendingOpen> pending_opens_;
+  scoped_refptr<net::IOBufferWithSize> header_buffer_;
+
+  BodyMode body_mode_;
+  int body_size_;
+  std::string buffer_;
+  scoped_refptr<DedupBlob> blob_;
+  // True if the body was written since the entry was opened.
+  bool body_written_;
+
+  // The hash of the body, while it is written in order from its start.
+  std::unique_ptr<crypto::SecureHash> hash_;
+
+  // True while |blob_| is created, during which reads and writes of the body
+  // are queued in |queued_operations_|.
+  bool waiting_for_blob_;
+  std::deque<QueuedOperation> queued_operations_;
+
+  base::WeakPtrFactory<DedupEntryImpl> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(DedupEntryImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_DEDUP_DEDUP_ENTRY_IMPL_H_
@@ -110,6 +110,16 @@ class NET_EXPORT Backend {
   virtual int OpenEntry(const std::string& key, Entry** entry,
                         const CompletionCallback& callback) = 0;
 
+  // Same as OpenEntry(), but also reads ahead up to |read_ahead_size| bytes
+  // at the start of stream 1 in the same operation, so that reading them
+  // afterwards does not wait on more IO. This lets a caller open an entry and
+  // get its headers and the first chunk of its body in a single round trip.
+  // Backends that cannot read ahead behave as OpenEntry().
+  virtual int OpenEntryWithReadAhead(const std::string& key,
+                                     int read_ahead_size,
+                                     Entry** entry,
+                                     const CompletionCallback& callback) = 0;
+
   // Creates a new entry. Upon success, the out param holds a pointer to an
   // Entry object representing the newly created disk cache entry. When the
   // entry pointer is no longer needed, its Close method should be called. The
@@ -162,6 +172,10 @@ class NET_EXPORT Backend {
   // Called whenever an external cache in the system reuses the resource
   // referred to by |key|.
   virtual void OnExternalCacheHit(const std::string& key) = 0;
+
+  // Returns false if the backend can tell right away, without any I/O, that
+  // it has no entry for |key|. Backends that cannot tell return true.
+  virtual bool MayHaveEntry(const std::string& key) const = 0;
 };
 
 // This interface represents an entry in the disk cache.
@@ -2,30 +2,52 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <string.h>
+
+#include <algorithm>
 #include <limits>
+#include <memory>
 #include <string>
+#include <utility>
 
 #include "base/bind.h"
 #include "base/bind_helpers.h"
 #include "base/files/file_enumerator.h"
 #include "base/files/file_path.h"
+#include "base/files/file_util.h"
 #include "base/hash.h"
 #include "base/process/process_metrics.h"
+#include "base/rand_util.h"
 #include "base/run_loop.h"
+#include "base/strings/string_number_conversions.h"
 #include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_log.h"
 #include "base/test/perf_time_logger.h"
+#include "base/test/scoped_feature_list.h"
 #include "base/test/test_file_util.h"
 #include "base/threading/thread.h"
+#include "base/timer/elapsed_timer.h"
 #include "net/base/cache_type.h"
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
 #include "net/base/test_completion_callback.h"
 #include "net/disk_cache/blockfile/backend_impl.h"
 #include "net/disk_cache/blockfile/block_files.h"
+#include "net/disk_cache/compressed/compressed_backend_impl.h"
+#include "net/disk_cache/dedup/dedup_backend_impl.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/disk_cache_test_base.h"
 #include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/disk_cache_trace.h"
+#include "net/disk_cache/disk_cache_trace_replayer.h"
+#include "net/disk_cache/memory/mem_backend_impl.h"
 #include "net/disk_cache/simple/simple_backend_impl.h"
+#include "net/disk_cache/simple/simple_entry_impl.h"
+#include "net/disk_cache/simple/simple_file_io.h"
+#include "net/disk_cache/simple/simple_index.h"
+#include "net/disk_cache/simple/simple_index_file.h"
+#include "net/disk_cache/simple/simple_util.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "testing/platform_test.h"
 
@@ -52,6 +74,54 @@ struct TestEntry {
   int data_len;
 };
 
+// Returns a trace in which requests for a set of popular entries alternate
+// with bursts of requests for entries used only once, as crawlers and bulk
+// downloads produce.
+std::vector<disk_cache::TraceRecord> GenerateOneHitWonderTrace() {
+  const int kPopularEntries = 100;
+  const int kRequests = 4000;
+  const int kBurstLength = 100;
+  std::vector<disk_cache::TraceRecord> trace;
+  srand(0);
+  for (int i = 0; i < kRequests; ++i) {
+    disk_cache::TraceRecord record;
+    record.time = base::TimeDelta::FromMilliseconds(i);
+    if ((i / kBurstLength) % 2) {
+      record.key = base::StringPrintf("once%d", i);
+      record.size = 16 * 1024;
+    } else {
+      // Favor the first popular entries.
+      int popular = rand() % kPopularEntries;
+      popular = popular * popular / kPopularEntries;
+      record.key = base::StringPrintf("popular%d", popular);
+      record.size = (8 + 4 * (popular % 4)) * 1024;
+    }
+    trace.push_back(record);
+  }
+  return trace;
+}
+
+// Returns a trace of requests for a set of scripts and images, each requested
+// with one of several cache busting queries, as if from several pages which
+// embed them with different queries.
+std::vector<disk_cache::TraceRecord> GenerateCacheBustedTrace() {
+  const int kResources = 50;
+  const int kQueries = 10;
+  const int kRequests = 2000;
+  std::vector<disk_cache::TraceRecord> trace;
+  srand(0);
+  for (int i = 0; i < kRequests; ++i) {
+    const int resource = rand() % kResources;
+    disk_cache::TraceRecord record;
+    record.time = base::TimeDelta::FromMilliseconds(i);
+    record.key = base::StringPrintf("http://cdn/resource%d?v=%d", resource,
+                                    rand() % kQueries);
+    record.size = (16 + 16 * (resource % 4)) * 1024;
+    trace.push_back(record);
+  }
+  return trace;
+}
+
 class DiskCachePerfTest : public DiskCacheTestWithCache {
  public:
   DiskCachePerfTest() : saved_fd_limit_(MaybeGetMaxFds()) {
@@ -71,12 +141,17 @@ class DiskCachePerfTest : public DiskCacheTestWithCache {
   };
 
   // Helper methods for constructing tests.
+  void LogEntryThroughput(const char* name, const base::ElapsedTimer& timer);
   bool TimeWrite();
   bool TimeRead(WhatToRead what_to_read, const char* timer_message);
   void ResetAndEvictSystemDiskCache();
+  void ReplayTrace(const std::string& name,
+                   const std::vector<disk_cache::TraceRecord>& trace);
 
   // Complete perf tests.
   void CacheBackendPerformance();
+  void SimpleCacheIndexRestorePerformance(const char* name);
+  void SimpleCacheStreamedWritePerformance(const char* name);
 
   const size_t kFdLimitForCacheTests = 8192;
 
@@ -90,6 +165,15 @@ class DiskCachePerfTest : public DiskCacheTestWithCache {
   const size_t saved_fd_limit_;
 };
 
+void DiskCachePerfTest::LogEntryThroughput(const char* name,
+                                           const base::ElapsedTimer& timer) {
+  const double seconds = timer.Elapsed().InSecondsF();
+  if (seconds > 0) {
+    base::LogPerfResult((std::string(name) + " throughput").c_str(),
+                        kNumEntries / seconds, "entries/s");
+  }
+}
+
 // Creates num_entries on the cache, and writes kHeaderSize bytes of metadata
 // and up to kBodySize of data to each entry.
 bool DiskCachePerfTest::TimeWrite() {
@@ -110,6 +194,7 @@ bool DiskCachePerfTest::TimeWrite() {
   CallbackTest callback(&helper, true);
 
   base::PerfTimeLogger timer("Write disk cache entries");
+  base::ElapsedTimer elapsed_timer;
 
   for (int i = 0; i < kNumEntries; i++) {
     TestEntry entry;
@@ -142,6 +227,7 @@ bool DiskCachePerfTest::TimeWrite() {
 
   helper.WaitUntilCacheIoFinished(expected);
   timer.Done();
+  LogEntryThroughput("Write disk cache entries", elapsed_timer);
 
   return expected == helper.callbacks_called();
 }
@@ -161,6 +247,7 @@ bool DiskCachePerfTest::TimeRead(WhatToRead what_to_read,
   CallbackTest callback(&helper, true);
 
   base::PerfTimeLogger timer(timer_message);
+  base::ElapsedTimer elapsed_timer;
 
   for (int i = 0; i < kNumEntries; i++) {
     disk_cache::Entry* cache_entry;
@@ -191,6 +278,7 @@ bool DiskCachePerfTest::TimeRead(WhatToRead what_to_read,
 
   helper.WaitUntilCacheIoFinished(expected);
   timer.Done();
+  LogEntryThroughput(timer_message, elapsed_timer);
 
   return (expected == helper.callbacks_called());
 }
@@ -233,6 +321,36 @@ void DiskCachePerfTest::ResetAndEvictSystemDiskCache() {
   InitCache();
 }
 
+// Replays |trace| against the cache, and reports the ratios of requests and
+// bytes served from the cache, the operation latencies and the IO sizes.
+void DiskCachePerfTest::ReplayTrace(
+    const std::string& name,
+    const std::vector<disk_cache::TraceRecord>& trace) {
+  disk_cache::TraceReplayResult result;
+  disk_cache::ReplayTrace(cache_.get(), trace,
+                          disk_cache::TRACE_REPLAY_DATA_ANY, &result);
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(0, result.errors);
+
+  base::LogPerfResult((name + " hit ratio").c_str(),
+                      100.0 * result.hits / result.requests, "%");
+  base::LogPerfResult((name + " byte hit ratio").c_str(),
+                      100.0 * result.hit_bytes / result.requested_bytes, "%");
+  base::LogPerfResult((name + " latency p50").c_str(),
+                      result.latency_p50.InMillisecondsF(), "ms");
+  base::LogPerfResult((name + " latency p99").c_str(),
+                      result.latency_p99.InMillisecondsF(), "ms");
+  base::LogPerfResult((name + " bytes read").c_str(), result.bytes_read,
+                      "bytes");
+  base::LogPerfResult((name + " bytes written").c_str(), result.bytes_written,
+                      "bytes");
+  if (simple_cache_impl_) {
+    base::LogPerfResult(
+        (name + " index memory").c_str(),
+        simple_cache_impl_->index()->EstimateMemoryUsage(), "bytes");
+  }
+}
+
 void DiskCachePerfTest::CacheBackendPerformance() {
   InitCache();
   EXPECT_TRUE(TimeWrite());
@@ -268,6 +386,380 @@ TEST_F(DiskCachePerfTest, SimpleCacheBackendPerformance) {
   CacheBackendPerformance();
 }
 
+#if defined(OS_LINUX)
+// Falls back to the same blocking IO as SimpleCacheBackendPerformance where
+// io_uring is not available.
+TEST_F(DiskCachePerfTest, SimpleCacheIOUringBackendPerformance) {
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndEnableFeature(disk_cache::kSimpleCacheIOUring);
+  SetSimpleCacheMode();
+  CacheBackendPerformance();
+}
+#endif
+
+TEST_F(DiskCachePerfTest, LogCacheBackendPerformance) {
+  SetLogCacheMode();
+  CacheBackendPerformance();
+}
+
+// Opens and reads random keys of |cache|, creating the entries that are
+// missing, as a network thread serving many requests would.
+void HitOrMissLoop(disk_cache::Backend* cache, int seed, int operations) {
+  const int kKeyCount = 10000;
+  const int kSize = 4096;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+  srand(seed);
+  for (int i = 0; i < operations; ++i) {
+    std::string key = base::IntToString(rand() % kKeyCount);
+    disk_cache::Entry* entry = nullptr;
+    if (cache->OpenEntry(key, &entry, net::CompletionCallback()) == net::OK) {
+      entry->ReadData(1, 0, buffer.get(), kSize, net::CompletionCallback());
+    } else if (cache->CreateEntry(key, &entry, net::CompletionCallback()) ==
+               net::OK) {
+      entry->WriteData(1, 0, buffer.get(), kSize, net::CompletionCallback(),
+                       false);
+    } else {
+      continue;
+    }
+    entry->Close();
+  }
+}
+
+// Measures the memory cache used from several threads at once, with a single
+// lock and with one lock per shard.
+TEST_F(DiskCachePerfTest, MemoryCacheConcurrentPerformance) {
+  const int kThreadCount = 8;
+  const int kOperationsPerThread = 100000;
+  const int kShardCounts[] = {1, 16};
+  for (int shard_count : kShardCounts) {
+    // Small enough that the cache keeps evicting.
+    std::unique_ptr<disk_cache::Backend> cache =
+        disk_cache::MemBackendImpl::CreateShardedBackend(16 * 1024 * 1024,
+                                                         shard_count, nullptr);
+    ASSERT_TRUE(cache);
+
+    std::unique_ptr<base::Thread> threads[kThreadCount];
+    base::ElapsedTimer timer;
+    for (int i = 0; i < kThreadCount; ++i) {
+      threads[i].reset(new base::Thread(base::StringPrintf("Cache%d", i)));
+      ASSERT_TRUE(threads[i]->Start());
+      threads[i]->task_runner()->PostTask(
+          FROM_HERE, base::Bind(&HitOrMissLoop, cache.get(), i,
+                                kOperationsPerThread));
+    }
+    for (int i = 0; i < kThreadCount; ++i)
+      threads[i]->Stop();
+
+    const double seconds = timer.Elapsed().InSecondsF();
+    if (seconds > 0) {
+      base::LogPerfResult(
+          base::StringPrintf("Memory cache, %d shards, throughput",
+                             shard_count)
+              .c_str(),
+          kThreadCount * kOperationsPerThread / seconds, "ops/s");
+    }
+  }
+}
+
+// Measures the space saved by storing identical bodies once.
+TEST_F(DiskCachePerfTest, DedupTraceReplay) {
+  const std::vector<disk_cache::TraceRecord> trace = GenerateCacheBustedTrace();
+  for (bool dedup : {false, true}) {
+    std::unique_ptr<disk_cache::Backend> mem_cache =
+        disk_cache::MemBackendImpl::CreateBackend(0, nullptr);
+    ASSERT_TRUE(mem_cache);
+    disk_cache::Backend* wrapped_cache = mem_cache.get();
+    disk_cache::DedupBackendImpl* dedup_cache = nullptr;
+    std::unique_ptr<disk_cache::Backend> cache;
+    if (dedup) {
+      dedup_cache = new disk_cache::DedupBackendImpl(std::move(mem_cache));
+      cache.reset(dedup_cache);
+    } else {
+      cache = std::move(mem_cache);
+    }
+    const std::string name = dedup ? "Dedup cache" : "Plain cache";
+
+    disk_cache::TraceReplayResult result;
+    disk_cache::ReplayTrace(cache.get(), trace,
+                            disk_cache::TRACE_REPLAY_DATA_BY_URL, &result);
+    base::RunLoop().RunUntilIdle();
+    EXPECT_EQ(0, result.errors);
+
+    net::TestCompletionCallback cb;
+    const int stored_size =
+        cb.GetResult(wrapped_cache->CalculateSizeOfAllEntries(cb.callback()));
+    base::LogPerfResult((name + " stored size").c_str(), stored_size,
+                        "bytes");
+    base::LogPerfResult((name + " latency p50").c_str(),
+                        result.latency_p50.InMillisecondsF(), "ms");
+    if (dedup_cache) {
+      base::LogPerfResult((name + " deduplicated bytes").c_str(),
+                          dedup_cache->deduplicated_bytes(), "bytes");
+    }
+  }
+}
+
+// Measures the space saved and the time taken by the compression of bodies,
+// over the memory cache so that only the compression is timed.
+TEST_F(DiskCachePerfTest, CompressedCachePerformance) {
+  const int kEntryCount = 200;
+  const int kChunkSize = 16 * 1024;
+  const int kCompressedBodySize = 4 * kChunkSize;
+
+  std::string text;
+  for (int i = 0; static_cast<int>(text.size()) < kCompressedBodySize; ++i)
+    text += base::StringPrintf("<div class=\"item\">Item %d</div>\n", i);
+  scoped_refptr<net::IOBuffer> bodies[2] = {
+      new net::IOBuffer(kCompressedBodySize),
+      new net::IOBuffer(kCompressedBodySize)};
+  memcpy(bodies[0]->data(), text.data(), kCompressedBodySize);
+  CacheTestFillBuffer(bodies[1]->data(), kCompressedBodySize, false);
+  const char* const kBodyNames[2] = {"text", "random"};
+
+  for (int body = 0; body < 2; ++body) {
+    for (bool compress : {false, true}) {
+      std::unique_ptr<disk_cache::Backend> mem_cache =
+          disk_cache::MemBackendImpl::CreateBackend(0, nullptr);
+      ASSERT_TRUE(mem_cache);
+      disk_cache::Backend* wrapped_cache = mem_cache.get();
+      std::unique_ptr<disk_cache::Backend> cache;
+      if (compress) {
+        cache.reset(new disk_cache::CompressedBackendImpl(
+            std::move(mem_cache), disk_cache::kCompressedStreamMask));
+      } else {
+        cache = std::move(mem_cache);
+      }
+      const std::string name = base::StringPrintf(
+          "%s cache, %s bodies", compress ? "Compressed" : "Plain",
+          kBodyNames[body]);
+
+      base::ElapsedTimer write_timer;
+      for (int i = 0; i < kEntryCount; ++i) {
+        disk_cache::Entry* entry = nullptr;
+        net::TestCompletionCallback cb;
+        ASSERT_EQ(net::OK, cb.GetResult(cache->CreateEntry(
+                               base::IntToString(i), &entry, cb.callback())));
+        for (int offset = 0; offset < kCompressedBodySize;
+             offset += kChunkSize) {
+          scoped_refptr<net::IOBuffer> chunk(new net::WrappedIOBuffer(
+              bodies[body]->data() + offset));
+          ASSERT_EQ(kChunkSize,
+                    cb.GetResult(entry->WriteData(1, offset, chunk.get(),
+                                                  kChunkSize, cb.callback(),
+                                                  false)));
+        }
+        entry->Close();
+      }
+      const base::TimeDelta write_time = write_timer.Elapsed();
+
+      base::ElapsedTimer read_timer;
+      scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kChunkSize));
+      for (int i = 0; i < kEntryCount; ++i) {
+        disk_cache::Entry* entry = nullptr;
+        net::TestCompletionCallback cb;
+        ASSERT_EQ(net::OK, cb.GetResult(cache->OpenEntry(
+                               base::IntToString(i), &entry, cb.callback())));
+        for (int offset = 0; offset < kCompressedBodySize;
+             offset += kChunkSize) {
+          ASSERT_EQ(kChunkSize,
+                    cb.GetResult(entry->ReadData(1, offset, buffer.get(),
+                                                 kChunkSize, cb.callback())));
+        }
+        entry->Close();
+      }
+      const base::TimeDelta read_time = read_timer.Elapsed();
+
+      net::TestCompletionCallback cb;
+      const int stored_size = cb.GetResult(
+          wrapped_cache->CalculateSizeOfAllEntries(cb.callback()));
+      base::LogPerfResult((name + " stored size").c_str(),
+                          100.0 * stored_size /
+                              (kEntryCount * kCompressedBodySize),
+                          "%");
+      base::LogPerfResult((name + " write time").c_str(),
+                          write_time.InMillisecondsF(), "ms");
+      base::LogPerfResult((name + " read time").c_str(),
+                          read_time.InMillisecondsF(), "ms");
+    }
+  }
+}
+
+// The popular entries take about 70% of the cache, and a burst of entries
+// requested once is about as large as the cache.
+TEST_F(DiskCachePerfTest, SimpleCacheLRUTraceReplay) {
+  SetSimpleCacheMode();
+  SetMaxSize(2 * 1024 * 1024);
+  InitCache();
+  ReplayTrace("Simple cache LRU", GenerateOneHitWonderTrace());
+}
+
+TEST_F(DiskCachePerfTest, BlockfileTraceReplay) {
+  SetMaxSize(2 * 1024 * 1024);
+  InitCache();
+  ReplayTrace("Blockfile cache", GenerateOneHitWonderTrace());
+}
+
+TEST_F(DiskCachePerfTest, MemoryCacheTraceReplay) {
+  SetMemoryOnlyMode();
+  SetMaxSize(2 * 1024 * 1024);
+  InitCache();
+  ReplayTrace("Memory cache", GenerateOneHitWonderTrace());
+}
+
+TEST_F(DiskCachePerfTest, LogCacheTraceReplay) {
+  SetLogCacheMode();
+  SetMaxSize(2 * 1024 * 1024);
+  InitCache();
+  ReplayTrace("Log cache", GenerateOneHitWonderTrace());
+}
+
+TEST_F(DiskCachePerfTest, SimpleCacheTinyLFUTraceReplay) {
+  SetSimpleCacheMode();
+  SetMaxSize(2 * 1024 * 1024);
+  InitCache();
+  simple_cache_impl_->index()->SetEvictionPolicy(
+      disk_cache::SimpleIndex::EVICTION_POLICY_TINY_LFU);
+  ReplayTrace("Simple cache TinyLFU", GenerateOneHitWonderTrace());
+}
+
+// Measures the time until the simple cache is ready when its index is lost,
+// as after a crash, and has to be restored from the entry files.
+void DiskCachePerfTest::SimpleCacheIndexRestorePerformance(const char* name) {
+  const int kEntryCount = 1000000;
+  // Much faster than creating the entries through the backend.
+  for (int i = 1; i <= kEntryCount; ++i) {
+    const base::FilePath file_path = cache_path_.AppendASCII(
+        disk_cache::simple_util::GetFilenameFromEntryHashAndFileIndex(i, 0));
+    ASSERT_EQ(1, base::WriteFile(file_path, "x", 1));
+  }
+  SetSimpleCacheMode();
+  DisableFirstCleanup();
+
+  base::ElapsedTimer timer;
+  InitCache();
+  base::LogPerfResult((std::string(name) + " time to ready").c_str(),
+                      timer.Elapsed().InMillisecondsF(), "ms");
+  EXPECT_EQ(kEntryCount, cache_->GetEntryCount());
+}
+
+TEST_F(DiskCachePerfTest, SimpleCacheIndexRestorePerformance) {
+  SimpleCacheIndexRestorePerformance("Simple cache index restore");
+}
+
+TEST_F(DiskCachePerfTest, SimpleCacheParallelIndexRestorePerformance) {
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndEnableFeature(
+      disk_cache::kSimpleCacheParallelIndexRestore);
+  SimpleCacheIndexRestorePerformance("Simple cache parallel index restore");
+}
+
+// Writes bodies to the simple cache in the small chunks they are received from
+// the network in, and measures the time and the number of writes it takes.
+void DiskCachePerfTest::SimpleCacheStreamedWritePerformance(const char* name) {
+  const int kEntryCount = 200;
+  const int kEntryBodySize = 256 * 1024;
+  const int kChunkSize = 1460;
+
+  SetSimpleCacheMode();
+  InitCache();
+  scoped_refptr<net::IOBuffer> body(new net::IOBuffer(kEntryBodySize));
+  CacheTestFillBuffer(body->data(), kEntryBodySize, false);
+
+  std::unique_ptr<base::ProcessMetrics> metrics =
+      base::ProcessMetrics::CreateCurrentProcessMetrics();
+  base::IoCounters start_counters = {};
+  const bool has_io_counters = metrics->GetIOCounters(&start_counters);
+  base::ElapsedTimer timer;
+  for (int i = 0; i < kEntryCount; ++i) {
+    disk_cache::Entry* entry = nullptr;
+    ASSERT_EQ(net::OK, CreateEntry(base::IntToString(i), &entry));
+    for (int offset = 0; offset < kEntryBodySize; offset += kChunkSize) {
+      const int len = std::min(kChunkSize, kEntryBodySize - offset);
+      scoped_refptr<net::IOBuffer> chunk(
+          new net::WrappedIOBuffer(body->data() + offset));
+      ASSERT_EQ(len, WriteData(entry, 1, offset, chunk.get(), len, false));
+    }
+    entry->Close();
+  }
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+  base::LogPerfResult((std::string(name) + " time").c_str(),
+                      timer.Elapsed().InMillisecondsF(), "ms");
+
+  base::IoCounters end_counters = {};
+  if (has_io_counters && metrics->GetIOCounters(&end_counters)) {
+    base::LogPerfResult(
+        (std::string(name) + " writes per entry").c_str(),
+        static_cast<double>(end_counters.WriteOperationCount -
+                            start_counters.WriteOperationCount) /
+            kEntryCount,
+        "writes");
+  }
+}
+
+TEST_F(DiskCachePerfTest, SimpleCacheStreamedWritePerformance) {
+  SimpleCacheStreamedWritePerformance("Simple cache streamed write");
+}
+
+TEST_F(DiskCachePerfTest, SimpleCacheBufferedStreamedWritePerformance) {
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndEnableFeature(
+      disk_cache::kSimpleCacheWriteBuffering);
+  SimpleCacheStreamedWritePerformance("Simple cache buffered streamed write");
+}
+
+// Replays a media workload against a sparse entry of the simple cache: the
+// media is buffered in small chunks, and then played from random positions,
+// with reads larger than the chunks.
+TEST_F(DiskCachePerfTest, SimpleCacheSparseMediaPerformance) {
+  const int kMediaSize = 16 * 1024 * 1024;
+  const int kChunkSize = 32 * 1024;
+  const int kReadSize = 256 * 1024;
+  const int kSeekCount = 200;
+  const char kKey[] = "http://media/video.webm";
+
+  SetSimpleCacheMode();
+  // An entry may use a tenth of the cache for its sparse data.
+  SetMaxSize(20 * kMediaSize);
+  InitCache();
+
+  scoped_refptr<net::IOBuffer> chunk(new net::IOBuffer(kChunkSize));
+  CacheTestFillBuffer(chunk->data(), kChunkSize, false);
+  disk_cache::Entry* entry = nullptr;
+  ASSERT_EQ(net::OK, CreateEntry(kKey, &entry));
+  for (int offset = 0; offset < kMediaSize; offset += kChunkSize) {
+    ASSERT_EQ(kChunkSize,
+              WriteSparseData(entry, offset, chunk.get(), kChunkSize));
+  }
+  entry->Close();
+
+  ResetAndEvictSystemDiskCache();
+
+  base::ElapsedTimer open_timer;
+  ASSERT_EQ(net::OK, OpenEntry(kKey, &entry));
+  base::LogPerfResult("Simple cache sparse media open time",
+                      open_timer.Elapsed().InMillisecondsF(), "ms");
+
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kReadSize));
+  base::ElapsedTimer seek_timer;
+  for (int i = 0; i < kSeekCount; ++i) {
+    const int64_t offset =
+        base::RandGenerator(kMediaSize - kReadSize) & ~UINT64_C(0xfff);
+    int64_t start;
+    net::TestCompletionCallback cb;
+    ASSERT_EQ(kReadSize,
+              cb.GetResult(entry->GetAvailableRange(offset, kReadSize, &start,
+                                                    cb.callback())));
+    ASSERT_EQ(kReadSize, ReadSparseData(entry, offset, buffer.get(),
+                                        kReadSize));
+  }
+  base::LogPerfResult("Simple cache sparse media seek latency",
+                      seek_timer.Elapsed().InMillisecondsF() / kSeekCount,
+                      "ms");
+  entry->Close();
+}
+
 int BlockSize() {
   // We can use form 1 to 4 blocks.
   return (rand() & 0x3) + 1;
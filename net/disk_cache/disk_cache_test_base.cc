@@ -17,11 +17,15 @@
 #include "net/base/test_completion_callback.h"
 #include "net/disk_cache/blockfile/backend_impl.h"
 #include "net/disk_cache/cache_util.h"
+#include "net/disk_cache/compressed/compressed_backend_impl.h"
+#include "net/disk_cache/dedup/dedup_backend_impl.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/log/log_backend_impl.h"
 #include "net/disk_cache/memory/mem_backend_impl.h"
 #include "net/disk_cache/simple/simple_backend_impl.h"
 #include "net/disk_cache/simple/simple_index.h"
+#include "net/disk_cache/tiered/tiered_backend_impl.h"
 #include "net/test/gtest_util.h"
 #include "testing/gmock/include/gmock/gmock.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -75,12 +79,22 @@ int DiskCacheTestWithCache::TestIterator::OpenNextEntry(
 DiskCacheTestWithCache::DiskCacheTestWithCache()
     : cache_impl_(NULL),
       simple_cache_impl_(NULL),
+      log_cache_impl_(NULL),
       mem_cache_(NULL),
+      compressed_cache_impl_(NULL),
+      dedup_cache_impl_(NULL),
+      tiered_cache_impl_(NULL),
       mask_(0),
       size_(0),
       type_(net::DISK_CACHE),
       memory_only_(false),
+      memory_shard_count_(1),
       simple_cache_mode_(false),
+      log_cache_mode_(false),
+      compressed_cache_mode_(false),
+      dedup_cache_mode_(false),
+      tiered_cache_mode_(false),
+      tiered_memory_size_(0),
       simple_cache_wait_for_index_(true),
       force_creation_(false),
       new_eviction_(false),
@@ -99,6 +113,7 @@ void DiskCacheTestWithCache::InitCache() {
     InitDiskCache();
 
   ASSERT_TRUE(NULL != cache_);
+  WrapCache();
   if (first_cleanup_)
     ASSERT_EQ(0, cache_->GetEntryCount());
 }
@@ -127,6 +142,9 @@ void DiskCacheTestWithCache::SetMaxSize(int size) {
   if (simple_cache_impl_)
     EXPECT_TRUE(simple_cache_impl_->SetMaxSize(size));
 
+  if (log_cache_impl_)
+    EXPECT_TRUE(log_cache_impl_->SetMaxSize(size));
+
   if (cache_impl_)
     EXPECT_TRUE(cache_impl_->SetMaxSize(size));
 
@@ -276,7 +294,7 @@ void DiskCacheTestWithCache::TearDown() {
   if (cache_thread_.IsRunning())
     cache_thread_.Stop();
 
-  if (!memory_only_ && !simple_cache_mode_ && integrity_) {
+  if (!memory_only_ && !simple_cache_mode_ && !log_cache_mode_ && integrity_) {
     EXPECT_TRUE(CheckCacheIntegrity(cache_path_, new_eviction_, mask_));
   }
   base::RunLoop().RunUntilIdle();
@@ -285,7 +303,7 @@ void DiskCacheTestWithCache::TearDown() {
 }
 
 void DiskCacheTestWithCache::InitMemoryCache() {
-  mem_cache_ = new disk_cache::MemBackendImpl(NULL);
+  mem_cache_ = new disk_cache::MemBackendImpl(NULL, memory_shard_count_);
   cache_.reset(mem_cache_);
   ASSERT_TRUE(cache_);
 
@@ -308,6 +326,23 @@ void DiskCacheTestWithCache::InitDiskCache() {
   CreateBackend(disk_cache::kNoRandom, &cache_thread_);
 }
 
+void DiskCacheTestWithCache::WrapCache() {
+  if (compressed_cache_mode_) {
+    compressed_cache_impl_ = new disk_cache::CompressedBackendImpl(
+        std::move(cache_), disk_cache::kCompressedStreamMask);
+    cache_.reset(compressed_cache_impl_);
+  }
+  if (dedup_cache_mode_) {
+    dedup_cache_impl_ = new disk_cache::DedupBackendImpl(std::move(cache_));
+    cache_.reset(dedup_cache_impl_);
+  }
+  if (tiered_cache_mode_) {
+    tiered_cache_impl_ = new disk_cache::TieredBackendImpl(
+        std::move(cache_), tiered_memory_size_, NULL);
+    cache_.reset(tiered_cache_impl_);
+  }
+}
+
 void DiskCacheTestWithCache::CreateBackend(uint32_t flags,
                                            base::Thread* thread) {
   scoped_refptr<base::SingleThreadTaskRunner> runner;
@@ -334,6 +369,17 @@ void DiskCacheTestWithCache::CreateBackend(uint32_t flags,
     return;
   }
 
+  if (log_cache_mode_) {
+    net::TestCompletionCallback cb;
+    std::unique_ptr<disk_cache::LogBackendImpl> log_backend(
+        new disk_cache::LogBackendImpl(cache_path_, size_, type_, runner));
+    int rv = log_backend->Init(cb.callback());
+    ASSERT_THAT(cb.GetResult(rv), IsOk());
+    log_cache_impl_ = log_backend.get();
+    cache_ = std::move(log_backend);
+    return;
+  }
+
   if (mask_)
     cache_impl_ = new disk_cache::BackendImpl(cache_path_, mask_, runner, NULL);
   else
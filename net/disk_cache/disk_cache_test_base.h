@@ -28,9 +28,13 @@ namespace disk_cache {
 
 class Backend;
 class BackendImpl;
+class CompressedBackendImpl;
+class DedupBackendImpl;
 class Entry;
+class LogBackendImpl;
 class MemBackendImpl;
 class SimpleBackendImpl;
+class TieredBackendImpl;
 
 }  // namespace disk_cache
 
@@ -86,10 +90,36 @@ class DiskCacheTestWithCache : public DiskCacheTest {
     memory_only_ = true;
   }
 
+  // Spreads the entries of the memory cache over |shard_count| shards.
+  void SetMemoryShardCount(int shard_count) {
+    memory_shard_count_ = shard_count;
+  }
+
   void SetSimpleCacheMode() {
     simple_cache_mode_ = true;
   }
 
+  void SetLogCacheMode() {
+    log_cache_mode_ = true;
+  }
+
+  // Wraps the backend in a CompressedBackendImpl.
+  void SetCompressedCacheMode() {
+    compressed_cache_mode_ = true;
+  }
+
+  // Wraps the backend in a DedupBackendImpl.
+  void SetDedupCacheMode() {
+    dedup_cache_mode_ = true;
+  }
+
+  // Fronts the backend with a TieredBackendImpl, whose memory tier holds
+  // |memory_size| bytes.
+  void SetTieredCacheMode(int memory_size) {
+    tiered_cache_mode_ = true;
+    tiered_memory_size_ = memory_size;
+  }
+
   void SetMask(uint32_t mask) { mask_ = mask; }
 
   void SetMaxSize(int size);
@@ -168,13 +198,23 @@ class DiskCacheTestWithCache : public DiskCacheTest {
   std::unique_ptr<disk_cache::Backend> cache_;
   disk_cache::BackendImpl* cache_impl_;
   disk_cache::SimpleBackendImpl* simple_cache_impl_;
+  disk_cache::LogBackendImpl* log_cache_impl_;
   disk_cache::MemBackendImpl* mem_cache_;
+  disk_cache::CompressedBackendImpl* compressed_cache_impl_;
+  disk_cache::DedupBackendImpl* dedup_cache_impl_;
+  disk_cache::TieredBackendImpl* tiered_cache_impl_;
 
   uint32_t mask_;
   int size_;
   net::CacheType type_;
   bool memory_only_;
+  int memory_shard_count_;
   bool simple_cache_mode_;
+  bool log_cache_mode_;
+  bool compressed_cache_mode_;
+  bool dedup_cache_mode_;
+  bool tiered_cache_mode_;
+  int tiered_memory_size_;
   bool simple_cache_wait_for_index_;
   bool force_creation_;
   bool new_eviction_;
@@ -187,6 +227,7 @@ class DiskCacheTestWithCache : public DiskCacheTest {
  private:
   void InitMemoryCache();
   void InitDiskCache();
+  void WrapCache();
 
   base::Thread cache_thread_;
   DISALLOW_COPY_AND_ASSIGN(DiskCacheTestWithCache);
@@ -0,0 +1,94 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/disk_cache_trace.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+
+#include "base/macros.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/string_split.h"
+#include "base/strings/stringprintf.h"
+
+namespace disk_cache {
+
+namespace {
+
+const char* const kOpNames[] = {"read", "write", "doom"};
+
+// Splits the next space separated token off the front of |line|.
+bool NextToken(base::StringPiece* line, base::StringPiece* token) {
+  const size_t space = line->find(' ');
+  if (space == base::StringPiece::npos || space == 0)
+    return false;
+  *token = line->substr(0, space);
+  line->remove_prefix(space + 1);
+  return true;
+}
+
+bool ParseLine(base::StringPiece line, TraceRecord* record) {
+  base::StringPiece time;
+  base::StringPiece op;
+  base::StringPiece size;
+  int64_t milliseconds;
+  if (!NextToken(&line, &time) || !NextToken(&line, &op) ||
+      !NextToken(&line, &size) || line.empty() ||
+      !base::StringToInt64(time, &milliseconds) || milliseconds < 0 ||
+      !base::StringToInt(size, &record->size) || record->size < 0) {
+    return false;
+  }
+
+  size_t i = 0;
+  while (i < arraysize(kOpNames) && op != kOpNames[i])
+    ++i;
+  if (i == arraysize(kOpNames))
+    return false;
+
+  record->time = base::TimeDelta::FromMilliseconds(milliseconds);
+  record->op = static_cast<TraceRecord::Op>(i);
+  line.CopyToString(&record->key);
+  return true;
+}
+
+}  // namespace
+
+TraceRecord::TraceRecord() : op(READ), size(0) {}
+
+TraceRecord::TraceRecord(base::TimeDelta time,
+                         Op op,
+                         int size,
+                         const std::string& key)
+    : time(time), op(op), size(size), key(key) {}
+
+TraceRecord::~TraceRecord() {}
+
+std::string SerializeTrace(const std::vector<TraceRecord>& records) {
+  std::string contents;
+  for (const TraceRecord& record : records) {
+    base::StringAppendF(&contents, "%" PRId64 " %s %d %s\n",
+                        record.time.InMilliseconds(), kOpNames[record.op],
+                        record.size, record.key.c_str());
+  }
+  return contents;
+}
+
+bool ParseTrace(const std::string& contents,
+                std::vector<TraceRecord>* records) {
+  std::vector<TraceRecord> parsed;
+  for (const base::StringPiece& line : base::SplitStringPiece(
+           contents, "\n", base::KEEP_WHITESPACE, base::SPLIT_WANT_NONEMPTY)) {
+    if (line.starts_with("#"))
+      continue;
+    TraceRecord record;
+    if (!ParseLine(line, &record))
+      return false;
+    parsed.push_back(record);
+  }
+  records->insert(records->end(), parsed.begin(), parsed.end());
+  return true;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,57 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_DISK_CACHE_TRACE_H_
+#define NET_DISK_CACHE_DISK_CACHE_TRACE_H_
+
+#include <string>
+#include <vector>
+
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+
+// A trace of the requests made to a disk cache, to evaluate cache changes by
+// replaying real traffic against any backend. Traces are recorded from the
+// HttpCache by net::HttpCacheTraceRecorder, and replayed by ReplayTrace() in
+// disk_cache_trace_replayer.h.
+//
+// The text format has one request per line:
+//
+//   <milliseconds since start> <read|write|doom> <size in bytes> <key>
+//
+// The key is the rest of the line. Empty lines and lines starting with '#'
+// are ignored.
+namespace disk_cache {
+
+struct NET_EXPORT TraceRecord {
+  enum Op {
+    // A request for the entry: it is read on a hit, and written with |size|
+    // bytes on a miss, like a response fetched from the network.
+    READ,
+    // A store of |size| bytes without a lookup, replacing any existing data.
+    WRITE,
+    // The entry is doomed; |size| is unused.
+    DOOM,
+  };
+
+  TraceRecord();
+  TraceRecord(base::TimeDelta time, Op op, int size, const std::string& key);
+  ~TraceRecord();
+
+  base::TimeDelta time;
+  Op op;
+  int size;
+  std::string key;
+};
+
+NET_EXPORT std::string SerializeTrace(const std::vector<TraceRecord>& records);
+
+// Appends the records of |contents| to |records|. Returns false, leaving
+// |records| unchanged, if any line is malformed.
+NET_EXPORT bool ParseTrace(const std::string& contents,
+                           std::vector<TraceRecord>* records);
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_DISK_CACHE_TRACE_H_
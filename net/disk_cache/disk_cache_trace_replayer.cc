@@ -0,0 +1,220 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/disk_cache_trace_replayer.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+
+#include "base/bind.h"
+#include "base/callback.h"
+#include "base/hash.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "base/run_loop.h"
+#include "net/base/completion_callback.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace disk_cache {
+
+namespace {
+
+// The stream holding the data of the replayed entries.
+const int kDataIndex = 1;
+
+// Waits for the operations of the backend and its entries, one at a time, by
+// running the message loop until they complete.
+class OperationWaiter {
+ public:
+  OperationWaiter() : result_(net::ERR_IO_PENDING), weak_factory_(this) {}
+
+  net::CompletionCallback callback() {
+    return base::Bind(&OperationWaiter::OnComplete,
+                      weak_factory_.GetWeakPtr());
+  }
+
+  // Returns the result of the operation which returned |rv|.
+  int GetResult(int rv) {
+    if (rv != net::ERR_IO_PENDING)
+      return rv;
+    base::RunLoop run_loop;
+    quit_closure_ = run_loop.QuitClosure();
+    run_loop.Run();
+    quit_closure_.Reset();
+    return result_;
+  }
+
+ private:
+  void OnComplete(int result) {
+    result_ = result;
+    if (!quit_closure_.is_null())
+      quit_closure_.Run();
+  }
+
+  int result_;
+  base::Closure quit_closure_;
+  base::WeakPtrFactory<OperationWaiter> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(OperationWaiter);
+};
+
+class Replayer {
+ public:
+  Replayer(Backend* backend, TraceReplayData data, TraceReplayResult* result)
+      : backend_(backend),
+        data_(data),
+        result_(result),
+        buffer_(new net::IOBufferWithSize(1)) {}
+
+  void Replay(const TraceRecord& record) {
+    switch (record.op) {
+      case TraceRecord::READ:
+        Read(record);
+        break;
+      case TraceRecord::WRITE:
+        Write(record);
+        break;
+      case TraceRecord::DOOM:
+        Doom(record);
+        break;
+    }
+  }
+
+ private:
+  void Read(const TraceRecord& record) {
+    ++result_->requests;
+    result_->requested_bytes += record.size;
+
+    Entry* entry = nullptr;
+    OperationWaiter cb;
+    if (cb.GetResult(backend_->OpenEntry(record.key, &entry, cb.callback())) !=
+        net::OK) {
+      // A miss: store the response, as if it was fetched from the network.
+      if (cb.GetResult(backend_->CreateEntry(record.key, &entry,
+                                             cb.callback())) != net::OK) {
+        ++result_->errors;
+        return;
+      }
+      WriteAndClose(record, entry);
+      return;
+    }
+    ++result_->hits;
+    result_->hit_bytes += record.size;
+
+    const int size = std::min(record.size, entry->GetDataSize(kDataIndex));
+    EnsureBufferSize(size);
+    const int rv = cb.GetResult(
+        entry->ReadData(kDataIndex, 0, buffer_.get(), size, cb.callback()));
+    if (rv >= 0)
+      result_->bytes_read += rv;
+    else
+      ++result_->errors;
+    entry->Close();
+  }
+
+  void Write(const TraceRecord& record) {
+    Entry* entry = nullptr;
+    OperationWaiter cb;
+    if (cb.GetResult(backend_->OpenEntry(record.key, &entry, cb.callback())) !=
+            net::OK &&
+        cb.GetResult(backend_->CreateEntry(record.key, &entry,
+                                           cb.callback())) != net::OK) {
+      ++result_->errors;
+      return;
+    }
+    WriteAndClose(record, entry);
+  }
+
+  void WriteAndClose(const TraceRecord& record, Entry* entry) {
+    OperationWaiter cb;
+    FillBuffer(record.key, record.size);
+    const int rv = cb.GetResult(entry->WriteData(kDataIndex, 0, buffer_.get(),
+                                                 record.size, cb.callback(),
+                                                 true));
+    if (rv >= 0)
+      result_->bytes_written += rv;
+    else
+      ++result_->errors;
+    entry->Close();
+  }
+
+  void Doom(const TraceRecord& record) {
+    OperationWaiter cb;
+    const int rv =
+        cb.GetResult(backend_->DoomEntry(record.key, cb.callback()));
+    // Dooming an entry which is not there is not an error.
+    if (rv != net::OK && rv != net::ERR_FAILED)
+      ++result_->errors;
+  }
+
+  void EnsureBufferSize(int size) {
+    if (buffer_->size() < size)
+      buffer_ = new net::IOBufferWithSize(size);
+  }
+
+  // Fills the first |size| bytes of |buffer_| with the data of |key|, as
+  // chosen by |data_|.
+  void FillBuffer(const std::string& key, int size) {
+    EnsureBufferSize(size);
+    if (data_ == TRACE_REPLAY_DATA_ANY)
+      return;
+    uint32_t state = base::Hash(key.substr(0, key.find('?')));
+    char* data = buffer_->data();
+    for (int i = 0; i < size; ++i) {
+      state = state * 1664525 + 1013904223;
+      data[i] = static_cast<char>(state >> 24);
+    }
+  }
+
+  Backend* const backend_;
+  const TraceReplayData data_;
+  TraceReplayResult* const result_;
+  scoped_refptr<net::IOBufferWithSize> buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(Replayer);
+};
+
+base::TimeDelta Percentile(const std::vector<base::TimeDelta>& sorted,
+                           int percent) {
+  if (sorted.empty())
+    return base::TimeDelta();
+  return sorted[(sorted.size() - 1) * percent / 100];
+}
+
+}  // namespace
+
+TraceReplayResult::TraceReplayResult()
+    : requests(0),
+      hits(0),
+      requested_bytes(0),
+      hit_bytes(0),
+      bytes_read(0),
+      bytes_written(0),
+      errors(0) {}
+
+void ReplayTrace(Backend* backend,
+                 const std::vector<TraceRecord>& records,
+                 TraceReplayData data,
+                 TraceReplayResult* result) {
+  *result = TraceReplayResult();
+  Replayer replayer(backend, data, result);
+  std::vector<base::TimeDelta> latencies;
+  latencies.reserve(records.size());
+  for (const TraceRecord& record : records) {
+    const base::TimeTicks start = base::TimeTicks::Now();
+    replayer.Replay(record);
+    latencies.push_back(base::TimeTicks::Now() - start);
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  result->latency_p50 = Percentile(latencies, 50);
+  result->latency_p99 = Percentile(latencies, 99);
+}
+
+}  // namespace disk_cache
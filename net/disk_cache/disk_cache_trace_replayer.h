@@ -0,0 +1,64 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_DISK_CACHE_TRACE_REPLAYER_H_
+#define NET_DISK_CACHE_DISK_CACHE_TRACE_REPLAYER_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "base/time/time.h"
+#include "net/disk_cache/disk_cache_trace.h"
+
+namespace disk_cache {
+
+class Backend;
+
+struct TraceReplayResult {
+  TraceReplayResult();
+
+  // READ records, and those of them that found their entry.
+  int requests;
+  int hits;
+  // The sizes of the READ records, and of those that hit.
+  int64_t requested_bytes;
+  int64_t hit_bytes;
+
+  // The data read from and written to entries.
+  int64_t bytes_read;
+  int64_t bytes_written;
+
+  // Records whose operations failed, other than by missing their entry.
+  int errors;
+
+  // The time taken by the operations of a record, from opening its entry to
+  // closing it, over all records.
+  base::TimeDelta latency_p50;
+  base::TimeDelta latency_p99;
+};
+
+// The data written by the WRITE records.
+enum TraceReplayData {
+  // Whatever the replayer has at hand, which costs nothing to produce.
+  TRACE_REPLAY_DATA_ANY,
+  // Data derived from the key without its query, so that keys only differing
+  // by their query, which is often only there to defeat caches, store the
+  // same data.
+  TRACE_REPLAY_DATA_BY_URL,
+};
+
+// Replays |records| against |backend|, which must be empty to reproduce the
+// recorded hits. Records are replayed in order, one at a time and as fast as
+// possible, ignoring their times. Data is stored in stream 1 of the entries,
+// as chosen by |data|. Must be called on the thread that created |backend|,
+// with a message loop.
+void ReplayTrace(Backend* backend,
+                 const std::vector<TraceRecord>& records,
+                 TraceReplayData data,
+                 TraceReplayResult* result);
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_DISK_CACHE_TRACE_REPLAYER_H_
@@ -0,0 +1,97 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/disk_cache_trace.h"
+
+#include <memory>
+#include <vector>
+
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/disk_cache_trace_replayer.h"
+#include "net/disk_cache/memory/mem_backend_impl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+TraceRecord MakeRecord(int milliseconds,
+                       TraceRecord::Op op,
+                       int size,
+                       const std::string& key) {
+  return TraceRecord(base::TimeDelta::FromMilliseconds(milliseconds), op,
+                     size, key);
+}
+
+}  // namespace
+
+TEST(DiskCacheTraceTest, SerializeAndParse) {
+  std::vector<TraceRecord> records;
+  records.push_back(MakeRecord(0, TraceRecord::READ, 100, "http://a/"));
+  records.push_back(MakeRecord(5, TraceRecord::WRITE, 0, "key with spaces"));
+  records.push_back(MakeRecord(1234, TraceRecord::DOOM, 0, "http://b/"));
+
+  const std::string contents = SerializeTrace(records);
+  EXPECT_EQ(
+      "0 read 100 http://a/\n"
+      "5 write 0 key with spaces\n"
+      "1234 doom 0 http://b/\n",
+      contents);
+
+  std::vector<TraceRecord> parsed;
+  ASSERT_TRUE(ParseTrace("# A comment.\n\n" + contents, &parsed));
+  ASSERT_EQ(records.size(), parsed.size());
+  for (size_t i = 0; i < records.size(); ++i) {
+    EXPECT_EQ(records[i].time, parsed[i].time);
+    EXPECT_EQ(records[i].op, parsed[i].op);
+    EXPECT_EQ(records[i].size, parsed[i].size);
+    EXPECT_EQ(records[i].key, parsed[i].key);
+  }
+}
+
+TEST(DiskCacheTraceTest, ParseMalformed) {
+  const char* const kMalformed[] = {
+      "0 read 100",    "0 read 100 ",   "x read 100 key",  "0 seek 100 key",
+      "0 read -1 key", "-5 read 1 key", "0  read 100 key",
+  };
+  for (const char* line : kMalformed) {
+    std::vector<TraceRecord> records;
+    records.push_back(MakeRecord(0, TraceRecord::READ, 1, "existing"));
+    EXPECT_FALSE(ParseTrace(std::string("0 read 1 valid\n") + line, &records))
+        << line;
+    EXPECT_EQ(1u, records.size()) << line;
+  }
+}
+
+TEST(DiskCacheTraceTest, Replay) {
+  std::unique_ptr<Backend> backend = MemBackendImpl::CreateBackend(0, nullptr);
+  ASSERT_TRUE(backend);
+
+  std::vector<TraceRecord> records;
+  // A miss, then a hit.
+  records.push_back(MakeRecord(0, TraceRecord::READ, 1000, "a"));
+  records.push_back(MakeRecord(1, TraceRecord::READ, 1000, "a"));
+  // A store without lookup, then a hit on it.
+  records.push_back(MakeRecord(2, TraceRecord::WRITE, 500, "b"));
+  records.push_back(MakeRecord(3, TraceRecord::READ, 500, "b"));
+  // A doom, then a miss.
+  records.push_back(MakeRecord(4, TraceRecord::DOOM, 0, "a"));
+  records.push_back(MakeRecord(5, TraceRecord::READ, 2000, "a"));
+  // Dooming a missing entry is fine.
+  records.push_back(MakeRecord(6, TraceRecord::DOOM, 0, "c"));
+
+  TraceReplayResult result;
+  ReplayTrace(backend.get(), records, TRACE_REPLAY_DATA_ANY, &result);
+  EXPECT_EQ(4, result.requests);
+  EXPECT_EQ(2, result.hits);
+  EXPECT_EQ(4500, result.requested_bytes);
+  EXPECT_EQ(1500, result.hit_bytes);
+  EXPECT_EQ(1500, result.bytes_read);
+  EXPECT_EQ(3500, result.bytes_written);
+  EXPECT_EQ(0, result.errors);
+  EXPECT_LE(result.latency_p50, result.latency_p99);
+  EXPECT_EQ(2, backend->GetEntryCount());
+}
+
+}  // namespace disk_cache
@@ -12,6 +12,7 @@
 #include "base/run_loop.h"
 #include "base/strings/string_number_conversions.h"
 #include "base/strings/string_util.h"
+#include "base/test/scoped_feature_list.h"
 #include "base/threading/platform_thread.h"
 #include "net/base/completion_callback.h"
 #include "net/base/io_buffer.h"
@@ -714,6 +715,20 @@ TEST_F(DiskCacheEntryTest, StreamAccess) {
   StreamAccess();
 }
 
+TEST_F(DiskCacheEntryTest, CompressedCacheStreamAccess) {
+  SetSimpleCacheMode();
+  SetCompressedCacheMode();
+  InitCache();
+  StreamAccess();
+}
+
+TEST_F(DiskCacheEntryTest, DedupCacheStreamAccess) {
+  SetSimpleCacheMode();
+  SetDedupCacheMode();
+  InitCache();
+  StreamAccess();
+}
+
 TEST_F(DiskCacheEntryTest, MemoryOnlyStreamAccess) {
   SetMemoryOnlyMode();
   InitCache();
@@ -768,6 +783,20 @@ TEST_F(DiskCacheEntryTest, GetKey) {
   GetKey();
 }
 
+TEST_F(DiskCacheEntryTest, CompressedCacheGetKey) {
+  SetSimpleCacheMode();
+  SetCompressedCacheMode();
+  InitCache();
+  GetKey();
+}
+
+TEST_F(DiskCacheEntryTest, DedupCacheGetKey) {
+  SetSimpleCacheMode();
+  SetDedupCacheMode();
+  InitCache();
+  GetKey();
+}
+
 TEST_F(DiskCacheEntryTest, MemoryOnlyGetKey) {
   SetMemoryOnlyMode();
   InitCache();
@@ -1486,6 +1515,20 @@ TEST_F(DiskCacheEntryTest, DoomEntry) {
   DoomNormalEntry();
 }
 
+TEST_F(DiskCacheEntryTest, CompressedCacheDoomEntry) {
+  SetSimpleCacheMode();
+  SetCompressedCacheMode();
+  InitCache();
+  DoomNormalEntry();
+}
+
+TEST_F(DiskCacheEntryTest, DedupCacheDoomEntry) {
+  SetSimpleCacheMode();
+  SetDedupCacheMode();
+  InitCache();
+  DoomNormalEntry();
+}
+
 TEST_F(DiskCacheEntryTest, MemoryOnlyDoomEntry) {
   SetMemoryOnlyMode();
   InitCache();
@@ -1522,6 +1565,20 @@ TEST_F(DiskCacheEntryTest, DoomEntryNextToOpenEntry) {
   DoomEntryNextToOpenEntry();
 }
 
+TEST_F(DiskCacheEntryTest, CompressedCacheDoomEntryNextToOpenEntry) {
+  SetSimpleCacheMode();
+  SetCompressedCacheMode();
+  InitCache();
+  DoomEntryNextToOpenEntry();
+}
+
+TEST_F(DiskCacheEntryTest, DedupCacheDoomEntryNextToOpenEntry) {
+  SetSimpleCacheMode();
+  SetDedupCacheMode();
+  InitCache();
+  DoomEntryNextToOpenEntry();
+}
+
 TEST_F(DiskCacheEntryTest, NewEvictionDoomEntryNextToOpenEntry) {
   SetNewEviction();
   InitCache();
@@ -1722,6 +1779,13 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyBasicSparseIO) {
   BasicSparseIO();
 }
 
+TEST_F(DiskCacheEntryTest, MemoryOnlyShardedBasicSparseIO) {
+  SetMemoryOnlyMode();
+  SetMemoryShardCount(8);
+  InitCache();
+  BasicSparseIO();
+}
+
 void DiskCacheEntryTest::HugeSparseIO() {
   std::string key("the first key");
   disk_cache::Entry* entry;
@@ -4176,6 +4240,132 @@ TEST_F(DiskCacheEntryTest, SimpleCacheTruncateLargeSparseFile) {
   entry->Close();
 }
 
+// Tests that the ranges of a sparse entry are read back through the index
+// written when it is closed, and that they can still be changed afterwards.
+TEST_F(DiskCacheEntryTest, SimpleCacheSparseIndex) {
+  const int kSize = 1024;
+  const int kRanges = 8;
+
+  SetSimpleCacheMode();
+  InitCache();
+
+  const char key[] = "key";
+  disk_cache::Entry* entry;
+  ASSERT_THAT(CreateEntry(key, &entry), IsOk());
+
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize * kRanges));
+  CacheTestFillBuffer(buffer->data(), kSize * kRanges, false);
+  // Contiguous ranges, written in order, and one more after a gap.
+  for (int i = 0; i < kRanges; ++i) {
+    scoped_refptr<net::IOBuffer> range(
+        new net::WrappedIOBuffer(buffer->data() + i * kSize));
+    EXPECT_EQ(kSize,
+              WriteSparseData(entry, i * kSize, range.get(), kSize));
+  }
+  EXPECT_EQ(kSize,
+            WriteSparseData(entry, 2 * kSize * kRanges, buffer.get(), kSize));
+  entry->Close();
+
+  // Reopening the entry waits for the sparse file to be closed.
+  ASSERT_THAT(OpenEntry(key, &entry), IsOk());
+  base::FilePath sparse_path = cache_path_.AppendASCII(
+      disk_cache::simple_util::GetSparseFilenameFromEntryHash(
+          disk_cache::simple_util::GetEntryHashKey(key)));
+  base::File sparse_file(sparse_path,
+                         base::File::FLAG_READ | base::File::FLAG_OPEN);
+  ASSERT_TRUE(sparse_file.IsValid());
+  disk_cache::SimpleFileSparseIndexFooter footer;
+  const int64_t footer_offset = sparse_file.GetLength() - sizeof(footer);
+  ASSERT_EQ(static_cast<int>(sizeof(footer)),
+            sparse_file.Read(footer_offset, reinterpret_cast<char*>(&footer),
+                             sizeof(footer)));
+  EXPECT_EQ(disk_cache::kSimpleSparseIndexMagicNumber,
+            footer.sparse_index_magic_number);
+  const size_t index_size =
+      sizeof(disk_cache::SimpleFileSparseIndexHeader) +
+      (kRanges + 1) * sizeof(disk_cache::SimpleFileSparseIndexEntry);
+  EXPECT_EQ(static_cast<int64_t>(index_size),
+            footer_offset - footer.index_offset);
+  sparse_file.Close();
+
+  // The contiguous ranges are read at once, across their headers.
+  VerifyContentSparseIO(entry, 0, buffer->data(), kSize * kRanges);
+  VerifyContentSparseIO(entry, kSize / 2, buffer->data() + kSize / 2,
+                        kSize * (kRanges - 1));
+  VerifyContentSparseIO(entry, 2 * kSize * kRanges, buffer->data(), kSize);
+  int64_t start;
+  net::TestCompletionCallback cb;
+  int rv = entry->GetAvailableRange(0, 4 * kSize * kRanges, &start,
+                                    cb.callback());
+  EXPECT_EQ(kSize * kRanges, cb.GetResult(rv));
+  EXPECT_EQ(0, start);
+
+  // A range appended in the gap replaces the index.
+  EXPECT_EQ(kSize,
+            WriteSparseData(entry, kSize * kRanges, buffer.get(), kSize));
+  entry->Close();
+
+  ASSERT_THAT(OpenEntry(key, &entry), IsOk());
+  VerifyContentSparseIO(entry, 0, buffer->data(), kSize * kRanges);
+  VerifyContentSparseIO(entry, kSize * kRanges, buffer->data(), kSize);
+  VerifyContentSparseIO(entry, 2 * kSize * kRanges, buffer->data(), kSize);
+  entry->Close();
+}
+
+// Tests that the ranges of a sparse entry are scanned when its index is
+// damaged.
+TEST_F(DiskCacheEntryTest, SimpleCacheSparseIndexCorrupt) {
+  const int kSize = 1024;
+  const int kRanges = 8;
+
+  SetSimpleCacheMode();
+  InitCache();
+
+  const char key[] = "key";
+  disk_cache::Entry* entry;
+  ASSERT_THAT(CreateEntry(key, &entry), IsOk());
+
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+  for (int i = 0; i < kRanges; ++i)
+    EXPECT_EQ(kSize, WriteSparseData(entry, i * kSize, buffer.get(), kSize));
+  entry->Close();
+  ASSERT_THAT(OpenEntry(key, &entry), IsOk());
+  entry->Close();
+  base::RunLoop().RunUntilIdle();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+
+  // Damages the last index entry.
+  base::FilePath sparse_path = cache_path_.AppendASCII(
+      disk_cache::simple_util::GetSparseFilenameFromEntryHash(
+          disk_cache::simple_util::GetEntryHashKey(key)));
+  base::File sparse_file(sparse_path,
+                         base::File::FLAG_WRITE | base::File::FLAG_OPEN);
+  ASSERT_TRUE(sparse_file.IsValid());
+  const int64_t entry_offset =
+      sparse_file.GetLength() -
+      sizeof(disk_cache::SimpleFileSparseIndexFooter) -
+      sizeof(disk_cache::SimpleFileSparseIndexEntry);
+  const char kGarbage[] = "garbage";
+  ASSERT_EQ(static_cast<int>(sizeof(kGarbage)),
+            sparse_file.Write(entry_offset, kGarbage, sizeof(kGarbage)));
+  sparse_file.Close();
+
+  ASSERT_THAT(OpenEntry(key, &entry), IsOk());
+  for (int i = 0; i < kRanges; ++i)
+    VerifyContentSparseIO(entry, i * kSize, buffer->data(), kSize);
+  // The remains of the index are dropped by the next write.
+  EXPECT_EQ(kSize,
+            WriteSparseData(entry, kSize * kRanges, buffer.get(), kSize));
+  entry->Close();
+
+  ASSERT_THAT(OpenEntry(key, &entry), IsOk());
+  for (int i = 0; i <= kRanges; ++i)
+    VerifyContentSparseIO(entry, i * kSize, buffer->data(), kSize);
+  entry->Close();
+}
+
 TEST_F(DiskCacheEntryTest, SimpleCacheReadWithoutKeySHA256) {
   // This test runs as APP_CACHE to make operations more synchronous.
   SetCacheType(net::APP_CACHE);
@@ -4292,3 +4482,199 @@ TEST_F(DiskCacheEntryTest, SimpleCacheReadCorruptLength) {
       disk_cache::simple_util::CorruptStream0LengthFromEntry(key, cache_path_));
   EXPECT_NE(net::OK, OpenEntry(key, &entry));
 }
+
+// Tests that reads within the data read ahead when opening an entry complete
+// synchronously, and that reads past it still work.
+TEST_F(DiskCacheEntryTest, SimpleCacheOpenWithReadAhead) {
+  SetSimpleCacheMode();
+  InitCache();
+
+  const char key[] = "the first key";
+  disk_cache::Entry* entry = NULL;
+  ASSERT_THAT(CreateEntry(key, &entry), IsOk());
+
+  const int kHeadersSize = 100;
+  scoped_refptr<net::IOBuffer> headers(new net::IOBuffer(kHeadersSize));
+  CacheTestFillBuffer(headers->data(), kHeadersSize, false);
+  EXPECT_EQ(kHeadersSize,
+            WriteData(entry, 0, 0, headers.get(), kHeadersSize, false));
+  const int kBodySize = 10000;
+  scoped_refptr<net::IOBuffer> body(new net::IOBuffer(kBodySize));
+  CacheTestFillBuffer(body->data(), kBodySize, false);
+  EXPECT_EQ(kBodySize, WriteData(entry, 1, 0, body.get(), kBodySize, false));
+  entry->Close();
+
+  base::RunLoop().RunUntilIdle();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+
+  const int kReadAheadSize = 4096;
+  net::TestCompletionCallback cb;
+  ASSERT_THAT(cb.GetResult(cache_->OpenEntryWithReadAhead(
+                  key, kReadAheadSize, &entry, cb.callback())),
+              IsOk());
+  ScopedEntryPtr entry_closer(entry);
+
+  scoped_refptr<net::IOBuffer> read_buffer(new net::IOBuffer(kBodySize));
+  EXPECT_EQ(kHeadersSize, entry->ReadData(0, 0, read_buffer.get(),
+                                          kHeadersSize,
+                                          net::CompletionCallback()));
+  EXPECT_EQ(0, memcmp(headers->data(), read_buffer->data(), kHeadersSize));
+  EXPECT_EQ(kReadAheadSize, entry->ReadData(1, 0, read_buffer.get(),
+                                            kReadAheadSize,
+                                            net::CompletionCallback()));
+  EXPECT_EQ(0, memcmp(body->data(), read_buffer->data(), kReadAheadSize));
+
+  // The rest of the body is read from the disk, and its checksum verified.
+  EXPECT_EQ(kBodySize - kReadAheadSize,
+            ReadData(entry, 1, kReadAheadSize, read_buffer.get(), kBodySize));
+  EXPECT_EQ(0, memcmp(body->data() + kReadAheadSize, read_buffer->data(),
+                      kBodySize - kReadAheadSize));
+
+  // Writing to the body drops the data read ahead.
+  const int kNewBodySize = 10;
+  scoped_refptr<net::IOBuffer> new_body(new net::IOBuffer(kNewBodySize));
+  CacheTestFillBuffer(new_body->data(), kNewBodySize, false);
+  EXPECT_EQ(kNewBodySize,
+            WriteData(entry, 1, 0, new_body.get(), kNewBodySize, true));
+  EXPECT_EQ(kNewBodySize,
+            ReadData(entry, 1, 0, read_buffer.get(), kBodySize));
+  EXPECT_EQ(0, memcmp(new_body->data(), read_buffer->data(), kNewBodySize));
+}
+
+// Tests that the reads of an entry opened without a read ahead do not
+// complete synchronously.
+TEST_F(DiskCacheEntryTest, SimpleCacheOpenWithoutReadAhead) {
+  SetSimpleCacheMode();
+  InitCache();
+
+  const char key[] = "the first key";
+  disk_cache::Entry* entry = NULL;
+  ASSERT_THAT(CreateEntry(key, &entry), IsOk());
+  const int kHeadersSize = 100;
+  scoped_refptr<net::IOBuffer> headers(new net::IOBuffer(kHeadersSize));
+  CacheTestFillBuffer(headers->data(), kHeadersSize, false);
+  EXPECT_EQ(kHeadersSize,
+            WriteData(entry, 0, 0, headers.get(), kHeadersSize, false));
+  entry->Close();
+
+  base::RunLoop().RunUntilIdle();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+
+  ASSERT_THAT(OpenEntry(key, &entry), IsOk());
+  ScopedEntryPtr entry_closer(entry);
+  scoped_refptr<net::IOBuffer> read_buffer(new net::IOBuffer(kHeadersSize));
+  net::TestCompletionCallback cb;
+  int rv = entry->ReadData(0, 0, read_buffer.get(), kHeadersSize,
+                           cb.callback());
+  EXPECT_THAT(rv, IsError(net::ERR_IO_PENDING));
+  EXPECT_EQ(kHeadersSize, cb.GetResult(rv));
+  EXPECT_EQ(0, memcmp(headers->data(), read_buffer->data(), kHeadersSize));
+}
+
+// Tests that reading ahead the whole body of an entry checks its checksum.
+TEST_F(DiskCacheEntryTest, SimpleCacheOpenWithReadAheadBadChecksum) {
+  SetSimpleCacheMode();
+  InitCache();
+
+  const char key[] = "the first key";
+  int data_size = 0;
+  ASSERT_TRUE(SimpleCacheMakeBadChecksumEntry(key, &data_size));
+
+  disk_cache::Entry* entry = NULL;
+  net::TestCompletionCallback cb;
+  EXPECT_NE(net::OK, cb.GetResult(cache_->OpenEntryWithReadAhead(
+                         key, data_size, &entry, cb.callback())));
+}
+
+// Tests that small appends to the body of an entry are kept in memory, and
+// written to disk along with the EOF records when the entry is closed.
+TEST_F(DiskCacheEntryTest, SimpleCacheWriteBuffering) {
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndEnableFeature(
+      disk_cache::kSimpleCacheWriteBuffering);
+  SetSimpleCacheMode();
+  InitCache();
+
+  const char key[] = "the first key";
+  disk_cache::Entry* entry = NULL;
+  ASSERT_THAT(CreateEntry(key, &entry), IsOk());
+
+  const int kChunkSize = 1000;
+  const int kChunkCount = 20;
+  const int kBodySize = kChunkSize * kChunkCount;
+  scoped_refptr<net::IOBuffer> body(new net::IOBuffer(kBodySize));
+  CacheTestFillBuffer(body->data(), kBodySize, false);
+  for (int i = 0; i < kChunkCount; ++i) {
+    scoped_refptr<net::IOBuffer> chunk(
+        new net::WrappedIOBuffer(body->data() + i * kChunkSize));
+    EXPECT_EQ(kChunkSize, WriteData(entry, 1, i * kChunkSize, chunk.get(),
+                                    kChunkSize, false));
+  }
+  EXPECT_EQ(kBodySize, entry->GetDataSize(1));
+
+  // Nothing was written to disk yet.
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+  const base::FilePath entry_file0_path = cache_path_.AppendASCII(
+      disk_cache::simple_util::GetFilenameFromKeyAndFileIndex(key, 0));
+  int64_t file_size = 0;
+  ASSERT_TRUE(base::GetFileSize(entry_file0_path, &file_size));
+  EXPECT_GT(kBodySize, file_size);
+
+  entry->Close();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+  ASSERT_TRUE(base::GetFileSize(entry_file0_path, &file_size));
+  EXPECT_LT(kBodySize, file_size);
+
+  // The body and its checksum were both written.
+  ASSERT_THAT(OpenEntry(key, &entry), IsOk());
+  ScopedEntryPtr entry_closer(entry);
+  scoped_refptr<net::IOBuffer> read_buffer(new net::IOBuffer(kBodySize));
+  EXPECT_EQ(kBodySize, ReadData(entry, 1, 0, read_buffer.get(), kBodySize));
+  EXPECT_EQ(0, memcmp(body->data(), read_buffer->data(), kBodySize));
+}
+
+// Tests that the buffered appends to the body of an entry are written before
+// the operations reading or changing it on disk.
+TEST_F(DiskCacheEntryTest, SimpleCacheWriteBufferingFlush) {
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndEnableFeature(
+      disk_cache::kSimpleCacheWriteBuffering);
+  SetSimpleCacheMode();
+  InitCache();
+
+  const char key[] = "the first key";
+  disk_cache::Entry* entry = NULL;
+  ASSERT_THAT(CreateEntry(key, &entry), IsOk());
+
+  const int kSize = 3000;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+  EXPECT_EQ(1000, WriteData(entry, 1, 0, buffer.get(), 1000, false));
+  EXPECT_EQ(1000, WriteData(entry, 2, 0, buffer.get(), 1000, false));
+  scoped_refptr<net::IOBuffer> chunk(
+      new net::WrappedIOBuffer(buffer->data() + 1000));
+  EXPECT_EQ(1000, WriteData(entry, 1, 1000, chunk.get(), 1000, false));
+
+  scoped_refptr<net::IOBuffer> read_buffer(new net::IOBuffer(kSize));
+  EXPECT_EQ(2000, ReadData(entry, 1, 0, read_buffer.get(), kSize));
+  EXPECT_EQ(0, memcmp(buffer->data(), read_buffer->data(), 2000));
+  EXPECT_EQ(1000, ReadData(entry, 2, 0, read_buffer.get(), kSize));
+  EXPECT_EQ(0, memcmp(buffer->data(), read_buffer->data(), 1000));
+
+  // A write over buffered data is not buffered.
+  chunk = new net::WrappedIOBuffer(buffer->data() + 2000);
+  EXPECT_EQ(1000, WriteData(entry, 1, 2000, chunk.get(), 1000, false));
+  EXPECT_EQ(1000, WriteData(entry, 1, 1500, chunk.get(), 1000, true));
+  memmove(buffer->data() + 1500, buffer->data() + 2000, 1000);
+  EXPECT_EQ(2500, entry->GetDataSize(1));
+  entry->Close();
+
+  ASSERT_THAT(OpenEntry(key, &entry), IsOk());
+  ScopedEntryPtr entry_closer(entry);
+  EXPECT_EQ(2500, ReadData(entry, 1, 0, read_buffer.get(), kSize));
+  EXPECT_EQ(0, memcmp(buffer->data(), read_buffer->data(), 2500));
+}
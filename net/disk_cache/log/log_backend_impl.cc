@@ -0,0 +1,590 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/log/log_backend_impl.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/pickle.h"
+#include "base/single_thread_task_runner.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/task_runner_util.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/log/log_entry_impl.h"
+#include "net/disk_cache/log/log_format.h"
+#include "net/disk_cache/simple/simple_util.h"
+
+using base::Time;
+
+namespace disk_cache {
+
+namespace {
+
+// The log is split in about this many segments.
+const uint64_t kSegmentsPerCache = 32;
+const uint32_t kMinSegmentSize = 64 * 1024;
+const uint32_t kMaxSegmentSize = 64 * 1024 * 1024;
+
+// A sealed segment is compacted rather than evicted when at most this fraction
+// of it is live.
+const uint32_t kMaxLiveFractionToCompact = 2;  // 1/2.
+
+// Collection stops once the log is below this fraction of the maximum size.
+const uint64_t kCollectionMarginFraction = 10;  // 1/10.
+
+// Delay before the index is checkpointed after it changed.
+const int kIndexCheckpointDelaySecs = 20;
+
+}  // namespace
+
+// Iterates over a snapshot of the entries in the cache when the iterator was
+// created, opening each in turn.
+class LogBackendImpl::LogIterator final : public Backend::Iterator {
+ public:
+  LogIterator(base::WeakPtr<LogBackendImpl> backend,
+              std::vector<uint64_t> entry_hashes)
+      : backend_(backend),
+        entry_hashes_(std::move(entry_hashes)),
+        weak_factory_(this) {}
+
+  int OpenNextEntry(Entry** next_entry,
+                    const CompletionCallback& callback) override {
+    while (backend_ && !entry_hashes_.empty()) {
+      uint64_t entry_hash = entry_hashes_.back();
+      entry_hashes_.pop_back();
+      int rv = backend_->OpenEntryFromHash(
+          std::string(), entry_hash, next_entry,
+          base::Bind(&LogIterator::OnEntryOpened, weak_factory_.GetWeakPtr(),
+                     next_entry, callback));
+      if (rv == net::OK || rv == net::ERR_IO_PENDING)
+        return rv;
+    }
+    return net::ERR_FAILED;
+  }
+
+ private:
+  // Skips the entries that were doomed or failed to load since the iterator
+  // was created.
+  void OnEntryOpened(Entry** next_entry,
+                     const CompletionCallback& callback,
+                     int result) {
+    if (result != net::OK) {
+      result = OpenNextEntry(next_entry, callback);
+      if (result == net::ERR_IO_PENDING)
+        return;
+    }
+    callback.Run(result);
+  }
+
+  base::WeakPtr<LogBackendImpl> backend_;
+  std::vector<uint64_t> entry_hashes_;
+  base::WeakPtrFactory<LogIterator> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogIterator);
+};
+
+LogBackendImpl::SegmentInfo::SegmentInfo() : size(0), live_size(0) {}
+
+LogBackendImpl::SegmentInfo::~SegmentInfo() {}
+
+LogBackendImpl::LogBackendImpl(
+    const base::FilePath& path,
+    int max_bytes,
+    net::CacheType cache_type,
+    const scoped_refptr<base::SingleThreadTaskRunner>& cache_thread)
+    : cache_type_(cache_type),
+      cache_thread_(cache_thread),
+      store_(new LogStore(path)),
+      orig_max_size_(max_bytes),
+      max_size_(0),
+      segment_size_(kMinSegmentSize),
+      head_segment_(0),
+      disk_size_(0),
+      live_size_(0),
+      weak_factory_(this) {}
+
+LogBackendImpl::~LogBackendImpl() {
+  if (max_size_)
+    WriteIndexCheckpoint();
+
+  // Entries still open outlive the backend, but are no longer written to the
+  // log.
+  std::unordered_set<LogEntryImpl*> entries;
+  entries.swap(entries_);
+  for (LogEntryImpl* entry : entries)
+    entry->OnBackendDestroyed();
+
+  cache_thread_->DeleteSoon(FROM_HERE, store_.release());
+}
+
+int LogBackendImpl::Init(const CompletionCallback& completion_callback) {
+  LogStoreLoadResult* result = new LogStoreLoadResult;
+  cache_thread_->PostTaskAndReply(
+      FROM_HERE,
+      base::Bind(&LogStore::Load, base::Unretained(store_.get()),
+                 static_cast<uint64_t>(orig_max_size_), result),
+      base::Bind(&LogBackendImpl::OnLoaded, weak_factory_.GetWeakPtr(),
+                 completion_callback, base::Owned(result)));
+  return net::ERR_IO_PENDING;
+}
+
+bool LogBackendImpl::SetMaxSize(int max_bytes) {
+  if (max_bytes < 0)
+    return false;
+  orig_max_size_ = max_bytes;
+  // Zero size means use the default, which is only known once loaded.
+  if (max_bytes && max_size_) {
+    max_size_ = max_bytes;
+    CollectSegmentsIfNeeded();
+  }
+  return true;
+}
+
+int LogBackendImpl::GetMaxFileSize() const {
+  return static_cast<int>(std::min<uint64_t>(
+      max_size_ / 8, segment_size_ - sizeof(LogRecordHeader)));
+}
+
+void LogBackendImpl::FlushIndexForTesting() {
+  WriteIndexCheckpoint();
+}
+
+void LogBackendImpl::OnEntryClosed(LogEntryImpl* entry) {
+  if (entry->doomed() || !entry->dirty())
+    return;
+
+  const uint64_t entry_hash = entry->entry_hash();
+  const bool was_in_index = RemoveFromIndex(entry_hash);
+  if (entry->GetRecordSize() > segment_size_) {
+    // Too large to be stored; the previous record is gone as well.
+    if (was_in_index)
+      AppendTombstone(entry_hash);
+    return;
+  }
+
+  LogRecordLocation location = AppendRecord(entry->BuildRecord());
+  AddToIndex(entry_hash, LogEntryMetadata(location, entry->GetLastUsed()));
+  CollectSegmentsIfNeeded();
+}
+
+void LogBackendImpl::OnEntryDoomed(LogEntryImpl* entry) {
+  DCHECK(active_entries_.count(entry->entry_hash()));
+  DCHECK_EQ(entry, active_entries_.find(entry->entry_hash())->second);
+  DoomEntryInternal(entry->entry_hash());
+}
+
+void LogBackendImpl::OnEntryDestroyed(LogEntryImpl* entry) {
+  entries_.erase(entry);
+  EntryMap::iterator it = active_entries_.find(entry->entry_hash());
+  if (it != active_entries_.end() && it->second == entry)
+    active_entries_.erase(it);
+}
+
+net::CacheType LogBackendImpl::GetCacheType() const {
+  return cache_type_;
+}
+
+int32_t LogBackendImpl::GetEntryCount() const {
+  // Entries created but not closed yet are not in the index.
+  size_t count = index_.size();
+  for (const auto& active_entry : active_entries_) {
+    if (!index_.count(active_entry.first))
+      ++count;
+  }
+  return static_cast<int32_t>(count);
+}
+
+int LogBackendImpl::OpenEntry(const std::string& key,
+                              Entry** entry,
+                              const CompletionCallback& callback) {
+  return OpenEntryFromHash(key, simple_util::GetEntryHashKey(key), entry,
+                           callback);
+}
+
+int LogBackendImpl::OpenEntryWithReadAhead(
+    const std::string& key,
+    int read_ahead_size,
+    Entry** entry,
+    const CompletionCallback& callback) {
+  return OpenEntry(key, entry, callback);
+}
+
+int LogBackendImpl::CreateEntry(const std::string& key,
+                                Entry** entry,
+                                const CompletionCallback& callback) {
+  const uint64_t entry_hash = simple_util::GetEntryHashKey(key);
+  if (active_entries_.count(entry_hash) || index_.count(entry_hash))
+    return net::ERR_FAILED;
+
+  LogEntryImpl* new_entry = new LogEntryImpl(this, key, entry_hash, false);
+  entries_.insert(new_entry);
+  active_entries_[entry_hash] = new_entry;
+  return new_entry->Open(entry, callback);
+}
+
+int LogBackendImpl::DoomEntry(const std::string& key,
+                              const CompletionCallback& callback) {
+  const uint64_t entry_hash = simple_util::GetEntryHashKey(key);
+  if (!active_entries_.count(entry_hash) && !index_.count(entry_hash))
+    return net::ERR_FAILED;
+
+  DoomEntryInternal(entry_hash);
+  return net::OK;
+}
+
+int LogBackendImpl::DoomAllEntries(const CompletionCallback& callback) {
+  for (const auto& active_entry : active_entries_)
+    active_entry.second->MarkAsDoomed();
+  active_entries_.clear();
+
+  index_.clear();
+  segments_.clear();
+  disk_size_ = 0;
+  live_size_ = 0;
+  // Segment ids keep increasing, so that no record of the old log can be
+  // mistaken for a new one.
+  segments_[++head_segment_];
+
+  cache_thread_->PostTask(FROM_HERE,
+                          base::Bind(&LogStore::DeleteAllSegments,
+                                     base::Unretained(store_.get())));
+  WriteIndexCheckpoint();
+  cache_thread_->PostTaskAndReply(FROM_HERE, base::Bind(&base::DoNothing),
+                                  base::Bind(callback, net::OK));
+  return net::ERR_IO_PENDING;
+}
+
+int LogBackendImpl::DoomEntriesBetween(Time initial_time,
+                                       Time end_time,
+                                       const CompletionCallback& callback) {
+  if (end_time.is_null())
+    end_time = Time::Max();
+
+  DCHECK_GE(end_time, initial_time);
+
+  std::vector<uint64_t> entry_hashes;
+  for (const auto& entry : index_) {
+    if (entry.second.last_used >= initial_time &&
+        entry.second.last_used < end_time) {
+      entry_hashes.push_back(entry.first);
+    }
+  }
+  for (const auto& active_entry : active_entries_) {
+    const Time last_used = active_entry.second->GetLastUsed();
+    if (!index_.count(active_entry.first) && last_used >= initial_time &&
+        last_used < end_time) {
+      entry_hashes.push_back(active_entry.first);
+    }
+  }
+
+  for (uint64_t entry_hash : entry_hashes)
+    DoomEntryInternal(entry_hash);
+  return net::OK;
+}
+
+int LogBackendImpl::DoomEntriesSince(Time initial_time,
+                                     const CompletionCallback& callback) {
+  return DoomEntriesBetween(initial_time, Time(), callback);
+}
+
+int LogBackendImpl::CalculateSizeOfAllEntries(
+    const CompletionCallback& callback) {
+  return static_cast<int>(
+      std::min<uint64_t>(live_size_, std::numeric_limits<int32_t>::max()));
+}
+
+std::unique_ptr<Backend::Iterator> LogBackendImpl::CreateIterator() {
+  std::vector<uint64_t> entry_hashes;
+  entry_hashes.reserve(index_.size() + active_entries_.size());
+  for (const auto& entry : index_)
+    entry_hashes.push_back(entry.first);
+  for (const auto& active_entry : active_entries_) {
+    if (!index_.count(active_entry.first))
+      entry_hashes.push_back(active_entry.first);
+  }
+  return std::unique_ptr<Backend::Iterator>(
+      new LogIterator(weak_factory_.GetWeakPtr(), std::move(entry_hashes)));
+}
+
+void LogBackendImpl::GetStats(base::StringPairs* stats) {
+  stats->push_back(std::make_pair("Cache type", "Log Cache"));
+  stats->push_back(
+      std::make_pair("Entries", base::SizeTToString(index_.size())));
+  stats->push_back(
+      std::make_pair("Segments", base::SizeTToString(segments_.size())));
+  stats->push_back(
+      std::make_pair("Disk size", base::Uint64ToString(disk_size_)));
+  stats->push_back(
+      std::make_pair("Live size", base::Uint64ToString(live_size_)));
+  stats->push_back(std::make_pair("Max size", base::Uint64ToString(max_size_)));
+}
+
+void LogBackendImpl::OnExternalCacheHit(const std::string& key) {
+  LogEntrySet::iterator it = index_.find(simple_util::GetEntryHashKey(key));
+  if (it != index_.end()) {
+    it->second.last_used = Time::Now();
+    ScheduleIndexCheckpoint();
+  }
+}
+
+bool LogBackendImpl::MayHaveEntry(const std::string& key) const {
+  const uint64_t entry_hash = simple_util::GetEntryHashKey(key);
+  return active_entries_.count(entry_hash) || index_.count(entry_hash);
+}
+
+void LogBackendImpl::OnLoaded(const CompletionCallback& callback,
+                              LogStoreLoadResult* result) {
+  if (result->net_error != net::OK) {
+    callback.Run(result->net_error);
+    return;
+  }
+
+  max_size_ = orig_max_size_ ? orig_max_size_ : result->max_size;
+  segment_size_ = static_cast<uint32_t>(
+      std::max<uint64_t>(kMinSegmentSize,
+                         std::min<uint64_t>(kMaxSegmentSize,
+                                            max_size_ / kSegmentsPerCache)));
+  head_segment_ = result->head_segment;
+  for (const auto& segment_size : result->segment_sizes) {
+    segments_[segment_size.first].size = segment_size.second;
+    disk_size_ += segment_size.second;
+  }
+  for (const auto& entry : result->entries)
+    AddToIndex(entry.first, entry.second);
+
+  CollectSegmentsIfNeeded();
+  callback.Run(net::OK);
+}
+
+int LogBackendImpl::OpenEntryFromHash(const std::string& key,
+                                      uint64_t entry_hash,
+                                      Entry** entry,
+                                      const CompletionCallback& callback) {
+  EntryMap::iterator active = active_entries_.find(entry_hash);
+  if (active != active_entries_.end()) {
+    LogEntryImpl* active_entry = active->second;
+    if (!key.empty() && !active_entry->key().empty() &&
+        key != active_entry->key()) {
+      return net::ERR_FAILED;
+    }
+    return active_entry->Open(entry, callback);
+  }
+
+  LogEntrySet::iterator it = index_.find(entry_hash);
+  if (it == index_.end())
+    return net::ERR_FAILED;
+  it->second.last_used = Time::Now();
+  ScheduleIndexCheckpoint();
+
+  LogEntryImpl* loading_entry = new LogEntryImpl(this, key, entry_hash, true);
+  entries_.insert(loading_entry);
+  active_entries_[entry_hash] = loading_entry;
+  int rv = loading_entry->Open(entry, callback);
+  DCHECK_EQ(net::ERR_IO_PENDING, rv);
+
+  const LogRecordLocation& location = it->second.location;
+  std::vector<char>* record = new std::vector<char>;
+  base::PostTaskAndReplyWithResult(
+      cache_thread_.get(), FROM_HERE,
+      base::Bind(&LogStore::ReadRecord, base::Unretained(store_.get()),
+                 location, entry_hash, record),
+      base::Bind(&LogBackendImpl::OnEntryRecordRead,
+                 weak_factory_.GetWeakPtr(), loading_entry, location,
+                 base::Owned(record)));
+  return rv;
+}
+
+void LogBackendImpl::OnEntryRecordRead(LogEntryImpl* entry,
+                                       const LogRecordLocation& location,
+                                       std::vector<char>* record,
+                                       int result) {
+  DCHECK(entries_.count(entry));
+  if (result != net::OK && !entry->doomed()) {
+    // The record is unreadable; forget about it, unless it was replaced since.
+    LogEntrySet::const_iterator it = index_.find(entry->entry_hash());
+    if (it != index_.end() && it->second.location.segment == location.segment &&
+        it->second.location.offset == location.offset) {
+      RemoveFromIndex(entry->entry_hash());
+    }
+  }
+  if (result == net::OK)
+    result = entry->InitFromRecord(*record);
+  entry->OnLoadComplete(result);
+}
+
+void LogBackendImpl::DoomEntryInternal(uint64_t entry_hash) {
+  EntryMap::iterator active = active_entries_.find(entry_hash);
+  if (active != active_entries_.end()) {
+    active->second->MarkAsDoomed();
+    active_entries_.erase(active);
+  }
+  if (RemoveFromIndex(entry_hash))
+    AppendTombstone(entry_hash);
+}
+
+LogRecordLocation LogBackendImpl::AllocateRecord(uint32_t size) {
+  DCHECK_LE(size, segment_size_);
+  SegmentInfo* head = &segments_[head_segment_];
+  if (head->size && head->size + size > segment_size_)
+    head = &segments_[++head_segment_];
+
+  LogRecordLocation location(head_segment_, head->size, size);
+  head->size += size;
+  disk_size_ += size;
+  return location;
+}
+
+LogRecordLocation LogBackendImpl::AppendRecord(
+    std::unique_ptr<std::vector<char>> record) {
+  LogRecordLocation location =
+      AllocateRecord(static_cast<uint32_t>(record->size()));
+  cache_thread_->PostTask(
+      FROM_HERE, base::Bind(&LogStore::WriteRecord,
+                            base::Unretained(store_.get()), location,
+                            base::Passed(&record)));
+  ScheduleIndexCheckpoint();
+  return location;
+}
+
+void LogBackendImpl::AppendTombstone(uint64_t entry_hash) {
+  LogRecordHeader header;
+  header.key_hash = entry_hash;
+  header.flags = LogRecordHeader::FLAG_TOMBSTONE;
+  header.last_modified = Time::Now().ToInternalValue();
+  const char* header_data = reinterpret_cast<const char*>(&header);
+  AppendRecord(std::unique_ptr<std::vector<char>>(
+      new std::vector<char>(header_data, header_data + sizeof(header))));
+}
+
+void LogBackendImpl::AddToIndex(uint64_t entry_hash,
+                                const LogEntryMetadata& metadata) {
+  DCHECK(!index_.count(entry_hash));
+  SegmentInfo& segment = segments_[metadata.location.segment];
+  segment.live_size += metadata.location.size;
+  segment.entries.insert(entry_hash);
+  live_size_ += metadata.location.size;
+  index_[entry_hash] = metadata;
+}
+
+bool LogBackendImpl::RemoveFromIndex(uint64_t entry_hash) {
+  LogEntrySet::iterator it = index_.find(entry_hash);
+  if (it == index_.end())
+    return false;
+
+  const LogRecordLocation& location = it->second.location;
+  SegmentInfo& segment = segments_[location.segment];
+  segment.live_size -= location.size;
+  segment.entries.erase(entry_hash);
+  live_size_ -= location.size;
+  index_.erase(it);
+  return true;
+}
+
+void LogBackendImpl::CollectSegmentsIfNeeded() {
+  if (disk_size_ <= max_size_)
+    return;
+
+  const uint64_t target_size =
+      max_size_ - max_size_ / kCollectionMarginFraction;
+  std::vector<uint32_t> collected_segments;
+  while (disk_size_ > target_size && segments_.size() > 1) {
+    // The head segment is the last one, and is never collected.
+    SegmentMap::iterator least_live = segments_.begin();
+    for (SegmentMap::iterator it = segments_.begin();
+         it->first != head_segment_; ++it) {
+      if (static_cast<uint64_t>(it->second.live_size) *
+              least_live->second.size <
+          static_cast<uint64_t>(least_live->second.live_size) *
+              it->second.size) {
+        least_live = it;
+      }
+    }
+
+    collected_segments.push_back(least_live->first);
+    if (least_live->second.live_size * kMaxLiveFractionToCompact <=
+        least_live->second.size) {
+      CompactSegment(least_live);
+    } else {
+      collected_segments.back() = segments_.begin()->first;
+      EvictSegment(segments_.begin());
+    }
+  }
+
+  if (collected_segments.empty())
+    return;
+
+  // The index must stop referring to the collected segments, and record the
+  // entries they held, before the segment files go away.
+  WriteIndexCheckpoint();
+  for (uint32_t segment : collected_segments) {
+    cache_thread_->PostTask(
+        FROM_HERE, base::Bind(&LogStore::DeleteSegment,
+                              base::Unretained(store_.get()), segment));
+  }
+}
+
+void LogBackendImpl::CompactSegment(SegmentMap::iterator segment) {
+  DCHECK_NE(head_segment_, segment->first);
+  std::vector<LogStore::RecordCopy> copies;
+  copies.reserve(segment->second.entries.size());
+  std::unordered_set<uint64_t> entries;
+  entries.swap(segment->second.entries);
+  for (uint64_t entry_hash : entries) {
+    LogEntryMetadata metadata = index_[entry_hash];
+    RemoveFromIndex(entry_hash);
+    LogRecordLocation from = metadata.location;
+    metadata.location = AllocateRecord(from.size);
+    copies.push_back(std::make_pair(from, metadata.location));
+    AddToIndex(entry_hash, metadata);
+  }
+  if (!copies.empty()) {
+    cache_thread_->PostTask(
+        FROM_HERE, base::Bind(&LogStore::CopyRecords,
+                              base::Unretained(store_.get()), copies));
+  }
+
+  disk_size_ -= segment->second.size;
+  segments_.erase(segment);
+}
+
+void LogBackendImpl::EvictSegment(SegmentMap::iterator segment) {
+  DCHECK_NE(head_segment_, segment->first);
+  std::unordered_set<uint64_t> entries;
+  entries.swap(segment->second.entries);
+  for (uint64_t entry_hash : entries) {
+    LogEntrySet::iterator it = index_.find(entry_hash);
+    live_size_ -= it->second.location.size;
+    index_.erase(it);
+  }
+
+  disk_size_ -= segment->second.size;
+  segments_.erase(segment);
+}
+
+void LogBackendImpl::ScheduleIndexCheckpoint() {
+  if (checkpoint_timer_.IsRunning())
+    return;
+  checkpoint_timer_.Start(
+      FROM_HERE, base::TimeDelta::FromSeconds(kIndexCheckpointDelaySecs),
+      base::Bind(&LogBackendImpl::WriteIndexCheckpoint,
+                 base::Unretained(this)));
+}
+
+void LogBackendImpl::WriteIndexCheckpoint() {
+  checkpoint_timer_.Stop();
+  std::unique_ptr<base::Pickle> pickle = LogStore::SerializeIndex(
+      index_, head_segment_, segments_[head_segment_].size);
+  cache_thread_->PostTask(FROM_HERE,
+                          base::Bind(&LogStore::WriteIndex,
+                                     base::Unretained(store_.get()),
+                                     base::Passed(&pickle)));
+}
+
+}  // namespace disk_cache
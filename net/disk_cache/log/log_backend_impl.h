@@ -0,0 +1,200 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_LOG_LOG_BACKEND_IMPL_H_
+#define NET_DISK_CACHE_LOG_LOG_BACKEND_IMPL_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "base/strings/string_split.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+#include "net/base/cache_type.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/log/log_store.h"
+
+namespace base {
+class SingleThreadTaskRunner;
+}  // namespace base
+
+namespace disk_cache {
+
+class LogEntryImpl;
+
+// This class implements the Backend interface with a log-structured store.
+// Entries are appended as single records to large segment files, so that the
+// number of files and of file opens does not grow with the number of entries,
+// unlike in the simple cache. An in-memory index maps entry hashes to their
+// records and is checkpointed to disk, like the SimpleIndex.
+//
+// Space is reclaimed a segment at a time. When the log grows past the maximum
+// size, the sealed segment with the least live data is compacted, copying its
+// live records to the head of the log, if at most half of it is live.
+// Otherwise the oldest segment is dropped along with the entries it holds.
+//
+// All file IO is done by a LogStore on the cache thread; this object lives on
+// the IO thread.
+class NET_EXPORT_PRIVATE LogBackendImpl final : public Backend {
+ public:
+  LogBackendImpl(
+      const base::FilePath& path,
+      int max_bytes,
+      net::CacheType cache_type,
+      const scoped_refptr<base::SingleThreadTaskRunner>& cache_thread);
+  ~LogBackendImpl() override;
+
+  // Loads the index and the log. Must be called, and complete, before any
+  // other method.
+  int Init(const CompletionCallback& completion_callback);
+
+  // Sets the maximum size for the total amount of data stored by this instance.
+  bool SetMaxSize(int max_bytes);
+
+  // Returns the maximum size for a stream of an entry.
+  int GetMaxFileSize() const;
+
+  // Writes the index checkpoint now rather than after a delay.
+  void FlushIndexForTesting();
+
+  // These next methods (before the implementation of the Backend interface) are
+  // called by LogEntryImpl to update the state of the backend during the entry
+  // lifecycle.
+
+  // Signals that the last handle to |entry| was closed, so that it is appended
+  // to the log if it was modified.
+  void OnEntryClosed(LogEntryImpl* entry);
+
+  // Signals that |entry| was doomed by its owner.
+  void OnEntryDoomed(LogEntryImpl* entry);
+
+  void OnEntryDestroyed(LogEntryImpl* entry);
+
+  // Backend interface.
+  net::CacheType GetCacheType() const override;
+  int32_t GetEntryCount() const override;
+  int OpenEntry(const std::string& key,
+                Entry** entry,
+                const CompletionCallback& callback) override;
+  int OpenEntryWithReadAhead(const std::string& key,
+                             int read_ahead_size,
+                             Entry** entry,
+                             const CompletionCallback& callback) override;
+  int CreateEntry(const std::string& key,
+                  Entry** entry,
+                  const CompletionCallback& callback) override;
+  int DoomEntry(const std::string& key,
+                const CompletionCallback& callback) override;
+  int DoomAllEntries(const CompletionCallback& callback) override;
+  int DoomEntriesBetween(base::Time initial_time,
+                         base::Time end_time,
+                         const CompletionCallback& callback) override;
+  int DoomEntriesSince(base::Time initial_time,
+                       const CompletionCallback& callback) override;
+  int CalculateSizeOfAllEntries(const CompletionCallback& callback) override;
+  std::unique_ptr<Iterator> CreateIterator() override;
+  void GetStats(base::StringPairs* stats) override;
+  void OnExternalCacheHit(const std::string& key) override;
+  bool MayHaveEntry(const std::string& key) const override;
+
+ private:
+  class LogIterator;
+  friend class LogIterator;
+
+  struct SegmentInfo {
+    SegmentInfo();
+    ~SegmentInfo();
+
+    uint32_t size;
+    // Total size of the records in the segment the index points to.
+    uint32_t live_size;
+    std::unordered_set<uint64_t> entries;
+  };
+
+  using EntryMap = std::unordered_map<uint64_t, LogEntryImpl*>;
+  using SegmentMap = std::map<uint32_t, SegmentInfo>;
+
+  void OnLoaded(const CompletionCallback& callback, LogStoreLoadResult* result);
+
+  // Opens the entry with |entry_hash|, reading it from the log unless it is
+  // already open. |key| may be empty if it is not known.
+  int OpenEntryFromHash(const std::string& key,
+                        uint64_t entry_hash,
+                        Entry** entry,
+                        const CompletionCallback& callback);
+  void OnEntryRecordRead(LogEntryImpl* entry,
+                         const LogRecordLocation& location,
+                         std::vector<char>* record,
+                         int result);
+
+  // Removes the entry with |entry_hash| from the index and from the active
+  // entries, and records its removal in the log.
+  void DoomEntryInternal(uint64_t entry_hash);
+
+  // Reserves |size| bytes at the head of the log, starting a new segment if
+  // the current one is full.
+  LogRecordLocation AllocateRecord(uint32_t size);
+  // Queues |record| for writing at the head of the log, and returns where it
+  // goes.
+  LogRecordLocation AppendRecord(std::unique_ptr<std::vector<char>> record);
+  void AppendTombstone(uint64_t entry_hash);
+
+  void AddToIndex(uint64_t entry_hash, const LogEntryMetadata& metadata);
+  // Returns false if |entry_hash| was not in the index.
+  bool RemoveFromIndex(uint64_t entry_hash);
+
+  // Collects segments until the log is below the maximum size.
+  void CollectSegmentsIfNeeded();
+  void CompactSegment(SegmentMap::iterator segment);
+  void EvictSegment(SegmentMap::iterator segment);
+
+  void ScheduleIndexCheckpoint();
+  void WriteIndexCheckpoint();
+
+  const net::CacheType cache_type_;
+  const scoped_refptr<base::SingleThreadTaskRunner> cache_thread_;
+
+  // Used on |cache_thread_| only, and deleted there.
+  std::unique_ptr<LogStore> store_;
+
+  int orig_max_size_;
+  uint64_t max_size_;
+  uint32_t segment_size_;
+
+  LogEntrySet index_;
+  SegmentMap segments_;
+  uint32_t head_segment_;
+
+  // Total size of all segments, and of the live records in them.
+  uint64_t disk_size_;
+  uint64_t live_size_;
+
+  // Entries with open handles, or being opened, by hash. Doomed entries are
+  // not in the map.
+  EntryMap active_entries_;
+  // All entry objects, including doomed ones.
+  std::unordered_set<LogEntryImpl*> entries_;
+
+  base::OneShotTimer checkpoint_timer_;
+
+  base::WeakPtrFactory<LogBackendImpl> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogBackendImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_LOG_LOG_BACKEND_IMPL_H_
@@ -0,0 +1,271 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/log/log_entry_impl.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/log/log_backend_impl.h"
+
+using base::Time;
+
+namespace disk_cache {
+
+LogEntryImpl::LogEntryImpl(LogBackendImpl* backend,
+                           const std::string& key,
+                           uint64_t entry_hash,
+                           bool loading)
+    : backend_(backend),
+      key_(key),
+      entry_hash_(entry_hash),
+      ref_count_(0),
+      loading_(loading),
+      // A new entry is written to the log even if no data is written to it.
+      dirty_(!loading),
+      doomed_(false),
+      last_modified_(Time::Now()),
+      last_used_(last_modified_) {
+  DCHECK(loading || !key.empty());
+}
+
+int LogEntryImpl::Open(Entry** out_entry, const CompletionCallback& callback) {
+  DCHECK(!doomed_);
+  ++ref_count_;
+  if (loading_) {
+    pending_opens_.push_back(std::make_pair(out_entry, callback));
+    return net::ERR_IO_PENDING;
+  }
+  last_used_ = Time::Now();
+  *out_entry = this;
+  return net::OK;
+}
+
+int LogEntryImpl::InitFromRecord(const std::vector<char>& record) {
+  DCHECK(loading_);
+  if (doomed_)
+    return net::ERR_FAILED;
+
+  LogRecordHeader header;
+  DCHECK_GE(record.size(), sizeof(header));
+  memcpy(&header, record.data(), sizeof(header));
+  DCHECK_EQ(record.size(), header.GetRecordSize());
+
+  const char* data = record.data() + sizeof(header);
+  std::string key(data, header.key_length);
+  // Another key with the same hash.
+  if (!key_.empty() && key != key_)
+    return net::ERR_FAILED;
+  key_.swap(key);
+  data += header.key_length;
+
+  for (int i = 0; i < kLogEntryStreamCount; ++i) {
+    data_[i].assign(data, data + header.stream_size[i]);
+    data += header.stream_size[i];
+  }
+  last_modified_ = Time::FromInternalValue(header.last_modified);
+  last_used_ = Time::Now();
+  loading_ = false;
+  return net::OK;
+}
+
+void LogEntryImpl::OnLoadComplete(int result) {
+  std::vector<PendingOpen> pending_opens;
+  pending_opens.swap(pending_opens_);
+  if (result != net::OK) {
+    ref_count_ = 0;
+    delete this;
+    for (const PendingOpen& pending_open : pending_opens)
+      pending_open.second.Run(result);
+    return;
+  }
+
+  // Running a callback may close the entry, so |this| must not be used from
+  // here on.
+  for (const PendingOpen& pending_open : pending_opens) {
+    *pending_open.first = this;
+    pending_open.second.Run(net::OK);
+  }
+}
+
+std::unique_ptr<std::vector<char>> LogEntryImpl::BuildRecord() const {
+  LogRecordHeader header;
+  header.key_hash = entry_hash_;
+  header.key_length = key_.size();
+  for (int i = 0; i < kLogEntryStreamCount; ++i)
+    header.stream_size[i] = data_[i].size();
+  header.last_modified = last_modified_.ToInternalValue();
+
+  std::unique_ptr<std::vector<char>> record(new std::vector<char>());
+  record->reserve(header.GetRecordSize());
+  const char* header_data = reinterpret_cast<const char*>(&header);
+  record->insert(record->end(), header_data, header_data + sizeof(header));
+  record->insert(record->end(), key_.begin(), key_.end());
+  for (const auto& stream : data_)
+    record->insert(record->end(), stream.begin(), stream.end());
+  return record;
+}
+
+uint32_t LogEntryImpl::GetRecordSize() const {
+  uint32_t size = sizeof(LogRecordHeader) + key_.size();
+  for (const auto& stream : data_)
+    size += stream.size();
+  return size;
+}
+
+void LogEntryImpl::OnBackendDestroyed() {
+  backend_ = nullptr;
+  if (!loading_)
+    return;
+  // The entry is never going to be loaded. The opens waiting for it are failed
+  // from a fresh stack, since the backend is being destroyed.
+  for (const PendingOpen& pending_open : pending_opens_) {
+    base::ThreadTaskRunnerHandle::Get()->PostTask(
+        FROM_HERE, base::Bind(pending_open.second, net::ERR_ABORTED));
+  }
+  delete this;
+}
+
+void LogEntryImpl::Doom() {
+  if (!doomed_ && backend_)
+    backend_->OnEntryDoomed(this);
+  doomed_ = true;
+}
+
+void LogEntryImpl::Close() {
+  DCHECK(!loading_);
+  --ref_count_;
+  DCHECK_GE(ref_count_, 0);
+  if (ref_count_)
+    return;
+  if (backend_)
+    backend_->OnEntryClosed(this);
+  delete this;
+}
+
+std::string LogEntryImpl::GetKey() const {
+  return key_;
+}
+
+Time LogEntryImpl::GetLastUsed() const {
+  return last_used_;
+}
+
+Time LogEntryImpl::GetLastModified() const {
+  return last_modified_;
+}
+
+int32_t LogEntryImpl::GetDataSize(int index) const {
+  if (index < 0 || index >= kLogEntryStreamCount)
+    return 0;
+  return data_[index].size();
+}
+
+int LogEntryImpl::ReadData(int index,
+                           int offset,
+                           IOBuffer* buf,
+                           int buf_len,
+                           const CompletionCallback& callback) {
+  if (index < 0 || index >= kLogEntryStreamCount || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+
+  int entry_size = data_[index].size();
+  if (offset >= entry_size || offset < 0 || !buf_len)
+    return 0;
+
+  if (offset + buf_len > entry_size)
+    buf_len = entry_size - offset;
+
+  last_used_ = Time::Now();
+  std::copy(data_[index].begin() + offset,
+            data_[index].begin() + offset + buf_len, buf->data());
+  return buf_len;
+}
+
+int LogEntryImpl::WriteData(int index,
+                            int offset,
+                            IOBuffer* buf,
+                            int buf_len,
+                            const CompletionCallback& callback,
+                            bool truncate) {
+  if (index < 0 || index >= kLogEntryStreamCount)
+    return net::ERR_INVALID_ARGUMENT;
+
+  if (offset < 0 || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+
+  if (backend_) {
+    int max_file_size = backend_->GetMaxFileSize();
+
+    // offset of buf_len could be negative numbers.
+    if (offset > max_file_size || buf_len > max_file_size ||
+        offset + buf_len > max_file_size) {
+      return net::ERR_FAILED;
+    }
+  }
+
+  int old_data_size = data_[index].size();
+  if (truncate || old_data_size < offset + buf_len) {
+    data_[index].resize(offset + buf_len);
+
+    // Zero fill any hole.
+    if (old_data_size < offset) {
+      std::fill(data_[index].begin() + old_data_size,
+                data_[index].begin() + offset, 0);
+    }
+  }
+
+  dirty_ = true;
+  last_used_ = Time::Now();
+  last_modified_ = last_used_;
+
+  if (!buf_len)
+    return 0;
+
+  std::copy(buf->data(), buf->data() + buf_len, data_[index].begin() + offset);
+  return buf_len;
+}
+
+int LogEntryImpl::ReadSparseData(int64_t offset,
+                                 IOBuffer* buf,
+                                 int buf_len,
+                                 const CompletionCallback& callback) {
+  return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+}
+
+int LogEntryImpl::WriteSparseData(int64_t offset,
+                                  IOBuffer* buf,
+                                  int buf_len,
+                                  const CompletionCallback& callback) {
+  return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+}
+
+int LogEntryImpl::GetAvailableRange(int64_t offset,
+                                    int len,
+                                    int64_t* start,
+                                    const CompletionCallback& callback) {
+  return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+}
+
+bool LogEntryImpl::CouldBeSparse() const {
+  return false;
+}
+
+int LogEntryImpl::ReadyForSparseIO(const CompletionCallback& callback) {
+  return net::OK;
+}
+
+LogEntryImpl::~LogEntryImpl() {
+  if (backend_)
+    backend_->OnEntryDestroyed(this);
+}
+
+}  // namespace disk_cache
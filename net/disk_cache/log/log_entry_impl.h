@@ -0,0 +1,133 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_LOG_LOG_ENTRY_IMPL_H_
+#define NET_DISK_CACHE_LOG_LOG_ENTRY_IMPL_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/time/time.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/log/log_format.h"
+
+namespace disk_cache {
+
+class LogBackendImpl;
+
+// This class implements the Entry interface for the log-structured cache. An
+// entry is read from the log as a whole when it is opened, and is served from
+// memory while open. If it was modified, the whole entry is appended to the
+// log as a new record when its last handle is closed; the previous record
+// becomes garbage.
+//
+// This suits entries that are small compared to a segment, which is what the
+// backend is meant for. Sparse data is not supported.
+class NET_EXPORT_PRIVATE LogEntryImpl final : public Entry {
+ public:
+  // Creates an entry for |key| with hash |entry_hash|. If |loading| is true,
+  // the entry waits to be initialized from its record by InitFromRecord(), and
+  // |key| may be empty, in which case the key is read from the record.
+  LogEntryImpl(LogBackendImpl* backend,
+               const std::string& key,
+               uint64_t entry_hash,
+               bool loading);
+
+  const std::string& key() const { return key_; }
+  uint64_t entry_hash() const { return entry_hash_; }
+  bool loading() const { return loading_; }
+  bool dirty() const { return dirty_; }
+  bool doomed() const { return doomed_; }
+
+  // Adds a handle to the entry, returned through |out_entry| right away, or
+  // through |callback| once the entry is loaded.
+  int Open(Entry** out_entry, const CompletionCallback& callback);
+
+  // Initializes the streams of a loading entry from |record|, which the
+  // backend read and validated. Returns a net error code.
+  int InitFromRecord(const std::vector<char>& record);
+
+  // Completes the opens waiting for the entry to load. If |result| is an
+  // error, the entry is deleted.
+  void OnLoadComplete(int result);
+
+  // Builds the record to append to the log for the current contents of the
+  // entry.
+  std::unique_ptr<std::vector<char>> BuildRecord() const;
+
+  // Returns the size of the record BuildRecord() would return.
+  uint32_t GetRecordSize() const;
+
+  void MarkAsDoomed() { doomed_ = true; }
+
+  // Detaches the entry from the backend, which is going away. An entry still
+  // loading is deleted, as it was never handed out, and its pending opens fail
+  // with net::ERR_ABORTED.
+  void OnBackendDestroyed();
+
+  // From disk_cache::Entry:
+  void Doom() override;
+  void Close() override;
+  std::string GetKey() const override;
+  base::Time GetLastUsed() const override;
+  base::Time GetLastModified() const override;
+  int32_t GetDataSize(int index) const override;
+  int ReadData(int index,
+               int offset,
+               IOBuffer* buf,
+               int buf_len,
+               const CompletionCallback& callback) override;
+  int WriteData(int index,
+                int offset,
+                IOBuffer* buf,
+                int buf_len,
+                const CompletionCallback& callback,
+                bool truncate) override;
+  int ReadSparseData(int64_t offset,
+                     IOBuffer* buf,
+                     int buf_len,
+                     const CompletionCallback& callback) override;
+  int WriteSparseData(int64_t offset,
+                      IOBuffer* buf,
+                      int buf_len,
+                      const CompletionCallback& callback) override;
+  int GetAvailableRange(int64_t offset,
+                        int len,
+                        int64_t* start,
+                        const CompletionCallback& callback) override;
+  bool CouldBeSparse() const override;
+  void CancelSparseIO() override {}
+  int ReadyForSparseIO(const CompletionCallback& callback) override;
+
+ private:
+  using PendingOpen = std::pair<Entry**, CompletionCallback>;
+
+  ~LogEntryImpl() override;
+
+  LogBackendImpl* backend_;  // Back pointer to the cache, null after it's gone.
+  std::string key_;
+  const uint64_t entry_hash_;
+  std::vector<char> data_[kLogEntryStreamCount];
+  int ref_count_;
+
+  bool loading_;  // True until the entry is read from the log.
+  bool dirty_;    // True if the entry must be appended to the log on close.
+  bool doomed_;   // True if this entry was removed from the cache.
+
+  std::vector<PendingOpen> pending_opens_;
+
+  base::Time last_modified_;
+  base::Time last_used_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogEntryImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_LOG_LOG_ENTRY_IMPL_H_
@@ -0,0 +1,24 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/log/log_format.h"
+
+#include <cstring>
+
+namespace disk_cache {
+
+LogRecordHeader::LogRecordHeader() {
+  // Make hashing repeatable: leave no padding bytes untouched.
+  std::memset(this, 0, sizeof(*this));
+  magic_number = kLogRecordMagicNumber;
+}
+
+uint64_t LogRecordHeader::GetRecordSize() const {
+  uint64_t size = sizeof(LogRecordHeader) + key_length;
+  for (int i = 0; i < kLogEntryStreamCount; ++i)
+    size += stream_size[i];
+  return size;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,57 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_LOG_LOG_FORMAT_H_
+#define NET_DISK_CACHE_LOG_LOG_FORMAT_H_
+
+#include <stdint.h>
+
+#include "net/base/net_export.h"
+
+namespace disk_cache {
+
+const uint64_t kLogRecordMagicNumber = UINT64_C(0x8b3d2f6ac4e10975);
+const uint64_t kLogIndexMagicNumber = UINT64_C(0x6c6f672d696e6478);
+
+// Changing the format of a record or of the index requires bumping
+// |kLogVersion|. Caches written with another version are discarded.
+const uint32_t kLogVersion = 1;
+
+static const int kLogEntryStreamCount = 3;
+
+// The log backend stores entries in segment files named "log_<id>", with
+// increasing ids. Records are only ever appended to the segment with the
+// highest id; older segments are immutable until they are garbage collected.
+//
+// A segment file is a sequence of records, each consisting of:
+//   - a LogRecordHeader.
+//   - the key.
+//   - the data from stream 0, stream 1 and stream 2, back to back.
+//
+// A record with FLAG_TOMBSTONE set has no key and no data. It marks the entry
+// with |key_hash| as doomed, so that replaying the log after a crash does not
+// bring the entry back.
+struct NET_EXPORT_PRIVATE LogRecordHeader {
+  enum Flags {
+    FLAG_TOMBSTONE = (1U << 0),
+  };
+
+  LogRecordHeader();
+
+  // Returns the size of the record this header starts.
+  uint64_t GetRecordSize() const;
+
+  uint64_t magic_number;
+  uint64_t key_hash;
+  uint32_t flags;
+  uint32_t key_length;
+  uint32_t stream_size[kLogEntryStreamCount];
+  // CRC32 of the key and the data of all streams.
+  uint32_t data_crc32;
+  int64_t last_modified;
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_LOG_LOG_FORMAT_H_
@@ -0,0 +1,406 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/log/log_store.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "base/files/file_enumerator.h"
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "base/numerics/safe_conversions.h"
+#include "base/pickle.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/sys_info.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/cache_util.h"
+#include "net/disk_cache/log/log_format.h"
+#include "third_party/zlib/zlib.h"
+
+namespace disk_cache {
+
+namespace {
+
+const char kIndexFileName[] = "log-index";
+const char kTempIndexFileName[] = "log-index-temp";
+const char kSegmentFilePrefix[] = "log_";
+const base::FilePath::CharType kSegmentFilePattern[] =
+    FILE_PATH_LITERAL("log_*");
+
+// Bounds the number of entries a corrupt checkpoint can make us allocate.
+const uint64_t kMaxEntriesInIndex = 100000000;
+
+struct PickleHeader : public base::Pickle::Header {
+  uint32_t crc;
+};
+
+uint32_t CalculatePickleCRC(const base::Pickle& pickle) {
+  return crc32(crc32(0, Z_NULL, 0),
+               reinterpret_cast<const Bytef*>(pickle.payload()),
+               pickle.payload_size());
+}
+
+uint32_t CalculateRecordCRC(const char* payload, size_t payload_size) {
+  return crc32(crc32(0, Z_NULL, 0), reinterpret_cast<const Bytef*>(payload),
+               payload_size);
+}
+
+// Returns true if |header| starts a record that fits in |available| bytes.
+bool IsValidRecordHeader(const LogRecordHeader& header, uint64_t available) {
+  if (header.magic_number != kLogRecordMagicNumber)
+    return false;
+  if (header.flags & LogRecordHeader::FLAG_TOMBSTONE &&
+      header.GetRecordSize() != sizeof(LogRecordHeader)) {
+    return false;
+  }
+  return header.GetRecordSize() <= available;
+}
+
+bool ParseSegmentFileName(const base::FilePath& file_path, uint32_t* segment) {
+  const std::string name = file_path.BaseName().MaybeAsASCII();
+  if (!base::StartsWith(name, kSegmentFilePrefix, base::CompareCase::SENSITIVE))
+    return false;
+  unsigned id;
+  if (!base::StringToUint(name.substr(strlen(kSegmentFilePrefix)), &id))
+    return false;
+  *segment = id;
+  return true;
+}
+
+}  // namespace
+
+LogRecordLocation::LogRecordLocation() : segment(0), offset(0), size(0) {}
+
+LogRecordLocation::LogRecordLocation(uint32_t segment,
+                                     uint32_t offset,
+                                     uint32_t size)
+    : segment(segment), offset(offset), size(size) {}
+
+LogEntryMetadata::LogEntryMetadata() {}
+
+LogEntryMetadata::LogEntryMetadata(const LogRecordLocation& location,
+                                   base::Time last_used)
+    : location(location), last_used(last_used) {}
+
+LogStoreLoadResult::LogStoreLoadResult()
+    : net_error(net::OK), max_size(0), head_segment(0) {}
+
+LogStoreLoadResult::~LogStoreLoadResult() {}
+
+LogStore::LogStore(const base::FilePath& path)
+    : path_(path),
+      index_file_(path.AppendASCII(kIndexFileName)),
+      temp_index_file_(path.AppendASCII(kTempIndexFileName)) {}
+
+LogStore::~LogStore() {}
+
+void LogStore::Load(uint64_t suggested_max_size,
+                    LogStoreLoadResult* out_result) {
+  out_result->max_size = suggested_max_size;
+  if (!base::DirectoryExists(path_) && !base::CreateDirectory(path_)) {
+    LOG(ERROR) << "Log Cache Backend: could not create the cache directory";
+    out_result->net_error = net::ERR_FAILED;
+    return;
+  }
+  if (!out_result->max_size) {
+    int64_t available = base::SysInfo::AmountOfFreeDiskSpace(path_);
+    out_result->max_size = disk_cache::PreferredCacheSize(available);
+  }
+
+  std::map<uint32_t, uint32_t>& segment_sizes = out_result->segment_sizes;
+  base::FileEnumerator enumerator(path_, false /* recursive */,
+                                  base::FileEnumerator::FILES,
+                                  kSegmentFilePattern);
+  for (base::FilePath file_path = enumerator.Next(); !file_path.empty();
+       file_path = enumerator.Next()) {
+    uint32_t segment;
+    int64_t size = enumerator.GetInfo().GetSize();
+    if (!ParseSegmentFileName(file_path, &segment) || size < 0 ||
+        size > std::numeric_limits<uint32_t>::max()) {
+      continue;
+    }
+    segment_sizes[segment] = static_cast<uint32_t>(size);
+  }
+
+  // Start from the checkpoint if there is a valid one, otherwise from the
+  // beginning of the log.
+  uint32_t replay_segment = 0;
+  uint32_t replay_offset = 0;
+  LogEntrySet& entries = out_result->entries;
+  std::string index_contents;
+  if (base::ReadFileToString(index_file_, &index_contents) &&
+      DeserializeIndex(index_contents.data(),
+                       base::checked_cast<int>(index_contents.size()), &entries,
+                       &replay_segment, &replay_offset)) {
+    for (LogEntrySet::iterator it = entries.begin(); it != entries.end();) {
+      const LogRecordLocation& location = it->second.location;
+      std::map<uint32_t, uint32_t>::const_iterator segment =
+          segment_sizes.find(location.segment);
+      if (segment == segment_sizes.end() ||
+          static_cast<uint64_t>(location.offset) + location.size >
+              segment->second) {
+        it = entries.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  } else {
+    entries.clear();
+    replay_offset = 0;
+    replay_segment = segment_sizes.empty() ? 0 : segment_sizes.begin()->first;
+  }
+
+  for (std::map<uint32_t, uint32_t>::iterator it =
+           segment_sizes.lower_bound(replay_segment);
+       it != segment_sizes.end(); ++it) {
+    uint32_t offset = it->first == replay_segment ? replay_offset : 0;
+    if (offset > it->second)
+      offset = 0;
+    it->second = ReplaySegment(it->first, offset, it->second, &entries);
+  }
+
+  out_result->head_segment =
+      segment_sizes.empty()
+          ? replay_segment
+          : std::max(replay_segment, segment_sizes.rbegin()->first);
+  segment_sizes.insert(std::make_pair(out_result->head_segment, 0));
+}
+
+void LogStore::WriteRecord(const LogRecordLocation& location,
+                           std::unique_ptr<std::vector<char>> record) {
+  DCHECK_EQ(location.size, record->size());
+  DCHECK_GE(record->size(), sizeof(LogRecordHeader));
+  LogRecordHeader* header = reinterpret_cast<LogRecordHeader*>(record->data());
+  header->data_crc32 =
+      CalculateRecordCRC(record->data() + sizeof(LogRecordHeader),
+                         record->size() - sizeof(LogRecordHeader));
+
+  base::File* file = GetSegmentFile(location.segment);
+  if (!file || file->Write(location.offset, record->data(),
+                           base::checked_cast<int>(record->size())) !=
+                   base::checked_cast<int>(record->size())) {
+    LOG(WARNING) << "Log Cache Backend: could not write a record";
+  }
+}
+
+int LogStore::ReadRecord(const LogRecordLocation& location,
+                         uint64_t key_hash,
+                         std::vector<char>* record) {
+  base::File* file = GetSegmentFile(location.segment);
+  if (!file || location.size < sizeof(LogRecordHeader))
+    return net::ERR_FAILED;
+
+  record->resize(location.size);
+  int size = base::checked_cast<int>(location.size);
+  if (file->Read(location.offset, record->data(), size) != size)
+    return net::ERR_FAILED;
+
+  LogRecordHeader header;
+  memcpy(&header, record->data(), sizeof(header));
+  if (!IsValidRecordHeader(header, location.size) ||
+      header.GetRecordSize() != location.size ||
+      header.flags & LogRecordHeader::FLAG_TOMBSTONE ||
+      header.key_hash != key_hash) {
+    return net::ERR_FAILED;
+  }
+  if (header.data_crc32 !=
+      CalculateRecordCRC(record->data() + sizeof(header),
+                         location.size - sizeof(header))) {
+    return net::ERR_CACHE_CHECKSUM_MISMATCH;
+  }
+  return net::OK;
+}
+
+void LogStore::CopyRecords(const std::vector<RecordCopy>& copies) {
+  std::vector<char> buffer;
+  for (const RecordCopy& copy : copies) {
+    const LogRecordLocation& from = copy.first;
+    const LogRecordLocation& to = copy.second;
+    DCHECK_EQ(from.size, to.size);
+    base::File* from_file = GetSegmentFile(from.segment);
+    base::File* to_file = GetSegmentFile(to.segment);
+    if (!from_file || !to_file)
+      continue;
+    buffer.resize(from.size);
+    int size = base::checked_cast<int>(from.size);
+    // A record that cannot be read is left out; the entry then fails to open
+    // and is dropped from the index.
+    if (from_file->Read(from.offset, buffer.data(), size) != size ||
+        to_file->Write(to.offset, buffer.data(), size) != size) {
+      LOG(WARNING) << "Log Cache Backend: could not copy a record";
+    }
+  }
+}
+
+void LogStore::DeleteSegment(uint32_t segment) {
+  segment_files_.erase(segment);
+  base::DeleteFile(GetSegmentFilePath(path_, segment), false);
+}
+
+void LogStore::DeleteAllSegments() {
+  std::map<uint32_t, std::unique_ptr<base::File>> segment_files;
+  segment_files.swap(segment_files_);
+  segment_files.clear();
+
+  base::FileEnumerator enumerator(path_, false /* recursive */,
+                                  base::FileEnumerator::FILES,
+                                  kSegmentFilePattern);
+  for (base::FilePath file_path = enumerator.Next(); !file_path.empty();
+       file_path = enumerator.Next()) {
+    uint32_t segment;
+    if (ParseSegmentFileName(file_path, &segment))
+      base::DeleteFile(file_path, false);
+  }
+}
+
+void LogStore::WriteIndex(std::unique_ptr<base::Pickle> pickle) {
+  int size = base::checked_cast<int>(pickle->size());
+  if (base::WriteFile(temp_index_file_,
+                      static_cast<const char*>(pickle->data()),
+                      size) != size) {
+    LOG(ERROR) << "Failed to write the temporary log index file";
+    base::DeleteFile(temp_index_file_, false);
+    return;
+  }
+  // Atomically rename the temporary index file to become the real one.
+  base::ReplaceFile(temp_index_file_, index_file_, nullptr);
+}
+
+// static
+std::unique_ptr<base::Pickle> LogStore::SerializeIndex(
+    const LogEntrySet& entries,
+    uint32_t head_segment,
+    uint32_t head_offset) {
+  std::unique_ptr<base::Pickle> pickle(new base::Pickle(sizeof(PickleHeader)));
+  pickle->WriteUInt64(kLogIndexMagicNumber);
+  pickle->WriteUInt32(kLogVersion);
+  pickle->WriteUInt32(head_segment);
+  pickle->WriteUInt32(head_offset);
+  pickle->WriteUInt64(entries.size());
+  for (const auto& entry : entries) {
+    const LogRecordLocation& location = entry.second.location;
+    pickle->WriteUInt64(entry.first);
+    pickle->WriteUInt32(location.segment);
+    pickle->WriteUInt32(location.offset);
+    pickle->WriteUInt32(location.size);
+    pickle->WriteInt64(entry.second.last_used.ToInternalValue());
+  }
+  pickle->headerT<PickleHeader>()->crc = CalculatePickleCRC(*pickle);
+  return pickle;
+}
+
+// static
+bool LogStore::DeserializeIndex(const char* data,
+                                int data_len,
+                                LogEntrySet* entries,
+                                uint32_t* head_segment,
+                                uint32_t* head_offset) {
+  entries->clear();
+  base::Pickle pickle(data, data_len);
+  if (!pickle.data() ||
+      pickle.headerT<PickleHeader>()->crc != CalculatePickleCRC(pickle)) {
+    LOG(WARNING) << "Corrupt Log Cache index file.";
+    return false;
+  }
+
+  base::PickleIterator it(pickle);
+  uint64_t magic_number;
+  uint32_t version;
+  uint64_t entry_count;
+  if (!it.ReadUInt64(&magic_number) || magic_number != kLogIndexMagicNumber ||
+      !it.ReadUInt32(&version) || version != kLogVersion ||
+      !it.ReadUInt32(head_segment) || !it.ReadUInt32(head_offset) ||
+      !it.ReadUInt64(&entry_count) || entry_count > kMaxEntriesInIndex) {
+    return false;
+  }
+
+  entries->reserve(entry_count);
+  for (uint64_t i = 0; i < entry_count; ++i) {
+    uint64_t key_hash;
+    LogEntryMetadata metadata;
+    int64_t last_used;
+    if (!it.ReadUInt64(&key_hash) ||
+        !it.ReadUInt32(&metadata.location.segment) ||
+        !it.ReadUInt32(&metadata.location.offset) ||
+        !it.ReadUInt32(&metadata.location.size) || !it.ReadInt64(&last_used)) {
+      entries->clear();
+      return false;
+    }
+    metadata.last_used = base::Time::FromInternalValue(last_used);
+    (*entries)[key_hash] = metadata;
+  }
+  return true;
+}
+
+// static
+base::FilePath LogStore::GetSegmentFilePath(const base::FilePath& path,
+                                            uint32_t segment) {
+  return path.AppendASCII(
+      base::StringPrintf("%s%06u", kSegmentFilePrefix, segment));
+}
+
+base::File* LogStore::GetSegmentFile(uint32_t segment) {
+  std::unique_ptr<base::File>& file = segment_files_[segment];
+  if (!file) {
+    file.reset(new base::File(GetSegmentFilePath(path_, segment),
+                              base::File::FLAG_OPEN_ALWAYS |
+                                  base::File::FLAG_READ |
+                                  base::File::FLAG_WRITE |
+                                  base::File::FLAG_SHARE_DELETE));
+  }
+  if (!file->IsValid()) {
+    segment_files_.erase(segment);
+    return nullptr;
+  }
+  return file.get();
+}
+
+uint32_t LogStore::ReplaySegment(uint32_t segment,
+                                 uint32_t offset,
+                                 uint32_t size,
+                                 LogEntrySet* entries) {
+  base::File* file = GetSegmentFile(segment);
+  if (!file)
+    return offset;
+
+  std::vector<char> payload;
+  while (size - offset >= sizeof(LogRecordHeader)) {
+    LogRecordHeader header;
+    if (file->Read(offset, reinterpret_cast<char*>(&header), sizeof(header)) !=
+            static_cast<int>(sizeof(header)) ||
+        !IsValidRecordHeader(header, size - offset)) {
+      break;
+    }
+    uint32_t record_size = static_cast<uint32_t>(header.GetRecordSize());
+    payload.resize(record_size - sizeof(header));
+    int payload_size = static_cast<int>(payload.size());
+    if (file->Read(offset + sizeof(header), payload.data(), payload_size) !=
+            payload_size ||
+        header.data_crc32 != CalculateRecordCRC(payload.data(),
+                                                payload.size())) {
+      break;
+    }
+
+    if (header.flags & LogRecordHeader::FLAG_TOMBSTONE) {
+      entries->erase(header.key_hash);
+    } else {
+      (*entries)[header.key_hash] = LogEntryMetadata(
+          LogRecordLocation(segment, offset, record_size),
+          base::Time::FromInternalValue(header.last_modified));
+    }
+    offset += record_size;
+  }
+
+  // Drop whatever a crash left half written at the end of the segment.
+  if (offset != size)
+    file->SetLength(offset);
+  return offset;
+}
+
+}  // namespace disk_cache
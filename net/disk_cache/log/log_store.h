@@ -0,0 +1,153 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_LOG_LOG_STORE_H_
+#define NET_DISK_CACHE_LOG_LOG_STORE_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+
+namespace base {
+class Pickle;
+}
+
+namespace disk_cache {
+
+// The position of a record in the log.
+struct NET_EXPORT_PRIVATE LogRecordLocation {
+  LogRecordLocation();
+  LogRecordLocation(uint32_t segment, uint32_t offset, uint32_t size);
+
+  uint32_t segment;
+  uint32_t offset;
+  uint32_t size;
+};
+
+// What the index keeps about each entry stored in the log.
+struct NET_EXPORT_PRIVATE LogEntryMetadata {
+  LogEntryMetadata();
+  LogEntryMetadata(const LogRecordLocation& location, base::Time last_used);
+
+  LogRecordLocation location;
+  base::Time last_used;
+};
+
+using LogEntrySet = std::unordered_map<uint64_t, LogEntryMetadata>;
+
+struct NET_EXPORT_PRIVATE LogStoreLoadResult {
+  LogStoreLoadResult();
+  ~LogStoreLoadResult();
+
+  int net_error;
+  uint64_t max_size;
+  LogEntrySet entries;
+  // The size of every segment on disk, by segment id. Always contains
+  // |head_segment|.
+  std::map<uint32_t, uint32_t> segment_sizes;
+  // The segment new records are appended to.
+  uint32_t head_segment;
+};
+
+// Performs the file IO of the log backend: appending and reading records in
+// the segment files, copying live records out of segments being garbage
+// collected, and writing the index checkpoint.
+//
+// The index checkpoint ("log-index") is a pickle holding the location and last
+// use time of every entry, and the end of the log when it was taken. On load,
+// the checkpoint is read and the records appended after it are replayed, so
+// that only entries written in the last moments before a crash need a log
+// scan. Without a valid checkpoint the whole log is scanned.
+//
+// LogStore is not thread safe: it is created on the IO thread but all other
+// methods, and the destructor, must run on the cache thread. Callers post
+// tasks in the order their effects must reach the disk.
+class NET_EXPORT_PRIVATE LogStore {
+ public:
+  // A live record to copy from a segment being collected to the head of the
+  // log.
+  using RecordCopy = std::pair<LogRecordLocation, LogRecordLocation>;
+
+  explicit LogStore(const base::FilePath& path);
+  ~LogStore();
+
+  // Creates the cache directory if needed, loads the index checkpoint and
+  // replays the log after it. If |suggested_max_size| is zero, the maximum
+  // size is derived from the available disk space.
+  void Load(uint64_t suggested_max_size, LogStoreLoadResult* out_result);
+
+  // Writes |record|, as built by the backend, at |location|. The CRC of the
+  // record is computed here so that the IO thread does not have to.
+  void WriteRecord(const LogRecordLocation& location,
+                   std::unique_ptr<std::vector<char>> record);
+
+  // Reads and validates the record at |location| into |record|. Returns a net
+  // error code.
+  int ReadRecord(const LogRecordLocation& location,
+                 uint64_t key_hash,
+                 std::vector<char>* record);
+
+  // Copies records between segments, as listed in |copies|.
+  void CopyRecords(const std::vector<RecordCopy>& copies);
+
+  void DeleteSegment(uint32_t segment);
+  void DeleteAllSegments();
+
+  // Atomically replaces the index checkpoint with |pickle|, as returned by
+  // SerializeIndex().
+  void WriteIndex(std::unique_ptr<base::Pickle> pickle);
+
+  // Serializes a checkpoint of |entries|, taken when the log ends at
+  // |head_offset| in |head_segment|.
+  static std::unique_ptr<base::Pickle> SerializeIndex(
+      const LogEntrySet& entries,
+      uint32_t head_segment,
+      uint32_t head_offset);
+
+  // Parses a checkpoint written by SerializeIndex(). Returns false if it is
+  // corrupt or from another version.
+  static bool DeserializeIndex(const char* data,
+                               int data_len,
+                               LogEntrySet* entries,
+                               uint32_t* head_segment,
+                               uint32_t* head_offset);
+
+  static base::FilePath GetSegmentFilePath(const base::FilePath& path,
+                                           uint32_t segment);
+
+ private:
+  // Returns the open file for |segment|, opening or creating it if needed, or
+  // nullptr on failure.
+  base::File* GetSegmentFile(uint32_t segment);
+
+  // Replays the records in |segment| from |offset| on into |entries|, and
+  // truncates the segment after its last valid record. Returns the new size
+  // of the segment.
+  uint32_t ReplaySegment(uint32_t segment,
+                         uint32_t offset,
+                         uint32_t size,
+                         LogEntrySet* entries);
+
+  const base::FilePath path_;
+  const base::FilePath index_file_;
+  const base::FilePath temp_index_file_;
+
+  std::map<uint32_t, std::unique_ptr<base::File>> segment_files_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogStore);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_LOG_LOG_STORE_H_
@@ -8,7 +8,9 @@
 #include <functional>
 #include <utility>
 
+#include "base/hash.h"
 #include "base/logging.h"
+#include "base/memory/ptr_util.h"
 #include "base/sys_info.h"
 #include "net/base/net_errors.h"
 #include "net/disk_cache/cache_util.h"
@@ -28,24 +30,40 @@ bool CheckLRUListOrder(const base::LinkedList<MemEntryImpl>& lru_list) {
   base::Time previous_last_use_time;
   for (base::LinkNode<MemEntryImpl>* node = lru_list.head();
        node != lru_list.end(); node = node->next()) {
-    if (node->value()->GetLastUsed() < previous_last_use_time)
+    if (node->value()->last_used() < previous_last_use_time)
       return false;
-    previous_last_use_time = node->value()->GetLastUsed();
+    previous_last_use_time = node->value()->last_used();
   }
   return true;
 }
 
 }  // namespace
 
+MemBackendImpl::Shard::Shard() : size(0), pooled_size(0) {}
+
+MemBackendImpl::Shard::~Shard() {}
+
 MemBackendImpl::MemBackendImpl(net::NetLog* net_log)
+    : MemBackendImpl(net_log, 1) {}
+
+MemBackendImpl::MemBackendImpl(net::NetLog* net_log, int shard_count)
     : max_size_(0), current_size_(0), net_log_(net_log), weak_factory_(this) {
+  DCHECK_GE(shard_count, 1);
+  for (int i = 0; i < shard_count; ++i)
+    shards_.push_back(base::WrapUnique(new Shard()));
 }
 
 MemBackendImpl::~MemBackendImpl() {
-  DCHECK(CheckLRUListOrder(lru_list_));
-  while (!entries_.empty())
-    entries_.begin()->second->Doom();
-  DCHECK(!current_size_);
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    Shard* shard = shards_[i].get();
+    base::AutoLock lock(shard->lock);
+    DCHECK(CheckLRUListOrder(shard->lru_list));
+    while (!shard->entries.empty())
+      shard->entries.begin()->second->InternalDoom();
+    ReleaseFreeBlocks(i);
+    DCHECK(!shard->size);
+  }
+  DCHECK(!GetCurrentSize());
 }
 
 // static
@@ -60,6 +78,21 @@ std::unique_ptr<Backend> MemBackendImpl::CreateBackend(int max_bytes,
   return nullptr;
 }
 
+// static
+std::unique_ptr<Backend> MemBackendImpl::CreateShardedBackend(
+    int max_bytes,
+    int shard_count,
+    net::NetLog* net_log) {
+  std::unique_ptr<MemBackendImpl> cache(
+      new MemBackendImpl(net_log, shard_count));
+  cache->SetMaxSize(max_bytes);
+  if (cache->Init())
+    return std::move(cache);
+
+  LOG(ERROR) << "Unable to create cache";
+  return nullptr;
+}
+
 bool MemBackendImpl::Init() {
   if (max_size_)
     return true;
@@ -100,29 +133,62 @@ int MemBackendImpl::MaxFileSize() const {
   return max_size_ / 8;
 }
 
+void MemBackendImpl::EvictTo(int32_t target_size) {
+  const int32_t shard_target_size = target_size / shards_.size();
+  for (size_t i = 0; i < shards_.size() && GetCurrentSize() > target_size;
+       ++i) {
+    base::AutoLock lock(shards_[i]->lock);
+    EvictFromShard(i, target_size, shard_target_size);
+  }
+}
+
+base::Lock& MemBackendImpl::GetShardLock(int shard) {
+  return shards_[shard]->lock;
+}
+
+MemBlockPool* MemBackendImpl::GetBlockPool(int shard) {
+  shards_[shard]->lock.AssertAcquired();
+  return &shards_[shard]->block_pool;
+}
+
 void MemBackendImpl::OnEntryInserted(MemEntryImpl* entry) {
-  lru_list_.Append(entry);
+  Shard* shard = shards_[entry->shard()].get();
+  shard->lock.AssertAcquired();
+  shard->lru_list.Append(entry);
 }
 
 void MemBackendImpl::OnEntryUpdated(MemEntryImpl* entry) {
-  DCHECK(CheckLRUListOrder(lru_list_));
-  // LinkedList<>::RemoveFromList() removes |entry| from |lru_list_|.
+  Shard* shard = shards_[entry->shard()].get();
+  shard->lock.AssertAcquired();
+  DCHECK(CheckLRUListOrder(shard->lru_list));
+  // LinkedList<>::RemoveFromList() removes |entry| from the LRU list.
   entry->RemoveFromList();
-  lru_list_.Append(entry);
+  shard->lru_list.Append(entry);
 }
 
 void MemBackendImpl::OnEntryDoomed(MemEntryImpl* entry) {
-  DCHECK(CheckLRUListOrder(lru_list_));
+  Shard* shard = shards_[entry->shard()].get();
+  shard->lock.AssertAcquired();
+  DCHECK(CheckLRUListOrder(shard->lru_list));
   if (entry->type() == MemEntryImpl::PARENT_ENTRY)
-    entries_.erase(entry->key());
-  // LinkedList<>::RemoveFromList() removes |entry| from |lru_list_|.
+    shard->entries.erase(entry->key());
+  // LinkedList<>::RemoveFromList() removes |entry| from the LRU list.
   entry->RemoveFromList();
 }
 
-void MemBackendImpl::ModifyStorageSize(int32_t delta) {
-  current_size_ += delta;
+void MemBackendImpl::ModifyStorageSize(int shard, int32_t delta) {
+  Shard* modified_shard = shards_[shard].get();
+  modified_shard->lock.AssertAcquired();
+  // Blocks kept by the pool take memory like the blocks of entries, so an
+  // entry growing into them leaves the size unchanged.
+  const int32_t pooled_size = static_cast<int32_t>(
+      modified_shard->block_pool.free_block_count() * MemBlockPool::kBlockSize);
+  delta += pooled_size - modified_shard->pooled_size;
+  modified_shard->pooled_size = pooled_size;
+  modified_shard->size += delta;
+  base::subtle::NoBarrier_AtomicIncrement(&current_size_, delta);
   if (delta > 0)
-    EvictIfNeeded();
+    EvictIfNeeded(shard);
 }
 
 net::CacheType MemBackendImpl::GetCacheType() const {
@@ -130,14 +196,21 @@ net::CacheType MemBackendImpl::GetCacheType() const {
 }
 
 int32_t MemBackendImpl::GetEntryCount() const {
-  return static_cast<int32_t>(entries_.size());
+  size_t count = 0;
+  for (const auto& shard : shards_) {
+    base::AutoLock lock(shard->lock);
+    count += shard->entries.size();
+  }
+  return static_cast<int32_t>(count);
 }
 
 int MemBackendImpl::OpenEntry(const std::string& key,
                               Entry** entry,
                               const CompletionCallback& callback) {
-  EntryMap::iterator it = entries_.find(key);
-  if (it == entries_.end())
+  Shard* shard = shards_[GetShardForKey(key)].get();
+  base::AutoLock lock(shard->lock);
+  EntryMap::iterator it = shard->entries.find(key);
+  if (it == shard->entries.end())
     return net::ERR_FAILED;
 
   it->second->Open();
@@ -146,16 +219,29 @@ int MemBackendImpl::OpenEntry(const std::string& key,
   return net::OK;
 }
 
+int MemBackendImpl::OpenEntryWithReadAhead(
+    const std::string& key,
+    int read_ahead_size,
+    Entry** entry,
+    const CompletionCallback& callback) {
+  // All the data is in memory already.
+  return OpenEntry(key, entry, callback);
+}
+
 int MemBackendImpl::CreateEntry(const std::string& key,
                                 Entry** entry,
                                 const CompletionCallback& callback) {
+  const int shard_index = GetShardForKey(key);
+  Shard* shard = shards_[shard_index].get();
+  base::AutoLock lock(shard->lock);
   std::pair<EntryMap::iterator, bool> create_result =
-      entries_.insert(EntryMap::value_type(key, nullptr));
+      shard->entries.insert(EntryMap::value_type(key, nullptr));
   const bool did_insert = create_result.second;
   if (!did_insert)
     return net::ERR_FAILED;
 
-  MemEntryImpl* cache_entry = new MemEntryImpl(this, key, net_log_);
+  MemEntryImpl* cache_entry =
+      new MemEntryImpl(this, key, shard_index, net_log_);
   create_result.first->second = cache_entry;
   *entry = cache_entry;
   return net::OK;
@@ -163,11 +249,13 @@ int MemBackendImpl::CreateEntry(const std::string& key,
 
 int MemBackendImpl::DoomEntry(const std::string& key,
                               const CompletionCallback& callback) {
-  EntryMap::iterator it = entries_.find(key);
-  if (it == entries_.end())
+  Shard* shard = shards_[GetShardForKey(key)].get();
+  base::AutoLock lock(shard->lock);
+  EntryMap::iterator it = shard->entries.find(key);
+  if (it == shard->entries.end())
     return net::ERR_FAILED;
 
-  it->second->Doom();
+  it->second->InternalDoom();
   return net::OK;
 }
 
@@ -183,13 +271,17 @@ int MemBackendImpl::DoomEntriesBetween(Time initial_time,
 
   DCHECK_GE(end_time, initial_time);
 
-  base::LinkNode<MemEntryImpl>* node = lru_list_.head();
-  while (node != lru_list_.end() && node->value()->GetLastUsed() < initial_time)
-    node = node->next();
-  while (node != lru_list_.end() && node->value()->GetLastUsed() < end_time) {
-    MemEntryImpl* to_doom = node->value();
-    node = node->next();
-    to_doom->Doom();
+  for (const auto& shard : shards_) {
+    base::AutoLock lock(shard->lock);
+    base::LinkedList<MemEntryImpl>& lru_list = shard->lru_list;
+    base::LinkNode<MemEntryImpl>* node = lru_list.head();
+    while (node != lru_list.end() && node->value()->last_used() < initial_time)
+      node = node->next();
+    while (node != lru_list.end() && node->value()->last_used() < end_time) {
+      MemEntryImpl* to_doom = node->value();
+      node = node->next();
+      to_doom->InternalDoom();
+    }
   }
 
   return net::OK;
@@ -202,43 +294,51 @@ int MemBackendImpl::DoomEntriesSince(Time initial_time,
 
 int MemBackendImpl::CalculateSizeOfAllEntries(
     const CompletionCallback& callback) {
-  return current_size_;
+  return GetCurrentSize();
 }
 
 class MemBackendImpl::MemIterator final : public Backend::Iterator {
  public:
   explicit MemIterator(base::WeakPtr<MemBackendImpl> backend)
-      : backend_(backend), current_(nullptr) {}
+      : backend_(backend), shard_(0), current_(nullptr) {}
 
   int OpenNextEntry(Entry** next_entry,
                     const CompletionCallback& callback) override {
     if (!backend_)
       return net::ERR_FAILED;
 
-    // Iterate using |lru_list_|, from most recently used to least recently
+    // Iterate using the LRU lists, from most recently used to least recently
     // used, for compatibility with the unit tests that assume this behaviour.
-    // Consider the last element if we are beginning an iteration, otherwise
-    // progressively move earlier in the LRU list.
-    current_ = current_ ? current_->previous() : backend_->lru_list_.tail();
-
-    // We should never return a child entry so iterate until we hit a parent
-    // entry.
-    while (current_ != backend_->lru_list_.end() &&
-           current_->value()->type() != MemEntryImpl::PARENT_ENTRY) {
-      current_ = current_->previous();
-    }
-    if (current_ == backend_->lru_list_.end()) {
-      *next_entry = nullptr;
-      return net::ERR_FAILED;
+    // With several shards, the order only holds within a shard.
+    for (; shard_ < backend_->shards_.size(); ++shard_) {
+      Shard* shard = backend_->shards_[shard_].get();
+      base::AutoLock lock(shard->lock);
+
+      // Consider the last element if we are beginning the shard, otherwise
+      // progressively move earlier in the LRU list.
+      current_ = current_ ? current_->previous() : shard->lru_list.tail();
+
+      // We should never return a child entry so iterate until we hit a parent
+      // entry.
+      while (current_ != shard->lru_list.end() &&
+             current_->value()->type() != MemEntryImpl::PARENT_ENTRY) {
+        current_ = current_->previous();
+      }
+      if (current_ != shard->lru_list.end()) {
+        current_->value()->Open();
+        *next_entry = current_->value();
+        return net::OK;
+      }
+      current_ = nullptr;
     }
 
-    current_->value()->Open();
-    *next_entry = current_->value();
-    return net::OK;
+    *next_entry = nullptr;
+    return net::ERR_FAILED;
   }
 
  private:
   base::WeakPtr<MemBackendImpl> backend_;
+  size_t shard_;
   base::LinkNode<MemEntryImpl>* current_;
 };
 
@@ -248,24 +348,73 @@ std::unique_ptr<Backend::Iterator> MemBackendImpl::CreateIterator() {
 }
 
 void MemBackendImpl::OnExternalCacheHit(const std::string& key) {
-  EntryMap::iterator it = entries_.find(key);
-  if (it != entries_.end())
+  Shard* shard = shards_[GetShardForKey(key)].get();
+  base::AutoLock lock(shard->lock);
+  EntryMap::iterator it = shard->entries.find(key);
+  if (it != shard->entries.end())
     it->second->UpdateStateOnUse(MemEntryImpl::ENTRY_WAS_NOT_MODIFIED);
 }
 
-void MemBackendImpl::EvictIfNeeded() {
-  if (current_size_ <= max_size_)
+bool MemBackendImpl::MayHaveEntry(const std::string& key) const {
+  Shard* shard = shards_[GetShardForKey(key)].get();
+  base::AutoLock lock(shard->lock);
+  return shard->entries.count(key) > 0;
+}
+
+int MemBackendImpl::GetShardForKey(const std::string& key) const {
+  if (shards_.size() == 1)
+    return 0;
+  return base::Hash(key) % shards_.size();
+}
+
+int32_t MemBackendImpl::GetCurrentSize() const {
+  return base::subtle::NoBarrier_Load(&current_size_);
+}
+
+void MemBackendImpl::EvictIfNeeded(int shard) {
+  if (GetCurrentSize() <= max_size_)
     return;
 
-  int target_size = std::max(0, max_size_ - kDefaultEvictionSize);
+  const int32_t target_size = std::max(0, max_size_ - kDefaultEvictionSize);
+  const int32_t shard_target_size = target_size / shards_.size();
+
+  // Evict from the shard that grew, down to its share of the cache, and then
+  // from the others. Holding two shard locks at once could deadlock with
+  // another thread doing the same, so shards busy on other threads are
+  // skipped; they will evict once they grow in turn.
+  EvictFromShard(shard, target_size, shard_target_size);
+  for (size_t i = 0; i < shards_.size() && GetCurrentSize() > target_size;
+       ++i) {
+    if (static_cast<int>(i) == shard || !shards_[i]->lock.Try())
+      continue;
+    EvictFromShard(i, target_size, shard_target_size);
+    shards_[i]->lock.Release();
+  }
+  EvictFromShard(shard, target_size, 0);
+}
 
-  base::LinkNode<MemEntryImpl>* entry = lru_list_.head();
-  while (current_size_ > target_size && entry != lru_list_.end()) {
+void MemBackendImpl::EvictFromShard(int shard,
+                                    int32_t target_size,
+                                    int32_t shard_target_size) {
+  Shard* evicted_shard = shards_[shard].get();
+  evicted_shard->lock.AssertAcquired();
+  ReleaseFreeBlocks(shard);
+  base::LinkNode<MemEntryImpl>* entry = evicted_shard->lru_list.head();
+  while (GetCurrentSize() > target_size &&
+         evicted_shard->size > shard_target_size &&
+         entry != evicted_shard->lru_list.end()) {
     MemEntryImpl* to_doom = entry->value();
     entry = entry->next();
-    if (!to_doom->InUse())
-      to_doom->Doom();
+    if (!to_doom->InUse()) {
+      to_doom->InternalDoom();
+      ReleaseFreeBlocks(shard);
+    }
   }
 }
 
+void MemBackendImpl::ReleaseFreeBlocks(int shard) {
+  shards_[shard]->block_pool.Trim();
+  ModifyStorageSize(shard, 0);
+}
+
 }  // namespace disk_cache
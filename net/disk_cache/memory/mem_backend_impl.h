@@ -9,17 +9,22 @@
 
 #include <stdint.h>
 
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "base/atomicops.h"
 #include "base/compiler_specific.h"
 #include "base/containers/linked_list.h"
 #include "base/macros.h"
 #include "base/memory/weak_ptr.h"
 #include "base/strings/string_split.h"
+#include "base/synchronization/lock.h"
 #include "base/time/time.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/memory/mem_entry_impl.h"
+#include "net/disk_cache/memory/mem_stream.h"
 
 namespace net {
 class NetLog;
@@ -29,9 +34,19 @@ namespace disk_cache {
 
 // This class implements the Backend interface. An object of this class handles
 // the operations of the cache without writing to disk.
+//
+// Entries are spread by key hash over one or more shards, each with its own
+// lock, LRU list and pool of stream blocks. With more than one shard, entries
+// may be created, opened, doomed, read and written from several threads at
+// once, as long as operations on entries in different shards do not contend.
+// Iterators, and the destruction of the backend, are still confined to the
+// thread that created the backend. The size limit applies to the backend as a
+// whole: a shard that grows the cache past it evicts from its own LRU list
+// first, down to its share of the limit, and then from the other shards.
 class NET_EXPORT_PRIVATE MemBackendImpl final : public Backend {
  public:
   explicit MemBackendImpl(net::NetLog* net_log);
+  MemBackendImpl(net::NetLog* net_log, int shard_count);
   ~MemBackendImpl() override;
 
   // Returns an instance of a Backend implemented only in memory. The returned
@@ -42,6 +57,12 @@ class NET_EXPORT_PRIVATE MemBackendImpl final : public Backend {
   static std::unique_ptr<Backend> CreateBackend(int max_bytes,
                                                 net::NetLog* net_log);
 
+  // Like CreateBackend(), for a backend with |shard_count| shards, to be used
+  // from several threads.
+  static std::unique_ptr<Backend> CreateShardedBackend(int max_bytes,
+                                                       int shard_count,
+                                                       net::NetLog* net_log);
+
   // Performs general initialization for this current instance of the cache.
   bool Init();
 
@@ -51,26 +72,40 @@ class NET_EXPORT_PRIVATE MemBackendImpl final : public Backend {
   // Returns the maximum size for a file to reside on the cache.
   int MaxFileSize() const;
 
+  // Deletes the least recently used entries that are not in use, until the
+  // cache holds no more than |target_size| bytes.
+  void EvictTo(int32_t target_size);
+
+  // Returns the lock of |shard|, which guards the entries of the shard and
+  // the state kept for them by the backend.
+  base::Lock& GetShardLock(int shard);
+
+  // Returns the pool the entries of |shard| store their streams in. Must be
+  // used with the shard lock held.
+  MemBlockPool* GetBlockPool(int shard);
+
   // These next methods (before the implementation of the Backend interface) are
   // called by MemEntryImpl to update the state of the backend during the entry
-  // lifecycle.
+  // lifecycle, with the lock of the shard of the entry held.
 
-  // Signals that new entry has been created, and should be placed in
-  // |lru_list_| so that it is eligable for eviction.
+  // Signals that new entry has been created, and should be placed in the LRU
+  // list of its shard so that it is eligable for eviction.
   void OnEntryInserted(MemEntryImpl* entry);
 
   // Signals that an entry has been updated, and thus should be moved to the end
-  // of |lru_list_|.
+  // of the LRU list of its shard.
   void OnEntryUpdated(MemEntryImpl* entry);
 
   // Signals that an entry has been doomed, and so it should be removed from the
-  // list of active entries as appropriate, as well as removed from the
-  // |lru_list_|.
+  // list of active entries as appropriate, as well as removed from the LRU
+  // list of its shard.
   void OnEntryDoomed(MemEntryImpl* entry);
 
-  // Adjust the current size of this backend by |delta|. This is used to
-  // determine if eviction is neccessary and when eviction is finished.
-  void ModifyStorageSize(int32_t delta);
+  // Adjust the current size of this backend by |delta|, for an entry of
+  // |shard|, and by the change in the blocks kept by the pool of |shard|. This
+  // is used to determine if eviction is neccessary and when eviction is
+  // finished.
+  void ModifyStorageSize(int shard, int32_t delta);
 
   // Backend interface.
   net::CacheType GetCacheType() const override;
@@ -78,6 +113,10 @@ class NET_EXPORT_PRIVATE MemBackendImpl final : public Backend {
   int OpenEntry(const std::string& key,
                 Entry** entry,
                 const CompletionCallback& callback) override;
+  int OpenEntryWithReadAhead(const std::string& key,
+                             int read_ahead_size,
+                             Entry** entry,
+                             const CompletionCallback& callback) override;
   int CreateEntry(const std::string& key,
                   Entry** entry,
                   const CompletionCallback& callback) override;
@@ -93,6 +132,7 @@ class NET_EXPORT_PRIVATE MemBackendImpl final : public Backend {
   std::unique_ptr<Iterator> CreateIterator() override;
   void GetStats(base::StringPairs* stats) override {}
   void OnExternalCacheHit(const std::string& key) override;
+  bool MayHaveEntry(const std::string& key) const override;
 
  private:
   class MemIterator;
@@ -100,17 +140,53 @@ class NET_EXPORT_PRIVATE MemBackendImpl final : public Backend {
 
   using EntryMap = std::unordered_map<std::string, MemEntryImpl*>;
 
+  struct Shard {
+    Shard();
+    ~Shard();
+
+    base::Lock lock;
+
+    EntryMap entries;
+
+    // Stored in increasing order of last use time, from least recently used
+    // to most recently used.
+    base::LinkedList<MemEntryImpl> lru_list;
+
+    // The part of |current_size_| held by the entries of this shard and the
+    // free blocks of |block_pool|.
+    int32_t size;
+
+    // The part of |size| held by the free blocks of |block_pool|.
+    int32_t pooled_size;
+
+    MemBlockPool block_pool;
+  };
+
+  int GetShardForKey(const std::string& key) const;
+
+  int32_t GetCurrentSize() const;
+
   // Deletes entries from the cache until the current size is below the limit.
-  void EvictIfNeeded();
+  // The lock of |shard| is held by the caller.
+  void EvictIfNeeded(int shard);
+
+  // Returns the free blocks kept by the pool of |shard| to the allocator. The
+  // lock of |shard| is held by the caller.
+  void ReleaseFreeBlocks(int shard);
 
-  EntryMap entries_;
+  // Deletes the least recently used entries of |shard| that are not in use,
+  // while the cache is larger than |target_size| and the shard larger than
+  // |shard_target_size|. The blocks of the deleted entries are released
+  // rather than kept for reuse.
+  void EvictFromShard(int shard,
+                      int32_t target_size,
+                      int32_t shard_target_size);
 
-  // Stored in increasing order of last use time, from least recently used to
-  // most recently used.
-  base::LinkedList<MemEntryImpl> lru_list_;
+  std::vector<std::unique_ptr<Shard>> shards_;
 
   int32_t max_size_;      // Maximum data size for this instance.
-  int32_t current_size_;
+  // Updated by all shards.
+  volatile base::subtle::Atomic32 current_size_;
 
   net::NetLog* net_log_;
 
@@ -10,6 +10,7 @@
 #include "base/bind.h"
 #include "base/logging.h"
 #include "base/strings/stringprintf.h"
+#include "base/synchronization/lock.h"
 #include "base/values.h"
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
@@ -72,14 +73,16 @@ std::unique_ptr<base::Value> NetLogEntryCreationCallback(
 
 MemEntryImpl::MemEntryImpl(MemBackendImpl* backend,
                            const std::string& key,
+                           int shard,
                            net::NetLog* net_log)
     : MemEntryImpl(backend,
                    key,
+                   shard,
                    0,        // child_id
                    nullptr,  // parent
                    net_log) {
   Open();
-  backend_->ModifyStorageSize(GetStorageSize());
+  backend_->ModifyStorageSize(shard_, GetStorageSize());
 }
 
 MemEntryImpl::MemEntryImpl(MemBackendImpl* backend,
@@ -88,6 +91,7 @@ MemEntryImpl::MemEntryImpl(MemBackendImpl* backend,
                            net::NetLog* net_log)
     : MemEntryImpl(backend,
                    std::string(),  // key
+                   parent->shard_,
                    child_id,
                    parent,
                    net_log) {
@@ -112,7 +116,7 @@ bool MemEntryImpl::InUse() const {
 int MemEntryImpl::GetStorageSize() const {
   int storage_size = static_cast<int32_t>(key_.size());
   for (const auto& i : data_)
-    storage_size += i.size();
+    storage_size += i.storage_size();
   return storage_size;
 }
 
@@ -125,7 +129,7 @@ void MemEntryImpl::UpdateStateOnUse(EntryModified modified_enum) {
     last_modified_ = last_used_;
 }
 
-void MemEntryImpl::Doom() {
+void MemEntryImpl::InternalDoom() {
   if (!doomed_) {
     doomed_ = true;
     backend_->OnEntryDoomed(this);
@@ -135,7 +139,13 @@ void MemEntryImpl::Doom() {
     delete this;
 }
 
+void MemEntryImpl::Doom() {
+  base::AutoLock lock(backend_->GetShardLock(shard_));
+  InternalDoom();
+}
+
 void MemEntryImpl::Close() {
+  base::AutoLock lock(backend_->GetShardLock(shard_));
   DCHECK_EQ(PARENT_ENTRY, type());
   --ref_count_;
   DCHECK_GE(ref_count_, 0);
@@ -150,21 +160,42 @@ std::string MemEntryImpl::GetKey() const {
 }
 
 Time MemEntryImpl::GetLastUsed() const {
+  base::AutoLock lock(backend_->GetShardLock(shard_));
   return last_used_;
 }
 
 Time MemEntryImpl::GetLastModified() const {
+  base::AutoLock lock(backend_->GetShardLock(shard_));
   return last_modified_;
 }
 
 int32_t MemEntryImpl::GetDataSize(int index) const {
+  base::AutoLock lock(backend_->GetShardLock(shard_));
+  return LockedGetDataSize(index);
+}
+
+int MemEntryImpl::ReadData(int index, int offset, IOBuffer* buf, int buf_len,
+                           const CompletionCallback& callback) {
+  base::AutoLock lock(backend_->GetShardLock(shard_));
+  return LockedReadData(index, offset, buf, buf_len);
+}
+
+int MemEntryImpl::WriteData(int index, int offset, IOBuffer* buf, int buf_len,
+                            const CompletionCallback& callback, bool truncate) {
+  base::AutoLock lock(backend_->GetShardLock(shard_));
+  return LockedWriteData(index, offset, buf, buf_len, truncate);
+}
+
+int32_t MemEntryImpl::LockedGetDataSize(int index) const {
   if (index < 0 || index >= kNumStreams)
     return 0;
   return data_[index].size();
 }
 
-int MemEntryImpl::ReadData(int index, int offset, IOBuffer* buf, int buf_len,
-                           const CompletionCallback& callback) {
+int MemEntryImpl::LockedReadData(int index,
+                                 int offset,
+                                 IOBuffer* buf,
+                                 int buf_len) {
   if (net_log_.IsCapturing()) {
     net_log_.BeginEvent(
         net::NetLog::TYPE_ENTRY_READ_DATA,
@@ -181,8 +212,11 @@ int MemEntryImpl::ReadData(int index, int offset, IOBuffer* buf, int buf_len,
   return result;
 }
 
-int MemEntryImpl::WriteData(int index, int offset, IOBuffer* buf, int buf_len,
-                            const CompletionCallback& callback, bool truncate) {
+int MemEntryImpl::LockedWriteData(int index,
+                                  int offset,
+                                  IOBuffer* buf,
+                                  int buf_len,
+                                  bool truncate) {
   if (net_log_.IsCapturing()) {
     net_log_.BeginEvent(
         net::NetLog::TYPE_ENTRY_WRITE_DATA,
@@ -203,6 +237,7 @@ int MemEntryImpl::ReadSparseData(int64_t offset,
                                  IOBuffer* buf,
                                  int buf_len,
                                  const CompletionCallback& callback) {
+  base::AutoLock lock(backend_->GetShardLock(shard_));
   if (net_log_.IsCapturing()) {
     net_log_.BeginEvent(
         net::NetLog::TYPE_SPARSE_READ,
@@ -218,6 +253,7 @@ int MemEntryImpl::WriteSparseData(int64_t offset,
                                   IOBuffer* buf,
                                   int buf_len,
                                   const CompletionCallback& callback) {
+  base::AutoLock lock(backend_->GetShardLock(shard_));
   if (net_log_.IsCapturing()) {
     net_log_.BeginEvent(
         net::NetLog::TYPE_SPARSE_WRITE,
@@ -233,6 +269,7 @@ int MemEntryImpl::GetAvailableRange(int64_t offset,
                                     int len,
                                     int64_t* start,
                                     const CompletionCallback& callback) {
+  base::AutoLock lock(backend_->GetShardLock(shard_));
   if (net_log_.IsCapturing()) {
     net_log_.BeginEvent(
         net::NetLog::TYPE_SPARSE_GET_RANGE,
@@ -248,6 +285,7 @@ int MemEntryImpl::GetAvailableRange(int64_t offset,
 }
 
 bool MemEntryImpl::CouldBeSparse() const {
+  base::AutoLock lock(backend_->GetShardLock(shard_));
   DCHECK_EQ(PARENT_ENTRY, type());
   return (children_.get() != nullptr);
 }
@@ -260,10 +298,12 @@ int MemEntryImpl::ReadyForSparseIO(const CompletionCallback& callback) {
 
 MemEntryImpl::MemEntryImpl(MemBackendImpl* backend,
                            const ::std::string& key,
+                           int shard,
                            int child_id,
                            MemEntryImpl* parent,
                            net::NetLog* net_log)
     : key_(key),
+      shard_(shard),
       ref_count_(0),
       child_id_(child_id),
       child_first_pos_(0),
@@ -280,7 +320,10 @@ MemEntryImpl::MemEntryImpl(MemBackendImpl* backend,
 }
 
 MemEntryImpl::~MemEntryImpl() {
-  backend_->ModifyStorageSize(-GetStorageSize());
+  const int storage_size = GetStorageSize();
+  for (auto& stream : data_)
+    stream.Clear(backend_->GetBlockPool(shard_));
+  backend_->ModifyStorageSize(shard_, -storage_size);
 
   if (type() == PARENT_ENTRY) {
     if (children_) {
@@ -291,7 +334,7 @@ MemEntryImpl::~MemEntryImpl() {
         // Since |this| is stored in the map, it should be guarded against
         // double dooming, which will result in double destruction.
         if (it.second != this)
-          it.second->Doom();
+          it.second->InternalDoom();
       }
     }
   } else {
@@ -315,8 +358,7 @@ int MemEntryImpl::InternalReadData(int index, int offset, IOBuffer* buf,
     buf_len = entry_size - offset;
 
   UpdateStateOnUse(ENTRY_WAS_NOT_MODIFIED);
-  std::copy(data_[index].begin() + offset,
-            data_[index].begin() + offset + buf_len, buf->data());
+  data_[index].Read(offset, buf->data(), buf_len);
   return buf_len;
 }
 
@@ -340,15 +382,11 @@ int MemEntryImpl::InternalWriteData(int index, int offset, IOBuffer* buf,
 
   int old_data_size = data_[index].size();
   if (truncate || old_data_size < offset + buf_len) {
-    data_[index].resize(offset + buf_len);
-
-    // Zero fill any hole.
-    if (old_data_size < offset) {
-      std::fill(data_[index].begin() + old_data_size,
-                data_[index].begin() + offset, 0);
-    }
-
-    backend_->ModifyStorageSize(data_[index].size() - old_data_size);
+    const int old_storage_size = data_[index].storage_size();
+    // This zero fills any hole.
+    data_[index].Resize(offset + buf_len, backend_->GetBlockPool(shard_));
+    backend_->ModifyStorageSize(
+        shard_, data_[index].storage_size() - old_storage_size);
   }
 
   UpdateStateOnUse(ENTRY_WAS_MODIFIED);
@@ -356,7 +394,7 @@ int MemEntryImpl::InternalWriteData(int index, int offset, IOBuffer* buf,
   if (!buf_len)
     return 0;
 
-  std::copy(buf->data(), buf->data() + buf_len, data_[index].begin() + offset);
+  data_[index].Write(offset, buf->data(), buf_len);
   return buf_len;
 }
 
@@ -396,8 +434,8 @@ int MemEntryImpl::InternalReadSparseData(int64_t offset,
           CreateNetLogSparseReadWriteCallback(child->net_log_.source(),
                                               io_buf->BytesRemaining()));
     }
-    int ret = child->ReadData(kSparseData, child_offset, io_buf.get(),
-                              io_buf->BytesRemaining(), CompletionCallback());
+    int ret = child->LockedReadData(kSparseData, child_offset, io_buf.get(),
+                                    io_buf->BytesRemaining());
     if (net_log_.IsCapturing()) {
       net_log_.EndEventWithNetErrorCode(
           net::NetLog::TYPE_SPARSE_READ_CHILD_DATA, ret);
@@ -445,7 +483,7 @@ int MemEntryImpl::InternalWriteSparseData(int64_t offset,
                              kMaxSparseEntrySize - child_offset);
 
     // Keep a record of the last byte position (exclusive) in the child.
-    int data_size = child->GetDataSize(kSparseData);
+    int data_size = child->LockedGetDataSize(kSparseData);
 
     if (net_log_.IsCapturing()) {
       net_log_.BeginEvent(net::NetLog::TYPE_SPARSE_WRITE_CHILD_DATA,
@@ -457,8 +495,8 @@ int MemEntryImpl::InternalWriteSparseData(int64_t offset,
     // previously written.
     // TODO(hclam): if there is data in the entry and this write is not
     // continuous we may want to discard this write.
-    int ret = child->WriteData(kSparseData, child_offset, io_buf.get(),
-                               write_len, CompletionCallback(), true);
+    int ret = child->LockedWriteData(kSparseData, child_offset, io_buf.get(),
+                                     write_len, true);
     if (net_log_.IsCapturing()) {
       net_log_.EndEventWithNetErrorCode(
           net::NetLog::TYPE_SPARSE_WRITE_CHILD_DATA, ret);
@@ -508,7 +546,7 @@ int MemEntryImpl::InternalGetAvailableRange(int64_t offset,
     // This loop scan for continuous bytes.
     while (len && current_child) {
       // Number of bytes available in this child.
-      int data_size = current_child->GetDataSize(kSparseData) -
+      int data_size = current_child->LockedGetDataSize(kSparseData) -
                       ToChildOffset(*start + continuous);
       if (data_size > len)
         data_size = len;
@@ -534,7 +572,7 @@ bool MemEntryImpl::InitSparseInfo() {
   if (!children_) {
     // If we already have some data in sparse stream but we are being
     // initialized as a sparse entry, we should fail.
-    if (GetDataSize(kSparseData))
+    if (LockedGetDataSize(kSparseData))
       return false;
     children_.reset(new EntryMap());
 
@@ -575,7 +613,7 @@ int MemEntryImpl::FindNextChild(int64_t offset, int len, MemEntryImpl** child) {
 
       // If the first byte position we should read from doesn't exceed the
       // filled region, we have found the first child.
-      if (first_pos < current_child->GetDataSize(kSparseData)) {
+      if (first_pos < current_child->LockedGetDataSize(kSparseData)) {
          *child = current_child;
 
          // We need to advance the scanned length.
@@ -17,6 +17,7 @@
 #include "base/macros.h"
 #include "base/time/time.h"
 #include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/memory/mem_stream.h"
 #include "net/log/net_log.h"
 
 namespace disk_cache {
@@ -49,6 +50,11 @@ class MemBackendImpl;
 // region, and the unfilled region (if there is one) is always before the filled
 // region. The book keeping for filled region in a sparse entry is done by using
 // the variable |child_first_pos_|.
+//
+// An entry belongs to a shard of the backend, like its children, and all of
+// its state is guarded by the lock of that shard. The methods of the Entry
+// interface take the lock; the other public methods are called by the backend
+// with the lock held.
 
 class NET_EXPORT_PRIVATE MemEntryImpl final
     : public Entry,
@@ -68,6 +74,7 @@ class NET_EXPORT_PRIVATE MemEntryImpl final
   // Constructor for parent entries.
   MemEntryImpl(MemBackendImpl* backend,
                const std::string& key,
+               int shard,
                net::NetLog* net_log);
 
   // Constructor for child entries.
@@ -83,6 +90,7 @@ class NET_EXPORT_PRIVATE MemEntryImpl final
   const std::string& key() const { return key_; }
   const MemEntryImpl* parent() const { return parent_; }
   int child_id() const { return child_id_; }
+  int shard() const { return shard_; }
   base::Time last_used() const { return last_used_; }
 
   // The in-memory size of this entry to use for the purposes of eviction.
@@ -92,6 +100,9 @@ class NET_EXPORT_PRIVATE MemEntryImpl final
   // the entry was modified, also update |last_modified_|.
   void UpdateStateOnUse(EntryModified modified_enum);
 
+  // Dooms the entry, like Doom(), for a caller holding the shard lock.
+  void InternalDoom();
+
   // From disk_cache::Entry:
   void Doom() override;
   void Close() override;
@@ -129,6 +140,7 @@ class NET_EXPORT_PRIVATE MemEntryImpl final
  private:
   MemEntryImpl(MemBackendImpl* backend,
                const std::string& key,
+               int shard,
                int child_id,
                MemEntryImpl* parent,
                net::NetLog* net_log);
@@ -139,6 +151,16 @@ class NET_EXPORT_PRIVATE MemEntryImpl final
 
   ~MemEntryImpl() override;
 
+  // Implement the corresponding public functions with the shard lock held, so
+  // that a parent entry can use them on its children.
+  int32_t LockedGetDataSize(int index) const;
+  int LockedReadData(int index, int offset, IOBuffer* buf, int buf_len);
+  int LockedWriteData(int index,
+                      int offset,
+                      IOBuffer* buf,
+                      int buf_len,
+                      bool truncate);
+
   // Do all the work for corresponding public functions.  Implemented as
   // separate functions to make logging of results simpler.
   int InternalReadData(int index, int offset, IOBuffer* buf, int buf_len);
@@ -164,7 +186,8 @@ class NET_EXPORT_PRIVATE MemEntryImpl final
   int FindNextChild(int64_t offset, int len, MemEntryImpl** child);
 
   std::string key_;
-  std::vector<char> data_[kNumStreams];  // User data.
+  const int shard_;
+  MemStream data_[kNumStreams];  // User data.
   int ref_count_;
 
   int child_id_;              // The ID of a child entry.
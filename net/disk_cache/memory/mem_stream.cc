@@ -0,0 +1,152 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/memory/mem_stream.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace disk_cache {
+
+namespace {
+
+// The number of freed blocks a pool keeps, 256 KB worth. Blocks past that are
+// returned to the allocator, so that evicting entries releases memory.
+const size_t kMaxFreeBlocks = 256;
+
+size_t BlocksForSize(int size) {
+  return (size + MemBlockPool::kBlockSize - 1) / MemBlockPool::kBlockSize;
+}
+
+}  // namespace
+
+const int MemBlockPool::kBlockSize;
+
+MemBlockPool::MemBlockPool() {}
+
+MemBlockPool::~MemBlockPool() {
+  for (char* block : free_blocks_)
+    delete[] block;
+}
+
+char* MemBlockPool::Allocate() {
+  if (free_blocks_.empty())
+    return new char[kBlockSize];
+  char* block = free_blocks_.back();
+  free_blocks_.pop_back();
+  return block;
+}
+
+void MemBlockPool::Free(char* block) {
+  if (free_blocks_.size() < kMaxFreeBlocks)
+    free_blocks_.push_back(block);
+  else
+    delete[] block;
+}
+
+void MemBlockPool::Trim() {
+  for (char* block : free_blocks_)
+    delete[] block;
+  free_blocks_.clear();
+}
+
+MemStream::MemStream() : size_(0) {}
+
+MemStream::~MemStream() {
+  DCHECK(blocks_.empty());
+}
+
+int MemStream::storage_size() const {
+  if (blocks_.empty())
+    return static_cast<int>(small_data_.size());
+  return static_cast<int>(blocks_.size()) * MemBlockPool::kBlockSize;
+}
+
+void MemStream::Resize(int size, MemBlockPool* pool) {
+  DCHECK_GE(size, 0);
+  if (size < MemBlockPool::kBlockSize) {
+    // Copying a stream this small is cheap, and keeps the vector exactly as
+    // large as the stream.
+    std::vector<char> small_data(size);
+    const int kept_size = std::min(size, size_);
+    if (kept_size > 0)
+      Read(0, small_data.data(), kept_size);
+    for (char* block : blocks_)
+      pool->Free(block);
+    blocks_.clear();
+    small_data_.swap(small_data);
+    size_ = size;
+    return;
+  }
+
+  if (blocks_.empty() && size_ > 0) {
+    blocks_.push_back(pool->Allocate());
+    memcpy(blocks_[0], small_data_.data(), size_);
+  }
+  std::vector<char>().swap(small_data_);
+
+  const size_t block_count = BlocksForSize(size);
+  while (blocks_.size() > block_count) {
+    pool->Free(blocks_.back());
+    blocks_.pop_back();
+  }
+  while (blocks_.size() < block_count)
+    blocks_.push_back(pool->Allocate());
+
+  // Blocks come from the pool with stale contents, and the end of the last
+  // block may hold data from before the stream was shrunk.
+  for (int offset = size_; offset < size;) {
+    const int block_offset = offset % MemBlockPool::kBlockSize;
+    const int len =
+        std::min(size - offset, MemBlockPool::kBlockSize - block_offset);
+    memset(blocks_[offset / MemBlockPool::kBlockSize] + block_offset, 0, len);
+    offset += len;
+  }
+  size_ = size;
+}
+
+void MemStream::Clear(MemBlockPool* pool) {
+  Resize(0, pool);
+}
+
+void MemStream::Read(int offset, char* buf, int len) const {
+  DCHECK_GE(offset, 0);
+  DCHECK_LE(offset + len, size_);
+  if (blocks_.empty()) {
+    memcpy(buf, small_data_.data() + offset, len);
+    return;
+  }
+  while (len > 0) {
+    const int block_offset = offset % MemBlockPool::kBlockSize;
+    const int chunk = std::min(len, MemBlockPool::kBlockSize - block_offset);
+    memcpy(buf, blocks_[offset / MemBlockPool::kBlockSize] + block_offset,
+           chunk);
+    buf += chunk;
+    offset += chunk;
+    len -= chunk;
+  }
+}
+
+void MemStream::Write(int offset, const char* buf, int len) {
+  DCHECK_GE(offset, 0);
+  DCHECK_LE(offset + len, size_);
+  if (blocks_.empty()) {
+    memcpy(small_data_.data() + offset, buf, len);
+    return;
+  }
+  while (len > 0) {
+    const int block_offset = offset % MemBlockPool::kBlockSize;
+    const int chunk = std::min(len, MemBlockPool::kBlockSize - block_offset);
+    memcpy(blocks_[offset / MemBlockPool::kBlockSize] + block_offset, buf,
+           chunk);
+    buf += chunk;
+    offset += chunk;
+    len -= chunk;
+  }
+}
+
+}  // namespace disk_cache
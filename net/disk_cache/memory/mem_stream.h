@@ -0,0 +1,83 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_MEMORY_MEM_STREAM_H_
+#define NET_DISK_CACHE_MEMORY_MEM_STREAM_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "base/macros.h"
+#include "net/base/net_export.h"
+
+namespace disk_cache {
+
+// A pool of fixed-size blocks to store the streams of memory cache entries.
+// Freed blocks are kept for reuse, up to a limit, so that entries which come
+// and go do not each go through the allocator for every stream. The memory
+// backend counts the kept blocks against its size limit, and releases them
+// before evicting entries. Not thread safe; each shard of the memory backend
+// has its own pool, used under the shard lock.
+class NET_EXPORT_PRIVATE MemBlockPool {
+ public:
+  static const int kBlockSize = 1024;
+
+  MemBlockPool();
+  ~MemBlockPool();
+
+  char* Allocate();
+  void Free(char* block);
+
+  // Returns the kept blocks to the allocator.
+  void Trim();
+
+  size_t free_block_count() const { return free_blocks_.size(); }
+
+ private:
+  std::vector<char*> free_blocks_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemBlockPool);
+};
+
+// The data of a stream of a memory cache entry. A stream of a block or more is
+// stored as a list of blocks from a MemBlockPool: unlike a single vector,
+// growing it never copies the data already written, and shrinking it returns
+// the blocks past the end to the pool. A smaller stream is stored in a vector
+// of its exact size instead, so that the many small streams, e.g. headers, do
+// not each take a whole block.
+class NET_EXPORT_PRIVATE MemStream {
+ public:
+  MemStream();
+  // The stream must have been cleared.
+  ~MemStream();
+
+  int size() const { return size_; }
+
+  // Returns the memory taken by the data of the stream.
+  int storage_size() const;
+
+  // Sets the size of the stream. Data past the old size reads as zeros.
+  void Resize(int size, MemBlockPool* pool);
+
+  // Returns all the blocks to |pool|, and sets the size to zero.
+  void Clear(MemBlockPool* pool);
+
+  // Copies |len| bytes at |offset| to or from |buf|. The range must be within
+  // the stream.
+  void Read(int offset, char* buf, int len) const;
+  void Write(int offset, const char* buf, int len);
+
+ private:
+  // Only one of these is used, depending on the size of the stream.
+  std::vector<char> small_data_;
+  std::vector<char*> blocks_;
+  int size_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemStream);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_MEMORY_MEM_STREAM_H_
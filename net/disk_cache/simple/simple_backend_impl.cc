@@ -16,6 +16,7 @@
 
 #include "base/bind.h"
 #include "base/callback.h"
+#include "base/feature_list.h"
 #include "base/files/file_util.h"
 #include "base/lazy_instance.h"
 #include "base/location.h"
@@ -31,6 +32,7 @@
 #include "base/time/time.h"
 #include "net/base/net_errors.h"
 #include "net/disk_cache/cache_util.h"
+#include "net/disk_cache/simple/simple_cache_warmer.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
 #include "net/disk_cache/simple/simple_entry_impl.h"
 #include "net/disk_cache/simple/simple_histogram_macros.h"
@@ -247,6 +249,10 @@ SimpleBackendImpl::SimpleBackendImpl(
 }
 
 SimpleBackendImpl::~SimpleBackendImpl() {
+  if (warmer_) {
+    index_->WriteHotEntriesToDisk(SimpleCacheWarmer::kMaxWarmEntries);
+    warmer_.reset();
+  }
   index_->WriteToDisk(SimpleIndex::INDEX_WRITE_REASON_SHUTDOWN);
 }
 
@@ -259,6 +265,8 @@ int SimpleBackendImpl::Init(const CompletionCallback& completion_callback) {
                                            cache_type_, path_))));
   index_->ExecuteWhenReady(
       base::Bind(&RecordIndexLoad, cache_type_, base::TimeTicks::Now()));
+  if (base::FeatureList::IsEnabled(kSimpleCacheWarmUp))
+    warmer_.reset(new SimpleCacheWarmer(this));
 
   PostTaskAndReplyWithResult(
       cache_thread_.get(),
@@ -376,7 +384,17 @@ int32_t SimpleBackendImpl::GetEntryCount() const {
 int SimpleBackendImpl::OpenEntry(const std::string& key,
                                  Entry** entry,
                                  const CompletionCallback& callback) {
+  return OpenEntryWithReadAhead(key, 0, entry, callback);
+}
+
+int SimpleBackendImpl::OpenEntryWithReadAhead(
+    const std::string& key,
+    int read_ahead_size,
+    Entry** entry,
+    const CompletionCallback& callback) {
   const uint64_t entry_hash = simple_util::GetEntryHashKey(key);
+  if (warmer_)
+    warmer_->OnForegroundOperation();
 
   // TODO(gavinp): Factor out this (not quite completely) repetitive code
   // block from OpenEntry/CreateEntry/DoomEntry.
@@ -384,15 +402,23 @@ int SimpleBackendImpl::OpenEntry(const std::string& key,
       entries_pending_doom_.find(entry_hash);
   if (it != entries_pending_doom_.end()) {
     Callback<int(const net::CompletionCallback&)> operation =
-        base::Bind(&SimpleBackendImpl::OpenEntry,
-                   base::Unretained(this), key, entry);
+        base::Bind(&SimpleBackendImpl::OpenEntryWithReadAhead,
+                   base::Unretained(this), key, read_ahead_size, entry);
     it->second.push_back(base::Bind(&RunOperationAndCallback,
                                     operation, callback));
     return net::ERR_IO_PENDING;
   }
+  // Misses are not recorded here, the CreateEntry() that follows them does.
+  if (index_->Has(entry_hash))
+    index_->RecordRequest(entry_hash);
   scoped_refptr<SimpleEntryImpl> simple_entry =
       CreateOrFindActiveEntry(entry_hash, key);
-  return simple_entry->OpenEntry(entry, callback);
+  int rv =
+      simple_entry->OpenEntryWithReadAhead(read_ahead_size, entry, callback);
+  // The entry is kept in memory by the new handle from now on.
+  if (warmer_)
+    warmer_->OnEntryOpened(entry_hash);
+  return rv;
 }
 
 int SimpleBackendImpl::CreateEntry(const std::string& key,
@@ -400,6 +426,8 @@ int SimpleBackendImpl::CreateEntry(const std::string& key,
                                    const CompletionCallback& callback) {
   DCHECK_LT(0u, key.size());
   const uint64_t entry_hash = simple_util::GetEntryHashKey(key);
+  if (warmer_)
+    warmer_->OnForegroundOperation();
 
   std::unordered_map<uint64_t, std::vector<Closure>>::iterator it =
       entries_pending_doom_.find(entry_hash);
@@ -419,6 +447,8 @@ int SimpleBackendImpl::CreateEntry(const std::string& key,
 int SimpleBackendImpl::DoomEntry(const std::string& key,
                                  const net::CompletionCallback& callback) {
   const uint64_t entry_hash = simple_util::GetEntryHashKey(key);
+  if (warmer_)
+    warmer_->OnForegroundOperation();
 
   std::unordered_map<uint64_t, std::vector<Closure>>::iterator it =
       entries_pending_doom_.find(entry_hash);
@@ -499,9 +529,8 @@ class SimpleBackendImpl::SimpleIterator final : public Iterator {
             weak_factory_.GetWeakPtr(),
             next_entry,
             callback);
-        int error_code_open = backend_->OpenEntryFromHash(entry_hash,
-                                                          next_entry,
-                                                          continue_iteration);
+        int error_code_open = backend_->OpenEntryFromHash(
+            entry_hash, 0, next_entry, continue_iteration);
         if (error_code_open == net::ERR_IO_PENDING)
           return;
         if (error_code_open != net::ERR_FAILED) {
@@ -541,7 +570,14 @@ void SimpleBackendImpl::GetStats(base::StringPairs* stats) {
 }
 
 void SimpleBackendImpl::OnExternalCacheHit(const std::string& key) {
-  index_->UseIfExists(simple_util::GetEntryHashKey(key));
+  const uint64_t entry_hash = simple_util::GetEntryHashKey(key);
+  if (index_->UseIfExists(entry_hash))
+    index_->RecordRequest(entry_hash);
+}
+
+bool SimpleBackendImpl::MayHaveEntry(const std::string& key) const {
+  // Until it is loaded, the index has every entry.
+  return index_->Has(simple_util::GetEntryHashKey(key));
 }
 
 void SimpleBackendImpl::InitializeIndex(const CompletionCallback& callback,
@@ -549,6 +585,8 @@ void SimpleBackendImpl::InitializeIndex(const CompletionCallback& callback,
   if (result.net_error == net::OK) {
     index_->SetMaxSize(result.max_size);
     index_->Initialize(result.cache_dir_mtime);
+    if (warmer_)
+      warmer_->Start();
   }
   callback.Run(result.net_error);
 }
@@ -624,6 +662,7 @@ scoped_refptr<SimpleEntryImpl> SimpleBackendImpl::CreateOrFindActiveEntry(
 }
 
 int SimpleBackendImpl::OpenEntryFromHash(uint64_t entry_hash,
+                                         int read_ahead_size,
                                          Entry** entry,
                                          const CompletionCallback& callback) {
   std::unordered_map<uint64_t, std::vector<Closure>>::iterator it =
@@ -631,7 +670,7 @@ int SimpleBackendImpl::OpenEntryFromHash(uint64_t entry_hash,
   if (it != entries_pending_doom_.end()) {
     Callback<int(const net::CompletionCallback&)> operation =
         base::Bind(&SimpleBackendImpl::OpenEntryFromHash,
-                   base::Unretained(this), entry_hash, entry);
+                   base::Unretained(this), entry_hash, read_ahead_size, entry);
     it->second.push_back(base::Bind(&RunOperationAndCallback,
                                     operation, callback));
     return net::ERR_IO_PENDING;
@@ -639,7 +678,8 @@ int SimpleBackendImpl::OpenEntryFromHash(uint64_t entry_hash,
 
   EntryMap::iterator has_active = active_entries_.find(entry_hash);
   if (has_active != active_entries_.end()) {
-    return OpenEntry(has_active->second->key(), entry, callback);
+    return OpenEntryWithReadAhead(has_active->second->key(), read_ahead_size,
+                                  entry, callback);
   }
 
   scoped_refptr<SimpleEntryImpl> simple_entry = new SimpleEntryImpl(
@@ -647,7 +687,8 @@ int SimpleBackendImpl::OpenEntryFromHash(uint64_t entry_hash,
   CompletionCallback backend_callback =
       base::Bind(&SimpleBackendImpl::OnEntryOpenedFromHash,
                  AsWeakPtr(), entry_hash, entry, simple_entry, callback);
-  return simple_entry->OpenEntry(entry, backend_callback);
+  return simple_entry->OpenEntryWithReadAhead(read_ahead_size, entry,
+                                              backend_callback);
 }
 
 int SimpleBackendImpl::DoomEntryFromHash(uint64_t entry_hash,
@@ -45,6 +45,7 @@ namespace disk_cache {
 // The non-static functions below must be called on the IO thread unless
 // otherwise stated.
 
+class SimpleCacheWarmer;
 class SimpleEntryImpl;
 class SimpleIndex;
 
@@ -64,6 +65,9 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
   net::CacheType cache_type() const { return cache_type_; }
   SimpleIndex* index() { return index_.get(); }
 
+  // Null unless kSimpleCacheWarmUp is enabled.
+  SimpleCacheWarmer* warmer() { return warmer_.get(); }
+
   base::TaskRunner* worker_pool() { return worker_pool_.get(); }
 
   int Init(const CompletionCallback& completion_callback);
@@ -96,6 +100,10 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
   int OpenEntry(const std::string& key,
                 Entry** entry,
                 const CompletionCallback& callback) override;
+  int OpenEntryWithReadAhead(const std::string& key,
+                             int read_ahead_size,
+                             Entry** entry,
+                             const CompletionCallback& callback) override;
   int CreateEntry(const std::string& key,
                   Entry** entry,
                   const CompletionCallback& callback) override;
@@ -111,10 +119,12 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
   std::unique_ptr<Iterator> CreateIterator() override;
   void GetStats(base::StringPairs* stats) override;
   void OnExternalCacheHit(const std::string& key) override;
+  bool MayHaveEntry(const std::string& key) const override;
 
  private:
   class SimpleIterator;
   friend class SimpleIterator;
+  friend class SimpleCacheWarmer;
 
   using EntryMap = std::unordered_map<uint64_t, SimpleEntryImpl*>;
 
@@ -160,8 +170,9 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
   // Given a hash, will try to open the corresponding Entry. If we have an Entry
   // corresponding to |hash| in the map of active entries, opens it. Otherwise,
   // a new empty Entry will be created, opened and filled with information from
-  // the disk.
+  // the disk, along with the first |read_ahead_size| bytes of stream 1.
   int OpenEntryFromHash(uint64_t entry_hash,
+                        int read_ahead_size,
                         Entry** entry,
                         const CompletionCallback& callback);
 
@@ -206,6 +217,8 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
 
   EntryMap active_entries_;
 
+  std::unique_ptr<SimpleCacheWarmer> warmer_;
+
   // The set of all entries which are currently being doomed. To avoid races,
   // these entries cannot have Doom/Create/Open operations run until the doom
   // is complete. The base::Closure map target is used to store deferred
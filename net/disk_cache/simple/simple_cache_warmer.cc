@@ -0,0 +1,168 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_cache_warmer.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/callback_helpers.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
+
+namespace disk_cache {
+
+namespace {
+
+// Warming up waits for the backend to see no request for this long.
+const int kIdleDelayMs = 200;
+
+// Warm entries not requested this long after warming up is done are closed.
+const int kHoldTimeSecs = 120;
+
+}  // namespace
+
+const size_t SimpleCacheWarmer::kMaxWarmEntries;
+const int SimpleCacheWarmer::kReadAheadSize;
+
+SimpleCacheWarmer::SimpleCacheWarmer(SimpleBackendImpl* backend)
+    : backend_(backend), done_(false), weak_factory_(this) {}
+
+SimpleCacheWarmer::~SimpleCacheWarmer() {
+  ReleaseWarmEntries();
+}
+
+void SimpleCacheWarmer::Start() {
+  backend_->index()->LoadHotEntries(base::Bind(
+      &SimpleCacheWarmer::OnHotEntriesLoaded, weak_factory_.GetWeakPtr()));
+}
+
+void SimpleCacheWarmer::OnForegroundOperation() {
+  last_foreground_operation_ = base::TimeTicks::Now();
+}
+
+void SimpleCacheWarmer::OnEntryOpened(uint64_t entry_hash) {
+  auto it = warm_entries_.find(entry_hash);
+  if (it == warm_entries_.end())
+    return;
+  it->second->Close();
+  warm_entries_.erase(it);
+}
+
+void SimpleCacheWarmer::SetDoneCallbackForTesting(
+    const base::Closure& callback) {
+  if (done_) {
+    callback.Run();
+    return;
+  }
+  done_callback_ = callback;
+}
+
+void SimpleCacheWarmer::OnHotEntriesLoaded(
+    std::unique_ptr<SimpleIndex::HashList> hot_entries) {
+  pending_hashes_.assign(hot_entries->begin(), hot_entries->end());
+  if (pending_hashes_.empty()) {
+    FinishWarmUp();
+    return;
+  }
+  backend_->index()->ExecuteWhenReady(base::Bind(
+      &SimpleCacheWarmer::OnIndexReady, weak_factory_.GetWeakPtr()));
+}
+
+void SimpleCacheWarmer::OnIndexReady(int result) {
+  if (result != net::OK) {
+    pending_hashes_.clear();
+    FinishWarmUp();
+    return;
+  }
+  SchedulePrefetch();
+}
+
+void SimpleCacheWarmer::SchedulePrefetch() {
+  base::TimeDelta delay;
+  if (!last_foreground_operation_.is_null()) {
+    delay = std::max(base::TimeDelta(),
+                     last_foreground_operation_ +
+                         base::TimeDelta::FromMilliseconds(kIdleDelayMs) -
+                         base::TimeTicks::Now());
+  }
+  prefetch_timer_.Start(FROM_HERE, delay,
+                        base::Bind(&SimpleCacheWarmer::PrefetchNextEntry,
+                                   base::Unretained(this)));
+}
+
+void SimpleCacheWarmer::PrefetchNextEntry() {
+  // Requests came in while waiting.
+  if (!last_foreground_operation_.is_null() &&
+      base::TimeTicks::Now() - last_foreground_operation_ <
+          base::TimeDelta::FromMilliseconds(kIdleDelayMs)) {
+    SchedulePrefetch();
+    return;
+  }
+
+  while (!pending_hashes_.empty() && warm_entries_.size() < kMaxWarmEntries) {
+    const uint64_t entry_hash = pending_hashes_.front();
+    pending_hashes_.pop_front();
+    // Entries evicted since they were recorded, or already opened, are
+    // skipped.
+    if (!backend_->index()->Has(entry_hash) ||
+        backend_->active_entries_.count(entry_hash)) {
+      continue;
+    }
+    Entry** entry = new Entry*(nullptr);
+    const net::CompletionCallback callback =
+        base::Bind(&SimpleCacheWarmer::OnEntryPrefetched,
+                   weak_factory_.GetWeakPtr(), entry_hash, base::Owned(entry));
+    int rv = backend_->OpenEntryFromHash(entry_hash, kReadAheadSize, entry,
+                                         callback);
+    if (rv != net::ERR_IO_PENDING)
+      OnEntryPrefetched(weak_factory_.GetWeakPtr(), entry_hash, entry, rv);
+    return;
+  }
+  FinishWarmUp();
+}
+
+// static
+void SimpleCacheWarmer::OnEntryPrefetched(
+    base::WeakPtr<SimpleCacheWarmer> warmer,
+    uint64_t entry_hash,
+    Entry** entry,
+    int result) {
+  if (!warmer) {
+    if (result == net::OK)
+      (*entry)->Close();
+    return;
+  }
+  if (result == net::OK) {
+    auto insert_result =
+        warmer->warm_entries_.insert(std::make_pair(entry_hash, *entry));
+    if (!insert_result.second)
+      (*entry)->Close();
+  }
+  warmer->SchedulePrefetch();
+}
+
+void SimpleCacheWarmer::FinishWarmUp() {
+  done_ = true;
+  if (!warm_entries_.empty()) {
+    release_timer_.Start(FROM_HERE,
+                         base::TimeDelta::FromSeconds(kHoldTimeSecs),
+                         base::Bind(&SimpleCacheWarmer::ReleaseWarmEntries,
+                                    base::Unretained(this)));
+  }
+  if (!done_callback_.is_null())
+    base::ResetAndReturn(&done_callback_).Run();
+}
+
+void SimpleCacheWarmer::ReleaseWarmEntries() {
+  for (const auto& warm_entry : warm_entries_)
+    warm_entry.second->Close();
+  warm_entries_.clear();
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,100 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_CACHE_WARMER_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_CACHE_WARMER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <unordered_map>
+
+#include "base/callback.h"
+#include "base/macros.h"
+#include "base/memory/weak_ptr.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/simple/simple_index.h"
+
+namespace disk_cache {
+
+class Entry;
+class SimpleBackendImpl;
+
+// With kSimpleCacheWarmUp, warms up a SimpleBackendImpl after it is opened:
+// the entries requested the most before the cache was last closed are opened
+// from their hash, which reads their headers (stream 0) and the start of their
+// body into memory, and kept open until they are requested, or for a while
+// after warming up is done.
+//
+// Warming up does not compete with the requests to the backend: the entries
+// are opened one at a time, and only once the backend did not see a request
+// for a while.
+class NET_EXPORT_PRIVATE SimpleCacheWarmer {
+ public:
+  // The most entries recorded when the cache is closed, and kept open.
+  static const size_t kMaxWarmEntries = 32;
+
+  // The bytes of the body read along with the headers of each entry.
+  static const int kReadAheadSize = 32 * 1024;
+
+  // |backend| owns the warmer.
+  explicit SimpleCacheWarmer(SimpleBackendImpl* backend);
+  ~SimpleCacheWarmer();
+
+  // Loads the entries recorded when the cache was last closed, and warms them
+  // up once the index is ready.
+  void Start();
+
+  // Called for each request to the backend, which postpones warming up.
+  void OnForegroundOperation();
+
+  // Called when the entry of |entry_hash| was opened from its key: the new
+  // handle keeps it in memory from now on.
+  void OnEntryOpened(uint64_t entry_hash);
+
+  size_t warm_entry_count() const { return warm_entries_.size(); }
+
+  // Runs |callback| once all the entries are warm, or right away if they
+  // already are.
+  void SetDoneCallbackForTesting(const base::Closure& callback);
+
+ private:
+  void OnHotEntriesLoaded(std::unique_ptr<SimpleIndex::HashList> hot_entries);
+  void OnIndexReady(int result);
+
+  // Opens the next pending entry once the backend is idle.
+  void SchedulePrefetch();
+  void PrefetchNextEntry();
+  static void OnEntryPrefetched(base::WeakPtr<SimpleCacheWarmer> warmer,
+                                uint64_t entry_hash,
+                                Entry** entry,
+                                int result);
+
+  void FinishWarmUp();
+  void ReleaseWarmEntries();
+
+  SimpleBackendImpl* const backend_;
+
+  std::deque<uint64_t> pending_hashes_;
+  std::unordered_map<uint64_t, Entry*> warm_entries_;
+  bool done_;
+
+  base::TimeTicks last_foreground_operation_;
+  base::OneShotTimer prefetch_timer_;
+  base::OneShotTimer release_timer_;
+
+  base::Closure done_callback_;
+
+  base::WeakPtrFactory<SimpleCacheWarmer> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleCacheWarmer);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_CACHE_WARMER_H_
@@ -23,4 +23,19 @@ SimpleFileSparseRangeHeader::SimpleFileSparseRangeHeader() {
   std::memset(this, 0, sizeof(*this));
 }
 
+SimpleFileSparseIndexHeader::SimpleFileSparseIndexHeader() {
+  // Make hashing repeatable: leave no padding bytes untouched.
+  std::memset(this, 0, sizeof(*this));
+}
+
+SimpleFileSparseIndexEntry::SimpleFileSparseIndexEntry() {
+  // Make hashing repeatable: leave no padding bytes untouched.
+  std::memset(this, 0, sizeof(*this));
+}
+
+SimpleFileSparseIndexFooter::SimpleFileSparseIndexFooter() {
+  // Make hashing repeatable: leave no padding bytes untouched.
+  std::memset(this, 0, sizeof(*this));
+}
+
 }  // namespace disk_cache
@@ -18,6 +18,7 @@ namespace disk_cache {
 const uint64_t kSimpleInitialMagicNumber = UINT64_C(0xfcfb6d1ba7725c30);
 const uint64_t kSimpleFinalMagicNumber = UINT64_C(0xf4fa6f45970d41d8);
 const uint64_t kSimpleSparseRangeMagicNumber = UINT64_C(0xeb97bf016553676b);
+const uint64_t kSimpleSparseIndexMagicNumber = UINT64_C(0x7d2c5a8e41b3f096);
 
 // A file containing stream 0 and stream 1 in the Simple cache consists of:
 //   - a SimpleFileHeader.
@@ -40,6 +41,20 @@ const uint64_t kSimpleSparseRangeMagicNumber = UINT64_C(0xeb97bf016553676b);
 //   - the key.
 //   - the data.
 //   - at the end, a SimpleFileEOF record.
+
+// A sparse data file in the Simple cache consists of:
+//   - a SimpleFileHeader.
+//   - the key.
+//   - the ranges, in the order they were appended, each a
+//     SimpleFileSparseRangeHeader followed by the data of the range.
+//   - (optionally) an index of the ranges: a SimpleFileSparseIndexHeader, a
+//     SimpleFileSparseIndexEntry per range in offset order, and at the end of
+//     the file a SimpleFileSparseIndexFooter.
+//
+// The index lets an entry be opened with two reads at the end of the file,
+// instead of a read of each range header. It is written when the file is
+// closed after its ranges changed, and removed before they change again.
+// Without a valid index, the ranges are scanned up to the index header.
 static const int kSimpleEntryFileCount = 2;
 static const int kSimpleEntryStreamCount = 3;
 
@@ -76,6 +91,33 @@ struct SimpleFileSparseRangeHeader {
   uint32_t data_crc32;
 };
 
+struct SimpleFileSparseIndexHeader {
+  SimpleFileSparseIndexHeader();
+
+  uint64_t sparse_index_magic_number;
+  uint32_t range_count;
+  // Of the SimpleFileSparseIndexEntry records.
+  uint32_t entries_crc32;
+};
+
+struct SimpleFileSparseIndexEntry {
+  SimpleFileSparseIndexEntry();
+
+  int64_t offset;
+  // Of the data of the range, past its SimpleFileSparseRangeHeader.
+  int64_t file_offset;
+  uint32_t length;
+  uint32_t data_crc32;
+};
+
+struct SimpleFileSparseIndexFooter {
+  SimpleFileSparseIndexFooter();
+
+  uint64_t sparse_index_magic_number;
+  // Of the SimpleFileSparseIndexHeader.
+  int64_t index_offset;
+};
+
 }  // namespace disk_cache
 
 #endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_ENTRY_FORMAT_H_
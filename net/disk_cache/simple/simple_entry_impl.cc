@@ -38,6 +38,11 @@ namespace {
 // the cache.
 const int64_t kMaxSparseDataSizeDivisor = 10;
 
+// With kSimpleCacheWriteBuffering, the writes smaller than this are buffered,
+// and the buffer is written once it holds kWriteBufferFlushSize bytes.
+const int kMaxBufferedWriteSize = 16 * 1024;
+const int kWriteBufferFlushSize = 64 * 1024;
+
 // Used in histograms, please only add entries at the end.
 enum ReadResult {
   READ_RESULT_SUCCESS = 0,
@@ -140,8 +145,30 @@ void InvokeCallbackIfBackendIsAlive(
   completion_callback.Run(result);
 }
 
+// Writes the buffered data of an entry being closed and closes it in the same
+// task, so that the data is committed along with its CRC and EOF records.
+void FlushAndCloseSynchronousEntry(
+    SimpleSynchronousEntry* synchronous_entry,
+    const SimpleSynchronousEntry::EntryOperationData& flush_op,
+    net::IOBuffer* flush_buf,
+    SimpleEntryStat flush_entry_stat,
+    const SimpleEntryStat& entry_stat,
+    std::unique_ptr<std::vector<SimpleSynchronousEntry::CRCRecord>>
+        crc32s_to_write,
+    net::GrowableIOBuffer* stream_0_data) {
+  // A failed write dooms the entry, whose files are then already deleted.
+  int result;
+  synchronous_entry->WriteData(flush_op, flush_buf, &flush_entry_stat,
+                               &result);
+  synchronous_entry->Close(entry_stat, std::move(crc32s_to_write),
+                           stream_0_data);
+}
+
 }  // namespace
 
+const base::Feature kSimpleCacheWriteBuffering{
+    "SimpleCacheWriteBuffering", base::FEATURE_DISABLED_BY_DEFAULT};
+
 using base::Closure;
 using base::FilePath;
 using base::Time;
@@ -176,6 +203,7 @@ SimpleEntryImpl::SimpleEntryImpl(net::CacheType cache_type,
       path_(path),
       entry_hash_(entry_hash),
       use_optimistic_operations_(operations_mode == OPTIMISTIC_OPERATIONS),
+      buffer_writes_(base::FeatureList::IsEnabled(kSimpleCacheWriteBuffering)),
       last_used_(Time::Now()),
       last_modified_(last_used_),
       sparse_data_size_(0),
@@ -207,6 +235,13 @@ void SimpleEntryImpl::SetActiveEntryProxy(
 
 int SimpleEntryImpl::OpenEntry(Entry** out_entry,
                                const CompletionCallback& callback) {
+  return OpenEntryWithReadAhead(0, out_entry, callback);
+}
+
+int SimpleEntryImpl::OpenEntryWithReadAhead(
+    int read_ahead_size,
+    Entry** out_entry,
+    const CompletionCallback& callback) {
   DCHECK(backend_.get());
 
   net_log_.AddEvent(net::NetLog::TYPE_SIMPLE_CACHE_ENTRY_OPEN_CALL);
@@ -239,7 +274,7 @@ int SimpleEntryImpl::OpenEntry(Entry** out_entry,
   }
 
   pending_operations_.push(SimpleEntryOperation::OpenOperation(
-      this, have_index, callback, out_entry));
+      this, have_index, read_ahead_size, callback, out_entry));
   RunNextOperationIfNeeded();
   return net::ERR_IO_PENDING;
 }
@@ -375,7 +410,23 @@ int SimpleEntryImpl::ReadData(int stream_index,
     return 0;
   }
 
-  // TODO(clamy): return immediatly when reading from stream 0.
+  if (CanReadSynchronously(stream_index, offset, buf_len)) {
+    buf_len = std::min(buf_len, GetDataSize(stream_index) - offset);
+    if (net_log_.IsCapturing()) {
+      net_log_.AddEvent(
+          net::NetLog::TYPE_SIMPLE_CACHE_ENTRY_READ_BEGIN,
+          CreateNetLogReadWriteDataCallback(stream_index, offset, buf_len,
+                                            false));
+    }
+    int ret_value = stream_index == 0
+                        ? ReadStream0Data(buf, offset, buf_len)
+                        : ReadStream1ReadAhead(buf, offset, buf_len);
+    if (net_log_.IsCapturing()) {
+      net_log_.AddEvent(net::NetLog::TYPE_SIMPLE_CACHE_ENTRY_READ_END,
+                        CreateNetLogReadWriteCompleteCallback(ret_value));
+    }
+    return ret_value;
+  }
 
   // TODO(felipeg): Optimization: Add support for truly parallel read
   // operations.
@@ -423,6 +474,9 @@ int SimpleEntryImpl::WriteData(int stream_index,
   }
   ScopedOperationRunner operation_runner(this);
 
+  if (stream_index == 1)
+    stream_1_read_ahead_ = NULL;
+
   // Stream 0 data is kept in memory, so can be written immediatly if there are
   // no IO operations pending.
   if (stream_index == 0 && state_ == STATE_READY &&
@@ -568,6 +622,12 @@ void SimpleEntryImpl::MakeUninitialized() {
   for (size_t i = 0; i < arraysize(crc_check_state_); ++i) {
     crc_check_state_[i] = CRC_CHECK_NEVER_READ_AT_ALL;
   }
+  read_ahead_ = false;
+  stream_1_read_ahead_ = NULL;
+  write_buffer_ = NULL;
+  write_buffer_stream_ = 0;
+  write_buffer_offset_ = 0;
+  write_buffer_size_ = 0;
 }
 
 void SimpleEntryImpl::ReturnEntryToCaller(Entry** out_entry) {
@@ -600,12 +660,19 @@ void SimpleEntryImpl::RunNextOperationIfNeeded() {
                    "EntryOperationsPending", cache_type_,
                    pending_operations_.size(), 0, 100, 20);
   if (!pending_operations_.empty() && state_ != STATE_IO_PENDING) {
+    if (write_buffer_size_ > 0 && state_ == STATE_READY &&
+        NeedsFlushBefore(pending_operations_.front())) {
+      // The operation runs once the flush completes.
+      FlushWriteBuffer();
+      return;
+    }
     std::unique_ptr<SimpleEntryOperation> operation(
         new SimpleEntryOperation(pending_operations_.front()));
     pending_operations_.pop();
     switch (operation->type()) {
       case SimpleEntryOperation::TYPE_OPEN:
         OpenEntryInternal(operation->have_index(),
+                          operation->length(),
                           operation->callback(),
                           operation->out_entry());
         break;
@@ -667,6 +734,7 @@ void SimpleEntryImpl::RunNextOperationIfNeeded() {
 }
 
 void SimpleEntryImpl::OpenEntryInternal(bool have_index,
+                                        int read_ahead_size,
                                         const CompletionCallback& callback,
                                         Entry** out_entry) {
   ScopedOperationRunner operation_runner(this);
@@ -692,13 +760,14 @@ void SimpleEntryImpl::OpenEntryInternal(bool have_index,
   DCHECK_EQ(STATE_UNINITIALIZED, state_);
   DCHECK(!synchronous_entry_);
   state_ = STATE_IO_PENDING;
+  read_ahead_ = read_ahead_size > 0;
   const base::TimeTicks start_time = base::TimeTicks::Now();
   std::unique_ptr<SimpleEntryCreationResults> results(
       new SimpleEntryCreationResults(SimpleEntryStat(
           last_used_, last_modified_, data_size_, sparse_data_size_)));
   Closure task =
       base::Bind(&SimpleSynchronousEntry::OpenEntry, cache_type_, path_, key_,
-                 entry_hash_, have_index, results.get());
+                 entry_hash_, have_index, read_ahead_size, results.get());
   Closure reply =
       base::Bind(&SimpleEntryImpl::CreationOperationComplete, this, callback,
                  start_time, base::Passed(&results), out_entry,
@@ -781,11 +850,30 @@ void SimpleEntryImpl::CloseInternal() {
   }
 
   if (synchronous_entry_) {
-    Closure task = base::Bind(
-        &SimpleSynchronousEntry::Close, base::Unretained(synchronous_entry_),
-        SimpleEntryStat(last_used_, last_modified_, data_size_,
-                        sparse_data_size_),
-        base::Passed(&crc32s_to_write), base::RetainedRef(stream_0_data_));
+    const SimpleEntryStat entry_stat(last_used_, last_modified_, data_size_,
+                                     sparse_data_size_);
+    Closure task;
+    if (write_buffer_size_ > 0) {
+      DCHECK_EQ(STATE_IO_PENDING, state_);
+      // The buffered data is written as if the stream ended where it starts.
+      SimpleEntryStat flush_entry_stat(entry_stat);
+      flush_entry_stat.set_data_size(write_buffer_stream_,
+                                     write_buffer_offset_);
+      task = base::Bind(
+          &FlushAndCloseSynchronousEntry, base::Unretained(synchronous_entry_),
+          SimpleSynchronousEntry::EntryOperationData(
+              write_buffer_stream_, write_buffer_offset_, write_buffer_size_,
+              false, doomed_),
+          base::RetainedRef(write_buffer_), flush_entry_stat, entry_stat,
+          base::Passed(&crc32s_to_write), base::RetainedRef(stream_0_data_));
+      write_buffer_ = NULL;
+      write_buffer_size_ = 0;
+    } else {
+      task = base::Bind(&SimpleSynchronousEntry::Close,
+                        base::Unretained(synchronous_entry_), entry_stat,
+                        base::Passed(&crc32s_to_write),
+                        base::RetainedRef(stream_0_data_));
+    }
     Closure reply = base::Bind(&SimpleEntryImpl::CloseOperationComplete, this);
     synchronous_entry_ = NULL;
     worker_pool_->PostTaskAndReply(FROM_HERE, task, reply);
@@ -934,6 +1022,11 @@ void SimpleEntryImpl::WriteDataInternal(int stream_index,
       return;
     }
   }
+  if (CanBufferWrite(stream_index, offset, buf_len)) {
+    BufferWrite(stream_index, offset, buf, buf_len, callback);
+    return;
+  }
+
   state_ = STATE_IO_PENDING;
   if (!doomed_ && backend_.get())
     backend_->index()->UseIfExists(entry_hash_);
@@ -1141,6 +1234,17 @@ void SimpleEntryImpl::CreationOperationComplete(
     crc32s_[0] = in_results->stream_0_crc32;
     crc32s_end_offset_[0] = in_results->entry_stat.data_size(0);
   }
+  if (in_results->stream_1_read_ahead.get()) {
+    stream_1_read_ahead_ = in_results->stream_1_read_ahead;
+    // Reads of stream 1 continue the crc of the data read ahead, which was
+    // already checked if it is the whole stream.
+    crc32s_[1] = in_results->stream_1_read_ahead_crc32;
+    crc32s_end_offset_[1] = stream_1_read_ahead_->size();
+    crc_check_state_[1] =
+        stream_1_read_ahead_->size() == in_results->entry_stat.data_size(1)
+            ? CRC_CHECK_DONE
+            : CRC_CHECK_NEVER_READ_TO_END;
+  }
   // If this entry was opened by hash, key_ could still be empty. If so, update
   // it with the key read from the synchronous entry.
   if (key_.empty()) {
@@ -1276,6 +1380,17 @@ void SimpleEntryImpl::WriteOperationComplete(
   EntryOperationComplete(completion_callback, *entry_stat, std::move(result));
 }
 
+void SimpleEntryImpl::FlushOperationComplete(
+    int stream_index,
+    std::unique_ptr<SimpleEntryStat> entry_stat,
+    std::unique_ptr<int> result) {
+  if (*result < 0) {
+    RecordWriteResult(cache_type_, WRITE_RESULT_SYNC_WRITE_FAILURE);
+    crc32s_end_offset_[stream_index] = 0;
+  }
+  EntryOperationComplete(CompletionCallback(), *entry_stat, std::move(result));
+}
+
 void SimpleEntryImpl::ReadSparseOperationComplete(
     const CompletionCallback& completion_callback,
     std::unique_ptr<base::Time> last_used,
@@ -1494,6 +1609,34 @@ int SimpleEntryImpl::ReadStream0Data(net::IOBuffer* buf,
   return buf_len;
 }
 
+bool SimpleEntryImpl::CanReadSynchronously(int stream_index,
+                                           int offset,
+                                           int buf_len) const {
+  if (!read_ahead_ || !pending_operations_.empty() || state_ != STATE_READY)
+    return false;
+  if (stream_index == 0)
+    return true;
+  if (stream_index != 1 || !stream_1_read_ahead_)
+    return false;
+  int end = offset + std::min(buf_len, GetDataSize(stream_index) - offset);
+  return end <= stream_1_read_ahead_->size();
+}
+
+int SimpleEntryImpl::ReadStream1ReadAhead(net::IOBuffer* buf,
+                                          int offset,
+                                          int buf_len) {
+  DCHECK(stream_1_read_ahead_);
+  DCHECK_LE(offset + buf_len, stream_1_read_ahead_->size());
+  if (!doomed_ && backend_.get())
+    backend_->index()->UseIfExists(entry_hash_);
+  memcpy(buf->data(), stream_1_read_ahead_->data() + offset, buf_len);
+  UpdateDataFromEntryStat(
+      SimpleEntryStat(base::Time::Now(), last_modified_, data_size_,
+                      sparse_data_size_));
+  RecordReadResult(cache_type_, READ_RESULT_SUCCESS);
+  return buf_len;
+}
+
 int SimpleEntryImpl::SetStream0Data(net::IOBuffer* buf,
                                     int offset,
                                     int buf_len,
@@ -1533,6 +1676,106 @@ int SimpleEntryImpl::SetStream0Data(net::IOBuffer* buf,
   return buf_len;
 }
 
+bool SimpleEntryImpl::CanBufferWrite(int stream_index,
+                                     int offset,
+                                     int buf_len) const {
+  // Only appends are buffered, so that the buffer always ends the stream.
+  return buffer_writes_ && stream_index != 0 && buf_len > 0 &&
+         buf_len < kMaxBufferedWriteSize &&
+         offset == data_size_[stream_index] &&
+         (write_buffer_size_ == 0 || stream_index == write_buffer_stream_);
+}
+
+bool SimpleEntryImpl::NeedsFlushBefore(
+    const SimpleEntryOperation& operation) const {
+  switch (operation.type()) {
+    case SimpleEntryOperation::TYPE_OPEN:
+      // Opening a ready entry does no IO.
+      return false;
+    case SimpleEntryOperation::TYPE_CLOSE:
+      // Closing writes the buffer along with the EOF records.
+      return false;
+    case SimpleEntryOperation::TYPE_READ:
+      // Stream 0 is kept in memory.
+      return operation.index() != 0;
+    case SimpleEntryOperation::TYPE_WRITE:
+      return operation.index() != 0 &&
+             !CanBufferWrite(operation.index(), operation.offset(),
+                             operation.length());
+    default:
+      return true;
+  }
+}
+
+void SimpleEntryImpl::BufferWrite(int stream_index,
+                                  int offset,
+                                  net::IOBuffer* buf,
+                                  int buf_len,
+                                  const CompletionCallback& callback) {
+  DCHECK_EQ(STATE_READY, state_);
+  DCHECK(CanBufferWrite(stream_index, offset, buf_len));
+  if (write_buffer_size_ == 0) {
+    write_buffer_stream_ = stream_index;
+    write_buffer_offset_ = offset;
+  }
+  if (!write_buffer_)
+    write_buffer_ = new net::GrowableIOBuffer();
+  if (write_buffer_->capacity() < write_buffer_size_ + buf_len) {
+    write_buffer_->SetCapacity(std::max(write_buffer_size_ + buf_len,
+                                        2 * write_buffer_->capacity()));
+  }
+  memcpy(write_buffer_->StartOfBuffer() + write_buffer_size_, buf->data(),
+         buf_len);
+  write_buffer_size_ += buf_len;
+
+  if (!doomed_ && backend_.get())
+    backend_->index()->UseIfExists(entry_hash_);
+  AdvanceCrc(buf, offset, buf_len, stream_index);
+  data_size_[stream_index] = offset + buf_len;
+  last_used_ = last_modified_ = base::Time::Now();
+  have_written_[stream_index] = true;
+  if (stream_index == 1)
+    have_written_[0] = true;
+
+  RecordWriteResult(cache_type_, WRITE_RESULT_SUCCESS);
+  if (net_log_.IsCapturing()) {
+    net_log_.AddEvent(net::NetLog::TYPE_SIMPLE_CACHE_ENTRY_WRITE_END,
+                      CreateNetLogReadWriteCompleteCallback(buf_len));
+  }
+  if (!callback.is_null()) {
+    base::ThreadTaskRunnerHandle::Get()->PostTask(
+        FROM_HERE, base::Bind(callback, buf_len));
+  }
+
+  if (write_buffer_size_ >= kWriteBufferFlushSize)
+    FlushWriteBuffer();
+}
+
+void SimpleEntryImpl::FlushWriteBuffer() {
+  DCHECK_EQ(STATE_READY, state_);
+  DCHECK_LT(0, write_buffer_size_);
+  state_ = STATE_IO_PENDING;
+
+  const int stream_index = write_buffer_stream_;
+  // The buffered data is written as if the stream ended where it starts.
+  std::unique_ptr<SimpleEntryStat> entry_stat(new SimpleEntryStat(
+      last_used_, last_modified_, data_size_, sparse_data_size_));
+  entry_stat->set_data_size(stream_index, write_buffer_offset_);
+  std::unique_ptr<int> result(new int());
+  Closure task = base::Bind(
+      &SimpleSynchronousEntry::WriteData, base::Unretained(synchronous_entry_),
+      SimpleSynchronousEntry::EntryOperationData(
+          stream_index, write_buffer_offset_, write_buffer_size_, false,
+          doomed_),
+      base::RetainedRef(write_buffer_), entry_stat.get(), result.get());
+  Closure reply = base::Bind(&SimpleEntryImpl::FlushOperationComplete, this,
+                             stream_index, base::Passed(&entry_stat),
+                             base::Passed(&result));
+  write_buffer_ = NULL;
+  write_buffer_size_ = 0;
+  worker_pool_->PostTaskAndReply(FROM_HERE, task, reply);
+}
+
 void SimpleEntryImpl::AdvanceCrc(net::IOBuffer* buffer,
                                  int offset,
                                  int length,
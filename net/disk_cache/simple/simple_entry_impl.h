@@ -11,6 +11,7 @@
 #include <queue>
 #include <string>
 
+#include "base/feature_list.h"
 #include "base/files/file_path.h"
 #include "base/memory/ref_counted.h"
 #include "base/threading/thread_checker.h"
@@ -28,6 +29,7 @@ class TaskRunner;
 namespace net {
 class GrowableIOBuffer;
 class IOBuffer;
+class IOBufferWithSize;
 }
 
 namespace disk_cache {
@@ -37,6 +39,10 @@ class SimpleSynchronousEntry;
 class SimpleEntryStat;
 struct SimpleEntryCreationResults;
 
+// Buffers the small writes appending to streams 1 and 2 of an entry in memory,
+// and writes them to disk together. See SimpleEntryImpl::write_buffer_.
+NET_EXPORT_PRIVATE extern const base::Feature kSimpleCacheWriteBuffering;
+
 // SimpleEntryImpl is the IO thread interface to an entry in the very simple
 // disk cache. It proxies for the SimpleSynchronousEntry, which performs IO
 // on the worker thread.
@@ -71,6 +77,13 @@ class NET_EXPORT_PRIVATE SimpleEntryImpl : public Entry,
   // |entry|.
   int OpenEntry(Entry** entry, const CompletionCallback& callback);
 
+  // Like OpenEntry(), but also reads up to |read_ahead_size| bytes at the
+  // start of stream 1 while opening, so that reads within them complete
+  // synchronously.
+  int OpenEntryWithReadAhead(int read_ahead_size,
+                             Entry** entry,
+                             const CompletionCallback& callback);
+
   // Creates this entry, if possible. Returns |this| to |entry|.
   int CreateEntry(Entry** entry, const CompletionCallback& callback);
 
@@ -178,6 +191,7 @@ class NET_EXPORT_PRIVATE SimpleEntryImpl : public Entry,
   void RunNextOperationIfNeeded();
 
   void OpenEntryInternal(bool have_index,
+                         int read_ahead_size,
                          const CompletionCallback& callback,
                          Entry** out_entry);
 
@@ -253,6 +267,11 @@ class NET_EXPORT_PRIVATE SimpleEntryImpl : public Entry,
                               std::unique_ptr<SimpleEntryStat> entry_stat,
                               std::unique_ptr<int> result);
 
+  // Called after |write_buffer_| was written to disk.
+  void FlushOperationComplete(int stream_index,
+                              std::unique_ptr<SimpleEntryStat> entry_stat,
+                              std::unique_ptr<int> result);
+
   void ReadSparseOperationComplete(
       const CompletionCallback& completion_callback,
       std::unique_ptr<base::Time> last_used,
@@ -294,6 +313,14 @@ class NET_EXPORT_PRIVATE SimpleEntryImpl : public Entry,
   // Reads from the stream 0 data kept in memory.
   int ReadStream0Data(net::IOBuffer* buf, int offset, int buf_len);
 
+  // Returns whether a read of stream |stream_index| can be served from
+  // memory, without waiting for other operations. Only the reads of entries
+  // opened with a read ahead are.
+  bool CanReadSynchronously(int stream_index, int offset, int buf_len) const;
+
+  // Reads from the start of stream 1 read ahead when opening the entry.
+  int ReadStream1ReadAhead(net::IOBuffer* buf, int offset, int buf_len);
+
   // Copies data from |buf| to the internal in-memory buffer for stream 0. If
   // |truncate| is set to true, the target buffer will be truncated at |offset|
   // + |buf_len| before being written.
@@ -301,6 +328,24 @@ class NET_EXPORT_PRIVATE SimpleEntryImpl : public Entry,
                      int offset, int buf_len,
                      bool truncate);
 
+  // Returns whether a write of |buf_len| bytes to |stream_index| at |offset|
+  // can be added to |write_buffer_|.
+  bool CanBufferWrite(int stream_index, int offset, int buf_len) const;
+
+  // Returns whether |write_buffer_| must be written to disk before |operation|
+  // runs.
+  bool NeedsFlushBefore(const SimpleEntryOperation& operation) const;
+
+  // Adds a write to |write_buffer_|, and completes it.
+  void BufferWrite(int stream_index,
+                   int offset,
+                   net::IOBuffer* buf,
+                   int buf_len,
+                   const CompletionCallback& callback);
+
+  // Writes |write_buffer_| to disk, as an operation of its own.
+  void FlushWriteBuffer();
+
   // Updates |crc32s_| and |crc32s_end_offset_| for a write of the data in
   // |buffer| on |stream_index|, starting at |offset| and of length |length|.
   void AdvanceCrc(net::IOBuffer* buffer,
@@ -320,6 +365,7 @@ class NET_EXPORT_PRIVATE SimpleEntryImpl : public Entry,
   const base::FilePath path_;
   const uint64_t entry_hash_;
   const bool use_optimistic_operations_;
+  const bool buffer_writes_;
   std::string key_;
 
   // |last_used_|, |last_modified_| and |data_size_| are copied from the
@@ -382,6 +428,28 @@ class NET_EXPORT_PRIVATE SimpleEntryImpl : public Entry,
   // used to write HTTP headers, the memory consumption of keeping it in memory
   // is acceptable.
   scoped_refptr<net::GrowableIOBuffer> stream_0_data_;
+
+  // True if the entry was opened by OpenEntryWithReadAhead() with a read
+  // ahead, whose callers expect the reads from memory to complete
+  // synchronously.
+  bool read_ahead_;
+
+  // The start of stream 1, if it was read ahead by OpenEntryWithReadAhead().
+  // It is dropped on the first write to stream 1.
+  scoped_refptr<net::IOBufferWithSize> stream_1_read_ahead_;
+
+  // With kSimpleCacheWriteBuffering, the small writes appending to stream 1 or
+  // 2 are copied to |write_buffer_| and complete right away. The buffer is
+  // written to disk in one write once it is large enough, before any other
+  // operation that needs the data on disk, or along with the CRCs and EOF
+  // records when the entry is closed. Until then, the data is lost if the
+  // process dies. Like an optimistic write, a buffered write that fails once
+  // flushed fails the next operations, and dooms the entry.
+  scoped_refptr<net::GrowableIOBuffer> write_buffer_;
+  int write_buffer_stream_;
+  // The offset in |write_buffer_stream_| of the start of |write_buffer_|.
+  int write_buffer_offset_;
+  int write_buffer_size_;
 };
 
 }  // namespace disk_cache
@@ -57,6 +57,7 @@ SimpleEntryOperation::~SimpleEntryOperation() {}
 SimpleEntryOperation SimpleEntryOperation::OpenOperation(
     SimpleEntryImpl* entry,
     bool have_index,
+    int read_ahead_size,
     const CompletionCallback& callback,
     Entry** out_entry) {
   return SimpleEntryOperation(entry,
@@ -65,7 +66,7 @@ SimpleEntryOperation SimpleEntryOperation::OpenOperation(
                               out_entry,
                               0,
                               0,
-                              0,
+                              read_ahead_size,
                               NULL,
                               TYPE_OPEN,
                               have_index,
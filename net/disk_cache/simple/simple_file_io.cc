@@ -0,0 +1,125 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_file_io.h"
+
+#include <memory>
+
+#include "base/files/file.h"
+#include "base/lazy_instance.h"
+#include "base/macros.h"
+#include "build/build_config.h"
+
+#if defined(OS_LINUX)
+#include "net/disk_cache/simple/simple_file_io_uring_linux.h"
+#endif
+
+#if defined(OS_LINUX) && defined(SIMPLE_CACHE_IO_URING_SUPPORTED)
+#define USE_IO_URING 1
+#endif
+
+namespace disk_cache {
+
+namespace {
+
+// Performs each request with a blocking call on the calling thread, which is
+// a thread of the simple cache worker pool.
+class BlockingFileIO : public SimpleFileIO {
+ public:
+  BlockingFileIO() {}
+  ~BlockingFileIO() override {}
+
+  Engine engine() const override { return ENGINE_BLOCKING; }
+
+  bool Run(Request* requests, size_t count) override {
+    bool success = true;
+    for (size_t i = 0; i < count; ++i) {
+      Request& request = requests[i];
+      if (request.type == Request::READ) {
+        request.result =
+            request.file->Read(request.offset, request.data, request.size);
+      } else {
+        request.result =
+            request.file->Write(request.offset, request.data, request.size);
+      }
+      if (request.result != request.size)
+        success = false;
+    }
+    return success;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(BlockingFileIO);
+};
+
+base::LazyInstance<BlockingFileIO>::Leaky g_blocking_file_io =
+    LAZY_INSTANCE_INITIALIZER;
+
+#if defined(USE_IO_URING)
+// Creates the io_uring engine the first time it is selected, and keeps it
+// for the life of the process, like the worker pool. Holds null if io_uring
+// is not available, e.g. on older kernels or when blocked by a sandbox.
+class LeakyFileIOUring {
+ public:
+  LeakyFileIOUring() : file_io_(SimpleFileIOUring::Create()) {}
+
+  SimpleFileIO* get() { return file_io_.get(); }
+
+ private:
+  std::unique_ptr<SimpleFileIOUring> file_io_;
+
+  DISALLOW_COPY_AND_ASSIGN(LeakyFileIOUring);
+};
+
+base::LazyInstance<LeakyFileIOUring>::Leaky g_file_io_uring =
+    LAZY_INSTANCE_INITIALIZER;
+#endif  // defined(USE_IO_URING)
+
+}  // namespace
+
+const base::Feature kSimpleCacheIOUring{"SimpleCacheIOUring",
+                                        base::FEATURE_DISABLED_BY_DEFAULT};
+
+// static
+SimpleFileIO::Request SimpleFileIO::Request::Read(base::File* file,
+                                                  int64_t offset,
+                                                  char* data,
+                                                  int size) {
+  Request request = {READ, file, offset, data, size, 0};
+  return request;
+}
+
+// static
+SimpleFileIO::Request SimpleFileIO::Request::Write(base::File* file,
+                                                   int64_t offset,
+                                                   const char* data,
+                                                   int size) {
+  // The data of a write is only read from.
+  Request request = {WRITE, file, offset, const_cast<char*>(data), size, 0};
+  return request;
+}
+
+// static
+SimpleFileIO* SimpleFileIO::Get() {
+#if defined(USE_IO_URING)
+  if (IsIOUringAvailable())
+    return g_file_io_uring.Get().get();
+#endif
+  return g_blocking_file_io.Pointer();
+}
+
+// static
+bool SimpleFileIO::IsIOUringAvailable() {
+#if defined(USE_IO_URING)
+  // The ring and its completion thread are only created once the engine is
+  // selected.
+  if (!base::FeatureList::IsEnabled(kSimpleCacheIOUring))
+    return false;
+  return g_file_io_uring.Get().get() != nullptr;
+#else
+  return false;
+#endif
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,78 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_FILE_IO_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_FILE_IO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "base/feature_list.h"
+#include "net/base/net_export.h"
+
+namespace base {
+class File;
+}
+
+namespace disk_cache {
+
+// Submits the positioned reads and writes of SimpleSynchronousEntry to io_uring
+// instead of issuing them as blocking system calls, where the kernel supports
+// it.
+NET_EXPORT_PRIVATE extern const base::Feature kSimpleCacheIOUring;
+
+// Performs the file IO of a SimpleSynchronousEntry operation. The IO of one
+// operation is handed over as a single batch, so that an engine able to
+// submit several requests at once can do so. Engines are shared by all
+// worker threads and must be thread safe.
+class NET_EXPORT_PRIVATE SimpleFileIO {
+ public:
+  // The engines Get() may return.
+  enum Engine {
+    ENGINE_BLOCKING,
+    ENGINE_IO_URING,
+  };
+
+  struct Request {
+    enum Type { READ, WRITE };
+
+    static Request Read(base::File* file, int64_t offset, char* data, int size);
+    static Request Write(base::File* file,
+                         int64_t offset,
+                         const char* data,
+                         int size);
+
+    Type type;
+    base::File* file;
+    int64_t offset;
+    char* data;
+    int size;
+
+    // Set by Run(): the number of bytes transferred, or -1 on error.
+    int result;
+  };
+
+  // Returns the engine to use for a new entry: the io_uring engine if
+  // kSimpleCacheIOUring is enabled and io_uring is available, or an engine
+  // making blocking calls on the calling worker thread otherwise.
+  static SimpleFileIO* Get();
+
+  // Returns true if Get() returns the io_uring engine: kSimpleCacheIOUring is
+  // enabled and io_uring is available. The io_uring engine is not created
+  // while the feature is disabled.
+  static bool IsIOUringAvailable();
+
+  virtual ~SimpleFileIO() {}
+
+  virtual Engine engine() const = 0;
+
+  // Performs the |count| |requests| and sets their results. The requests of a
+  // batch may be performed in any order, and must not overlap. Returns true
+  // if every request transferred its full size.
+  virtual bool Run(Request* requests, size_t count) = 0;
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_FILE_IO_H_
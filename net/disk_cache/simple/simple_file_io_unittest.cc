@@ -0,0 +1,91 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_file_io.h"
+
+#include <string.h>
+
+#include "base/files/file.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/test/scoped_feature_list.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+// Writes and reads back several ranges of a file, a batch at a time.
+void CheckBatches(SimpleFileIO* file_io) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  base::File file(temp_dir.path().AppendASCII("file"),
+                  base::File::FLAG_CREATE | base::File::FLAG_READ |
+                      base::File::FLAG_WRITE);
+  ASSERT_TRUE(file.IsValid());
+
+  const char kFirst[] = "first";
+  const char kSecond[] = "second";
+  const int kSecondOffset = 4096;
+  SimpleFileIO::Request writes[] = {
+      SimpleFileIO::Request::Write(&file, kSecondOffset, kSecond,
+                                   sizeof(kSecond)),
+      SimpleFileIO::Request::Write(&file, 0, kFirst, sizeof(kFirst)),
+  };
+  EXPECT_TRUE(file_io->Run(writes, arraysize(writes)));
+  EXPECT_EQ(static_cast<int>(sizeof(kSecond)), writes[0].result);
+  EXPECT_EQ(static_cast<int>(sizeof(kFirst)), writes[1].result);
+
+  char first[sizeof(kFirst)];
+  char second[sizeof(kSecond)];
+  SimpleFileIO::Request reads[] = {
+      SimpleFileIO::Request::Read(&file, 0, first, sizeof(first)),
+      SimpleFileIO::Request::Read(&file, kSecondOffset, second,
+                                  sizeof(second)),
+  };
+  EXPECT_TRUE(file_io->Run(reads, arraysize(reads)));
+  EXPECT_EQ(0, memcmp(kFirst, first, sizeof(first)));
+  EXPECT_EQ(0, memcmp(kSecond, second, sizeof(second)));
+
+  // A read past the end of the file is short, which fails the batch.
+  char past_end[sizeof(kSecond) + 10];
+  SimpleFileIO::Request short_read = SimpleFileIO::Request::Read(
+      &file, kSecondOffset, past_end, sizeof(past_end));
+  EXPECT_FALSE(file_io->Run(&short_read, 1));
+  EXPECT_EQ(static_cast<int>(sizeof(kSecond)), short_read.result);
+
+  EXPECT_TRUE(file_io->Run(nullptr, 0));
+}
+
+}  // namespace
+
+TEST(SimpleFileIOTest, Blocking) {
+  SimpleFileIO* file_io = SimpleFileIO::Get();
+  ASSERT_EQ(SimpleFileIO::ENGINE_BLOCKING, file_io->engine());
+  CheckBatches(file_io);
+}
+
+TEST(SimpleFileIOTest, IOUring) {
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndEnableFeature(kSimpleCacheIOUring);
+  if (!SimpleFileIO::IsIOUringAvailable()) {
+    LOG(WARNING) << "io_uring is not available, skipping test";
+    return;
+  }
+  SimpleFileIO* file_io = SimpleFileIO::Get();
+  ASSERT_EQ(SimpleFileIO::ENGINE_IO_URING, file_io->engine());
+  CheckBatches(file_io);
+}
+
+// Without the feature, the blocking engine is used even if io_uring is
+// available.
+TEST(SimpleFileIOTest, IOUringDisabled) {
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndDisableFeature(kSimpleCacheIOUring);
+  EXPECT_FALSE(SimpleFileIO::IsIOUringAvailable());
+  EXPECT_EQ(SimpleFileIO::ENGINE_BLOCKING, SimpleFileIO::Get()->engine());
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,268 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_file_io_uring_linux.h"
+
+#if defined(SIMPLE_CACHE_IO_URING_SUPPORTED)
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "base/files/file.h"
+#include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/synchronization/waitable_event.h"
+
+namespace disk_cache {
+
+namespace {
+
+// The number of submission queue entries. The worker pool runs a handful of
+// threads, each with one batch of a few requests in flight.
+const uint32_t kQueueDepth = 64;
+
+int IOUringSetup(uint32_t entries, io_uring_params* params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int IOUringEnter(int fd,
+                 uint32_t to_submit,
+                 uint32_t min_complete,
+                 uint32_t flags) {
+  return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                 nullptr, 0);
+}
+
+volatile base::subtle::Atomic32* RingPointer(void* ring, uint32_t offset) {
+  return reinterpret_cast<volatile base::subtle::Atomic32*>(
+      static_cast<char*>(ring) + offset);
+}
+
+uint32_t RingValue(void* ring, uint32_t offset) {
+  return *reinterpret_cast<uint32_t*>(static_cast<char*>(ring) + offset);
+}
+
+}  // namespace
+
+// The requests of a batch, and the event its worker thread waits on. Lives on
+// the stack of the worker thread.
+struct SimpleFileIOUring::Batch {
+  Batch()
+      : pending(0),
+        done(base::WaitableEvent::ResetPolicy::MANUAL,
+             base::WaitableEvent::InitialState::NOT_SIGNALED) {}
+
+  // Only used on the completion thread once the batch is submitted.
+  size_t pending;
+  base::WaitableEvent done;
+};
+
+// The user data of a submission, pointed to by its completion.
+struct SimpleFileIOUring::InFlightRequest {
+  Request* request;
+  Batch* batch;
+  iovec iov;
+};
+
+// static
+std::unique_ptr<SimpleFileIOUring> SimpleFileIOUring::Create() {
+  std::unique_ptr<SimpleFileIOUring> file_io(new SimpleFileIOUring());
+  if (!file_io->Init())
+    return nullptr;
+  return file_io;
+}
+
+SimpleFileIOUring::SimpleFileIOUring()
+    : ring_fd_(-1),
+      ring_(MAP_FAILED),
+      ring_size_(0),
+      sqes_(static_cast<io_uring_sqe*>(MAP_FAILED)),
+      sqes_size_(0),
+      sq_head_(nullptr),
+      sq_tail_(nullptr),
+      sq_mask_(0),
+      sq_entries_(0),
+      sq_array_(nullptr),
+      unsubmitted_(0),
+      cq_head_(nullptr),
+      cq_tail_(nullptr),
+      cq_mask_(0),
+      cqes_(nullptr) {}
+
+SimpleFileIOUring::~SimpleFileIOUring() {
+  if (sqes_ != MAP_FAILED)
+    munmap(sqes_, sqes_size_);
+  if (ring_ != MAP_FAILED)
+    munmap(ring_, ring_size_);
+  if (ring_fd_ >= 0)
+    IGNORE_EINTR(close(ring_fd_));
+}
+
+bool SimpleFileIOUring::Init() {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring_fd_ = IOUringSetup(kQueueDepth, &params);
+  if (ring_fd_ < 0) {
+    DVLOG(1) << "io_uring is not available: " << errno;
+    return false;
+  }
+
+  // Without IORING_FEAT_NODROP, completions past the size of the completion
+  // queue would be lost and the batches waiting for them would never finish.
+  // Kernels without it use the blocking engine instead.
+  if (!(params.features & IORING_FEAT_NODROP) ||
+      !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+    return false;
+  }
+
+  ring_size_ =
+      std::max(params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+               params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+  ring_ = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  if (ring_ == MAP_FAILED)
+    return false;
+
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size_,
+                                          PROT_READ | PROT_WRITE,
+                                          MAP_SHARED | MAP_POPULATE, ring_fd_,
+                                          IORING_OFF_SQES));
+  if (sqes_ == MAP_FAILED)
+    return false;
+
+  sq_head_ = RingPointer(ring_, params.sq_off.head);
+  sq_tail_ = RingPointer(ring_, params.sq_off.tail);
+  sq_mask_ = RingValue(ring_, params.sq_off.ring_mask);
+  sq_entries_ = params.sq_entries;
+  sq_array_ = reinterpret_cast<uint32_t*>(static_cast<char*>(ring_) +
+                                          params.sq_off.array);
+  cq_head_ = RingPointer(ring_, params.cq_off.head);
+  cq_tail_ = RingPointer(ring_, params.cq_off.tail);
+  cq_mask_ = RingValue(ring_, params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(static_cast<char*>(ring_) +
+                                          params.cq_off.cqes);
+
+  return base::PlatformThread::CreateNonJoinable(0, this);
+}
+
+SimpleFileIO::Engine SimpleFileIOUring::engine() const {
+  return ENGINE_IO_URING;
+}
+
+bool SimpleFileIOUring::Run(Request* requests, size_t count) {
+  if (!count)
+    return true;
+
+  Batch batch;
+  batch.pending = count;
+  std::vector<InFlightRequest> in_flight(count);
+  {
+    base::AutoLock lock(submit_lock_);
+    uint32_t tail = base::subtle::NoBarrier_Load(sq_tail_);
+    for (size_t i = 0; i < count; ++i) {
+      // The kernel consumes the queued entries when they are submitted, which
+      // makes room for more.
+      if (tail - base::subtle::Acquire_Load(sq_head_) == sq_entries_) {
+        SubmitLocked();
+        DCHECK_NE(tail - base::subtle::Acquire_Load(sq_head_), sq_entries_);
+      }
+
+      InFlightRequest& in_flight_request = in_flight[i];
+      in_flight_request.request = &requests[i];
+      in_flight_request.batch = &batch;
+      in_flight_request.iov.iov_base = requests[i].data;
+      in_flight_request.iov.iov_len = requests[i].size;
+
+      const uint32_t index = tail & sq_mask_;
+      io_uring_sqe* sqe = &sqes_[index];
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = requests[i].type == Request::READ ? IORING_OP_READV
+                                                      : IORING_OP_WRITEV;
+      sqe->fd = requests[i].file->GetPlatformFile();
+      sqe->off = requests[i].offset;
+      sqe->addr = reinterpret_cast<uint64_t>(&in_flight_request.iov);
+      sqe->len = 1;
+      sqe->user_data = reinterpret_cast<uint64_t>(&in_flight_request);
+      sq_array_[index] = index;
+
+      ++tail;
+      ++unsubmitted_;
+      base::subtle::Release_Store(sq_tail_, tail);
+    }
+    SubmitLocked();
+  }
+
+  batch.done.Wait();
+
+  bool success = true;
+  for (size_t i = 0; i < count; ++i) {
+    Request& request = requests[i];
+    // Unlike base::File, io_uring does not retry short transfers. They are
+    // rare, so the rest is done with a blocking call.
+    if (request.result > 0 && request.result < request.size) {
+      const int64_t offset = request.offset + request.result;
+      char* data = request.data + request.result;
+      const int size = request.size - request.result;
+      const int rv = request.type == Request::READ
+                         ? request.file->Read(offset, data, size)
+                         : request.file->Write(offset, data, size);
+      if (rv > 0)
+        request.result += rv;
+    }
+    if (request.result != request.size)
+      success = false;
+  }
+  return success;
+}
+
+void SimpleFileIOUring::SubmitLocked() {
+  submit_lock_.AssertAcquired();
+  while (unsubmitted_) {
+    int rv = IOUringEnter(ring_fd_, unsubmitted_, 0, 0);
+    if (rv > 0) {
+      unsubmitted_ -= rv;
+      continue;
+    }
+    // EAGAIN and EBUSY mean the kernel is short of resources or that
+    // completions are backlogged; the completion thread will drain them.
+    PCHECK(rv == 0 || errno == EINTR || errno == EAGAIN || errno == EBUSY);
+    base::PlatformThread::YieldCurrentThread();
+  }
+}
+
+void SimpleFileIOUring::ThreadMain() {
+  base::PlatformThread::SetName("SimpleCacheIOUring");
+  while (true) {
+    int rv = IOUringEnter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS);
+    PCHECK(rv >= 0 || errno == EINTR || errno == EAGAIN || errno == EBUSY);
+
+    uint32_t head = base::subtle::NoBarrier_Load(cq_head_);
+    const uint32_t tail = base::subtle::Acquire_Load(cq_tail_);
+    for (; head != tail; ++head) {
+      const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+      InFlightRequest* in_flight_request =
+          reinterpret_cast<InFlightRequest*>(cqe.user_data);
+      in_flight_request->request->result = cqe.res < 0 ? -1 : cqe.res;
+
+      // The batch goes away as soon as it is signaled.
+      Batch* batch = in_flight_request->batch;
+      if (!--batch->pending)
+        batch->done.Signal();
+    }
+    base::subtle::Release_Store(cq_head_, head);
+  }
+}
+
+}  // namespace disk_cache
+
+#endif  // defined(SIMPLE_CACHE_IO_URING_SUPPORTED)
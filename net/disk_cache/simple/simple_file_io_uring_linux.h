@@ -0,0 +1,95 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_FILE_IO_URING_LINUX_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_FILE_IO_URING_LINUX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+#include "base/atomicops.h"
+#include "base/macros.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/simple/simple_file_io.h"
+
+// The io_uring engine is only built against kernel headers that declare
+// io_uring. Older sysroots lack <linux/io_uring.h>.
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define SIMPLE_CACHE_IO_URING_SUPPORTED 1
+#endif
+#endif
+
+struct io_uring_cqe;
+struct io_uring_sqe;
+
+namespace disk_cache {
+
+// A SimpleFileIO engine submitting requests to a single io_uring shared by
+// all worker threads. A worker thread queues all the requests of a batch and
+// enters the kernel once to submit them, instead of making one system call
+// per request. The kernel performs the requests of a batch concurrently, and
+// a dedicated thread reaps all completions and wakes up the worker threads
+// whose batches are done.
+class NET_EXPORT_PRIVATE SimpleFileIOUring
+    : public SimpleFileIO,
+      public base::PlatformThread::Delegate {
+ public:
+  // Returns null if io_uring is not available.
+  static std::unique_ptr<SimpleFileIOUring> Create();
+
+  // The completion thread is never stopped, so an instance must be leaked.
+  ~SimpleFileIOUring() override;
+
+  // SimpleFileIO:
+  Engine engine() const override;
+  bool Run(Request* requests, size_t count) override;
+
+  // base::PlatformThread::Delegate, the completion thread:
+  void ThreadMain() override;
+
+ private:
+  struct Batch;
+  struct InFlightRequest;
+
+  SimpleFileIOUring();
+
+  // Sets up the ring and starts the completion thread.
+  bool Init();
+
+  // Submits the queued requests up to |sq_tail_|. Requires |submit_lock_|.
+  void SubmitLocked();
+
+  int ring_fd_;
+
+  void* ring_;
+  size_t ring_size_;
+  io_uring_sqe* sqes_;
+  size_t sqes_size_;
+
+  // The submission queue, written by the worker threads under |submit_lock_|.
+  base::Lock submit_lock_;
+  volatile base::subtle::Atomic32* sq_head_;
+  volatile base::subtle::Atomic32* sq_tail_;
+  uint32_t sq_mask_;
+  uint32_t sq_entries_;
+  uint32_t* sq_array_;
+  uint32_t unsubmitted_;
+
+  // The completion queue, only used on the completion thread.
+  volatile base::subtle::Atomic32* cq_head_;
+  volatile base::subtle::Atomic32* cq_tail_;
+  uint32_t cq_mask_;
+  io_uring_cqe* cqes_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleFileIOUring);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_FILE_IO_URING_LINUX_H_
@@ -0,0 +1,100 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_frequency_sketch.h"
+
+#include <algorithm>
+
+namespace disk_cache {
+
+namespace {
+
+const int kDepth = 4;
+const int kCountersPerWord = 16;
+const size_t kMinWidth = kCountersPerWord;
+
+// Entry hashes are already uniformly distributed, so each row only needs to
+// pick different bits of them.
+const uint64_t kSeeds[kDepth] = {
+    UINT64_C(0xc3a5c85c97cb3127), UINT64_C(0xb492b66fbe98f273),
+    UINT64_C(0x9ae16a3b2f90404f), UINT64_C(0xcbf29ce484222325),
+};
+
+}  // namespace
+
+const int SimpleFrequencySketch::kMaxFrequency;
+const size_t SimpleFrequencySketch::kMaxWidth;
+
+SimpleFrequencySketch::SimpleFrequencySketch()
+    : table_(kDepth * kMinWidth / kCountersPerWord),
+      width_(kMinWidth),
+      additions_(0),
+      sample_size_(10 * kMinWidth) {}
+
+SimpleFrequencySketch::~SimpleFrequencySketch() {}
+
+void SimpleFrequencySketch::EnsureCapacity(size_t entry_count) {
+  if (entry_count <= width_ || width_ == kMaxWidth)
+    return;
+  size_t width = width_;
+  while (width < entry_count && width < kMaxWidth)
+    width *= 2;
+
+  // The counter of a hash in a row is picked by the low bits of its row hash,
+  // so in the wider row it is one of the copies of its counter in the old row.
+  // Copying the old row over the new one keeps every estimate.
+  const size_t old_row_words = width_ / kCountersPerWord;
+  const size_t row_words = width / kCountersPerWord;
+  std::vector<uint64_t> table(kDepth * row_words);
+  for (int row = 0; row < kDepth; ++row) {
+    for (size_t word = 0; word < row_words; ++word) {
+      table[row * row_words + word] =
+          table_[row * old_row_words + word % old_row_words];
+    }
+  }
+  table_.swap(table);
+  width_ = width;
+  sample_size_ = 10 * width_;
+}
+
+void SimpleFrequencySketch::Increment(uint64_t entry_hash) {
+  bool added = false;
+  for (int row = 0; row < kDepth; ++row) {
+    const size_t index = CounterIndex(entry_hash, row);
+    if (GetCounter(index) < kMaxFrequency) {
+      table_[index / kCountersPerWord] +=
+          UINT64_C(1) << (4 * (index % kCountersPerWord));
+      added = true;
+    }
+  }
+  if (added && ++additions_ == sample_size_)
+    Age();
+}
+
+int SimpleFrequencySketch::Estimate(uint64_t entry_hash) const {
+  int frequency = kMaxFrequency;
+  for (int row = 0; row < kDepth; ++row)
+    frequency = std::min(frequency, GetCounter(CounterIndex(entry_hash, row)));
+  return frequency;
+}
+
+size_t SimpleFrequencySketch::CounterIndex(uint64_t entry_hash,
+                                           int row) const {
+  uint64_t hash = (entry_hash + kSeeds[row]) * kSeeds[row];
+  hash ^= hash >> 32;
+  return row * width_ + (hash & (width_ - 1));
+}
+
+int SimpleFrequencySketch::GetCounter(size_t index) const {
+  return (table_[index / kCountersPerWord] >>
+          (4 * (index % kCountersPerWord))) & 0xf;
+}
+
+void SimpleFrequencySketch::Age() {
+  for (uint64_t& word : table_)
+    word = (word >> 1) & UINT64_C(0x7777777777777777);
+  additions_ /= 2;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,71 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_FREQUENCY_SKETCH_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_FREQUENCY_SKETCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "base/macros.h"
+#include "net/base/net_export.h"
+
+namespace disk_cache {
+
+// Estimates how often each entry hash was requested recently, for the TinyLFU
+// eviction policy of SimpleIndex. This is a Count-Min sketch of 4-bit
+// counters: a request increments one counter in each of four rows, and the
+// estimate is the smallest of them. Once the number of recorded requests
+// reaches ten times the width, all counters are halved, so that entries that
+// stop being requested lose their advantage.
+//
+// Uses two bytes per entry of capacity, and at most 2 MB.
+class NET_EXPORT_PRIVATE SimpleFrequencySketch {
+ public:
+  static const int kMaxFrequency = 15;
+  static const size_t kMaxWidth = 1 << 20;
+
+  SimpleFrequencySketch();
+  ~SimpleFrequencySketch();
+
+  // Grows the sketch to have at least one counter per row for each of
+  // |entry_count| entries. Growing keeps the estimates of the requests
+  // recorded so far.
+  void EnsureCapacity(size_t entry_count);
+
+  void Increment(uint64_t entry_hash);
+
+  // Returns the estimated number of recent requests, up to kMaxFrequency.
+  int Estimate(uint64_t entry_hash) const;
+
+  size_t width() const { return width_; }
+
+  size_t EstimateMemoryUsage() const {
+    return table_.capacity() * sizeof(uint64_t);
+  }
+
+ private:
+  // Returns the index of the counter of |entry_hash| in |row|.
+  size_t CounterIndex(uint64_t entry_hash, int row) const;
+
+  int GetCounter(size_t index) const;
+
+  // Halves all counters.
+  void Age();
+
+  // The counters of all rows, sixteen per word.
+  std::vector<uint64_t> table_;
+  size_t width_;
+
+  size_t additions_;
+  size_t sample_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleFrequencySketch);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_FREQUENCY_SKETCH_H_
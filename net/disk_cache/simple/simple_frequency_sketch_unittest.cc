@@ -0,0 +1,77 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_frequency_sketch.h"
+
+#include "base/strings/stringprintf.h"
+#include "net/disk_cache/simple/simple_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+uint64_t HashForKey(int i) {
+  return simple_util::GetEntryHashKey(base::StringPrintf("key%d", i));
+}
+
+}  // namespace
+
+TEST(SimpleFrequencySketchTest, Estimate) {
+  SimpleFrequencySketch sketch;
+  EXPECT_EQ(0, sketch.Estimate(HashForKey(1)));
+
+  for (int i = 0; i < 5; ++i)
+    sketch.Increment(HashForKey(1));
+  sketch.Increment(HashForKey(2));
+
+  // The sketch may overestimate, but never underestimates.
+  EXPECT_LE(5, sketch.Estimate(HashForKey(1)));
+  EXPECT_LE(1, sketch.Estimate(HashForKey(2)));
+  EXPECT_GT(sketch.Estimate(HashForKey(1)), sketch.Estimate(HashForKey(2)));
+}
+
+TEST(SimpleFrequencySketchTest, Saturates) {
+  SimpleFrequencySketch sketch;
+  for (int i = 0; i < 2 * SimpleFrequencySketch::kMaxFrequency; ++i)
+    sketch.Increment(HashForKey(1));
+  EXPECT_EQ(SimpleFrequencySketch::kMaxFrequency,
+            sketch.Estimate(HashForKey(1)));
+}
+
+// Counters are halved once enough requests were recorded, so that an entry
+// which is no longer requested loses its advantage.
+TEST(SimpleFrequencySketchTest, Ages) {
+  SimpleFrequencySketch sketch;
+  sketch.EnsureCapacity(1000);
+  for (int i = 0; i < SimpleFrequencySketch::kMaxFrequency; ++i)
+    sketch.Increment(HashForKey(0));
+  EXPECT_EQ(SimpleFrequencySketch::kMaxFrequency,
+            sketch.Estimate(HashForKey(0)));
+
+  for (size_t i = 0; i < 10 * sketch.width(); ++i)
+    sketch.Increment(HashForKey(static_cast<int>(1 + i)));
+  EXPECT_GT(SimpleFrequencySketch::kMaxFrequency,
+            sketch.Estimate(HashForKey(0)));
+}
+
+TEST(SimpleFrequencySketchTest, EnsureCapacity) {
+  SimpleFrequencySketch sketch;
+  const size_t initial_width = sketch.width();
+  sketch.Increment(HashForKey(1));
+
+  sketch.EnsureCapacity(initial_width);
+  EXPECT_EQ(initial_width, sketch.width());
+  EXPECT_EQ(1, sketch.Estimate(HashForKey(1)));
+
+  // Growing keeps the requests recorded so far.
+  sketch.EnsureCapacity(5000);
+  EXPECT_EQ(8192u, sketch.width());
+  EXPECT_EQ(1, sketch.Estimate(HashForKey(1)));
+
+  sketch.EnsureCapacity(10 * SimpleFrequencySketch::kMaxWidth);
+  EXPECT_EQ(SimpleFrequencySketch::kMaxWidth, sketch.width());
+}
+
+}  // namespace disk_cache
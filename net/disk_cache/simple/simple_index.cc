@@ -28,6 +28,7 @@
 #include "net/disk_cache/simple/simple_histogram_macros.h"
 #include "net/disk_cache/simple/simple_index_delegate.h"
 #include "net/disk_cache/simple/simple_index_file.h"
+#include "net/disk_cache/simple/simple_index_table.h"
 #include "net/disk_cache/simple/simple_synchronous_entry.h"
 #include "net/disk_cache/simple/simple_util.h"
 
@@ -49,6 +50,10 @@ const uint32_t kEvictionMarginDivisor = 20;
 
 const uint32_t kBytesInKb = 1024;
 
+// With EVICTION_POLICY_TINY_LFU, the most recently used entries making up this
+// fraction of the cache are evicted last, in LRU order.
+const uint32_t kTinyLFUWindowDivisor = 100;
+
 // Utility class used for timestamp comparisons in entry metadata while sorting.
 class CompareHashesForTimestamp {
   typedef disk_cache::SimpleIndex SimpleIndex;
@@ -74,10 +79,36 @@ bool CompareHashesForTimestamp::operator()(uint64_t hash1, uint64_t hash2) {
   return it1->second.GetLastUsedTime() < it2->second.GetLastUsedTime();
 }
 
+// Utility class used to order entries by estimated request frequency.
+class CompareHashesForFrequency {
+ public:
+  explicit CompareHashesForFrequency(
+      const disk_cache::SimpleFrequencySketch& sketch);
+
+  bool operator()(uint64_t hash1, uint64_t hash2);
+
+ private:
+  const disk_cache::SimpleFrequencySketch& sketch_;
+};
+
+CompareHashesForFrequency::CompareHashesForFrequency(
+    const disk_cache::SimpleFrequencySketch& sketch)
+    : sketch_(sketch) {}
+
+bool CompareHashesForFrequency::operator()(uint64_t hash1, uint64_t hash2) {
+  return sketch_.Estimate(hash1) < sketch_.Estimate(hash2);
+}
+
 }  // namespace
 
 namespace disk_cache {
 
+const base::Feature kSimpleCacheTinyLFU{"SimpleCacheTinyLFU",
+                                        base::FEATURE_DISABLED_BY_DEFAULT};
+
+const base::Feature kSimpleCacheWarmUp{"SimpleCacheWarmUp",
+                                       base::FEATURE_DISABLED_BY_DEFAULT};
+
 EntryMetadata::EntryMetadata()
   : last_used_time_seconds_since_epoch_(0),
     entry_size_(0) {
@@ -151,6 +182,11 @@ SimpleIndex::SimpleIndex(
       high_watermark_(0),
       low_watermark_(0),
       eviction_in_progress_(false),
+      eviction_policy_(base::FeatureList::IsEnabled(kSimpleCacheTinyLFU)
+                           ? EVICTION_POLICY_TINY_LFU
+                           : EVICTION_POLICY_LRU),
+      record_requests_for_warm_up_(
+          base::FeatureList::IsEnabled(kSimpleCacheWarmUp)),
       initialized_(false),
       init_method_(INITIALIZE_METHOD_MAX),
       index_file_(std::move(index_file)),
@@ -200,6 +236,11 @@ void SimpleIndex::SetMaxSize(uint64_t max_bytes) {
   }
 }
 
+void SimpleIndex::SetEvictionPolicy(EvictionPolicy eviction_policy) {
+  DCHECK(io_thread_checker_.CalledOnValidThread());
+  eviction_policy_ = eviction_policy;
+}
+
 int SimpleIndex::ExecuteWhenReady(const net::CompletionCallback& task) {
   DCHECK(io_thread_checker_.CalledOnValidThread());
   if (initialized_)
@@ -248,6 +289,14 @@ uint64_t SimpleIndex::GetCacheSize() const {
   return cache_size_;
 }
 
+size_t SimpleIndex::EstimateMemoryUsage() const {
+  // Each element of the map is allocated in a node along with a pointer to
+  // the next one, and the map has an array of bucket pointers.
+  return entries_set_.size() * (sizeof(EntrySet::value_type) + sizeof(void*)) +
+         entries_set_.bucket_count() * sizeof(void*) +
+         frequency_sketch_.EstimateMemoryUsage();
+}
+
 void SimpleIndex::Insert(uint64_t entry_hash) {
   DCHECK(io_thread_checker_.CalledOnValidThread());
   // Upon insert we don't know yet the size of the entry.
@@ -255,6 +304,8 @@ void SimpleIndex::Insert(uint64_t entry_hash) {
   // creating the new entry, and then UpdateEntrySize will be called.
   InsertInEntrySet(entry_hash, EntryMetadata(base::Time::Now(), 0u),
                    &entries_set_);
+  RecordRequest(entry_hash);
+  RecordChange(entry_hash);
   if (!initialized_)
     removed_entries_.erase(entry_hash);
   PostponeWritingToDisk();
@@ -267,6 +318,7 @@ void SimpleIndex::Remove(uint64_t entry_hash) {
     UpdateEntryIteratorSize(&it, 0u);
     entries_set_.erase(it);
   }
+  RecordChange(entry_hash);
 
   if (!initialized_)
     removed_entries_.insert(entry_hash);
@@ -288,10 +340,84 @@ bool SimpleIndex::UseIfExists(uint64_t entry_hash) {
     // If not initialized, always return true, forcing it to go to the disk.
     return !initialized_;
   it->second.SetLastUsedTime(base::Time::Now());
+  RecordChange(entry_hash);
   PostponeWritingToDisk();
   return true;
 }
 
+void SimpleIndex::RecordRequest(uint64_t entry_hash) {
+  DCHECK(io_thread_checker_.CalledOnValidThread());
+  if (eviction_policy_ != EVICTION_POLICY_TINY_LFU &&
+      !record_requests_for_warm_up_) {
+    return;
+  }
+  frequency_sketch_.EnsureCapacity(entries_set_.size());
+  frequency_sketch_.Increment(entry_hash);
+}
+
+std::unique_ptr<SimpleIndex::HashList> SimpleIndex::GetHotEntries(
+    size_t max_count) const {
+  DCHECK(io_thread_checker_.CalledOnValidThread());
+  return SelectHotEntries(GetHotEntryCandidates(), max_count);
+}
+
+std::unique_ptr<SimpleIndex::HotEntryCandidateList>
+SimpleIndex::GetHotEntryCandidates() const {
+  DCHECK(io_thread_checker_.CalledOnValidThread());
+  std::unique_ptr<HotEntryCandidateList> candidates(
+      new HotEntryCandidateList());
+  for (const auto& entry : entries_set_) {
+    const int frequency = frequency_sketch_.Estimate(entry.first);
+    if (frequency > 0) {
+      HotEntryCandidate candidate;
+      candidate.entry_hash = entry.first;
+      candidate.frequency = frequency;
+      candidate.last_used_time = entry.second.GetLastUsedTime();
+      candidates->push_back(candidate);
+    }
+  }
+  return candidates;
+}
+
+// static
+std::unique_ptr<SimpleIndex::HashList> SimpleIndex::SelectHotEntries(
+    std::unique_ptr<HotEntryCandidateList> candidates,
+    size_t max_count) {
+  auto is_hotter = [](const HotEntryCandidate& a, const HotEntryCandidate& b) {
+    if (a.frequency != b.frequency)
+      return a.frequency > b.frequency;
+    return a.last_used_time > b.last_used_time;
+  };
+  // The warm set is much smaller than the index: the hottest entries are
+  // partitioned out before being sorted.
+  if (candidates->size() > max_count) {
+    std::nth_element(candidates->begin(), candidates->begin() + max_count,
+                     candidates->end(), is_hotter);
+    candidates->resize(max_count);
+  }
+  std::sort(candidates->begin(), candidates->end(), is_hotter);
+  std::unique_ptr<HashList> hot_entries(new HashList());
+  hot_entries->reserve(candidates->size());
+  for (const HotEntryCandidate& candidate : *candidates)
+    hot_entries->push_back(candidate.entry_hash);
+  return hot_entries;
+}
+
+void SimpleIndex::WriteHotEntriesToDisk(size_t max_count) {
+  DCHECK(io_thread_checker_.CalledOnValidThread());
+  if (!initialized_)
+    return;
+  // Keeps the entries written last time if none were requested since.
+  std::unique_ptr<HotEntryCandidateList> candidates = GetHotEntryCandidates();
+  if (!candidates->empty())
+    index_file_->WriteHotEntries(std::move(candidates), max_count);
+}
+
+void SimpleIndex::LoadHotEntries(const HotEntriesCallback& callback) {
+  DCHECK(io_thread_checker_.CalledOnValidThread());
+  index_file_->LoadHotEntries(callback);
+}
+
 void SimpleIndex::StartEvictionIfNeeded() {
   DCHECK(io_thread_checker_.CalledOnValidThread());
   if (eviction_in_progress_ || cache_size_ <= high_watermark_)
@@ -313,6 +439,19 @@ void SimpleIndex::StartEvictionIfNeeded() {
   }
   std::sort(entry_hashes.begin(), entry_hashes.end(),
             CompareHashesForTimestamp(entries_set_));
+  if (eviction_policy_ == EVICTION_POLICY_TINY_LFU) {
+    // Leave the window at the end, and order the rest by frequency. The sort
+    // is stable, so equally frequent entries stay in LRU order.
+    std::vector<uint64_t>::iterator window_begin = entry_hashes.end();
+    uint64_t window_size = 0;
+    while (window_begin != entry_hashes.begin() &&
+           window_size < max_size_ / kTinyLFUWindowDivisor) {
+      --window_begin;
+      window_size += entries_set_.find(*window_begin)->second.GetEntrySize();
+    }
+    std::stable_sort(entry_hashes.begin(), window_begin,
+                     CompareHashesForFrequency(frequency_sketch_));
+  }
 
   // Remove as many entries from the index to get below |low_watermark_|.
   std::vector<uint64_t>::iterator it = entry_hashes.begin();
@@ -349,6 +488,7 @@ bool SimpleIndex::UpdateEntrySize(uint64_t entry_hash,
     return false;
 
   UpdateEntryIteratorSize(&it, entry_size);
+  RecordChange(entry_hash);
   PostponeWritingToDisk();
   StartEvictionIfNeeded();
   return true;
@@ -387,6 +527,11 @@ void SimpleIndex::PostponeWritingToDisk() {
       FROM_HERE, base::TimeDelta::FromMilliseconds(delay), write_to_disk_cb_);
 }
 
+void SimpleIndex::RecordChange(uint64_t entry_hash) {
+  if (index_file_->uses_index_table())
+    changed_entries_.insert(entry_hash);
+}
+
 void SimpleIndex::UpdateEntryIteratorSize(
     EntrySet::iterator* it,
     base::StrictNumeric<uint32_t> entry_size) {
@@ -486,6 +631,28 @@ void SimpleIndex::WriteToDisk(IndexWriteToDiskReason reason) {
   }
   last_write_to_disk_ = start;
 
+  // Changes made before initialization, which are already merged in, are
+  // written along with the others. Restored indexes are written whole.
+  if (index_file_->uses_index_table() &&
+      reason != INDEX_WRITE_REASON_STARTUP_MERGE) {
+    std::unique_ptr<SimpleIndexTable::ChangeList> changes(
+        new SimpleIndexTable::ChangeList());
+    changes->reserve(changed_entries_.size());
+    for (uint64_t entry_hash : changed_entries_) {
+      EntrySet::const_iterator it = entries_set_.find(entry_hash);
+      if (it == entries_set_.end()) {
+        changes->push_back(SimpleIndexTable::Change::Removal(entry_hash));
+      } else {
+        changes->push_back(SimpleIndexTable::Change(entry_hash, it->second));
+      }
+    }
+    changed_entries_.clear();
+    index_file_->WriteChangesToDisk(reason, std::move(changes), start,
+                                    app_on_background_, base::Closure());
+    return;
+  }
+
+  changed_entries_.clear();
   index_file_->WriteToDisk(reason, entries_set_, cache_size_, start,
                            app_on_background_, base::Closure());
 }
@@ -5,6 +5,7 @@
 #ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_H_
 #define NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <list>
@@ -14,6 +15,7 @@
 #include <vector>
 
 #include "base/callback.h"
+#include "base/feature_list.h"
 #include "base/files/file_path.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/ref_counted.h"
@@ -26,6 +28,7 @@
 #include "net/base/cache_type.h"
 #include "net/base/completion_callback.h"
 #include "net/base/net_export.h"
+#include "net/disk_cache/simple/simple_frequency_sketch.h"
 
 #if defined(OS_ANDROID)
 #include "base/android/application_status_listener.h"
@@ -42,6 +45,13 @@ class SimpleIndexDelegate;
 class SimpleIndexFile;
 struct SimpleIndexLoadResult;
 
+// Makes SimpleIndex::EVICTION_POLICY_TINY_LFU the default eviction policy.
+NET_EXPORT_PRIVATE extern const base::Feature kSimpleCacheTinyLFU;
+
+// Records the entries requested the most when the cache is closed, and warms
+// them up when it is next opened. See SimpleCacheWarmer.
+NET_EXPORT_PRIVATE extern const base::Feature kSimpleCacheWarmUp;
+
 class NET_EXPORT_PRIVATE EntryMetadata {
  public:
   EntryMetadata();
@@ -97,8 +107,33 @@ class NET_EXPORT_PRIVATE SimpleIndex
     INDEX_WRITE_REASON_MAX = 4,
   };
 
+  // How entries are picked for eviction.
+  enum EvictionPolicy {
+    // The least recently used entries first.
+    EVICTION_POLICY_LRU,
+    // Window TinyLFU: the most recently used entries, about 1% of the cache,
+    // are a window that is evicted last. Among the other entries, the ones
+    // requested the least often recently are evicted first, and the least
+    // recently used among equally frequent ones. A new entry leaving the
+    // window thus only stays if it is requested more often than the entries
+    // already in the cache, which keeps responses that are only requested
+    // once from flushing the entries that are used all the time.
+    EVICTION_POLICY_TINY_LFU,
+  };
+
   typedef std::vector<uint64_t> HashList;
 
+  // An entry with a request recorded, from which the hot entries are picked.
+  struct HotEntryCandidate {
+    uint64_t entry_hash;
+    int frequency;
+    base::Time last_used_time;
+  };
+  typedef std::vector<HotEntryCandidate> HotEntryCandidateList;
+
+  using HotEntriesCallback =
+      base::Callback<void(std::unique_ptr<HashList> hot_entries)>;
+
   SimpleIndex(const scoped_refptr<base::SingleThreadTaskRunner>& io_thread,
               SimpleIndexDelegate* delegate,
               net::CacheType cache_type,
@@ -111,6 +146,9 @@ class NET_EXPORT_PRIVATE SimpleIndex
   void SetMaxSize(uint64_t max_bytes);
   uint64_t max_size() const { return max_size_; }
 
+  void SetEvictionPolicy(EvictionPolicy eviction_policy);
+  EvictionPolicy eviction_policy() const { return eviction_policy_; }
+
   void Insert(uint64_t entry_hash);
   void Remove(uint64_t entry_hash);
 
@@ -121,8 +159,33 @@ class NET_EXPORT_PRIVATE SimpleIndex
   // iff the entry exist in the index.
   bool UseIfExists(uint64_t entry_hash);
 
+  // Records a request for the entry with the given key hash, for the TinyLFU
+  // eviction policy and kSimpleCacheWarmUp. Called once per open of an indexed
+  // entry; creating an entry records its request in Insert().
+  void RecordRequest(uint64_t entry_hash);
+
   void WriteToDisk(IndexWriteToDiskReason reason);
 
+  // Returns up to |max_count| of the entries requested the most, the most
+  // requested first, and the most recently used first among equally requested
+  // ones. Entries with no request recorded are left out.
+  std::unique_ptr<HashList> GetHotEntries(size_t max_count) const;
+
+  // Returns the entries with a request recorded, in no particular order.
+  std::unique_ptr<HotEntryCandidateList> GetHotEntryCandidates() const;
+
+  // Returns up to |max_count| of |candidates|, ordered as by GetHotEntries().
+  // Only the entries returned are sorted. Can be called on any thread.
+  static std::unique_ptr<HashList> SelectHotEntries(
+      std::unique_ptr<HotEntryCandidateList> candidates,
+      size_t max_count);
+
+  // Writes GetHotEntries(|max_count|) to disk, unless it is empty, for
+  // LoadHotEntries() to return when the cache is next opened. The entries
+  // are selected on the cache thread.
+  void WriteHotEntriesToDisk(size_t max_count);
+  void LoadHotEntries(const HotEntriesCallback& callback);
+
   // Update the size (in bytes) of an entry, in the metadata stored in the
   // index. This should be the total disk-file size including all streams of the
   // entry.
@@ -155,6 +218,9 @@ class NET_EXPORT_PRIVATE SimpleIndex
   // index has been initialized.
   uint64_t GetCacheSize() const;
 
+  // Returns an estimate of the memory used by the index, in bytes.
+  size_t EstimateMemoryUsage() const;
+
   // Returns whether the index has been initialized yet.
   bool initialized() const { return initialized_; }
 
@@ -172,6 +238,10 @@ class NET_EXPORT_PRIVATE SimpleIndex
 
   void PostponeWritingToDisk();
 
+  // Notes that the entry of |entry_hash| changed since the index was last
+  // written, when the index file is written incrementally.
+  void RecordChange(uint64_t entry_hash);
+
   void UpdateEntryIteratorSize(EntrySet::iterator* it,
                                base::StrictNumeric<uint32_t> entry_size);
 
@@ -196,11 +266,21 @@ class NET_EXPORT_PRIVATE SimpleIndex
   uint64_t high_watermark_;
   uint64_t low_watermark_;
   bool eviction_in_progress_;
+  EvictionPolicy eviction_policy_;
+  // Whether requests are recorded for kSimpleCacheWarmUp.
+  const bool record_requests_for_warm_up_;
+  // Only used with EVICTION_POLICY_TINY_LFU or kSimpleCacheWarmUp, and not
+  // persisted: the policy behaves like LRU until requests are recorded after a
+  // restart.
+  SimpleFrequencySketch frequency_sketch_;
   base::TimeTicks eviction_start_time_;
 
   // This stores all the entry_hash of entries that are removed during
   // initialization.
   std::unordered_set<uint64_t> removed_entries_;
+  // The entries inserted, updated or removed since the index was last
+  // written, with SimpleIndexFile::uses_index_table().
+  std::unordered_set<uint64_t> changed_entries_;
   bool initialized_;
   IndexInitMethod init_method_;
 
@@ -4,18 +4,24 @@
 
 #include "net/disk_cache/simple/simple_index_file.h"
 
+#include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
+#include "base/bind.h"
 #include "base/files/file.h"
 #include "base/files/file_util.h"
 #include "base/files/memory_mapped_file.h"
 #include "base/hash.h"
 #include "base/logging.h"
+#include "base/memory/ptr_util.h"
 #include "base/numerics/safe_conversions.h"
+#include "base/numerics/safe_math.h"
 #include "base/pickle.h"
 #include "base/single_thread_task_runner.h"
 #include "base/task_runner_util.h"
+#include "base/threading/simple_thread.h"
 #include "base/threading/thread_restrictions.h"
 #include "net/disk_cache/simple/simple_backend_version.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
@@ -81,6 +87,20 @@ void UmaRecordIndexWriteReasonAtLoad(SimpleIndex::IndexWriteToDiskReason reason,
                    SimpleIndex::INDEX_WRITE_REASON_MAX);
 }
 
+void UmaRecordIndexWriteTime(const base::TimeTicks& start_time,
+                              bool app_on_background,
+                              net::CacheType cache_type) {
+  if (app_on_background) {
+    SIMPLE_CACHE_UMA(TIMES,
+                     "IndexWriteToDiskTime.Background", cache_type,
+                     (base::TimeTicks::Now() - start_time));
+  } else {
+    SIMPLE_CACHE_UMA(TIMES,
+                     "IndexWriteToDiskTime.Foreground", cache_type,
+                     (base::TimeTicks::Now() - start_time));
+  }
+}
+
 void UmaRecordStaleIndexQuality(int missed_entry_count,
                                 int extra_entry_count,
                                 net::CacheType cache_type) {
@@ -166,8 +186,94 @@ void ProcessEntryFile(SimpleIndex::EntrySet* entries,
   }
 }
 
+// With kSimpleCacheParallelIndexRestore, the entry files found while
+// restoring the index are handed out in batches of this many files to a pool
+// of this many threads.
+const size_t kRestoreBatchSize = 1024;
+const int kRestoreThreadCount = 8;
+
+// The entries of a batch of entry files, restored on a thread of the pool.
+class RestoreBatch : public base::DelegateSimpleThread::Delegate {
+ public:
+  RestoreBatch() {}
+
+  void AddFile(const base::FilePath& file_path) {
+    file_paths_.push_back(file_path);
+  }
+  bool IsFull() const { return file_paths_.size() >= kRestoreBatchSize; }
+  const SimpleIndex::EntrySet& entries() const { return entries_; }
+
+  // base::DelegateSimpleThread::Delegate:
+  void Run() override {
+    for (const base::FilePath& file_path : file_paths_)
+      ProcessEntryFile(&entries_, file_path);
+    std::vector<base::FilePath>().swap(file_paths_);
+  }
+
+ private:
+  std::vector<base::FilePath> file_paths_;
+  SimpleIndex::EntrySet entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(RestoreBatch);
+};
+
+// Restores the index from entry files found by a traversal of the cache
+// directory on the calling thread, while a pool of threads gets their file
+// info, which is most of the cost of a restore.
+class ParallelRestore {
+ public:
+  ParallelRestore() : pool_("SimpleCacheRestore", kRestoreThreadCount) {
+    pool_.Start();
+  }
+
+  void AddFile(const base::FilePath& file_path) {
+    if (batches_.empty() || batches_.back()->IsFull()) {
+      if (!batches_.empty())
+        pool_.AddWork(batches_.back().get());
+      batches_.push_back(base::MakeUnique<RestoreBatch>());
+    }
+    batches_.back()->AddFile(file_path);
+  }
+
+  // Waits for all the batches, and merges their entries into |entries|. The
+  // files of one entry may end up in different batches: merging the batches
+  // in traversal order keeps the first last used time seen, and sums the
+  // sizes, exactly as a restore on a single thread would.
+  void Finish(SimpleIndex::EntrySet* entries) {
+    if (!batches_.empty())
+      pool_.AddWork(batches_.back().get());
+    pool_.JoinAll();
+    for (const std::unique_ptr<RestoreBatch>& batch : batches_) {
+      for (const auto& entry : batch->entries()) {
+        SimpleIndex::EntrySet::iterator it = entries->find(entry.first);
+        if (it == entries->end()) {
+          SimpleIndex::InsertInEntrySet(entry.first, entry.second, entries);
+          continue;
+        }
+        base::CheckedNumeric<uint32_t> total_entry_size =
+            it->second.GetEntrySize();
+        total_entry_size += entry.second.GetEntrySize();
+        it->second.SetEntrySize(total_entry_size.ValueOrDie());
+      }
+    }
+    batches_.clear();
+  }
+
+ private:
+  base::DelegateSimpleThreadPool pool_;
+  std::vector<std::unique_ptr<RestoreBatch>> batches_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelRestore);
+};
+
 }  // namespace
 
+const base::Feature kSimpleCacheParallelIndexRestore{
+    "SimpleCacheParallelIndexRestore", base::FEATURE_DISABLED_BY_DEFAULT};
+
+const base::Feature kSimpleCacheIndexTable{"SimpleCacheIndexTable",
+                                           base::FEATURE_DISABLED_BY_DEFAULT};
+
 SimpleIndexLoadResult::SimpleIndexLoadResult()
     : did_load(false),
       index_write_reason(SimpleIndex::INDEX_WRITE_REASON_MAX),
@@ -189,6 +295,10 @@ const char SimpleIndexFile::kIndexFileName[] = "the-real-index";
 const char SimpleIndexFile::kIndexDirectory[] = "index-dir";
 // static
 const char SimpleIndexFile::kTempIndexFileName[] = "temp-index";
+// static
+const char SimpleIndexFile::kHotEntriesFileName[] = "hot-entries";
+// static
+const char SimpleIndexFile::kTempHotEntriesFileName[] = "temp-hot-entries";
 
 SimpleIndexFile::IndexMetadata::IndexMetadata()
     : magic_number_(kSimpleIndexMagicNumber),
@@ -282,15 +392,64 @@ void SimpleIndexFile::SyncWriteToDisk(net::CacheType cache_type,
   if (!base::ReplaceFile(temp_index_filename, index_filename, NULL))
     return;
 
-  if (app_on_background) {
-    SIMPLE_CACHE_UMA(TIMES,
-                     "IndexWriteToDiskTime.Background", cache_type,
-                     (base::TimeTicks::Now() - start_time));
-  } else {
-    SIMPLE_CACHE_UMA(TIMES,
-                     "IndexWriteToDiskTime.Foreground", cache_type,
-                     (base::TimeTicks::Now() - start_time));
+  UmaRecordIndexWriteTime(start_time, app_on_background, cache_type);
+}
+
+// static
+void SimpleIndexFile::SyncWriteTableToDisk(
+    net::CacheType cache_type,
+    const base::FilePath& cache_directory,
+    const base::FilePath& index_directory,
+    std::unique_ptr<SimpleIndex::EntrySet> entries,
+    const base::TimeTicks& start_time,
+    bool app_on_background) {
+  if (!base::DirectoryExists(index_directory) &&
+      !base::CreateDirectory(index_directory)) {
+    LOG(ERROR) << "Could not create a directory to hold the index file";
+    return;
+  }
+
+  // As with the pickle, the table may look stale if entries are still being
+  // created.
+  base::Time cache_dir_mtime;
+  if (!simple_util::GetMTime(cache_directory, &cache_dir_mtime)) {
+    LOG(ERROR) << "Could obtain information about cache age";
+    return;
+  }
+  if (!SimpleIndexTable::SyncWriteTable(index_directory, *entries,
+                                        cache_dir_mtime)) {
+    LOG(ERROR) << "Failed to write the index table";
+    return;
+  }
+  // The pickle the table was converted from, if any, is now out of date.
+  simple_util::SimpleCacheDeleteFile(
+      index_directory.AppendASCII(kIndexFileName));
+
+  UmaRecordIndexWriteTime(start_time, app_on_background, cache_type);
+}
+
+// static
+void SimpleIndexFile::SyncWriteChangesToDisk(
+    net::CacheType cache_type,
+    const base::FilePath& cache_directory,
+    const base::FilePath& index_directory,
+    std::unique_ptr<SimpleIndexTable::ChangeList> changes,
+    const base::TimeTicks& start_time,
+    bool app_on_background) {
+  base::Time cache_dir_mtime;
+  if (!simple_util::GetMTime(cache_directory, &cache_dir_mtime)) {
+    LOG(ERROR) << "Could obtain information about cache age";
+    return;
+  }
+  // On failure the table is left as it was, and is found stale or corrupt
+  // when it is next loaded.
+  if (!SimpleIndexTable::SyncApplyChanges(index_directory, *changes,
+                                          cache_dir_mtime)) {
+    LOG(ERROR) << "Failed to update the index table";
+    return;
   }
+
+  UmaRecordIndexWriteTime(start_time, app_on_background, cache_type);
 }
 
 bool SimpleIndexFile::IndexMetadata::CheckIndexMetadata() {
@@ -318,7 +477,12 @@ SimpleIndexFile::SimpleIndexFile(
       index_file_(cache_directory_.AppendASCII(kIndexDirectory)
                       .AppendASCII(kIndexFileName)),
       temp_index_file_(cache_directory_.AppendASCII(kIndexDirectory)
-                           .AppendASCII(kTempIndexFileName)) {
+                           .AppendASCII(kTempIndexFileName)),
+      hot_entries_file_(cache_directory_.AppendASCII(kIndexDirectory)
+                            .AppendASCII(kHotEntriesFileName)),
+      temp_hot_entries_file_(cache_directory_.AppendASCII(kIndexDirectory)
+                                 .AppendASCII(kTempHotEntriesFileName)),
+      use_index_table_(base::FeatureList::IsEnabled(kSimpleCacheIndexTable)) {
 }
 
 SimpleIndexFile::~SimpleIndexFile() {}
@@ -327,7 +491,7 @@ void SimpleIndexFile::LoadIndexEntries(base::Time cache_last_modified,
                                        const base::Closure& callback,
                                        SimpleIndexLoadResult* out_result) {
   base::Closure task = base::Bind(&SimpleIndexFile::SyncLoadIndexEntries,
-                                  cache_type_,
+                                  cache_type_, use_index_table_,
                                   cache_last_modified, cache_directory_,
                                   index_file_, out_result);
   worker_pool_->PostTaskAndReply(FROM_HERE, task, callback);
@@ -340,6 +504,20 @@ void SimpleIndexFile::WriteToDisk(SimpleIndex::IndexWriteToDiskReason reason,
                                   bool app_on_background,
                                   const base::Closure& callback) {
   UmaRecordIndexWriteReason(reason, cache_type_);
+  if (use_index_table_) {
+    std::unique_ptr<SimpleIndex::EntrySet> entries(
+        new SimpleIndex::EntrySet(entry_set));
+    base::Closure task = base::Bind(
+        &SimpleIndexFile::SyncWriteTableToDisk, cache_type_, cache_directory_,
+        index_file_.DirName(), base::Passed(&entries), start,
+        app_on_background);
+    if (callback.is_null())
+      cache_thread_->PostTask(FROM_HERE, task);
+    else
+      cache_thread_->PostTaskAndReply(FROM_HERE, task, callback);
+    return;
+  }
+
   IndexMetadata index_metadata(reason, entry_set.size(), cache_size);
   std::unique_ptr<base::Pickle> pickle = Serialize(index_metadata, entry_set);
   base::Closure task =
@@ -352,19 +530,136 @@ void SimpleIndexFile::WriteToDisk(SimpleIndex::IndexWriteToDiskReason reason,
     cache_thread_->PostTaskAndReply(FROM_HERE, task, callback);
 }
 
+void SimpleIndexFile::WriteChangesToDisk(
+    SimpleIndex::IndexWriteToDiskReason reason,
+    std::unique_ptr<SimpleIndexTable::ChangeList> changes,
+    const base::TimeTicks& start,
+    bool app_on_background,
+    const base::Closure& callback) {
+  DCHECK(use_index_table_);
+  UmaRecordIndexWriteReason(reason, cache_type_);
+  base::Closure task = base::Bind(
+      &SimpleIndexFile::SyncWriteChangesToDisk, cache_type_, cache_directory_,
+      index_file_.DirName(), base::Passed(&changes), start, app_on_background);
+  if (callback.is_null())
+    cache_thread_->PostTask(FROM_HERE, task);
+  else
+    cache_thread_->PostTaskAndReply(FROM_HERE, task, callback);
+}
+
+void SimpleIndexFile::WriteHotEntries(
+    std::unique_ptr<SimpleIndex::HotEntryCandidateList> candidates,
+    size_t max_count) {
+  cache_thread_->PostTask(
+      FROM_HERE,
+      base::Bind(&SimpleIndexFile::SyncWriteHotEntries, hot_entries_file_,
+                 temp_hot_entries_file_, base::Passed(&candidates),
+                 max_count));
+}
+
+void SimpleIndexFile::LoadHotEntries(
+    const SimpleIndex::HotEntriesCallback& callback) {
+  base::PostTaskAndReplyWithResult(
+      cache_thread_.get(), FROM_HERE,
+      base::Bind(&SimpleIndexFile::SyncLoadHotEntries, hot_entries_file_),
+      callback);
+}
+
+// static
+void SimpleIndexFile::SyncWriteHotEntries(
+    const base::FilePath& hot_entries_filename,
+    const base::FilePath& temp_hot_entries_filename,
+    std::unique_ptr<SimpleIndex::HotEntryCandidateList> candidates,
+    size_t max_count) {
+  std::unique_ptr<SimpleIndex::HashList> hot_entries =
+      SimpleIndex::SelectHotEntries(std::move(candidates), max_count);
+  const base::FilePath index_directory = hot_entries_filename.DirName();
+  if (!base::DirectoryExists(index_directory) &&
+      !base::CreateDirectory(index_directory)) {
+    return;
+  }
+
+  base::Pickle pickle(sizeof(PickleHeader));
+  pickle.WriteUInt64(kSimpleHotEntriesMagicNumber);
+  pickle.WriteUInt64(hot_entries->size());
+  for (uint64_t entry_hash : *hot_entries)
+    pickle.WriteUInt64(entry_hash);
+  pickle.headerT<PickleHeader>()->crc = CalculatePickleCRC(pickle);
+
+  if (!WritePickleFile(&pickle, temp_hot_entries_filename)) {
+    LOG(ERROR) << "Failed to write the temporary hot entries file";
+    return;
+  }
+  base::ReplaceFile(temp_hot_entries_filename, hot_entries_filename, NULL);
+}
+
+// static
+std::unique_ptr<SimpleIndex::HashList> SimpleIndexFile::SyncLoadHotEntries(
+    const base::FilePath& hot_entries_filename) {
+  std::unique_ptr<SimpleIndex::HashList> hot_entries(
+      new SimpleIndex::HashList());
+  std::string data;
+  if (!base::ReadFileToString(hot_entries_filename, &data))
+    return hot_entries;
+
+  base::Pickle pickle(data.data(), data.size());
+  if (!pickle.data() ||
+      pickle.headerT<PickleHeader>()->crc != CalculatePickleCRC(pickle)) {
+    LOG(WARNING) << "Corrupt Simple Cache hot entries file.";
+    return hot_entries;
+  }
+  base::PickleIterator pickle_it(pickle);
+  uint64_t magic_number;
+  uint64_t entry_count;
+  if (!pickle_it.ReadUInt64(&magic_number) ||
+      magic_number != kSimpleHotEntriesMagicNumber ||
+      !pickle_it.ReadUInt64(&entry_count)) {
+    return hot_entries;
+  }
+  while (hot_entries->size() < entry_count) {
+    uint64_t entry_hash;
+    if (!pickle_it.ReadUInt64(&entry_hash)) {
+      hot_entries->clear();
+      break;
+    }
+    hot_entries->push_back(entry_hash);
+  }
+  return hot_entries;
+}
+
 // static
 void SimpleIndexFile::SyncLoadIndexEntries(
     net::CacheType cache_type,
+    bool use_index_table,
     base::Time cache_last_modified,
     const base::FilePath& cache_directory,
     const base::FilePath& index_file_path,
     SimpleIndexLoadResult* out_result) {
   // Load the index and find its age.
   base::Time last_cache_seen_by_index;
-  SyncLoadFromDisk(index_file_path, &last_cache_seen_by_index, out_result);
+  const base::FilePath index_directory = index_file_path.DirName();
+  base::FilePath loaded_file_path = index_file_path;
+  if (use_index_table && SimpleIndexTable::Exists(index_directory)) {
+    loaded_file_path = SimpleIndexTable::GetTablePath(index_directory);
+    out_result->Reset();
+    out_result->did_load = SimpleIndexTable::SyncLoad(
+        index_directory, &out_result->entries, &last_cache_seen_by_index);
+    out_result->entries.reserve(out_result->entries.size() +
+                                kExtraSizeForMerge);
+  } else {
+    SyncLoadFromDisk(index_file_path, &last_cache_seen_by_index, out_result);
+    if (use_index_table) {
+      // Convert the pickle to a table right away.
+      out_result->flush_required = true;
+    } else {
+      // Drop any table left from kSimpleCacheIndexTable, which is not kept
+      // up to date without it.
+      SimpleIndexTable::SyncDelete(index_directory);
+    }
+  }
 
   // Consider the index loaded if it is fresh.
-  const bool index_file_existed = base::PathExists(index_file_path);
+  const bool index_file_existed = base::PathExists(loaded_file_path);
   if (!out_result->did_load) {
     if (index_file_existed)
       UmaRecordIndexFileState(INDEX_STATE_CORRUPT, cache_type);
@@ -377,7 +672,7 @@ void SimpleIndexFile::SyncLoadIndexEntries(
       }
       base::Time latest_dir_mtime;
       simple_util::GetMTime(cache_directory, &latest_dir_mtime);
-      if (LegacyIsIndexFileStale(latest_dir_mtime, index_file_path)) {
+      if (LegacyIsIndexFileStale(latest_dir_mtime, loaded_file_path)) {
         UmaRecordIndexFileState(INDEX_STATE_FRESH_CONCURRENT_UPDATES,
                                 cache_type);
       } else {
@@ -535,11 +830,21 @@ void SimpleIndexFile::SyncRestoreFromDisk(
     SimpleIndexLoadResult* out_result) {
   VLOG(1) << "Simple Cache Index is being restored from disk.";
   simple_util::SimpleCacheDeleteFile(index_file_path);
+  SimpleIndexTable::SyncDelete(index_file_path.DirName());
   out_result->Reset();
   SimpleIndex::EntrySet* entries = &out_result->entries;
 
-  const bool did_succeed = TraverseCacheDirectory(
-      cache_directory, base::Bind(&ProcessEntryFile, entries));
+  bool did_succeed;
+  if (base::FeatureList::IsEnabled(kSimpleCacheParallelIndexRestore)) {
+    ParallelRestore restore;
+    did_succeed = TraverseCacheDirectory(
+        cache_directory,
+        base::Bind(&ParallelRestore::AddFile, base::Unretained(&restore)));
+    restore.Finish(entries);
+  } else {
+    did_succeed = TraverseCacheDirectory(
+        cache_directory, base::Bind(&ProcessEntryFile, entries));
+  }
   if (!did_succeed) {
     LOG(ERROR) << "Could not reconstruct index from disk";
     return;
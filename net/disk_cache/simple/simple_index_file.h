@@ -11,6 +11,7 @@
 #include <string>
 #include <vector>
 
+#include "base/feature_list.h"
 #include "base/files/file_path.h"
 #include "base/gtest_prod_util.h"
 #include "base/logging.h"
@@ -19,6 +20,7 @@
 #include "net/base/cache_type.h"
 #include "net/base/net_export.h"
 #include "net/disk_cache/simple/simple_index.h"
+#include "net/disk_cache/simple/simple_index_table.h"
 
 namespace base {
 class SingleThreadTaskRunner;
@@ -28,6 +30,17 @@ class TaskRunner;
 namespace disk_cache {
 
 const uint64_t kSimpleIndexMagicNumber = UINT64_C(0x656e74657220796f);
+const uint64_t kSimpleHotEntriesMagicNumber = UINT64_C(0x686f742d656e7473);
+
+// Keeps the index in a SimpleIndexTable, which is updated in place with the
+// entries changed since the last write, rather than in a pickle of all the
+// entries.
+NET_EXPORT_PRIVATE extern const base::Feature kSimpleCacheIndexTable;
+
+// Restores a lost index from the entry files on a pool of threads, while the
+// cache directory is traversed, rather than one file at a time. Until the
+// index is ready, the backend serves every lookup by opening the entry files.
+NET_EXPORT_PRIVATE extern const base::Feature kSimpleCacheParallelIndexRestore;
 
 struct NET_EXPORT_PRIVATE SimpleIndexLoadResult {
   SimpleIndexLoadResult();
@@ -47,6 +60,9 @@ struct NET_EXPORT_PRIVATE SimpleIndexLoadResult {
 // the format see |SimpleIndexFile::Serialize()| and
 // |SimpleIndexFile::LoadFromDisk()|.
 //
+// With kSimpleCacheIndexTable, the index is a SimpleIndexTable instead, and
+// an index pickle found at load time is converted to one.
+//
 // The non-static methods must run on the IO thread. All the real
 // work is done in the static methods, which are run on the cache thread
 // or in worker threads. Synchronization between methods is the
@@ -101,6 +117,32 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
                            bool app_on_background,
                            const base::Closure& callback);
 
+  // Writes the entries in |changes|, which are all the changes to the index
+  // since it was loaded or last written. Only supported with
+  // uses_index_table().
+  virtual void WriteChangesToDisk(
+      SimpleIndex::IndexWriteToDiskReason reason,
+      std::unique_ptr<SimpleIndexTable::ChangeList> changes,
+      const base::TimeTicks& start,
+      bool app_on_background,
+      const base::Closure& callback);
+
+  // Writes the hashes of the entries to warm up when the cache is next
+  // opened, in place of those written before: SimpleIndex::SelectHotEntries()
+  // of |candidates| and |max_count|, which runs on the cache thread.
+  virtual void WriteHotEntries(
+      std::unique_ptr<SimpleIndex::HotEntryCandidateList> candidates,
+      size_t max_count);
+
+  // Runs |callback| with the hashes last written by WriteHotEntries(), or with
+  // an empty list if there are none.
+  virtual void LoadHotEntries(const SimpleIndex::HotEntriesCallback& callback);
+
+  bool uses_index_table() const { return use_index_table_; }
+  void SetUseIndexTableForTesting(bool use_index_table) {
+    use_index_table_ = use_index_table;
+  }
+
  private:
   friend class WrappedSimpleIndexFile;
 
@@ -113,6 +155,7 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
 
   // Synchronous (IO performing) implementation of LoadIndexEntries.
   static void SyncLoadIndexEntries(net::CacheType cache_type,
+                                   bool use_index_table,
                                    base::Time cache_last_modified,
                                    const base::FilePath& cache_directory,
                                    const base::FilePath& index_file_path,
@@ -163,6 +206,37 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
                               const base::TimeTicks& start_time,
                               bool app_on_background);
 
+  // Writes a new index table of |entries| to disk.
+  static void SyncWriteTableToDisk(
+      net::CacheType cache_type,
+      const base::FilePath& cache_directory,
+      const base::FilePath& index_directory,
+      std::unique_ptr<SimpleIndex::EntrySet> entries,
+      const base::TimeTicks& start_time,
+      bool app_on_background);
+
+  // Applies |changes| to the index table on disk.
+  static void SyncWriteChangesToDisk(
+      net::CacheType cache_type,
+      const base::FilePath& cache_directory,
+      const base::FilePath& index_directory,
+      std::unique_ptr<SimpleIndexTable::ChangeList> changes,
+      const base::TimeTicks& start_time,
+      bool app_on_background);
+
+  // Selects the hot entries among |candidates|, and writes the hot entries
+  // file atomically.
+  static void SyncWriteHotEntries(
+      const base::FilePath& hot_entries_filename,
+      const base::FilePath& temp_hot_entries_filename,
+      std::unique_ptr<SimpleIndex::HotEntryCandidateList> candidates,
+      size_t max_count);
+
+  // Reads the hot entries file, returning an empty list if it is missing or
+  // corrupt.
+  static std::unique_ptr<SimpleIndex::HashList> SyncLoadHotEntries(
+      const base::FilePath& hot_entries_filename);
+
   // Scan the index directory for entries, returning an EntrySet of all entries
   // found.
   static void SyncRestoreFromDisk(const base::FilePath& cache_directory,
@@ -186,10 +260,15 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
   const base::FilePath cache_directory_;
   const base::FilePath index_file_;
   const base::FilePath temp_index_file_;
+  const base::FilePath hot_entries_file_;
+  const base::FilePath temp_hot_entries_file_;
+  bool use_index_table_;
 
   static const char kIndexDirectory[];
   static const char kIndexFileName[];
   static const char kTempIndexFileName[];
+  static const char kHotEntriesFileName[];
+  static const char kTempHotEntriesFileName[];
 
   DISALLOW_COPY_AND_ASSIGN(SimpleIndexFile);
 };
@@ -5,17 +5,21 @@
 #include "net/disk_cache/simple/simple_index_file.h"
 
 #include <memory>
+#include <utility>
 
+#include "base/bind.h"
 #include "base/files/file.h"
 #include "base/files/file_util.h"
 #include "base/files/scoped_temp_dir.h"
 #include "base/hash.h"
 #include "base/location.h"
 #include "base/logging.h"
+#include "base/memory/ptr_util.h"
 #include "base/pickle.h"
 #include "base/run_loop.h"
 #include "base/single_thread_task_runner.h"
 #include "base/strings/stringprintf.h"
+#include "base/test/scoped_feature_list.h"
 #include "base/threading/thread.h"
 #include "base/threading/thread_task_runner_handle.h"
 #include "base/time/time.h"
@@ -26,6 +30,7 @@
 #include "net/disk_cache/simple/simple_backend_version.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
 #include "net/disk_cache/simple/simple_index.h"
+#include "net/disk_cache/simple/simple_index_table.h"
 #include "net/disk_cache/simple/simple_util.h"
 #include "net/disk_cache/simple/simple_version_upgrade.h"
 #include "net/test/gtest_util.h"
@@ -157,6 +162,26 @@ class SimpleIndexFileTest : public testing::Test {
             b.last_used_time_seconds_since_epoch_ &&
         a.entry_size_ == b.entry_size_;
   }
+
+  std::unique_ptr<SimpleIndex::HashList> LoadHotEntries(
+      SimpleIndexFile* simple_index_file) {
+    std::unique_ptr<SimpleIndex::HashList> hot_entries;
+    base::RunLoop run_loop;
+    simple_index_file->LoadHotEntries(base::Bind(
+        &SimpleIndexFileTest::OnHotEntriesLoaded, &hot_entries,
+        run_loop.QuitClosure()));
+    run_loop.Run();
+    return hot_entries;
+  }
+
+ private:
+  static void OnHotEntriesLoaded(
+      std::unique_ptr<SimpleIndex::HashList>* out_hot_entries,
+      const base::Closure& quit_closure,
+      std::unique_ptr<SimpleIndex::HashList> hot_entries) {
+    *out_hot_entries = std::move(hot_entries);
+    quit_closure.Run();
+  }
 };
 
 TEST_F(SimpleIndexFileTest, Serialize) {
@@ -300,6 +325,35 @@ TEST_F(SimpleIndexFileTest, LoadCorruptIndex) {
   EXPECT_TRUE(load_index_result.flush_required);
 }
 
+TEST_F(SimpleIndexFileTest, WriteThenLoadHotEntries) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+  WrappedSimpleIndexFile simple_index_file(cache_dir.path());
+
+  // None were written yet.
+  EXPECT_TRUE(LoadHotEntries(&simple_index_file)->empty());
+
+  // The hottest of the candidates are written, the hottest first.
+  const base::Time now = base::Time::Now();
+  const SimpleIndex::HotEntryCandidateList kCandidates = {
+      {11, 2, now}, {44, 1, now}, {22, 1, now + base::TimeDelta::FromDays(1)},
+      {33, 3, now}};
+  const SimpleIndex::HashList kHotEntries = {33, 11, 22};
+  simple_index_file.WriteHotEntries(
+      base::MakeUnique<SimpleIndex::HotEntryCandidateList>(kCandidates), 3);
+  EXPECT_EQ(kHotEntries, *LoadHotEntries(&simple_index_file));
+
+  // A corrupt file is ignored.
+  const base::FilePath hot_entries_path =
+      simple_index_file.GetIndexFilePath().DirName().AppendASCII(
+          "hot-entries");
+  const std::string kDummyData = "nothing to be seen here";
+  EXPECT_EQ(static_cast<int>(kDummyData.size()),
+            base::WriteFile(hot_entries_path, kDummyData.data(),
+                            kDummyData.size()));
+  EXPECT_TRUE(LoadHotEntries(&simple_index_file)->empty());
+}
+
 // Tests that after an upgrade the backend has the index file put in place.
 TEST_F(SimpleIndexFileTest, SimpleCacheUpgrade) {
   base::ScopedTempDir cache_dir;
@@ -401,6 +455,119 @@ TEST_F(SimpleIndexFileTest, OverwritesStaleTempFile) {
   EXPECT_TRUE(base::PathExists(simple_index_file.GetIndexFilePath()));
 }
 
+TEST_F(SimpleIndexFileTest, WriteChangesThenLoadIndexTable) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+  const base::FilePath index_directory =
+      cache_dir.path().AppendASCII("index-dir");
+
+  SimpleIndex::EntrySet entries;
+  SimpleIndex::InsertInEntrySet(11, EntryMetadata(Time(), 11u), &entries);
+  SimpleIndex::InsertInEntrySet(22, EntryMetadata(Time(), 22u), &entries);
+  net::TestClosure closure;
+  {
+    WrappedSimpleIndexFile simple_index_file(cache_dir.path());
+    simple_index_file.SetUseIndexTableForTesting(true);
+    simple_index_file.WriteToDisk(SimpleIndex::INDEX_WRITE_REASON_SHUTDOWN,
+                                  entries, 33U, base::TimeTicks(), false,
+                                  closure.closure());
+    closure.WaitForResult();
+    EXPECT_TRUE(SimpleIndexTable::Exists(index_directory));
+    EXPECT_FALSE(base::PathExists(simple_index_file.GetIndexFilePath()));
+
+    std::unique_ptr<SimpleIndexTable::ChangeList> changes(
+        new SimpleIndexTable::ChangeList());
+    changes->push_back(SimpleIndexTable::Change::Removal(11));
+    changes->push_back(
+        SimpleIndexTable::Change(33, EntryMetadata(Time(), 33u)));
+    simple_index_file.WriteChangesToDisk(
+        SimpleIndex::INDEX_WRITE_REASON_IDLE, std::move(changes),
+        base::TimeTicks(), false, closure.closure());
+    closure.WaitForResult();
+  }
+
+  WrappedSimpleIndexFile simple_index_file(cache_dir.path());
+  simple_index_file.SetUseIndexTableForTesting(true);
+  base::Time fake_cache_mtime;
+  ASSERT_TRUE(simple_util::GetMTime(cache_dir.path(), &fake_cache_mtime));
+  SimpleIndexLoadResult load_index_result;
+  simple_index_file.LoadIndexEntries(fake_cache_mtime, closure.closure(),
+                                     &load_index_result);
+  closure.WaitForResult();
+
+  EXPECT_TRUE(load_index_result.did_load);
+  EXPECT_FALSE(load_index_result.flush_required);
+  EXPECT_EQ(SimpleIndex::INITIALIZE_METHOD_LOADED,
+            load_index_result.init_method);
+  EXPECT_EQ(2U, load_index_result.entries.size());
+  EXPECT_EQ(0U, load_index_result.entries.count(11));
+  EXPECT_EQ(22U, load_index_result.entries[22].GetEntrySize());
+  EXPECT_EQ(33U, load_index_result.entries[33].GetEntrySize());
+}
+
+// Tests that an index pickle is loaded, and then converted to a table, when
+// switching to kSimpleCacheIndexTable.
+TEST_F(SimpleIndexFileTest, LoadIndexPickleAsTable) {
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+
+  SimpleIndex::EntrySet entries;
+  SimpleIndex::InsertInEntrySet(11, EntryMetadata(Time(), 11u), &entries);
+  net::TestClosure closure;
+  WrappedSimpleIndexFile simple_index_file(cache_dir.path());
+  simple_index_file.SetUseIndexTableForTesting(false);
+  simple_index_file.WriteToDisk(SimpleIndex::INDEX_WRITE_REASON_SHUTDOWN,
+                                entries, 11U, base::TimeTicks(), false,
+                                closure.closure());
+  closure.WaitForResult();
+
+  simple_index_file.SetUseIndexTableForTesting(true);
+  base::Time fake_cache_mtime;
+  ASSERT_TRUE(simple_util::GetMTime(cache_dir.path(), &fake_cache_mtime));
+  SimpleIndexLoadResult load_index_result;
+  simple_index_file.LoadIndexEntries(fake_cache_mtime, closure.closure(),
+                                     &load_index_result);
+  closure.WaitForResult();
+
+  EXPECT_TRUE(load_index_result.did_load);
+  EXPECT_TRUE(load_index_result.flush_required);
+  EXPECT_EQ(1U, load_index_result.entries.count(11));
+}
+
+TEST_F(SimpleIndexFileTest, RestoreInParallel) {
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndEnableFeature(kSimpleCacheParallelIndexRestore);
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+
+  // Enough entries for several batches, so that the two files of some
+  // entries are restored on different threads.
+  const uint64_t kEntryCount = 5000;
+  for (uint64_t hash = 1; hash <= kEntryCount; ++hash) {
+    for (int file_index = 0; file_index < 2; ++file_index) {
+      const base::FilePath file_path = cache_dir.path().AppendASCII(
+          simple_util::GetFilenameFromEntryHashAndFileIndex(hash, file_index));
+      ASSERT_EQ(file_index + 1,
+                base::WriteFile(file_path, "xx", file_index + 1));
+    }
+  }
+
+  WrappedSimpleIndexFile simple_index_file(cache_dir.path());
+  base::Time fake_cache_mtime;
+  ASSERT_TRUE(simple_util::GetMTime(cache_dir.path(), &fake_cache_mtime));
+  SimpleIndexLoadResult load_index_result;
+  net::TestClosure closure;
+  simple_index_file.LoadIndexEntries(fake_cache_mtime, closure.closure(),
+                                     &load_index_result);
+  closure.WaitForResult();
+
+  EXPECT_TRUE(load_index_result.did_load);
+  EXPECT_TRUE(load_index_result.flush_required);
+  ASSERT_EQ(kEntryCount, load_index_result.entries.size());
+  for (const auto& entry : load_index_result.entries)
+    EXPECT_EQ(3u, entry.second.GetEntrySize()) << entry.first;
+}
+
 #endif  // defined(OS_POSIX)
 
 }  // namespace disk_cache
@@ -0,0 +1,543 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_index_table.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include <memory>
+#include <utility>
+
+#include "base/files/file.h"
+#include "base/files/file_util.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/logging.h"
+#include "net/disk_cache/simple/simple_util.h"
+#include "third_party/zlib/zlib.h"
+
+using base::File;
+
+namespace disk_cache {
+
+namespace {
+
+const uint32_t kTableVersion = 1;
+
+// Tables have a power of two number of slots, at least this many, and are
+// rewritten when more than three quarters of them are used so that probe
+// sequences stay short. Rewritten tables are at most half full. The largest
+// tables take about 1.5 GB, and hold 32 million entries.
+const uint32_t kMinCapacity = 1024;
+const uint32_t kMaxCapacity = 1 << 26;
+
+enum SlotState : uint32_t {
+  SLOT_EMPTY = 0,
+  SLOT_IN_USE = 1,
+  // Removed slots are skipped by lookups but end their probe sequences only
+  // once reused, until the table is rewritten.
+  SLOT_REMOVED = 2,
+};
+
+struct TableHeader {
+  uint64_t magic_number;
+  uint32_t version;
+  uint32_t capacity;
+  int64_t cache_last_modified;
+  // Slots that are not empty.
+  uint32_t used_slot_count;
+  uint32_t crc;
+};
+static_assert(sizeof(TableHeader) == 32, "the table format changed");
+
+// Table slots, and journal records.
+struct TableSlot {
+  uint64_t entry_hash;
+  uint32_t last_used_time_seconds_since_epoch;
+  uint32_t entry_size;
+  uint32_t state;
+  uint32_t crc;
+};
+static_assert(sizeof(TableSlot) == 24, "the table format changed");
+
+struct JournalHeader {
+  uint64_t magic_number;
+  // What the table is to record once the changes are applied.
+  int64_t cache_last_modified;
+  uint32_t change_count;
+  // Of the records following the header.
+  uint32_t crc;
+};
+static_assert(sizeof(JournalHeader) == 24, "the journal format changed");
+
+typedef std::vector<TableSlot> SlotList;
+
+uint32_t CalculateCRC(const void* data, size_t size) {
+  return crc32(crc32(0, Z_NULL, 0), static_cast<const Bytef*>(data), size);
+}
+
+uint32_t CalculateHeaderCRC(const TableHeader& header) {
+  return CalculateCRC(&header, offsetof(TableHeader, crc));
+}
+
+uint32_t CalculateSlotCRC(const TableSlot& slot) {
+  return CalculateCRC(&slot, offsetof(TableSlot, crc));
+}
+
+int GetTableSize(uint32_t capacity) {
+  return sizeof(TableHeader) + capacity * sizeof(TableSlot);
+}
+
+uint32_t GetCapacityFor(size_t entry_count) {
+  uint32_t capacity = kMinCapacity;
+  while (capacity < kMaxCapacity && capacity / 2 < entry_count)
+    capacity *= 2;
+  return capacity;
+}
+
+bool HasRoomFor(const TableHeader& header, size_t new_slot_count) {
+  return header.used_slot_count + new_slot_count <= header.capacity / 4 * 3;
+}
+
+TableSlot MakeSlot(uint64_t entry_hash,
+                   const EntryMetadata& metadata,
+                   SlotState state) {
+  TableSlot slot;
+  memset(&slot, 0, sizeof(slot));
+  slot.entry_hash = entry_hash;
+  const base::Time last_used_time = metadata.GetLastUsedTime();
+  // EntryMetadata keeps whole seconds, and null times as 0.
+  if (!last_used_time.is_null()) {
+    slot.last_used_time_seconds_since_epoch = static_cast<uint32_t>(
+        (last_used_time - base::Time::UnixEpoch()).InSeconds());
+  }
+  slot.entry_size = metadata.GetEntrySize();
+  slot.state = state;
+  slot.crc = CalculateSlotCRC(slot);
+  return slot;
+}
+
+EntryMetadata GetSlotMetadata(const TableSlot& slot) {
+  base::Time last_used_time;
+  if (slot.last_used_time_seconds_since_epoch) {
+    last_used_time =
+        base::Time::UnixEpoch() +
+        base::TimeDelta::FromSeconds(slot.last_used_time_seconds_since_epoch);
+  }
+  return EntryMetadata(last_used_time, slot.entry_size);
+}
+
+// Returns the slot holding |entry_hash| in |slots|, or else the slot it
+// should be inserted in. Leaves |*found| telling which.
+uint32_t FindSlot(const TableSlot* slots,
+                  uint32_t capacity,
+                  uint64_t entry_hash,
+                  bool* found) {
+  const uint32_t mask = capacity - 1;
+  uint32_t first_removed = capacity;
+  uint32_t index = static_cast<uint32_t>(entry_hash) & mask;
+  for (uint32_t probes = 0; probes < capacity; ++probes) {
+    const TableSlot& slot = slots[index];
+    if (slot.state == SLOT_EMPTY)
+      break;
+    if (slot.state == SLOT_IN_USE && slot.entry_hash == entry_hash) {
+      *found = true;
+      return index;
+    }
+    if (slot.state == SLOT_REMOVED && first_removed == capacity)
+      first_removed = index;
+    index = (index + 1) & mask;
+  }
+  *found = false;
+  // Tables are never full, so the probes stopped at an empty slot.
+  return first_removed != capacity ? first_removed : index;
+}
+
+SlotList GetSlotsForChanges(const SimpleIndexTable::ChangeList& changes) {
+  SlotList slots;
+  slots.reserve(changes.size());
+  for (const SimpleIndexTable::Change& change : changes) {
+    slots.push_back(MakeSlot(change.entry_hash, change.metadata,
+                             change.removed ? SLOT_REMOVED : SLOT_IN_USE));
+  }
+  return slots;
+}
+
+// A table file, mapped to be read and written to in place.
+class MappedTable {
+ public:
+  MappedTable() : slots_(nullptr) {}
+
+  bool Open(const base::FilePath& table_path) {
+    file_.Initialize(table_path, File::FLAG_OPEN | File::FLAG_READ |
+                                     File::FLAG_WRITE |
+                                     File::FLAG_SHARE_DELETE);
+    if (!file_.IsValid() || !map_.Initialize(file_.Duplicate()))
+      return false;
+    if (map_.length() < sizeof(TableHeader))
+      return false;
+    memcpy(&header_, map_.data(), sizeof(header_));
+    if (header_.magic_number != kSimpleIndexTableMagicNumber ||
+        header_.version != kTableVersion ||
+        header_.crc != CalculateHeaderCRC(header_) ||
+        header_.capacity < kMinCapacity || header_.capacity > kMaxCapacity ||
+        (header_.capacity & (header_.capacity - 1)) != 0 ||
+        map_.length() != static_cast<size_t>(GetTableSize(header_.capacity))) {
+      return false;
+    }
+    slots_ = reinterpret_cast<const TableSlot*>(map_.data() +
+                                                sizeof(TableHeader));
+    return true;
+  }
+
+  // Reads the entries in use, and repairs the count of used slots, which
+  // might lag behind the slots after a crash.
+  bool ReadEntries(SimpleIndex::EntrySet* entries) {
+    entries->reserve(header_.used_slot_count);
+    uint32_t used_slot_count = 0;
+    for (uint32_t i = 0; i < header_.capacity; ++i) {
+      const TableSlot& slot = slots_[i];
+      if (slot.state == SLOT_EMPTY)
+        continue;
+      if (slot.crc != CalculateSlotCRC(slot) || slot.state > SLOT_REMOVED)
+        return false;
+      ++used_slot_count;
+      if (slot.state == SLOT_IN_USE) {
+        SimpleIndex::InsertInEntrySet(slot.entry_hash, GetSlotMetadata(slot),
+                                      entries);
+      }
+    }
+    if (used_slot_count == header_.used_slot_count)
+      return true;
+    header_.used_slot_count = used_slot_count;
+    return WriteHeader();
+  }
+
+  // Writes |slots|, which are either in use or removed, over the slots of
+  // their entries. Slots are written rather than stored through the mapping
+  // so that Flush() covers them on every platform; the mapping still sees
+  // them for the next lookups.
+  bool WriteSlots(const SlotList& slots) {
+    for (const TableSlot& slot : slots) {
+      bool found;
+      const uint32_t index =
+          FindSlot(slots_, header_.capacity, slot.entry_hash, &found);
+      if (!found && slot.state == SLOT_REMOVED)
+        continue;
+      if (!found && slots_[index].state == SLOT_EMPTY)
+        ++header_.used_slot_count;
+      const int64_t offset = sizeof(TableHeader) +
+                             static_cast<int64_t>(index) * sizeof(TableSlot);
+      if (file_.Write(offset, reinterpret_cast<const char*>(&slot),
+                      sizeof(slot)) != sizeof(slot)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Recounts the slots that are not empty. An update interrupted after some of
+  // its slots were written leaves a stale count in the header, which writing
+  // its slots again from the journal does not repair.
+  void RecountUsedSlots() {
+    uint32_t used_slot_count = 0;
+    for (uint32_t i = 0; i < header_.capacity; ++i) {
+      if (slots_[i].state != SLOT_EMPTY)
+        ++used_slot_count;
+    }
+    header_.used_slot_count = used_slot_count;
+  }
+
+  // Writes the header, which comes last so that a table whose update is
+  // interrupted still looks stale, then flushes the table.
+  bool Finish(base::Time cache_last_modified) {
+    header_.cache_last_modified = cache_last_modified.ToInternalValue();
+    return WriteHeader() && file_.Flush();
+  }
+
+  const TableHeader& header() const { return header_; }
+
+ private:
+  bool WriteHeader() {
+    header_.crc = CalculateHeaderCRC(header_);
+    return file_.Write(0, reinterpret_cast<const char*>(&header_),
+                       sizeof(header_)) == sizeof(header_);
+  }
+
+  File file_;
+  base::MemoryMappedFile map_;
+  TableHeader header_;
+  const TableSlot* slots_;
+
+  DISALLOW_COPY_AND_ASSIGN(MappedTable);
+};
+
+bool WriteJournal(const base::FilePath& journal_path,
+                  const SlotList& slots,
+                  base::Time cache_last_modified) {
+  File file(journal_path, File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE |
+                              File::FLAG_SHARE_DELETE);
+  if (!file.IsValid())
+    return false;
+
+  const int slots_size = static_cast<int>(slots.size() * sizeof(TableSlot));
+  JournalHeader header;
+  header.magic_number = kSimpleIndexJournalMagicNumber;
+  header.cache_last_modified = cache_last_modified.ToInternalValue();
+  header.change_count = static_cast<uint32_t>(slots.size());
+  header.crc = CalculateCRC(slots.data(), slots_size);
+
+  std::string contents(reinterpret_cast<const char*>(&header), sizeof(header));
+  contents.append(reinterpret_cast<const char*>(slots.data()), slots_size);
+  return file.Write(0, contents.data(), contents.size()) ==
+             static_cast<int>(contents.size()) &&
+         file.Flush();
+}
+
+// Reads the journal at |journal_path|. Returns false if there is none, or
+// if its write was interrupted.
+bool ReadJournal(const base::FilePath& journal_path,
+                 SlotList* slots,
+                 base::Time* cache_last_modified) {
+  std::string contents;
+  if (!base::ReadFileToString(journal_path, &contents) ||
+      contents.size() < sizeof(JournalHeader)) {
+    return false;
+  }
+  JournalHeader header;
+  memcpy(&header, contents.data(), sizeof(header));
+  const size_t slots_size = contents.size() - sizeof(header);
+  if (header.magic_number != kSimpleIndexJournalMagicNumber ||
+      slots_size != header.change_count * sizeof(TableSlot)) {
+    return false;
+  }
+  slots->resize(header.change_count);
+  memcpy(slots->data(), contents.data() + sizeof(header), slots_size);
+  if (header.crc != CalculateCRC(slots->data(), slots_size))
+    return false;
+  for (const TableSlot& slot : *slots) {
+    if (slot.crc != CalculateSlotCRC(slot) ||
+        (slot.state != SLOT_IN_USE && slot.state != SLOT_REMOVED)) {
+      return false;
+    }
+  }
+  *cache_last_modified =
+      base::Time::FromInternalValue(header.cache_last_modified);
+  return true;
+}
+
+// Applies the journal in |index_directory| to the table, if both exist, and
+// deletes the journal.
+void ReplayJournal(const base::FilePath& index_directory) {
+  const base::FilePath journal_path =
+      SimpleIndexTable::GetJournalPath(index_directory);
+  if (!base::PathExists(journal_path))
+    return;
+
+  SlotList slots;
+  base::Time cache_last_modified;
+  if (ReadJournal(journal_path, &slots, &cache_last_modified)) {
+    // The journal is only written when the table has room for it.
+    const base::FilePath table_path =
+        SimpleIndexTable::GetTablePath(index_directory);
+    MappedTable table;
+    bool replayed = table.Open(table_path) && table.WriteSlots(slots);
+    if (replayed) {
+      table.RecountUsedSlots();
+      replayed = table.Finish(cache_last_modified);
+    }
+    if (!replayed) {
+      LOG(WARNING) << "Could not replay the Simple Cache index journal.";
+      simple_util::SimpleCacheDeleteFile(table_path);
+    }
+  }
+  simple_util::SimpleCacheDeleteFile(journal_path);
+}
+
+}  // namespace
+
+SimpleIndexTable::Change::Change() : entry_hash(0), removed(false) {}
+
+SimpleIndexTable::Change::Change(uint64_t entry_hash,
+                                 const EntryMetadata& metadata)
+    : entry_hash(entry_hash), removed(false), metadata(metadata) {}
+
+// static
+SimpleIndexTable::Change SimpleIndexTable::Change::Removal(
+    uint64_t entry_hash) {
+  Change change;
+  change.entry_hash = entry_hash;
+  change.removed = true;
+  return change;
+}
+
+// static
+bool SimpleIndexTable::SyncWriteTable(const base::FilePath& index_directory,
+                                      const SimpleIndex::EntrySet& entries,
+                                      base::Time cache_last_modified) {
+  const uint32_t capacity = GetCapacityFor(entries.size());
+  if (entries.size() > capacity / 2)
+    return false;
+
+  std::unique_ptr<TableSlot[]> slots(new TableSlot[capacity]());
+  for (const auto& entry : entries) {
+    bool found;
+    const uint32_t index = FindSlot(slots.get(), capacity, entry.first, &found);
+    slots[index] = MakeSlot(entry.first, entry.second, SLOT_IN_USE);
+  }
+  TableHeader header;
+  header.magic_number = kSimpleIndexTableMagicNumber;
+  header.version = kTableVersion;
+  header.capacity = capacity;
+  header.cache_last_modified = cache_last_modified.ToInternalValue();
+  header.used_slot_count = static_cast<uint32_t>(entries.size());
+  header.crc = CalculateHeaderCRC(header);
+
+  const base::FilePath temp_table_path =
+      index_directory.AppendASCII(kTempTableFileName);
+  {
+    File file(temp_table_path, File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE |
+                                   File::FLAG_SHARE_DELETE);
+    if (!file.IsValid())
+      return false;
+    const int slots_size = GetTableSize(capacity) - sizeof(header);
+    if (file.Write(0, reinterpret_cast<const char*>(&header),
+                   sizeof(header)) != sizeof(header) ||
+        file.Write(sizeof(header), reinterpret_cast<const char*>(slots.get()),
+                   slots_size) != slots_size ||
+        !file.Flush()) {
+      file.Close();
+      simple_util::SimpleCacheDeleteFile(temp_table_path);
+      return false;
+    }
+  }
+
+  // |entries| are newer than any journal left behind, which must not be
+  // replayed over them.
+  simple_util::SimpleCacheDeleteFile(GetJournalPath(index_directory));
+  return base::ReplaceFile(temp_table_path, GetTablePath(index_directory),
+                           nullptr);
+}
+
+// static
+bool SimpleIndexTable::SyncApplyChanges(const base::FilePath& index_directory,
+                                        const ChangeList& changes,
+                                        base::Time cache_last_modified) {
+  // A journal left by a failed update comes before |changes|.
+  ReplayJournal(index_directory);
+
+  SimpleIndex::EntrySet entries;
+  {
+    MappedTable table;
+    if (!table.Open(GetTablePath(index_directory))) {
+      LOG(WARNING) << "Could not open the Simple Cache index table.";
+      return false;
+    }
+
+    const SlotList slots = GetSlotsForChanges(changes);
+    if (HasRoomFor(table.header(), slots.size())) {
+      const base::FilePath journal_path = GetJournalPath(index_directory);
+      if (!WriteJournal(journal_path, slots, cache_last_modified)) {
+        simple_util::SimpleCacheDeleteFile(journal_path);
+        return false;
+      }
+      if (!table.WriteSlots(slots) || !table.Finish(cache_last_modified))
+        return false;
+      simple_util::SimpleCacheDeleteFile(journal_path);
+      return true;
+    }
+
+    // Out of free slots: rewrite the table, once it is closed.
+    if (!table.ReadEntries(&entries))
+      return false;
+  }
+  for (const Change& change : changes) {
+    if (change.removed)
+      entries.erase(change.entry_hash);
+    else
+      entries[change.entry_hash] = change.metadata;
+  }
+  return SyncWriteTable(index_directory, entries, cache_last_modified);
+}
+
+// static
+bool SimpleIndexTable::SyncLoad(const base::FilePath& index_directory,
+                                SimpleIndex::EntrySet* out_entries,
+                                base::Time* out_cache_last_modified) {
+  ReplayJournal(index_directory);
+
+  MappedTable table;
+  SimpleIndex::EntrySet entries;
+  if (!table.Open(GetTablePath(index_directory)) ||
+      !table.ReadEntries(&entries)) {
+    LOG(WARNING) << "Corrupt Simple Cache index table.";
+    SyncDelete(index_directory);
+    return false;
+  }
+  out_entries->swap(entries);
+  *out_cache_last_modified =
+      base::Time::FromInternalValue(table.header().cache_last_modified);
+  return true;
+}
+
+// static
+void SimpleIndexTable::SyncDelete(const base::FilePath& index_directory) {
+  simple_util::SimpleCacheDeleteFile(GetJournalPath(index_directory));
+  simple_util::SimpleCacheDeleteFile(GetTablePath(index_directory));
+}
+
+// static
+bool SimpleIndexTable::Exists(const base::FilePath& index_directory) {
+  return base::PathExists(GetTablePath(index_directory));
+}
+
+// static
+bool SimpleIndexTable::SyncWriteJournalForTesting(
+    const base::FilePath& index_directory,
+    const ChangeList& changes,
+    base::Time cache_last_modified,
+    size_t applied_change_count) {
+  const SlotList slots = GetSlotsForChanges(changes);
+  if (!WriteJournal(GetJournalPath(index_directory), slots,
+                    cache_last_modified)) {
+    return false;
+  }
+  if (!applied_change_count)
+    return true;
+  // The header is left as it was, as the update did not get to write it.
+  MappedTable table;
+  return table.Open(GetTablePath(index_directory)) &&
+         table.WriteSlots(
+             SlotList(slots.begin(), slots.begin() + applied_change_count));
+}
+
+// static
+int SimpleIndexTable::GetUsedSlotCountForTesting(
+    const base::FilePath& index_directory) {
+  MappedTable table;
+  if (!table.Open(GetTablePath(index_directory)))
+    return -1;
+  return static_cast<int>(table.header().used_slot_count);
+}
+
+// static
+base::FilePath SimpleIndexTable::GetTablePath(
+    const base::FilePath& index_directory) {
+  return index_directory.AppendASCII(kTableFileName);
+}
+
+// static
+base::FilePath SimpleIndexTable::GetJournalPath(
+    const base::FilePath& index_directory) {
+  return index_directory.AppendASCII(kJournalFileName);
+}
+
+// static
+const char SimpleIndexTable::kTableFileName[] = "index-table";
+// static
+const char SimpleIndexTable::kTempTableFileName[] = "temp-index-table";
+// static
+const char SimpleIndexTable::kJournalFileName[] = "index-journal";
+
+}  // namespace disk_cache
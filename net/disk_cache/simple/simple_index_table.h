@@ -0,0 +1,107 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_TABLE_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_TABLE_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/simple/simple_index.h"
+
+namespace disk_cache {
+
+const uint64_t kSimpleIndexTableMagicNumber = UINT64_C(0x7461626c65696478);
+const uint64_t kSimpleIndexJournalMagicNumber = UINT64_C(0x6a726e6c65696478);
+
+// An index file format that is updated in place, so that writing the index
+// costs in proportion to the entries changed since the last write rather
+// than to the size of the cache.
+//
+// The table file is a header followed by an open addressed hash table of
+// fixed-size slots, one per entry, each with its own CRC. It is memory
+// mapped to be read, and its slots are written in place.
+//
+// Changes first go to a journal file, which is flushed before the table is
+// touched and only cleared once the table is flushed in turn. A write that
+// is interrupted is thus either lost as a whole, leaving the table as it
+// was, or replayed from the journal on the next load. Replaying is
+// idempotent, since changes hold the complete metadata of their entries.
+//
+// All methods perform blocking IO, and must run on the cache thread or in a
+// worker pool. Synchronization is the responsibility of the caller.
+class NET_EXPORT_PRIVATE SimpleIndexTable {
+ public:
+  // A change to the entry of |entry_hash|: either it was removed, or its
+  // metadata is now |metadata|.
+  struct NET_EXPORT_PRIVATE Change {
+    Change();
+    Change(uint64_t entry_hash, const EntryMetadata& metadata);
+
+    static Change Removal(uint64_t entry_hash);
+
+    uint64_t entry_hash;
+    bool removed;
+    EntryMetadata metadata;
+  };
+  typedef std::vector<Change> ChangeList;
+
+  // Writes a new table of |entries| in |index_directory|, replacing any
+  // table and journal there. |cache_last_modified| is the last modification
+  // time of the cache directory seen by the table, to tell whether it is
+  // stale when loaded.
+  static bool SyncWriteTable(const base::FilePath& index_directory,
+                             const SimpleIndex::EntrySet& entries,
+                             base::Time cache_last_modified);
+
+  // Applies |changes|, in order, to the table in |index_directory|. The
+  // table is rewritten when it runs out of free slots.
+  static bool SyncApplyChanges(const base::FilePath& index_directory,
+                               const ChangeList& changes,
+                               base::Time cache_last_modified);
+
+  // Replays the journal in |index_directory|, if any, then reads the
+  // entries of the table. Returns false, after deleting the table, if it is
+  // missing or corrupt.
+  static bool SyncLoad(const base::FilePath& index_directory,
+                       SimpleIndex::EntrySet* out_entries,
+                       base::Time* out_cache_last_modified);
+
+  // Deletes the table and the journal in |index_directory|, if any.
+  static void SyncDelete(const base::FilePath& index_directory);
+
+  // Returns whether there is a table in |index_directory|.
+  static bool Exists(const base::FilePath& index_directory);
+
+  // Writes the journal for |changes|, and applies only the first
+  // |applied_change_count| of them to the table, as an update interrupted by
+  // a crash would.
+  static bool SyncWriteJournalForTesting(const base::FilePath& index_directory,
+                                         const ChangeList& changes,
+                                         base::Time cache_last_modified,
+                                         size_t applied_change_count);
+
+  // Returns the count of used slots recorded by the table, or -1 if there is
+  // no valid table.
+  static int GetUsedSlotCountForTesting(const base::FilePath& index_directory);
+
+  static base::FilePath GetTablePath(const base::FilePath& index_directory);
+  static base::FilePath GetJournalPath(const base::FilePath& index_directory);
+
+ private:
+  static const char kTableFileName[];
+  static const char kTempTableFileName[];
+  static const char kJournalFileName[];
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(SimpleIndexTable);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_TABLE_H_
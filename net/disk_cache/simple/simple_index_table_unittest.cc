@@ -0,0 +1,239 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_index_table.h"
+
+#include <stdint.h>
+
+#include <string>
+
+#include "base/files/file.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/time/time.h"
+#include "net/disk_cache/simple/simple_index.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+const base::Time kLastUsedTime =
+    base::Time::UnixEpoch() + base::TimeDelta::FromDays(20);
+
+EntryMetadata MakeMetadata(uint32_t entry_size) {
+  return EntryMetadata(kLastUsedTime, entry_size);
+}
+
+}  // namespace
+
+class SimpleIndexTableTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    cache_last_modified_ = base::Time::Now();
+  }
+
+  const base::FilePath& index_directory() const { return temp_dir_.path(); }
+
+  void ExpectEntries(const SimpleIndex::EntrySet& expected) {
+    SimpleIndex::EntrySet entries;
+    base::Time cache_last_modified;
+    ASSERT_TRUE(SimpleIndexTable::SyncLoad(index_directory(), &entries,
+                                           &cache_last_modified));
+    EXPECT_EQ(cache_last_modified_, cache_last_modified);
+    ASSERT_EQ(expected.size(), entries.size());
+    for (const auto& entry : expected) {
+      SimpleIndex::EntrySet::const_iterator it = entries.find(entry.first);
+      ASSERT_TRUE(it != entries.end());
+      EXPECT_EQ(entry.second.GetLastUsedTime(), it->second.GetLastUsedTime());
+      EXPECT_EQ(entry.second.GetEntrySize(), it->second.GetEntrySize());
+    }
+  }
+
+  base::ScopedTempDir temp_dir_;
+  base::Time cache_last_modified_;
+};
+
+TEST_F(SimpleIndexTableTest, WriteThenLoad) {
+  SimpleIndex::EntrySet entries;
+  entries[11] = MakeMetadata(110);
+  entries[22] = MakeMetadata(220);
+  entries[33] = EntryMetadata(base::Time(), 330u);
+  ASSERT_TRUE(SimpleIndexTable::SyncWriteTable(index_directory(), entries,
+                                               cache_last_modified_));
+  EXPECT_TRUE(SimpleIndexTable::Exists(index_directory()));
+  ExpectEntries(entries);
+}
+
+TEST_F(SimpleIndexTableTest, ApplyChanges) {
+  SimpleIndex::EntrySet entries;
+  entries[11] = MakeMetadata(110);
+  entries[22] = MakeMetadata(220);
+  ASSERT_TRUE(SimpleIndexTable::SyncWriteTable(index_directory(), entries,
+                                               base::Time()));
+  const base::FilePath table_path =
+      SimpleIndexTable::GetTablePath(index_directory());
+  int64_t table_size_before = 0;
+  ASSERT_TRUE(base::GetFileSize(table_path, &table_size_before));
+
+  SimpleIndexTable::ChangeList changes;
+  changes.push_back(SimpleIndexTable::Change(11, MakeMetadata(111)));
+  changes.push_back(SimpleIndexTable::Change::Removal(22));
+  changes.push_back(SimpleIndexTable::Change(33, MakeMetadata(330)));
+  // Removing a missing entry is fine.
+  changes.push_back(SimpleIndexTable::Change::Removal(44));
+  ASSERT_TRUE(SimpleIndexTable::SyncApplyChanges(index_directory(), changes,
+                                                 cache_last_modified_));
+
+  // The table was updated in place, and the journal cleared.
+  int64_t table_size = 0;
+  ASSERT_TRUE(base::GetFileSize(table_path, &table_size));
+  EXPECT_EQ(table_size_before, table_size);
+  EXPECT_FALSE(
+      base::PathExists(SimpleIndexTable::GetJournalPath(index_directory())));
+
+  entries.erase(22);
+  entries[11] = MakeMetadata(111);
+  entries[33] = MakeMetadata(330);
+  ExpectEntries(entries);
+
+  // Entries can be added back after being removed.
+  changes.clear();
+  changes.push_back(SimpleIndexTable::Change(22, MakeMetadata(222)));
+  ASSERT_TRUE(SimpleIndexTable::SyncApplyChanges(index_directory(), changes,
+                                                 cache_last_modified_));
+  entries[22] = MakeMetadata(222);
+  ExpectEntries(entries);
+}
+
+TEST_F(SimpleIndexTableTest, Grows) {
+  ASSERT_TRUE(SimpleIndexTable::SyncWriteTable(
+      index_directory(), SimpleIndex::EntrySet(), cache_last_modified_));
+
+  // Add and remove far more entries than the table has slots, so that it is
+  // rewritten both to grow and to drop removed slots.
+  SimpleIndex::EntrySet entries;
+  for (uint64_t i = 0; i < 5000; i += 100) {
+    SimpleIndexTable::ChangeList changes;
+    for (uint64_t hash = i; hash < i + 100; ++hash) {
+      const EntryMetadata metadata = MakeMetadata(static_cast<uint32_t>(hash));
+      changes.push_back(SimpleIndexTable::Change(hash, metadata));
+      entries[hash] = metadata;
+      if (hash % 3 == 0) {
+        changes.push_back(SimpleIndexTable::Change::Removal(hash));
+        entries.erase(hash);
+      }
+    }
+    ASSERT_TRUE(SimpleIndexTable::SyncApplyChanges(index_directory(), changes,
+                                                   cache_last_modified_));
+  }
+  ExpectEntries(entries);
+}
+
+TEST_F(SimpleIndexTableTest, ReplaysJournal) {
+  SimpleIndex::EntrySet entries;
+  entries[11] = MakeMetadata(110);
+  entries[22] = MakeMetadata(220);
+  ASSERT_TRUE(SimpleIndexTable::SyncWriteTable(index_directory(), entries,
+                                               base::Time()));
+
+  // The table gets the cache modification time of the journal.
+  SimpleIndexTable::ChangeList changes;
+  changes.push_back(SimpleIndexTable::Change::Removal(11));
+  changes.push_back(SimpleIndexTable::Change(33, MakeMetadata(330)));
+  ASSERT_TRUE(SimpleIndexTable::SyncWriteJournalForTesting(
+      index_directory(), changes, cache_last_modified_, 0));
+
+  entries.erase(11);
+  entries[33] = MakeMetadata(330);
+  ExpectEntries(entries);
+  EXPECT_FALSE(
+      base::PathExists(SimpleIndexTable::GetJournalPath(index_directory())));
+}
+
+TEST_F(SimpleIndexTableTest, ReplaysPartiallyAppliedJournal) {
+  SimpleIndex::EntrySet entries;
+  entries[11] = MakeMetadata(110);
+  entries[22] = MakeMetadata(220);
+  ASSERT_TRUE(SimpleIndexTable::SyncWriteTable(index_directory(), entries,
+                                               base::Time()));
+
+  // The slot of 33 was written before the crash, but not the header.
+  SimpleIndexTable::ChangeList changes;
+  changes.push_back(SimpleIndexTable::Change(33, MakeMetadata(330)));
+  changes.push_back(SimpleIndexTable::Change(44, MakeMetadata(440)));
+  changes.push_back(SimpleIndexTable::Change::Removal(11));
+  ASSERT_TRUE(SimpleIndexTable::SyncWriteJournalForTesting(
+      index_directory(), changes, base::Time(), 1));
+
+  // Applying changes replays the journal first, and counts every slot it
+  // used, including the slot of the removed entry.
+  changes.clear();
+  changes.push_back(SimpleIndexTable::Change(55, MakeMetadata(550)));
+  ASSERT_TRUE(SimpleIndexTable::SyncApplyChanges(index_directory(), changes,
+                                                 cache_last_modified_));
+  EXPECT_EQ(5, SimpleIndexTable::GetUsedSlotCountForTesting(index_directory()));
+
+  entries.erase(11);
+  entries[33] = MakeMetadata(330);
+  entries[44] = MakeMetadata(440);
+  entries[55] = MakeMetadata(550);
+  ExpectEntries(entries);
+}
+
+TEST_F(SimpleIndexTableTest, IgnoresTornJournal) {
+  SimpleIndex::EntrySet entries;
+  entries[11] = MakeMetadata(110);
+  ASSERT_TRUE(SimpleIndexTable::SyncWriteTable(index_directory(), entries,
+                                               cache_last_modified_));
+
+  SimpleIndexTable::ChangeList changes;
+  changes.push_back(SimpleIndexTable::Change::Removal(11));
+  changes.push_back(SimpleIndexTable::Change(22, MakeMetadata(220)));
+  ASSERT_TRUE(SimpleIndexTable::SyncWriteJournalForTesting(
+      index_directory(), changes, base::Time::Now(), 0));
+  const base::FilePath journal_path =
+      SimpleIndexTable::GetJournalPath(index_directory());
+  int64_t journal_size = 0;
+  ASSERT_TRUE(base::GetFileSize(journal_path, &journal_size));
+  {
+    base::File journal(journal_path,
+                       base::File::FLAG_OPEN | base::File::FLAG_WRITE);
+    ASSERT_TRUE(journal.SetLength(journal_size - 1));
+  }
+
+  // The interrupted write is lost as a whole.
+  ExpectEntries(entries);
+  EXPECT_FALSE(base::PathExists(journal_path));
+}
+
+TEST_F(SimpleIndexTableTest, LoadCorruptTable) {
+  const uint64_t kHash = UINT64_C(0x1122334455667788);
+  SimpleIndex::EntrySet entries;
+  entries[kHash] = MakeMetadata(110);
+  ASSERT_TRUE(SimpleIndexTable::SyncWriteTable(index_directory(), entries,
+                                               cache_last_modified_));
+
+  // Flip a bit of the metadata of the entry, found by its hash.
+  const base::FilePath table_path =
+      SimpleIndexTable::GetTablePath(index_directory());
+  std::string contents;
+  ASSERT_TRUE(base::ReadFileToString(table_path, &contents));
+  const std::string hash_bytes(reinterpret_cast<const char*>(&kHash),
+                               sizeof(kHash));
+  const size_t slot_offset = contents.find(hash_bytes);
+  ASSERT_NE(std::string::npos, slot_offset);
+  contents[slot_offset + sizeof(kHash)] ^= 1;
+  ASSERT_EQ(static_cast<int>(contents.size()),
+            base::WriteFile(table_path, contents.data(), contents.size()));
+
+  SimpleIndex::EntrySet loaded_entries;
+  base::Time cache_last_modified;
+  EXPECT_FALSE(SimpleIndexTable::SyncLoad(index_directory(), &loaded_entries,
+                                          &cache_last_modified));
+  EXPECT_FALSE(SimpleIndexTable::Exists(index_directory()));
+}
+
+}  // namespace disk_cache
@@ -21,6 +21,7 @@
 #include "net/base/cache_type.h"
 #include "net/disk_cache/simple/simple_index_delegate.h"
 #include "net/disk_cache/simple/simple_index_file.h"
+#include "net/disk_cache/simple/simple_index_table.h"
 #include "net/disk_cache/simple/simple_test_util.h"
 #include "net/disk_cache/simple/simple_util.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -56,7 +57,8 @@ class MockSimpleIndexFile : public SimpleIndexFile,
       : SimpleIndexFile(NULL, NULL, net::DISK_CACHE, base::FilePath()),
         load_result_(NULL),
         load_index_entries_calls_(0),
-        disk_writes_(0) {}
+        disk_writes_(0),
+        disk_change_writes_(0) {}
 
   void LoadIndexEntries(base::Time cache_last_modified,
                         const base::Closure& callback,
@@ -76,21 +78,37 @@ class MockSimpleIndexFile : public SimpleIndexFile,
     disk_write_entry_set_ = entry_set;
   }
 
+  void WriteChangesToDisk(SimpleIndex::IndexWriteToDiskReason reason,
+                          std::unique_ptr<SimpleIndexTable::ChangeList> changes,
+                          const base::TimeTicks& start,
+                          bool app_on_background,
+                          const base::Closure& callback) override {
+    disk_change_writes_++;
+    disk_write_changes_.swap(*changes);
+  }
+
   void GetAndResetDiskWriteEntrySet(SimpleIndex::EntrySet* entry_set) {
     entry_set->swap(disk_write_entry_set_);
   }
 
+  void GetAndResetDiskWriteChanges(SimpleIndexTable::ChangeList* changes) {
+    changes->swap(disk_write_changes_);
+  }
+
   const base::Closure& load_callback() const { return load_callback_; }
   SimpleIndexLoadResult* load_result() const { return load_result_; }
   int load_index_entries_calls() const { return load_index_entries_calls_; }
   int disk_writes() const { return disk_writes_; }
+  int disk_change_writes() const { return disk_change_writes_; }
 
  private:
   base::Closure load_callback_;
   SimpleIndexLoadResult* load_result_;
   int load_index_entries_calls_;
   int disk_writes_;
+  int disk_change_writes_;
   SimpleIndex::EntrySet disk_write_entry_set_;
+  SimpleIndexTable::ChangeList disk_write_changes_;
 };
 
 class SimpleIndexTest  : public testing::Test, public SimpleIndexDelegate {
@@ -568,6 +586,114 @@ TEST_F(SimpleIndexTest, BasicEviction) {
   ASSERT_EQ(2u, last_doom_entry_hashes().size());
 }
 
+// With TinyLFU, an entry requested once is evicted before an older entry that
+// is requested often.
+TEST_F(SimpleIndexTest, TinyLFUEviction) {
+  base::Time now(base::Time::Now());
+  index()->SetEvictionPolicy(SimpleIndex::EVICTION_POLICY_TINY_LFU);
+  index()->SetMaxSize(1000);
+  InsertIntoIndexFileReturn(hashes_.at<1>(),
+                            now - base::TimeDelta::FromDays(2),
+                            300u);
+  ReturnIndexFile();
+  for (int i = 0; i < 5; ++i)
+    index()->RecordRequest(hashes_.at<1>());
+
+  index()->Insert(hashes_.at<2>());
+  index()->UpdateEntrySize(hashes_.at<2>(), 300u);
+
+  WaitForTimeChange();
+
+  // The newest entry is in the window, and stays.
+  index()->Insert(hashes_.at<3>());
+  index()->UpdateEntrySize(hashes_.at<3>(), 400u);
+  EXPECT_EQ(1, doom_entries_calls());
+  EXPECT_EQ(2, index()->GetEntryCount());
+  EXPECT_TRUE(index()->Has(hashes_.at<1>()));
+  EXPECT_FALSE(index()->Has(hashes_.at<2>()));
+  EXPECT_TRUE(index()->Has(hashes_.at<3>()));
+}
+
+// Without requests recorded, TinyLFU evicts in LRU order.
+TEST_F(SimpleIndexTest, TinyLFUEvictionWithoutRequests) {
+  base::Time now(base::Time::Now());
+  index()->SetEvictionPolicy(SimpleIndex::EVICTION_POLICY_TINY_LFU);
+  index()->SetMaxSize(1000);
+  InsertIntoIndexFileReturn(hashes_.at<1>(),
+                            now - base::TimeDelta::FromDays(2),
+                            300u);
+  InsertIntoIndexFileReturn(hashes_.at<2>(),
+                            now - base::TimeDelta::FromDays(1),
+                            300u);
+  ReturnIndexFile();
+
+  index()->Insert(hashes_.at<3>());
+  index()->UpdateEntrySize(hashes_.at<3>(), 400u);
+  EXPECT_EQ(1, doom_entries_calls());
+  EXPECT_FALSE(index()->Has(hashes_.at<1>()));
+  EXPECT_TRUE(index()->Has(hashes_.at<2>()));
+  EXPECT_TRUE(index()->Has(hashes_.at<3>()));
+}
+
+// The hot entries are the most requested, and the most recently used among
+// equally requested ones.
+TEST_F(SimpleIndexTest, GetHotEntries) {
+  base::Time now(base::Time::Now());
+  index()->SetEvictionPolicy(SimpleIndex::EVICTION_POLICY_TINY_LFU);
+  InsertIntoIndexFileReturn(hashes_.at<1>(),
+                            now - base::TimeDelta::FromDays(3), 100u);
+  InsertIntoIndexFileReturn(hashes_.at<2>(),
+                            now - base::TimeDelta::FromDays(2), 100u);
+  InsertIntoIndexFileReturn(hashes_.at<3>(),
+                            now - base::TimeDelta::FromDays(1), 100u);
+  InsertIntoIndexFileReturn(hashes_.at<4>(), now, 100u);
+  ReturnIndexFile();
+  for (int i = 0; i < 3; ++i)
+    index()->RecordRequest(hashes_.at<1>());
+  index()->RecordRequest(hashes_.at<2>());
+  index()->RecordRequest(hashes_.at<3>());
+
+  std::unique_ptr<SimpleIndex::HashList> hot_entries =
+      index()->GetHotEntries(2);
+  ASSERT_EQ(2u, hot_entries->size());
+  EXPECT_EQ(hashes_.at<1>(), hot_entries->at(0));
+  EXPECT_EQ(hashes_.at<3>(), hot_entries->at(1));
+
+  // The entry never requested is left out.
+  hot_entries = index()->GetHotEntries(10);
+  ASSERT_EQ(3u, hot_entries->size());
+  EXPECT_EQ(hashes_.at<2>(), hot_entries->at(2));
+}
+
+// Only the hottest candidates are kept and sorted, but they come out as if
+// all of them were.
+TEST_F(SimpleIndexTest, SelectHotEntries) {
+  const base::Time now = base::Time::Now();
+  std::unique_ptr<SimpleIndex::HotEntryCandidateList> candidates(
+      new SimpleIndex::HotEntryCandidateList());
+  for (uint64_t i = 0; i < 1000; ++i) {
+    SimpleIndex::HotEntryCandidate candidate;
+    candidate.entry_hash = i;
+    candidate.frequency = 1 + (i * 7919) % 15;
+    candidate.last_used_time = now + base::TimeDelta::FromSeconds(i);
+    candidates->push_back(candidate);
+  }
+  SimpleIndex::HotEntryCandidateList sorted = *candidates;
+  std::sort(sorted.begin(), sorted.end(),
+            [](const SimpleIndex::HotEntryCandidate& a,
+               const SimpleIndex::HotEntryCandidate& b) {
+              if (a.frequency != b.frequency)
+                return a.frequency > b.frequency;
+              return a.last_used_time > b.last_used_time;
+            });
+
+  std::unique_ptr<SimpleIndex::HashList> hot_entries =
+      SimpleIndex::SelectHotEntries(std::move(candidates), 50);
+  ASSERT_EQ(50u, hot_entries->size());
+  for (size_t i = 0; i < hot_entries->size(); ++i)
+    EXPECT_EQ(sorted[i].entry_hash, hot_entries->at(i)) << i;
+}
+
 // Confirm all the operations queue a disk write at some point in the
 // future.
 TEST_F(SimpleIndexTest, DiskWriteQueued) {
@@ -645,4 +771,48 @@ TEST_F(SimpleIndexTest, DiskWritePostponed) {
   index()->write_to_disk_timer_.Stop();
 }
 
+// Confirm that with an index table only the changed entries are written.
+TEST_F(SimpleIndexTest, DiskWriteChanges) {
+  index_file_->SetUseIndexTableForTesting(true);
+  index()->SetMaxSize(1000);
+  InsertIntoIndexFileReturn(hashes_.at<1>(), base::Time::Now(), 10);
+  InsertIntoIndexFileReturn(hashes_.at<2>(), base::Time::Now(), 10);
+  // Changes made before initialization are written too.
+  index()->Remove(hashes_.at<2>());
+  ReturnIndexFile();
+
+  index()->Insert(hashes_.at<3>());
+  index()->UpdateEntrySize(hashes_.at<3>(), 20u);
+  index()->Insert(hashes_.at<4>());
+  index()->Remove(hashes_.at<4>());
+  index()->write_to_disk_timer_.Stop();
+  index()->WriteToDisk(SimpleIndex::INDEX_WRITE_REASON_IDLE);
+  EXPECT_EQ(0, index_file_->disk_writes());
+  EXPECT_EQ(1, index_file_->disk_change_writes());
+
+  SimpleIndexTable::ChangeList changes;
+  index_file_->GetAndResetDiskWriteChanges(&changes);
+  ASSERT_EQ(3u, changes.size());
+  std::vector<uint64_t> removed_hashes;
+  for (const SimpleIndexTable::Change& change : changes) {
+    if (change.removed) {
+      removed_hashes.push_back(change.entry_hash);
+    } else {
+      EXPECT_EQ(hashes_.at<3>(), change.entry_hash);
+      EXPECT_EQ(20u, change.metadata.GetEntrySize());
+    }
+  }
+  std::sort(removed_hashes.begin(), removed_hashes.end());
+  std::vector<uint64_t> expected_removed_hashes = {hashes_.at<2>(),
+                                                   hashes_.at<4>()};
+  std::sort(expected_removed_hashes.begin(), expected_removed_hashes.end());
+  EXPECT_EQ(expected_removed_hashes, removed_hashes);
+
+  // Nothing changed since.
+  index()->WriteToDisk(SimpleIndex::INDEX_WRITE_REASON_SHUTDOWN);
+  EXPECT_EQ(2, index_file_->disk_change_writes());
+  index_file_->GetAndResetDiskWriteChanges(&changes);
+  EXPECT_TRUE(changes.empty());
+}
+
 }  // namespace disk_cache
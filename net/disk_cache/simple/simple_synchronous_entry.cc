@@ -7,6 +7,7 @@
 #include <algorithm>
 #include <cstring>
 #include <functional>
+#include <iterator>
 #include <limits>
 
 #include "base/compiler_specific.h"
@@ -23,6 +24,7 @@
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
 #include "net/disk_cache/simple/simple_backend_version.h"
+#include "net/disk_cache/simple/simple_file_io.h"
 #include "net/disk_cache/simple/simple_histogram_macros.h"
 #include "net/disk_cache/simple/simple_util.h"
 #include "third_party/zlib/zlib.h"
@@ -135,6 +137,10 @@ bool TruncatePath(const FilePath& filename_to_truncate) {
   return true;
 }
 
+// Below this many ranges, scanning the sparse file is about as quick as
+// reading an index of its ranges.
+const size_t kMinSparseIndexRanges = 4;
+
 void CalculateSHA256OfKey(const std::string& key,
                           net::SHA256HashValue* out_hash_value) {
   std::unique_ptr<crypto::SecureHash> hash(
@@ -212,6 +218,7 @@ SimpleEntryCreationResults::SimpleEntryCreationResults(
     : sync_entry(NULL),
       entry_stat(entry_stat),
       stream_0_crc32(crc32(0, Z_NULL, 0)),
+      stream_1_read_ahead_crc32(crc32(0, Z_NULL, 0)),
       result(net::OK) {
 }
 
@@ -258,6 +265,7 @@ void SimpleSynchronousEntry::OpenEntry(
     const std::string& key,
     const uint64_t entry_hash,
     const bool had_index,
+    const int read_ahead_size,
     SimpleEntryCreationResults* out_results) {
   base::ElapsedTimer open_time;
   SimpleSynchronousEntry* sync_entry =
@@ -265,11 +273,22 @@ void SimpleSynchronousEntry::OpenEntry(
   out_results->result = sync_entry->InitializeForOpen(
       &out_results->entry_stat, &out_results->stream_0_data,
       &out_results->stream_0_crc32);
+  if (out_results->result == net::OK) {
+    const int read_ahead_len =
+        std::min(read_ahead_size, out_results->entry_stat.data_size(1));
+    if (read_ahead_len > 0) {
+      out_results->result = sync_entry->ReadAhead(
+          read_ahead_len, &out_results->entry_stat,
+          &out_results->stream_1_read_ahead,
+          &out_results->stream_1_read_ahead_crc32);
+    }
+  }
   if (out_results->result != net::OK) {
     sync_entry->Doom();
     delete sync_entry;
     out_results->sync_entry = NULL;
     out_results->stream_0_data = NULL;
+    out_results->stream_1_read_ahead = NULL;
     return;
   }
   UMA_HISTOGRAM_TIMES("SimpleCache.DiskOpenLatency", open_time.Elapsed());
@@ -345,8 +364,10 @@ void SimpleSynchronousEntry::ReadData(const EntryOperationData& in_entry_op,
   // be handled in the SimpleEntryImpl.
   DCHECK_GT(in_entry_op.buf_len, 0);
   DCHECK(!empty_file_omitted_[file_index]);
-  int bytes_read = files_[file_index].Read(file_offset, out_buf->data(),
-                                           in_entry_op.buf_len);
+  SimpleFileIO::Request request = SimpleFileIO::Request::Read(
+      &files_[file_index], file_offset, out_buf->data(), in_entry_op.buf_len);
+  file_io_->Run(&request, 1);
+  int bytes_read = request.result;
   if (bytes_read > 0) {
     entry_stat->set_last_used(Time::Now());
     *out_crc32 = crc32(crc32(0L, Z_NULL, 0),
@@ -422,8 +443,9 @@ void SimpleSynchronousEntry::WriteData(const EntryOperationData& in_entry_op,
     }
   }
   if (buf_len > 0) {
-    if (files_[file_index].Write(file_offset, in_buf->data(), buf_len) !=
-        buf_len) {
+    SimpleFileIO::Request request = SimpleFileIO::Request::Write(
+        &files_[file_index], file_offset, in_buf->data(), buf_len);
+    if (!file_io_->Run(&request, 1)) {
       RecordWriteResult(cache_type_, WRITE_RESULT_WRITE_FAILURE);
       Doom();
       *out_result = net::ERR_CACHE_WRITE_FAILURE;
@@ -466,47 +488,62 @@ void SimpleSynchronousEntry::ReadSparseData(
 
   // Find the first sparse range at or after the requested offset.
   SparseRangeIterator it = sparse_ranges_.lower_bound(offset);
+  // The offset to read from in |it|.
+  int net_offset = 0;
 
   if (it != sparse_ranges_.begin()) {
-    // Hop back one range and read the one overlapping with the start.
-    --it;
-    SparseRange* found_range = &it->second;
-    DCHECK_EQ(it->first, found_range->offset);
+    // Hop back one range and start with it if it overlaps with the start.
+    SparseRangeIterator previous = std::prev(it);
+    SparseRange* found_range = &previous->second;
+    DCHECK_EQ(previous->first, found_range->offset);
     if (found_range->offset + found_range->length > offset) {
       DCHECK_GE(found_range->length, 0);
       DCHECK_LE(found_range->length, std::numeric_limits<int32_t>::max());
       DCHECK_GE(offset - found_range->offset, 0);
       DCHECK_LE(offset - found_range->offset,
                 std::numeric_limits<int32_t>::max());
-      int net_offset = static_cast<int>(offset - found_range->offset);
-      int range_len_after_offset =
-          static_cast<int>(found_range->length - net_offset);
-      DCHECK_GE(range_len_after_offset, 0);
-
-      int len_to_read = std::min(buf_len, range_len_after_offset);
-      if (!ReadSparseRange(found_range, net_offset, len_to_read, buf)) {
-        *out_result = net::ERR_CACHE_READ_FAILURE;
-        return;
-      }
-      read_so_far += len_to_read;
+      net_offset = static_cast<int>(offset - found_range->offset);
+      it = previous;
     }
-    ++it;
   }
 
   // Keep reading until the buffer is full or there is not another contiguous
-  // range.
+  // range. Contiguous ranges that also follow each other in the sparse file,
+  // as those written in order do, are read at once.
   while (read_so_far < buf_len &&
          it != sparse_ranges_.end() &&
-         it->second.offset == offset + read_so_far) {
-    SparseRange* found_range = &it->second;
-    DCHECK_EQ(it->first, found_range->offset);
-    int range_len = base::saturated_cast<int>(found_range->length);
-    int len_to_read = std::min(buf_len - read_so_far, range_len);
-    if (!ReadSparseRange(found_range, 0, len_to_read, buf + read_so_far)) {
+         it->second.offset + net_offset == offset + read_so_far) {
+    DCHECK_EQ(it->first, it->second.offset);
+    SparseRangeIterator first = it;
+    int range_len_after_offset =
+        base::saturated_cast<int>(it->second.length - net_offset);
+    DCHECK_GE(range_len_after_offset, 0);
+    int len_to_read = std::min(buf_len - read_so_far, range_len_after_offset);
+    int run_len = len_to_read;
+    int last_len = len_to_read;
+    size_t count = 1;
+
+    SparseRangeIterator next = std::next(it);
+    while (read_so_far + run_len < buf_len &&
+           next != sparse_ranges_.end() &&
+           next->second.offset == it->second.offset + it->second.length &&
+           next->second.file_offset ==
+               it->second.file_offset + it->second.length +
+                   static_cast<int64_t>(sizeof(SimpleFileSparseRangeHeader))) {
+      it = next++;
+      last_len = std::min(buf_len - read_so_far - run_len,
+                          base::saturated_cast<int>(it->second.length));
+      run_len += last_len;
+      ++count;
+    }
+
+    if (!ReadSparseRanges(first, count, net_offset, len_to_read, last_len,
+                          buf + read_so_far)) {
       *out_result = net::ERR_CACHE_READ_FAILURE;
       return;
     }
-    read_so_far += len_to_read;
+    read_so_far += run_len;
+    net_offset = 0;
     ++it;
   }
 
@@ -532,6 +569,12 @@ void SimpleSynchronousEntry::WriteSparseData(
     return;
   }
 
+  if (!RemoveSparseIndex()) {
+    *out_result = net::ERR_CACHE_WRITE_FAILURE;
+    return;
+  }
+  sparse_ranges_changed_ = true;
+
   uint64_t sparse_data_size = out_entry_stat->sparse_data_size();
   // This is a pessimistic estimate; it assumes the entire buffer is going to
   // be appended as a new range, not written over existing ranges.
@@ -688,6 +731,12 @@ void SimpleSynchronousEntry::Close(
     net::GrowableIOBuffer* stream_0_data) {
   DCHECK(stream_0_data);
 
+  // All the writes are issued as one batch once the files have their final
+  // lengths. The buffers they point to must stay put until then.
+  std::vector<SimpleFileIO::Request> writes;
+  std::vector<SimpleFileEOF> eof_records;
+  eof_records.reserve(crc32s_to_write->size());
+  net::SHA256HashValue hash_value;
   for (std::vector<CRCRecord>::const_iterator it = crc32s_to_write->begin();
        it != crc32s_to_write->end(); ++it) {
     const int stream_index = it->index;
@@ -698,21 +747,13 @@ void SimpleSynchronousEntry::Close(
     if (stream_index == 0) {
       // Write stream 0 data.
       int stream_0_offset = entry_stat.GetOffsetInFile(key_.size(), 0, 0);
-      if (files_[0].Write(stream_0_offset, stream_0_data->data(),
-                          entry_stat.data_size(0)) != entry_stat.data_size(0)) {
-        RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
-        DVLOG(1) << "Could not write stream 0 data.";
-        Doom();
-      }
-      net::SHA256HashValue hash_value;
+      writes.push_back(SimpleFileIO::Request::Write(
+          &files_[0], stream_0_offset, stream_0_data->data(),
+          entry_stat.data_size(0)));
       CalculateSHA256OfKey(key_, &hash_value);
-      if (files_[0].Write(stream_0_offset + entry_stat.data_size(0),
-                          reinterpret_cast<char*>(hash_value.data),
-                          sizeof(hash_value)) != sizeof(hash_value)) {
-        RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
-        DVLOG(1) << "Could not write stream 0 data.";
-        Doom();
-      }
+      writes.push_back(SimpleFileIO::Request::Write(
+          &files_[0], stream_0_offset + entry_stat.data_size(0),
+          reinterpret_cast<char*>(hash_value.data), sizeof(hash_value)));
     }
 
     SimpleFileEOF eof_record;
@@ -735,15 +776,16 @@ void SimpleSynchronousEntry::Close(
       Doom();
       break;
     }
-    if (files_[file_index].Write(eof_offset,
-                                 reinterpret_cast<const char*>(&eof_record),
-                                 sizeof(eof_record)) !=
-        sizeof(eof_record)) {
-      RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
-      DVLOG(1) << "Could not write eof record.";
-      Doom();
-      break;
-    }
+    eof_records.push_back(eof_record);
+    writes.push_back(SimpleFileIO::Request::Write(
+        &files_[file_index], eof_offset,
+        reinterpret_cast<const char*>(&eof_records.back()),
+        sizeof(eof_record)));
+  }
+  if (!file_io_->Run(writes.data(), writes.size())) {
+    RecordCloseResult(cache_type_, CLOSE_RESULT_WRITE_FAILURE);
+    DVLOG(1) << "Could not write stream 0 data or eof record.";
+    Doom();
   }
   for (int i = 0; i < kSimpleEntryFileCount; ++i) {
     if (empty_file_omitted_[i])
@@ -765,7 +807,7 @@ void SimpleSynchronousEntry::Close(
   }
 
   if (sparse_file_open())
-    sparse_file_.Close();
+    CloseSparseFile();
 
   if (files_created_) {
     const int stream2_file_index = GetFileIndexFromStreamIndex(2);
@@ -787,8 +829,12 @@ SimpleSynchronousEntry::SimpleSynchronousEntry(net::CacheType cache_type,
       entry_hash_(entry_hash),
       had_index_(had_index),
       key_(key),
+      file_io_(SimpleFileIO::Get()),
       have_open_files_(false),
-      initialized_(false) {
+      initialized_(false),
+      sparse_tail_offset_(0),
+      sparse_index_on_disk_(false),
+      sparse_ranges_changed_(false) {
   for (int i = 0; i < kSimpleEntryFileCount; ++i)
     empty_file_omitted_[i] = false;
 }
@@ -1121,21 +1167,21 @@ bool SimpleSynchronousEntry::InitializeCreatedFile(
   header.key_length = key_.size();
   header.key_hash = base::Hash(key_);
 
-  int bytes_written = files_[file_index].Write(
-      0, reinterpret_cast<char*>(&header), sizeof(header));
-  if (bytes_written != sizeof(header)) {
-    *out_result = CREATE_ENTRY_CANT_WRITE_HEADER;
-    return false;
-  }
-
-  bytes_written = files_[file_index].Write(sizeof(header), key_.data(),
-                                           key_.size());
-  if (bytes_written != base::checked_cast<int>(key_.size())) {
-    *out_result = CREATE_ENTRY_CANT_WRITE_KEY;
-    return false;
-  }
+  SimpleFileIO::Request writes[] = {
+      SimpleFileIO::Request::Write(&files_[file_index], 0,
+                                   reinterpret_cast<char*>(&header),
+                                   sizeof(header)),
+      SimpleFileIO::Request::Write(&files_[file_index], sizeof(header),
+                                   key_.data(),
+                                   base::checked_cast<int>(key_.size())),
+  };
+  if (file_io_->Run(writes, arraysize(writes)))
+    return true;
 
-  return true;
+  *out_result = writes[0].result != writes[0].size
+                    ? CREATE_ENTRY_CANT_WRITE_HEADER
+                    : CREATE_ENTRY_CANT_WRITE_KEY;
+  return false;
 }
 
 int SimpleSynchronousEntry::InitializeForCreate(
@@ -1160,6 +1206,33 @@ int SimpleSynchronousEntry::InitializeForCreate(
   return net::OK;
 }
 
+int SimpleSynchronousEntry::ReadAhead(
+    int read_ahead_len,
+    SimpleEntryStat* entry_stat,
+    scoped_refptr<net::IOBufferWithSize>* out_read_ahead,
+    uint32_t* out_read_ahead_crc32) {
+  DCHECK_GT(read_ahead_len, 0);
+  scoped_refptr<net::IOBufferWithSize> read_ahead =
+      new net::IOBufferWithSize(read_ahead_len);
+  int result = net::ERR_FAILED;
+  ReadData(EntryOperationData(1, 0, read_ahead_len), read_ahead.get(),
+           out_read_ahead_crc32, entry_stat, &result);
+  if (result < 0)
+    return result;
+  // The stream is as long as its EOF record says, so it cannot be short.
+  if (result != read_ahead_len) {
+    Doom();
+    return net::ERR_CACHE_READ_FAILURE;
+  }
+  if (read_ahead_len == entry_stat->data_size(1)) {
+    CheckEOFRecord(1, *entry_stat, *out_read_ahead_crc32, &result);
+    if (result != net::OK)
+      return result;
+  }
+  *out_read_ahead = read_ahead;
+  return net::OK;
+}
+
 int SimpleSynchronousEntry::ReadAndValidateStream0(
     int file_size,
     SimpleEntryStat* out_entry_stat,
@@ -1375,6 +1448,8 @@ bool SimpleSynchronousEntry::CreateSparseFile() {
 
 void SimpleSynchronousEntry::CloseSparseFile() {
   DCHECK(sparse_file_open());
+  if (sparse_ranges_changed_ && sparse_ranges_.size() >= kMinSparseIndexRanges)
+    WriteSparseIndex();
   sparse_file_.Close();
 }
 
@@ -1389,6 +1464,7 @@ bool SimpleSynchronousEntry::TruncateSparseFile() {
 
   sparse_ranges_.clear();
   sparse_tail_offset_ = header_and_key_length;
+  sparse_index_on_disk_ = false;
 
   return true;
 }
@@ -1418,6 +1494,8 @@ bool SimpleSynchronousEntry::InitializeSparseFile() {
 
   sparse_ranges_.clear();
   sparse_tail_offset_ = sizeof(header) + key_.size();
+  sparse_index_on_disk_ = false;
+  sparse_ranges_changed_ = false;
 
   return true;
 }
@@ -1445,7 +1523,14 @@ bool SimpleSynchronousEntry::ScanSparseFile(int32_t* out_sparse_data_size) {
     return false;
   }
 
+  sparse_ranges_changed_ = false;
+  if (ReadSparseIndex(&sparse_data_size)) {
+    *out_sparse_data_size = static_cast<int32_t>(sparse_data_size);
+    return true;
+  }
+
   sparse_ranges_.clear();
+  sparse_index_on_disk_ = false;
 
   int64_t range_header_offset = sizeof(header) + key_.size();
   while (1) {
@@ -1456,6 +1541,14 @@ bool SimpleSynchronousEntry::ScanSparseFile(int32_t* out_sparse_data_size) {
                           sizeof(range_header));
     if (range_header_read_result == 0)
       break;
+    if (range_header_read_result >=
+            static_cast<int>(sizeof(range_header.sparse_range_magic_number)) &&
+        range_header.sparse_range_magic_number ==
+            kSimpleSparseIndexMagicNumber) {
+      // The ranges end at an index that could not be read.
+      sparse_index_on_disk_ = true;
+      break;
+    }
     if (range_header_read_result != sizeof(range_header)) {
       DLOG(WARNING) << "Could not read sparse range header.";
       return false;
@@ -1486,29 +1579,209 @@ bool SimpleSynchronousEntry::ScanSparseFile(int32_t* out_sparse_data_size) {
   return true;
 }
 
-bool SimpleSynchronousEntry::ReadSparseRange(const SparseRange* range,
-                                             int offset, int len, char* buf) {
-  DCHECK(range);
-  DCHECK(buf);
-  DCHECK_LE(offset, range->length);
-  DCHECK_LE(offset + len, range->length);
+bool SimpleSynchronousEntry::ReadSparseIndex(int64_t* out_sparse_data_size) {
+  DCHECK(sparse_file_open());
 
-  int bytes_read = sparse_file_.Read(range->file_offset + offset, buf, len);
-  if (bytes_read < len) {
-    DLOG(WARNING) << "Could not read sparse range.";
+  const int64_t ranges_offset = sizeof(SimpleFileHeader) + key_.size();
+  const int64_t file_length = sparse_file_.GetLength();
+  const int64_t footer_offset =
+      file_length - static_cast<int64_t>(sizeof(SimpleFileSparseIndexFooter));
+  if (footer_offset - ranges_offset <
+      static_cast<int64_t>(sizeof(SimpleFileSparseIndexHeader))) {
+    return false;
+  }
+
+  SimpleFileSparseIndexFooter footer;
+  int footer_read_result = sparse_file_.Read(
+      footer_offset, reinterpret_cast<char*>(&footer), sizeof(footer));
+  if (footer_read_result != sizeof(footer) ||
+      footer.sparse_index_magic_number != kSimpleSparseIndexMagicNumber) {
+    return false;
+  }
+
+  const int64_t index_size = footer_offset - footer.index_offset;
+  if (footer.index_offset < ranges_offset ||
+      index_size < static_cast<int64_t>(sizeof(SimpleFileSparseIndexHeader)) ||
+      index_size > std::numeric_limits<int32_t>::max()) {
+    DLOG(WARNING) << "Invalid sparse index footer.";
+    return false;
+  }
+
+  std::unique_ptr<char[]> index(new char[index_size]);
+  int index_read_result = sparse_file_.Read(footer.index_offset, index.get(),
+                                            static_cast<int>(index_size));
+  if (index_read_result != index_size) {
+    DLOG(WARNING) << "Could not read sparse index.";
+    return false;
+  }
+
+  SimpleFileSparseIndexHeader index_header;
+  std::memcpy(&index_header, index.get(), sizeof(index_header));
+  const char* entries = index.get() + sizeof(index_header);
+  const int64_t entries_size = index_size - sizeof(index_header);
+  if (index_header.sparse_index_magic_number != kSimpleSparseIndexMagicNumber ||
+      entries_size != static_cast<int64_t>(index_header.range_count) *
+                          static_cast<int64_t>(
+                              sizeof(SimpleFileSparseIndexEntry)) ||
+      index_header.entries_crc32 !=
+          crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(entries),
+                static_cast<uInt>(entries_size))) {
+    DLOG(WARNING) << "Invalid sparse index.";
     return false;
   }
 
-  // If we read the whole range and we have a crc32, check it.
-  if (offset == 0 && len == range->length && range->data_crc32 != 0) {
-    uint32_t actual_crc32 =
-        crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(buf), len);
-    if (actual_crc32 != range->data_crc32) {
-      DLOG(WARNING) << "Sparse range crc32 mismatch.";
+  sparse_ranges_.clear();
+  int64_t sparse_data_size = 0;
+  for (uint32_t i = 0; i < index_header.range_count; ++i) {
+    SimpleFileSparseIndexEntry entry;
+    std::memcpy(&entry, entries + i * sizeof(entry), sizeof(entry));
+
+    SparseRange range;
+    range.offset = entry.offset;
+    range.length = entry.length;
+    range.data_crc32 = entry.data_crc32;
+    range.file_offset = entry.file_offset;
+    if (range.offset < 0 ||
+        range.length > std::numeric_limits<int32_t>::max() ||
+        range.file_offset - ranges_offset <
+            static_cast<int64_t>(sizeof(SimpleFileSparseRangeHeader)) ||
+        range.file_offset + range.length > footer.index_offset) {
+      DLOG(WARNING) << "Invalid sparse index entry.";
+      sparse_ranges_.clear();
       return false;
     }
+    sparse_ranges_.insert(std::make_pair(range.offset, range));
+    sparse_data_size += range.length;
+  }
+
+  *out_sparse_data_size = sparse_data_size;
+  sparse_tail_offset_ = footer.index_offset;
+  sparse_index_on_disk_ = true;
+
+  return true;
+}
+
+void SimpleSynchronousEntry::WriteSparseIndex() {
+  DCHECK(sparse_file_open());
+  DCHECK(!sparse_index_on_disk_);
+
+  const size_t entries_size =
+      sparse_ranges_.size() * sizeof(SimpleFileSparseIndexEntry);
+  const size_t index_size = sizeof(SimpleFileSparseIndexHeader) +
+                            entries_size + sizeof(SimpleFileSparseIndexFooter);
+  std::unique_ptr<char[]> index(new char[index_size]);
+  char* entries = index.get() + sizeof(SimpleFileSparseIndexHeader);
+
+  char* entry_pos = entries;
+  for (const auto& it : sparse_ranges_) {
+    const SparseRange& range = it.second;
+    SimpleFileSparseIndexEntry entry;
+    entry.offset = range.offset;
+    entry.file_offset = range.file_offset;
+    entry.length = base::checked_cast<uint32_t>(range.length);
+    entry.data_crc32 = range.data_crc32;
+    std::memcpy(entry_pos, &entry, sizeof(entry));
+    entry_pos += sizeof(entry);
+  }
+
+  SimpleFileSparseIndexHeader index_header;
+  index_header.sparse_index_magic_number = kSimpleSparseIndexMagicNumber;
+  index_header.range_count =
+      base::checked_cast<uint32_t>(sparse_ranges_.size());
+  index_header.entries_crc32 =
+      crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(entries),
+            base::checked_cast<uInt>(entries_size));
+  std::memcpy(index.get(), &index_header, sizeof(index_header));
+
+  SimpleFileSparseIndexFooter footer;
+  footer.sparse_index_magic_number = kSimpleSparseIndexMagicNumber;
+  footer.index_offset = sparse_tail_offset_;
+  std::memcpy(entry_pos, &footer, sizeof(footer));
+
+  // Even if it is partly written, the index is removed before the ranges
+  // change.
+  sparse_index_on_disk_ = true;
+  int bytes_written = sparse_file_.Write(sparse_tail_offset_, index.get(),
+                                         base::checked_cast<int>(index_size));
+  if (bytes_written != base::checked_cast<int>(index_size))
+    DLOG(WARNING) << "Could not write sparse index.";
+}
+
+bool SimpleSynchronousEntry::RemoveSparseIndex() {
+  DCHECK(sparse_file_open());
+
+  if (!sparse_index_on_disk_)
+    return true;
+  if (!sparse_file_.SetLength(sparse_tail_offset_)) {
+    DLOG(WARNING) << "Could not remove sparse index.";
+    return false;
+  }
+  sparse_index_on_disk_ = false;
+
+  return true;
+}
+
+bool SimpleSynchronousEntry::ReadSparseRanges(SparseRangeIterator first,
+                                              size_t count,
+                                              int offset,
+                                              int len,
+                                              int last_len,
+                                              char* buf) {
+  DCHECK(buf);
+  DCHECK_GT(count, 0u);
+  DCHECK(count > 1 || len == last_len);
+
+  SparseRangeIterator last = std::next(first, count - 1);
+  const int64_t read_offset = first->second.file_offset + offset;
+  const int64_t read_end =
+      count > 1 ? last->second.file_offset + last_len : read_offset + len;
+  const int read_len = base::checked_cast<int>(read_end - read_offset);
+
+  // A single range is read in place; the headers between several ranges are
+  // read too, so those are read aside.
+  std::unique_ptr<char[]> run_buffer;
+  char* run = buf;
+  if (count > 1) {
+    run_buffer.reset(new char[read_len]);
+    run = run_buffer.get();
+  }
+
+  int bytes_read = sparse_file_.Read(read_offset, run, read_len);
+  if (bytes_read < read_len) {
+    DLOG(WARNING) << "Could not read sparse range.";
+    return false;
+  }
+
+  SparseRangeIterator it = first;
+  for (size_t i = 0; i < count; ++i, ++it) {
+    const SparseRange& range = it->second;
+    const int range_offset = i == 0 ? offset : 0;
+    int range_len = static_cast<int>(range.length);
+    if (i == 0)
+      range_len = len;
+    else if (i == count - 1)
+      range_len = last_len;
+    DCHECK_LE(range_offset, range.length);
+    DCHECK_LE(range_offset + range_len, range.length);
+
+    const char* data = run + (range.file_offset + range_offset - read_offset);
+    // If we read the whole range and we have a crc32, check it.
+    if (range_offset == 0 && range_len == range.length &&
+        range.data_crc32 != 0) {
+      uint32_t actual_crc32 =
+          crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(data),
+                range_len);
+      if (actual_crc32 != range.data_crc32) {
+        DLOG(WARNING) << "Sparse range crc32 mismatch.";
+        return false;
+      }
+    }
+    // TODO(juliatuttle): Incremental crc32 calculation?
+
+    if (count > 1)
+      std::memcpy(buf, data, range_len);
+    buf += range_len;
   }
-  // TODO(juliatuttle): Incremental crc32 calculation?
 
   return true;
 }
@@ -26,12 +26,14 @@
 namespace net {
 class GrowableIOBuffer;
 class IOBuffer;
+class IOBufferWithSize;
 }
 
 FORWARD_DECLARE_TEST(DiskCacheBackendTest, SimpleCacheEnumerationLongKeys);
 
 namespace disk_cache {
 
+class SimpleFileIO;
 class SimpleSynchronousEntry;
 
 // This class handles the passing of data about the entry between
@@ -81,6 +83,10 @@ struct SimpleEntryCreationResults {
   scoped_refptr<net::GrowableIOBuffer> stream_0_data;
   SimpleEntryStat entry_stat;
   uint32_t stream_0_crc32;
+  // The start of stream 1, if it was read ahead when opening the entry, and
+  // its crc.
+  scoped_refptr<net::IOBufferWithSize> stream_1_read_ahead;
+  uint32_t stream_1_read_ahead_crc32;
   int result;
 };
 
@@ -117,12 +123,15 @@ class SimpleSynchronousEntry {
 
   // Opens a disk cache entry on disk. The |key| parameter is optional, if empty
   // the operation may be slower. The |entry_hash| parameter is required.
-  // |had_index| is provided only for histograms.
+  // |had_index| is provided only for histograms. Up to |read_ahead_size|
+  // bytes of stream 1 are also read, so that the entry can serve them from
+  // memory.
   static void OpenEntry(net::CacheType cache_type,
                         const base::FilePath& path,
                         const std::string& key,
                         uint64_t entry_hash,
                         bool had_index,
+                        int read_ahead_size,
                         SimpleEntryCreationResults* out_results);
 
   static void CreateEntry(net::CacheType cache_type,
@@ -215,6 +224,9 @@ class SimpleSynchronousEntry {
     }
   };
 
+  typedef std::map<int64_t, SparseRange> SparseRangeOffsetMap;
+  typedef SparseRangeOffsetMap::iterator SparseRangeIterator;
+
   // When opening an entry without knowing the key, the header must be read
   // without knowing the size of the key. This is how much to read initially, to
   // make it likely the entire key is read.
@@ -262,6 +274,14 @@ class SimpleSynchronousEntry {
   // |*out_result| on failure.
   bool InitializeCreatedFile(int index, CreateEntryResult* out_result);
 
+  // Reads the first |read_ahead_len| bytes of stream 1 into a new
+  // |out_read_ahead| buffer, and checks the crc of the stream if that is all
+  // of it. Returns a net error, i.e. net::OK on success.
+  int ReadAhead(int read_ahead_len,
+                SimpleEntryStat* entry_stat,
+                scoped_refptr<net::IOBufferWithSize>* out_read_ahead,
+                uint32_t* out_read_ahead_crc32);
+
   // Returns a net error, including net::OK on success and net::FILE_EXISTS
   // when the entry already exists.
   int InitializeForCreate(SimpleEntryStat* out_entry_stat);
@@ -288,7 +308,8 @@ class SimpleSynchronousEntry {
   // Creates and initializes the sparse data file.
   bool CreateSparseFile();
 
-  // Closes the sparse data file.
+  // Closes the sparse data file, after writing the index of its ranges if they
+  // changed.
   void CloseSparseFile();
 
   // Writes the header to the (newly-created) sparse file.
@@ -302,10 +323,27 @@ class SimpleSynchronousEntry {
   // including headers).
   bool ScanSparseFile(int32_t* out_sparse_data_size);
 
-  // Reads from a single sparse range. If asked to read the entire range, also
-  // verifies the CRC32.
-  bool ReadSparseRange(const SparseRange* range,
-                       int offset, int len, char* buf);
+  // Like ScanSparseFile(), from the index at the end of the sparse file, once
+  // its header was checked. Returns false if there is no valid index.
+  bool ReadSparseIndex(int64_t* out_sparse_data_size);
+
+  // Writes the index of |sparse_ranges_| at the end of the sparse file.
+  void WriteSparseIndex();
+
+  // Removes the index from the sparse file, before its ranges change.
+  bool RemoveSparseIndex();
+
+  // Reads from |count| sparse ranges starting at |first|, which follow each
+  // other both in offset and in the sparse file, with a single read: |len|
+  // bytes from |offset| in the first range, the whole of the ranges in
+  // between, and |last_len| bytes from the start of the last one. Verifies the
+  // CRC32 of the ranges read entirely.
+  bool ReadSparseRanges(SparseRangeIterator first,
+                        size_t count,
+                        int offset,
+                        int len,
+                        int last_len,
+                        char* buf);
 
   // Writes to a single (existing) sparse range. If asked to write the entire
   // range, also updates the CRC32; otherwise, invalidates it.
@@ -337,6 +375,9 @@ class SimpleSynchronousEntry {
   const bool had_index_;
   std::string key_;
 
+  // Performs the reads and writes of the entry files. Not owned.
+  SimpleFileIO* const file_io_;
+
   bool have_open_files_;
   bool initialized_;
 
@@ -353,13 +394,16 @@ class SimpleSynchronousEntry {
   // was created to store it.
   bool empty_file_omitted_[kSimpleEntryFileCount];
 
-  typedef std::map<int64_t, SparseRange> SparseRangeOffsetMap;
-  typedef SparseRangeOffsetMap::iterator SparseRangeIterator;
   SparseRangeOffsetMap sparse_ranges_;
   base::File sparse_file_;
   // Offset of the end of the sparse file (where the next sparse range will be
   // written).
   int64_t sparse_tail_offset_;
+  // True if the sparse file has an index of its ranges, or what is left of one,
+  // after |sparse_tail_offset_|.
+  bool sparse_index_on_disk_;
+  // True if the ranges changed since the sparse file was opened.
+  bool sparse_ranges_changed_;
 
   // True if the entry was created, or false if it was opened. Used to log
   // SimpleCache.*.EntryCreatedWithStream2Omitted only for created entries.
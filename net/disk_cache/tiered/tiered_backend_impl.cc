@@ -0,0 +1,469 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/tiered/tiered_backend_impl.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/memory/ptr_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/memory/mem_backend_impl.h"
+#include "net/disk_cache/tiered/tiered_entry_impl.h"
+
+namespace disk_cache {
+
+const base::Feature kDiskCacheMemoryTier{"DiskCacheMemoryTier",
+                                         base::FEATURE_DISABLED_BY_DEFAULT};
+
+// Reads the rest of the streams of an entry of the disk backend, after the
+// data already read through the entry, to copy them to the memory tier. Owns a
+// handle to the entry, closed once the promotion is done or cancelled.
+class TieredBackendImpl::Promotion {
+ public:
+  Promotion(TieredBackendImpl* backend,
+            const std::string& key,
+            Entry* disk_entry,
+            std::vector<std::string>* teed_streams)
+      : backend_(backend),
+        key_(key),
+        disk_entry_(disk_entry),
+        sparse_start_(0),
+        stream_index_(0),
+        weak_factory_(this) {
+    teed_streams_.swap(*teed_streams);
+    teed_streams_.resize(kMemoryTierStreamCount);
+  }
+
+  ~Promotion() { disk_entry_->Close(); }
+
+  const std::string& key() const { return key_; }
+
+  // Returns the data of stream |index|, or null if it is empty.
+  net::IOBufferWithSize* stream(int index) const {
+    return streams_[index].get();
+  }
+
+  // Reads the streams of the entry, and then calls OnPromotionComplete() on
+  // the backend, which deletes this object.
+  void Start() {
+    if (!disk_entry_->CouldBeSparse()) {
+      ReadNextStream();
+      return;
+    }
+    int rv = disk_entry_->GetAvailableRange(
+        0, std::numeric_limits<int32_t>::max(), &sparse_start_,
+        base::Bind(&Promotion::OnSparseDataChecked,
+                   weak_factory_.GetWeakPtr()));
+    if (rv != net::ERR_IO_PENDING)
+      OnSparseDataChecked(rv);
+  }
+
+ private:
+  void OnSparseDataChecked(int result) {
+    // Sparse data is not copied, so the entry has to stay on the disk.
+    if (result > 0) {
+      backend_->OnPromotionComplete(this, false);
+      return;
+    }
+    ReadNextStream();
+  }
+
+  void ReadNextStream() {
+    for (; stream_index_ < kMemoryTierStreamCount; ++stream_index_) {
+      const int size = disk_entry_->GetDataSize(stream_index_);
+      if (!size)
+        continue;
+      const std::string& teed = teed_streams_[stream_index_];
+      const int teed_len = std::min(static_cast<int>(teed.size()), size);
+      streams_[stream_index_] = new net::IOBufferWithSize(size);
+      memcpy(streams_[stream_index_]->data(), teed.data(), teed_len);
+      if (teed_len == size)
+        continue;
+      rest_ = new net::IOBufferWithSize(size - teed_len);
+      int rv = disk_entry_->ReadData(
+          stream_index_, teed_len, rest_.get(), rest_->size(),
+          base::Bind(&Promotion::OnStreamRead, weak_factory_.GetWeakPtr()));
+      if (rv == net::ERR_IO_PENDING)
+        return;
+      if (!DidReadStream(rv)) {
+        backend_->OnPromotionComplete(this, false);
+        return;
+      }
+    }
+    backend_->OnPromotionComplete(this, true);
+  }
+
+  void OnStreamRead(int result) {
+    if (!DidReadStream(result)) {
+      backend_->OnPromotionComplete(this, false);
+      return;
+    }
+    ++stream_index_;
+    ReadNextStream();
+  }
+
+  // Copies the rest of the current stream after the data teed, once read.
+  bool DidReadStream(int result) {
+    if (result != rest_->size())
+      return false;
+    net::IOBufferWithSize* stream = streams_[stream_index_].get();
+    memcpy(stream->data() + stream->size() - result, rest_->data(), result);
+    rest_ = nullptr;
+    return true;
+  }
+
+  TieredBackendImpl* const backend_;
+  const std::string key_;
+  Entry* const disk_entry_;
+  int64_t sparse_start_;
+  int stream_index_;
+  std::vector<std::string> teed_streams_;
+  scoped_refptr<net::IOBufferWithSize> streams_[kMemoryTierStreamCount];
+  // The rest of the current stream, while it is read.
+  scoped_refptr<net::IOBufferWithSize> rest_;
+
+  base::WeakPtrFactory<Promotion> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(Promotion);
+};
+
+class TieredBackendImpl::TieredIterator final : public Backend::Iterator {
+ public:
+  TieredIterator(base::WeakPtr<TieredBackendImpl> backend,
+                 std::unique_ptr<Backend::Iterator> iterator)
+      : backend_(backend),
+        iterator_(std::move(iterator)),
+        weak_factory_(this) {}
+
+  // From Backend::Iterator:
+  int OpenNextEntry(Entry** next_entry,
+                    const CompletionCallback& callback) override {
+    // The disk backend holds all the entries.
+    Entry** disk_entry = new Entry*(nullptr);
+    CompletionCallback disk_callback = base::Bind(
+        &TieredIterator::OnDiskEntryOpened, weak_factory_.GetWeakPtr(),
+        base::Owned(disk_entry), next_entry, callback);
+    int rv = iterator_->OpenNextEntry(disk_entry, disk_callback);
+    if (rv == net::ERR_IO_PENDING)
+      return rv;
+    return WrapEntry(rv, *disk_entry, next_entry);
+  }
+
+ private:
+  int WrapEntry(int result, Entry* disk_entry, Entry** next_entry) {
+    if (result != net::OK)
+      return result;
+    if (!backend_) {
+      disk_entry->Close();
+      return net::ERR_FAILED;
+    }
+    return backend_->WrapDiskEntry(result, disk_entry, false, next_entry);
+  }
+
+  void OnDiskEntryOpened(Entry** disk_entry,
+                         Entry** next_entry,
+                         const CompletionCallback& callback,
+                         int result) {
+    callback.Run(WrapEntry(result, *disk_entry, next_entry));
+  }
+
+  base::WeakPtr<TieredBackendImpl> backend_;
+  std::unique_ptr<Backend::Iterator> iterator_;
+  base::WeakPtrFactory<TieredIterator> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(TieredIterator);
+};
+
+TieredBackendImpl::TieredBackendImpl(std::unique_ptr<Backend> backend,
+                                     int memory_size,
+                                     net::NetLog* net_log)
+    : backend_(std::move(backend)),
+      memory_backend_(new MemBackendImpl(net_log)),
+      memory_size_(memory_size),
+      memory_hit_count_(0),
+      disk_hit_count_(0),
+      weak_factory_(this) {
+  DCHECK(backend_);
+  DCHECK_GT(memory_size_, 0);
+  memory_backend_->SetMaxSize(memory_size_);
+  bool initialized = memory_backend_->Init();
+  DCHECK(initialized);
+  memory_pressure_listener_.reset(new base::MemoryPressureListener(
+      base::Bind(&TieredBackendImpl::OnMemoryPressure,
+                 base::Unretained(this))));
+}
+
+TieredBackendImpl::~TieredBackendImpl() {}
+
+void TieredBackendImpl::OnEntryClosed(TieredEntryImpl* entry) {
+  auto it = active_entries_.find(entry->GetKey());
+  if (it != active_entries_.end() && it->second == entry)
+    active_entries_.erase(it);
+}
+
+void TieredBackendImpl::OnEntryDoomed(TieredEntryImpl* entry) {
+  OnEntryClosed(entry);
+  DoomMemoryEntry(entry->GetKey());
+}
+
+void TieredBackendImpl::DoomMemoryEntry(const std::string& key) {
+  promotions_.erase(key);
+  memory_backend_->DoomEntry(key, CompletionCallback());
+}
+
+bool TieredBackendImpl::CanPromote(Entry* disk_entry) const {
+  int64_t size = 0;
+  for (int i = 0; i < kMemoryTierStreamCount; ++i)
+    size += disk_entry->GetDataSize(i);
+  return size <= memory_backend_->MaxFileSize();
+}
+
+void TieredBackendImpl::PromoteEntry(const std::string& key,
+                                     Entry* disk_entry,
+                                     std::vector<std::string>* teed_streams) {
+  if (!CanPromote(disk_entry) || promotions_.count(key)) {
+    disk_entry->Close();
+    return;
+  }
+  Promotion* promotion = new Promotion(this, key, disk_entry, teed_streams);
+  promotions_[key] = base::WrapUnique(promotion);
+  promotion->Start();
+}
+
+net::CacheType TieredBackendImpl::GetCacheType() const {
+  return backend_->GetCacheType();
+}
+
+int32_t TieredBackendImpl::GetEntryCount() const {
+  // The memory tier holds copies of entries of the disk backend, and those of
+  // the entries it evicted are dropped before they are hit.
+  return backend_->GetEntryCount();
+}
+
+int TieredBackendImpl::OpenEntry(const std::string& key,
+                                 Entry** entry,
+                                 const CompletionCallback& callback) {
+  return OpenEntryWithReadAhead(key, 0, entry, callback);
+}
+
+int TieredBackendImpl::OpenEntryWithReadAhead(
+    const std::string& key,
+    int read_ahead_size,
+    Entry** entry,
+    const CompletionCallback& callback) {
+  auto it = active_entries_.find(key);
+  if (it != active_entries_.end()) {
+    it->second->Open();
+    *entry = it->second;
+    return net::OK;
+  }
+
+  Entry* memory_entry = nullptr;
+  if (memory_backend_->OpenEntry(key, &memory_entry, CompletionCallback()) ==
+      net::OK) {
+    if (!backend_->MayHaveEntry(key)) {
+      // The copy outlived its entry on the disk.
+      memory_entry->Doom();
+      memory_entry->Close();
+      return net::ERR_FAILED;
+    }
+    ++memory_hit_count_;
+    // Keeps the disk backend from evicting the entries hit the most.
+    backend_->OnExternalCacheHit(key);
+    *entry = NewEntry(key, nullptr, memory_entry, false);
+    return net::OK;
+  }
+
+  Entry** disk_entry = new Entry*(nullptr);
+  CompletionCallback disk_callback = base::Bind(
+      &TieredBackendImpl::OnDiskEntryOpened, weak_factory_.GetWeakPtr(),
+      base::Owned(disk_entry), true, entry, callback);
+  int rv = backend_->OpenEntryWithReadAhead(key, read_ahead_size, disk_entry,
+                                            disk_callback);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return WrapDiskEntry(rv, *disk_entry, true, entry);
+}
+
+int TieredBackendImpl::CreateEntry(const std::string& key,
+                                   Entry** entry,
+                                   const CompletionCallback& callback) {
+  // The entry may only be in the memory tier, if the disk backend evicted it
+  // while it was open.
+  if (active_entries_.count(key))
+    return net::ERR_FAILED;
+  DoomMemoryEntry(key);
+
+  Entry** disk_entry = new Entry*(nullptr);
+  CompletionCallback disk_callback = base::Bind(
+      &TieredBackendImpl::OnDiskEntryOpened, weak_factory_.GetWeakPtr(),
+      base::Owned(disk_entry), false, entry, callback);
+  int rv = backend_->CreateEntry(key, disk_entry, disk_callback);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return WrapDiskEntry(rv, *disk_entry, false, entry);
+}
+
+int TieredBackendImpl::DoomEntry(const std::string& key,
+                                 const CompletionCallback& callback) {
+  auto it = active_entries_.find(key);
+  if (it != active_entries_.end()) {
+    it->second->Doom();
+    return net::OK;
+  }
+  DoomMemoryEntry(key);
+  return backend_->DoomEntry(key, callback);
+}
+
+int TieredBackendImpl::DoomAllEntries(const CompletionCallback& callback) {
+  DetachAllEntries();
+  memory_backend_->DoomAllEntries(CompletionCallback());
+  return backend_->DoomAllEntries(callback);
+}
+
+int TieredBackendImpl::DoomEntriesBetween(base::Time initial_time,
+                                          base::Time end_time,
+                                          const CompletionCallback& callback) {
+  // The copies in the memory tier are used at other times than their entries
+  // on the disk, so they are all doomed.
+  DetachAllEntries();
+  memory_backend_->DoomAllEntries(CompletionCallback());
+  return backend_->DoomEntriesBetween(initial_time, end_time, callback);
+}
+
+int TieredBackendImpl::DoomEntriesSince(base::Time initial_time,
+                                        const CompletionCallback& callback) {
+  DetachAllEntries();
+  memory_backend_->DoomAllEntries(CompletionCallback());
+  return backend_->DoomEntriesSince(initial_time, callback);
+}
+
+int TieredBackendImpl::CalculateSizeOfAllEntries(
+    const CompletionCallback& callback) {
+  return backend_->CalculateSizeOfAllEntries(callback);
+}
+
+std::unique_ptr<Backend::Iterator> TieredBackendImpl::CreateIterator() {
+  return std::unique_ptr<Backend::Iterator>(new TieredIterator(
+      weak_factory_.GetWeakPtr(), backend_->CreateIterator()));
+}
+
+void TieredBackendImpl::GetStats(base::StringPairs* stats) {
+  backend_->GetStats(stats);
+  stats->push_back(std::make_pair(
+      "Memory tier entries",
+      base::IntToString(memory_backend_->GetEntryCount())));
+  stats->push_back(std::make_pair("Memory tier hits",
+                                  base::Int64ToString(memory_hit_count_)));
+  stats->push_back(std::make_pair("Disk tier hits",
+                                  base::Int64ToString(disk_hit_count_)));
+}
+
+void TieredBackendImpl::OnExternalCacheHit(const std::string& key) {
+  memory_backend_->OnExternalCacheHit(key);
+  backend_->OnExternalCacheHit(key);
+}
+
+bool TieredBackendImpl::MayHaveEntry(const std::string& key) const {
+  // The disk backend holds all the entries.
+  return backend_->MayHaveEntry(key);
+}
+
+int TieredBackendImpl::WrapDiskEntry(int result,
+                                     Entry* disk_entry,
+                                     bool promotable,
+                                     Entry** out_entry) {
+  if (result != net::OK)
+    return result;
+  const std::string key = disk_entry->GetKey();
+  auto it = active_entries_.find(key);
+  if (it != active_entries_.end()) {
+    // The entry was opened again while the disk backend opened it.
+    disk_entry->Close();
+    it->second->Open();
+    *out_entry = it->second;
+    return net::OK;
+  }
+  if (promotable)
+    ++disk_hit_count_;
+  *out_entry = NewEntry(key, disk_entry, nullptr,
+                        promotable && CanPromote(disk_entry));
+  return net::OK;
+}
+
+void TieredBackendImpl::OnDiskEntryOpened(Entry** disk_entry,
+                                          bool promotable,
+                                          Entry** out_entry,
+                                          const CompletionCallback& callback,
+                                          int result) {
+  callback.Run(WrapDiskEntry(result, *disk_entry, promotable, out_entry));
+}
+
+TieredEntryImpl* TieredBackendImpl::NewEntry(const std::string& key,
+                                            Entry* disk_entry,
+                                            Entry* memory_entry,
+                                            bool promotable) {
+  TieredEntryImpl* entry =
+      new TieredEntryImpl(weak_factory_.GetWeakPtr(), key, disk_entry,
+                          memory_entry, promotable);
+  entry->Open();
+  active_entries_[key] = entry;
+  return entry;
+}
+
+void TieredBackendImpl::OnPromotionComplete(Promotion* promotion,
+                                            bool succeeded) {
+  const std::string key = promotion->key();
+  Entry* memory_entry = nullptr;
+  if (succeeded && memory_backend_->CreateEntry(key, &memory_entry,
+                                                CompletionCallback()) ==
+                       net::OK) {
+    for (int i = 0; i < kMemoryTierStreamCount; ++i) {
+      net::IOBufferWithSize* stream = promotion->stream(i);
+      if (!stream)
+        continue;
+      if (memory_entry->WriteData(i, 0, stream, stream->size(),
+                                  CompletionCallback(),
+                                  true) != stream->size()) {
+        memory_entry->Doom();
+        break;
+      }
+    }
+    memory_entry->Close();
+  }
+  // Closes the handle to the entry of the disk backend.
+  promotions_.erase(key);
+}
+
+void TieredBackendImpl::DetachAllEntries() {
+  // The entries still open keep working, but are no longer shared with the
+  // next opens.
+  active_entries_.clear();
+  promotions_.clear();
+}
+
+void TieredBackendImpl::OnMemoryPressure(
+    base::MemoryPressureListener::MemoryPressureLevel memory_pressure_level) {
+  switch (memory_pressure_level) {
+    case base::MemoryPressureListener::MEMORY_PRESSURE_LEVEL_NONE:
+      break;
+    case base::MemoryPressureListener::MEMORY_PRESSURE_LEVEL_MODERATE:
+      memory_backend_->EvictTo(memory_size_ / 2);
+      break;
+    case base::MemoryPressureListener::MEMORY_PRESSURE_LEVEL_CRITICAL:
+      promotions_.clear();
+      memory_backend_->EvictTo(0);
+      break;
+  }
+}
+
+}  // namespace disk_cache
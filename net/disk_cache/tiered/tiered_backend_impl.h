@@ -0,0 +1,182 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_TIERED_TIERED_BACKEND_IMPL_H_
+#define NET_DISK_CACHE_TIERED_TIERED_BACKEND_IMPL_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "base/feature_list.h"
+#include "base/macros.h"
+#include "base/memory/memory_pressure_listener.h"
+#include "base/memory/weak_ptr.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace net {
+class NetLog;
+}
+
+namespace disk_cache {
+
+class MemBackendImpl;
+class TieredEntryImpl;
+
+// Makes CreateCacheBackend() keep copies of the disk cache entries that are
+// hit in memory, with a TieredBackendImpl.
+NET_EXPORT_PRIVATE extern const base::Feature kDiskCacheMemoryTier;
+
+// The size of the memory tier of the backends created by CreateCacheBackend().
+const int kDefaultMemoryTierSize = 16 * 1024 * 1024;
+
+// The streams copied to the memory tier: those of the HTTP cache.
+const int kMemoryTierStreamCount = 3;
+
+// This class implements the Backend interface on top of a disk backend, with a
+// bounded memory tier, a MemBackendImpl, in front of it.
+//
+// The disk backend holds every entry, and the memory tier copies of the
+// streams of the entries hit the most recently. An entry opened from the disk
+// is copied to the memory tier once its last handle is closed, if it is small
+// enough: the data read through the entry is kept as it is read, and only the
+// rest of the streams is read from the disk then. The next opens are read
+// from memory, without opening the entry of the disk backend, unless they
+// write. The hits in memory are reported to the disk backend, which may still
+// evict the entry: its copy is then a miss once Backend::MayHaveEntry() tells
+// it is gone, or dropped once the open for a write fails. Writes go to the
+// disk backend and drop the copy, so that both tiers never disagree. The
+// memory tier evicts its least recently used copies as it fills up, which
+// demotes them to the disk backend, where they already are.
+//
+// Sparse data is not copied: entries that have sparse data stay on the disk.
+//
+// The memory tier is evicted down to half its size on moderate memory
+// pressure, and emptied on critical memory pressure.
+class NET_EXPORT_PRIVATE TieredBackendImpl final : public Backend {
+ public:
+  // Fronts |backend| with a memory tier of |memory_size| bytes.
+  TieredBackendImpl(std::unique_ptr<Backend> backend,
+                    int memory_size,
+                    net::NetLog* net_log);
+  ~TieredBackendImpl() override;
+
+  Backend* wrapped_backend() const { return backend_.get(); }
+  MemBackendImpl* memory_backend() const { return memory_backend_.get(); }
+
+  int64_t memory_hit_count() const { return memory_hit_count_; }
+  int64_t disk_hit_count() const { return disk_hit_count_; }
+
+  // Called by TieredEntryImpl.
+  void OnEntryClosed(TieredEntryImpl* entry);
+  void OnEntryDoomed(TieredEntryImpl* entry);
+
+  // Called by TieredEntryImpl when the entry of |key| is about to change on
+  // the disk: drops its copy from the memory tier.
+  void DoomMemoryEntry(const std::string& key);
+
+  // Returns whether the streams of |disk_entry| fit in the memory tier.
+  bool CanPromote(Entry* disk_entry) const;
+
+  // Called by TieredEntryImpl when its last handle is closed, with the handle
+  // to |disk_entry| it opened from the disk backend, and the data it read
+  // from the start of each stream, |teed_streams|: copies the streams of the
+  // entry to the memory tier, reading only the rest of them, and then closes
+  // |disk_entry|.
+  void PromoteEntry(const std::string& key,
+                    Entry* disk_entry,
+                    std::vector<std::string>* teed_streams);
+
+  // Backend implementation.
+  net::CacheType GetCacheType() const override;
+  int32_t GetEntryCount() const override;
+  int OpenEntry(const std::string& key,
+                Entry** entry,
+                const CompletionCallback& callback) override;
+  int OpenEntryWithReadAhead(const std::string& key,
+                             int read_ahead_size,
+                             Entry** entry,
+                             const CompletionCallback& callback) override;
+  int CreateEntry(const std::string& key,
+                  Entry** entry,
+                  const CompletionCallback& callback) override;
+  int DoomEntry(const std::string& key,
+                const CompletionCallback& callback) override;
+  int DoomAllEntries(const CompletionCallback& callback) override;
+  int DoomEntriesBetween(base::Time initial_time,
+                         base::Time end_time,
+                         const CompletionCallback& callback) override;
+  int DoomEntriesSince(base::Time initial_time,
+                       const CompletionCallback& callback) override;
+  int CalculateSizeOfAllEntries(const CompletionCallback& callback) override;
+  std::unique_ptr<Iterator> CreateIterator() override;
+  void GetStats(base::StringPairs* stats) override;
+  void OnExternalCacheHit(const std::string& key) override;
+  bool MayHaveEntry(const std::string& key) const override;
+
+ private:
+  class Promotion;
+  class TieredIterator;
+
+  // Completes an open or create of |disk_entry| in the disk backend, which
+  // returned |result|: returns the entry wrapping it to |out_entry|. An entry
+  // |promotable| is copied to the memory tier once closed. Returns a net error
+  // code.
+  int WrapDiskEntry(int result,
+                    Entry* disk_entry,
+                    bool promotable,
+                    Entry** out_entry);
+
+  void OnDiskEntryOpened(Entry** disk_entry,
+                         bool promotable,
+                         Entry** out_entry,
+                         const CompletionCallback& callback,
+                         int result);
+
+  // Returns a new handle to the entry of |key|, which wraps |disk_entry| or
+  // |memory_entry|.
+  TieredEntryImpl* NewEntry(const std::string& key,
+                            Entry* disk_entry,
+                            Entry* memory_entry,
+                            bool promotable);
+
+  // Called once |promotion| read the streams of its entry, or failed to.
+  void OnPromotionComplete(Promotion* promotion, bool succeeded);
+
+  // Forgets the active entries, and cancels the promotions, for entries doomed
+  // in bulk.
+  void DetachAllEntries();
+
+  void OnMemoryPressure(
+      base::MemoryPressureListener::MemoryPressureLevel memory_pressure_level);
+
+  std::unique_ptr<Backend> backend_;
+  std::unique_ptr<MemBackendImpl> memory_backend_;
+  const int memory_size_;
+
+  // The entries with open handles, by key.
+  std::unordered_map<std::string, TieredEntryImpl*> active_entries_;
+
+  // The entries being copied to the memory tier, by key.
+  std::unordered_map<std::string, std::unique_ptr<Promotion>> promotions_;
+
+  int64_t memory_hit_count_;
+  int64_t disk_hit_count_;
+
+  std::unique_ptr<base::MemoryPressureListener> memory_pressure_listener_;
+
+  base::WeakPtrFactory<TieredBackendImpl> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(TieredBackendImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_TIERED_TIERED_BACKEND_IMPL_H_
@@ -0,0 +1,432 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/tiered/tiered_backend_impl.h"
+
+#include <memory>
+#include <string>
+
+#include "base/memory/memory_pressure_listener.h"
+#include "base/run_loop.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/disk_cache_test_base.h"
+#include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/memory/mem_backend_impl.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+const int kHeadersIndex = 0;
+const int kBodyIndex = 1;
+const int kMemorySize = 1024 * 1024;
+
+std::string MakeData(int size) {
+  std::string data(size, '\0');
+  CacheTestFillBuffer(&data[0], size, false);
+  return data;
+}
+
+class TieredBackendTest : public DiskCacheTestWithCache {
+ protected:
+  void InitTieredCache() {
+    SetSimpleCacheMode();
+    SetTieredCacheMode(kMemorySize);
+    InitCache();
+  }
+
+  Backend* disk_backend() const {
+    return tiered_cache_impl_->wrapped_backend();
+  }
+
+  int32_t GetMemoryEntryCount() const {
+    return tiered_cache_impl_->memory_backend()->GetEntryCount();
+  }
+
+  Entry* CreateEntry(const std::string& key) {
+    Entry* entry = nullptr;
+    EXPECT_EQ(net::OK, DiskCacheTestWithCache::CreateEntry(key, &entry));
+    return entry;
+  }
+
+  Entry* OpenEntry(const std::string& key) {
+    Entry* entry = nullptr;
+    if (DiskCacheTestWithCache::OpenEntry(key, &entry) != net::OK)
+      return nullptr;
+    return entry;
+  }
+
+  // Dooms the entry of |key| in the disk backend only, like its eviction.
+  void EvictEntry(const std::string& key) {
+    net::TestCompletionCallback cb;
+    EXPECT_EQ(net::OK,
+              cb.GetResult(disk_backend()->DoomEntry(key, cb.callback())));
+    RunUntilIdle();
+  }
+
+  int WriteStream(Entry* entry, int index, const std::string& data) {
+    scoped_refptr<net::StringIOBuffer> buffer(new net::StringIOBuffer(data));
+    return WriteData(entry, index, 0, buffer.get(), data.size(), true);
+  }
+
+  std::string ReadStream(Entry* entry, int index) {
+    const int size = entry->GetDataSize(index);
+    scoped_refptr<net::IOBufferWithSize> buffer(
+        new net::IOBufferWithSize(size));
+    int rv = ReadData(entry, index, 0, buffer.get(), size);
+    if (rv < 0)
+      return std::string();
+    return std::string(buffer->data(), rv);
+  }
+
+  // Runs the operations of the simple cache, like the reads of the entries
+  // copied to the memory tier once closed, which take a few round trips to the
+  // worker pool.
+  void RunUntilIdle() {
+    for (int i = 0; i < 3; ++i) {
+      base::RunLoop().RunUntilIdle();
+      SimpleBackendImpl::FlushWorkerPoolForTesting();
+    }
+    base::RunLoop().RunUntilIdle();
+  }
+
+  void CreateEntryWithBody(const std::string& key, const std::string& body) {
+    Entry* entry = CreateEntry(key);
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(static_cast<int>(key.size()),
+              WriteStream(entry, kHeadersIndex, key));
+    EXPECT_EQ(static_cast<int>(body.size()),
+              WriteStream(entry, kBodyIndex, body));
+    entry->Close();
+    RunUntilIdle();
+  }
+
+  std::string GetBody(const std::string& key) {
+    Entry* entry = OpenEntry(key);
+    if (!entry)
+      return std::string();
+    EXPECT_EQ(key, ReadStream(entry, kHeadersIndex));
+    std::string body = ReadStream(entry, kBodyIndex);
+    entry->Close();
+    RunUntilIdle();
+    return body;
+  }
+};
+
+}  // namespace
+
+TEST_F(TieredBackendTest, PromoteOnHit) {
+  InitTieredCache();
+  const std::string kBody = MakeData(10000);
+  CreateEntryWithBody("a", kBody);
+  EXPECT_EQ(0, GetMemoryEntryCount());
+
+  EXPECT_EQ(kBody, GetBody("a"));
+  EXPECT_EQ(1, tiered_cache_impl_->disk_hit_count());
+  EXPECT_EQ(0, tiered_cache_impl_->memory_hit_count());
+  EXPECT_EQ(1, GetMemoryEntryCount());
+
+  EXPECT_EQ(kBody, GetBody("a"));
+  EXPECT_EQ(1, tiered_cache_impl_->disk_hit_count());
+  EXPECT_EQ(1, tiered_cache_impl_->memory_hit_count());
+  EXPECT_EQ(1, cache_->GetEntryCount());
+}
+
+// Only the data not read through the entry is read again to promote it.
+TEST_F(TieredBackendTest, PromotePartiallyReadEntry) {
+  InitTieredCache();
+  const std::string kBody = MakeData(10000);
+  CreateEntryWithBody("a", kBody);
+
+  Entry* entry = OpenEntry("a");
+  ASSERT_TRUE(entry);
+  scoped_refptr<net::IOBufferWithSize> buffer(new net::IOBufferWithSize(3000));
+  EXPECT_EQ(3000, ReadData(entry, kBodyIndex, 0, buffer.get(), 3000));
+  EXPECT_EQ(3000, ReadData(entry, kBodyIndex, 2000, buffer.get(), 3000));
+  entry->Close();
+  RunUntilIdle();
+  EXPECT_EQ(1, GetMemoryEntryCount());
+
+  EXPECT_EQ(kBody, GetBody("a"));
+  EXPECT_EQ(1, tiered_cache_impl_->memory_hit_count());
+}
+
+TEST_F(TieredBackendTest, OpenTwice) {
+  InitTieredCache();
+  CreateEntryWithBody("a", MakeData(1000));
+  EXPECT_FALSE(GetBody("a").empty());
+
+  Entry* entry1 = OpenEntry("a");
+  Entry* entry2 = OpenEntry("a");
+  ASSERT_TRUE(entry1);
+  EXPECT_EQ(entry1, entry2);
+  EXPECT_EQ(1, tiered_cache_impl_->memory_hit_count());
+  entry1->Close();
+  entry2->Close();
+}
+
+TEST_F(TieredBackendTest, WriteDropsMemoryCopy) {
+  InitTieredCache();
+  const std::string kBody = MakeData(10000);
+  const std::string kNewBody = MakeData(5000);
+  CreateEntryWithBody("a", kBody);
+  EXPECT_EQ(kBody, GetBody("a"));
+  EXPECT_EQ(1, GetMemoryEntryCount());
+
+  Entry* entry = OpenEntry("a");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(1, tiered_cache_impl_->memory_hit_count());
+  EXPECT_EQ(static_cast<int>(kNewBody.size()),
+            WriteStream(entry, kBodyIndex, kNewBody));
+  EXPECT_EQ(0, GetMemoryEntryCount());
+  EXPECT_EQ(kNewBody, ReadStream(entry, kBodyIndex));
+  EXPECT_EQ("a", ReadStream(entry, kHeadersIndex));
+  entry->Close();
+  RunUntilIdle();
+
+  // The written entry is on the disk, and is promoted again once hit.
+  EXPECT_EQ(0, GetMemoryEntryCount());
+  EXPECT_EQ(kNewBody, GetBody("a"));
+  EXPECT_EQ(2, tiered_cache_impl_->disk_hit_count());
+  EXPECT_EQ(1, GetMemoryEntryCount());
+  EXPECT_EQ(kNewBody, GetBody("a"));
+  EXPECT_EQ(2, tiered_cache_impl_->memory_hit_count());
+}
+
+// The operations of an entry opened from the memory tier wait for its entry
+// of the disk backend from the first write on.
+TEST_F(TieredBackendTest, WriteWhileOpeningDiskEntry) {
+  InitTieredCache();
+  const std::string kBody = MakeData(10000);
+  const std::string kNewBody = MakeData(5000);
+  CreateEntryWithBody("a", kBody);
+  EXPECT_EQ(kBody, GetBody("a"));
+
+  Entry* entry = OpenEntry("a");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(1, tiered_cache_impl_->memory_hit_count());
+
+  // Reads are served from the memory tier meanwhile.
+  scoped_refptr<net::IOBufferWithSize> read_buffer(
+      new net::IOBufferWithSize(kBody.size()));
+  net::TestCompletionCallback read_cb;
+  EXPECT_EQ(static_cast<int>(kBody.size()),
+            entry->ReadData(kBodyIndex, 0, read_buffer.get(), kBody.size(),
+                            read_cb.callback()));
+
+  scoped_refptr<net::StringIOBuffer> write_buffer(
+      new net::StringIOBuffer(kNewBody));
+  net::TestCompletionCallback write_cb;
+  EXPECT_EQ(net::ERR_IO_PENDING,
+            entry->WriteData(kBodyIndex, 0, write_buffer.get(),
+                             kNewBody.size(), write_cb.callback(), true));
+  read_buffer = new net::IOBufferWithSize(kNewBody.size());
+  EXPECT_EQ(net::ERR_IO_PENDING,
+            entry->ReadData(kBodyIndex, 0, read_buffer.get(), kNewBody.size(),
+                            read_cb.callback()));
+  EXPECT_EQ(static_cast<int>(kNewBody.size()), write_cb.WaitForResult());
+  EXPECT_EQ(static_cast<int>(kNewBody.size()), read_cb.WaitForResult());
+  EXPECT_EQ(kNewBody, std::string(read_buffer->data(), kNewBody.size()));
+  EXPECT_EQ(0, GetMemoryEntryCount());
+  entry->Close();
+  RunUntilIdle();
+
+  EXPECT_EQ(kNewBody, GetBody("a"));
+}
+
+TEST_F(TieredBackendTest, WriteDuringPromotion) {
+  InitTieredCache();
+  const std::string kBody = MakeData(10000);
+  const std::string kNewBody = MakeData(5000);
+  CreateEntryWithBody("a", kBody);
+
+  // Closing the entry starts its promotion, which reads it in the background.
+  Entry* entry = OpenEntry("a");
+  ASSERT_TRUE(entry);
+  entry->Close();
+
+  // Whether the promotion completes before the write or not, the write drops
+  // the copy of the entry.
+  entry = OpenEntry("a");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(static_cast<int>(kNewBody.size()),
+            WriteStream(entry, kBodyIndex, kNewBody));
+  entry->Close();
+  RunUntilIdle();
+  EXPECT_EQ(0, GetMemoryEntryCount());
+
+  EXPECT_EQ(kNewBody, GetBody("a"));
+  EXPECT_EQ(1, GetMemoryEntryCount());
+  EXPECT_EQ(kNewBody, GetBody("a"));
+  EXPECT_EQ(1, tiered_cache_impl_->memory_hit_count());
+}
+
+TEST_F(TieredBackendTest, EvictedFromDisk) {
+  InitTieredCache();
+  CreateEntryWithBody("a", MakeData(1000));
+  CreateEntryWithBody("b", MakeData(1000));
+  EXPECT_FALSE(GetBody("a").empty());
+  EXPECT_FALSE(GetBody("b").empty());
+  EXPECT_EQ(2, GetMemoryEntryCount());
+
+  EvictEntry("a");
+  EXPECT_EQ(1, cache_->GetEntryCount());
+
+  // The copy of the evicted entry is dropped once hit, which is a miss.
+  EXPECT_FALSE(OpenEntry("a"));
+  EXPECT_EQ(1, GetMemoryEntryCount());
+  EXPECT_EQ(0, tiered_cache_impl_->memory_hit_count());
+  EXPECT_EQ(1, cache_->GetEntryCount());
+
+  // The entry can be stored again.
+  const std::string kBody = MakeData(1000);
+  CreateEntryWithBody("a", kBody);
+  EXPECT_EQ(kBody, GetBody("a"));
+  EXPECT_EQ(2, cache_->GetEntryCount());
+}
+
+// An entry opened from the memory tier only opens its entry of the disk
+// backend to write: once evicted from the disk, it can still be read, but not
+// written.
+TEST_F(TieredBackendTest, EvictedFromDiskWhileOpen) {
+  InitTieredCache();
+  const std::string kBody = MakeData(1000);
+  CreateEntryWithBody("a", kBody);
+  EXPECT_EQ(kBody, GetBody("a"));
+
+  Entry* entry = OpenEntry("a");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(1, tiered_cache_impl_->memory_hit_count());
+  EvictEntry("a");
+  EXPECT_EQ(kBody, ReadStream(entry, kBodyIndex));
+  EXPECT_EQ(net::ERR_FAILED, WriteStream(entry, kBodyIndex, kBody));
+  EXPECT_EQ(0, GetMemoryEntryCount());
+  entry->Close();
+  RunUntilIdle();
+  EXPECT_FALSE(OpenEntry("a"));
+}
+
+TEST_F(TieredBackendTest, LargeEntryNotPromoted) {
+  InitTieredCache();
+  const std::string kBody =
+      MakeData(tiered_cache_impl_->memory_backend()->MaxFileSize() + 1);
+  CreateEntryWithBody("a", kBody);
+  EXPECT_EQ(kBody, GetBody("a"));
+  EXPECT_EQ(kBody, GetBody("a"));
+  EXPECT_EQ(0, GetMemoryEntryCount());
+  EXPECT_EQ(2, tiered_cache_impl_->disk_hit_count());
+}
+
+TEST_F(TieredBackendTest, SparseEntryNotPromoted) {
+  InitTieredCache();
+  const std::string kData = MakeData(1000);
+  Entry* entry = CreateEntry("a");
+  ASSERT_TRUE(entry);
+  scoped_refptr<net::StringIOBuffer> buffer(new net::StringIOBuffer(kData));
+  EXPECT_EQ(static_cast<int>(kData.size()),
+            WriteSparseData(entry, 0, buffer.get(), kData.size()));
+  entry->Close();
+  RunUntilIdle();
+
+  entry = OpenEntry("a");
+  ASSERT_TRUE(entry);
+  EXPECT_TRUE(entry->CouldBeSparse());
+  entry->Close();
+  RunUntilIdle();
+  EXPECT_EQ(0, GetMemoryEntryCount());
+}
+
+TEST_F(TieredBackendTest, DoomEntry) {
+  InitTieredCache();
+  CreateEntryWithBody("a", MakeData(1000));
+  EXPECT_FALSE(GetBody("a").empty());
+  EXPECT_EQ(1, GetMemoryEntryCount());
+
+  EXPECT_EQ(net::OK, DiskCacheTestWithCache::DoomEntry("a"));
+  EXPECT_EQ(0, GetMemoryEntryCount());
+  EXPECT_EQ(0, disk_backend()->GetEntryCount());
+  EXPECT_FALSE(OpenEntry("a"));
+}
+
+TEST_F(TieredBackendTest, DoomMemoryHit) {
+  InitTieredCache();
+  CreateEntryWithBody("a", MakeData(1000));
+  EXPECT_FALSE(GetBody("a").empty());
+
+  Entry* entry = OpenEntry("a");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(1, tiered_cache_impl_->memory_hit_count());
+  entry->Doom();
+  entry->Close();
+  RunUntilIdle();
+  EXPECT_EQ(0, GetMemoryEntryCount());
+  EXPECT_EQ(0, disk_backend()->GetEntryCount());
+}
+
+TEST_F(TieredBackendTest, DoomAllEntries) {
+  InitTieredCache();
+  CreateEntryWithBody("a", MakeData(1000));
+  CreateEntryWithBody("b", MakeData(1000));
+  EXPECT_FALSE(GetBody("a").empty());
+  EXPECT_EQ(1, GetMemoryEntryCount());
+
+  EXPECT_EQ(net::OK, DiskCacheTestWithCache::DoomAllEntries());
+  EXPECT_EQ(0, GetMemoryEntryCount());
+  EXPECT_EQ(0, cache_->GetEntryCount());
+  EXPECT_FALSE(OpenEntry("a"));
+}
+
+TEST_F(TieredBackendTest, MemoryPressure) {
+  InitTieredCache();
+  const int kEntryCount = 8;
+  const std::string kBody = MakeData(100 * 1024);
+  for (int i = 0; i < kEntryCount; ++i) {
+    const std::string key(1, 'a' + i);
+    CreateEntryWithBody(key, kBody);
+    EXPECT_EQ(kBody, GetBody(key));
+  }
+  EXPECT_EQ(kEntryCount, GetMemoryEntryCount());
+
+  // Moderate pressure halves the memory tier.
+  base::MemoryPressureListener::NotifyMemoryPressure(
+      base::MemoryPressureListener::MEMORY_PRESSURE_LEVEL_MODERATE);
+  base::RunLoop().RunUntilIdle();
+  EXPECT_LT(0, GetMemoryEntryCount());
+  EXPECT_GT(kEntryCount, GetMemoryEntryCount());
+
+  // Critical pressure empties it.
+  base::MemoryPressureListener::NotifyMemoryPressure(
+      base::MemoryPressureListener::MEMORY_PRESSURE_LEVEL_CRITICAL);
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(0, GetMemoryEntryCount());
+
+  // The entries are still on the disk.
+  EXPECT_EQ(kEntryCount, cache_->GetEntryCount());
+  EXPECT_EQ(kBody, GetBody("a"));
+}
+
+TEST_F(TieredBackendTest, Iterator) {
+  InitTieredCache();
+  const std::string kBody = MakeData(1000);
+  CreateEntryWithBody("a", kBody);
+
+  std::unique_ptr<TestIterator> iter = CreateIterator();
+  Entry* entry = nullptr;
+  ASSERT_EQ(net::OK, iter->OpenNextEntry(&entry));
+  EXPECT_EQ("a", entry->GetKey());
+  EXPECT_EQ(kBody, ReadStream(entry, kBodyIndex));
+  entry->Close();
+  EXPECT_NE(net::OK, iter->OpenNextEntry(&entry));
+  RunUntilIdle();
+
+  // Iterating is not a hit.
+  EXPECT_EQ(0, GetMemoryEntryCount());
+}
+
+}  // namespace disk_cache
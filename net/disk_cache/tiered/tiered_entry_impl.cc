@@ -0,0 +1,340 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/tiered/tiered_entry_impl.h"
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/tiered/tiered_backend_impl.h"
+
+namespace disk_cache {
+
+namespace {
+
+void OnDiskEntryDoomed(int result) {}
+
+}  // namespace
+
+TieredEntryImpl::QueuedOperation::QueuedOperation(
+    const base::Callback<int()>& operation,
+    const CompletionCallback& callback)
+    : operation(operation), callback(callback) {}
+
+TieredEntryImpl::QueuedOperation::QueuedOperation(
+    const QueuedOperation& other) = default;
+
+TieredEntryImpl::QueuedOperation::~QueuedOperation() {}
+
+TieredEntryImpl::TieredEntryImpl(base::WeakPtr<TieredBackendImpl> backend,
+                                 const std::string& key,
+                                 Entry* disk_entry,
+                                 Entry* memory_entry,
+                                 bool promotable)
+    : backend_(backend),
+      key_(key),
+      disk_entry_(disk_entry),
+      memory_entry_(memory_entry),
+      promotable_(promotable),
+      open_count_(0),
+      doomed_(false),
+      opening_disk_entry_(false),
+      weak_factory_(this) {
+  DCHECK(disk_entry_ || memory_entry_);
+  DCHECK(!promotable_ || disk_entry_);
+  if (promotable_)
+    teed_streams_.resize(kMemoryTierStreamCount);
+}
+
+void TieredEntryImpl::Open() {
+  ++open_count_;
+}
+
+void TieredEntryImpl::Doom() {
+  if (doomed_)
+    return;
+  doomed_ = true;
+  // Dooms the copy in the memory tier too.
+  if (backend_)
+    backend_->OnEntryDoomed(this);
+  if (disk_entry_) {
+    disk_entry_->Doom();
+  } else if (!opening_disk_entry_ && backend_) {
+    backend_->wrapped_backend()->DoomEntry(key_,
+                                           base::Bind(&OnDiskEntryDoomed));
+  }
+}
+
+void TieredEntryImpl::Close() {
+  DCHECK_GT(open_count_, 0);
+  if (--open_count_ > 0)
+    return;
+  MaybeFinishClose();
+}
+
+std::string TieredEntryImpl::GetKey() const {
+  return key_;
+}
+
+base::Time TieredEntryImpl::GetLastUsed() const {
+  return current_entry()->GetLastUsed();
+}
+
+base::Time TieredEntryImpl::GetLastModified() const {
+  return current_entry()->GetLastModified();
+}
+
+int32_t TieredEntryImpl::GetDataSize(int index) const {
+  return current_entry()->GetDataSize(index);
+}
+
+int TieredEntryImpl::ReadData(int index,
+                              int offset,
+                              IOBuffer* buf,
+                              int buf_len,
+                              const CompletionCallback& callback) {
+  return RunOperation(
+      base::Bind(&TieredEntryImpl::ReadEntryData, base::Unretained(this),
+                 index, offset, base::RetainedRef(buf), buf_len, callback),
+      callback, false);
+}
+
+int TieredEntryImpl::WriteData(int index,
+                               int offset,
+                               IOBuffer* buf,
+                               int buf_len,
+                               const CompletionCallback& callback,
+                               bool truncate) {
+  return RunOperation(
+      base::Bind(&TieredEntryImpl::WriteEntryData, base::Unretained(this),
+                 index, offset, base::RetainedRef(buf), buf_len, callback,
+                 truncate),
+      callback, true);
+}
+
+int TieredEntryImpl::ReadSparseData(int64_t offset,
+                                    IOBuffer* buf,
+                                    int buf_len,
+                                    const CompletionCallback& callback) {
+  return RunOperation(
+      base::Bind(&TieredEntryImpl::ReadEntrySparseData, base::Unretained(this),
+                 offset, base::RetainedRef(buf), buf_len, callback),
+      callback, true);
+}
+
+int TieredEntryImpl::WriteSparseData(int64_t offset,
+                                     IOBuffer* buf,
+                                     int buf_len,
+                                     const CompletionCallback& callback) {
+  return RunOperation(
+      base::Bind(&TieredEntryImpl::WriteEntrySparseData,
+                 base::Unretained(this), offset, base::RetainedRef(buf),
+                 buf_len, callback),
+      callback, true);
+}
+
+int TieredEntryImpl::GetAvailableRange(int64_t offset,
+                                       int len,
+                                       int64_t* start,
+                                       const CompletionCallback& callback) {
+  return RunOperation(
+      base::Bind(&TieredEntryImpl::GetEntryAvailableRange,
+                 base::Unretained(this), offset, len, start, callback),
+      callback, true);
+}
+
+bool TieredEntryImpl::CouldBeSparse() const {
+  // Copies in the memory tier have no sparse data.
+  return current_entry()->CouldBeSparse();
+}
+
+void TieredEntryImpl::CancelSparseIO() {
+  if (disk_entry_)
+    disk_entry_->CancelSparseIO();
+}
+
+int TieredEntryImpl::ReadyForSparseIO(const CompletionCallback& callback) {
+  if (!disk_entry_)
+    return net::OK;
+  return disk_entry_->ReadyForSparseIO(callback);
+}
+
+TieredEntryImpl::~TieredEntryImpl() {}
+
+int TieredEntryImpl::RunOperation(const base::Callback<int()>& operation,
+                                  const CompletionCallback& callback,
+                                  bool needs_disk_entry) {
+  if (queued_operations_.empty() && (disk_entry_ || !needs_disk_entry))
+    return operation.Run();
+
+  queued_operations_.push_back(QueuedOperation(operation, callback));
+  OpenDiskEntry();
+  return net::ERR_IO_PENDING;
+}
+
+void TieredEntryImpl::OpenDiskEntry() {
+  if (disk_entry_ || opening_disk_entry_)
+    return;
+  opening_disk_entry_ = true;
+  Entry** disk_entry = new Entry*(nullptr);
+  CompletionCallback open_callback =
+      base::Bind(&TieredEntryImpl::OnDiskEntryOpened, base::Unretained(this),
+                 base::Owned(disk_entry));
+  int rv = net::ERR_FAILED;
+  if (backend_) {
+    rv = backend_->wrapped_backend()->OpenEntry(key_, disk_entry,
+                                                open_callback);
+  }
+  if (rv != net::ERR_IO_PENDING)
+    OnDiskEntryOpened(disk_entry, rv);
+}
+
+void TieredEntryImpl::OnDiskEntryOpened(Entry** disk_entry, int result) {
+  opening_disk_entry_ = false;
+  if (result == net::OK) {
+    disk_entry_ = *disk_entry;
+    if (doomed_)
+      disk_entry_->Doom();
+  } else if (!doomed_) {
+    // The disk backend evicted the entry, so its copy in the memory tier is
+    // dropped, and only serves the reads of the handles already open. The
+    // writes fail.
+    doomed_ = true;
+    if (backend_)
+      backend_->OnEntryDoomed(this);
+  }
+  RunQueuedOperations();
+}
+
+void TieredEntryImpl::RunQueuedOperations() {
+  while (!queued_operations_.empty()) {
+    QueuedOperation queued_operation = queued_operations_.front();
+    queued_operations_.pop_front();
+    int rv = queued_operation.operation.Run();
+    if (rv != net::ERR_IO_PENDING && !queued_operation.callback.is_null()) {
+      base::ThreadTaskRunnerHandle::Get()->PostTask(
+          FROM_HERE, base::Bind(queued_operation.callback, rv));
+    }
+  }
+  MaybeFinishClose();
+}
+
+int TieredEntryImpl::ReadEntryData(int index,
+                                   int offset,
+                                   IOBuffer* buf,
+                                   int buf_len,
+                                   const CompletionCallback& callback) {
+  if (!promotable_ || index < 0 || index >= kMemoryTierStreamCount)
+    return current_entry()->ReadData(index, offset, buf, buf_len, callback);
+  int rv = disk_entry_->ReadData(
+      index, offset, buf, buf_len,
+      base::Bind(&TieredEntryImpl::OnDiskDataRead, weak_factory_.GetWeakPtr(),
+                 index, offset, base::RetainedRef(buf), callback));
+  if (rv != net::ERR_IO_PENDING)
+    TeeData(index, offset, buf, rv);
+  return rv;
+}
+
+int TieredEntryImpl::WriteEntryData(int index,
+                                    int offset,
+                                    IOBuffer* buf,
+                                    int buf_len,
+                                    const CompletionCallback& callback,
+                                    bool truncate) {
+  if (!disk_entry_)
+    return net::ERR_FAILED;
+  DropMemoryEntry();
+  return disk_entry_->WriteData(index, offset, buf, buf_len, callback,
+                                truncate);
+}
+
+int TieredEntryImpl::ReadEntrySparseData(int64_t offset,
+                                         IOBuffer* buf,
+                                         int buf_len,
+                                         const CompletionCallback& callback) {
+  if (!disk_entry_)
+    return net::ERR_FAILED;
+  return disk_entry_->ReadSparseData(offset, buf, buf_len, callback);
+}
+
+int TieredEntryImpl::WriteEntrySparseData(int64_t offset,
+                                          IOBuffer* buf,
+                                          int buf_len,
+                                          const CompletionCallback& callback) {
+  if (!disk_entry_)
+    return net::ERR_FAILED;
+  DropMemoryEntry();
+  return disk_entry_->WriteSparseData(offset, buf, buf_len, callback);
+}
+
+int TieredEntryImpl::GetEntryAvailableRange(
+    int64_t offset,
+    int len,
+    int64_t* start,
+    const CompletionCallback& callback) {
+  if (!disk_entry_)
+    return net::ERR_FAILED;
+  return disk_entry_->GetAvailableRange(offset, len, start, callback);
+}
+
+// static
+void TieredEntryImpl::OnDiskDataRead(base::WeakPtr<TieredEntryImpl> entry,
+                                     int index,
+                                     int offset,
+                                     IOBuffer* buf,
+                                     const CompletionCallback& callback,
+                                     int result) {
+  if (entry)
+    entry->TeeData(index, offset, buf, result);
+  if (!callback.is_null())
+    callback.Run(result);
+}
+
+void TieredEntryImpl::TeeData(int index,
+                              int offset,
+                              IOBuffer* buf,
+                              int result) {
+  if (!promotable_ || result <= 0)
+    return;
+  std::string* teed = &teed_streams_[index];
+  const int teed_len = teed->size();
+  if (offset > teed_len || offset + result <= teed_len)
+    return;
+  teed->append(buf->data() + teed_len - offset, offset + result - teed_len);
+}
+
+void TieredEntryImpl::DropMemoryEntry() {
+  // A written entry is copied to the memory tier again once it is hit.
+  promotable_ = false;
+  teed_streams_.clear();
+  if (memory_entry_) {
+    memory_entry_->Close();
+    memory_entry_ = nullptr;
+  }
+  if (backend_)
+    backend_->DoomMemoryEntry(key_);
+}
+
+void TieredEntryImpl::MaybeFinishClose() {
+  if (open_count_ > 0 || opening_disk_entry_)
+    return;
+  DCHECK(queued_operations_.empty());
+
+  if (backend_)
+    backend_->OnEntryClosed(this);
+  if (memory_entry_)
+    memory_entry_->Close();
+  if (disk_entry_) {
+    if (backend_ && promotable_ && !doomed_)
+      backend_->PromoteEntry(key_, disk_entry_, &teed_streams_);
+    else
+      disk_entry_->Close();
+  }
+  delete this;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,183 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_TIERED_TIERED_ENTRY_IMPL_H_
+#define NET_DISK_CACHE_TIERED_TIERED_ENTRY_IMPL_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/macros.h"
+#include "base/memory/weak_ptr.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace disk_cache {
+
+class TieredBackendImpl;
+
+// This class implements the Entry interface for TieredBackendImpl, on top of
+// an entry of the disk backend, or of its copy in the memory tier.
+//
+// An entry opened from the memory tier is read from there. Its entry in the
+// disk backend is only opened for the writes and the sparse data. A write
+// drops the copy in the memory tier, and the entry is read from the disk from
+// then on.
+//
+// An entry opened from the disk keeps the data read from the start of each
+// stream, for TieredBackendImpl::PromoteEntry().
+class NET_EXPORT_PRIVATE TieredEntryImpl final : public Entry {
+ public:
+  // Takes a handle to |disk_entry|, or to |memory_entry| for an entry opened
+  // from the memory tier. A |promotable| entry is copied to the memory tier
+  // once its last handle is closed, unless it was written.
+  TieredEntryImpl(base::WeakPtr<TieredBackendImpl> backend,
+                  const std::string& key,
+                  Entry* disk_entry,
+                  Entry* memory_entry,
+                  bool promotable);
+
+  // Adds a handle to the entry.
+  void Open();
+
+  // From disk_cache::Entry:
+  void Doom() override;
+  void Close() override;
+  std::string GetKey() const override;
+  base::Time GetLastUsed() const override;
+  base::Time GetLastModified() const override;
+  int32_t GetDataSize(int index) const override;
+  int ReadData(int index,
+               int offset,
+               IOBuffer* buf,
+               int buf_len,
+               const CompletionCallback& callback) override;
+  int WriteData(int index,
+                int offset,
+                IOBuffer* buf,
+                int buf_len,
+                const CompletionCallback& callback,
+                bool truncate) override;
+  int ReadSparseData(int64_t offset,
+                     IOBuffer* buf,
+                     int buf_len,
+                     const CompletionCallback& callback) override;
+  int WriteSparseData(int64_t offset,
+                      IOBuffer* buf,
+                      int buf_len,
+                      const CompletionCallback& callback) override;
+  int GetAvailableRange(int64_t offset,
+                        int len,
+                        int64_t* start,
+                        const CompletionCallback& callback) override;
+  bool CouldBeSparse() const override;
+  void CancelSparseIO() override;
+  int ReadyForSparseIO(const CompletionCallback& callback) override;
+
+ private:
+  // An operation waiting for the entry of the disk backend to be opened.
+  struct QueuedOperation {
+    QueuedOperation(const base::Callback<int()>& operation,
+                    const CompletionCallback& callback);
+    QueuedOperation(const QueuedOperation& other);
+    ~QueuedOperation();
+
+    base::Callback<int()> operation;
+    CompletionCallback callback;
+  };
+
+  ~TieredEntryImpl() override;
+
+  // The entry the streams are read from.
+  Entry* current_entry() const {
+    return memory_entry_ ? memory_entry_ : disk_entry_;
+  }
+
+  // Runs |operation|, once the entry of the disk backend is open if
+  // |needs_disk_entry|, and after the operations queued before. Returns a net
+  // error code.
+  int RunOperation(const base::Callback<int()>& operation,
+                   const CompletionCallback& callback,
+                   bool needs_disk_entry);
+
+  // Opens the entry of the disk backend, unless it is open or being opened,
+  // and then runs the queued operations.
+  void OpenDiskEntry();
+  void OnDiskEntryOpened(Entry** disk_entry, int result);
+  void RunQueuedOperations();
+
+  // The operations run by RunOperation().
+  int ReadEntryData(int index,
+                    int offset,
+                    IOBuffer* buf,
+                    int buf_len,
+                    const CompletionCallback& callback);
+  int WriteEntryData(int index,
+                     int offset,
+                     IOBuffer* buf,
+                     int buf_len,
+                     const CompletionCallback& callback,
+                     bool truncate);
+  int ReadEntrySparseData(int64_t offset,
+                          IOBuffer* buf,
+                          int buf_len,
+                          const CompletionCallback& callback);
+  int WriteEntrySparseData(int64_t offset,
+                           IOBuffer* buf,
+                           int buf_len,
+                           const CompletionCallback& callback);
+  int GetEntryAvailableRange(int64_t offset,
+                             int len,
+                             int64_t* start,
+                             const CompletionCallback& callback);
+
+  // Completes a read of the entry of the disk backend, after keeping the data
+  // read if |entry| is still alive.
+  static void OnDiskDataRead(base::WeakPtr<TieredEntryImpl> entry,
+                             int index,
+                             int offset,
+                             IOBuffer* buf,
+                             const CompletionCallback& callback,
+                             int result);
+
+  // Keeps the |result| bytes of |buf| read at |offset| in stream |index|, if
+  // they follow the data kept so far.
+  void TeeData(int index, int offset, IOBuffer* buf, int result);
+
+  // Drops the copy of the entry in the memory tier, before the entry is
+  // written.
+  void DropMemoryEntry();
+
+  // Once the last handle is closed and no operation is queued, closes the
+  // wrapped entries, and deletes this entry.
+  void MaybeFinishClose();
+
+  base::WeakPtr<TieredBackendImpl> backend_;
+  const std::string key_;
+  Entry* disk_entry_;
+  Entry* memory_entry_;
+  bool promotable_;
+  // The data read from the start of each stream, while |promotable_|.
+  std::vector<std::string> teed_streams_;
+
+  int open_count_;
+  bool doomed_;
+
+  // True while the entry of the disk backend is opened, during which all the
+  // operations are queued in |queued_operations_|.
+  bool opening_disk_entry_;
+  std::deque<QueuedOperation> queued_operations_;
+
+  base::WeakPtrFactory<TieredEntryImpl> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(TieredEntryImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_TIERED_TIERED_ENTRY_IMPL_H_
@@ -0,0 +1,226 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/wrapping_backend.h"
+
+#include <utility>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/strings/string_util.h"
+#include "net/base/net_errors.h"
+
+namespace disk_cache {
+
+class WrappingBackend::WrappingIterator final : public Backend::Iterator {
+ public:
+  WrappingIterator(base::WeakPtr<WrappingBackend> backend,
+                   std::unique_ptr<Backend::Iterator> iterator)
+      : backend_(backend),
+        iterator_(std::move(iterator)),
+        weak_factory_(this) {}
+
+  // From Backend::Iterator:
+  int OpenNextEntry(Entry** next_entry,
+                    const CompletionCallback& callback) override {
+    while (true) {
+      Entry** wrapped_entry = new Entry*(nullptr);
+      CompletionCallback wrapped_callback = base::Bind(
+          &WrappingIterator::OnWrappedEntryOpened, weak_factory_.GetWeakPtr(),
+          base::Owned(wrapped_entry), next_entry, callback);
+      int rv = iterator_->OpenNextEntry(wrapped_entry, wrapped_callback);
+      if (rv == net::ERR_IO_PENDING)
+        return rv;
+      bool skipped = false;
+      rv = WrapEntry(rv, *wrapped_entry, next_entry, callback, &skipped);
+      if (!skipped)
+        return rv;
+    }
+  }
+
+ private:
+  // Wraps |wrapped_entry|, unless it was not stored by the backend, in which
+  // case it is closed and |skipped| set to true.
+  int WrapEntry(int result,
+                Entry* wrapped_entry,
+                Entry** next_entry,
+                const CompletionCallback& callback,
+                bool* skipped) {
+    if (result != net::OK)
+      return result;
+    std::string key;
+    if (!backend_ ||
+        !backend_->GetKeyFromWrappedKey(wrapped_entry->GetKey(), &key)) {
+      wrapped_entry->Close();
+      if (!backend_)
+        return net::ERR_FAILED;
+      *skipped = true;
+      return net::OK;
+    }
+    return backend_->WrapEntry(result, wrapped_entry, next_entry, callback);
+  }
+
+  void OnWrappedEntryOpened(Entry** wrapped_entry,
+                            Entry** next_entry,
+                            const CompletionCallback& callback,
+                            int result) {
+    bool skipped = false;
+    int rv = WrapEntry(result, *wrapped_entry, next_entry, callback, &skipped);
+    if (skipped)
+      rv = OpenNextEntry(next_entry, callback);
+    if (rv != net::ERR_IO_PENDING)
+      callback.Run(rv);
+  }
+
+  base::WeakPtr<WrappingBackend> backend_;
+  std::unique_ptr<Backend::Iterator> iterator_;
+  base::WeakPtrFactory<WrappingIterator> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(WrappingIterator);
+};
+
+WrappingBackend::WrappingBackend(std::unique_ptr<Backend> backend,
+                                 const std::string& key_prefix)
+    : backend_(std::move(backend)),
+      key_prefix_(key_prefix),
+      weak_factory_(this) {
+  DCHECK(backend_);
+  DCHECK(!key_prefix_.empty());
+}
+
+WrappingBackend::~WrappingBackend() {}
+
+std::string WrappingBackend::GetWrappedKey(const std::string& key) const {
+  return key_prefix_ + key;
+}
+
+bool WrappingBackend::GetKeyFromWrappedKey(const std::string& wrapped_key,
+                                           std::string* key) const {
+  if (!base::StartsWith(wrapped_key, key_prefix_,
+                        base::CompareCase::SENSITIVE)) {
+    return false;
+  }
+  *key = wrapped_key.substr(key_prefix_.size());
+  return true;
+}
+
+void WrappingBackend::OnEntryClosed(Entry* wrapped_entry) {
+  active_entries_.erase(wrapped_entry);
+}
+
+net::CacheType WrappingBackend::GetCacheType() const {
+  return backend_->GetCacheType();
+}
+
+int32_t WrappingBackend::GetEntryCount() const {
+  return backend_->GetEntryCount();
+}
+
+int WrappingBackend::OpenEntry(const std::string& key,
+                               Entry** entry,
+                               const CompletionCallback& callback) {
+  return OpenEntryWithReadAhead(key, 0, entry, callback);
+}
+
+int WrappingBackend::OpenEntryWithReadAhead(
+    const std::string& key,
+    int read_ahead_size,
+    Entry** entry,
+    const CompletionCallback& callback) {
+  Entry** wrapped_entry = new Entry*(nullptr);
+  CompletionCallback wrapped_callback = base::Bind(
+      &WrappingBackend::OnWrappedEntryOpened, weak_factory_.GetWeakPtr(),
+      base::Owned(wrapped_entry), entry, callback);
+  // The data read ahead is the data as stored by the entry, but it saves a
+  // round trip all the same.
+  int rv = backend_->OpenEntryWithReadAhead(
+      GetWrappedKey(key), read_ahead_size, wrapped_entry, wrapped_callback);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return WrapEntry(rv, *wrapped_entry, entry, callback);
+}
+
+int WrappingBackend::CreateEntry(const std::string& key,
+                                 Entry** entry,
+                                 const CompletionCallback& callback) {
+  Entry** wrapped_entry = new Entry*(nullptr);
+  CompletionCallback wrapped_callback = base::Bind(
+      &WrappingBackend::OnWrappedEntryOpened, weak_factory_.GetWeakPtr(),
+      base::Owned(wrapped_entry), entry, callback);
+  int rv = backend_->CreateEntry(GetWrappedKey(key), wrapped_entry,
+                                 wrapped_callback);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return WrapEntry(rv, *wrapped_entry, entry, callback);
+}
+
+int WrappingBackend::DoomEntry(const std::string& key,
+                               const CompletionCallback& callback) {
+  return backend_->DoomEntry(GetWrappedKey(key), callback);
+}
+
+int WrappingBackend::DoomAllEntries(const CompletionCallback& callback) {
+  return backend_->DoomAllEntries(callback);
+}
+
+int WrappingBackend::DoomEntriesBetween(base::Time initial_time,
+                                        base::Time end_time,
+                                        const CompletionCallback& callback) {
+  return backend_->DoomEntriesBetween(initial_time, end_time, callback);
+}
+
+int WrappingBackend::DoomEntriesSince(base::Time initial_time,
+                                      const CompletionCallback& callback) {
+  return backend_->DoomEntriesSince(initial_time, callback);
+}
+
+int WrappingBackend::CalculateSizeOfAllEntries(
+    const CompletionCallback& callback) {
+  return backend_->CalculateSizeOfAllEntries(callback);
+}
+
+std::unique_ptr<Backend::Iterator> WrappingBackend::CreateIterator() {
+  return std::unique_ptr<Backend::Iterator>(new WrappingIterator(
+      weak_factory_.GetWeakPtr(), backend_->CreateIterator()));
+}
+
+void WrappingBackend::GetStats(base::StringPairs* stats) {
+  backend_->GetStats(stats);
+}
+
+void WrappingBackend::OnExternalCacheHit(const std::string& key) {
+  backend_->OnExternalCacheHit(GetWrappedKey(key));
+}
+
+bool WrappingBackend::MayHaveEntry(const std::string& key) const {
+  return backend_->MayHaveEntry(GetWrappedKey(key));
+}
+
+int WrappingBackend::WrapEntry(int result,
+                               Entry* wrapped_entry,
+                               Entry** out_entry,
+                               const CompletionCallback& callback) {
+  if (result != net::OK)
+    return result;
+  // The wrapped backend returns the same entry to all the opens of a key.
+  WrappingEntry*& entry = active_entries_[wrapped_entry];
+  if (!entry) {
+    std::string key;
+    if (!GetKeyFromWrappedKey(wrapped_entry->GetKey(), &key))
+      NOTREACHED();
+    entry = NewEntry(key, wrapped_entry);
+  }
+  return entry->Open(out_entry, callback);
+}
+
+void WrappingBackend::OnWrappedEntryOpened(Entry** wrapped_entry,
+                                           Entry** out_entry,
+                                           const CompletionCallback& callback,
+                                           int result) {
+  int rv = WrapEntry(result, *wrapped_entry, out_entry, callback);
+  if (rv != net::ERR_IO_PENDING)
+    callback.Run(rv);
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,124 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_WRAPPING_BACKEND_H_
+#define NET_DISK_CACHE_WRAPPING_BACKEND_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "base/macros.h"
+#include "base/memory/weak_ptr.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace disk_cache {
+
+// The interface of the entries of a WrappingBackend.
+class NET_EXPORT_PRIVATE WrappingEntry : public Entry {
+ public:
+  // Adds a handle to the entry, for a handle to the wrapped entry, which is
+  // returned through |out_entry| right away, or through |callback| once the
+  // entry is ready. Returns a net error code.
+  virtual int Open(Entry** out_entry, const CompletionCallback& callback) = 0;
+
+ protected:
+  ~WrappingEntry() override {}
+};
+
+// A base for the backends that store each of their entries in an entry of
+// another backend, like CompressedBackendImpl and DedupBackendImpl.
+//
+// Entries are stored in the wrapped backend under their key with a prefix, so
+// that the entries of different backends never mix. Entries without the prefix
+// are not visible through this class. The operations that are not about a
+// single entry are forwarded to the wrapped backend as they are.
+class NET_EXPORT_PRIVATE WrappingBackend : public Backend {
+ public:
+  ~WrappingBackend() override;
+
+  Backend* wrapped_backend() const { return backend_.get(); }
+
+  // Returns the key of the entry of the wrapped backend that stores |key|.
+  std::string GetWrappedKey(const std::string& key) const;
+
+  // Returns whether |wrapped_key| is the key of an entry of the wrapped backend
+  // that stores an entry of this backend, and if so returns its key to |key|.
+  bool GetKeyFromWrappedKey(const std::string& wrapped_key,
+                            std::string* key) const;
+
+  // Called by the entries when they no longer wrap |wrapped_entry|.
+  void OnEntryClosed(Entry* wrapped_entry);
+
+  // Backend implementation.
+  net::CacheType GetCacheType() const override;
+  int32_t GetEntryCount() const override;
+  int OpenEntry(const std::string& key,
+                Entry** entry,
+                const CompletionCallback& callback) override;
+  int OpenEntryWithReadAhead(const std::string& key,
+                             int read_ahead_size,
+                             Entry** entry,
+                             const CompletionCallback& callback) override;
+  int CreateEntry(const std::string& key,
+                  Entry** entry,
+                  const CompletionCallback& callback) override;
+  int DoomEntry(const std::string& key,
+                const CompletionCallback& callback) override;
+  int DoomAllEntries(const CompletionCallback& callback) override;
+  int DoomEntriesBetween(base::Time initial_time,
+                         base::Time end_time,
+                         const CompletionCallback& callback) override;
+  int DoomEntriesSince(base::Time initial_time,
+                       const CompletionCallback& callback) override;
+  int CalculateSizeOfAllEntries(const CompletionCallback& callback) override;
+  std::unique_ptr<Iterator> CreateIterator() override;
+  void GetStats(base::StringPairs* stats) override;
+  void OnExternalCacheHit(const std::string& key) override;
+  bool MayHaveEntry(const std::string& key) const override;
+
+ protected:
+  // Stores the entries in |backend|, under keys starting with |key_prefix|.
+  WrappingBackend(std::unique_ptr<Backend> backend,
+                  const std::string& key_prefix);
+
+  // Returns a new entry of key |key|, wrapping |wrapped_entry|.
+  virtual WrappingEntry* NewEntry(const std::string& key,
+                                  Entry* wrapped_entry) = 0;
+
+ private:
+  class WrappingIterator;
+
+  // Completes an open or create of |wrapped_entry| in the wrapped backend,
+  // which returned |result|: returns the entry wrapping it to |out_entry|
+  // once it is ready. Returns a net error code.
+  int WrapEntry(int result,
+                Entry* wrapped_entry,
+                Entry** out_entry,
+                const CompletionCallback& callback);
+
+  void OnWrappedEntryOpened(Entry** wrapped_entry,
+                            Entry** out_entry,
+                            const CompletionCallback& callback,
+                            int result);
+
+  std::unique_ptr<Backend> backend_;
+  const std::string key_prefix_;
+
+  // The entries with open handles, by the entry of |backend_| they wrap.
+  std::unordered_map<Entry*, WrappingEntry*> active_entries_;
+
+  base::WeakPtrFactory<WrappingBackend> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(WrappingBackend);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_WRAPPING_BACKEND_H_
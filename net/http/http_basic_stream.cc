@@ -6,6 +6,8 @@
 
 #include <memory>
 
+#include "net/base/load_flags.h"
+#include "net/base/net_errors.h"
 #include "net/http/http_request_info.h"
 #include "net/http/http_response_body_drainer.h"
 #include "net/http/http_stream_parser.h"
@@ -23,6 +25,9 @@ int HttpBasicStream::InitializeStream(const HttpRequestInfo* request_info,
                                       RequestPriority priority,
                                       const BoundNetLog& net_log,
                                       const CompletionCallback& callback) {
+  // HTTP/1 has no server push.
+  if (request_info->load_flags & LOAD_ONLY_FROM_PUSH)
+    return ERR_FAILED;
   state_.Initialize(request_info, priority, net_log, callback);
   return OK;
 }
@@ -11,6 +11,7 @@
 #include "base/bind_helpers.h"
 #include "base/callback.h"
 #include "base/compiler_specific.h"
+#include "base/containers/mru_cache.h"
 #include "base/files/file_util.h"
 #include "base/format_macros.h"
 #include "base/location.h"
@@ -44,6 +45,7 @@
 #include "net/http/http_response_info.h"
 #include "net/http/http_util.h"
 #include "net/quic/core/crypto/quic_server_info.h"
+#include "net/spdy/server_push_store.h"
 
 #if defined(OS_POSIX)
 #include <unistd.h>
@@ -51,6 +53,23 @@
 
 namespace net {
 
+namespace {
+
+// The amount of the body read ahead when opening an entry. This is the size
+// of the buffers that consumers typically read responses with.
+const int kOpenEntryReadAheadSize = 32 * 1024;
+
+}  // namespace
+
+const base::Feature kHttpCacheReadWhileWriting{
+    "HttpCacheReadWhileWriting", base::FEATURE_DISABLED_BY_DEFAULT};
+
+const base::Feature kHttpCacheOpenWithReadAhead{
+    "HttpCacheOpenWithReadAhead", base::FEATURE_DISABLED_BY_DEFAULT};
+
+const base::Feature kHttpCacheAdoptServerPushes{
+    "HttpCacheAdoptServerPushes", base::FEATURE_DISABLED_BY_DEFAULT};
+
 HttpCache::DefaultBackend::DefaultBackend(
     CacheType type,
     BackendType backend_type,
@@ -96,7 +115,9 @@ HttpCache::ActiveEntry::ActiveEntry(disk_cache::Entry* entry)
     : disk_entry(entry),
       writer(NULL),
       will_process_pending_queue(false),
-      doomed(false) {
+      doomed(false),
+      streaming(false),
+      streaming_aborted(false) {
 }
 
 HttpCache::ActiveEntry::~ActiveEntry() {
@@ -289,6 +310,189 @@ class HttpCache::QuicServerInfoFactoryAdaptor : public QuicServerInfoFactory {
   HttpCache* const http_cache_;
 };
 
+//-----------------------------------------------------------------------------
+
+// Adopts the server pushes accepted by the sessions of the network layer: for
+// each push, a request for the pushed URL is issued through the cache, which
+// claims the push like any other request would and writes the response to the
+// cache on the way. The request never goes to the network by itself: it is
+// served by the cache or by the push, or fails. The URLs of adopted pushes are
+// remembered for a while, so that cache hits on them can be credited to server
+// push.
+class HttpCache::PushAdopter : public ServerPushStore::Observer {
+ public:
+  PushAdopter(HttpCache* cache, ServerPushStore* store);
+  ~PushAdopter() override;
+
+  // ServerPushStore::Observer implementation:
+  bool AdoptPush(const GURL& url, PrivacyMode privacy_mode) override;
+
+  // Called when a request got the response for |url| from the cache.
+  void OnCacheEntryUsed(const GURL& url);
+
+ private:
+  class PushReader;
+
+  // Number of adopted URLs that cache hits are looked up in.
+  static const size_t kMaxAdoptedUrls = 256;
+
+  void StartReader(const GURL& url, PrivacyMode privacy_mode);
+
+  // Called by |reader| once it is done. |redundant| is true if the cache
+  // already had a usable response, so that the push was not needed.
+  void OnReaderDone(PushReader* reader, bool redundant);
+
+  HttpCache* const cache_;
+  ServerPushStore* const store_;
+  std::set<PushReader*> readers_;
+  base::MRUCache<GURL, bool> adopted_urls_;
+
+  base::WeakPtrFactory<PushAdopter> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(PushAdopter);
+};
+
+// Reads the response for a pushed URL through the cache, and discards it.
+class HttpCache::PushAdopter::PushReader {
+ public:
+  PushReader(PushAdopter* adopter,
+             const GURL& url,
+             PrivacyMode privacy_mode,
+             std::unique_ptr<HttpTransaction> transaction);
+  ~PushReader();
+
+  const GURL& url() const { return request_info_.url; }
+
+  void Start();
+
+ private:
+  static const int kReadBufferSize = 32 * 1024;
+
+  void OnStartComplete(int result);
+  void Read();
+  void OnReadComplete(int result);
+
+  PushAdopter* const adopter_;
+  HttpRequestInfo request_info_;
+  std::unique_ptr<HttpTransaction> transaction_;
+  scoped_refptr<IOBuffer> buf_;
+
+  DISALLOW_COPY_AND_ASSIGN(PushReader);
+};
+
+HttpCache::PushAdopter::PushReader::PushReader(
+    PushAdopter* adopter,
+    const GURL& url,
+    PrivacyMode privacy_mode,
+    std::unique_ptr<HttpTransaction> transaction)
+    : adopter_(adopter),
+      transaction_(std::move(transaction)),
+      buf_(new IOBuffer(kReadBufferSize)) {
+  request_info_.url = url;
+  request_info_.method = "GET";
+  // The session holding the push is only found by a request in its privacy
+  // mode.
+  request_info_.privacy_mode = privacy_mode;
+  request_info_.load_flags = LOAD_ONLY_FROM_PUSH;
+}
+
+HttpCache::PushAdopter::PushReader::~PushReader() {}
+
+void HttpCache::PushAdopter::PushReader::Start() {
+  int rv = transaction_->Start(
+      &request_info_,
+      base::Bind(&PushReader::OnStartComplete, base::Unretained(this)),
+      BoundNetLog());
+  if (rv != ERR_IO_PENDING)
+    OnStartComplete(rv);
+}
+
+void HttpCache::PushAdopter::PushReader::OnStartComplete(int result) {
+  if (result != OK)
+    return adopter_->OnReaderDone(this, false);
+
+  const HttpResponseInfo* response_info = transaction_->GetResponseInfo();
+  if (response_info->was_cached && !response_info->network_accessed)
+    return adopter_->OnReaderDone(this, true);
+  Read();
+}
+
+void HttpCache::PushAdopter::PushReader::Read() {
+  int rv;
+  do {
+    rv = transaction_->Read(
+        buf_.get(), kReadBufferSize,
+        base::Bind(&PushReader::OnReadComplete, base::Unretained(this)));
+  } while (rv > 0);
+  if (rv != ERR_IO_PENDING)
+    adopter_->OnReaderDone(this, false);
+}
+
+void HttpCache::PushAdopter::PushReader::OnReadComplete(int result) {
+  if (result <= 0)
+    return adopter_->OnReaderDone(this, false);
+  Read();
+}
+
+HttpCache::PushAdopter::PushAdopter(HttpCache* cache, ServerPushStore* store)
+    : cache_(cache),
+      store_(store),
+      adopted_urls_(kMaxAdoptedUrls),
+      weak_factory_(this) {
+  store_->AddObserver(this);
+}
+
+HttpCache::PushAdopter::~PushAdopter() {
+  store_->RemoveObserver(this);
+  STLDeleteElements(&readers_);
+}
+
+bool HttpCache::PushAdopter::AdoptPush(const GURL& url,
+                                       PrivacyMode privacy_mode) {
+  if (cache_->mode() == DISABLE)
+    return false;
+  // The push is reported by a session in the middle of handling a frame, so
+  // claim it from a fresh stack.
+  base::ThreadTaskRunnerHandle::Get()->PostTask(
+      FROM_HERE, base::Bind(&PushAdopter::StartReader,
+                            weak_factory_.GetWeakPtr(), url, privacy_mode));
+  adopted_urls_.Put(url, true);
+  return true;
+}
+
+void HttpCache::PushAdopter::OnCacheEntryUsed(const GURL& url) {
+  base::MRUCache<GURL, bool>::iterator it = adopted_urls_.Peek(url);
+  if (it == adopted_urls_.end())
+    return;
+  adopted_urls_.Erase(it);
+  store_->OnAdoptedPushUsed();
+}
+
+void HttpCache::PushAdopter::StartReader(const GURL& url,
+                                         PrivacyMode privacy_mode) {
+  // The push may have been evicted or cancelled in the meantime.
+  if (!store_->HasPush(url, privacy_mode))
+    return;
+  std::unique_ptr<HttpTransaction> transaction;
+  if (cache_->CreateTransaction(IDLE, &transaction) != OK)
+    return;
+  PushReader* reader =
+      new PushReader(this, url, privacy_mode, std::move(transaction));
+  readers_.insert(reader);
+  reader->Start();
+}
+
+void HttpCache::PushAdopter::OnReaderDone(PushReader* reader, bool redundant) {
+  if (redundant) {
+    base::MRUCache<GURL, bool>::iterator it = adopted_urls_.Peek(reader->url());
+    if (it != adopted_urls_.end())
+      adopted_urls_.Erase(it);
+    store_->CancelPushes(reader->url());
+  }
+  readers_.erase(reader);
+  delete reader;
+}
+
 //-----------------------------------------------------------------------------
 HttpCache::HttpCache(HttpNetworkSession* session,
                      std::unique_ptr<BackendFactory> backend_factory,
@@ -321,10 +525,17 @@ HttpCache::HttpCache(std::unique_ptr<HttpTransactionFactory> network_layer,
       session->quic_stream_factory()->set_quic_server_info_factory(
           new QuicServerInfoFactoryAdaptor(this));
     }
+    if (base::FeatureList::IsEnabled(kHttpCacheAdoptServerPushes)) {
+      push_adopter_.reset(
+          new PushAdopter(this, session->server_push_store()));
+    }
   }
 }
 
 HttpCache::~HttpCache() {
+  // Cancel the requests claiming server pushes while the cache is intact.
+  push_adopter_.reset();
+
   // Transactions should see an invalid cache after this point; otherwise they
   // could see an inconsistent object (half destroyed).
   weak_factory_.InvalidateWeakPtrs();
@@ -738,8 +949,15 @@ int HttpCache::OpenEntry(const std::string& key, ActiveEntry** entry,
   pending_op->callback = base::Bind(&HttpCache::OnPendingOpComplete,
                                     GetWeakPtr(), pending_op);
 
-  int rv = disk_cache_->OpenEntry(key, &(pending_op->disk_entry),
-                                  pending_op->callback);
+  int rv;
+  if (base::FeatureList::IsEnabled(kHttpCacheOpenWithReadAhead)) {
+    rv = disk_cache_->OpenEntryWithReadAhead(key, kOpenEntryReadAheadSize,
+                                             &(pending_op->disk_entry),
+                                             pending_op->callback);
+  } else {
+    rv = disk_cache_->OpenEntry(key, &(pending_op->disk_entry),
+                                pending_op->callback);
+  }
   if (rv != ERR_IO_PENDING) {
     item->ClearTransaction();
     pending_op->callback.Run(rv);
@@ -799,6 +1017,9 @@ int HttpCache::AddTransactionToEntry(ActiveEntry* entry, Transaction* trans) {
 
   if (entry->writer || entry->will_process_pending_queue) {
     entry->pending_queue.push_back(trans);
+    // The transaction may be able to read the response being written.
+    if (entry->streaming)
+      ProcessPendingQueue(entry);
     return ERR_IO_PENDING;
   }
 
@@ -828,11 +1049,14 @@ void HttpCache::DoneWithEntry(ActiveEntry* entry, Transaction* trans,
                               bool cancel) {
   // If we already posted a task to move on to the next transaction and this was
   // the writer, there is nothing to cancel.
-  if (entry->will_process_pending_queue && entry->readers.empty())
+  if (entry->will_process_pending_queue && entry->readers.empty() &&
+      !entry->writer) {
     return;
+  }
 
-  if (entry->writer) {
-    DCHECK(trans == entry->writer);
+  if (entry->writer == trans) {
+    // The body is not complete, or the writer would be done already.
+    StopStreamingToReaders(entry);
 
     // Assume there was a failure.
     bool success = false;
@@ -852,21 +1076,31 @@ void HttpCache::DoneWithEntry(ActiveEntry* entry, Transaction* trans,
 }
 
 void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
-  DCHECK(entry->readers.empty());
+  // The only readers of an entry being written read the streamed body.
+  DCHECK(entry->readers.empty() || entry->streaming ||
+         entry->streaming_aborted);
 
+  if (!entry->readers.empty() && !(success && entry->streaming))
+    entry->streaming_aborted = true;
+  entry->streaming = false;
   entry->writer = NULL;
+  NotifyStreamingReaders(entry);
 
   if (success) {
     ProcessPendingQueue(entry);
   } else {
-    DCHECK(!entry->will_process_pending_queue);
-
     // We failed to create this entry.
     TransactionList pending_queue;
     pending_queue.swap(entry->pending_queue);
 
-    entry->disk_entry->Doom();
-    DestroyEntry(entry);
+    if (entry->readers.empty() && !entry->will_process_pending_queue) {
+      entry->disk_entry->Doom();
+      DestroyEntry(entry);
+    } else if (!entry->doomed) {
+      // Keep the entry until the readers of the streamed body are done, and
+      // OnProcessPendingQueue() destroys it.
+      DoomEntry(entry->disk_entry->GetKey(), NULL);
+    }
 
     // We need to do something about these pending entries, which now need to
     // be added to a new entry.
@@ -879,7 +1113,7 @@ void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
 }
 
 void HttpCache::DoneReadingFromEntry(ActiveEntry* entry, Transaction* trans) {
-  DCHECK(!entry->writer);
+  DCHECK(!entry->writer || entry->streaming || entry->streaming_aborted);
 
   TransactionList::iterator it =
       std::find(entry->readers.begin(), entry->readers.end(), trans);
@@ -903,6 +1137,34 @@ void HttpCache::ConvertWriterToReader(ActiveEntry* entry) {
   ProcessPendingQueue(entry);
 }
 
+void HttpCache::StartStreamingToReaders(ActiveEntry* entry) {
+  DCHECK(entry->writer);
+  DCHECK(entry->readers.empty());
+  if (!base::FeatureList::IsEnabled(kHttpCacheReadWhileWriting))
+    return;
+
+  entry->streaming = true;
+  entry->streaming_aborted = false;
+  if (!entry->pending_queue.empty())
+    ProcessPendingQueue(entry);
+}
+
+void HttpCache::StopStreamingToReaders(ActiveEntry* entry) {
+  DCHECK(entry->writer);
+  if (!entry->streaming)
+    return;
+
+  entry->streaming = false;
+  if (!entry->readers.empty())
+    entry->streaming_aborted = true;
+  NotifyStreamingReaders(entry);
+}
+
+void HttpCache::NotifyStreamingReaders(ActiveEntry* entry) {
+  for (Transaction* reader : entry->readers)
+    reader->OnWriterProgress();
+}
+
 LoadState HttpCache::GetLoadStateForPendingTransaction(
       const Transaction* trans) {
   ActiveEntriesMap::const_iterator i = active_entries_.find(trans->key());
@@ -996,7 +1258,29 @@ void HttpCache::ProcessPendingQueue(ActiveEntry* entry) {
 
 void HttpCache::OnProcessPendingQueue(ActiveEntry* entry) {
   entry->will_process_pending_queue = false;
-  DCHECK(!entry->writer);
+
+  if (entry->writer) {
+    // Only the transactions that can use the response being written may join
+    // the writer. The others wait for it to finish.
+    if (!entry->streaming)
+      return;
+    const HttpResponseInfo* response = entry->writer->GetResponseInfo();
+    TransactionList::iterator it = std::find_if(
+        entry->pending_queue.begin(), entry->pending_queue.end(),
+        [response](const Transaction* trans) {
+          return trans->CanReadWhileWriting(*response);
+        });
+    if (it == entry->pending_queue.end())
+      return;
+
+    Transaction* next = *it;
+    entry->pending_queue.erase(it);
+    entry->readers.push_back(next);
+    // Look for more transactions that can join.
+    ProcessPendingQueue(entry);
+    next->io_callback().Run(OK);
+    return;
+  }
 
   // If no one is interested in this entry, then we can deactivate it.
   if (entry->pending_queue.empty()) {
@@ -1160,4 +1444,9 @@ void HttpCache::OnBackendCreated(int result, PendingOp* pending_op) {
     item->NotifyTransaction(result, NULL);
 }
 
+void HttpCache::OnCacheEntryUsed(const GURL& url) {
+  if (push_adopter_)
+    push_adopter_->OnCacheEntryUsed(url);
+}
+
 }  // namespace net
@@ -20,6 +20,7 @@
 #include <string>
 #include <unordered_map>
 
+#include "base/feature_list.h"
 #include "base/files/file_path.h"
 #include "base/macros.h"
 #include "base/memory/weak_ptr.h"
@@ -63,6 +64,20 @@ class TransportSecurityState;
 class ViewCacheHelper;
 struct HttpRequestInfo;
 
+// Lets transactions that wait for the writer of a cache entry read its
+// response while it is being written, instead of after it is complete.
+NET_EXPORT extern const base::Feature kHttpCacheReadWhileWriting;
+
+// Opens cache entries with read ahead of the start of their body, so that a
+// cache hit gets its headers and first body bytes in a single round trip to
+// the backend.
+NET_EXPORT extern const base::Feature kHttpCacheOpenWithReadAhead;
+
+// Makes caches built on an HttpNetworkSession adopt the server pushes its
+// sessions accept, so that the pushed responses are written to the cache even
+// if no request claims them.
+NET_EXPORT extern const base::Feature kHttpCacheAdoptServerPushes;
+
 class NET_EXPORT HttpCache : public HttpTransactionFactory,
                              NON_EXPORTED_BASE(public base::NonThreadSafe) {
  public:
@@ -239,6 +254,7 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   };
 
   class MetadataWriter;
+  class PushAdopter;
   class QuicServerInfoFactoryAdaptor;
   class Transaction;
   class WorkItem;
@@ -259,6 +275,12 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
     TransactionList    pending_queue;
     bool               will_process_pending_queue;
     bool               doomed;
+    // Set while |writer| appends the body of a response that |readers| may
+    // read as it is written. See StartStreamingToReaders().
+    bool               streaming;
+    // Set when the writer stopped before the end of the body it streamed,
+    // so that the readers fail rather than end early.
+    bool               streaming_aborted;
   };
 
   using ActiveEntriesMap = std::unordered_map<std::string, ActiveEntry*>;
@@ -361,6 +383,20 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   // transactions can start reading from this entry.
   void ConvertWriterToReader(ActiveEntry* entry);
 
+  // Called by the writer of |entry| once it wrote the headers of a response,
+  // and is about to append its body. With kHttpCacheReadWhileWriting, the
+  // pending transactions that can use that response as is join the entry as
+  // readers, and read the body as it is written.
+  void StartStreamingToReaders(ActiveEntry* entry);
+
+  // Called when the writer of |entry| stops writing the streamed body before
+  // its end.
+  void StopStreamingToReaders(ActiveEntry* entry);
+
+  // Lets the readers of |entry| that caught up with its writer know that
+  // more of the body was written, or that the writer is done.
+  void NotifyStreamingReaders(ActiveEntry* entry);
+
   // Returns the LoadState of the provided pending transaction.
   LoadState GetLoadStateForPendingTransaction(const Transaction* trans);
 
@@ -400,6 +436,10 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   // Processes the backend creation notification.
   void OnBackendCreated(int result, PendingOp* pending_op);
 
+  // Called by a transaction that read the response for |url| from the cache
+  // without validating it over the network.
+  void OnCacheEntryUsed(const GURL& url);
+
   // Variables ----------------------------------------------------------------
 
   NetLog* net_log_;
@@ -430,6 +470,10 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   // A clock that can be swapped out for testing.
   std::unique_ptr<base::Clock> clock_;
 
+  // Adopts server pushes received by the network layer's session, if any, with
+  // kHttpCacheAdoptServerPushes.
+  std::unique_ptr<PushAdopter> push_adopter_;
+
   base::WeakPtrFactory<HttpCache> weak_factory_;
 
   DISALLOW_COPY_AND_ASSIGN(HttpCache);
@@ -0,0 +1,167 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/http_cache_trace_recorder.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "base/numerics/safe_conversions.h"
+#include "base/values.h"
+#include "net/log/net_log_capture_mode.h"
+
+namespace net {
+
+namespace {
+
+bool CompareRecordTimes(const disk_cache::TraceRecord& a,
+                        const disk_cache::TraceRecord& b) {
+  return a.time < b.time;
+}
+
+}  // namespace
+
+HttpCacheTraceRecorder::PendingRequest::PendingRequest()
+    : looked_up(false),
+      opened(false),
+      created(false),
+      bytes_read(0),
+      bytes_written(0) {}
+
+HttpCacheTraceRecorder::HttpCacheTraceRecorder() {}
+
+HttpCacheTraceRecorder::~HttpCacheTraceRecorder() {
+  DCHECK(!net_log());
+}
+
+void HttpCacheTraceRecorder::StartObserving(NetLog* net_log) {
+  {
+    base::AutoLock auto_lock(lock_);
+    start_ = base::TimeTicks::Now();
+  }
+  net_log->DeprecatedAddObserver(this, NetLogCaptureMode::Default());
+}
+
+void HttpCacheTraceRecorder::StopObserving() {
+  net_log()->DeprecatedRemoveObserver(this);
+  base::AutoLock auto_lock(lock_);
+  while (!pending_requests_.empty())
+    FinishRequestLocked(pending_requests_.begin()->first);
+}
+
+std::vector<disk_cache::TraceRecord> HttpCacheTraceRecorder::TakeRecords() {
+  std::vector<disk_cache::TraceRecord> records;
+  {
+    base::AutoLock auto_lock(lock_);
+    records.swap(records_);
+  }
+  // Requests are recorded when they finish; order them by start.
+  std::stable_sort(records.begin(), records.end(), &CompareRecordTimes);
+  return records;
+}
+
+void HttpCacheTraceRecorder::OnAddEntry(const NetLog::Entry& entry) {
+  switch (entry.type()) {
+    case NetLog::TYPE_HTTP_CACHE_OPEN_ENTRY:
+    case NetLog::TYPE_HTTP_CACHE_CREATE_ENTRY:
+    case NetLog::TYPE_HTTP_CACHE_DOOM_ENTRY:
+    case NetLog::TYPE_HTTP_CACHE_READ_DATA:
+    case NetLog::TYPE_HTTP_CACHE_WRITE_DATA:
+    case NetLog::TYPE_REQUEST_ALIVE:
+      break;
+    default:
+      return;
+  }
+
+  std::unique_ptr<base::Value> params = entry.ParametersToValue();
+  const base::DictionaryValue* dict = nullptr;
+  if (params)
+    params->GetAsDictionary(&dict);
+  const bool begin = entry.phase() == NetLog::PHASE_BEGIN;
+  const bool end = entry.phase() == NetLog::PHASE_END;
+  const bool failed = dict && dict->HasKey("net_error");
+  const uint32_t source_id = entry.source().id;
+
+  base::AutoLock auto_lock(lock_);
+  std::string key;
+  int byte_count;
+  switch (entry.type()) {
+    case NetLog::TYPE_HTTP_CACHE_OPEN_ENTRY:
+    case NetLog::TYPE_HTTP_CACHE_CREATE_ENTRY: {
+      if (begin && dict && dict->GetString("key", &key)) {
+        std::map<uint32_t, PendingRequest>::iterator it =
+            pending_requests_.find(source_id);
+        if (it != pending_requests_.end() && it->second.key != key)
+          FinishRequestLocked(source_id);
+        PendingRequest& request = pending_requests_[source_id];
+        if (request.key.empty()) {
+          request.key = key;
+          request.start = base::TimeTicks::Now();
+        }
+        if (entry.type() == NetLog::TYPE_HTTP_CACHE_OPEN_ENTRY)
+          request.looked_up = true;
+      }
+      std::map<uint32_t, PendingRequest>::iterator it =
+          pending_requests_.find(source_id);
+      if (end && !failed && it != pending_requests_.end()) {
+        if (entry.type() == NetLog::TYPE_HTTP_CACHE_OPEN_ENTRY)
+          it->second.opened = true;
+        else
+          it->second.created = true;
+      }
+      break;
+    }
+    case NetLog::TYPE_HTTP_CACHE_DOOM_ENTRY:
+      if (begin && dict && dict->GetString("key", &key)) {
+        records_.push_back(disk_cache::TraceRecord(
+            base::TimeTicks::Now() - start_, disk_cache::TraceRecord::DOOM, 0,
+            key));
+      }
+      break;
+    case NetLog::TYPE_HTTP_CACHE_READ_DATA:
+    case NetLog::TYPE_HTTP_CACHE_WRITE_DATA: {
+      std::map<uint32_t, PendingRequest>::iterator it =
+          pending_requests_.find(source_id);
+      if (end && it != pending_requests_.end() && dict &&
+          dict->GetInteger("byte_count", &byte_count)) {
+        if (entry.type() == NetLog::TYPE_HTTP_CACHE_READ_DATA)
+          it->second.bytes_read += byte_count;
+        else
+          it->second.bytes_written += byte_count;
+      }
+      break;
+    }
+    case NetLog::TYPE_REQUEST_ALIVE:
+      if (end)
+        FinishRequestLocked(source_id);
+      break;
+    default:
+      NOTREACHED();
+  }
+}
+
+void HttpCacheTraceRecorder::FinishRequestLocked(uint32_t source_id) {
+  lock_.AssertAcquired();
+  std::map<uint32_t, PendingRequest>::iterator it =
+      pending_requests_.find(source_id);
+  if (it == pending_requests_.end())
+    return;
+
+  const PendingRequest& request = it->second;
+  const base::TimeDelta time = request.start - start_;
+  if (request.opened || (request.looked_up && request.created)) {
+    records_.push_back(disk_cache::TraceRecord(
+        time, disk_cache::TraceRecord::READ,
+        base::saturated_cast<int>(
+            std::max(request.bytes_read, request.bytes_written)),
+        request.key));
+  } else if (request.created) {
+    records_.push_back(disk_cache::TraceRecord(
+        time, disk_cache::TraceRecord::WRITE,
+        base::saturated_cast<int>(request.bytes_written), request.key));
+  }
+  pending_requests_.erase(it);
+}
+
+}  // namespace net
@@ -0,0 +1,84 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_HTTP_HTTP_CACHE_TRACE_RECORDER_H_
+#define NET_HTTP_HTTP_CACHE_TRACE_RECORDER_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/disk_cache_trace.h"
+#include "net/log/net_log.h"
+
+namespace net {
+
+// Records the requests HttpCache transactions make to their disk cache as a
+// disk_cache::TraceRecord list, derived from the HTTP_CACHE_* events of a
+// NetLog, so that the traffic can be replayed against other cache backends.
+//
+// The cache requests of a URLRequest are recorded once it is destroyed, or
+// when it starts a new one, as after a redirect:
+//   - one that looked its entry up, and then read it or stored the response,
+//     is a READ of the larger of the sizes read and written. This covers
+//     hits, misses and responses that were revalidated or updated;
+//   - one that created its entry without a lookup, as when the cache is
+//     bypassed, is a WRITE of the size written;
+//   - one that missed without storing the response is not recorded.
+// Dooms are recorded as they start.
+//
+// Only response bodies are counted; headers and metadata are not.
+class NET_EXPORT HttpCacheTraceRecorder : public NetLog::ThreadSafeObserver {
+ public:
+  HttpCacheTraceRecorder();
+  ~HttpCacheTraceRecorder() override;
+
+  // Starts recording the events of |net_log|. Record times are relative to
+  // this call.
+  void StartObserving(NetLog* net_log);
+
+  // Stops recording, and records the requests that are still in progress.
+  void StopObserving();
+
+  // Returns the records so far, and forgets them. May be called on any
+  // thread.
+  std::vector<disk_cache::TraceRecord> TakeRecords();
+
+  // NetLog::ThreadSafeObserver:
+  void OnAddEntry(const NetLog::Entry& entry) override;
+
+ private:
+  // The cache requests of a URLRequest in progress.
+  struct PendingRequest {
+    PendingRequest();
+
+    std::string key;
+    base::TimeTicks start;
+    bool looked_up;
+    bool opened;
+    bool created;
+    int64_t bytes_read;
+    int64_t bytes_written;
+  };
+
+  // Records the request of |source_id|, if any.
+  void FinishRequestLocked(uint32_t source_id);
+
+  base::Lock lock_;
+  base::TimeTicks start_;
+  std::map<uint32_t, PendingRequest> pending_requests_;
+  std::vector<disk_cache::TraceRecord> records_;
+
+  DISALLOW_COPY_AND_ASSIGN(HttpCacheTraceRecorder);
+};
+
+}  // namespace net
+
+#endif  // NET_HTTP_HTTP_CACHE_TRACE_RECORDER_H_
@@ -79,6 +79,17 @@ enum ExternallyConditionalizedType {
   EXTERNALLY_CONDITIONALIZED_MAX
 };
 
+// Ends a HTTP_CACHE_READ_DATA or HTTP_CACHE_WRITE_DATA event, with the number
+// of bytes transferred on success.
+void EndCacheDataEvent(const BoundNetLog& net_log,
+                       NetLog::EventType type,
+                       int result) {
+  if (result >= 0)
+    net_log.EndEvent(type, NetLog::IntCallback("byte_count", result));
+  else
+    net_log.EndEventWithNetErrorCode(type, result);
+}
+
 }  // namespace
 
 struct HeaderNameAndValue {
@@ -163,6 +174,8 @@ HttpCache::Transaction::Transaction(RequestPriority priority, HttpCache* cache)
       couldnt_conditionalize_request_(false),
       bypass_lock_for_test_(false),
       fail_conditionalization_for_test_(false),
+      reading_while_writing_(false),
+      waiting_for_writer_(false),
       io_buf_len_(0),
       read_offset_(0),
       effective_load_flags_(0),
@@ -240,6 +253,39 @@ bool HttpCache::Transaction::AddTruncatedFlag() {
   return true;
 }
 
+bool HttpCache::Transaction::CanReadWhileWriting(
+    const HttpResponseInfo& response) const {
+  if (mode_ != READ_WRITE && mode_ != READ)
+    return false;
+  if (partial_ || request_->method != "GET" ||
+      (effective_load_flags_ & (LOAD_VALIDATE_CACHE | LOAD_PREFETCH))) {
+    return false;
+  }
+
+  // Same as RequiresValidation(), for a response that was just received.
+  if (response.unused_since_prefetch)
+    return false;
+  if (response.vary_data.is_valid() &&
+      !response.vary_data.MatchesRequest(*request_, *response.headers.get())) {
+    return false;
+  }
+  if (effective_load_flags_ & LOAD_PREFERRING_CACHE)
+    return true;
+  return response.headers->RequiresValidation(
+             response.request_time, response.response_time,
+             cache_->clock_->Now()) == VALIDATION_NONE;
+}
+
+void HttpCache::Transaction::OnWriterProgress() {
+  if (!waiting_for_writer_)
+    return;
+
+  // The writer may be in the middle of its own IO.
+  waiting_for_writer_ = false;
+  base::ThreadTaskRunnerHandle::Get()->PostTask(FROM_HERE,
+                                                base::Bind(io_callback_, OK));
+}
+
 LoadState HttpCache::Transaction::GetWriterLoadState() const {
   if (network_trans_.get())
     return network_trans_->GetLoadState();
@@ -407,6 +453,7 @@ void HttpCache::Transaction::StopCaching() {
   //                Fix this.
   if (cache_.get() && entry_ && (mode_ & WRITE) && network_trans_.get() &&
       !is_sparse_ && !range_requested_) {
+    cache_->StopStreamingToReaders(entry_);
     mode_ = NONE;
   }
 }
@@ -965,7 +1012,8 @@ int HttpCache::Transaction::DoOpenEntry() {
   DCHECK(!new_entry_);
   next_state_ = STATE_OPEN_ENTRY_COMPLETE;
   cache_pending_ = true;
-  net_log_.BeginEvent(NetLog::TYPE_HTTP_CACHE_OPEN_ENTRY);
+  net_log_.BeginEvent(NetLog::TYPE_HTTP_CACHE_OPEN_ENTRY,
+                      NetLog::StringCallback("key", &cache_key_));
   first_cache_access_since_ = TimeTicks::Now();
   return cache_->OpenEntry(cache_key_, &new_entry_, this);
 }
@@ -1016,7 +1064,8 @@ int HttpCache::Transaction::DoDoomEntry() {
   cache_pending_ = true;
   if (first_cache_access_since_.is_null())
     first_cache_access_since_ = TimeTicks::Now();
-  net_log_.BeginEvent(NetLog::TYPE_HTTP_CACHE_DOOM_ENTRY);
+  net_log_.BeginEvent(NetLog::TYPE_HTTP_CACHE_DOOM_ENTRY,
+                      NetLog::StringCallback("key", &cache_key_));
   return cache_->DoomEntry(cache_key_, this);
 }
 
@@ -1033,7 +1082,8 @@ int HttpCache::Transaction::DoCreateEntry() {
   DCHECK(!new_entry_);
   next_state_ = STATE_CREATE_ENTRY_COMPLETE;
   cache_pending_ = true;
-  net_log_.BeginEvent(NetLog::TYPE_HTTP_CACHE_CREATE_ENTRY);
+  net_log_.BeginEvent(NetLog::TYPE_HTTP_CACHE_CREATE_ENTRY,
+                      NetLog::StringCallback("key", &cache_key_));
   return cache_->CreateEntry(cache_key_, &new_entry_, this);
 }
 
@@ -1119,8 +1169,15 @@ int HttpCache::Transaction::DoAddToEntryComplete(int result) {
   DCHECK(new_entry_);
   cache_pending_ = false;
 
-  if (result == OK)
+  if (result == OK) {
     entry_ = new_entry_;
+    if (entry_->writer && entry_->writer != this) {
+      // We joined the writer to read its response as it is written.
+      DCHECK(entry_->streaming);
+      mode_ = READ;
+      reading_while_writing_ = true;
+    }
+  }
 
   // If there is a failure, the cache should have taken care of new_entry_.
   new_entry_ = NULL;
@@ -1624,10 +1681,8 @@ int HttpCache::Transaction::DoTruncateCachedData() {
 
 int HttpCache::Transaction::DoTruncateCachedDataComplete(int result) {
   if (entry_) {
-    if (net_log_.IsCapturing()) {
-      net_log_.EndEventWithNetErrorCode(NetLog::TYPE_HTTP_CACHE_WRITE_DATA,
-                                        result);
-    }
+    if (net_log_.IsCapturing())
+      EndCacheDataEvent(net_log_, NetLog::TYPE_HTTP_CACHE_WRITE_DATA, result);
   }
 
   next_state_ = STATE_TRUNCATE_CACHED_METADATA;
@@ -1652,6 +1707,14 @@ int HttpCache::Transaction::DoTruncateCachedMetadataComplete(int result) {
     }
   }
 
+  // Only a whole 200 response, written as it is received, can be streamed.
+  if (entry_ && mode_ == WRITE && !partial_ && !truncated_ &&
+      network_trans_ && request_->method == "GET" &&
+      !auth_response_.headers.get() && response_.headers.get() &&
+      response_.headers->response_code() == 200) {
+    cache_->StartStreamingToReaders(entry_);
+  }
+
   next_state_ = STATE_PARTIAL_HEADERS_RECEIVED;
   return OK;
 }
@@ -1727,6 +1790,10 @@ int HttpCache::Transaction::DoCacheReadData() {
   DCHECK(entry_);
   next_state_ = STATE_CACHE_READ_DATA_COMPLETE;
 
+  // The cache may have gone away while we waited for the writer.
+  if (!cache_.get())
+    return ERR_UNEXPECTED;
+
   if (net_log_.IsCapturing())
     net_log_.BeginEvent(NetLog::TYPE_HTTP_CACHE_READ_DATA);
   if (partial_) {
@@ -1740,10 +1807,8 @@ int HttpCache::Transaction::DoCacheReadData() {
 }
 
 int HttpCache::Transaction::DoCacheReadDataComplete(int result) {
-  if (net_log_.IsCapturing()) {
-    net_log_.EndEventWithNetErrorCode(NetLog::TYPE_HTTP_CACHE_READ_DATA,
-                                      result);
-  }
+  if (net_log_.IsCapturing())
+    EndCacheDataEvent(net_log_, NetLog::TYPE_HTTP_CACHE_READ_DATA, result);
 
   if (!cache_.get())
     return ERR_UNEXPECTED;
@@ -1755,10 +1820,27 @@ int HttpCache::Transaction::DoCacheReadDataComplete(int result) {
     return DoPartialCacheReadCompleted(result);
   }
 
+  if (result == 0 && reading_while_writing_) {
+    // Unless the whole body is there, either the writer did not write the
+    // rest yet, or it will never do.
+    int64_t body_size = response_.headers->GetContentLength();
+    if (body_size < 0 || read_offset_ < body_size) {
+      if (entry_->streaming_aborted)
+        return ERR_CACHE_READ_FAILURE;
+      if (entry_->writer) {
+        waiting_for_writer_ = true;
+        next_state_ = STATE_CACHE_READ_DATA;
+        return ERR_IO_PENDING;
+      }
+    }
+  }
+
   if (result > 0) {
     read_offset_ += result;
   } else if (result == 0) {  // End of file.
     RecordHistograms();
+    if (cache_entry_status_ == CacheEntryStatus::ENTRY_USED)
+      cache_->OnCacheEntryUsed(request_->url);
     cache_->DoneReadingFromEntry(entry_, this);
     entry_ = NULL;
   } else {
@@ -1785,10 +1867,8 @@ int HttpCache::Transaction::DoCacheWriteData(int num_bytes) {
 
 int HttpCache::Transaction::DoCacheWriteDataComplete(int result) {
   if (entry_) {
-    if (net_log_.IsCapturing()) {
-      net_log_.EndEventWithNetErrorCode(NetLog::TYPE_HTTP_CACHE_WRITE_DATA,
-                                        result);
-    }
+    if (net_log_.IsCapturing())
+      EndCacheDataEvent(net_log_, NetLog::TYPE_HTTP_CACHE_WRITE_DATA, result);
   }
   if (!cache_.get())
     return ERR_UNEXPECTED;
@@ -1807,6 +1887,9 @@ int HttpCache::Transaction::DoCacheWriteDataComplete(int result) {
       done_reading_ = true;
   }
 
+  if (entry_ && entry_->streaming && result > 0)
+    cache_->NotifyStreamingReaders(entry_);
+
   if (partial_) {
     // This may be the last request.
     if (result != 0 || truncated_ ||
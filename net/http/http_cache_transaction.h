@@ -118,6 +118,15 @@ class HttpCache::Transaction : public HttpTransaction {
 
   const CompletionCallback& io_callback() { return io_callback_; }
 
+  // Returns whether this pending transaction can use |response|, which is
+  // being written to the entry by another transaction, as is: it would be
+  // read without validation, and without updating the entry.
+  bool CanReadWhileWriting(const HttpResponseInfo& response) const;
+
+  // Called when the writer of the entry that this transaction reads while it
+  // is written appended more of the body, or stopped writing it.
+  void OnWriterProgress();
+
   const BoundNetLog& net_log() const;
 
   // Bypasses the cache lock whenever there is lock contention.
@@ -461,6 +470,8 @@ class HttpCache::Transaction : public HttpTransaction {
   bool couldnt_conditionalize_request_;
   bool bypass_lock_for_test_;  // A test is exercising the cache lock.
   bool fail_conditionalization_for_test_;  // Fail ConditionalizeRequest.
+  bool reading_while_writing_;  // We read the body as the writer appends it.
+  bool waiting_for_writer_;  // We read all that the writer appended so far.
   scoped_refptr<IOBuffer> read_buf_;
   int io_buf_len_;
   int read_offset_;
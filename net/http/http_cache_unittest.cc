@@ -20,6 +20,7 @@
 #include "base/run_loop.h"
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
+#include "base/test/scoped_feature_list.h"
 #include "base/test/simple_test_clock.h"
 #include "net/base/cache_type.h"
 #include "net/base/elements_upload_data_stream.h"
@@ -34,6 +35,7 @@
 #include "net/cert/x509_certificate.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/http/http_byte_range.h"
+#include "net/http/http_cache_trace_recorder.h"
 #include "net/http/http_cache_transaction.h"
 #include "net/http/http_request_headers.h"
 #include "net/http/http_request_info.h"
@@ -666,6 +668,24 @@ TEST(HttpCache, SimpleGET) {
   TestLoadTimingNetworkRequest(load_timing_info);
 }
 
+// Tests that with kHttpCacheOpenWithReadAhead, entries are opened with read
+// ahead of their body.
+TEST(HttpCache, SimpleGET_OpenWithReadAhead) {
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndEnableFeature(kHttpCacheOpenWithReadAhead);
+  MockHttpCache cache;
+
+  // Write to the cache.
+  RunTransactionTest(cache.http_cache(), kSimpleGET_Transaction);
+  // Read from the cache.
+  RunTransactionTest(cache.http_cache(), kSimpleGET_Transaction);
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, cache.disk_cache()->open_count());
+  EXPECT_EQ(2, cache.disk_cache()->read_ahead_open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
 TEST(HttpCache, SimpleGETNoDiskCache) {
   MockHttpCache cache;
 
@@ -719,6 +739,44 @@ TEST(HttpCache, SimpleGETNoDiskCache2) {
   EXPECT_FALSE(cache.http_cache()->GetCurrentBackend());
 }
 
+// Tests that the cache requests of transactions are recorded as a trace.
+TEST(HttpCache, TraceRecorder) {
+  MockHttpCache cache;
+  TestNetLog net_log;
+  HttpCacheTraceRecorder recorder;
+  recorder.StartObserving(&net_log);
+
+  MockTransaction bypass_transaction(kSimpleGET_Transaction);
+  bypass_transaction.load_flags |= LOAD_BYPASS_CACHE;
+  // A miss, a hit, then a request that bypasses the cache.
+  const MockTransaction* const transactions[] = {
+      &kSimpleGET_Transaction, &kSimpleGET_Transaction, &bypass_transaction,
+  };
+  for (const MockTransaction* transaction : transactions) {
+    BoundNetLog log =
+        BoundNetLog::Make(&net_log, NetLog::SOURCE_URL_REQUEST);
+    log.BeginEvent(NetLog::TYPE_REQUEST_ALIVE);
+    RunTransactionTestWithLog(cache.http_cache(), *transaction, log);
+    log.EndEvent(NetLog::TYPE_REQUEST_ALIVE);
+  }
+  recorder.StopObserving();
+
+  const int body_size = strlen(kSimpleGET_Transaction.data);
+  const std::string key = kSimpleGET_Transaction.url;
+  std::vector<disk_cache::TraceRecord> records = recorder.TakeRecords();
+  ASSERT_EQ(4u, records.size());
+  EXPECT_EQ(disk_cache::TraceRecord::READ, records[0].op);
+  EXPECT_EQ(body_size, records[0].size);
+  EXPECT_EQ(key, records[0].key);
+  EXPECT_EQ(disk_cache::TraceRecord::READ, records[1].op);
+  EXPECT_EQ(body_size, records[1].size);
+  EXPECT_EQ(disk_cache::TraceRecord::DOOM, records[2].op);
+  EXPECT_EQ(key, records[2].key);
+  EXPECT_EQ(disk_cache::TraceRecord::WRITE, records[3].op);
+  EXPECT_EQ(body_size, records[3].size);
+  EXPECT_TRUE(recorder.TakeRecords().empty());
+}
+
 // Tests that IOBuffers are not referenced after IO completes.
 TEST(HttpCache, ReleaseBuffer) {
   MockHttpCache cache;
@@ -1326,6 +1384,141 @@ TEST(HttpCache, SimpleGET_ManyReaders) {
   }
 }
 
+// Tests that with kHttpCacheReadWhileWriting, transactions waiting for the
+// writer read the response as it is written.
+TEST(HttpCache, SimpleGET_ReadWhileWriting) {
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndEnableFeature(kHttpCacheReadWhileWriting);
+  MockHttpCache cache;
+  MockHttpRequest request(kSimpleGET_Transaction);
+  MockHttpRequest validate_request(kSimpleGET_Transaction);
+  validate_request.load_flags = LOAD_VALIDATE_CACHE;
+
+  Context writer;
+  ASSERT_THAT(cache.CreateTransaction(&writer.trans), IsOk());
+  writer.result =
+      writer.trans->Start(&request, writer.callback.callback(), BoundNetLog());
+  ASSERT_THAT(writer.callback.GetResult(writer.result), IsOk());
+
+  const int kNumReaders = 3;
+  std::vector<std::unique_ptr<Context>> readers;
+  for (int i = 0; i < kNumReaders; ++i) {
+    readers.push_back(base::MakeUnique<Context>());
+    Context* c = readers.back().get();
+    ASSERT_THAT(cache.CreateTransaction(&c->trans), IsOk());
+    c->result =
+        c->trans->Start(&request, c->callback.callback(), BoundNetLog());
+  }
+  // A transaction that has to validate the response waits for the writer.
+  Context validator;
+  ASSERT_THAT(cache.CreateTransaction(&validator.trans), IsOk());
+  validator.result = validator.trans->Start(
+      &validate_request, validator.callback.callback(), BoundNetLog());
+  base::RunLoop().RunUntilIdle();
+  EXPECT_FALSE(validator.callback.have_result());
+
+  // The readers have the headers before the writer has the body, and wait
+  // for it.
+  const int kBufferSize = 1024;
+  std::vector<scoped_refptr<IOBuffer>> buffers;
+  for (const auto& c : readers) {
+    ASSERT_THAT(c->callback.GetResult(c->result), IsOk());
+    buffers.push_back(new IOBuffer(kBufferSize));
+    c->result = c->trans->Read(buffers.back().get(), kBufferSize,
+                               c->callback.callback());
+    EXPECT_THAT(c->result, IsError(ERR_IO_PENDING));
+  }
+
+  ReadAndVerifyTransaction(writer.trans.get(), kSimpleGET_Transaction);
+
+  const std::string expected(kSimpleGET_Transaction.data);
+  for (int i = 0; i < kNumReaders; ++i) {
+    Context* c = readers[i].get();
+    ASSERT_EQ(static_cast<int>(expected.size()), c->callback.WaitForResult());
+    EXPECT_EQ(expected, std::string(buffers[i]->data(), expected.size()));
+    std::string rest;
+    EXPECT_THAT(ReadTransaction(c->trans.get(), &rest), IsOk());
+    EXPECT_EQ("", rest);
+  }
+  readers.clear();
+
+  ASSERT_THAT(validator.callback.WaitForResult(), IsOk());
+  ReadAndVerifyTransaction(validator.trans.get(), kSimpleGET_Transaction);
+
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
+// Tests that transactions waiting for the writer of a response other than a
+// 200 wait for the whole response to be written.
+TEST(HttpCache, SimpleGET_ReadWhileWritingNot200) {
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndEnableFeature(kHttpCacheReadWhileWriting);
+  MockHttpCache cache;
+  ScopedMockTransaction transaction(kSimpleGET_Transaction);
+  transaction.status = "HTTP/1.1 203 Non-Authoritative Information";
+  MockHttpRequest request(transaction);
+
+  Context writer;
+  ASSERT_THAT(cache.CreateTransaction(&writer.trans), IsOk());
+  writer.result =
+      writer.trans->Start(&request, writer.callback.callback(), BoundNetLog());
+  ASSERT_THAT(writer.callback.GetResult(writer.result), IsOk());
+
+  Context reader;
+  ASSERT_THAT(cache.CreateTransaction(&reader.trans), IsOk());
+  reader.result =
+      reader.trans->Start(&request, reader.callback.callback(), BoundNetLog());
+  base::RunLoop().RunUntilIdle();
+  EXPECT_FALSE(reader.callback.have_result());
+
+  ReadAndVerifyTransaction(writer.trans.get(), transaction);
+  writer.trans.reset();
+
+  ASSERT_THAT(reader.callback.WaitForResult(), IsOk());
+  ReadAndVerifyTransaction(reader.trans.get(), transaction);
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
+// Tests that the readers of a response fail when its writer is cancelled
+// before the end of the body.
+TEST(HttpCache, SimpleGET_ReadWhileWritingCancelWriter) {
+  base::test::ScopedFeatureList scoped_feature_list;
+  scoped_feature_list.InitAndEnableFeature(kHttpCacheReadWhileWriting);
+  MockHttpCache cache;
+  MockHttpRequest request(kSimpleGET_Transaction);
+
+  std::unique_ptr<Context> writer(new Context());
+  ASSERT_THAT(cache.CreateTransaction(&writer->trans), IsOk());
+  writer->result = writer->trans->Start(&request, writer->callback.callback(),
+                                        BoundNetLog());
+  ASSERT_THAT(writer->callback.GetResult(writer->result), IsOk());
+
+  Context reader;
+  ASSERT_THAT(cache.CreateTransaction(&reader.trans), IsOk());
+  reader.result =
+      reader.trans->Start(&request, reader.callback.callback(), BoundNetLog());
+  ASSERT_THAT(reader.callback.GetResult(reader.result), IsOk());
+
+  scoped_refptr<IOBuffer> buffer(new IOBuffer(1024));
+  reader.result =
+      reader.trans->Read(buffer.get(), 1024, reader.callback.callback());
+  EXPECT_THAT(reader.result, IsError(ERR_IO_PENDING));
+
+  writer.reset();
+  EXPECT_THAT(reader.callback.WaitForResult(),
+              IsError(ERR_CACHE_READ_FAILURE));
+  reader.trans.reset();
+
+  // The entry was not kept.
+  RunTransactionTest(cache.http_cache(), kSimpleGET_Transaction);
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(2, cache.disk_cache()->create_count());
+}
+
 // This is a test for http://code.google.com/p/chromium/issues/detail?id=4769.
 // If cancelling a request is racing with another request for the same resource
 // finishing, we have to make sure that we remove both transactions from the
@@ -44,6 +44,8 @@
 
 #include "net/http/http_chunked_decoder.h"
 
+#include <string.h>
+
 #include <algorithm>
 
 #include "base/logging.h"
@@ -67,37 +69,41 @@ HttpChunkedDecoder::HttpChunkedDecoder()
 }
 
 int HttpChunkedDecoder::FilterBuf(char* buf, int buf_len) {
+  // Decoded data is written at |result| while the input is read at |offset|,
+  // so that each byte is moved at most once however many chunks |buf| holds.
   int result = 0;
+  int offset = 0;
 
-  while (buf_len > 0) {
+  while (offset < buf_len) {
     if (chunk_remaining_ > 0) {
       // Since |chunk_remaining_| is positive and |buf_len| an int, the minimum
       // of the two must be an int.
       int num = static_cast<int>(
-          std::min(chunk_remaining_, static_cast<int64_t>(buf_len)));
+          std::min(chunk_remaining_, static_cast<int64_t>(buf_len - offset)));
 
-      buf_len -= num;
+      if (result != offset)
+        memmove(buf + result, buf + offset, num);
+      offset += num;
       chunk_remaining_ -= num;
-
       result += num;
-      buf += num;
 
       // After each chunk's data there should be a CRLF.
       if (chunk_remaining_ == 0)
         chunk_terminator_remaining_ = true;
       continue;
     } else if (reached_eof_) {
-      bytes_after_eof_ += buf_len;
+      // The bytes after the final CRLF are left right after the decoded data.
+      bytes_after_eof_ += buf_len - offset;
+      if (result != offset)
+        memmove(buf + result, buf + offset, buf_len - offset);
       break;  // Done!
     }
 
-    int bytes_consumed = ScanForChunkRemaining(buf, buf_len);
+    int bytes_consumed = ScanForChunkRemaining(buf + offset, buf_len - offset);
     if (bytes_consumed < 0)
       return bytes_consumed; // Error
 
-    buf_len -= bytes_consumed;
-    if (buf_len > 0)
-      memmove(buf, buf + bytes_consumed, buf_len);
+    offset += bytes_consumed;
   }
 
   return result;
@@ -109,12 +115,13 @@ int HttpChunkedDecoder::ScanForChunkRemaining(const char* buf, int buf_len) {
 
   int bytes_consumed = 0;
 
-  size_t index_of_lf = base::StringPiece(buf, buf_len).find('\n');
-  if (index_of_lf != base::StringPiece::npos) {
-    buf_len = static_cast<int>(index_of_lf);
+  const char* lf = static_cast<const char*>(memchr(buf, '\n', buf_len));
+  if (lf) {
+    int index_of_lf = static_cast<int>(lf - buf);
+    buf_len = index_of_lf;
     if (buf_len && buf[buf_len - 1] == '\r')  // Eliminate a preceding CR.
       buf_len--;
-    bytes_consumed = static_cast<int>(index_of_lf) + 1;
+    bytes_consumed = index_of_lf + 1;
 
     // Make buf point to the full line buffer to parse.
     if (!line_buf_.empty()) {
@@ -136,9 +143,10 @@ int HttpChunkedDecoder::ScanForChunkRemaining(const char* buf, int buf_len) {
       chunk_terminator_remaining_ = false;
     } else if (buf_len > 0) {
       // Ignore any chunk-extensions.
-      size_t index_of_semicolon = base::StringPiece(buf, buf_len).find(';');
-      if (index_of_semicolon != base::StringPiece::npos)
-        buf_len = static_cast<int>(index_of_semicolon);
+      const char* semicolon =
+          static_cast<const char*>(memchr(buf, ';', buf_len));
+      if (semicolon)
+        buf_len = static_cast<int>(semicolon - buf);
 
       if (!ParseChunkSize(buf, buf_len, &chunk_remaining_)) {
         DLOG(ERROR) << "Failed parsing HEX from: " <<
@@ -96,7 +96,8 @@ class NET_EXPORT_PRIVATE HttpChunkedDecoder {
   // file.  This method modifies |buf| inline if necessary to remove chunk
   // markers.  The return value indicates the final size of decoded data stored
   // in |buf|.  Call reached_eof() after this method to check if end-of-file
-  // was encountered.
+  // was encountered.  Any bytes after the final CRLF are left in |buf| right
+  // after the decoded data.
   int FilterBuf(char* buf, int buf_len);
 
  private:
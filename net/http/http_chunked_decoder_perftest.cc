@@ -0,0 +1,87 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/http_chunked_decoder.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_log.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/platform_test.h"
+
+namespace net {
+
+namespace {
+
+const size_t kBodySize = 4 * 1024 * 1024;
+const int kIterations = 20;
+
+// Size of the reads the encoded body is decoded in, as HttpStreamParser would.
+const size_t kReadSize = 32 * 1024;
+
+// Returns a body of |kBodySize| bytes encoded in chunks of |chunk_size| bytes.
+std::string EncodeBody(size_t chunk_size) {
+  std::string encoded;
+  for (size_t size = 0; size < kBodySize; size += chunk_size) {
+    encoded += base::StringPrintf("%X\r\n", static_cast<unsigned>(chunk_size));
+    encoded.append(chunk_size, 'a' + size % 26);
+    encoded += "\r\n";
+  }
+  encoded += "0\r\n\r\n";
+  return encoded;
+}
+
+}  // namespace
+
+class HttpChunkedDecoderPerfTest : public PlatformTest {
+ protected:
+  // Decodes a body sent in chunks of |chunk_size| bytes and logs the decoded
+  // data rate.
+  void Decode(const char* name, size_t chunk_size) {
+    const std::string encoded = EncodeBody(chunk_size);
+    std::vector<char> buf(kReadSize);
+
+    base::TimeDelta elapsed;
+    for (int i = 0; i < kIterations; ++i) {
+      HttpChunkedDecoder decoder;
+      size_t decoded_size = 0;
+      for (size_t offset = 0; offset < encoded.size(); offset += kReadSize) {
+        size_t len = std::min(kReadSize, encoded.size() - offset);
+        memcpy(buf.data(), encoded.data() + offset, len);
+        base::TimeTicks start = base::TimeTicks::Now();
+        int rv = decoder.FilterBuf(buf.data(), static_cast<int>(len));
+        elapsed += base::TimeTicks::Now() - start;
+        ASSERT_GE(rv, 0);
+        decoded_size += rv;
+      }
+      ASSERT_TRUE(decoder.reached_eof());
+      ASSERT_LE(kBodySize, decoded_size);
+    }
+    base::LogPerfResult(name,
+                        static_cast<double>(kBodySize) * kIterations / 1024 /
+                            1024 / elapsed.InSecondsF(),
+                        "MB/s");
+  }
+};
+
+TEST_F(HttpChunkedDecoderPerfTest, TinyChunks) {
+  Decode("Http_chunked_decoder_chunks_of_16", 16);
+}
+
+TEST_F(HttpChunkedDecoderPerfTest, SmallChunks) {
+  Decode("Http_chunked_decoder_chunks_of_256", 256);
+}
+
+TEST_F(HttpChunkedDecoderPerfTest, LargeChunks) {
+  Decode("Http_chunked_decoder_chunks_of_16k", 16 * 1024);
+}
+
+}  // namespace net
@@ -394,6 +394,44 @@ TEST(HttpChunkedDecoderTest, MultipleExtraDataBlocks) {
   RunTest(inputs, arraysize(inputs), "hello", true, 11);
 }
 
+// The bytes after the final CRLF are left right after the decoded data.
+TEST(HttpChunkedDecoderTest, ExtraDataFollowsDecodedData) {
+  std::string input =
+      "5\r\nhello\r\n1;ext\r\n \r\n5\r\nworld\r\n0\r\n\r\nextra";
+  HttpChunkedDecoder decoder;
+  int n = decoder.FilterBuf(&input[0], static_cast<int>(input.size()));
+  ASSERT_EQ(11, n);
+  EXPECT_TRUE(decoder.reached_eof());
+  ASSERT_EQ(5, decoder.bytes_after_eof());
+  EXPECT_EQ("hello worldextra", input.substr(0, n + 5));
+}
+
+TEST(HttpChunkedDecoderTest, ManySmallChunks) {
+  std::string input;
+  std::string expected_output;
+  for (int i = 0; i < 1000; ++i) {
+    std::string data(i % 17 + 1, 'a' + i % 26);
+    input += base::StringPrintf("%X\r\n", static_cast<unsigned>(data.size())) +
+             data + "\r\n";
+    expected_output += data;
+  }
+  input += "0\r\n\r\n";
+
+  // Feed the input in pieces that split chunks and their markers anywhere.
+  const size_t kPieceSize = 7;
+  std::vector<std::string> pieces;
+  for (size_t i = 0; i < input.size(); i += kPieceSize)
+    pieces.push_back(input.substr(i, kPieceSize));
+  std::vector<const char*> inputs;
+  for (const std::string& piece : pieces)
+    inputs.push_back(piece.c_str());
+  RunTest(inputs.data(), inputs.size(), expected_output.c_str(), true, 0);
+
+  const char* const whole_input[] = {input.c_str()};
+  RunTest(whole_input, arraysize(whole_input), expected_output.c_str(), true,
+          0);
+}
+
 // Test when the line with the chunk length is too long.
 TEST(HttpChunkedDecoderTest, LongChunkLengthLine) {
   int big_chunk_length = HttpChunkedDecoder::kMaxLineBufLen;
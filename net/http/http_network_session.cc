@@ -60,6 +60,9 @@ ClientSocketPoolManager* CreateSocketPoolManager(
 // The maximum receive window sizes for HTTP/2 sessions and streams.
 const int32_t kSpdySessionMaxRecvWindowSize = 15 * 1024 * 1024;  // 15 MB
 const int32_t kSpdyStreamMaxRecvWindowSize = 6 * 1024 * 1024;    //  6 MB
+// Server pushes held unclaimed across all HTTP/2 and QUIC sessions.
+const size_t kServerPushMaxUnclaimedPushes = 128;
+const size_t kServerPushMaxUnclaimedBytes = 8 * 1024 * 1024;  // 8 MB
 // QUIC's socket receive buffer size.
 // We should adaptively set this buffer size, but for now, we'll use a size
 // that seems large enough to receive data at line rate for most connections,
@@ -93,6 +96,8 @@ HttpNetworkSession::Params::Params()
       enable_http2(true),
       spdy_session_max_recv_window_size(kSpdySessionMaxRecvWindowSize),
       spdy_stream_max_recv_window_size(kSpdyStreamMaxRecvWindowSize),
+      server_push_max_unclaimed_pushes(kServerPushMaxUnclaimedPushes),
+      server_push_max_unclaimed_bytes(kServerPushMaxUnclaimedBytes),
       time_func(&base::TimeTicks::Now),
       enable_http2_alternative_service_with_different_host(false),
       enable_quic_alternative_service_with_different_host(true),
@@ -146,6 +151,8 @@ HttpNetworkSession::HttpNetworkSession(const Params& params)
       http_auth_handler_factory_(params.http_auth_handler_factory),
       proxy_service_(params.proxy_service),
       ssl_config_service_(params.ssl_config_service),
+      server_push_store_(params.server_push_max_unclaimed_pushes,
+                         params.server_push_max_unclaimed_bytes),
       quic_stream_factory_(
           params.net_log,
           params.host_resolver,
@@ -238,6 +245,9 @@ HttpNetworkSession::HttpNetworkSession(const Params& params)
 
   next_protos_.push_back(kProtoHTTP11);
 
+  quic_stream_factory_.set_server_push_store(&server_push_store_);
+  spdy_session_pool_.set_server_push_store(&server_push_store_);
+
   http_server_properties_->SetMaxServerConfigsStoredInProperties(
       params.quic_max_server_configs_stored_in_properties);
 
@@ -301,6 +311,10 @@ std::unique_ptr<base::Value> HttpNetworkSession::SpdySessionPoolInfoToValue()
   return spdy_session_pool_.SpdySessionPoolInfoToValue();
 }
 
+std::unique_ptr<base::Value> HttpNetworkSession::ServerPushInfoToValue() const {
+  return server_push_store_.GetInfoAsValue();
+}
+
 std::unique_ptr<base::Value> HttpNetworkSession::QuicInfoToValue() const {
   std::unique_ptr<base::DictionaryValue> dict(new base::DictionaryValue());
   dict->Set("sessions", quic_stream_factory_.QuicStreamFactoryInfoToValue());
@@ -25,6 +25,7 @@
 #include "net/http/http_stream_factory.h"
 #include "net/quic/chromium/quic_stream_factory.h"
 #include "net/socket/next_proto.h"
+#include "net/spdy/server_push_store.h"
 #include "net/spdy/spdy_session_pool.h"
 #include "net/ssl/ssl_client_auth_cache.h"
 
@@ -92,6 +93,10 @@ class NET_EXPORT HttpNetworkSession
     bool enable_http2;
     size_t spdy_session_max_recv_window_size;
     size_t spdy_stream_max_recv_window_size;
+    // Limits on the HTTP/2 and QUIC server pushes that are held unclaimed
+    // across all sessions.
+    size_t server_push_max_unclaimed_pushes;
+    size_t server_push_max_unclaimed_bytes;
     // Source of time for SPDY connections.
     SpdySessionPool::TimeFunc time_func;
     // Whether to enable HTTP/2 Alt-Svc entries with hostname different than
@@ -224,6 +229,7 @@ class NET_EXPORT HttpNetworkSession
   SSLConfigService* ssl_config_service() { return ssl_config_service_.get(); }
   SpdySessionPool* spdy_session_pool() { return &spdy_session_pool_; }
   QuicStreamFactory* quic_stream_factory() { return &quic_stream_factory_; }
+  ServerPushStore* server_push_store() { return &server_push_store_; }
   HttpAuthHandlerFactory* http_auth_handler_factory() {
     return http_auth_handler_factory_;
   }
@@ -246,6 +252,10 @@ class NET_EXPORT HttpNetworkSession
   // Creates a Value summary of the state of the SPDY sessions.
   std::unique_ptr<base::Value> SpdySessionPoolInfoToValue() const;
 
+  // Creates a Value summary of the server pushes held by the SPDY and QUIC
+  // sessions.
+  std::unique_ptr<base::Value> ServerPushInfoToValue() const;
+
   // Creates a Value summary of the state of the QUIC sessions and
   // configuration.
   std::unique_ptr<base::Value> QuicInfoToValue() const;
@@ -292,6 +302,8 @@ class NET_EXPORT HttpNetworkSession
   SSLClientAuthCache ssl_client_auth_cache_;
   std::unique_ptr<ClientSocketPoolManager> normal_socket_pool_manager_;
   std::unique_ptr<ClientSocketPoolManager> websocket_socket_pool_manager_;
+  // Outlives the sessions, which report their pushes to it.
+  ServerPushStore server_push_store_;
   QuicStreamFactory quic_stream_factory_;
   SpdySessionPool spdy_session_pool_;
   std::unique_ptr<HttpStreamFactory> http_stream_factory_;
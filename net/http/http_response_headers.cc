@@ -9,6 +9,8 @@
 
 #include "net/http/http_response_headers.h"
 
+#include <string.h>
+
 #include <algorithm>
 #include <unordered_map>
 #include <utility>
@@ -111,6 +113,31 @@ bool ShouldUpdateHeader(base::StringPiece name) {
   return true;
 }
 
+// A persisted header layout is a sequence of little-endian 16 bit values: the
+// low and high halves of the response code, the HTTP version, and then the
+// offsets of the name and value of each parsed header within the persisted
+// headers.
+const size_t kLayoutValueSize = 2;
+const size_t kLayoutPrefixValues = 3;
+const size_t kLayoutValuesPerHeader = 4;
+
+// Name offset of a header continuation in a persisted layout.
+const uint16_t kLayoutContinuation = 0xFFFF;
+
+// Persisted headers at least this large are not described by a layout.
+const size_t kMaxLayoutHeadersSize = kLayoutContinuation;
+
+void AppendLayoutValue(uint16_t value, std::string* layout) {
+  layout->push_back(static_cast<char>(value & 0xFF));
+  layout->push_back(static_cast<char>(value >> 8));
+}
+
+uint16_t GetLayoutValue(const base::StringPiece& layout, size_t index) {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(layout.data());
+  return static_cast<uint16_t>(data[index * kLayoutValueSize] |
+                               (data[index * kLayoutValueSize + 1] << 8));
+}
+
 void CheckDoesNotHaveEmbededNulls(const std::string& str) {
   // Care needs to be taken when adding values to the raw headers string to
   // make sure it does not contain embeded NULLs. Any embeded '\0' may be
@@ -165,10 +192,43 @@ HttpResponseHeaders::HttpResponseHeaders(base::PickleIterator* iter)
     Parse(raw_input);
 }
 
+HttpResponseHeaders::HttpResponseHeaders(const StringPiece& raw_headers,
+                                         const StringPiece& layout)
+    : response_code_(-1) {
+  if (!RestoreLayout(raw_headers, layout)) {
+    raw_headers_.clear();
+    parsed_.clear();
+    Parse(raw_headers.as_string());
+  }
+}
+
 void HttpResponseHeaders::Persist(base::Pickle* pickle,
                                   PersistOptions options) {
+  Persist(pickle, options, nullptr);
+}
+
+void HttpResponseHeaders::Persist(base::Pickle* pickle,
+                                  PersistOptions options,
+                                  std::string* layout) {
+  if (layout) {
+    layout->clear();
+    const uint32_t response_code = static_cast<uint32_t>(response_code_);
+    AppendLayoutValue(static_cast<uint16_t>(response_code & 0xFFFF), layout);
+    AppendLayoutValue(static_cast<uint16_t>(response_code >> 16), layout);
+    AppendLayoutValue(static_cast<uint16_t>((http_version_.major_value() << 8) |
+                                            http_version_.minor_value()),
+                      layout);
+  }
+
   if (options == PERSIST_RAW) {
     pickle->WriteString(raw_headers_);
+    if (layout) {
+      if (raw_headers_.size() < kMaxLayoutHeadersSize) {
+        AppendToLayout(0, parsed_.size(), raw_headers_.begin(), 0, layout);
+      } else {
+        layout->clear();
+      }
+    }
     return;  // Done.
   }
 
@@ -212,6 +272,8 @@ void HttpResponseHeaders::Persist(base::Pickle* pickle,
     std::string header_name = base::ToLowerASCII(
         base::StringPiece(parsed_[i].name_begin, parsed_[i].name_end));
     if (filter_headers.find(header_name) == filter_headers.end()) {
+      if (layout)
+        AppendToLayout(i, k + 1, parsed_[i].name_begin, blob.size(), layout);
       // Make sure there is a null after the value.
       blob.append(parsed_[i].name_begin, parsed_[k].value_end);
       blob.push_back('\0');
@@ -222,6 +284,8 @@ void HttpResponseHeaders::Persist(base::Pickle* pickle,
   blob.push_back('\0');
 
   pickle->WriteString(blob);
+  if (layout && blob.size() >= kMaxLayoutHeadersSize)
+    layout->clear();
 }
 
 void HttpResponseHeaders::Update(const HttpResponseHeaders& new_headers) {
@@ -446,6 +510,102 @@ void HttpResponseHeaders::Parse(const std::string& raw_input) {
   DCHECK_EQ('\0', raw_headers_[raw_headers_.size() - 1]);
 }
 
+bool HttpResponseHeaders::RestoreLayout(const StringPiece& raw_headers,
+                                        const StringPiece& layout) {
+  if (layout.size() % kLayoutValueSize != 0)
+    return false;
+  const size_t num_values = layout.size() / kLayoutValueSize;
+  if (num_values < kLayoutPrefixValues ||
+      (num_values - kLayoutPrefixValues) % kLayoutValuesPerHeader != 0) {
+    return false;
+  }
+
+  if (raw_headers.size() < 2 || raw_headers.size() >= kMaxLayoutHeadersSize ||
+      raw_headers[raw_headers.size() - 2] != '\0' ||
+      raw_headers[raw_headers.size() - 1] != '\0') {
+    return false;
+  }
+  raw_headers_.assign(raw_headers.data(), raw_headers.size());
+
+  // Each header must lie within a line of |raw_headers| after the status line,
+  // in order, like Parse() would have found it: a name at the start of a line,
+  // followed by the first colon of the line, and values that end before the
+  // null terminating the line. Continuations lie on the line of the header
+  // they continue.
+  const size_t status_line_end = raw_headers_.find('\0');
+  size_t line_end = status_line_end;
+  size_t prev_value_end = status_line_end;
+  parsed_.reserve((num_values - kLayoutPrefixValues) / kLayoutValuesPerHeader);
+  for (size_t i = kLayoutPrefixValues; i < num_values;
+       i += kLayoutValuesPerHeader) {
+    const size_t name_begin = GetLayoutValue(layout, i);
+    const size_t name_end = GetLayoutValue(layout, i + 1);
+    const size_t value_begin = GetLayoutValue(layout, i + 2);
+    const size_t value_end = GetLayoutValue(layout, i + 3);
+
+    ParsedHeader header;
+    if (name_begin == kLayoutContinuation && name_end == kLayoutContinuation) {
+      if (parsed_.empty() || value_begin < prev_value_end)
+        return false;
+      header.name_begin = header.name_end = raw_headers_.end();
+    } else {
+      if (name_begin <= line_end || raw_headers_[name_begin - 1] != '\0' ||
+          name_begin >= name_end) {
+        return false;
+      }
+      line_end = raw_headers_.find('\0', name_begin);
+      const size_t colon = raw_headers_.find(':', name_begin);
+      if (colon >= line_end || name_end > colon || value_begin <= colon ||
+          !HttpUtil::IsToken(raw_headers_.begin() + name_begin,
+                             raw_headers_.begin() + name_end)) {
+        return false;
+      }
+      for (size_t j = name_end; j < colon; ++j) {
+        if (!HttpUtil::IsLWS(raw_headers_[j]))
+          return false;
+      }
+      header.name_begin = raw_headers_.begin() + name_begin;
+      header.name_end = raw_headers_.begin() + name_end;
+    }
+    if (value_begin > value_end || value_end > line_end)
+      return false;
+    header.value_begin = raw_headers_.begin() + value_begin;
+    header.value_end = raw_headers_.begin() + value_end;
+    parsed_.push_back(header);
+    prev_value_end = value_end;
+  }
+
+  response_code_ = static_cast<int>(
+      GetLayoutValue(layout, 0) |
+      (static_cast<uint32_t>(GetLayoutValue(layout, 1)) << 16));
+  const uint16_t http_version = GetLayoutValue(layout, 2);
+  http_version_ = HttpVersion(http_version >> 8, http_version & 0xFF);
+  return true;
+}
+
+void HttpResponseHeaders::AppendToLayout(size_t begin,
+                                         size_t end,
+                                         std::string::const_iterator src,
+                                         size_t dst,
+                                         std::string* layout) const {
+  for (size_t i = begin; i < end; ++i) {
+    const ParsedHeader& header = parsed_[i];
+    if (header.is_continuation()) {
+      AppendLayoutValue(kLayoutContinuation, layout);
+      AppendLayoutValue(kLayoutContinuation, layout);
+    } else {
+      AppendLayoutValue(
+          static_cast<uint16_t>(dst + (header.name_begin - src)), layout);
+      AppendLayoutValue(
+          static_cast<uint16_t>(dst + (header.name_end - src)), layout);
+    }
+    AppendLayoutValue(
+        static_cast<uint16_t>(dst + (header.value_begin - src)), layout);
+    AppendLayoutValue(
+        static_cast<uint16_t>(dst + (header.value_end - src)), layout);
+  }
+}
+
 // Append all of our headers to the final output string.
 void HttpResponseHeaders::GetNormalizedHeaders(std::string* output) const {
   // copy up to the null byte.  this just copies the status line.
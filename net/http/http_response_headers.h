@@ -76,10 +76,23 @@ class NET_EXPORT HttpResponseHeaders
   // be passed to the pickle's various Read* methods.
   explicit HttpResponseHeaders(base::PickleIterator* pickle_iter);
 
+  // Initializes from headers persisted by Persist() and the |layout| of their
+  // parsed form it returned, without parsing them again. Parses |raw_headers|
+  // if |layout| is empty or does not match them.
+  HttpResponseHeaders(const base::StringPiece& raw_headers,
+                      const base::StringPiece& layout);
+
   // Appends a representation of this object to the given pickle.
   // The options argument can be a combination of PersistOptions.
   void Persist(base::Pickle* pickle, PersistOptions options);
 
+  // Same as above, and also sets |layout| to a compact description of the
+  // parsed headers within the persisted ones, or clears it if they are too
+  // large to be described.
+  void Persist(base::Pickle* pickle,
+               PersistOptions options,
+               std::string* layout);
+
   // Performs header merging as described in 13.5.3 of RFC 2616.
   void Update(const HttpResponseHeaders& new_headers);
 
@@ -340,6 +353,19 @@ class NET_EXPORT HttpResponseHeaders
   // Initializes from the given raw headers.
   void Parse(const std::string& raw_input);
 
+  // Initializes from persisted headers and their layout. Returns false if
+  // |layout| does not describe |raw_headers|.
+  bool RestoreLayout(const base::StringPiece& raw_headers,
+                     const base::StringPiece& layout);
+
+  // Appends the offsets of parsed_[begin, end) to |layout|, for headers whose
+  // bytes starting at |src| are persisted at offset |dst|.
+  void AppendToLayout(size_t begin,
+                      size_t end,
+                      std::string::const_iterator src,
+                      size_t dst,
+                      std::string* layout) const;
+
   // Helper function for ParseStatusLine.
   // Tries to extract the "HTTP/X.Y" from a status line formatted like:
   //    HTTP/1.1 200 OK
@@ -12,6 +12,7 @@
 #include <memory>
 
 #include "base/pickle.h"
+#include "base/strings/string_piece.h"
 #include "base/time/time.h"
 #include "base/values.h"
 #include "net/http/http_byte_range.h"
@@ -294,6 +295,23 @@ TEST_P(PersistenceTest, Persist) {
   std::string h2;
   parsed2->GetNormalizedHeaders(&h2);
   EXPECT_EQ(std::string(test.expected_headers), h2);
+
+  // Headers restored with their layout are the same as when parsed.
+  base::Pickle layout_pickle;
+  std::string layout;
+  parsed1->Persist(&layout_pickle, test.options, &layout);
+  EXPECT_FALSE(layout.empty());
+  base::PickleIterator layout_iter(layout_pickle);
+  base::StringPiece raw_headers;
+  ASSERT_TRUE(layout_iter.ReadStringPiece(&raw_headers));
+  scoped_refptr<HttpResponseHeaders> parsed3(
+      new HttpResponseHeaders(raw_headers, layout));
+
+  std::string h3;
+  parsed3->GetNormalizedHeaders(&h3);
+  EXPECT_EQ(std::string(test.expected_headers), h3);
+  EXPECT_EQ(parsed2->response_code(), parsed3->response_code());
+  EXPECT_EQ(parsed2->GetHttpVersion(), parsed3->GetHttpVersion());
 }
 
 const struct PersistData persistence_tests[] = {
@@ -448,6 +466,147 @@ INSTANTIATE_TEST_CASE_P(HttpResponseHeaders,
                         PersistenceTest,
                         testing::ValuesIn(persistence_tests));
 
+TEST(HttpResponseHeadersTest, RestoreLayout) {
+  std::string headers =
+      "HTTP/1.1 404 Not Found\n"
+      "Cache-control:private , no-cache=\"set-cookie,server\" \n"
+      "Content-Type: text/html\n"
+      "cache-Control: no-store\n";
+  HeadersToRaw(&headers);
+  scoped_refptr<HttpResponseHeaders> parsed(new HttpResponseHeaders(headers));
+
+  base::Pickle pickle;
+  std::string layout;
+  parsed->Persist(&pickle, HttpResponseHeaders::PERSIST_RAW, &layout);
+  base::PickleIterator iter(pickle);
+  base::StringPiece raw_headers;
+  ASSERT_TRUE(iter.ReadStringPiece(&raw_headers));
+
+  scoped_refptr<HttpResponseHeaders> restored(
+      new HttpResponseHeaders(raw_headers, layout));
+  EXPECT_EQ(404, restored->response_code());
+  EXPECT_EQ(HttpVersion(1, 1), restored->GetHttpVersion());
+  EXPECT_EQ("HTTP/1.1 404 Not Found", restored->GetStatusLine());
+
+  size_t it = 0;
+  std::string value;
+  EXPECT_TRUE(restored->EnumerateHeader(&it, "cache-control", &value));
+  EXPECT_EQ("private", value);
+  EXPECT_TRUE(restored->EnumerateHeader(&it, "cache-control", &value));
+  EXPECT_EQ("no-cache=\"set-cookie,server\"", value);
+  EXPECT_TRUE(restored->EnumerateHeader(&it, "cache-control", &value));
+  EXPECT_EQ("no-store", value);
+  EXPECT_FALSE(restored->EnumerateHeader(&it, "cache-control", &value));
+  std::string mime_type;
+  EXPECT_TRUE(restored->GetMimeType(&mime_type));
+  EXPECT_EQ("text/html", mime_type);
+}
+
+// A layout that does not describe the headers is ignored.
+TEST(HttpResponseHeadersTest, RestoreLayoutMismatch) {
+  std::string headers =
+      "HTTP/1.1 200 OK\n"
+      "Content-Type: text/html\n";
+  HeadersToRaw(&headers);
+  scoped_refptr<HttpResponseHeaders> parsed(new HttpResponseHeaders(headers));
+
+  base::Pickle pickle;
+  std::string layout;
+  parsed->Persist(&pickle, HttpResponseHeaders::PERSIST_RAW, &layout);
+  base::PickleIterator iter(pickle);
+  base::StringPiece raw_headers;
+  ASSERT_TRUE(iter.ReadStringPiece(&raw_headers));
+
+  const std::string kTruncatedHeaders("HTTP/1.1 200 OK\0X: y\0\0", 22);
+  const std::string kBadLayouts[] = {
+      layout.substr(0, layout.size() - 1),
+      layout.substr(0, layout.size() - 2),
+      layout + std::string(8, '\xff'),
+  };
+  for (const std::string& bad_layout : kBadLayouts) {
+    scoped_refptr<HttpResponseHeaders> restored(
+        new HttpResponseHeaders(raw_headers, bad_layout));
+    EXPECT_TRUE(restored->HasHeaderValue("content-type", "text/html"));
+  }
+
+  scoped_refptr<HttpResponseHeaders> restored(
+      new HttpResponseHeaders(kTruncatedHeaders, layout));
+  EXPECT_EQ(200, restored->response_code());
+  EXPECT_TRUE(restored->HasHeader("x"));
+  EXPECT_FALSE(restored->HasHeader("content-type"));
+}
+
+// Response codes that do not fit 16 bits are restored intact, and the layout
+// does not depend on the byte order of the host.
+TEST(HttpResponseHeadersTest, RestoreLayoutResponseCode) {
+  std::string headers =
+      "HTTP/1.1 70000 Whatever\n"
+      "Content-Type: text/html\n";
+  HeadersToRaw(&headers);
+  scoped_refptr<HttpResponseHeaders> parsed(new HttpResponseHeaders(headers));
+  ASSERT_EQ(70000, parsed->response_code());
+
+  base::Pickle pickle;
+  std::string layout;
+  parsed->Persist(&pickle, HttpResponseHeaders::PERSIST_RAW, &layout);
+  // 70000 is 0x00011170.
+  ASSERT_LE(6u, layout.size());
+  EXPECT_EQ(std::string("\x70\x11\x01\x00\x01\x01", 6), layout.substr(0, 6));
+
+  base::PickleIterator iter(pickle);
+  base::StringPiece raw_headers;
+  ASSERT_TRUE(iter.ReadStringPiece(&raw_headers));
+  scoped_refptr<HttpResponseHeaders> restored(
+      new HttpResponseHeaders(raw_headers, layout));
+  EXPECT_EQ(70000, restored->response_code());
+  EXPECT_EQ(HttpVersion(1, 1), restored->GetHttpVersion());
+}
+
+// A layout whose offsets stay within the headers, but do not fall on the
+// lines of their names and values, is ignored.
+TEST(HttpResponseHeadersTest, RestoreLayoutMisplacedOffsets) {
+  std::string headers =
+      "HTTP/1.1 200 OK\n"
+      "Content-Type: text/html\n"
+      "X-Foo: bar\n";
+  HeadersToRaw(&headers);
+  scoped_refptr<HttpResponseHeaders> parsed(new HttpResponseHeaders(headers));
+
+  base::Pickle pickle;
+  std::string layout;
+  parsed->Persist(&pickle, HttpResponseHeaders::PERSIST_RAW, &layout);
+  base::PickleIterator iter(pickle);
+  base::StringPiece raw_headers;
+  ASSERT_TRUE(iter.ReadStringPiece(&raw_headers));
+
+  // Offsets of the name and value of the first header, after the response
+  // code and the HTTP version.
+  const size_t kNameBegin = 6;
+  const size_t kNameEnd = 8;
+  const size_t kValueEnd = 12;
+  std::string bad_layouts[4] = {layout, layout, layout, layout};
+  // The name does not start a line.
+  bad_layouts[0][kNameBegin] += 1;
+  // The name does not end at the colon.
+  bad_layouts[1][kNameEnd] -= 1;
+  // The value runs into the next line.
+  bad_layouts[2][kValueEnd] += 2;
+  // The name starts in the status line.
+  bad_layouts[3][kNameBegin] = 0;
+  bad_layouts[3][kNameBegin + 1] = 0;
+  for (const std::string& bad_layout : bad_layouts) {
+    scoped_refptr<HttpResponseHeaders> restored(
+        new HttpResponseHeaders(raw_headers, bad_layout));
+    EXPECT_TRUE(restored->HasHeaderValue("content-type", "text/html"));
+    EXPECT_TRUE(restored->HasHeaderValue("x-foo", "bar"));
+    std::string normalized;
+    std::string expected;
+    restored->GetNormalizedHeaders(&normalized);
+    parsed->GetNormalizedHeaders(&expected);
+    EXPECT_EQ(expected, normalized);
+  }
+}
+
 TEST(HttpResponseHeadersTest, EnumerateHeader_Coalesced) {
   // Ensure that commas in quoted strings are not regarded as value separators.
   // Ensure that whitespace following a value is trimmed properly.
@@ -6,6 +6,7 @@
 
 #include "base/logging.h"
 #include "base/pickle.h"
+#include "base/strings/string_piece.h"
 #include "base/time/time.h"
 #include "net/base/auth.h"
 #include "net/base/io_buffer.h"
@@ -100,6 +101,10 @@ enum {
   // trust anchor.
   RESPONSE_INFO_PKP_BYPASSED = 1 << 23,
 
+  // This bit is set if the response has the layout of its parsed headers at
+  // the end, which spares parsing them again.
+  RESPONSE_INFO_HAS_HEADERS_LAYOUT = 1 << 24,
+
   // TODO(darin): Add other bits to indicate alternate request methods.
   // For now, we don't support storing those.
 };
@@ -197,9 +202,10 @@ bool HttpResponseInfo::InitFromPickle(const base::Pickle& pickle,
     return false;
   response_time = Time::FromInternalValue(time_val);
 
-  // Read response-headers
-  headers = new HttpResponseHeaders(&iter);
-  if (headers->response_code() == -1)
+  // Read response-headers. They are restored once their layout, which follows
+  // at the end, has been read.
+  base::StringPiece raw_headers;
+  if (!iter.ReadStringPiece(&raw_headers))
     return false;
 
   // Read ssl-info
@@ -291,6 +297,16 @@ bool HttpResponseInfo::InitFromPickle(const base::Pickle& pickle,
     ssl_info.key_exchange_info = key_exchange_info;
   }
 
+  // Read the layout of the response-headers.
+  base::StringPiece headers_layout;
+  if (flags & RESPONSE_INFO_HAS_HEADERS_LAYOUT) {
+    if (!iter.ReadStringPiece(&headers_layout))
+      return false;
+  }
+  headers = new HttpResponseHeaders(raw_headers, headers_layout);
+  if (headers->response_code() == -1)
+    return false;
+
   was_fetched_via_spdy = (flags & RESPONSE_INFO_WAS_SPDY) != 0;
 
   was_npn_negotiated = (flags & RESPONSE_INFO_WAS_NPN) != 0;
@@ -311,7 +327,7 @@ bool HttpResponseInfo::InitFromPickle(const base::Pickle& pickle,
 void HttpResponseInfo::Persist(base::Pickle* pickle,
                                bool skip_transient_headers,
                                bool response_truncated) const {
-  int flags = RESPONSE_INFO_VERSION;
+  int flags = RESPONSE_INFO_VERSION | RESPONSE_INFO_HAS_HEADERS_LAYOUT;
   if (ssl_info.is_valid()) {
     flags |= RESPONSE_INFO_HAS_CERT;
     flags |= RESPONSE_INFO_HAS_CERT_STATUS;
@@ -361,7 +377,8 @@ void HttpResponseInfo::Persist(base::Pickle* pickle,
                       HttpResponseHeaders::PERSIST_SANS_SECURITY_STATE;
   }
 
-  headers->Persist(pickle, persist_options);
+  std::string headers_layout;
+  headers->Persist(pickle, persist_options, &headers_layout);
 
   if (ssl_info.is_valid()) {
     ssl_info.cert->Persist(pickle);
@@ -395,6 +412,8 @@ void HttpResponseInfo::Persist(base::Pickle* pickle,
 
   if (ssl_info.is_valid() && ssl_info.key_exchange_info != 0)
     pickle->WriteInt(ssl_info.key_exchange_info);
+
+  pickle->WriteString(headers_layout);
 }
 
 HttpResponseInfo::ConnectionInfo HttpResponseInfo::ConnectionInfoFromNextProto(
@@ -4,6 +4,9 @@
 
 #include "net/http/http_response_info.h"
 
+#include <algorithm>
+#include <string>
+
 #include "base/pickle.h"
 #include "net/http/http_response_headers.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -29,6 +32,34 @@ class HttpResponseInfoTest : public testing::Test {
   HttpResponseInfo response_info_;
 };
 
+// Headers are restored from their persisted layout as they were persisted.
+TEST_F(HttpResponseInfoTest, HeadersPersist) {
+  std::string raw_headers =
+      "HTTP/1.1 200 OK\n"
+      "Content-Type: text/html\n"
+      "Cache-Control: max-age=3600, public\n"
+      "Set-Cookie: a=b\n"
+      "Connection: keep-alive\n";
+  std::replace(raw_headers.begin(), raw_headers.end(), '\n', '\0');
+  response_info_.headers = new HttpResponseHeaders(raw_headers);
+
+  base::Pickle pickle;
+  response_info_.Persist(&pickle, true, false);
+  HttpResponseInfo restored_response_info;
+  bool truncated = false;
+  ASSERT_TRUE(restored_response_info.InitFromPickle(pickle, &truncated));
+
+  std::string normalized_headers;
+  restored_response_info.headers->GetNormalizedHeaders(&normalized_headers);
+  EXPECT_EQ(
+      "HTTP/1.1 200 OK\n"
+      "Content-Type: text/html\n"
+      "Cache-Control: max-age=3600, public\n",
+      normalized_headers);
+  EXPECT_TRUE(
+      restored_response_info.headers->HasHeaderValue("cache-control", "public"));
+}
+
 TEST_F(HttpResponseInfoTest, UnusedSincePrefetchDefault) {
   EXPECT_FALSE(response_info_.unused_since_prefetch);
 }
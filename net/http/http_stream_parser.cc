@@ -4,6 +4,7 @@
 
 #include "net/http/http_stream_parser.h"
 
+#include <algorithm>
 #include <utility>
 
 #include "base/bind.h"
@@ -210,6 +211,7 @@ HttpStreamParser::HttpStreamParser(ClientSocketHandle* connection,
       read_buf_(read_buffer),
       read_buf_unused_offset_(0),
       response_header_start_offset_(-1),
+      response_header_search_offset_(0),
       received_bytes_(0),
       sent_bytes_(0),
       response_(nullptr),
@@ -950,12 +952,18 @@ int HttpStreamParser::FindAndParseResponseHeaders() {
   if (response_header_start_offset_ < 0) {
     response_header_start_offset_ = HttpUtil::LocateStartOfStatusLine(
         read_buf_->StartOfBuffer(), read_buf_->offset());
+    response_header_search_offset_ = response_header_start_offset_;
   }
 
   if (response_header_start_offset_ >= 0) {
-    end_offset = HttpUtil::LocateEndOfHeaders(read_buf_->StartOfBuffer(),
-                                              read_buf_->offset(),
-                                              response_header_start_offset_);
+    // Headers may trickle in over many reads, so resume the search where the
+    // last one stopped. The end-of-headers marker is at most 3 bytes long, so
+    // the last 2 bytes already searched may be the start of it.
+    int search_offset = std::max(response_header_start_offset_,
+                                 response_header_search_offset_ - 2);
+    end_offset = HttpUtil::LocateEndOfHeaders(
+        read_buf_->StartOfBuffer(), read_buf_->offset(), search_offset);
+    response_header_search_offset_ = read_buf_->offset();
   } else if (read_buf_->offset() >= 8) {
     // Enough data to decide that this is an HTTP/0.9 response.
     // 8 bytes = (4 bytes of junk) + "http".length()
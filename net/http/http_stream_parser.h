@@ -221,6 +221,11 @@ class NET_EXPORT_PRIVATE HttpStreamParser {
   // -1 if not found yet.
   int response_header_start_offset_;
 
+  // The number of bytes of |read_buf_| that have already been searched for the
+  // end of the response headers, so that each read only searches the new data.
+  // Only meaningful once |response_header_start_offset_| has been found.
+  int response_header_search_offset_;
+
   // The amount of received data.  If connection is reused then intermediate
   // value may be bigger than final.
   int64_t received_bytes_;
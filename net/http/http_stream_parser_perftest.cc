@@ -0,0 +1,157 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/http_stream_parser.h"
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/memory/ref_counted.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_log.h"
+#include "base/time/time.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/http/http_request_headers.h"
+#include "net/http/http_request_info.h"
+#include "net/http/http_response_headers.h"
+#include "net/http/http_response_info.h"
+#include "net/http/http_util.h"
+#include "net/log/net_log.h"
+#include "net/socket/client_socket_handle.h"
+#include "net/socket/socket_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/platform_test.h"
+#include "url/gurl.h"
+
+namespace net {
+
+namespace {
+
+const int kIterations = 2000;
+
+// Response headers typical of a static resource served by a CDN.
+std::string BuildResponseHeaders() {
+  std::string headers =
+      "HTTP/1.1 200 OK\r\n"
+      "Date: Mon, 17 Oct 2016 10:21:14 GMT\r\n"
+      "Content-Type: application/javascript; charset=utf-8\r\n"
+      "Content-Length: 48213\r\n"
+      "Connection: keep-alive\r\n"
+      "Cache-Control: public, max-age=31536000\r\n"
+      "ETag: \"5a1f3c4e-bc55\"\r\n"
+      "Last-Modified: Thu, 13 Oct 2016 08:00:00 GMT\r\n"
+      "Expires: Tue, 17 Oct 2017 10:21:14 GMT\r\n"
+      "Vary: Accept-Encoding\r\n"
+      "Content-Encoding: gzip\r\n"
+      "Accept-Ranges: bytes\r\n"
+      "Access-Control-Allow-Origin: *\r\n"
+      "Timing-Allow-Origin: *\r\n"
+      "Strict-Transport-Security: max-age=31536000; includeSubDomains\r\n"
+      "X-Content-Type-Options: nosniff\r\n"
+      "Server: nginx/1.10.1\r\n"
+      "Age: 5215\r\n";
+  for (int i = 0; i < 6; ++i) {
+    headers += base::StringPrintf(
+        "X-Cache-Node-%d: edge-%d.fra.example-cdn.net; hit; fetch=%dms\r\n", i,
+        40 + i, 3 * i + 1);
+  }
+  headers += "\r\n";
+  return headers;
+}
+
+std::unique_ptr<ClientSocketHandle> CreateConnectedSocketHandle(
+    SequencedSocketData* data) {
+  data->set_connect_data(MockConnect(SYNCHRONOUS, OK));
+  std::unique_ptr<MockTCPClientSocket> socket(
+      new MockTCPClientSocket(AddressList(), nullptr, data));
+  TestCompletionCallback callback;
+  EXPECT_EQ(OK, socket->Connect(callback.callback()));
+
+  std::unique_ptr<ClientSocketHandle> socket_handle(new ClientSocketHandle);
+  socket_handle->SetSocket(std::move(socket));
+  return socket_handle;
+}
+
+}  // namespace
+
+class HttpStreamParserPerfTest : public PlatformTest {
+ protected:
+  HttpStreamParserPerfTest() : headers_(BuildResponseHeaders()) {}
+
+  // Reads |headers_| through an HttpStreamParser kIterations times, with the
+  // socket returning |read_size| bytes per read, and logs the parsing rate.
+  void ReadResponseHeaders(const char* name, size_t read_size) {
+    const char kRequest[] = "GET / HTTP/1.1\r\n\r\n";
+    HttpRequestInfo request_info;
+    request_info.method = "GET";
+    request_info.url = GURL("http://www.example.org/");
+
+    base::TimeDelta elapsed;
+    for (int i = 0; i < kIterations; ++i) {
+      std::vector<MockWrite> writes;
+      writes.push_back(MockWrite(SYNCHRONOUS, 0, kRequest));
+      std::vector<MockRead> reads;
+      for (size_t offset = 0; offset < headers_.size(); offset += read_size) {
+        reads.push_back(MockRead(
+            SYNCHRONOUS, headers_.data() + offset,
+            std::min(read_size, headers_.size() - offset), reads.size() + 1));
+      }
+      SequencedSocketData data(reads.data(), reads.size(), writes.data(),
+                               writes.size());
+      std::unique_ptr<ClientSocketHandle> socket_handle =
+          CreateConnectedSocketHandle(&data);
+
+      scoped_refptr<GrowableIOBuffer> read_buffer(new GrowableIOBuffer);
+      HttpStreamParser parser(socket_handle.get(), &request_info,
+                              read_buffer.get(), BoundNetLog());
+      HttpResponseInfo response_info;
+      TestCompletionCallback callback;
+      ASSERT_EQ(OK, parser.SendRequest("GET / HTTP/1.1\r\n",
+                                       HttpRequestHeaders(), &response_info,
+                                       callback.callback()));
+
+      base::TimeTicks start = base::TimeTicks::Now();
+      ASSERT_EQ(OK, parser.ReadResponseHeaders(callback.callback()));
+      elapsed += base::TimeTicks::Now() - start;
+      ASSERT_EQ(200, response_info.headers->response_code());
+    }
+    base::LogPerfResult(name, kIterations / elapsed.InSecondsF(),
+                        "responses/s");
+  }
+
+  const std::string headers_;
+};
+
+// Measures assembling and parsing a complete block of response headers into
+// HttpResponseHeaders.
+TEST_F(HttpStreamParserPerfTest, ParseResponseHeaders) {
+  const int kParseIterations = 100 * kIterations;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kParseIterations; ++i) {
+    scoped_refptr<HttpResponseHeaders> headers(new HttpResponseHeaders(
+        HttpUtil::AssembleRawHeaders(headers_.data(), headers_.size())));
+    ASSERT_EQ(200, headers->response_code());
+  }
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  base::LogPerfResult("Http_response_headers_parse",
+                      static_cast<double>(headers_.size()) * kParseIterations /
+                          1024 / 1024 / elapsed.InSecondsF(),
+                      "MB/s");
+}
+
+// Measures reading response headers that arrive in a single read, and that
+// trickle in over many small reads.
+TEST_F(HttpStreamParserPerfTest, ReadResponseHeaders) {
+  ReadResponseHeaders("Http_stream_parser_read_headers_whole", headers_.size());
+  ReadResponseHeaders("Http_stream_parser_read_headers_reads_of_16", 16);
+}
+
+}  // namespace net
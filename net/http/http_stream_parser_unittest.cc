@@ -1349,6 +1349,38 @@ TEST(HttpStreamParser, ReceivedBytesMultipleReads) {
   EXPECT_EQ(response_size, get_runner.parser()->received_bytes());
 }
 
+// Test that the end of the headers is found when the headers trickle in over
+// reads that may split the end-of-headers marker, which is searched for
+// incrementally.
+TEST(HttpStreamParser, HeadersSplitAcrossReads) {
+  const char* const kLineBreaks[] = {"\r\n", "\n"};
+  const char* const kEndsOfHeaders[] = {"\r\n\r\n", "\n\n", "\n\r\n"};
+  for (const char* line_break : kLineBreaks) {
+    for (const char* end_of_headers : kEndsOfHeaders) {
+      std::string headers = std::string("HTTP/1.1 200 OK") + line_break +
+                            "Content-Type: text/plain" + line_break +
+                            "Content-Length: 7" + end_of_headers;
+      std::string response = headers + "content";
+      for (size_t receive_length = 1; receive_length <= 4; ++receive_length) {
+        SCOPED_TRACE(receive_length);
+        std::vector<std::string> blocks;
+        for (size_t i = 0; i < response.size(); i += receive_length)
+          blocks.push_back(response.substr(i, receive_length));
+
+        SimpleGetRunner get_runner;
+        for (const std::string& block : blocks)
+          get_runner.AddRead(block);
+        get_runner.SetupParserAndSendRequest();
+        get_runner.ReadHeaders();
+        EXPECT_EQ(200, get_runner.response_info()->headers->response_code());
+        EXPECT_EQ(7, get_runner.response_info()->headers->GetContentLength());
+        EXPECT_EQ(static_cast<int64_t>(headers.size()),
+                  get_runner.parser()->received_bytes());
+      }
+    }
+  }
+}
+
 // Test that "continue" HTTP header is counted as "received_bytes".
 TEST(HttpStreamParser, ReceivedBytesIncludesContinueHeader) {
   std::string status100 = "HTTP/1.1 100 OK\r\n\r\n";
@@ -7,6 +7,8 @@
 
 #include "net/http/http_util.h"
 
+#include <string.h>
+
 #include <algorithm>
 
 #include "base/logging.h"
@@ -657,6 +659,23 @@ static const char* FindFirstNonLWS(const char* begin, const char* end) {
   return end;  // Not found.
 }
 
+// Helper used by AssembleRawHeaders, to append [begin, end) to |output|,
+// dropping any '\0' characters, which it uses as line terminators.
+static void AppendWithoutNulls(const char* begin,
+                               const char* end,
+                               std::string* output) {
+  while (begin != end) {
+    const char* null =
+        static_cast<const char*>(memchr(begin, '\0', end - begin));
+    if (!null) {
+      output->append(begin, end);
+      return;
+    }
+    output->append(begin, null);
+    begin = null + 1;
+  }
+}
+
 std::string HttpUtil::AssembleRawHeaders(const char* input_begin,
                                          int input_len) {
   std::string raw_headers;
@@ -670,9 +689,11 @@ std::string HttpUtil::AssembleRawHeaders(const char* input_begin,
   if (status_begin_offset != -1)
     input_begin += status_begin_offset;
 
-  // Copy the status line.
+  // Copy the status line. '\0' is the canonical line terminator, so any
+  // '\0' characters within the input are dropped as the lines are copied, to
+  // avoid interpreting them as line breaks.
   const char* status_line_end = FindStatusLineEnd(input_begin, input_end);
-  raw_headers.append(input_begin, status_line_end);
+  AppendWithoutNulls(input_begin, status_line_end, &raw_headers);
 
   // After the status line, every subsequent line is a header line segment.
   // Should a segment start with LWS, it is a continuation of the previous
@@ -691,28 +712,21 @@ std::string HttpUtil::AssembleRawHeaders(const char* input_begin,
     if (prev_line_continuable && IsLWS(*line_begin)) {
       // Join continuation; reduce the leading LWS to a single SP.
       raw_headers.push_back(' ');
-      raw_headers.append(FindFirstNonLWS(line_begin, line_end), line_end);
+      AppendWithoutNulls(FindFirstNonLWS(line_begin, line_end), line_end,
+                         &raw_headers);
     } else {
       // Terminate the previous line.
-      raw_headers.push_back('\n');
+      raw_headers.push_back('\0');
 
       // Copy the raw data to output.
-      raw_headers.append(line_begin, line_end);
+      AppendWithoutNulls(line_begin, line_end, &raw_headers);
 
       // Check if the current line can be continued.
       prev_line_continuable = IsLineSegmentContinuable(line_begin, line_end);
     }
   }
 
-  raw_headers.append("\n\n", 2);
-
-  // Use '\0' as the canonical line terminator. If the input already contained
-  // any embeded '\0' characters we will strip them first to avoid interpreting
-  // them as line breaks.
-  raw_headers.erase(std::remove(raw_headers.begin(), raw_headers.end(), '\0'),
-                    raw_headers.end());
-  std::replace(raw_headers.begin(), raw_headers.end(), '\n', '\0');
-
+  raw_headers.append("\0\0", 2);
   return raw_headers;
 }
 
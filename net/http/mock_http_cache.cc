@@ -370,8 +370,12 @@ bool MockDiskEntry::ignore_callbacks_ = false;
 //-----------------------------------------------------------------------------
 
 MockDiskCache::MockDiskCache()
-    : open_count_(0), create_count_(0), fail_requests_(false),
-      soft_failures_(false), double_create_check_(true),
+    : open_count_(0),
+      read_ahead_open_count_(0),
+      create_count_(0),
+      fail_requests_(false),
+      soft_failures_(false),
+      double_create_check_(true),
       fail_sparse_requests_(false) {
 }
 
@@ -419,6 +423,15 @@ int MockDiskCache::OpenEntry(const std::string& key,
   return ERR_IO_PENDING;
 }
 
+int MockDiskCache::OpenEntryWithReadAhead(
+    const std::string& key,
+    int read_ahead_size,
+    disk_cache::Entry** entry,
+    const CompletionCallback& callback) {
+  read_ahead_open_count_++;
+  return OpenEntry(key, entry, callback);
+}
+
 int MockDiskCache::CreateEntry(const std::string& key,
                                disk_cache::Entry** entry,
                                const CompletionCallback& callback) {
@@ -515,6 +528,10 @@ void MockDiskCache::GetStats(base::StringPairs* stats) {
 void MockDiskCache::OnExternalCacheHit(const std::string& key) {
 }
 
+bool MockDiskCache::MayHaveEntry(const std::string& key) const {
+  return true;
+}
+
 void MockDiskCache::ReleaseAll() {
   EntryMap::iterator it = entries_.begin();
   for (; it != entries_.end(); ++it)
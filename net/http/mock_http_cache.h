@@ -119,6 +119,10 @@ class MockDiskCache : public disk_cache::Backend {
   int OpenEntry(const std::string& key,
                 disk_cache::Entry** entry,
                 const CompletionCallback& callback) override;
+  int OpenEntryWithReadAhead(const std::string& key,
+                             int read_ahead_size,
+                             disk_cache::Entry** entry,
+                             const CompletionCallback& callback) override;
   int CreateEntry(const std::string& key,
                   disk_cache::Entry** entry,
                   const CompletionCallback& callback) override;
@@ -134,10 +138,14 @@ class MockDiskCache : public disk_cache::Backend {
   std::unique_ptr<Iterator> CreateIterator() override;
   void GetStats(base::StringPairs* stats) override;
   void OnExternalCacheHit(const std::string& key) override;
+  bool MayHaveEntry(const std::string& key) const override;
 
   // Returns number of times a cache entry was successfully opened.
   int open_count() const { return open_count_; }
 
+  // Returns number of times OpenEntryWithReadAhead() was called.
+  int read_ahead_open_count() const { return read_ahead_open_count_; }
+
   // Returns number of times a cache entry was successfully created.
   int create_count() const { return create_count_; }
 
@@ -163,6 +171,7 @@ class MockDiskCache : public disk_cache::Backend {
 
   EntryMap entries_;
   int open_count_;
+  int read_ahead_open_count_;
   int create_count_;
   bool fail_requests_;
   bool soft_failures_;
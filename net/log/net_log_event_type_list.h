@@ -903,9 +903,17 @@ EVENT_TYPE(URL_REQUEST_FILTERS_SET)
 EVENT_TYPE(HTTP_CACHE_GET_BACKEND)
 
 // Measures the time while opening a disk cache entry.
+// The BEGIN phase contains the following parameters:
+//   {
+//     "key": <The key of the entry>,
+//   }
 EVENT_TYPE(HTTP_CACHE_OPEN_ENTRY)
 
 // Measures the time while creating a disk cache entry.
+// The BEGIN phase contains the following parameters:
+//   {
+//     "key": <The key of the entry>,
+//   }
 EVENT_TYPE(HTTP_CACHE_CREATE_ENTRY)
 
 // Measures the time it takes to add a HttpCache::Transaction to an http cache
@@ -913,6 +921,10 @@ EVENT_TYPE(HTTP_CACHE_CREATE_ENTRY)
 EVENT_TYPE(HTTP_CACHE_ADD_TO_ENTRY)
 
 // Measures the time while deleting a disk cache entry.
+// The BEGIN phase contains the following parameters:
+//   {
+//     "key": <The key of the entry>,
+//   }
 EVENT_TYPE(HTTP_CACHE_DOOM_ENTRY)
 
 // Measures the time while reading/writing a disk cache entry's response headers
@@ -921,6 +933,11 @@ EVENT_TYPE(HTTP_CACHE_READ_INFO)
 EVENT_TYPE(HTTP_CACHE_WRITE_INFO)
 
 // Measures the time while reading/writing a disk cache entry's body.
+// On success, the END phase contains the following parameters:
+//   {
+//     "byte_count": <Number of bytes read or written>,
+//   }
+// On failure, it contains the "net_error" parameter instead.
 EVENT_TYPE(HTTP_CACHE_READ_DATA)
 EVENT_TYPE(HTTP_CACHE_WRITE_DATA)
 
@@ -142,6 +142,29 @@ std::unique_ptr<base::Value> NetLogQuicPushPromiseReceivedCallback(
   return std::move(dict);
 }
 
+// Handle to a promised stream, held by the ServerPushStore. The store may
+// cancel pushes while the session is handling a frame, so the stream is reset
+// from a posted task.
+class QuicServerPush : public ServerPushStore::Push {
+ public:
+  QuicServerPush(const base::WeakPtr<QuicChromiumClientSession>& session,
+                 QuicStreamId promised_id)
+      : session_(session), promised_id_(promised_id) {}
+  ~QuicServerPush() override {}
+
+  void Cancel() override {
+    base::ThreadTaskRunnerHandle::Get()->PostTask(
+        FROM_HERE, base::Bind(&QuicChromiumClientSession::CancelPush,
+                              session_, promised_id_));
+  }
+
+ private:
+  const base::WeakPtr<QuicChromiumClientSession> session_;
+  const QuicStreamId promised_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicServerPush);
+};
+
 class HpackEncoderDebugVisitor : public QuicHeadersStream::HpackDebugVisitor {
   void OnUseEntry(QuicTime::Delta elapsed) override {
     UMA_HISTOGRAM_TIMES(
@@ -267,6 +290,11 @@ QuicChromiumClientSession::QuicChromiumClientSession(
 }
 
 QuicChromiumClientSession::~QuicChromiumClientSession() {
+  ServerPushStore* store = server_push_store();
+  if (store) {
+    for (const auto& push_id : push_ids_)
+      store->OnPushDiscarded(push_id.second);
+  }
   if (!dynamic_streams().empty())
     RecordUnexpectedOpenStreams(DESTRUCTOR);
   if (!observers_.empty())
@@ -1218,13 +1246,42 @@ void QuicChromiumClientSession::HandlePromised(QuicStreamId id,
   net_log_.AddEvent(NetLog::TYPE_QUIC_SESSION_PUSH_PROMISE_RECEIVED,
                     base::Bind(&NetLogQuicPushPromiseReceivedCallback, &headers,
                                id, promised_id));
+  ServerPushStore* store = server_push_store();
+  QuicClientPromisedInfo* promised = GetPromisedById(promised_id);
+  if (store && promised) {
+    push_ids_[promised_id] = store->OnPushAccepted(
+        GURL(promised->url()), server_id_.privacy_mode(),
+        base::WrapUnique(new QuicServerPush(GetWeakPtr(), promised_id)));
+  }
 }
 
 void QuicChromiumClientSession::DeletePromised(
     QuicClientPromisedInfo* promised) {
-  if (IsOpenStream(promised->id()))
+  bool claimed = IsOpenStream(promised->id());
+  if (claimed)
     streams_pushed_and_claimed_count_++;
+  auto it = push_ids_.find(promised->id());
+  if (it != push_ids_.end()) {
+    ServerPushStore* store = server_push_store();
+    if (store) {
+      if (claimed)
+        store->OnPushClaimed(it->second);
+      else
+        store->OnPushDiscarded(it->second);
+    }
+    push_ids_.erase(it);
+  }
   QuicClientSessionBase::DeletePromised(promised);
 }
 
+void QuicChromiumClientSession::CancelPush(QuicStreamId promised_id) {
+  QuicClientPromisedInfo* promised = GetPromisedById(promised_id);
+  if (promised)
+    promised->Reset(QUIC_STREAM_CANCELLED);
+}
+
+ServerPushStore* QuicChromiumClientSession::server_push_store() const {
+  return stream_factory_ ? stream_factory_->server_push_store() : nullptr;
+}
+
 }  // namespace net
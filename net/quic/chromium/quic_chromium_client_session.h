@@ -13,6 +13,7 @@
 #include <stddef.h>
 
 #include <list>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
@@ -35,6 +36,7 @@
 #include "net/quic/core/quic_server_id.h"
 #include "net/quic/core/quic_time.h"
 #include "net/socket/socket_performance_watcher.h"
+#include "net/spdy/server_push_store.h"
 
 namespace net {
 
@@ -284,6 +286,9 @@ class NET_EXPORT_PRIVATE QuicChromiumClientSession
 
   void DeletePromised(QuicClientPromisedInfo* promised) override;
 
+  // Resets the promised stream |promised_id|, if it has not been claimed.
+  void CancelPush(QuicStreamId promised_id);
+
  protected:
   // QuicSession methods:
   bool ShouldCreateIncomingDynamicStream(QuicStreamId id) override;
@@ -334,6 +339,9 @@ class NET_EXPORT_PRIVATE QuicChromiumClientSession
 
   void OnConnectTimeout();
 
+  // Returns the store that accepted pushes are reported to, or null.
+  ServerPushStore* server_push_store() const;
+
   QuicServerId server_id_;
   bool require_confirmation_;
   std::unique_ptr<QuicCryptoClientStream> crypto_stream_;
@@ -365,6 +373,8 @@ class NET_EXPORT_PRIVATE QuicChromiumClientSession
   // UMA histogram counters for streams pushed to this session.
   int streams_pushed_count_;
   int streams_pushed_and_claimed_count_;
+  // Ids in the ServerPushStore of the promised streams, by stream id.
+  std::map<QuicStreamId, ServerPushStore::PushId> push_ids_;
   // Return value from packet rewrite packet on new socket. Used
   // during connection migration on socket write error.
   int error_code_from_rewrite_;
@@ -169,6 +169,9 @@ int QuicHttpStream::InitializeStream(const HttpRequestInfo* request_info,
     return OK;
   }
 
+  if (request_info_->load_flags & LOAD_ONLY_FROM_PUSH)
+    return ERR_FAILED;
+
   next_state_ = STATE_REQUEST_STREAM;
   int rv = DoLoop(OK);
   if (rv == ERR_IO_PENDING)
@@ -800,6 +800,7 @@ QuicStreamFactory::QuicStreamFactory(
       check_persisted_supports_quic_(true),
       has_initialized_data_(false),
       num_push_streams_created_(0),
+      server_push_store_(nullptr),
       status_(OPEN),
       task_runner_(nullptr),
       ssl_config_service_(ssl_config_service),
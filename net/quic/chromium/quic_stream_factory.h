@@ -56,6 +56,7 @@ class QuicRandom;
 class QuicServerInfo;
 class QuicServerInfoFactory;
 class QuicStreamFactory;
+class ServerPushStore;
 class SocketPerformanceWatcherFactory;
 class TransportSecurityState;
 class BidirectionalStreamImpl;
@@ -365,6 +366,12 @@ class NET_EXPORT_PRIVATE QuicStreamFactory
   void set_quic_server_info_factory(
       QuicServerInfoFactory* quic_server_info_factory);
 
+  // The store that sessions report the pushes they accept to. May be null.
+  ServerPushStore* server_push_store() { return server_push_store_; }
+  void set_server_push_store(ServerPushStore* server_push_store) {
+    server_push_store_ = server_push_store;
+  }
+
   bool enable_connection_racing() const { return enable_connection_racing_; }
   void set_enable_connection_racing(bool enable_connection_racing) {
     enable_connection_racing_ = enable_connection_racing;
@@ -638,6 +645,8 @@ class NET_EXPORT_PRIVATE QuicStreamFactory
 
   QuicClientPushPromiseIndex push_promise_index_;
 
+  ServerPushStore* server_push_store_;
+
   // Current status of the factory's ability to create streams.
   FactoryStatus status_;
 
@@ -115,7 +115,7 @@ bool HttpConnection::QueuedWriteIOBuffer::Append(const std::string& data) {
     return false;
   }
 
-  pending_data_.push(data);
+  pending_data_.push_back(data);
   total_size_ += data.size();
 
   // If new data is the first pending data, updates data_.
@@ -133,7 +133,7 @@ void HttpConnection::QueuedWriteIOBuffer::DidConsume(int size) {
   if (size < GetSizeToWrite()) {
     data_ += size;
   } else {  // size == GetSizeToWrite(). Updates data_ to next pending data.
-    pending_data_.pop();
+    pending_data_.pop_front();
     data_ = IsEmpty() ? NULL : const_cast<char*>(pending_data_.front().data());
   }
   total_size_ -= size;
@@ -150,11 +150,39 @@ int HttpConnection::QueuedWriteIOBuffer::GetSizeToWrite() const {
   return pending_data_.front().size() - consumed;
 }
 
+void HttpConnection::QueuedWriteIOBuffer::Coalesce(int max_size) {
+  if (pending_data_.size() < 2)
+    return;
+  int size = GetSizeToWrite();
+  size_t count = 1;
+  while (count < pending_data_.size() &&
+         size + static_cast<int>(pending_data_[count].size()) <= max_size) {
+    size += pending_data_[count].size();
+    ++count;
+  }
+  if (count == 1)
+    return;
+
+  std::string merged;
+  merged.reserve(size);
+  merged.append(data_, GetSizeToWrite());
+  for (size_t i = 1; i < count; ++i)
+    merged.append(pending_data_[i]);
+  pending_data_.erase(pending_data_.begin(), pending_data_.begin() + count);
+  pending_data_.push_front(std::move(merged));
+  data_ = const_cast<char*>(pending_data_.front().data());
+}
+
 HttpConnection::HttpConnection(int id, std::unique_ptr<StreamSocket> socket)
     : id_(id),
       socket_(std::move(socket)),
       read_buf_(new ReadIOBuffer()),
-      write_buf_(new QueuedWriteIOBuffer()) {}
+      write_buf_(new QueuedWriteIOBuffer()),
+      write_pending_(false),
+      write_batch_depth_(0),
+      pending_responses_(0),
+      close_after_responses_(false),
+      sending_chunked_response_(false) {}
 
 HttpConnection::~HttpConnection() {
 }
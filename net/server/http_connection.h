@@ -5,8 +5,8 @@
 #ifndef NET_SERVER_HTTP_CONNECTION_H_
 #define NET_SERVER_HTTP_CONNECTION_H_
 
+#include <deque>
 #include <memory>
-#include <queue>
 #include <string>
 
 #include "base/macros.h"
@@ -91,6 +91,12 @@ class HttpConnection {
     // Gets size of data to write this time. It is NOT total data size.
     int GetSizeToWrite() const;
 
+    // Merges the pending data that follows the data to write this time into
+    // it, as long as the result is no larger than |max_size|, so that small
+    // pieces of data are written with a single call. It changes data(), so it
+    // must not be called while data() is being written.
+    void Coalesce(int max_size);
+
     // Total size of all pending data.
     int total_size() const { return total_size_; }
 
@@ -103,7 +109,7 @@ class HttpConnection {
    private:
     ~QueuedWriteIOBuffer() override;
 
-    std::queue<std::string> pending_data_;
+    std::deque<std::string> pending_data_;
     int total_size_;
     int max_buffer_size_;
 
@@ -121,6 +127,33 @@ class HttpConnection {
   WebSocket* web_socket() const { return web_socket_.get(); }
   void SetWebSocket(std::unique_ptr<WebSocket> web_socket);
 
+  // Whether a write of write_buf() to the socket is in progress.
+  bool write_pending() const { return write_pending_; }
+  void set_write_pending(bool write_pending) { write_pending_ = write_pending; }
+
+  // Nesting depth of the write batches data sent to this connection is
+  // currently deferred by.
+  int write_batch_depth() const { return write_batch_depth_; }
+  void set_write_batch_depth(int depth) { write_batch_depth_ = depth; }
+
+  // Number of requests passed to the delegate that have not been completely
+  // responded to yet.
+  int pending_responses() const { return pending_responses_; }
+  void set_pending_responses(int pending_responses) {
+    pending_responses_ = pending_responses;
+  }
+
+  // Whether the client is not going to reuse the connection, which is closed
+  // as soon as all pending responses have been written.
+  bool close_after_responses() const { return close_after_responses_; }
+  void set_close_after_responses() { close_after_responses_ = true; }
+
+  // Whether a chunked response is being streamed.
+  bool sending_chunked_response() const { return sending_chunked_response_; }
+  void set_sending_chunked_response(bool sending_chunked_response) {
+    sending_chunked_response_ = sending_chunked_response;
+  }
+
  private:
   const int id_;
   const std::unique_ptr<StreamSocket> socket_;
@@ -129,6 +162,12 @@ class HttpConnection {
 
   std::unique_ptr<WebSocket> web_socket_;
 
+  bool write_pending_;
+  int write_batch_depth_;
+  int pending_responses_;
+  bool close_after_responses_;
+  bool sending_chunked_response_;
+
   DISALLOW_COPY_AND_ASSIGN(HttpConnection);
 };
 
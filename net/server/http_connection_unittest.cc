@@ -327,5 +327,45 @@ TEST(HttpConnectionTest, QueuedWriteIOBuffer_TotalSizeLimit) {
   EXPECT_EQ(kDataLength * 4 - kConsumedLength, buffer->total_size());
 }
 
+TEST(HttpConnectionTest, QueuedWriteIOBuffer_Coalesce) {
+  scoped_refptr<HttpConnection::QueuedWriteIOBuffer> buffer(
+      new HttpConnection::QueuedWriteIOBuffer());
+  // Nothing to merge.
+  buffer->Coalesce(100);
+  EXPECT_TRUE(buffer->IsEmpty());
+
+  const std::string kData("headers");
+  const std::string kData2("body");
+  const std::string kData3(100, 'x');
+  EXPECT_TRUE(buffer->Append(kData));
+  EXPECT_TRUE(buffer->Append(kData2));
+  EXPECT_TRUE(buffer->Append(kData3));
+  const int kTotalSize = kData.size() + kData2.size() + kData3.size();
+
+  // Data already partially written is merged from where it was left.
+  const int kConsumedLength = 2;
+  buffer->DidConsume(kConsumedLength);
+
+  // Merges data only as long as it fits |max_size|.
+  buffer->Coalesce(kData.size() + kData2.size());
+  EXPECT_EQ(kData.substr(kConsumedLength) + kData2,
+            base::StringPiece(buffer->data(), buffer->GetSizeToWrite()));
+  EXPECT_EQ(kTotalSize - kConsumedLength, buffer->total_size());
+
+  // Data too large to be merged is left as is.
+  buffer->Coalesce(kData3.size());
+  EXPECT_EQ(kData.substr(kConsumedLength) + kData2,
+            base::StringPiece(buffer->data(), buffer->GetSizeToWrite()));
+
+  buffer->Coalesce(kTotalSize);
+  EXPECT_EQ(kData.substr(kConsumedLength) + kData2 + kData3,
+            base::StringPiece(buffer->data(), buffer->GetSizeToWrite()));
+  EXPECT_EQ(kTotalSize - kConsumedLength, buffer->total_size());
+
+  buffer->DidConsume(buffer->GetSizeToWrite());
+  EXPECT_TRUE(buffer->IsEmpty());
+  EXPECT_EQ(0, buffer->total_size());
+}
+
 }  // namespace
 }  // namespace net
@@ -30,11 +30,20 @@
 
 namespace net {
 
+namespace {
+
+// Pending data is merged into writes of up to this size, so that small
+// responses to pipelined requests do not each take a write.
+const int kMaxCoalescedWriteSize = 64 * 1024;
+
+}  // namespace
+
 HttpServer::HttpServer(std::unique_ptr<ServerSocket> server_socket,
                        HttpServer::Delegate* delegate)
     : server_socket_(std::move(server_socket)),
       delegate_(delegate),
       last_id_(0),
+      close_after_responses_(false),
       weak_ptr_factory_(this) {
   DCHECK(server_socket_);
   // Start accepting connections in next run loop in case when delegate is not
@@ -72,15 +81,16 @@ void HttpServer::SendRaw(int connection_id, const std::string& data) {
   HttpConnection* connection = FindConnection(connection_id);
   if (connection == NULL)
     return;
-
-  bool writing_in_progress = !connection->write_buf()->IsEmpty();
-  if (connection->write_buf()->Append(data) && !writing_in_progress)
-    DoWriteLoop(connection);
+  QueueData(connection, data);
 }
 
 void HttpServer::SendResponse(int connection_id,
                               const HttpServerResponseInfo& response) {
-  SendRaw(connection_id, response.Serialize());
+  HttpConnection* connection = FindConnection(connection_id);
+  if (connection == NULL)
+    return;
+  DCHECK(!connection->sending_chunked_response());
+  QueueData(connection, response.Serialize());
 }
 
 void HttpServer::Send(int connection_id,
@@ -89,8 +99,7 @@ void HttpServer::Send(int connection_id,
                       const std::string& content_type) {
   HttpServerResponseInfo response(status_code);
   response.SetContentHeaders(data.size(), content_type);
-  SendResponse(connection_id, response);
-  SendRaw(connection_id, data);
+  SendCompleteResponse(connection_id, response, data);
 }
 
 void HttpServer::Send200(int connection_id,
@@ -100,11 +109,58 @@ void HttpServer::Send200(int connection_id,
 }
 
 void HttpServer::Send404(int connection_id) {
-  SendResponse(connection_id, HttpServerResponseInfo::CreateFor404());
+  SendCompleteResponse(connection_id, HttpServerResponseInfo::CreateFor404(),
+                       std::string());
 }
 
 void HttpServer::Send500(int connection_id, const std::string& message) {
-  SendResponse(connection_id, HttpServerResponseInfo::CreateFor500(message));
+  SendCompleteResponse(connection_id,
+                       HttpServerResponseInfo::CreateFor500(message),
+                       std::string());
+}
+
+void HttpServer::StartChunkedResponse(int connection_id,
+                                      const HttpServerResponseInfo& response) {
+  HttpConnection* connection = FindConnection(connection_id);
+  if (connection == NULL)
+    return;
+  DCHECK(!connection->sending_chunked_response());
+  DCHECK(response.body().empty());
+
+  HttpServerResponseInfo chunked_response(response);
+  chunked_response.AddHeader("Transfer-Encoding", "chunked");
+  connection->set_sending_chunked_response(true);
+  QueueData(connection, chunked_response.Serialize());
+}
+
+void HttpServer::SendChunk(int connection_id, const std::string& data) {
+  HttpConnection* connection = FindConnection(connection_id);
+  if (connection == NULL)
+    return;
+  DCHECK(connection->sending_chunked_response());
+  // An empty chunk would end the body.
+  if (data.empty())
+    return;
+
+  BeginWriteBatch(connection);
+  QueueData(connection, base::StringPrintf("%X\r\n",
+                                           static_cast<unsigned>(data.size())));
+  QueueData(connection, data);
+  QueueData(connection, "\r\n");
+  EndWriteBatch(connection);
+}
+
+void HttpServer::FinishChunkedResponse(int connection_id) {
+  HttpConnection* connection = FindConnection(connection_id);
+  if (connection == NULL)
+    return;
+  DCHECK(connection->sending_chunked_response());
+
+  connection->set_sending_chunked_response(false);
+  BeginWriteBatch(connection);
+  QueueData(connection, "0\r\n\r\n");
+  DidSendResponse(connection);
+  EndWriteBatch(connection);
 }
 
 void HttpServer::Close(int connection_id) {
@@ -206,8 +262,20 @@ int HttpServer::HandleReadResult(HttpConnection* connection, int rv) {
     return rv == 0 ? ERR_CONNECTION_CLOSED : rv;
   }
 
+  connection->read_buf()->DidRead(rv);
+
+  // Responses sent while handling the requests of this read, in particular to
+  // pipelined requests, are written together once all have been handled.
+  BeginWriteBatch(connection);
+  rv = HandleReceivedData(connection);
+  EndWriteBatch(connection);
+  if (rv == OK && HasClosedConnection(connection))
+    return ERR_CONNECTION_CLOSED;
+  return rv;
+}
+
+int HttpServer::HandleReceivedData(HttpConnection* connection) {
   HttpConnection::ReadIOBuffer* read_buf = connection->read_buf();
-  read_buf->DidRead(rv);
 
   // Handles http requests or websocket messages.
   while (read_buf->GetSize() > 0) {
@@ -228,6 +296,14 @@ int HttpServer::HandleReadResult(HttpConnection* connection, int rv) {
       continue;
     }
 
+    // The client sends no further requests on a connection it asked to close.
+    // It is still read from, to notice when the client closes it, which is
+    // the only way to know when responses sent with SendRaw() are done.
+    if (connection->close_after_responses()) {
+      read_buf->DidConsume(read_buf->GetSize());
+      break;
+    }
+
     HttpServerRequestInfo request;
     size_t pos = 0;
     if (!ParseHeaders(read_buf->StartOfBuffer(), read_buf->GetSize(),
@@ -270,6 +346,9 @@ int HttpServer::HandleReadResult(HttpConnection* connection, int rv) {
     }
 
     read_buf->DidConsume(pos);
+    connection->set_pending_responses(connection->pending_responses() + 1);
+    if (close_after_responses_ && !request.IsKeepAlive())
+      connection->set_close_after_responses();
     delegate_->OnHttpRequest(connection->id(), request);
     if (HasClosedConnection(connection))
       return ERR_CONNECTION_CLOSED;
@@ -282,15 +361,22 @@ void HttpServer::DoWriteLoop(HttpConnection* connection) {
   int rv = OK;
   HttpConnection::QueuedWriteIOBuffer* write_buf = connection->write_buf();
   while (rv == OK && write_buf->GetSizeToWrite() > 0) {
+    write_buf->Coalesce(kMaxCoalescedWriteSize);
     rv = connection->socket()->Write(
         write_buf,
         write_buf->GetSizeToWrite(),
         base::Bind(&HttpServer::OnWriteCompleted,
                    weak_ptr_factory_.GetWeakPtr(), connection->id()));
-    if (rv == ERR_IO_PENDING || rv == OK)
+    if (rv == ERR_IO_PENDING) {
+      connection->set_write_pending(true);
+      return;
+    }
+    if (rv == OK)
       return;
     rv = HandleWriteResult(connection, rv);
   }
+  if (rv == OK)
+    MaybeCloseAfterResponses(connection);
 }
 
 void HttpServer::OnWriteCompleted(int connection_id, int rv) {
@@ -298,6 +384,7 @@ void HttpServer::OnWriteCompleted(int connection_id, int rv) {
   if (!connection)  // It might be closed right before by read error.
     return;
 
+  connection->set_write_pending(false);
   if (HandleWriteResult(connection, rv) == OK)
     DoWriteLoop(connection);
 }
@@ -312,6 +399,73 @@ int HttpServer::HandleWriteResult(HttpConnection* connection, int rv) {
   return OK;
 }
 
+void HttpServer::QueueData(HttpConnection* connection,
+                           const std::string& data) {
+  if (connection->write_buf()->Append(data) && !connection->write_pending() &&
+      connection->write_batch_depth() == 0) {
+    DoWriteLoop(connection);
+  }
+}
+
+void HttpServer::BeginWriteBatch(HttpConnection* connection) {
+  connection->set_write_batch_depth(connection->write_batch_depth() + 1);
+}
+
+void HttpServer::EndWriteBatch(HttpConnection* connection) {
+  DCHECK_GT(connection->write_batch_depth(), 0);
+  connection->set_write_batch_depth(connection->write_batch_depth() - 1);
+  if (connection->write_batch_depth() > 0 || connection->write_pending() ||
+      HasClosedConnection(connection)) {
+    return;
+  }
+  // Also closes the connection if the batch completed its last response.
+  DoWriteLoop(connection);
+}
+
+void HttpServer::SendCompleteResponse(int connection_id,
+                                      const HttpServerResponseInfo& response,
+                                      const std::string& body) {
+  HttpConnection* connection = FindConnection(connection_id);
+  if (connection == NULL)
+    return;
+  DCHECK(!connection->sending_chunked_response());
+
+  BeginWriteBatch(connection);
+  QueueData(connection, response.Serialize());
+  if (!body.empty())
+    QueueData(connection, body);
+  DidSendResponse(connection);
+  EndWriteBatch(connection);
+}
+
+void HttpServer::DidSendResponse(HttpConnection* connection) {
+  if (connection->pending_responses() > 0)
+    connection->set_pending_responses(connection->pending_responses() - 1);
+}
+
+bool HttpServer::ShouldCloseAfterResponses(HttpConnection* connection) {
+  return connection->close_after_responses() &&
+         connection->pending_responses() == 0 &&
+         connection->write_batch_depth() == 0 &&
+         !connection->write_pending() && connection->write_buf()->IsEmpty();
+}
+
+void HttpServer::MaybeCloseAfterResponses(HttpConnection* connection) {
+  if (!ShouldCloseAfterResponses(connection))
+    return;
+  // This may run from within the call the delegate made to send the last
+  // response, so the delegate is told about the close from a fresh stack.
+  base::ThreadTaskRunnerHandle::Get()->PostTask(
+      FROM_HERE, base::Bind(&HttpServer::CloseAfterResponses,
+                            weak_ptr_factory_.GetWeakPtr(), connection->id()));
+}
+
+void HttpServer::CloseAfterResponses(int connection_id) {
+  HttpConnection* connection = FindConnection(connection_id);
+  if (connection && ShouldCloseAfterResponses(connection))
+    Close(connection_id);
+}
+
 namespace {
 
 //
@@ -406,8 +560,7 @@ bool HttpServer::ParseHeaders(const char* data,
           buffer.clear();
           break;
         case ST_PROTO:
-          // TODO(mbelshe): Deal better with parsing protocol.
-          DCHECK(buffer == "HTTP/1.1");
+          info->protocol = buffer;
           buffer.clear();
           break;
         case ST_NAME:
@@ -26,6 +26,17 @@ class ServerSocket;
 class StreamSocket;
 class WebSocket;
 
+// An HTTP/1.1 server. Requests pipelined on a connection are passed to the
+// delegate in order, and responses are written in the order they are sent, so
+// the delegate must respond to them in order. Send(), Send200(), Send404(),
+// Send500() and FinishChunkedResponse() complete the response to the oldest
+// pending request of a connection. If set_close_after_responses() enabled it,
+// a connection the client did not want to keep alive is closed once all its
+// requests have been responded to and the responses written.
+//
+// Data sent while the requests of a read are being handled is written once
+// they all have been, and small pieces of pending data are written together,
+// so pipelined responses take few writes.
 class HttpServer {
  public:
   // Delegate to handle http/websocket events. Beware that it is not safe to
@@ -57,8 +68,13 @@ class HttpServer {
   void SendOverWebSocket(int connection_id, const std::string& data);
   // Sends the provided data directly to the given connection. No validation is
   // performed that data constitutes a valid HTTP response. A valid HTTP
-  // response may be split across multiple calls to SendRaw.
+  // response may be split across multiple calls to SendRaw. Since the end of
+  // the response is unknown, a connection the client did not want to keep
+  // alive is only closed once the client closes it.
   void SendRaw(int connection_id, const std::string& data);
+  // Sends the headers and the body of |response|. Like SendRaw(), it does not
+  // complete the response, as the delegate may send more of the body with
+  // SendRaw().
   // TODO(byungchul): Consider replacing function name with SendResponseInfo
   void SendResponse(int connection_id, const HttpServerResponseInfo& response);
   void Send(int connection_id,
@@ -71,8 +87,25 @@ class HttpServer {
   void Send404(int connection_id);
   void Send500(int connection_id, const std::string& message);
 
+  // Streams a response with a chunked body, to an HTTP/1.1 request.
+  // StartChunkedResponse() sends |response|, which must have neither a body
+  // nor a Content-Length, with a "Transfer-Encoding: chunked" header. The body
+  // is then sent with any number of calls to SendChunk(), and ended with
+  // FinishChunkedResponse().
+  void StartChunkedResponse(int connection_id,
+                            const HttpServerResponseInfo& response);
+  void SendChunk(int connection_id, const std::string& data);
+  void FinishChunkedResponse(int connection_id);
+
   void Close(int connection_id);
 
+  // Whether connections the client did not want to keep alive are closed once
+  // all their requests have been completely responded to. Defaults to false,
+  // in which case the client closes them.
+  void set_close_after_responses(bool close_after_responses) {
+    close_after_responses_ = close_after_responses;
+  }
+
   void SetReceiveBufferSize(int connection_id, int32_t size);
   void SetSendBufferSize(int connection_id, int32_t size);
 
@@ -91,11 +124,44 @@ class HttpServer {
   void DoReadLoop(HttpConnection* connection);
   void OnReadCompleted(int connection_id, int rv);
   int HandleReadResult(HttpConnection* connection, int rv);
+  // Handles the requests or WebSocket messages in the read buffer of
+  // |connection|.
+  int HandleReceivedData(HttpConnection* connection);
 
   void DoWriteLoop(HttpConnection* connection);
   void OnWriteCompleted(int connection_id, int rv);
   int HandleWriteResult(HttpConnection* connection, int rv);
 
+  // Appends |data| to the data to write to |connection|, and starts writing
+  // unless a write is in progress or writes are deferred.
+  void QueueData(HttpConnection* connection, const std::string& data);
+
+  // Data queued between these calls is only written once the outermost batch
+  // ends. EndWriteBatch() may close |connection| on a write error.
+  void BeginWriteBatch(HttpConnection* connection);
+  void EndWriteBatch(HttpConnection* connection);
+
+  // Sends |response| followed by |body| as the complete response to the
+  // oldest pending request of the connection.
+  void SendCompleteResponse(int connection_id,
+                            const HttpServerResponseInfo& response,
+                            const std::string& body);
+
+  // Marks the response to the oldest pending request of |connection| as
+  // completely sent.
+  void DidSendResponse(HttpConnection* connection);
+
+  // Whether |connection| is to be closed as the client asked for and all
+  // responses have been written.
+  bool ShouldCloseAfterResponses(HttpConnection* connection);
+
+  // Closes |connection|, asynchronously, if ShouldCloseAfterResponses().
+  void MaybeCloseAfterResponses(HttpConnection* connection);
+
+  // Closes the connection if it still ShouldCloseAfterResponses(): more data
+  // may have been sent to it since the close was posted.
+  void CloseAfterResponses(int connection_id);
+
   // Expects the raw data to be stored in recv_data_. If parsing is successful,
   // will remove the data parsed from recv_data_, leaving only the unused
   // recv data.
@@ -116,6 +182,8 @@ class HttpServer {
   int last_id_;
   IdToConnectionMap id_to_connection_;
 
+  bool close_after_responses_;
+
   base::WeakPtrFactory<HttpServer> weak_ptr_factory_;
 
   DISALLOW_COPY_AND_ASSIGN(HttpServer);
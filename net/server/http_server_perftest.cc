@@ -0,0 +1,141 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/server/http_server.h"
+
+#include <stddef.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/message_loop/message_loop.h"
+#include "base/test/perf_log.h"
+#include "base/time/time.h"
+#include "net/base/address_list.h"
+#include "net/base/io_buffer.h"
+#include "net/base/ip_endpoint.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/log/net_log.h"
+#include "net/server/http_server_request_info.h"
+#include "net/server/http_server_response_info.h"
+#include "net/socket/tcp_client_socket.h"
+#include "net/socket/tcp_server_socket.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/platform_test.h"
+
+namespace net {
+
+namespace {
+
+const int kNumRequests = 20000;
+const int kReadBufferSize = 64 * 1024;
+
+const char kRequest[] =
+    "GET /json/version HTTP/1.1\r\n"
+    "Host: 127.0.0.1\r\n"
+    "Accept: application/json\r\n"
+    "\r\n";
+
+// Responds to every request right away with the same small body, as a
+// DevTools-style JSON endpoint would.
+class HttpServerPerfTest : public PlatformTest, public HttpServer::Delegate {
+ public:
+  HttpServerPerfTest() : body_("{\"Browser\": \"Chrome/55.0.2883.0\"}") {}
+
+  void SetUp() override {
+    std::unique_ptr<ServerSocket> server_socket(
+        new TCPServerSocket(NULL, NetLog::Source()));
+    ASSERT_EQ(OK, server_socket->ListenWithAddressAndPort("127.0.0.1", 0, 1));
+    server_.reset(new HttpServer(std::move(server_socket), this));
+    ASSERT_EQ(OK, server_->GetLocalAddress(&server_address_));
+
+    HttpServerResponseInfo response(HTTP_OK);
+    response.SetContentHeaders(body_.size(), "application/json");
+    response_size_ = response.Serialize().size() + body_.size();
+  }
+
+  // HttpServer::Delegate implementation.
+  void OnConnect(int connection_id) override {}
+  void OnHttpRequest(int connection_id,
+                     const HttpServerRequestInfo& info) override {
+    server_->Send200(connection_id, body_, "application/json");
+  }
+  void OnWebSocketRequest(int connection_id,
+                          const HttpServerRequestInfo& info) override {}
+  void OnWebSocketMessage(int connection_id,
+                          const std::string& data) override {}
+  void OnClose(int connection_id) override {}
+
+ protected:
+  // Sends kNumRequests requests on a single connection, |pipeline_depth| at a
+  // time, waits for all responses to each batch, and logs the request rate.
+  void RunRequests(const char* name, int pipeline_depth) {
+    TCPClientSocket socket(AddressList(server_address_), NULL, NULL,
+                           NetLog::Source());
+    TestCompletionCallback connect_callback;
+    ASSERT_EQ(OK, connect_callback.GetResult(
+                      socket.Connect(connect_callback.callback())));
+
+    std::string batch;
+    for (int i = 0; i < pipeline_depth; ++i)
+      batch += kRequest;
+    scoped_refptr<IOBufferWithSize> read_buffer(
+        new IOBufferWithSize(kReadBufferSize));
+
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < kNumRequests / pipeline_depth; ++i) {
+      scoped_refptr<DrainableIOBuffer> write_buffer(new DrainableIOBuffer(
+          new StringIOBuffer(batch), batch.size()));
+      while (write_buffer->BytesRemaining() > 0) {
+        TestCompletionCallback callback;
+        int rv = callback.GetResult(
+            socket.Write(write_buffer.get(), write_buffer->BytesRemaining(),
+                         callback.callback()));
+        ASSERT_GT(rv, 0);
+        write_buffer->DidConsume(rv);
+      }
+
+      size_t remaining = response_size_ * pipeline_depth;
+      while (remaining > 0) {
+        TestCompletionCallback callback;
+        int rv = callback.GetResult(socket.Read(
+            read_buffer.get(), kReadBufferSize, callback.callback()));
+        ASSERT_GT(rv, 0);
+        ASSERT_LE(static_cast<size_t>(rv), remaining);
+        remaining -= rv;
+      }
+    }
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    base::LogPerfResult(name, kNumRequests / elapsed.InSecondsF(),
+                        "requests/s");
+  }
+
+ private:
+  base::MessageLoopForIO message_loop_;
+  std::unique_ptr<HttpServer> server_;
+  IPEndPoint server_address_;
+  const std::string body_;
+  size_t response_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(HttpServerPerfTest);
+};
+
+}  // namespace
+
+// Measures request/response round trips on a keep-alive connection.
+TEST_F(HttpServerPerfTest, SequentialRequests) {
+  RunRequests("Http_server_sequential_requests", 1);
+}
+
+// Measures requests pipelined in batches, whose responses the server writes
+// together.
+TEST_F(HttpServerPerfTest, PipelinedRequests) {
+  RunRequests("Http_server_pipelined_requests", 32);
+}
+
+}  // namespace net
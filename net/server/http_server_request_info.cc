@@ -41,4 +41,12 @@ bool HttpServerRequestInfo::HasHeaderValue(
   return false;
 }
 
+bool HttpServerRequestInfo::IsKeepAlive() const {
+  if (HasHeaderValue("connection", "close"))
+    return false;
+  if (protocol == "HTTP/1.0")
+    return HasHeaderValue("connection", "keep-alive");
+  return true;
+}
+
 }  // namespace net
@@ -32,6 +32,11 @@ class HttpServerRequestInfo {
       const std::string& header_name,
       const std::string& header_value) const;
 
+  // Whether the client allows the connection to be reused for further
+  // requests: by default for HTTP/1.1, and with "Connection: keep-alive" for
+  // HTTP/1.0.
+  bool IsKeepAlive() const;
+
   // Request peer address.
   IPEndPoint peer;
 
@@ -41,6 +46,9 @@ class HttpServerRequestInfo {
   // Request line.
   std::string path;
 
+  // Request protocol, e.g. "HTTP/1.1".
+  std::string protocol;
+
   // Request data.
   std::string data;
 
@@ -38,6 +38,7 @@
 #include "net/http/http_util.h"
 #include "net/log/net_log.h"
 #include "net/server/http_server_request_info.h"
+#include "net/server/http_server_response_info.h"
 #include "net/socket/tcp_client_socket.h"
 #include "net/socket/tcp_server_socket.h"
 #include "net/test/gtest_util.h"
@@ -120,6 +121,8 @@ class TestHttpClient {
     return true;
   }
 
+  void Disconnect() { socket_.reset(); }
+
   bool ReadResponse(std::string* message) {
     if (!Read(message, 1))
       return false;
@@ -637,6 +640,206 @@ TEST_F(HttpServerTest, MultipleRequestsOnSameConnection) {
                              base::CompareCase::SENSITIVE));
 }
 
+TEST_F(HttpServerTest, PipelinedRequests) {
+  TestHttpClient client;
+  ASSERT_THAT(client.ConnectAndWait(server_address_), IsOk());
+  client.Send(
+      "GET /test1 HTTP/1.1\r\n\r\n"
+      "GET /test2 HTTP/1.1\r\n\r\n"
+      "GET /test3 HTTP/1.1\r\n\r\n");
+  ASSERT_TRUE(RunUntilRequestsReceived(3));
+  ASSERT_EQ("/test1", GetRequest(0).path);
+  ASSERT_EQ("/test2", GetRequest(1).path);
+  ASSERT_EQ("/test3", GetRequest(2).path);
+  ASSERT_EQ(GetConnectionId(0), GetConnectionId(2));
+
+  std::string expected_response;
+  for (size_t i = 0; i < requests_.size(); ++i) {
+    std::string body = "Content for " + GetRequest(i).path;
+    HttpServerResponseInfo response(HTTP_OK);
+    response.SetContentHeaders(body.size(), "text/plain");
+    expected_response += response.Serialize() + body;
+    server_->Send200(GetConnectionId(i), body, "text/plain");
+  }
+
+  std::string response;
+  ASSERT_TRUE(client.Read(&response, expected_response.length()));
+  ASSERT_EQ(expected_response, response);
+}
+
+TEST_F(HttpServerTest, ConnectionCloseRequest) {
+  TestHttpClient client;
+  server_->set_close_after_responses(true);
+  ASSERT_THAT(client.ConnectAndWait(server_address_), IsOk());
+  client.Send(
+      "GET /test HTTP/1.1\r\n"
+      "Connection: close\r\n\r\n");
+  ASSERT_TRUE(RunUntilRequestsReceived(1));
+  server_->Send200(GetConnectionId(0), "Response!", "text/plain");
+
+  std::string response;
+  ASSERT_TRUE(client.ReadResponse(&response));
+  ASSERT_TRUE(
+      base::EndsWith(response, "Response!", base::CompareCase::SENSITIVE));
+  // The server closes the connection once the response is written.
+  std::string more_data;
+  ASSERT_FALSE(client.Read(&more_data, 1));
+}
+
+TEST_F(HttpServerTest, ConnectionCloseRequestNotClosedByDefault) {
+  TestHttpClient client;
+  ASSERT_THAT(client.ConnectAndWait(server_address_), IsOk());
+  client.Send(
+      "GET /test HTTP/1.1\r\n"
+      "Connection: close\r\n\r\n");
+  ASSERT_TRUE(RunUntilRequestsReceived(1));
+  server_->Send200(GetConnectionId(0), "Response!", "text/plain");
+
+  std::string response;
+  ASSERT_TRUE(client.ReadResponse(&response));
+  ASSERT_TRUE(
+      base::EndsWith(response, "Response!", base::CompareCase::SENSITIVE));
+  // The connection is still open for the server to send more data on.
+  server_->SendRaw(GetConnectionId(0), "More");
+  std::string more_data;
+  ASSERT_TRUE(client.Read(&more_data, 4));
+  ASSERT_EQ("More", more_data);
+}
+
+TEST_F(HttpServerTest, Http10Request) {
+  TestHttpClient client;
+  ASSERT_THAT(client.ConnectAndWait(server_address_), IsOk());
+  server_->set_close_after_responses(true);
+  client.Send("GET /test HTTP/1.0\r\n\r\n");
+  ASSERT_TRUE(RunUntilRequestsReceived(1));
+  ASSERT_EQ("HTTP/1.0", GetRequest(0).protocol);
+  ASSERT_FALSE(GetRequest(0).IsKeepAlive());
+  server_->Send404(GetConnectionId(0));
+
+  std::string response;
+  ASSERT_TRUE(client.ReadResponse(&response));
+  ASSERT_TRUE(base::StartsWith(response, "HTTP/1.1 404 Not Found",
+                               base::CompareCase::SENSITIVE));
+  std::string more_data;
+  ASSERT_FALSE(client.Read(&more_data, 1));
+}
+
+TEST_F(HttpServerTest, ChunkedResponse) {
+  TestHttpClient client;
+  ASSERT_THAT(client.ConnectAndWait(server_address_), IsOk());
+  client.Send("GET /test HTTP/1.1\r\n\r\n");
+  ASSERT_TRUE(RunUntilRequestsReceived(1));
+
+  HttpServerResponseInfo response_info(HTTP_OK);
+  response_info.AddHeader("Content-Type", "text/plain");
+  server_->StartChunkedResponse(GetConnectionId(0), response_info);
+  server_->SendChunk(GetConnectionId(0), "Hello");
+  // Empty chunks are not sent, as they would end the body.
+  server_->SendChunk(GetConnectionId(0), std::string());
+  server_->SendChunk(GetConnectionId(0), std::string(26, '!'));
+  server_->FinishChunkedResponse(GetConnectionId(0));
+
+  response_info.AddHeader("Transfer-Encoding", "chunked");
+  const std::string expected_response = response_info.Serialize() +
+                                        "5\r\nHello\r\n"
+                                        "1A\r\n" +
+                                        std::string(26, '!') +
+                                        "\r\n"
+                                        "0\r\n\r\n";
+  std::string response;
+  ASSERT_TRUE(client.Read(&response, expected_response.length()));
+  ASSERT_EQ(expected_response, response);
+}
+
+class TrackCloseHttpServerTest : public HttpServerTest {
+ public:
+  void OnClose(int connection_id) override {
+    closed_connection_ids_.push_back(connection_id);
+    if (!run_loop_quit_func_.is_null())
+      run_loop_quit_func_.Run();
+  }
+
+  bool RunUntilConnectionClosed() {
+    if (!closed_connection_ids_.empty())
+      return true;
+    base::RunLoop run_loop;
+    run_loop_quit_func_ = run_loop.QuitClosure();
+    bool success = RunLoopWithTimeout(&run_loop);
+    run_loop_quit_func_.Reset();
+    return success;
+  }
+
+ protected:
+  std::vector<int> closed_connection_ids_;
+};
+
+// SendResponse() does not complete the response, so the body the delegate
+// sends after it is not cut off by the close.
+TEST_F(TrackCloseHttpServerTest, ConnectionCloseRequestWithSendResponse) {
+  TestHttpClient client;
+  server_->set_close_after_responses(true);
+  ASSERT_THAT(client.ConnectAndWait(server_address_), IsOk());
+  client.Send(
+      "GET /test HTTP/1.1\r\n"
+      "Connection: close\r\n\r\n");
+  ASSERT_TRUE(RunUntilRequestsReceived(1));
+  HttpServerResponseInfo response_info(HTTP_OK);
+  response_info.SetContentHeaders(9, "text/plain");
+  server_->SendResponse(GetConnectionId(0), response_info);
+  base::RunLoop().RunUntilIdle();
+  server_->SendRaw(GetConnectionId(0), "Response!");
+
+  std::string response;
+  ASSERT_TRUE(client.ReadResponse(&response));
+  ASSERT_EQ(response_info.Serialize() + "Response!", response);
+  EXPECT_TRUE(closed_connection_ids_.empty());
+
+  client.Disconnect();
+  ASSERT_TRUE(RunUntilConnectionClosed());
+  EXPECT_EQ(GetConnectionId(0), closed_connection_ids_[0]);
+}
+
+// The server cannot tell when a response sent with SendRaw() is complete, so
+// it notices the client closing a connection it did not want to keep alive.
+TEST_F(TrackCloseHttpServerTest, ClientClosesAfterRawResponse) {
+  TestHttpClient client;
+  server_->set_close_after_responses(true);
+  ASSERT_THAT(client.ConnectAndWait(server_address_), IsOk());
+  client.Send(
+      "GET /test HTTP/1.1\r\n"
+      "Connection: close\r\n\r\n");
+  ASSERT_TRUE(RunUntilRequestsReceived(1));
+  const std::string kResponse =
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Length: 9\r\n\r\n"
+      "Response!";
+  server_->SendRaw(GetConnectionId(0), kResponse);
+
+  std::string response;
+  ASSERT_TRUE(client.Read(&response, kResponse.length()));
+  ASSERT_EQ(kResponse, response);
+  EXPECT_TRUE(closed_connection_ids_.empty());
+
+  client.Disconnect();
+  ASSERT_TRUE(RunUntilConnectionClosed());
+  ASSERT_EQ(1u, closed_connection_ids_.size());
+  EXPECT_EQ(GetConnectionId(0), closed_connection_ids_[0]);
+}
+
+// The delegate is not told about the close from within the call it made to
+// send the last response.
+TEST_F(TrackCloseHttpServerTest, CloseAfterResponsesIsAsynchronous) {
+  TestHttpClient client;
+  server_->set_close_after_responses(true);
+  ASSERT_THAT(client.ConnectAndWait(server_address_), IsOk());
+  client.Send("GET /test HTTP/1.0\r\n\r\n");
+  ASSERT_TRUE(RunUntilRequestsReceived(1));
+  server_->Send404(GetConnectionId(0));
+  EXPECT_TRUE(closed_connection_ids_.empty());
+  ASSERT_TRUE(RunUntilConnectionClosed());
+  EXPECT_EQ(GetConnectionId(0), closed_connection_ids_[0]);
+}
+
 class CloseOnConnectHttpServerTest : public HttpServerTest {
  public:
   void OnConnect(int connection_id) override {
@@ -4,10 +4,14 @@
 
 #include "net/spdy/buffered_spdy_framer.h"
 
+#include <string.h>
+
 #include <utility>
 
 #include "base/logging.h"
 #include "base/strings/string_util.h"
+#include "base/sys_byteorder.h"
+#include "net/spdy/spdy_bitmasks.h"
 
 namespace net {
 
@@ -398,6 +402,25 @@ SpdySerializedFrame* BufferedSpdyFramer::CreateDataFrame(SpdyStreamId stream_id,
   return new SpdySerializedFrame(spdy_framer_.SerializeData(data_ir));
 }
 
+void BufferedSpdyFramer::SerializeDataFrameHeader(SpdyStreamId stream_id,
+                                                  uint32_t len,
+                                                  SpdyDataFlags flags,
+                                                  char* out) const {
+  DCHECK_EQ(HTTP2, spdy_framer_.protocol_version());
+  DCHECK_EQ(0u, len & ~kLengthMask);
+  DCHECK_EQ(0u, stream_id & ~kStreamIdMask);
+  // 24-bit length, 8-bit type, 8-bit flags, 31-bit stream ID.
+  uint32_t length_and_type = base::HostToNet32(
+      (len << 8) | SpdyConstants::SerializeFrameType(HTTP2, DATA));
+  uint32_t network_stream_id = base::HostToNet32(stream_id);
+  memcpy(out, &length_and_type, sizeof(length_and_type));
+  out[sizeof(length_and_type)] = static_cast<char>(flags & DATA_FLAG_FIN);
+  memcpy(out + sizeof(length_and_type) + 1, &network_stream_id,
+         sizeof(network_stream_id));
+  DCHECK_EQ(sizeof(length_and_type) + 1 + sizeof(network_stream_id),
+            GetDataFrameMinimumSize());
+}
+
 // TODO(jgraettinger): Eliminate uses of this method (prefer SpdyPushPromiseIR).
 SpdySerializedFrame* BufferedSpdyFramer::CreatePushPromise(
     SpdyStreamId stream_id,
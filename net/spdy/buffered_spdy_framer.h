@@ -208,6 +208,12 @@ class NET_EXPORT_PRIVATE BufferedSpdyFramer
                                        const char* data,
                                        uint32_t len,
                                        SpdyDataFlags flags);
+  // Writes the header of a DATA frame with a |len| byte payload to |out|,
+  // which must have room for GetDataFrameMinimumSize() bytes.
+  void SerializeDataFrameHeader(SpdyStreamId stream_id,
+                                uint32_t len,
+                                SpdyDataFlags flags,
+                                char* out) const;
   SpdySerializedFrame* CreatePushPromise(SpdyStreamId stream_id,
                                          SpdyStreamId promised_stream_id,
                                          SpdyHeaderBlock headers);
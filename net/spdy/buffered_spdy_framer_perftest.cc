@@ -0,0 +1,186 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/spdy/buffered_spdy_framer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_log.h"
+#include "base/time/time.h"
+#include "net/spdy/spdy_protocol.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/platform_test.h"
+
+namespace net {
+
+namespace {
+
+const int kNumStreams = 100;
+const int kDataFramesPerStream = 8;
+const size_t kDataFramePayloadSize = 8 * 1024;
+const int kIterations = 100;
+
+// Size of the chunks the input is fed in, as if read from a socket.
+const size_t kReadSize = 32 * 1024;
+
+// Counts the frames and bytes delivered by a BufferedSpdyFramer.
+class CountingVisitor : public BufferedSpdyFramerVisitorInterface {
+ public:
+  CountingVisitor()
+      : error_(false), headers_(0), streams_ended_(0), data_bytes_(0) {}
+  ~CountingVisitor() override {}
+
+  void OnError(SpdyFramer::SpdyError error_code) override { error_ = true; }
+  void OnStreamError(SpdyStreamId stream_id,
+                     const std::string& description) override {
+    error_ = true;
+  }
+  void OnHeaders(SpdyStreamId stream_id,
+                 bool has_priority,
+                 int weight,
+                 SpdyStreamId parent_stream_id,
+                 bool exclusive,
+                 bool fin,
+                 SpdyHeaderBlock headers) override {
+    ++headers_;
+  }
+  void OnDataFrameHeader(SpdyStreamId stream_id,
+                         size_t length,
+                         bool fin) override {}
+  void OnStreamFrameData(SpdyStreamId stream_id,
+                         const char* data,
+                         size_t len) override {
+    data_bytes_ += len;
+  }
+  void OnStreamEnd(SpdyStreamId stream_id) override { ++streams_ended_; }
+  void OnStreamPadding(SpdyStreamId stream_id, size_t len) override {}
+  void OnSettings(bool clear_persisted) override {}
+  void OnSetting(SpdySettingsIds id, uint8_t flags, uint32_t value) override {}
+  void OnPing(SpdyPingId unique_id, bool is_ack) override {}
+  void OnRstStream(SpdyStreamId stream_id,
+                   SpdyRstStreamStatus status) override {}
+  void OnGoAway(SpdyStreamId last_accepted_stream_id,
+                SpdyGoAwayStatus status,
+                base::StringPiece debug_data) override {}
+  void OnWindowUpdate(SpdyStreamId stream_id, int delta_window_size) override {}
+  void OnPushPromise(SpdyStreamId stream_id,
+                     SpdyStreamId promised_stream_id,
+                     SpdyHeaderBlock headers) override {}
+  void OnAltSvc(SpdyStreamId stream_id,
+                base::StringPiece origin,
+                const SpdyAltSvcWireFormat::AlternativeServiceVector&
+                    altsvc_vector) override {}
+  bool OnUnknownFrame(SpdyStreamId stream_id, int frame_type) override {
+    return false;
+  }
+
+  bool error() const { return error_; }
+  int headers() const { return headers_; }
+  int streams_ended() const { return streams_ended_; }
+  int64_t data_bytes() const { return data_bytes_; }
+
+ private:
+  bool error_;
+  int headers_;
+  int streams_ended_;
+  int64_t data_bytes_;
+};
+
+SpdyHeaderBlock MakeResponseHeaders(int index) {
+  SpdyHeaderBlock headers;
+  headers[":status"] = "200";
+  headers["date"] = "Mon, 17 Oct 2016 10:21:00 GMT";
+  headers["content-type"] = "application/javascript";
+  headers["content-length"] =
+      base::IntToString(kDataFramesPerStream * kDataFramePayloadSize);
+  headers["cache-control"] = "public, max-age=31536000";
+  headers["etag"] = base::StringPrintf("\"%08x\"", index * 2654435761u);
+  return headers;
+}
+
+// Serializes the responses of kNumStreams streams, each a HEADERS frame
+// followed by DATA frames, with |framer|, and appends them to |out|. Returns
+// the number of frames.
+int SerializeResponses(BufferedSpdyFramer* framer, std::string* out) {
+  const std::string payload(kDataFramePayloadSize, 'a');
+  int frame_count = 0;
+  for (int i = 0; i < kNumStreams; ++i) {
+    SpdyStreamId stream_id = 2 * i + 1;
+    std::unique_ptr<SpdySerializedFrame> headers(framer->CreateHeaders(
+        stream_id, CONTROL_FLAG_NONE, kHttp2DefaultStreamWeight,
+        MakeResponseHeaders(i)));
+    out->append(headers->data(), headers->size());
+    ++frame_count;
+    for (int j = 0; j < kDataFramesPerStream; ++j) {
+      std::unique_ptr<SpdySerializedFrame> data(framer->CreateDataFrame(
+          stream_id, payload.data(), payload.size(),
+          j == kDataFramesPerStream - 1 ? DATA_FLAG_FIN : DATA_FLAG_NONE));
+      out->append(data->data(), data->size());
+      ++frame_count;
+    }
+  }
+  return frame_count;
+}
+
+}  // namespace
+
+class BufferedSpdyFramerPerfTest : public PlatformTest {};
+
+// Measures the rate at which responses are serialized, HPACK compressing
+// their headers on a single connection.
+TEST_F(BufferedSpdyFramerPerfTest, Serialize) {
+  int frame_count = 0;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    BufferedSpdyFramer framer;
+    std::string out;
+    frame_count += SerializeResponses(&framer, &out);
+  }
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  base::LogPerfResult("Buffered_spdy_framer_serialize",
+                      frame_count / elapsed.InSecondsF(), "frames/s");
+}
+
+// Measures the rate at which responses are parsed and delivered to the
+// visitor when read from a socket in chunks.
+TEST_F(BufferedSpdyFramerPerfTest, ProcessInput) {
+  std::string input;
+  int frame_count = 0;
+  {
+    BufferedSpdyFramer framer;
+    frame_count = SerializeResponses(&framer, &input);
+  }
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    CountingVisitor visitor;
+    BufferedSpdyFramer framer;
+    framer.set_visitor(&visitor);
+    for (size_t offset = 0; offset < input.size(); offset += kReadSize) {
+      size_t len = std::min(kReadSize, input.size() - offset);
+      ASSERT_EQ(len, framer.ProcessInput(input.data() + offset, len));
+    }
+    ASSERT_FALSE(visitor.error());
+    ASSERT_EQ(kNumStreams, visitor.headers());
+    ASSERT_EQ(kNumStreams, visitor.streams_ended());
+  }
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  base::LogPerfResult(
+      "Buffered_spdy_framer_process_input",
+      static_cast<double>(frame_count) * kIterations / elapsed.InSecondsF(),
+      "frames/s");
+  base::LogPerfResult("Buffered_spdy_framer_process_input_bytes",
+                      static_cast<double>(input.size()) * kIterations / 1024 /
+                          1024 / elapsed.InSecondsF(),
+                      "MB/s");
+}
+
+}  // namespace net
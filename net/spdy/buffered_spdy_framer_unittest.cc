@@ -275,6 +275,23 @@ TEST_F(BufferedSpdyFramerTest, GoAwayDebugData) {
   EXPECT_EQ("foo", visitor.goaway_debug_data_);
 }
 
+// SerializeDataFrameHeader() must write the same header as CreateDataFrame().
+TEST_F(BufferedSpdyFramerTest, SerializeDataFrameHeader) {
+  BufferedSpdyFramer framer;
+  const char kPayload[] = "payload";
+  const uint32_t kPayloadSize = arraysize(kPayload) - 1;
+  const SpdyDataFlags kFlags[] = {DATA_FLAG_NONE, DATA_FLAG_FIN};
+  for (SpdyDataFlags flags : kFlags) {
+    std::unique_ptr<SpdySerializedFrame> frame(
+        framer.CreateDataFrame(3u, kPayload, kPayloadSize, flags));
+    ASSERT_EQ(framer.GetDataFrameMinimumSize() + kPayloadSize, frame->size());
+
+    std::string header(framer.GetDataFrameMinimumSize(), '\0');
+    framer.SerializeDataFrameHeader(3u, kPayloadSize, flags, &header[0]);
+    EXPECT_EQ(std::string(frame->data(), header.size()), header);
+  }
+}
+
 TEST_F(BufferedSpdyFramerTest, OnAltSvc) {
   const SpdyStreamId altsvc_stream_id(1);
   const char altsvc_origin[] = "https://www.example.org";
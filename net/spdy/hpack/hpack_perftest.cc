@@ -0,0 +1,261 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_log.h"
+#include "base/time/time.h"
+#include "net/spdy/hpack/hpack_constants.h"
+#include "net/spdy/hpack/hpack_decoder.h"
+#include "net/spdy/hpack/hpack_encoder.h"
+#include "net/spdy/spdy_header_block.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/platform_test.h"
+
+namespace net {
+
+namespace {
+
+// Number of subresources of the simulated page load.
+const int kNumSubresources = 80;
+const int kIterations = 500;
+
+const char kUserAgent[] =
+    "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+    "Chrome/53.0.2785.143 Safari/537.36";
+const char kCookie[] =
+    "SID=31d4d96e407aad42; lang=en-US; _ga=GA1.2.1849361092.1476700000; "
+    "prefs=ZGFyay10aGVtZT0xJmxheW91dD1jb21wYWN0";
+
+enum ResourceType { DOCUMENT, SCRIPT, STYLESHEET, IMAGE, XHR };
+
+ResourceType GetResourceType(int index) {
+  if (index == 0)
+    return DOCUMENT;
+  static const ResourceType kSubresourceTypes[] = {IMAGE, SCRIPT, IMAGE,
+                                                   STYLESHEET, IMAGE, XHR};
+  return kSubresourceTypes[index % arraysize(kSubresourceTypes)];
+}
+
+// Builds the request header blocks of a page load: a document followed by
+// its subresources, most of them from the same origin and some from a CDN.
+void BuildRequestCorpus(std::vector<SpdyHeaderBlock>* corpus) {
+  for (int i = 0; i <= kNumSubresources; ++i) {
+    ResourceType type = GetResourceType(i);
+    bool cdn = type == IMAGE && i % 3 == 0;
+    SpdyHeaderBlock block;
+    block[":method"] = "GET";
+    block[":scheme"] = "https";
+    block[":authority"] = cdn ? "static.example-cdn.net" : "www.example.org";
+    switch (type) {
+      case DOCUMENT:
+        block[":path"] = "/news/2016/10/17/article.html?ref=frontpage";
+        block["accept"] =
+            "text/html,application/xhtml+xml,application/xml;q=0.9,"
+            "image/webp,*/*;q=0.8";
+        block["upgrade-insecure-requests"] = "1";
+        break;
+      case SCRIPT:
+        block[":path"] = base::StringPrintf("/static/js/bundle.%d.min.js", i);
+        block["accept"] = "*/*";
+        break;
+      case STYLESHEET:
+        block[":path"] = base::StringPrintf("/static/css/theme.%d.css", i);
+        block["accept"] = "text/css,*/*;q=0.1";
+        break;
+      case IMAGE:
+        block[":path"] =
+            base::StringPrintf("/images/2016/10/photo_%04d.jpg?w=640", i * 7);
+        block["accept"] = "image/webp,image/*,*/*;q=0.8";
+        break;
+      case XHR:
+        block[":path"] =
+            base::StringPrintf("/api/v2/comments?article=1742&page=%d", i);
+        block["accept"] = "application/json";
+        block["x-requested-with"] = "XMLHttpRequest";
+        break;
+    }
+    block["user-agent"] = kUserAgent;
+    block["accept-encoding"] = "gzip, deflate, sdch, br";
+    block["accept-language"] = "en-US,en;q=0.8";
+    if (type != DOCUMENT)
+      block["referer"] =
+          "https://www.example.org/news/2016/10/17/article.html?ref=frontpage";
+    if (!cdn)
+      block["cookie"] = kCookie;
+    corpus->push_back(std::move(block));
+  }
+}
+
+// Builds the response header blocks matching BuildRequestCorpus().
+void BuildResponseCorpus(std::vector<SpdyHeaderBlock>* corpus) {
+  for (int i = 0; i <= kNumSubresources; ++i) {
+    ResourceType type = GetResourceType(i);
+    SpdyHeaderBlock block;
+    // Every so often the cached copy of a subresource is still fresh.
+    bool not_modified = type != DOCUMENT && type != XHR && i % 5 == 0;
+    block[":status"] = not_modified ? "304" : "200";
+    block["date"] =
+        base::StringPrintf("Mon, 17 Oct 2016 10:21:%02d GMT", 10 + i / 8);
+    block["server"] = "nginx/1.10.1";
+    if (!not_modified) {
+      static const char* const kContentTypes[] = {
+          "text/html; charset=utf-8", "application/javascript",
+          "text/css", "image/jpeg", "application/json"};
+      block["content-type"] = kContentTypes[type];
+      block["content-length"] = base::IntToString(1000 + (i * 7919) % 90000);
+    }
+    switch (type) {
+      case DOCUMENT:
+        block["cache-control"] = "private, max-age=0, must-revalidate";
+        block["set-cookie"] =
+            "SID=31d4d96e407aad42; Path=/; Secure; HttpOnly; Max-Age=86400";
+        block["strict-transport-security"] = "max-age=31536000";
+        block["x-frame-options"] = "SAMEORIGIN";
+        break;
+      case XHR:
+        block["cache-control"] = "no-cache";
+        block["vary"] = "Accept-Encoding";
+        break;
+      default:
+        block["cache-control"] = "public, max-age=31536000";
+        block["etag"] = base::StringPrintf(
+            "\"%08x\"", static_cast<uint32_t>(i * 2654435761u));
+        block["last-modified"] = "Thu, 13 Oct 2016 08:00:00 GMT";
+        block["accept-ranges"] = "bytes";
+        break;
+    }
+    if (type == SCRIPT || type == STYLESHEET)
+      block["content-encoding"] = "gzip";
+    corpus->push_back(std::move(block));
+  }
+}
+
+// Returns the size of |block| serialized as HTTP/1.1 header lines.
+size_t GetHttp1Size(const SpdyHeaderBlock& block) {
+  size_t size = 0;
+  for (const auto& header : block)
+    size += header.first.size() + 2 + header.second.size() + 2;
+  return size;
+}
+
+}  // namespace
+
+class HpackPerfTest : public PlatformTest {
+ protected:
+  HpackPerfTest() {
+    BuildRequestCorpus(&requests_);
+    BuildResponseCorpus(&responses_);
+  }
+
+  // Encodes |corpus| with a fresh encoder, in order, as a connection would,
+  // and logs the encoded size relative to HTTP/1.1 and the encoding rate.
+  void Encode(const std::string& name,
+              const std::vector<SpdyHeaderBlock>& corpus) {
+    size_t http1_bytes = 0;
+    for (const SpdyHeaderBlock& block : corpus)
+      http1_bytes += GetHttp1Size(block);
+
+    size_t encoded_bytes = 0;
+    size_t no_indexing_bytes = 0;
+    size_t literal_bytes = 0;
+    {
+      HpackEncoder encoder(ObtainHpackHuffmanTable());
+      HpackEncoder no_indexing_encoder(ObtainHpackHuffmanTable());
+      no_indexing_encoder.SetIndexingPolicy(
+          [](base::StringPiece, base::StringPiece) { return false; });
+      HpackEncoder literal_encoder(ObtainHpackHuffmanTable());
+      for (const SpdyHeaderBlock& block : corpus) {
+        std::string output;
+        ASSERT_TRUE(encoder.EncodeHeaderSet(block, &output));
+        encoded_bytes += output.size();
+        output.clear();
+        ASSERT_TRUE(no_indexing_encoder.EncodeHeaderSet(block, &output));
+        no_indexing_bytes += output.size();
+        output.clear();
+        ASSERT_TRUE(
+            literal_encoder.EncodeHeaderSetWithoutCompression(block, &output));
+        literal_bytes += output.size();
+      }
+    }
+    base::LogPerfResult((name + "_size").c_str(),
+                        100.0 * encoded_bytes / http1_bytes, "%");
+    base::LogPerfResult((name + "_size_static_table_only").c_str(),
+                        100.0 * no_indexing_bytes / http1_bytes, "%");
+    base::LogPerfResult((name + "_size_literal_only").c_str(),
+                        100.0 * literal_bytes / http1_bytes, "%");
+
+    std::string output;
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < kIterations; ++i) {
+      HpackEncoder encoder(ObtainHpackHuffmanTable());
+      for (const SpdyHeaderBlock& block : corpus) {
+        output.clear();
+        encoder.EncodeHeaderSet(block, &output);
+      }
+    }
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    base::LogPerfResult(
+        (name + "_encode").c_str(),
+        static_cast<double>(http1_bytes) * kIterations / 1024 / 1024 /
+            elapsed.InSecondsF(),
+        "MB/s");
+  }
+
+  // Decodes |corpus|, as encoded on a single connection, with a fresh decoder
+  // and logs the decoding rate.
+  void Decode(const std::string& name,
+              const std::vector<SpdyHeaderBlock>& corpus) {
+    size_t http1_bytes = 0;
+    std::vector<std::string> encoded;
+    HpackEncoder encoder(ObtainHpackHuffmanTable());
+    for (const SpdyHeaderBlock& block : corpus) {
+      http1_bytes += GetHttp1Size(block);
+      encoded.push_back(std::string());
+      ASSERT_TRUE(encoder.EncodeHeaderSet(block, &encoded.back()));
+    }
+
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < kIterations; ++i) {
+      HpackDecoder decoder;
+      for (size_t j = 0; j < encoded.size(); ++j) {
+        decoder.HandleControlFrameHeadersStart(nullptr);
+        ASSERT_TRUE(decoder.HandleControlFrameHeadersData(encoded[j].data(),
+                                                          encoded[j].size()));
+        ASSERT_TRUE(decoder.HandleControlFrameHeadersComplete(nullptr));
+        if (i == 0)
+          ASSERT_EQ(corpus[j], decoder.decoded_block());
+      }
+    }
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    base::LogPerfResult(
+        (name + "_decode").c_str(),
+        static_cast<double>(http1_bytes) * kIterations / 1024 / 1024 /
+            elapsed.InSecondsF(),
+        "MB/s");
+  }
+
+  std::vector<SpdyHeaderBlock> requests_;
+  std::vector<SpdyHeaderBlock> responses_;
+};
+
+TEST_F(HpackPerfTest, RequestHeaders) {
+  Encode("Hpack_request_headers", requests_);
+  Decode("Hpack_request_headers", requests_);
+}
+
+TEST_F(HpackPerfTest, ResponseHeaders) {
+  Encode("Hpack_response_headers", responses_);
+  Decode("Hpack_response_headers", responses_);
+}
+
+}  // namespace net
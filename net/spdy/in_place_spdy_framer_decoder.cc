@@ -0,0 +1,251 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/spdy/in_place_spdy_framer_decoder.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <utility>
+
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/sys_byteorder.h"
+#include "net/spdy/spdy_bitmasks.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace net {
+
+namespace {
+
+// Size of the fixed HTTP/2 frame header: 24-bit length, 8-bit type, 8-bit
+// flags and 31-bit stream id.
+const size_t kFrameHeaderSize = 9;
+
+// Payload sizes of the fixed-length frames that are decoded in place.
+const size_t kWindowUpdatePayloadSize = 4;
+const size_t kPingPayloadSize = 8;
+
+uint32_t ReadUInt24(const char* data) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  return (bytes[0] << 16) | (bytes[1] << 8) | bytes[2];
+}
+
+uint32_t ReadUInt32(const char* data) {
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  return base::NetToHost32(value);
+}
+
+uint64_t ReadUInt64(const char* data) {
+  uint64_t value;
+  memcpy(&value, data, sizeof(value));
+  return base::NetToHost64(value);
+}
+
+// Passes all calls on to the visitor, while keeping track of whether the
+// nested SpdyFramer is in the middle of a header block. DATA, WINDOW_UPDATE and
+// PING frames arriving then are protocol errors, which only the nested framer
+// reports.
+class ContinuationTrackingVisitor : public SpdyFramerVisitorAdapter {
+ public:
+  ContinuationTrackingVisitor(SpdyFramerVisitorInterface* visitor,
+                              SpdyFramer* framer)
+      : SpdyFramerVisitorAdapter(visitor, framer),
+        expect_continuation_(false) {}
+  ~ContinuationTrackingVisitor() override {}
+
+  bool expect_continuation() const { return expect_continuation_; }
+  void reset_expect_continuation() { expect_continuation_ = false; }
+
+  void OnError(SpdyFramer* framer) override {
+    expect_continuation_ = false;
+    SpdyFramerVisitorAdapter::OnError(framer);
+  }
+
+  void OnHeaders(SpdyStreamId stream_id,
+                 bool has_priority,
+                 int weight,
+                 SpdyStreamId parent_stream_id,
+                 bool exclusive,
+                 bool fin,
+                 bool end) override {
+    expect_continuation_ = !end;
+    SpdyFramerVisitorAdapter::OnHeaders(stream_id, has_priority, weight,
+                                        parent_stream_id, exclusive, fin, end);
+  }
+
+  void OnPushPromise(SpdyStreamId stream_id,
+                     SpdyStreamId promised_stream_id,
+                     bool end) override {
+    expect_continuation_ = !end;
+    SpdyFramerVisitorAdapter::OnPushPromise(stream_id, promised_stream_id,
+                                            end);
+  }
+
+  void OnContinuation(SpdyStreamId stream_id, bool end) override {
+    expect_continuation_ = !end;
+    SpdyFramerVisitorAdapter::OnContinuation(stream_id, end);
+  }
+
+ private:
+  bool expect_continuation_;
+
+  DISALLOW_COPY_AND_ASSIGN(ContinuationTrackingVisitor);
+};
+
+class InPlaceSpdyFramerDecoder : public SpdyFramerDecoderAdapter {
+ public:
+  explicit InPlaceSpdyFramerDecoder(SpdyFramer* outer)
+      : framer_(HTTP2, nullptr),
+        outer_(outer),
+        data_frame_type_(SpdyConstants::SerializeFrameType(HTTP2, DATA)),
+        window_update_frame_type_(
+            SpdyConstants::SerializeFrameType(HTTP2, WINDOW_UPDATE)),
+        ping_frame_type_(SpdyConstants::SerializeFrameType(HTTP2, PING)) {
+    // The nested framer always stops at frame boundaries, so that the next
+    // frame gets a chance to be decoded in place.
+    framer_.set_process_single_input_frame(true);
+  }
+  ~InPlaceSpdyFramerDecoder() override {}
+
+  void set_visitor(SpdyFramerVisitorInterface* visitor) override {
+    visitor_adapter_.reset(new ContinuationTrackingVisitor(visitor, outer_));
+    SpdyFramerDecoderAdapter::set_visitor(visitor_adapter_.get());
+    framer_.set_visitor(visitor_adapter_.get());
+  }
+
+  void set_debug_visitor(
+      SpdyFramerDebugVisitorInterface* debug_visitor) override {
+    SpdyFramerDecoderAdapter::set_debug_visitor(debug_visitor);
+    framer_.set_debug_visitor(debug_visitor);
+  }
+
+  void SetDecoderHeaderTableDebugVisitor(
+      std::unique_ptr<HpackHeaderTable::DebugVisitorInterface> visitor)
+      override {
+    framer_.SetDecoderHeaderTableDebugVisitor(std::move(visitor));
+  }
+
+  size_t ProcessInput(const char* data, size_t len) override {
+    const size_t original_len = len;
+    while (len > 0) {
+      size_t bytes_read = 0;
+      if (framer_.state() == SpdyFramer::SPDY_READY_FOR_FRAME &&
+          !visitor_adapter_->expect_continuation()) {
+        bytes_read = ProcessCompleteFrame(data, len);
+      }
+      bool in_place = bytes_read > 0;
+      if (!in_place)
+        bytes_read = framer_.ProcessInput(data, len);
+      data += bytes_read;
+      len -= bytes_read;
+      if (!in_place &&
+          (bytes_read == 0 || framer_.state() == SpdyFramer::SPDY_ERROR)) {
+        break;
+      }
+      if (process_single_input_frame() &&
+          framer_.state() == SpdyFramer::SPDY_READY_FOR_FRAME) {
+        break;
+      }
+    }
+    return original_len - len;
+  }
+
+  void Reset() override {
+    framer_.Reset();
+    visitor_adapter_->reset_expect_continuation();
+  }
+
+  SpdyFramer::SpdyError error_code() const override {
+    return framer_.error_code();
+  }
+  SpdyFramer::SpdyState state() const override { return framer_.state(); }
+  bool probable_http_response() const override {
+    return framer_.probable_http_response();
+  }
+
+ private:
+  // If |data| starts with a complete, well-formed DATA, WINDOW_UPDATE or PING
+  // frame, delivers it to the visitor and returns its size on the wire.
+  // Otherwise returns 0 without side effects, and the nested framer is left to
+  // buffer the frame or to report the error.
+  size_t ProcessCompleteFrame(const char* data, size_t len) {
+    if (len < kFrameHeaderSize)
+      return 0;
+    const size_t payload_len = ReadUInt24(data);
+    const size_t frame_len = kFrameHeaderSize + payload_len;
+    if (len < frame_len || payload_len > kSpdyInitialFrameSizeLimit)
+      return 0;
+
+    const int type = static_cast<uint8_t>(data[3]);
+    const uint8_t flags = static_cast<uint8_t>(data[4]);
+    const SpdyStreamId stream_id = ReadUInt32(data + 5) & kStreamIdMask;
+    const char* payload = data + kFrameHeaderSize;
+
+    if (type == data_frame_type_) {
+      if (stream_id == 0 || (flags & ~(DATA_FLAG_FIN | DATA_FLAG_PADDED)))
+        return 0;
+      size_t padding_len = 0;
+      bool padded = payload_len > 0 && (flags & DATA_FLAG_PADDED);
+      if (padded) {
+        padding_len = static_cast<uint8_t>(payload[0]);
+        if (padding_len + 1 > payload_len)
+          return 0;
+      }
+
+      visitor()->OnDataFrameHeader(stream_id, payload_len,
+                                   (flags & DATA_FLAG_FIN) != 0);
+      if (padded)
+        visitor()->OnStreamPadding(stream_id, 1);
+      size_t data_len = payload_len - padding_len - (padded ? 1 : 0);
+      if (data_len > 0) {
+        visitor()->OnStreamFrameData(stream_id, payload + (padded ? 1 : 0),
+                                     data_len);
+      }
+      if (padding_len > 0)
+        visitor()->OnStreamPadding(stream_id, padding_len);
+      if (flags & DATA_FLAG_FIN)
+        visitor()->OnStreamEnd(stream_id);
+      return frame_len;
+    }
+
+    if (type == window_update_frame_type_) {
+      if (payload_len != kWindowUpdatePayloadSize)
+        return 0;
+      visitor()->OnWindowUpdate(stream_id, ReadUInt32(payload));
+      return frame_len;
+    }
+
+    if (type == ping_frame_type_) {
+      if (payload_len != kPingPayloadSize || stream_id != 0)
+        return 0;
+      visitor()->OnPing(ReadUInt64(payload), (flags & PING_FLAG_ACK) != 0);
+      return frame_len;
+    }
+
+    return 0;
+  }
+
+  SpdyFramer framer_;
+  SpdyFramer* const outer_;
+  std::unique_ptr<ContinuationTrackingVisitor> visitor_adapter_;
+
+  // HTTP/2 wire values of the frame types that are decoded in place.
+  const int data_frame_type_;
+  const int window_update_frame_type_;
+  const int ping_frame_type_;
+
+  DISALLOW_COPY_AND_ASSIGN(InPlaceSpdyFramerDecoder);
+};
+
+}  // namespace
+
+std::unique_ptr<SpdyFramerDecoderAdapter> CreateInPlaceSpdyFramerDecoder(
+    SpdyFramer* outer) {
+  return std::unique_ptr<SpdyFramerDecoderAdapter>(
+      new InPlaceSpdyFramerDecoder(outer));
+}
+
+}  // namespace net
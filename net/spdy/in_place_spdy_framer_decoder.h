@@ -0,0 +1,28 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_SPDY_IN_PLACE_SPDY_FRAMER_DECODER_H_
+#define NET_SPDY_IN_PLACE_SPDY_FRAMER_DECODER_H_
+
+#include <memory>
+
+#include "net/base/net_export.h"
+#include "net/spdy/spdy_framer.h"
+#include "net/spdy/spdy_framer_decoder_adapter.h"
+
+namespace net {
+
+// Create an instance of InPlaceSpdyFramerDecoder, which implements
+// SpdyFramerDecoderAdapter. Whenever the input starts with a complete DATA,
+// WINDOW_UPDATE or PING frame, that frame is decoded directly from the
+// caller's buffer without copying its header into the framer's frame buffer or
+// stepping through the per-state bookkeeping of SpdyFramer. All other frames,
+// and frames that are split across calls to ProcessInput, are handed to a
+// nested SpdyFramer, which buffers as needed.
+NET_EXPORT_PRIVATE std::unique_ptr<SpdyFramerDecoderAdapter>
+CreateInPlaceSpdyFramerDecoder(SpdyFramer* outer);
+
+}  // namespace net
+
+#endif  // NET_SPDY_IN_PLACE_SPDY_FRAMER_DECODER_H_
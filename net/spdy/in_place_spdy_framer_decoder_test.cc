@@ -0,0 +1,223 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/spdy/in_place_spdy_framer_decoder.h"
+
+#include <string>
+
+#include "base/macros.h"
+#include "net/spdy/mock_spdy_framer_visitor.h"
+#include "net/spdy/spdy_framer.h"
+#include "net/spdy/spdy_protocol.h"
+#include "testing/gmock/include/gmock/gmock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using testing::InSequence;
+using testing::StrictMock;
+using testing::_;
+
+namespace net {
+
+namespace test {
+
+namespace {
+
+const char kMixedFrames[] = {
+    0x00, 0x00, 0x03,        // Length: 3
+    0x00,                    //   Type: DATA
+    0x00,                    //  Flags: none
+    0x00, 0x00, 0x00, 0x01,  // Stream: 1
+    'f',  'o',  'o',         // Payload
+
+    0x00, 0x00, 0x04,        // Length: 4
+    0x08,                    //   Type: WINDOW_UPDATE
+    0x00,                    //  Flags: none
+    0x00, 0x00, 0x00, 0x03,  // Stream: 3
+    0x00, 0x00, 0x10, 0x00,  //  Delta: 4096
+
+    0x00, 0x00, 0x08,        // Length: 8
+    0x06,                    //   Type: PING
+    0x01,                    //  Flags: ACK
+    0x00, 0x00, 0x00, 0x00,  // Stream: 0
+    0x00, 0x00, 0x00, 0x00,  //     Id: 42
+    0x00, 0x00, 0x00, 0x2a,  //
+
+    0x00, 0x00, 0x06,        // Length: 6
+    0x00,                    //   Type: DATA
+    0x09,                    //  Flags: END_STREAM|PADDED
+    0x00, 0x00, 0x00, 0x01,  // Stream: 1
+    0x02,                    // PadLen: 2 trailing bytes
+    'b',  'a',  'r',         // Payload
+    0x00, 0x00,              // Padding
+};
+
+class InPlaceSpdyFramerDecoderTest : public ::testing::Test {
+ protected:
+  InPlaceSpdyFramerDecoderTest()
+      : framer_(HTTP2, &CreateInPlaceSpdyFramerDecoder) {
+    framer_.set_visitor(&visitor_);
+  }
+
+  // Expects the frames of |kMixedFrames|, allowing DATA payload and padding
+  // to be delivered in pieces.
+  void ExpectMixedFrames() {
+    data_.clear();
+    padding_ = 0;
+    EXPECT_CALL(visitor_, OnDataFrameHeader(1, 3, false));
+    EXPECT_CALL(visitor_, OnWindowUpdate(3, 4096));
+    EXPECT_CALL(visitor_, OnPing(42, true));
+    EXPECT_CALL(visitor_, OnDataFrameHeader(1, 6, true));
+    EXPECT_CALL(visitor_, OnStreamFrameData(1, _, _))
+        .WillRepeatedly(
+            testing::Invoke(this, &InPlaceSpdyFramerDecoderTest::OnData));
+    EXPECT_CALL(visitor_, OnStreamPadding(1, _))
+        .WillRepeatedly(
+            testing::Invoke(this, &InPlaceSpdyFramerDecoderTest::OnPadding));
+    EXPECT_CALL(visitor_, OnStreamEnd(1));
+  }
+
+  void VerifyMixedFrames() {
+    EXPECT_EQ("foobar", data_);
+    EXPECT_EQ(3u, padding_);
+    testing::Mock::VerifyAndClearExpectations(&visitor_);
+  }
+
+  void OnData(SpdyStreamId stream_id, const char* data, size_t len) {
+    data_.append(data, len);
+  }
+
+  void OnPadding(SpdyStreamId stream_id, size_t len) { padding_ += len; }
+
+  StrictMock<MockSpdyFramerVisitor> visitor_;
+  SpdyFramer framer_;
+  std::string data_;
+  size_t padding_ = 0;
+};
+
+// Complete frames are delivered straight out of the input buffer.
+TEST_F(InPlaceSpdyFramerDecoderTest, CompleteFramesDecodedInPlace) {
+  InSequence seq;
+  EXPECT_CALL(visitor_, OnDataFrameHeader(1, 3, false));
+  EXPECT_CALL(visitor_, OnStreamFrameData(1, kMixedFrames + 9, 3));
+  EXPECT_CALL(visitor_, OnWindowUpdate(3, 4096));
+  EXPECT_CALL(visitor_, OnPing(42, true));
+  EXPECT_CALL(visitor_, OnDataFrameHeader(1, 6, true));
+  EXPECT_CALL(visitor_, OnStreamPadding(1, 1));
+  EXPECT_CALL(visitor_, OnStreamFrameData(1, kMixedFrames + 52, 3));
+  EXPECT_CALL(visitor_, OnStreamPadding(1, 2));
+  EXPECT_CALL(visitor_, OnStreamEnd(1));
+
+  EXPECT_EQ(sizeof(kMixedFrames),
+            framer_.ProcessInput(kMixedFrames, sizeof(kMixedFrames)));
+  EXPECT_FALSE(framer_.HasError());
+  EXPECT_EQ(SpdyFramer::SPDY_READY_FOR_FRAME, framer_.state());
+}
+
+// Frames split across reads are buffered by the nested framer, and the visitor
+// sees the same calls as for complete frames.
+TEST_F(InPlaceSpdyFramerDecoderTest, SplitFrames) {
+  ExpectMixedFrames();
+
+  for (size_t i = 0; i < sizeof(kMixedFrames); ++i)
+    EXPECT_EQ(1u, framer_.ProcessInput(kMixedFrames + i, 1));
+  EXPECT_FALSE(framer_.HasError());
+  EXPECT_EQ(SpdyFramer::SPDY_READY_FOR_FRAME, framer_.state());
+  VerifyMixedFrames();
+}
+
+// Frames that start in the middle of one read and end in the next are handed
+// back to the in place path once the nested framer has finished them.
+TEST_F(InPlaceSpdyFramerDecoderTest, FrameSplitAtEveryOffset) {
+  for (size_t split = 1; split < sizeof(kMixedFrames); ++split) {
+    ExpectMixedFrames();
+    EXPECT_EQ(split, framer_.ProcessInput(kMixedFrames, split));
+    EXPECT_EQ(sizeof(kMixedFrames) - split,
+              framer_.ProcessInput(kMixedFrames + split,
+                                   sizeof(kMixedFrames) - split));
+    EXPECT_FALSE(framer_.HasError());
+    VerifyMixedFrames();
+  }
+}
+
+TEST_F(InPlaceSpdyFramerDecoderTest, ProcessSingleInputFrame) {
+  ExpectMixedFrames();
+  framer_.set_process_single_input_frame(true);
+
+  EXPECT_EQ(12u, framer_.ProcessInput(kMixedFrames, sizeof(kMixedFrames)));
+  EXPECT_EQ(13u,
+            framer_.ProcessInput(kMixedFrames + 12, sizeof(kMixedFrames) - 12));
+  EXPECT_EQ(17u,
+            framer_.ProcessInput(kMixedFrames + 25, sizeof(kMixedFrames) - 25));
+  EXPECT_EQ(15u,
+            framer_.ProcessInput(kMixedFrames + 42, sizeof(kMixedFrames) - 42));
+  VerifyMixedFrames();
+}
+
+// Malformed frames are left to the nested framer, which reports the error.
+TEST_F(InPlaceSpdyFramerDecoderTest, DataWithStreamIdZero) {
+  const char kInput[] = {
+      0x00, 0x00, 0x03,        // Length: 3
+      0x00,                    //   Type: DATA
+      0x00,                    //  Flags: none
+      0x00, 0x00, 0x00, 0x00,  // Stream: 0
+      'f',  'o',  'o',         // Payload
+  };
+
+  EXPECT_CALL(visitor_, OnError(&framer_));
+  EXPECT_GT(sizeof(kInput), framer_.ProcessInput(kInput, sizeof(kInput)));
+  EXPECT_EQ(SpdyFramer::SPDY_INVALID_STREAM_ID, framer_.error_code())
+      << SpdyFramer::ErrorCodeToString(framer_.error_code());
+}
+
+TEST_F(InPlaceSpdyFramerDecoderTest, OversizedDataPadding) {
+  const char kInput[] = {
+      0x00, 0x00, 0x03,        // Length: 3
+      0x00,                    //   Type: DATA
+      0x08,                    //  Flags: PADDED
+      0x00, 0x00, 0x00, 0x01,  // Stream: 1
+      0x05,                    // PadLen: 5 trailing bytes (Too Long)
+      0x00, 0x00,              // Padding
+  };
+
+  InSequence seq;
+  EXPECT_CALL(visitor_, OnDataFrameHeader(1, 3, false));
+  EXPECT_CALL(visitor_, OnStreamPadding(1, 1));
+  EXPECT_CALL(visitor_, OnError(&framer_));
+  EXPECT_GT(sizeof(kInput), framer_.ProcessInput(kInput, sizeof(kInput)));
+  EXPECT_EQ(SpdyFramer::SPDY_INVALID_PADDING, framer_.error_code())
+      << SpdyFramer::ErrorCodeToString(framer_.error_code());
+}
+
+// A DATA frame in the middle of a header block is a protocol error, even if it
+// is complete and otherwise well-formed.
+TEST_F(InPlaceSpdyFramerDecoderTest, ExpectContinuationReceiveData) {
+  const char kInput[] = {
+      0x00, 0x00, 0x10,        // Length: 16
+      0x01,                    //   Type: HEADERS
+      0x00,                    //  Flags: none
+      0x00, 0x00, 0x00, 0x01,  // Stream: 1
+      0x00, 0x06, 0x63, 0x6f,  // HPACK
+      0x6f, 0x6b, 0x69, 0x65,  //
+      0x07, 0x66, 0x6f, 0x6f,  //
+      0x3d, 0x62, 0x61, 0x72,  //
+
+      0x00, 0x00, 0x00,        // Length: 0
+      0x00,                    //   Type: DATA
+      0x01,                    //  Flags: END_STREAM
+      0x00, 0x00, 0x00, 0x01,  // Stream: 1
+  };
+
+  EXPECT_CALL(visitor_, OnHeaders(1, false, _, _, _, false, false));
+  EXPECT_CALL(visitor_, OnHeaderFrameStart(1));
+  EXPECT_CALL(visitor_, OnError(&framer_));
+  framer_.ProcessInput(kInput, sizeof(kInput));
+  EXPECT_EQ(SpdyFramer::SPDY_UNEXPECTED_FRAME, framer_.error_code())
+      << SpdyFramer::ErrorCodeToString(framer_.error_code());
+}
+
+}  // namespace
+
+}  // namespace test
+
+}  // namespace net
@@ -0,0 +1,188 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/spdy/server_push_store.h"
+
+#include <iterator>
+#include <utility>
+
+#include "base/logging.h"
+#include "base/metrics/histogram_macros.h"
+#include "base/values.h"
+
+namespace net {
+
+ServerPushStore::Stats::Stats()
+    : accepted(0),
+      claimed(0),
+      adopted(0),
+      adopted_used(0),
+      wasted(0),
+      claimed_bytes(0),
+      wasted_bytes(0) {}
+
+ServerPushStore::Entry::Entry(PushId id,
+                              const GURL& url,
+                              PrivacyMode privacy_mode,
+                              std::unique_ptr<Push> push)
+    : id(id),
+      url(url),
+      privacy_mode(privacy_mode),
+      push(std::move(push)),
+      bytes(0),
+      adopted(false) {}
+
+ServerPushStore::Entry::~Entry() {}
+
+ServerPushStore::ServerPushStore(size_t max_pushes, size_t max_bytes)
+    : max_pushes_(max_pushes),
+      max_bytes_(max_bytes),
+      bytes_(0),
+      next_id_(1) {}
+
+ServerPushStore::~ServerPushStore() {
+  DCHECK(thread_checker_.CalledOnValidThread());
+}
+
+void ServerPushStore::AddObserver(Observer* observer) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  observers_.AddObserver(observer);
+}
+
+void ServerPushStore::RemoveObserver(Observer* observer) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  observers_.RemoveObserver(observer);
+}
+
+ServerPushStore::PushId ServerPushStore::OnPushAccepted(
+    const GURL& url,
+    PrivacyMode privacy_mode,
+    std::unique_ptr<Push> push) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  PushId id = next_id_++;
+  pushes_.emplace_back(id, url, privacy_mode, std::move(push));
+  pushes_by_id_[id] = std::prev(pushes_.end());
+  ++stats_.accepted;
+
+  // A push is only claimed once, so it is adopted by one observer at most.
+  base::ObserverList<Observer>::Iterator it(&observers_);
+  Observer* observer;
+  while (!pushes_.back().adopted && (observer = it.GetNext()) != nullptr)
+    pushes_.back().adopted = observer->AdoptPush(url, privacy_mode);
+
+  EvictIfNeeded();
+  return id;
+}
+
+void ServerPushStore::OnPushDataReceived(PushId id, size_t len) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  auto it = pushes_by_id_.find(id);
+  if (it == pushes_by_id_.end())
+    return;
+  it->second->bytes += len;
+  bytes_ += len;
+  EvictIfNeeded();
+}
+
+void ServerPushStore::OnPushClaimed(PushId id) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  auto it = pushes_by_id_.find(id);
+  if (it == pushes_by_id_.end())
+    return;
+  EntryList::iterator entry = it->second;
+  Remove(entry, entry->adopted ? OUTCOME_ADOPTED : OUTCOME_CLAIMED, false);
+}
+
+void ServerPushStore::OnPushDiscarded(PushId id) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  auto it = pushes_by_id_.find(id);
+  if (it == pushes_by_id_.end())
+    return;
+  Remove(it->second, OUTCOME_DISCARDED, false);
+}
+
+bool ServerPushStore::HasPush(const GURL& url,
+                              PrivacyMode privacy_mode) const {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  for (const Entry& entry : pushes_) {
+    if (entry.url == url && entry.privacy_mode == privacy_mode)
+      return true;
+  }
+  return false;
+}
+
+void ServerPushStore::CancelPushes(const GURL& url) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  for (EntryList::iterator it = pushes_.begin(); it != pushes_.end();) {
+    EntryList::iterator next = std::next(it);
+    if (it->url == url)
+      Remove(it, OUTCOME_ALREADY_AVAILABLE, true);
+    it = next;
+  }
+}
+
+void ServerPushStore::OnAdoptedPushUsed() {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  ++stats_.adopted_used;
+}
+
+std::unique_ptr<base::Value> ServerPushStore::GetInfoAsValue() const {
+  std::unique_ptr<base::DictionaryValue> dict(new base::DictionaryValue());
+  dict->SetInteger("unclaimed_pushes", static_cast<int>(pushes_.size()));
+  dict->SetInteger("unclaimed_bytes", static_cast<int>(bytes_));
+  dict->SetInteger("max_pushes", static_cast<int>(max_pushes_));
+  dict->SetInteger("max_bytes", static_cast<int>(max_bytes_));
+  dict->SetInteger("accepted", static_cast<int>(stats_.accepted));
+  dict->SetInteger("claimed", static_cast<int>(stats_.claimed));
+  dict->SetInteger("adopted", static_cast<int>(stats_.adopted));
+  dict->SetInteger("adopted_used", static_cast<int>(stats_.adopted_used));
+  dict->SetInteger("wasted", static_cast<int>(stats_.wasted));
+  dict->SetDouble("claimed_bytes", static_cast<double>(stats_.claimed_bytes));
+  dict->SetDouble("wasted_bytes", static_cast<double>(stats_.wasted_bytes));
+  return std::move(dict);
+}
+
+void ServerPushStore::Remove(EntryList::iterator it,
+                             Outcome outcome,
+                             bool cancel) {
+  switch (outcome) {
+    case OUTCOME_CLAIMED:
+      ++stats_.claimed;
+      stats_.claimed_bytes += it->bytes;
+      break;
+    case OUTCOME_ADOPTED:
+      ++stats_.adopted;
+      stats_.claimed_bytes += it->bytes;
+      break;
+    case OUTCOME_DISCARDED:
+    case OUTCOME_EVICTED:
+    case OUTCOME_ALREADY_AVAILABLE:
+      ++stats_.wasted;
+      stats_.wasted_bytes += it->bytes;
+      UMA_HISTOGRAM_COUNTS("Net.ServerPush.WastedBytes", it->bytes);
+      break;
+    case OUTCOME_MAX:
+      NOTREACHED();
+      break;
+  }
+  UMA_HISTOGRAM_ENUMERATION("Net.ServerPush.Outcome", outcome, OUTCOME_MAX);
+
+  // The session may call back into the store when the push is cancelled, so
+  // forget about the push first.
+  std::unique_ptr<Push> push = std::move(it->push);
+  bytes_ -= it->bytes;
+  pushes_by_id_.erase(it->id);
+  pushes_.erase(it);
+  if (cancel)
+    push->Cancel();
+}
+
+void ServerPushStore::EvictIfNeeded() {
+  while (!pushes_.empty() &&
+         (pushes_.size() > max_pushes_ || bytes_ > max_bytes_)) {
+    Remove(pushes_.begin(), OUTCOME_EVICTED, true);
+  }
+}
+
+}  // namespace net
@@ -0,0 +1,181 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_SPDY_SERVER_PUSH_STORE_H_
+#define NET_SPDY_SERVER_PUSH_STORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <map>
+#include <memory>
+
+#include "base/macros.h"
+#include "base/observer_list.h"
+#include "base/threading/thread_checker.h"
+#include "net/base/net_export.h"
+#include "net/base/privacy_mode.h"
+#include "url/gurl.h"
+
+namespace base {
+class Value;
+}
+
+namespace net {
+
+// ServerPushStore keeps track of the server pushes that HTTP/2 and QUIC
+// sessions have accepted, but that no request has claimed yet. A single store
+// is shared by all sessions of an HttpNetworkSession. It bounds the number of
+// unclaimed pushes and the number of pushed body bytes buffered for them
+// across all sessions, cancelling the oldest pushes first, and counts how many
+// pushes were claimed and how many were wasted.
+//
+// Observers, such as the HTTP caches sharing the network session, can adopt
+// pushes as they are accepted.
+//
+// A store must only be used on a single thread.
+class NET_EXPORT_PRIVATE ServerPushStore {
+ public:
+  // Identifies a push for the lifetime of the store. Never 0.
+  typedef uint64_t PushId;
+
+  // Handle to a pushed stream, implemented by the session holding it.
+  class NET_EXPORT_PRIVATE Push {
+   public:
+    virtual ~Push() {}
+
+    // Resets the pushed stream. Called after the push has been removed from
+    // the store, possibly from within a call the session made into the store,
+    // so the session must not close the stream synchronously.
+    virtual void Cancel() = 0;
+  };
+
+  class NET_EXPORT_PRIVATE Observer {
+   public:
+    // Called when a session in |privacy_mode| accepts a push for |url|, until
+    // an observer adopts it. Returns true if the observer is going to claim
+    // the push by issuing a request for |url|, which it must not do
+    // synchronously.
+    virtual bool AdoptPush(const GURL& url, PrivacyMode privacy_mode) = 0;
+
+   protected:
+    virtual ~Observer() {}
+  };
+
+  struct NET_EXPORT_PRIVATE Stats {
+    Stats();
+
+    // Pushes accepted by a session.
+    size_t accepted;
+    // Pushes claimed by a request. Each of these saved a round trip.
+    size_t claimed;
+    // Pushes claimed by an observer.
+    size_t adopted;
+    // Adopted pushes that a request later got from an observer without
+    // going to the network.
+    size_t adopted_used;
+    // Pushes that went away without being claimed: reset by the server,
+    // expired, evicted from the store or already available to an observer.
+    size_t wasted;
+    // Pushed body bytes received before the push was claimed, or wasted.
+    int64_t claimed_bytes;
+    int64_t wasted_bytes;
+  };
+
+  // Up to |max_pushes| pushes, holding no more than |max_bytes| of pushed
+  // body in total, are kept unclaimed.
+  ServerPushStore(size_t max_pushes, size_t max_bytes);
+  ~ServerPushStore();
+
+  // Observers must be removed before they are destroyed.
+  void AddObserver(Observer* observer);
+  void RemoveObserver(Observer* observer);
+
+  // Called by sessions. Pushes are reported by the id returned from
+  // OnPushAccepted(), which the session must stop using once it reports the
+  // push claimed or discarded, or once the push is cancelled. Reports on
+  // pushes no longer in the store are ignored.
+  PushId OnPushAccepted(const GURL& url,
+                        PrivacyMode privacy_mode,
+                        std::unique_ptr<Push> push);
+  void OnPushDataReceived(PushId id, size_t len);
+  void OnPushClaimed(PushId id);
+  void OnPushDiscarded(PushId id);
+
+  // Called by observers. Returns true if a push for |url|, accepted by a
+  // session in |privacy_mode|, is still waiting to be claimed.
+  bool HasPush(const GURL& url, PrivacyMode privacy_mode) const;
+
+  // Called by observers. Cancels all pushes for |url|, because the observer
+  // already has a usable response for it.
+  void CancelPushes(const GURL& url);
+
+  // Called by observers when a request got a response that was adopted from
+  // a push.
+  void OnAdoptedPushUsed();
+
+  size_t num_pushes() const { return pushes_.size(); }
+  size_t bytes() const { return bytes_; }
+  const Stats& stats() const { return stats_; }
+
+  // Returns a summary of the store for net-internals.
+  std::unique_ptr<base::Value> GetInfoAsValue() const;
+
+ private:
+  // These values are logged to UMA. Entries should not be renumbered.
+  enum Outcome {
+    OUTCOME_CLAIMED = 0,
+    OUTCOME_ADOPTED = 1,
+    OUTCOME_DISCARDED = 2,
+    OUTCOME_EVICTED = 3,
+    OUTCOME_ALREADY_AVAILABLE = 4,
+    OUTCOME_MAX
+  };
+
+  struct Entry {
+    Entry(PushId id,
+          const GURL& url,
+          PrivacyMode privacy_mode,
+          std::unique_ptr<Push> push);
+    ~Entry();
+
+    PushId id;
+    GURL url;
+    PrivacyMode privacy_mode;
+    std::unique_ptr<Push> push;
+    size_t bytes;
+    // Whether an observer is going to claim this push.
+    bool adopted;
+  };
+
+  // Pushes in the order they were accepted.
+  typedef std::list<Entry> EntryList;
+
+  // Removes |it| from the store, and records |outcome|. If |cancel| is true,
+  // resets the pushed stream.
+  void Remove(EntryList::iterator it, Outcome outcome, bool cancel);
+
+  // Cancels the oldest pushes until the store is within its limits.
+  void EvictIfNeeded();
+
+  const size_t max_pushes_;
+  const size_t max_bytes_;
+  base::ObserverList<Observer> observers_;
+
+  EntryList pushes_;
+  std::map<PushId, EntryList::iterator> pushes_by_id_;
+  size_t bytes_;
+  PushId next_id_;
+
+  Stats stats_;
+
+  base::ThreadChecker thread_checker_;
+
+  DISALLOW_COPY_AND_ASSIGN(ServerPushStore);
+};
+
+}  // namespace net
+
+#endif  // NET_SPDY_SERVER_PUSH_STORE_H_
@@ -0,0 +1,231 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/spdy/server_push_store.h"
+
+#include <memory>
+#include <vector>
+
+#include "base/macros.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "url/gurl.h"
+
+namespace net {
+
+namespace {
+
+const size_t kMaxPushes = 3;
+const size_t kMaxBytes = 1000;
+
+// Records the URLs of the pushes that got cancelled.
+class TestPush : public ServerPushStore::Push {
+ public:
+  TestPush(const GURL& url, std::vector<GURL>* cancelled)
+      : url_(url), cancelled_(cancelled) {}
+  ~TestPush() override {}
+
+  void Cancel() override { cancelled_->push_back(url_); }
+
+ private:
+  const GURL url_;
+  std::vector<GURL>* const cancelled_;
+};
+
+class TestObserver : public ServerPushStore::Observer {
+ public:
+  TestObserver() : adopt_(true) {}
+  ~TestObserver() override {}
+
+  bool AdoptPush(const GURL& url, PrivacyMode privacy_mode) override {
+    offered_.push_back(url);
+    return adopt_;
+  }
+
+  void set_adopt(bool adopt) { adopt_ = adopt; }
+  const std::vector<GURL>& offered() const { return offered_; }
+
+ private:
+  bool adopt_;
+  std::vector<GURL> offered_;
+};
+
+class ServerPushStoreTest : public ::testing::Test {
+ protected:
+  ServerPushStoreTest() : store_(kMaxPushes, kMaxBytes) {}
+
+  ServerPushStore::PushId Accept(const GURL& url) {
+    return store_.OnPushAccepted(
+        url, PRIVACY_MODE_DISABLED,
+        std::unique_ptr<ServerPushStore::Push>(new TestPush(url, &cancelled_)));
+  }
+
+  ServerPushStore store_;
+  std::vector<GURL> cancelled_;
+};
+
+TEST_F(ServerPushStoreTest, ClaimedPushIsAHit) {
+  ServerPushStore::PushId id = Accept(GURL("https://www.example.org/a.js"));
+  store_.OnPushDataReceived(id, 100);
+  EXPECT_EQ(1u, store_.num_pushes());
+  EXPECT_EQ(100u, store_.bytes());
+
+  store_.OnPushClaimed(id);
+  EXPECT_EQ(0u, store_.num_pushes());
+  EXPECT_EQ(0u, store_.bytes());
+  EXPECT_EQ(1u, store_.stats().accepted);
+  EXPECT_EQ(1u, store_.stats().claimed);
+  EXPECT_EQ(100, store_.stats().claimed_bytes);
+  EXPECT_EQ(0u, store_.stats().wasted);
+
+  // Data arriving after the claim is not buffered by the store any more.
+  store_.OnPushDataReceived(id, 100);
+  store_.OnPushDiscarded(id);
+  EXPECT_EQ(0u, store_.bytes());
+  EXPECT_EQ(0u, store_.stats().wasted);
+  EXPECT_TRUE(cancelled_.empty());
+}
+
+TEST_F(ServerPushStoreTest, DiscardedPushIsWasted) {
+  ServerPushStore::PushId id = Accept(GURL("https://www.example.org/a.js"));
+  store_.OnPushDataReceived(id, 200);
+  store_.OnPushDiscarded(id);
+  EXPECT_EQ(0u, store_.num_pushes());
+  EXPECT_EQ(1u, store_.stats().wasted);
+  EXPECT_EQ(200, store_.stats().wasted_bytes);
+  EXPECT_EQ(0u, store_.stats().claimed);
+  // The session already got rid of the stream.
+  EXPECT_TRUE(cancelled_.empty());
+}
+
+// Once more than |kMaxPushes| pushes are unclaimed, the oldest is cancelled.
+TEST_F(ServerPushStoreTest, EvictsOldestPushOverCountLimit) {
+  const GURL kUrls[] = {
+      GURL("https://www.example.org/0"), GURL("https://www.example.org/1"),
+      GURL("https://www.example.org/2"), GURL("https://www.example.org/3"),
+  };
+  ServerPushStore::PushId ids[arraysize(kUrls)];
+  for (size_t i = 0; i < arraysize(kUrls); ++i)
+    ids[i] = Accept(kUrls[i]);
+
+  EXPECT_EQ(kMaxPushes, store_.num_pushes());
+  ASSERT_EQ(1u, cancelled_.size());
+  EXPECT_EQ(kUrls[0], cancelled_[0]);
+  EXPECT_EQ(1u, store_.stats().wasted);
+
+  // The session reports the reset stream, which is not counted twice.
+  store_.OnPushDiscarded(ids[0]);
+  EXPECT_EQ(1u, store_.stats().wasted);
+  store_.OnPushClaimed(ids[0]);
+  EXPECT_EQ(0u, store_.stats().claimed);
+}
+
+// Pushes are cancelled, oldest first, until the buffered bytes fit the limit
+// again.
+TEST_F(ServerPushStoreTest, EvictsOldestPushesOverByteLimit) {
+  const GURL kUrl0("https://www.example.org/0");
+  const GURL kUrl1("https://www.example.org/1");
+  const GURL kUrl2("https://www.example.org/2");
+  ServerPushStore::PushId id0 = Accept(kUrl0);
+  ServerPushStore::PushId id1 = Accept(kUrl1);
+  ServerPushStore::PushId id2 = Accept(kUrl2);
+  store_.OnPushDataReceived(id0, 400);
+  store_.OnPushDataReceived(id1, 400);
+  EXPECT_TRUE(cancelled_.empty());
+
+  store_.OnPushDataReceived(id2, 500);
+  ASSERT_EQ(2u, cancelled_.size());
+  EXPECT_EQ(kUrl0, cancelled_[0]);
+  EXPECT_EQ(kUrl1, cancelled_[1]);
+  EXPECT_EQ(1u, store_.num_pushes());
+  EXPECT_EQ(500u, store_.bytes());
+  EXPECT_EQ(800, store_.stats().wasted_bytes);
+}
+
+// Claims of pushes an observer adopted are counted separately from hits.
+TEST_F(ServerPushStoreTest, AdoptedPush) {
+  TestObserver observer;
+  store_.AddObserver(&observer);
+
+  const GURL kAdoptedUrl("https://www.example.org/adopted");
+  const GURL kDeclinedUrl("https://www.example.org/declined");
+  ServerPushStore::PushId adopted_id = Accept(kAdoptedUrl);
+  observer.set_adopt(false);
+  ServerPushStore::PushId declined_id = Accept(kDeclinedUrl);
+  ASSERT_EQ(2u, observer.offered().size());
+  EXPECT_EQ(kAdoptedUrl, observer.offered()[0]);
+  EXPECT_EQ(kDeclinedUrl, observer.offered()[1]);
+
+  store_.OnPushClaimed(adopted_id);
+  store_.OnPushClaimed(declined_id);
+  EXPECT_EQ(1u, store_.stats().adopted);
+  EXPECT_EQ(1u, store_.stats().claimed);
+
+  store_.OnAdoptedPushUsed();
+  EXPECT_EQ(1u, store_.stats().adopted_used);
+  store_.RemoveObserver(&observer);
+}
+
+// A push is offered to the observers until one adopts it, and observers can be
+// removed independently of each other.
+TEST_F(ServerPushStoreTest, SeveralObservers) {
+  TestObserver first;
+  TestObserver second;
+  store_.AddObserver(&first);
+  store_.AddObserver(&second);
+
+  const GURL kUrl0("https://www.example.org/0");
+  const GURL kUrl1("https://www.example.org/1");
+  const GURL kUrl2("https://www.example.org/2");
+  first.set_adopt(false);
+  store_.OnPushClaimed(Accept(kUrl0));
+  EXPECT_EQ(1u, first.offered().size());
+  EXPECT_EQ(1u, second.offered().size());
+  EXPECT_EQ(1u, store_.stats().adopted);
+
+  first.set_adopt(true);
+  Accept(kUrl1);
+  EXPECT_EQ(2u, first.offered().size());
+  EXPECT_EQ(1u, second.offered().size());
+
+  store_.RemoveObserver(&first);
+  Accept(kUrl2);
+  EXPECT_EQ(2u, first.offered().size());
+  ASSERT_EQ(2u, second.offered().size());
+  EXPECT_EQ(kUrl2, second.offered()[1]);
+  store_.RemoveObserver(&second);
+}
+
+TEST_F(ServerPushStoreTest, HasPush) {
+  const GURL kUrl("https://www.example.org/a.js");
+  EXPECT_FALSE(store_.HasPush(kUrl, PRIVACY_MODE_DISABLED));
+  ServerPushStore::PushId id = Accept(kUrl);
+  EXPECT_TRUE(store_.HasPush(kUrl, PRIVACY_MODE_DISABLED));
+  EXPECT_FALSE(store_.HasPush(kUrl, PRIVACY_MODE_ENABLED));
+  store_.OnPushClaimed(id);
+  EXPECT_FALSE(store_.HasPush(kUrl, PRIVACY_MODE_DISABLED));
+}
+
+// Pushes for a URL an observer already has a response for are cancelled.
+TEST_F(ServerPushStoreTest, CancelPushes) {
+  const GURL kUrl("https://www.example.org/a.js");
+  const GURL kOtherUrl("https://www.example.org/b.js");
+  ServerPushStore::PushId id = Accept(kUrl);
+  Accept(kOtherUrl);
+  // The same URL may be pushed on another session.
+  Accept(kUrl);
+
+  store_.CancelPushes(kUrl);
+  ASSERT_EQ(2u, cancelled_.size());
+  EXPECT_EQ(kUrl, cancelled_[0]);
+  EXPECT_EQ(kUrl, cancelled_[1]);
+  EXPECT_EQ(1u, store_.num_pushes());
+  EXPECT_EQ(2u, store_.stats().wasted);
+
+  store_.OnPushClaimed(id);
+  EXPECT_EQ(0u, store_.stats().claimed);
+}
+
+}  // namespace
+
+}  // namespace net
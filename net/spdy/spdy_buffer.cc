@@ -11,6 +11,7 @@
 #include "base/logging.h"
 #include "base/macros.h"
 #include "net/base/io_buffer.h"
+#include "net/spdy/spdy_buffer_pool.h"
 #include "net/spdy/spdy_protocol.h"
 
 namespace net {
@@ -36,6 +37,37 @@ std::unique_ptr<SpdySerializedFrame> MakeSpdySerializedFrame(const char* data,
 
 }  // namespace
 
+// Holds the frame a SpdyBuffer was constructed with. If the frame's storage
+// was handed out by a SpdyBufferPool, it is returned to the pool when the
+// last reference goes away. Like the pool, it is only used on the thread of
+// the session.
+class SpdyBuffer::SharedFrame : public base::RefCounted<SharedFrame> {
+ public:
+  explicit SharedFrame(std::unique_ptr<SpdySerializedFrame> frame)
+      : frame_(std::move(frame)) {}
+
+  SharedFrame(const scoped_refptr<SpdyBufferPool>& pool,
+              char* block,
+              size_t size)
+      : frame_(new SpdySerializedFrame(block, size, false /* owns_buffer */)),
+        pool_(pool) {}
+
+  const SpdySerializedFrame& frame() const { return *frame_; }
+
+ private:
+  friend class base::RefCounted<SharedFrame>;
+
+  ~SharedFrame() {
+    if (pool_)
+      pool_->ReturnBlock(frame_->data(), frame_->size());
+  }
+
+  const std::unique_ptr<SpdySerializedFrame> frame_;
+  const scoped_refptr<SpdyBufferPool> pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedFrame);
+};
+
 // This class is an IOBuffer implementation that simply holds a
 // reference to a SharedFrame object and a fixed offset. Used by
 // SpdyBuffer::GetIOBufferForRemainingData().
@@ -43,7 +75,7 @@ class SpdyBuffer::SharedFrameIOBuffer : public IOBuffer {
  public:
   SharedFrameIOBuffer(const scoped_refptr<SharedFrame>& shared_frame,
                       size_t offset)
-      : IOBuffer(shared_frame->data->data() + offset),
+      : IOBuffer(shared_frame->frame().data() + offset),
         shared_frame_(shared_frame) {}
 
  private:
@@ -58,18 +90,20 @@ class SpdyBuffer::SharedFrameIOBuffer : public IOBuffer {
 };
 
 SpdyBuffer::SpdyBuffer(std::unique_ptr<SpdySerializedFrame> frame)
-    : shared_frame_(new SharedFrame()), offset_(0) {
-  shared_frame_->data = std::move(frame);
-}
+    : shared_frame_(new SharedFrame(std::move(frame))), offset_(0) {}
 
 // The given data may not be strictly a SPDY frame; we (ab)use
 // |frame_| just as a container.
-SpdyBuffer::SpdyBuffer(const char* data, size_t size) :
-    shared_frame_(new SharedFrame()),
-    offset_(0) {
+SpdyBuffer::SpdyBuffer(const char* data, size_t size)
+    : shared_frame_(new SharedFrame(MakeSpdySerializedFrame(data, size))),
+      offset_(0) {}
+
+SpdyBuffer::SpdyBuffer(const scoped_refptr<SpdyBufferPool>& pool,
+                       char* block,
+                       size_t size)
+    : shared_frame_(new SharedFrame(pool, block, size)), offset_(0) {
   CHECK_GT(size, 0u);
   CHECK_LE(size, kMaxSpdyFrameSize);
-  shared_frame_->data = MakeSpdySerializedFrame(data, size);
 }
 
 SpdyBuffer::~SpdyBuffer() {
@@ -78,11 +112,11 @@ SpdyBuffer::~SpdyBuffer() {
 }
 
 const char* SpdyBuffer::GetRemainingData() const {
-  return shared_frame_->data->data() + offset_;
+  return shared_frame_->frame().data() + offset_;
 }
 
 size_t SpdyBuffer::GetRemainingSize() const {
-  return shared_frame_->data->size() - offset_;
+  return shared_frame_->frame().size() - offset_;
 }
 
 void SpdyBuffer::AddConsumeCallback(const ConsumeCallback& consume_callback) {
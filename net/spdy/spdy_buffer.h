@@ -17,6 +17,7 @@
 namespace net {
 
 class IOBuffer;
+class SpdyBufferPool;
 class SpdySerializedFrame;
 
 // SpdyBuffer is a class to hold data read from or to be written to a
@@ -84,12 +85,20 @@ class NET_EXPORT_PRIVATE SpdyBuffer {
   IOBuffer* GetIOBufferForRemainingData();
 
  private:
+  friend class SpdyBufferPool;
+
+  // Construct with the |size| bytes at |block|, which was handed out by
+  // |pool|. The block is handed back to |pool| once this buffer and every
+  // IOBuffer returned by GetIOBufferForRemainingData() are gone.
+  SpdyBuffer(const scoped_refptr<SpdyBufferPool>& pool,
+             char* block,
+             size_t size);
+
   void ConsumeHelper(size_t consume_size, ConsumeSource consume_source);
 
-  // Ref-count the passed-in SpdySerializedFrame to support the semantics of
+  // Ref-counts the SpdySerializedFrame to support the semantics of
   // |GetIOBufferForRemainingData()|.
-  typedef base::RefCountedData<std::unique_ptr<SpdySerializedFrame>>
-      SharedFrame;
+  class SharedFrame;
 
   class SharedFrameIOBuffer;
 
@@ -0,0 +1,96 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/spdy/spdy_buffer_pool.h"
+
+#include "base/logging.h"
+#include "base/memory/ptr_util.h"
+#include "net/spdy/spdy_buffer.h"
+
+namespace net {
+
+namespace {
+
+// Returns the size class of a block able to hold |size| bytes. Only valid
+// for sizes no larger than SpdyBufferPool::kMaxBlockSize.
+size_t GetSizeClass(size_t size) {
+  size_t size_class = 0;
+  size_t block_size = SpdyBufferPool::kMinBlockSize;
+  while (block_size < size) {
+    block_size <<= 1;
+    ++size_class;
+  }
+  return size_class;
+}
+
+size_t GetBlockSize(size_t size_class) {
+  return SpdyBufferPool::kMinBlockSize << size_class;
+}
+
+}  // namespace
+
+const size_t SpdyBufferPool::kMinBlockSize;
+const size_t SpdyBufferPool::kMaxBlockSize;
+
+SpdyBufferPool::SpdyBufferPool(size_t max_pooled_bytes)
+    : max_pooled_bytes_(max_pooled_bytes),
+      pooled_bytes_(0),
+      heap_allocation_count_(0),
+      reuse_count_(0),
+      free_blocks_(GetSizeClass(kMaxBlockSize) + 1) {}
+
+SpdyBufferPool::~SpdyBufferPool() {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  for (std::vector<char*>& blocks : free_blocks_) {
+    for (char* block : blocks)
+      delete[] block;
+  }
+}
+
+std::unique_ptr<SpdyBuffer> SpdyBufferPool::CreateBuffer(size_t size,
+                                                         char** data) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  DCHECK_GT(size, 0u);
+
+  char* block = nullptr;
+  if (size > kMaxBlockSize) {
+    block = new char[size];
+    ++heap_allocation_count_;
+  } else {
+    size_t size_class = GetSizeClass(size);
+    std::vector<char*>& blocks = free_blocks_[size_class];
+    if (blocks.empty()) {
+      block = new char[GetBlockSize(size_class)];
+      ++heap_allocation_count_;
+    } else {
+      block = blocks.back();
+      blocks.pop_back();
+      pooled_bytes_ -= GetBlockSize(size_class);
+      ++reuse_count_;
+    }
+  }
+
+  *data = block;
+  return base::WrapUnique(new SpdyBuffer(this, block, size));
+}
+
+void SpdyBufferPool::ReturnBlock(char* block, size_t size) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  if (size > kMaxBlockSize) {
+    delete[] block;
+    return;
+  }
+
+  size_t size_class = GetSizeClass(size);
+  size_t block_size = GetBlockSize(size_class);
+  if (pooled_bytes_ + block_size > max_pooled_bytes_) {
+    delete[] block;
+    return;
+  }
+
+  free_blocks_[size_class].push_back(block);
+  pooled_bytes_ += block_size;
+}
+
+}  // namespace net
@@ -0,0 +1,75 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_SPDY_SPDY_BUFFER_POOL_H_
+#define NET_SPDY_SPDY_BUFFER_POOL_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/threading/thread_checker.h"
+#include "net/base/net_export.h"
+
+namespace net {
+
+class SpdyBuffer;
+
+// SpdyBufferPool recycles the storage of the SpdyBuffers that carry DATA
+// frames, so that a session moving a large body does not hit the heap for
+// every frame. Storage is handed out in power-of-two size classes between
+// kMinBlockSize and kMaxBlockSize bytes; larger requests are served from the
+// heap directly. A block goes back to the pool once the SpdyBuffer built on
+// it and every IOBuffer obtained from it have been destroyed, and is kept
+// for reuse as long as the pool holds no more than |max_pooled_bytes|.
+//
+// A pool must only be used on a single thread.
+class NET_EXPORT_PRIVATE SpdyBufferPool
+    : public base::RefCounted<SpdyBufferPool> {
+ public:
+  static const size_t kMinBlockSize = 1024;
+  static const size_t kMaxBlockSize = 64 * 1024;
+
+  explicit SpdyBufferPool(size_t max_pooled_bytes);
+
+  // Returns a SpdyBuffer of |size| bytes, which must be positive, and sets
+  // |*data| to its storage. The contents are uninitialized and must be
+  // written through |*data| before the buffer is consumed or written.
+  std::unique_ptr<SpdyBuffer> CreateBuffer(size_t size, char** data);
+
+  // Returns the number of bytes held for reuse.
+  size_t pooled_bytes() const { return pooled_bytes_; }
+
+  // Returns the number of blocks that had to be allocated from the heap,
+  // and the number of requests that were served from the pool instead.
+  size_t heap_allocation_count() const { return heap_allocation_count_; }
+  size_t reuse_count() const { return reuse_count_; }
+
+ private:
+  friend class base::RefCounted<SpdyBufferPool>;
+  friend class SpdyBuffer;
+
+  ~SpdyBufferPool();
+
+  // Hands back |block|, which was allocated for a buffer of |size| bytes.
+  void ReturnBlock(char* block, size_t size);
+
+  const size_t max_pooled_bytes_;
+  size_t pooled_bytes_;
+  size_t heap_allocation_count_;
+  size_t reuse_count_;
+
+  // Free blocks, indexed by size class.
+  std::vector<std::vector<char*>> free_blocks_;
+
+  base::ThreadChecker thread_checker_;
+
+  DISALLOW_COPY_AND_ASSIGN(SpdyBufferPool);
+};
+
+}  // namespace net
+
+#endif  // NET_SPDY_SPDY_BUFFER_POOL_H_
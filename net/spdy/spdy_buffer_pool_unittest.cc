@@ -0,0 +1,127 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/spdy/spdy_buffer_pool.h"
+
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "base/memory/ref_counted.h"
+#include "net/base/io_buffer.h"
+#include "net/spdy/spdy_buffer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const char kData[] = "hello!\0hi.";
+const size_t kDataSize = arraysize(kData);
+
+std::unique_ptr<SpdyBuffer> CreateBufferWithData(SpdyBufferPool* pool,
+                                                 const char* data,
+                                                 size_t size) {
+  char* buffer_data = nullptr;
+  std::unique_ptr<SpdyBuffer> buffer = pool->CreateBuffer(size, &buffer_data);
+  memcpy(buffer_data, data, size);
+  return buffer;
+}
+
+class SpdyBufferPoolTest : public ::testing::Test {
+ protected:
+  SpdyBufferPoolTest() : pool_(new SpdyBufferPool(64 * 1024)) {}
+
+  scoped_refptr<SpdyBufferPool> pool_;
+};
+
+// A buffer created from the pool holds the data written to it.
+TEST_F(SpdyBufferPoolTest, CreateBuffer) {
+  std::unique_ptr<SpdyBuffer> buffer =
+      CreateBufferWithData(pool_.get(), kData, kDataSize);
+  EXPECT_EQ(kDataSize, buffer->GetRemainingSize());
+  EXPECT_EQ(std::string(kData, kDataSize),
+            std::string(buffer->GetRemainingData(), kDataSize));
+  EXPECT_EQ(1u, pool_->heap_allocation_count());
+  EXPECT_EQ(0u, pool_->pooled_bytes());
+}
+
+// Storage of a destroyed buffer is reused for the next buffer of the same
+// size class.
+TEST_F(SpdyBufferPoolTest, ReuseAfterDestroy) {
+  char* first_data = nullptr;
+  pool_->CreateBuffer(100, &first_data);
+  EXPECT_EQ(SpdyBufferPool::kMinBlockSize, pool_->pooled_bytes());
+
+  char* second_data = nullptr;
+  std::unique_ptr<SpdyBuffer> buffer =
+      pool_->CreateBuffer(SpdyBufferPool::kMinBlockSize, &second_data);
+  EXPECT_EQ(first_data, second_data);
+  EXPECT_EQ(1u, pool_->heap_allocation_count());
+  EXPECT_EQ(1u, pool_->reuse_count());
+  EXPECT_EQ(0u, pool_->pooled_bytes());
+
+  // A request from another size class allocates.
+  char* third_data = nullptr;
+  pool_->CreateBuffer(SpdyBufferPool::kMinBlockSize + 1, &third_data);
+  EXPECT_EQ(2u, pool_->heap_allocation_count());
+  EXPECT_EQ(2 * SpdyBufferPool::kMinBlockSize, pool_->pooled_bytes());
+}
+
+// Consuming a buffer does not release its storage; destroying it does.
+TEST_F(SpdyBufferPoolTest, ConsumeDoesNotRelease) {
+  std::unique_ptr<SpdyBuffer> buffer =
+      CreateBufferWithData(pool_.get(), kData, kDataSize);
+  buffer->Consume(kDataSize);
+  EXPECT_EQ(0u, pool_->pooled_bytes());
+  buffer.reset();
+  EXPECT_EQ(SpdyBufferPool::kMinBlockSize, pool_->pooled_bytes());
+}
+
+// An IOBuffer obtained from a pooled buffer keeps the storage out of the
+// pool until it is released.
+TEST_F(SpdyBufferPoolTest, IOBufferOutlivesBuffer) {
+  std::unique_ptr<SpdyBuffer> buffer =
+      CreateBufferWithData(pool_.get(), kData, kDataSize);
+  scoped_refptr<IOBuffer> io_buffer = buffer->GetIOBufferForRemainingData();
+  buffer.reset();
+  EXPECT_EQ(0u, pool_->pooled_bytes());
+  EXPECT_EQ(std::string(kData, kDataSize),
+            std::string(io_buffer->data(), kDataSize));
+
+  io_buffer = nullptr;
+  EXPECT_EQ(SpdyBufferPool::kMinBlockSize, pool_->pooled_bytes());
+}
+
+// Blocks are not kept once the pool holds its maximum, and requests larger
+// than kMaxBlockSize are never pooled.
+TEST_F(SpdyBufferPoolTest, Limits) {
+  char* data = nullptr;
+  std::unique_ptr<SpdyBuffer> large =
+      pool_->CreateBuffer(SpdyBufferPool::kMaxBlockSize + 1, &data);
+  std::unique_ptr<SpdyBuffer> max1 =
+      pool_->CreateBuffer(SpdyBufferPool::kMaxBlockSize, &data);
+  std::unique_ptr<SpdyBuffer> max2 =
+      pool_->CreateBuffer(SpdyBufferPool::kMaxBlockSize, &data);
+
+  large.reset();
+  EXPECT_EQ(0u, pool_->pooled_bytes());
+  max1.reset();
+  EXPECT_EQ(SpdyBufferPool::kMaxBlockSize, pool_->pooled_bytes());
+  max2.reset();
+  EXPECT_EQ(SpdyBufferPool::kMaxBlockSize, pool_->pooled_bytes());
+}
+
+// Outstanding buffers keep the pool alive.
+TEST_F(SpdyBufferPoolTest, BufferOutlivesPoolReference) {
+  std::unique_ptr<SpdyBuffer> buffer =
+      CreateBufferWithData(pool_.get(), kData, kDataSize);
+  pool_ = nullptr;
+  EXPECT_EQ(std::string(kData, kDataSize),
+            std::string(buffer->GetRemainingData(), kDataSize));
+}
+
+}  // namespace
+
+}  // namespace net
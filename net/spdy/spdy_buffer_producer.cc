@@ -16,6 +16,10 @@ SpdyBufferProducer::SpdyBufferProducer() {}
 
 SpdyBufferProducer::~SpdyBufferProducer() {}
 
+size_t SpdyBufferProducer::EstimateBufferSize() const {
+  return 0;
+}
+
 SimpleBufferProducer::SimpleBufferProducer(std::unique_ptr<SpdyBuffer> buffer)
     : buffer_(std::move(buffer)) {}
 
@@ -26,4 +30,8 @@ std::unique_ptr<SpdyBuffer> SimpleBufferProducer::ProduceBuffer() {
   return std::move(buffer_);
 }
 
+size_t SimpleBufferProducer::EstimateBufferSize() const {
+  return buffer_ ? buffer_->GetRemainingSize() : 0;
+}
+
 }  // namespace net
@@ -5,6 +5,8 @@
 #ifndef NET_SPDY_SPDY_BUFFER_PRODUCER_H_
 #define NET_SPDY_SPDY_BUFFER_PRODUCER_H_
 
+#include <stddef.h>
+
 #include <memory>
 
 #include "base/compiler_specific.h"
@@ -25,6 +27,10 @@ class NET_EXPORT_PRIVATE SpdyBufferProducer {
   // Produces the buffer to be written. Will be called at most once.
   virtual std::unique_ptr<SpdyBuffer> ProduceBuffer() = 0;
 
+  // Returns the number of bytes the produced buffer is expected to hold, or 0
+  // if that is not known until ProduceBuffer() is called.
+  virtual size_t EstimateBufferSize() const;
+
   virtual ~SpdyBufferProducer();
 
  private:
@@ -39,6 +45,7 @@ class NET_EXPORT_PRIVATE SimpleBufferProducer : public SpdyBufferProducer {
   ~SimpleBufferProducer() override;
 
   std::unique_ptr<SpdyBuffer> ProduceBuffer() override;
+  size_t EstimateBufferSize() const override;
 
  private:
   std::unique_ptr<SpdyBuffer> buffer_;
@@ -7,6 +7,10 @@
 // Use NestedSpdyFramerDecoder.
 bool FLAGS_use_nested_spdy_framer_decoder = false;
 
+// Decode complete DATA, WINDOW_UPDATE and PING frames directly from the input
+// buffer, falling back to SpdyFramer for everything else.
+bool FLAGS_use_in_place_spdy_framer_decoder = false;
+
 // Enforce the limit we advertise on frame payload size with
 // GOAWAY_FRAME_SIZE_ERROR.
 bool FLAGS_chromium_http2_flag_enforce_max_frame_size = true;
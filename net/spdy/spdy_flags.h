@@ -8,6 +8,7 @@
 #include "net/base/net_export.h"
 
 NET_EXPORT_PRIVATE extern bool FLAGS_use_nested_spdy_framer_decoder;
+NET_EXPORT_PRIVATE extern bool FLAGS_use_in_place_spdy_framer_decoder;
 NET_EXPORT_PRIVATE extern bool FLAGS_chromium_http2_flag_enforce_max_frame_size;
 NET_EXPORT_PRIVATE extern bool
     FLAGS_chromium_http2_flag_use_new_spdy_header_block_header_joining;
@@ -20,6 +20,7 @@
 #include "base/metrics/histogram_macros.h"
 #include "net/quic/core/quic_flags.h"
 #include "net/spdy/hpack/hpack_constants.h"
+#include "net/spdy/in_place_spdy_framer_decoder.h"
 #include "net/spdy/spdy_bitmasks.h"
 #include "net/spdy/spdy_bug_tracker.h"
 #include "net/spdy/spdy_flags.h"
@@ -98,6 +99,10 @@ std::unique_ptr<SpdyFramerDecoderAdapter> DecoderAdapterFactory(
     DVLOG(1) << "Creating NestedSpdyFramerDecoder.";
     return CreateNestedSpdyFramerDecoder(outer);
   }
+  if (FLAGS_use_in_place_spdy_framer_decoder) {
+    DVLOG(1) << "Creating InPlaceSpdyFramerDecoder.";
+    return CreateInPlaceSpdyFramerDecoder(outer);
+  }
   return nullptr;
 }
 
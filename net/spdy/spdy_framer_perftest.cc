@@ -0,0 +1,132 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/spdy/spdy_framer.h"
+
+#include <algorithm>
+#include <string>
+
+#include "base/test/perf_log.h"
+#include "base/time/time.h"
+#include "net/spdy/in_place_spdy_framer_decoder.h"
+#include "net/spdy/spdy_no_op_visitor.h"
+#include "net/spdy/spdy_protocol.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/platform_test.h"
+
+namespace net {
+
+namespace {
+
+const int kNumStreams = 100;
+const int kDataFramesPerStream = 16;
+const size_t kDataFramePayloadSize = 4 * 1024;
+const int kIterations = 200;
+
+// Size of the chunks the input is fed in when simulating socket reads, which
+// usually end in the middle of a frame.
+const size_t kReadSize = 16 * 1024 + 1;
+
+// Serializes a connection's worth of response traffic: for each stream a
+// HEADERS frame, a run of DATA frames interleaved with stream and connection
+// level WINDOW_UPDATE frames, and a PING. Returns the number of frames.
+int BuildMixedFrames(std::string* out) {
+  SpdyFramer framer(HTTP2);
+  // Header blocks must decode identically on every iteration, so keep them out
+  // of the HPACK dynamic table.
+  framer.set_enable_compression(false);
+  const std::string payload(kDataFramePayloadSize, 'a');
+  int frame_count = 0;
+  for (int i = 0; i < kNumStreams; ++i) {
+    SpdyStreamId stream_id = 2 * i + 1;
+
+    SpdyHeadersIR headers(stream_id);
+    headers.SetHeader(":status", "200");
+    headers.SetHeader("content-type", "text/html");
+    headers.SetHeader("cache-control", "max-age=3600");
+    SpdySerializedFrame headers_frame(framer.SerializeHeaders(headers));
+    out->append(headers_frame.data(), headers_frame.size());
+    ++frame_count;
+
+    for (int j = 0; j < kDataFramesPerStream; ++j) {
+      SpdyDataIR data(stream_id, payload);
+      data.set_fin(j == kDataFramesPerStream - 1);
+      SpdySerializedFrame data_frame(framer.SerializeData(data));
+      out->append(data_frame.data(), data_frame.size());
+      ++frame_count;
+
+      if (j % 4 == 3) {
+        SpdySerializedFrame window_update(framer.SerializeWindowUpdate(
+            SpdyWindowUpdateIR(j % 8 == 7 ? 0 : stream_id, 4 * 1024)));
+        out->append(window_update.data(), window_update.size());
+        ++frame_count;
+      }
+    }
+
+    SpdySerializedFrame ping(framer.SerializePing(SpdyPingIR(i)));
+    out->append(ping.data(), ping.size());
+    ++frame_count;
+  }
+  return frame_count;
+}
+
+}  // namespace
+
+class SpdyFramerPerfTest : public PlatformTest {
+ protected:
+  SpdyFramerPerfTest() : frame_count_(BuildMixedFrames(&input_)) {}
+
+  // Decodes |input_| kIterations times, |read_size| bytes at a time, and logs
+  // the decoding rate.
+  void Decode(const char* name,
+              SpdyFramer::DecoderAdapterFactoryFn adapter_factory,
+              size_t read_size) {
+    test::SpdyNoOpVisitor visitor;
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < kIterations; ++i) {
+      SpdyFramer framer(HTTP2, adapter_factory);
+      framer.set_visitor(&visitor);
+      for (size_t offset = 0; offset < input_.size(); offset += read_size) {
+        size_t len = std::min(read_size, input_.size() - offset);
+        ASSERT_EQ(len, framer.ProcessInput(input_.data() + offset, len));
+      }
+      ASSERT_FALSE(framer.HasError());
+    }
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    base::LogPerfResult(
+        name,
+        static_cast<double>(frame_count_) * kIterations / elapsed.InSecondsF(),
+        "frames/s");
+  }
+
+  std::string input_;
+  const int frame_count_;
+};
+
+TEST_F(SpdyFramerPerfTest, MixedFramesSerialize) {
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    std::string out;
+    ASSERT_EQ(frame_count_, BuildMixedFrames(&out));
+  }
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  base::LogPerfResult(
+      "Spdy_framer_mixed_frames_serialize",
+      static_cast<double>(frame_count_) * kIterations / elapsed.InSecondsF(),
+      "frames/s");
+}
+
+TEST_F(SpdyFramerPerfTest, MixedFramesSpdyFramer) {
+  Decode("Spdy_framer_mixed_frames_whole", nullptr, input_.size());
+  Decode("Spdy_framer_mixed_frames_reads", nullptr, kReadSize);
+}
+
+TEST_F(SpdyFramerPerfTest, MixedFramesInPlaceDecoder) {
+  Decode("Spdy_framer_in_place_mixed_frames_whole",
+         &CreateInPlaceSpdyFramerDecoder, input_.size());
+  Decode("Spdy_framer_in_place_mixed_frames_reads",
+         &CreateInPlaceSpdyFramerDecoder, kReadSize);
+}
+
+}  // namespace net
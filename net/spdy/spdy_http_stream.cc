@@ -17,6 +17,7 @@
 #include "base/threading/thread_task_runner_handle.h"
 #include "base/values.h"
 #include "net/base/host_port_pair.h"
+#include "net/base/load_flags.h"
 #include "net/base/upload_data_stream.h"
 #include "net/http/http_request_headers.h"
 #include "net/http/http_request_info.h"
@@ -86,6 +87,9 @@ int SpdyHttpStream::InitializeStream(const HttpRequestInfo* request_info,
     }
   }
 
+  if (request_info_->load_flags & LOAD_ONLY_FROM_PUSH)
+    return ERR_FAILED;
+
   int rv = stream_request_.StartRequest(
       SPDY_REQUEST_RESPONSE_STREAM, spdy_session_, request_info_->url,
       priority, stream_net_log,
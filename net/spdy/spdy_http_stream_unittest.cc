@@ -14,6 +14,7 @@
 #include "crypto/ec_signature_creator.h"
 #include "crypto/signature_creator.h"
 #include "net/base/chunked_upload_data_stream.h"
+#include "net/base/load_flags.h"
 #include "net/base/load_timing_info.h"
 #include "net/base/load_timing_info_test_util.h"
 #include "net/base/test_completion_callback.h"
@@ -186,6 +187,29 @@ TEST_F(SpdyHttpStreamTest, GetUploadProgressBeforeInitialization) {
   base::RunLoop().RunUntilIdle();
 }
 
+// A request that may only be served by a push fails without sending anything
+// when there is none.
+TEST_F(SpdyHttpStreamTest, OnlyFromPushWithoutPush) {
+  MockRead reads[] = {
+      MockRead(ASYNC, 0, 0)  // EOF
+  };
+
+  InitSession(reads, arraysize(reads), nullptr, 0);
+
+  HttpRequestInfo request;
+  request.method = "GET";
+  request.url = GURL("http://www.example.org/");
+  request.load_flags = LOAD_ONLY_FROM_PUSH;
+  SpdyHttpStream http_stream(session_, true);
+  EXPECT_EQ(ERR_FAILED,
+            http_stream.InitializeStream(&request, DEFAULT_PRIORITY,
+                                         BoundNetLog(), CompletionCallback()));
+  EXPECT_EQ(0, http_stream.GetTotalSentBytes());
+
+  // Pump the event loop so |reads| is consumed before the function returns.
+  base::RunLoop().RunUntilIdle();
+}
+
 TEST_F(SpdyHttpStreamTest, SendRequest) {
   SpdySerializedFrame req(
       spdy_util_.ConstructSpdyGet(nullptr, 0, 1, LOWEST, true));
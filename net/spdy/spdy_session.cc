@@ -4,6 +4,8 @@
 
 #include "net/spdy/spdy_session.h"
 
+#include <string.h>
+
 #include <algorithm>
 #include <limits>
 #include <map>
@@ -13,6 +15,7 @@
 #include "base/compiler_specific.h"
 #include "base/location.h"
 #include "base/logging.h"
+#include "base/memory/ptr_util.h"
 #include "base/metrics/histogram_macros.h"
 #include "base/metrics/sparse_histogram.h"
 #include "base/profiler/scoped_tracker.h"
@@ -54,7 +57,6 @@ namespace net {
 
 namespace {
 
-const int kReadBufferSize = 8 * 1024;
 const int kDefaultConnectionAtRiskOfLossSeconds = 10;
 const int kHungIntervalSeconds = 10;
 
@@ -290,6 +292,28 @@ class RequestEquals {
 // the server permits more, we will never exceed this limit.
 const size_t kMaxConcurrentStreamLimit = 256;
 
+// Handle to an unclaimed pushed stream, held by the ServerPushStore. The
+// store may cancel pushes while the session is handling a frame, so the
+// stream is reset from a posted task.
+class SpdyServerPush : public ServerPushStore::Push {
+ public:
+  SpdyServerPush(const base::WeakPtr<SpdySession>& session,
+                 SpdyStreamId stream_id)
+      : session_(session), stream_id_(stream_id) {}
+  ~SpdyServerPush() override {}
+
+  void Cancel() override {
+    base::ThreadTaskRunnerHandle::Get()->PostTask(
+        FROM_HERE, base::Bind(&SpdySession::CancelPush, session_, stream_id_));
+  }
+
+ private:
+  const base::WeakPtr<SpdySession> session_;
+  const SpdyStreamId stream_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(SpdyServerPush);
+};
+
 }  // namespace
 
 SpdyProtocolErrorDetails MapFramerErrorToProtocolError(
@@ -535,7 +559,7 @@ SpdySession::UnclaimedPushedStreamContainer::~UnclaimedPushedStreamContainer() {
 size_t SpdySession::UnclaimedPushedStreamContainer::erase(const GURL& url) {
   const_iterator it = find(url);
   if (it != end()) {
-    streams_.erase(it);
+    erase(it);
     return 1;
   }
   return 0;
@@ -543,14 +567,11 @@ size_t SpdySession::UnclaimedPushedStreamContainer::erase(const GURL& url) {
 
 SpdySession::UnclaimedPushedStreamContainer::iterator
 SpdySession::UnclaimedPushedStreamContainer::erase(const_iterator it) {
-  DCHECK(spdy_session_->pool_);
   DCHECK(it != end());
-  // Only allow cross-origin push for secure resources.
-  if (it->first.SchemeIsCryptographic()) {
-    spdy_session_->pool_->UnregisterUnclaimedPushedStream(it->first,
-                                                          spdy_session_);
-  }
-  return streams_.erase(it);
+  ServerPushStore* store = server_push_store();
+  if (store)
+    store->OnPushDiscarded(it->second.push_id);
+  return Unregister(it);
 }
 
 SpdySession::UnclaimedPushedStreamContainer::iterator
@@ -565,11 +586,57 @@ SpdySession::UnclaimedPushedStreamContainer::insert(
     spdy_session_->pool_->RegisterUnclaimedPushedStream(
         url, spdy_session_->GetWeakPtr());
   }
+  ServerPushStore::PushId push_id = 0;
+  ServerPushStore* store = server_push_store();
+  if (store) {
+    push_id = store->OnPushAccepted(
+        url, spdy_session_->spdy_session_key_.privacy_mode(),
+        base::WrapUnique(
+            new SpdyServerPush(spdy_session_->GetWeakPtr(), stream_id)));
+  }
   return streams_.insert(
       position,
       std::make_pair(
           url, SpdySession::UnclaimedPushedStreamContainer::PushedStreamInfo(
-                   stream_id, creation_time)));
+                   stream_id, creation_time, push_id)));
+}
+
+SpdySession::UnclaimedPushedStreamContainer::iterator
+SpdySession::UnclaimedPushedStreamContainer::claim(const_iterator it) {
+  DCHECK(it != end());
+  ServerPushStore* store = server_push_store();
+  if (store)
+    store->OnPushClaimed(it->second.push_id);
+  return Unregister(it);
+}
+
+void SpdySession::UnclaimedPushedStreamContainer::OnDataReceived(
+    const GURL& url,
+    SpdyStreamId stream_id,
+    size_t len) {
+  ServerPushStore* store = server_push_store();
+  if (!store)
+    return;
+  const_iterator it = find(url);
+  if (it != end() && it->second.stream_id == stream_id)
+    store->OnPushDataReceived(it->second.push_id, len);
+}
+
+ServerPushStore*
+SpdySession::UnclaimedPushedStreamContainer::server_push_store() const {
+  return spdy_session_->pool_ ? spdy_session_->pool_->server_push_store()
+                              : nullptr;
+}
+
+SpdySession::UnclaimedPushedStreamContainer::iterator
+SpdySession::UnclaimedPushedStreamContainer::Unregister(const_iterator it) {
+  DCHECK(spdy_session_->pool_);
+  // Only allow cross-origin push for secure resources.
+  if (it->first.SchemeIsCryptographic()) {
+    spdy_session_->pool_->UnregisterUnclaimedPushedStream(it->first,
+                                                          spdy_session_);
+  }
+  return streams_.erase(it);
 }
 
 // static
@@ -635,7 +702,10 @@ SpdySession::SpdySession(const SpdySessionKey& spdy_session_key,
       pool_(NULL),
       http_server_properties_(http_server_properties),
       transport_security_state_(transport_security_state),
-      read_buffer_(new IOBuffer(kReadBufferSize)),
+      buffer_pool_(new SpdyBufferPool(kMaxPooledDataBufferBytes)),
+      read_buffer_len_(0),
+      read_buffer_size_(kMinReadBufferSize),
+      small_reads_count_(0),
       stream_hi_water_mark_(kFirstStreamId),
       last_accepted_push_stream_id_(0),
       unclaimed_pushed_streams_(this),
@@ -1129,12 +1199,14 @@ std::unique_ptr<SpdyBuffer> SpdySession::CreateDataBuffer(
 
   // TODO(mbelshe): reduce memory copies here.
   DCHECK(buffered_spdy_framer_.get());
-  std::unique_ptr<SpdySerializedFrame> frame(
-      buffered_spdy_framer_->CreateDataFrame(
-          stream_id, data->data(), static_cast<uint32_t>(effective_len),
-          flags));
-
-  std::unique_ptr<SpdyBuffer> data_buffer(new SpdyBuffer(std::move(frame)));
+  size_t header_size = buffered_spdy_framer_->GetDataFrameMinimumSize();
+  char* frame_data = nullptr;
+  std::unique_ptr<SpdyBuffer> data_buffer(buffer_pool_->CreateBuffer(
+      header_size + effective_len, &frame_data));
+  buffered_spdy_framer_->SerializeDataFrameHeader(
+      stream_id, static_cast<uint32_t>(effective_len), flags, frame_data);
+  if (effective_len > 0)
+    memcpy(frame_data + header_size, data->data(), effective_len);
 
   // Send window size is based on payload size, so nothing to do if this is
   // just a FIN with no payload.
@@ -1188,6 +1260,22 @@ void SpdySession::ResetStream(SpdyStreamId stream_id,
   ResetStreamIterator(it, status, description);
 }
 
+void SpdySession::CancelPush(SpdyStreamId stream_id) {
+  ActiveStreamMap::iterator it = active_streams_.find(stream_id);
+  if (it == active_streams_.end())
+    return;
+  UnclaimedPushedStreamContainer::const_iterator unclaimed_it =
+      unclaimed_pushed_streams_.find(it->second.stream->url());
+  if (unclaimed_it == unclaimed_pushed_streams_.end() ||
+      unclaimed_it->second.stream_id != stream_id) {
+    return;
+  }
+  LogAbandonedActiveStream(it, ERR_ABORTED);
+  // CloseActiveStreamIterator() will remove the stream from
+  // |unclaimed_pushed_streams_|.
+  ResetStreamIterator(it, RST_STREAM_CANCEL, "Push cancelled by the store.");
+}
+
 bool SpdySession::IsStreamActive(SpdyStreamId stream_id) const {
   return ContainsKey(active_streams_, stream_id);
 }
@@ -1319,7 +1407,7 @@ int SpdySession::DoReadLoop(ReadState expected_read_state, int result) {
       break;
 
     if (read_state_ == READ_STATE_DO_READ &&
-        (bytes_read_without_yielding > kYieldAfterBytesRead ||
+        (bytes_read_without_yielding > GetYieldAfterBytesRead() ||
          time_func_() > yield_after_time)) {
       base::ThreadTaskRunnerHandle::Get()->PostTask(
           FROM_HERE,
@@ -1341,10 +1429,23 @@ int SpdySession::DoRead() {
 
   CHECK(connection_);
   CHECK(connection_->socket());
+
+  // Do not pin a large buffer while waiting for data on an idle session.
+  int buffer_len = read_buffer_size_;
+  if (!is_active()) {
+    buffer_len = kIdleReadBufferSize;
+    read_buffer_size_ = kMinReadBufferSize;
+    small_reads_count_ = 0;
+  }
+  if (!read_buffer_ || read_buffer_len_ != buffer_len) {
+    read_buffer_ = new IOBuffer(buffer_len);
+    read_buffer_len_ = buffer_len;
+  }
+
   read_state_ = READ_STATE_DO_READ_COMPLETE;
   return connection_->socket()->Read(
       read_buffer_.get(),
-      kReadBufferSize,
+      read_buffer_len_,
       base::Bind(&SpdySession::PumpReadLoop,
                  weak_factory_.GetWeakPtr(), READ_STATE_DO_READ_COMPLETE));
 }
@@ -1352,10 +1453,6 @@ int SpdySession::DoRead() {
 int SpdySession::DoReadComplete(int result) {
   CHECK(in_io_loop_);
 
-  // Parse a frame.  For now this code requires that the frame fit into our
-  // buffer (kReadBufferSize).
-  // TODO(mbelshe): support arbitrarily large frames!
-
   if (result == 0) {
     UMA_HISTOGRAM_CUSTOM_COUNTS("Net.SpdySession.BytesRead.EOF",
                                 total_bytes_received_, 1, 100000000, 50);
@@ -1370,8 +1467,9 @@ int SpdySession::DoReadComplete(int result) {
         base::StringPrintf("Error %d reading from socket.", -result));
     return result;
   }
-  CHECK_LE(result, kReadBufferSize);
+  CHECK_LE(result, read_buffer_len_);
   total_bytes_received_ += result;
+  UpdateReadBufferSize(result);
 
   last_activity_time_ = time_func_();
 
@@ -1394,6 +1492,33 @@ int SpdySession::DoReadComplete(int result) {
   return OK;
 }
 
+void SpdySession::UpdateReadBufferSize(int bytes_read) {
+  // Reads into the idle buffer say nothing about the throughput of the
+  // session.
+  if (read_buffer_len_ != read_buffer_size_)
+    return;
+
+  if (bytes_read == read_buffer_len_) {
+    small_reads_count_ = 0;
+    read_buffer_size_ = std::min(2 * read_buffer_size_, kMaxReadBufferSize);
+    return;
+  }
+
+  if (bytes_read >= read_buffer_len_ / 4) {
+    small_reads_count_ = 0;
+    return;
+  }
+
+  if (++small_reads_count_ < kReadBufferShrinkAfterReads)
+    return;
+  small_reads_count_ = 0;
+  read_buffer_size_ = std::max(read_buffer_size_ / 2, kMinReadBufferSize);
+}
+
+int SpdySession::GetYieldAfterBytesRead() const {
+  return std::max(kYieldAfterBytesRead, 2 * read_buffer_size_);
+}
+
 void SpdySession::PumpWriteLoop(WriteState expected_write_state, int result) {
   CHECK(!in_io_loop_);
   DCHECK_EQ(write_state_, expected_write_state);
@@ -1909,7 +2034,7 @@ base::WeakPtr<SpdyStream> SpdySession::GetActivePushStream(const GURL& url) {
     return base::WeakPtr<SpdyStream>();
 
   SpdyStreamId stream_id = unclaimed_it->second.stream_id;
-  unclaimed_pushed_streams_.erase(unclaimed_it);
+  unclaimed_pushed_streams_.claim(unclaimed_it);
 
   ActiveStreamMap::iterator active_it = active_streams_.find(stream_id);
   if (active_it == active_streams_.end()) {
@@ -2012,8 +2137,10 @@ void SpdySession::OnStreamFrameData(SpdyStreamId stream_id,
   std::unique_ptr<SpdyBuffer> buffer;
   if (data) {
     DCHECK_GT(len, 0u);
-    CHECK_LE(len, static_cast<size_t>(kReadBufferSize));
-    buffer.reset(new SpdyBuffer(data, len));
+    CHECK_LE(len, static_cast<size_t>(kMaxReadBufferSize));
+    char* buffer_data = nullptr;
+    buffer = buffer_pool_->CreateBuffer(len, &buffer_data);
+    memcpy(buffer_data, data, len);
 
     DecreaseRecvWindowSize(static_cast<int32_t>(len));
     buffer->AddConsumeCallback(base::Bind(&SpdySession::OnReadBufferConsumed,
@@ -2040,6 +2167,9 @@ void SpdySession::OnStreamFrameData(SpdyStreamId stream_id,
     return;
   }
 
+  if (stream->type() == SPDY_PUSH_STREAM && len > 0)
+    unclaimed_pushed_streams_.OnDataReceived(stream->url(), stream_id, len);
+
   stream->OnDataReceived(std::move(buffer));
 }
 
@@ -31,10 +31,12 @@
 #include "net/socket/next_proto.h"
 #include "net/socket/ssl_client_socket.h"
 #include "net/socket/stream_socket.h"
+#include "net/spdy/server_push_store.h"
 #include "net/spdy/buffered_spdy_framer.h"
 #include "net/spdy/http2_priority_dependencies.h"
 #include "net/spdy/spdy_alt_svc_wire_format.h"
 #include "net/spdy/spdy_buffer.h"
+#include "net/spdy/spdy_buffer_pool.h"
 #include "net/spdy/spdy_framer.h"
 #include "net/spdy/spdy_header_block.h"
 #include "net/spdy/spdy_protocol.h"
@@ -71,10 +73,26 @@ const size_t kInitialMaxConcurrentStreams = 100;
 const int kMaxConcurrentPushedStreams = 1000;
 
 // If more than this many bytes have been read or more than that many
-// milliseconds have passed, return ERR_IO_PENDING from ReadLoop.
+// milliseconds have passed, return ERR_IO_PENDING from ReadLoop.  Once the
+// read buffer has grown, the byte limit is raised to two full reads so that
+// bulk transfers are not forced to yield after every read.
 const int kYieldAfterBytesRead = 32 * 1024;
 const int kYieldAfterDurationMilliseconds = 20;
 
+// Bounds for the size of the buffer used to read from the socket. A session
+// with active or created streams starts reading into a buffer of
+// kMinReadBufferSize bytes.  The buffer doubles, up to kMaxReadBufferSize,
+// every time a read fills it, and halves after kReadBufferShrinkAfterReads
+// consecutive reads that fill less than a quarter of it.  A session without
+// any streams only pins a buffer of kIdleReadBufferSize bytes.
+const int kIdleReadBufferSize = 1024;
+const int kMinReadBufferSize = 8 * 1024;
+const int kMaxReadBufferSize = 64 * 1024;
+const int kReadBufferShrinkAfterReads = 4;
+
+// Upper bound on the storage a session keeps around for reuse by DATA frames.
+const size_t kMaxPooledDataBufferBytes = 256 * 1024;
+
 // First and last valid stream IDs. As we always act as the client,
 // start at 1 for the first stream id.
 const SpdyStreamId kFirstStreamId = 1;
@@ -229,18 +247,25 @@ class NET_EXPORT SpdySession : public BufferedSpdyFramerVisitorInterface,
   typedef base::TimeTicks (*TimeFunc)(void);
 
   // Container class for unclaimed pushed streams on a SpdySession.  Guarantees
-  // that |spdy_session_.pool_| gets notified every time a stream is pushed or
-  // an unclaimed pushed stream is claimed.
+  // that |spdy_session_.pool_| and its ServerPushStore, if any, get notified
+  // every time a stream is pushed or an unclaimed pushed stream is claimed or
+  // goes away.
   class UnclaimedPushedStreamContainer {
    public:
     struct PushedStreamInfo {
-      PushedStreamInfo() : stream_id(0) {}
-      PushedStreamInfo(SpdyStreamId stream_id, base::TimeTicks creation_time)
-          : stream_id(stream_id), creation_time(creation_time) {}
+      PushedStreamInfo() : stream_id(0), push_id(0) {}
+      PushedStreamInfo(SpdyStreamId stream_id,
+                       base::TimeTicks creation_time,
+                       ServerPushStore::PushId push_id)
+          : stream_id(stream_id),
+            creation_time(creation_time),
+            push_id(push_id) {}
       ~PushedStreamInfo() {}
 
       SpdyStreamId stream_id;
       base::TimeTicks creation_time;
+      // Id of the push in the ServerPushStore, or 0 if there is none.
+      ServerPushStore::PushId push_id;
     };
     using PushedStreamMap = std::map<GURL, PushedStreamInfo>;
     using iterator = PushedStreamMap::iterator;
@@ -267,7 +292,17 @@ class NET_EXPORT SpdySession : public BufferedSpdyFramerVisitorInterface,
                     SpdyStreamId stream_id,
                     const base::TimeTicks& creation_time);
 
+    // Like erase(), for a stream that is being claimed by a request.
+    iterator claim(const_iterator it);
+
+    // Accounts for |len| bytes of data received on the pushed stream
+    // |stream_id| for |url|, if it is still unclaimed.
+    void OnDataReceived(const GURL& url, SpdyStreamId stream_id, size_t len);
+
    private:
+    ServerPushStore* server_push_store() const;
+    iterator Unregister(const_iterator it);
+
     SpdySession* spdy_session_;
 
     // (Bijective) map from the URL to the ID of the streams that have
@@ -392,6 +427,10 @@ class NET_EXPORT SpdySession : public BufferedSpdyFramerVisitorInterface,
                    SpdyRstStreamStatus status,
                    const std::string& description);
 
+  // Reset the pushed stream with the given ID, if it is still active and
+  // unclaimed.
+  void CancelPush(SpdyStreamId stream_id);
+
   // Check if a stream is active.
   bool IsStreamActive(SpdyStreamId stream_id) const;
 
@@ -559,6 +598,7 @@ class NET_EXPORT SpdySession : public BufferedSpdyFramerVisitorInterface,
   friend class SpdyHttpStreamTest;
   friend class SpdyNetworkTransactionTest;
   friend class SpdyProxyClientSocketTest;
+  friend class SpdySessionPerfTest;
   friend class SpdySessionTest;
   friend class SpdyStreamRequest;
 
@@ -590,6 +630,8 @@ class NET_EXPORT SpdySession : public BufferedSpdyFramerVisitorInterface,
   FRIEND_TEST_ALL_PREFIXES(SpdySessionTest,
                            CancelReservedStreamOnHeadersReceived);
   FRIEND_TEST_ALL_PREFIXES(SpdySessionTest, RejectInvalidUnknownFrames);
+  FRIEND_TEST_ALL_PREFIXES(SpdySessionTest, IdleSessionUsesSmallReadBuffer);
+  FRIEND_TEST_ALL_PREFIXES(SpdySessionTest, ReadBufferGrowsForBulkData);
   FRIEND_TEST_ALL_PREFIXES(SpdySessionPoolTest, IPAddressChanged);
   FRIEND_TEST_ALL_PREFIXES(SpdyNetworkTransactionTest,
                            ServerPushValidCrossOrigin);
@@ -712,6 +754,13 @@ class NET_EXPORT SpdySession : public BufferedSpdyFramerVisitorInterface,
   int DoRead();
   int DoReadComplete(int result);
 
+  // Adjusts |read_buffer_size_| after a read of |bytes_read| bytes into a
+  // buffer of |read_buffer_len_| bytes.
+  void UpdateReadBufferSize(int bytes_read);
+
+  // Returns the number of bytes DoReadLoop may read before yielding.
+  int GetYieldAfterBytesRead() const;
+
   // Calls DoWriteLoop. If |availability_state_| is STATE_DRAINING and no
   // writes remain, the session is removed from the session pool and
   // destroyed.
@@ -1006,8 +1055,18 @@ class NET_EXPORT SpdySession : public BufferedSpdyFramerVisitorInterface,
   // The socket handle for this session.
   std::unique_ptr<ClientSocketHandle> connection_;
 
-  // The read buffer used to read data from the socket.
+  // Recycles the storage of DATA frames sent and received on this session.
+  scoped_refptr<SpdyBufferPool> buffer_pool_;
+
+  // The read buffer used to read data from the socket, and its length.
+  // Allocated lazily in DoRead() so that it can be resized between reads.
   scoped_refptr<IOBuffer> read_buffer_;
+  int read_buffer_len_;
+
+  // The size of the read buffer to use while the session has streams, and
+  // the number of consecutive reads that used less than a quarter of it.
+  int read_buffer_size_;
+  int small_reads_count_;
 
   SpdyStreamId stream_hi_water_mark_;  // The next stream id to use.
 
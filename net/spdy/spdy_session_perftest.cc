@@ -0,0 +1,284 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/spdy/spdy_session.h"
+
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/memory/ptr_util.h"
+#include "base/run_loop.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/perf_log.h"
+#include "base/test/perf_time_logger.h"
+#include "base/time/time.h"
+#include "net/base/host_port_pair.h"
+#include "net/base/request_priority.h"
+#include "net/log/net_log.h"
+#include "net/proxy/proxy_server.h"
+#include "net/socket/socket_test_util.h"
+#include "net/spdy/spdy_buffer.h"
+#include "net/spdy/spdy_buffer_pool.h"
+#include "net/spdy/spdy_session_pool.h"
+#include "net/spdy/spdy_stream.h"
+#include "net/spdy/spdy_stream_test_util.h"
+#include "net/spdy/spdy_test_util_common.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/platform_test.h"
+
+namespace net {
+
+namespace {
+
+const int kBodySize = 32 * 1024 * 1024;
+const int kDataFramePayloadSize = 16 * 1024;
+const int kNumIdleSessions = 100;
+const int kNumRequests = 100;
+const int kNumRequestSessions = 20;
+
+// A delegate that drops received data as soon as it arrives, so that flow
+// control windows are replenished immediately.
+class ConsumingDelegate : public test::StreamDelegateDoNothing {
+ public:
+  explicit ConsumingDelegate(const base::WeakPtr<SpdyStream>& stream)
+      : test::StreamDelegateDoNothing(stream), bytes_received_(0) {}
+  ~ConsumingDelegate() override {}
+
+  void OnDataReceived(std::unique_ptr<SpdyBuffer> buffer) override {
+    if (buffer)
+      bytes_received_ += buffer->GetRemainingSize();
+  }
+
+  int64_t bytes_received() const { return bytes_received_; }
+
+ private:
+  int64_t bytes_received_;
+};
+
+// The socket traffic of a session serving kNumRequests concurrent GET
+// requests, each answered with a small body.
+class RequestsSocketData {
+ public:
+  RequestsSocketData() {
+    SpdyTestUtil spdy_util;
+    for (int i = 0; i < kNumRequests; ++i) {
+      frames_.push_back(
+          spdy_util.ConstructSpdyGet(nullptr, 0, 2 * i + 1, MEDIUM, true));
+    }
+    for (int i = 0; i < kNumRequests; ++i) {
+      frames_.push_back(spdy_util.ConstructSpdyGetReply(nullptr, 0, 2 * i + 1));
+      frames_.push_back(
+          spdy_util.ConstructSpdyDataFrame(2 * i + 1, /*fin=*/true));
+    }
+
+    int seq = 0;
+    for (int i = 0; i < kNumRequests; ++i)
+      writes_.push_back(CreateMockWrite(frames_[i], seq++));
+    for (size_t i = kNumRequests; i < frames_.size(); ++i)
+      reads_.push_back(CreateMockRead(frames_[i], seq++));
+    reads_.push_back(MockRead(ASYNC, 0, seq++));  // EOF
+    data_.reset(new SequencedSocketData(reads_.data(), reads_.size(),
+                                        writes_.data(), writes_.size()));
+  }
+
+  SequencedSocketData* data() { return data_.get(); }
+
+ private:
+  std::vector<SpdySerializedFrame> frames_;
+  std::vector<MockWrite> writes_;
+  std::vector<MockRead> reads_;
+  std::unique_ptr<SequencedSocketData> data_;
+
+  DISALLOW_COPY_AND_ASSIGN(RequestsSocketData);
+};
+
+}  // namespace
+
+class SpdySessionPerfTest : public PlatformTest {
+ protected:
+  SpdySessionPerfTest() : test_url_(kDefaultUrl) {
+    session_deps_.host_resolver->set_synchronous_mode(true);
+  }
+
+  void CreateNetworkSession() {
+    http_session_ = SpdySessionDependencies::SpdyCreateSession(&session_deps_);
+  }
+
+  base::WeakPtr<SpdySession> CreateSession(const HostPortPair& host_port) {
+    SpdySessionKey key(host_port, ProxyServer::Direct(),
+                       PRIVACY_MODE_DISABLED);
+    return CreateInsecureSpdySession(http_session_.get(), key, BoundNetLog());
+  }
+
+  static int read_buffer_len(const base::WeakPtr<SpdySession>& session) {
+    return session->read_buffer_len_;
+  }
+
+  static scoped_refptr<SpdyBufferPool> buffer_pool(
+      const base::WeakPtr<SpdySession>& session) {
+    return session->buffer_pool_;
+  }
+
+  SpdyTestUtil spdy_util_;
+  SpdySessionDependencies session_deps_;
+  std::unique_ptr<HttpNetworkSession> http_session_;
+  const GURL test_url_;
+};
+
+// Measures the time it takes a session to read a large response body that is
+// available on the socket all at once.
+TEST_F(SpdySessionPerfTest, LargeBodyThroughput) {
+  std::string payload(kDataFramePayloadSize, 'a');
+  SpdySerializedFrame data_frame(spdy_util_.ConstructSpdyDataFrame(
+      1, payload.data(), payload.size(), /*fin=*/false));
+  SpdySerializedFrame finish_frame(
+      spdy_util_.ConstructSpdyDataFrame(1, "", 0, /*fin=*/true));
+  std::string body;
+  for (int i = 0; i < kBodySize / kDataFramePayloadSize; ++i)
+    body.append(data_frame.data(), data_frame.size());
+  body.append(finish_frame.data(), finish_frame.size());
+
+  SpdySerializedFrame resp(spdy_util_.ConstructSpdyGetReply(nullptr, 0, 1));
+  MockRead reads[] = {
+      CreateMockRead(resp, 0, ASYNC),
+      MockRead(SYNCHRONOUS, body.data(), body.size()),
+      MockRead(ASYNC, 0)  // EOF
+  };
+
+  // Writes are not checked, so that WINDOW_UPDATE frames may be sent freely.
+  StaticSocketDataProvider data(reads, arraysize(reads), nullptr, 0);
+  session_deps_.socket_factory->AddSocketDataProvider(&data);
+
+  CreateNetworkSession();
+  base::WeakPtr<SpdySession> session =
+      CreateSession(HostPortPair::FromURL(test_url_));
+
+  base::WeakPtr<SpdyStream> stream = CreateStreamSynchronously(
+      SPDY_REQUEST_RESPONSE_STREAM, session, test_url_, MEDIUM, BoundNetLog());
+  ASSERT_TRUE(stream);
+  ConsumingDelegate delegate(stream);
+  stream->SetDelegate(&delegate);
+  stream->SendRequestHeaders(spdy_util_.ConstructGetHeaderBlock(kDefaultUrl),
+                             NO_MORE_DATA_TO_SEND);
+
+  scoped_refptr<SpdyBufferPool> pool = buffer_pool(session);
+  base::PerfTimeLogger timer("Spdy_session_large_body_read");
+  base::RunLoop().RunUntilIdle();
+  timer.Done();
+
+  EXPECT_EQ(kBodySize, delegate.bytes_received());
+  EXPECT_FALSE(stream);
+  base::LogPerfResult(
+      "Spdy_session_large_body_read_data_allocations",
+      static_cast<double>(pool->heap_allocation_count()) * 1024 * 1024 /
+          kBodySize,
+      "allocations/MB");
+}
+
+// Measures the rate at which sessions complete small requests, with
+// kNumRequests of them in flight on each session.
+TEST_F(SpdySessionPerfTest, RequestThroughput) {
+  std::vector<std::unique_ptr<RequestsSocketData>> data;
+  for (int i = 0; i < kNumRequestSessions; ++i) {
+    data.push_back(base::WrapUnique(new RequestsSocketData()));
+    session_deps_.socket_factory->AddSocketDataProvider(data.back()->data());
+  }
+  CreateNetworkSession();
+
+  base::TimeDelta elapsed;
+  for (int i = 0; i < kNumRequestSessions; ++i) {
+    base::WeakPtr<SpdySession> session = CreateSession(
+        HostPortPair(base::StringPrintf("www.example%d.org", i), 443));
+    std::vector<std::unique_ptr<test::StreamDelegateDoNothing>> delegates;
+
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int j = 0; j < kNumRequests; ++j) {
+      base::WeakPtr<SpdyStream> stream =
+          CreateStreamSynchronously(SPDY_REQUEST_RESPONSE_STREAM, session,
+                                    test_url_, MEDIUM, BoundNetLog());
+      ASSERT_TRUE(stream);
+      delegates.push_back(
+          base::WrapUnique(new test::StreamDelegateDoNothing(stream)));
+      stream->SetDelegate(delegates.back().get());
+      stream->SendRequestHeaders(
+          spdy_util_.ConstructGetHeaderBlock(kDefaultUrl),
+          NO_MORE_DATA_TO_SEND);
+    }
+    base::RunLoop().RunUntilIdle();
+    elapsed += base::TimeTicks::Now() - start;
+
+    for (const auto& delegate : delegates)
+      ASSERT_TRUE(delegate->StreamIsClosed());
+    EXPECT_TRUE(data[i]->data()->AllWriteDataConsumed());
+    EXPECT_TRUE(data[i]->data()->AllReadDataConsumed());
+  }
+
+  base::LogPerfResult(
+      "Spdy_session_requests",
+      static_cast<double>(kNumRequests) * kNumRequestSessions /
+          elapsed.InSecondsF(),
+      "requests/s");
+}
+
+// Compares building DATA frame buffers from the heap and from a pool.
+TEST_F(SpdySessionPerfTest, DataBufferAllocation) {
+  const int kIterations = 1000000;
+  std::string payload(kMaxSpdyFrameChunkSize, 'a');
+
+  {
+    base::PerfTimeLogger timer("Spdy_data_buffer_heap");
+    for (int i = 0; i < kIterations; ++i)
+      SpdyBuffer buffer(payload.data(), payload.size());
+  }
+
+  scoped_refptr<SpdyBufferPool> pool(
+      new SpdyBufferPool(kMaxPooledDataBufferBytes));
+  {
+    base::PerfTimeLogger timer("Spdy_data_buffer_pooled");
+    for (int i = 0; i < kIterations; ++i) {
+      char* data = nullptr;
+      std::unique_ptr<SpdyBuffer> buffer =
+          pool->CreateBuffer(payload.size(), &data);
+      memcpy(data, payload.data(), payload.size());
+    }
+  }
+  EXPECT_EQ(1u, pool->heap_allocation_count());
+}
+
+// Measures the memory pinned by the read buffers of sessions that have no
+// streams.
+TEST_F(SpdySessionPerfTest, IdleSessionReadBufferMemory) {
+  MockRead reads[] = {MockRead(ASYNC, ERR_IO_PENDING, 0)};
+  std::vector<std::unique_ptr<SequencedSocketData>> data;
+  for (int i = 0; i < kNumIdleSessions; ++i) {
+    data.push_back(base::WrapUnique(
+        new SequencedSocketData(reads, arraysize(reads), nullptr, 0)));
+    session_deps_.socket_factory->AddSocketDataProvider(data.back().get());
+  }
+
+  CreateNetworkSession();
+  std::vector<base::WeakPtr<SpdySession>> sessions;
+  for (int i = 0; i < kNumIdleSessions; ++i) {
+    sessions.push_back(CreateSession(
+        HostPortPair(base::StringPrintf("www.example%d.org", i), 443)));
+  }
+  base::RunLoop().RunUntilIdle();
+
+  int64_t total_bytes = 0;
+  for (const auto& session : sessions) {
+    ASSERT_TRUE(session);
+    EXPECT_FALSE(session->is_active());
+    total_bytes += read_buffer_len(session);
+  }
+  base::LogPerfResult("Spdy_session_idle_read_buffer_bytes",
+                      static_cast<double>(total_bytes) / kNumIdleSessions,
+                      "bytes/session");
+}
+
+}  // namespace net
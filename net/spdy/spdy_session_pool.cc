@@ -52,7 +52,8 @@ SpdySessionPool::SpdySessionPool(
       session_max_recv_window_size_(session_max_recv_window_size),
       stream_max_recv_window_size_(stream_max_recv_window_size),
       time_func_(time_func),
-      proxy_delegate_(proxy_delegate) {
+      proxy_delegate_(proxy_delegate),
+      server_push_store_(nullptr) {
   NetworkChangeNotifier::AddIPAddressObserver(this);
   if (ssl_config_service_.get())
     ssl_config_service_->AddObserver(this);
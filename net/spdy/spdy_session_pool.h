@@ -34,6 +34,7 @@ class ClientSocketHandle;
 class HostResolver;
 class HttpServerProperties;
 class ProxyDelegate;
+class ServerPushStore;
 class SpdySession;
 class TransportSecurityState;
 
@@ -129,6 +130,12 @@ class NET_EXPORT SpdySessionPool
     return http_server_properties_;
   }
 
+  // The store that sessions report the pushes they accept to. May be null.
+  ServerPushStore* server_push_store() { return server_push_store_; }
+  void set_server_push_store(ServerPushStore* server_push_store) {
+    server_push_store_ = server_push_store;
+  }
+
   // NetworkChangeNotifier::IPAddressObserver methods:
 
   // We flush all idle sessions and release references to the active ones so
@@ -229,6 +236,8 @@ class NET_EXPORT SpdySessionPool
   // streams. May be nullptr.
   ProxyDelegate* proxy_delegate_;
 
+  ServerPushStore* server_push_store_;
+
   DISALLOW_COPY_AND_ASSIGN(SpdySessionPool);
 };
 
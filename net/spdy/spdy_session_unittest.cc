@@ -26,6 +26,7 @@
 #include "net/proxy/proxy_server.h"
 #include "net/socket/client_socket_pool_manager.h"
 #include "net/socket/socket_test_util.h"
+#include "net/spdy/server_push_store.h"
 #include "net/spdy/spdy_http_utils.h"
 #include "net/spdy/spdy_session_pool.h"
 #include "net/spdy/spdy_session_test_util.h"
@@ -1284,6 +1285,63 @@ TEST_F(SpdySessionTest, DeleteExpiredPushStreams) {
   EXPECT_FALSE(session_);
 }
 
+// Pushes are reported to the ServerPushStore of the network session, which
+// can cancel them.
+TEST_F(SpdySessionTest, ServerPushStoreCancelsPush) {
+  session_deps_.host_resolver->set_synchronous_mode(true);
+
+  SpdySerializedFrame req(
+      spdy_util_.ConstructSpdyGet(nullptr, 0, 1, MEDIUM, true));
+  SpdySerializedFrame rst(
+      spdy_util_.ConstructSpdyRstStream(2, RST_STREAM_CANCEL));
+  MockWrite writes[] = {CreateMockWrite(req, 0), CreateMockWrite(rst, 3)};
+
+  SpdySerializedFrame push_a(spdy_util_.ConstructSpdyPush(
+      nullptr, 0, 2, 1, "https://www.example.org/a.dat"));
+  SpdySerializedFrame push_a_body(spdy_util_.ConstructSpdyDataFrame(2, false));
+  MockRead reads[] = {
+      CreateMockRead(push_a, 1), CreateMockRead(push_a_body, 2),
+      MockRead(ASYNC, ERR_IO_PENDING, 4), MockRead(ASYNC, 0, 5)  // EOF
+  };
+
+  SequencedSocketData data(reads, arraysize(reads), writes, arraysize(writes));
+  session_deps_.socket_factory->AddSocketDataProvider(&data);
+
+  CreateNetworkSession();
+  CreateInsecureSpdySession();
+
+  base::WeakPtr<SpdyStream> spdy_stream = CreateStreamSynchronously(
+      SPDY_REQUEST_RESPONSE_STREAM, session_, test_url_, MEDIUM, BoundNetLog());
+  test::StreamDelegateDoNothing delegate(spdy_stream);
+  spdy_stream->SetDelegate(&delegate);
+
+  SpdyHeaderBlock headers(spdy_util_.ConstructGetHeaderBlock(kDefaultUrl));
+  spdy_stream->SendRequestHeaders(std::move(headers), NO_MORE_DATA_TO_SEND);
+
+  base::RunLoop().RunUntilIdle();
+
+  EXPECT_EQ(1u, session_->num_unclaimed_pushed_streams());
+  ServerPushStore* store = http_session_->server_push_store();
+  EXPECT_EQ(1u, store->num_pushes());
+  EXPECT_EQ(static_cast<size_t>(kUploadDataSize), store->bytes());
+  EXPECT_EQ(1u, store->stats().accepted);
+
+  // The stream is reset asynchronously.
+  store->CancelPushes(GURL("https://www.example.org/a.dat"));
+  EXPECT_EQ(0u, store->num_pushes());
+  EXPECT_EQ(1u, session_->num_unclaimed_pushed_streams());
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(0u, session_->num_unclaimed_pushed_streams());
+  EXPECT_EQ(1u, store->stats().wasted);
+  EXPECT_EQ(kUploadDataSize, store->stats().wasted_bytes);
+
+  // Read and process EOF.
+  EXPECT_TRUE(session_);
+  data.Resume();
+  base::RunLoop().RunUntilIdle();
+  EXPECT_FALSE(session_);
+}
+
 TEST_F(SpdySessionTest, FailedPing) {
   session_deps_.host_resolver->set_synchronous_mode(true);
 
@@ -2802,6 +2860,106 @@ TEST_F(SpdySessionTest, TestYieldingDuringAsyncReadData) {
   EXPECT_TRUE(data.AllReadDataConsumed());
 }
 
+// Test that a session without streams reads into a small buffer.
+TEST_F(SpdySessionTest, IdleSessionUsesSmallReadBuffer) {
+  session_deps_.host_resolver->set_synchronous_mode(true);
+
+  MockRead reads[] = {
+      MockRead(ASYNC, ERR_IO_PENDING, 0), MockRead(ASYNC, 0, 1)  // EOF
+  };
+
+  SequencedSocketData data(reads, arraysize(reads), nullptr, 0);
+  session_deps_.socket_factory->AddSocketDataProvider(&data);
+
+  CreateNetworkSession();
+  CreateInsecureSpdySession();
+  base::RunLoop().RunUntilIdle();
+
+  EXPECT_FALSE(session_->is_active());
+  EXPECT_EQ(kIdleReadBufferSize, session_->read_buffer_len_);
+  EXPECT_EQ(kMinReadBufferSize, session_->read_buffer_size_);
+
+  data.Resume();
+  base::RunLoop().RunUntilIdle();
+  EXPECT_FALSE(session_);
+  EXPECT_TRUE(data.AllReadDataConsumed());
+}
+
+// Test that the read buffer doubles every time a read fills it, up to
+// kMaxReadBufferSize.  This test makes 8K + 16K + 32K bytes of data available
+// in a single synchronous read.
+TEST_F(SpdySessionTest, ReadBufferGrowsForBulkData) {
+  session_deps_.host_resolver->set_synchronous_mode(true);
+  session_deps_.time_func = InstantaneousReads;
+
+  BufferedSpdyFramer framer;
+
+  SpdySerializedFrame req1(
+      spdy_util_.ConstructSpdyGet(nullptr, 0, 1, MEDIUM, true));
+  MockWrite writes[] = {
+      CreateMockWrite(req1, 0),
+  };
+
+  ASSERT_EQ(8 * 1024, kMinReadBufferSize);
+  ASSERT_EQ(64 * 1024, kMaxReadBufferSize);
+  const int kPayloadSize = kMinReadBufferSize - framer.GetFrameHeaderSize();
+  TestDataStream test_stream;
+  scoped_refptr<IOBuffer> payload(new IOBuffer(kPayloadSize));
+  char* payload_data = payload->data();
+  test_stream.GetBytes(payload_data, kPayloadSize);
+
+  SpdySerializedFrame data_frame(spdy_util_.ConstructSpdyDataFrame(
+      1, payload_data, kPayloadSize, /*fin=*/false));
+  std::string bulk_data;
+  for (int i = 0; i < 7; ++i)
+    bulk_data.append(data_frame.data(), data_frame.size());
+  ASSERT_EQ(static_cast<size_t>(7 * kMinReadBufferSize), bulk_data.size());
+
+  SpdySerializedFrame resp1(spdy_util_.ConstructSpdyGetReply(nullptr, 0, 1));
+
+  MockRead reads[] = {
+      CreateMockRead(resp1, 1),
+      MockRead(ASYNC, ERR_IO_PENDING, 2),
+      MockRead(ASYNC, bulk_data.data(), bulk_data.size(), 3),
+      MockRead(ASYNC, ERR_IO_PENDING, 4),
+      MockRead(ASYNC, 0, 5)  // EOF
+  };
+
+  SequencedSocketData data(reads, arraysize(reads), writes, arraysize(writes));
+  session_deps_.socket_factory->AddSocketDataProvider(&data);
+
+  CreateNetworkSession();
+  CreateInsecureSpdySession();
+
+  base::WeakPtr<SpdyStream> spdy_stream1 = CreateStreamSynchronously(
+      SPDY_REQUEST_RESPONSE_STREAM, session_, test_url_, MEDIUM, BoundNetLog());
+  ASSERT_TRUE(spdy_stream1);
+  test::StreamDelegateDoNothing delegate1(spdy_stream1);
+  spdy_stream1->SetDelegate(&delegate1);
+
+  SpdyHeaderBlock headers1(spdy_util_.ConstructGetHeaderBlock(kDefaultUrl));
+  spdy_stream1->SendRequestHeaders(std::move(headers1), NO_MORE_DATA_TO_SEND);
+
+  // Run until 1st read.
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(1u, delegate1.stream_id());
+  EXPECT_EQ(kMinReadBufferSize, session_->read_buffer_len_);
+
+  // The bulk data is read as 8K, 16K and 32K chunks, each of which fills
+  // the buffer.
+  data.Resume();
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(kMaxReadBufferSize, session_->read_buffer_size_);
+  EXPECT_EQ(kMaxReadBufferSize, session_->read_buffer_len_);
+  EXPECT_EQ(2 * kMaxReadBufferSize, session_->GetYieldAfterBytesRead());
+
+  data.Resume();
+  base::RunLoop().RunUntilIdle();
+  EXPECT_FALSE(spdy_stream1);
+  EXPECT_TRUE(data.AllWriteDataConsumed());
+  EXPECT_TRUE(data.AllReadDataConsumed());
+}
+
 // Send a GoAway frame when SpdySession is in DoReadLoop. Make sure
 // nothing blows up.
 TEST_F(SpdySessionTest, GoAwayWhileInDoReadLoop) {
@@ -4,18 +4,46 @@
 
 #include "net/spdy/spdy_write_queue.h"
 
+#include <algorithm>
 #include <cstddef>
+#include <iterator>
+#include <limits>
 #include <vector>
 
 #include "base/logging.h"
 #include "base/stl_util.h"
 #include "net/spdy/spdy_buffer.h"
 #include "net/spdy/spdy_buffer_producer.h"
+#include "net/spdy/spdy_http_utils.h"
+#include "net/spdy/spdy_protocol.h"
+#include "net/spdy/spdy_session.h"
 #include "net/spdy/spdy_stream.h"
 
 namespace net {
 
-SpdyWriteQueue::PendingWrite::PendingWrite() : frame_producer(NULL) {}
+namespace {
+
+// Bytes a sender is credited per turn for each unit of the HTTP/2 weight
+// of its priority.
+const size_t kQuantumBytesPerWeight = 32;
+
+// Returns the bytes a sender of |priority| is credited per turn. A turn
+// covers at least a full DATA frame of kMaxSpdyFrameChunkSize bytes, at
+// every priority, so streams that queue one frame at a time are served
+// strictly in turn.
+size_t GetQuantum(RequestPriority priority) {
+  const size_t min_quantum = static_cast<size_t>(kMaxSpdyFrameChunkSize) +
+                             SpdyConstants::GetDataFrameMinimumSize(HTTP2);
+  return std::max(min_quantum,
+                  kQuantumBytesPerWeight *
+                      Spdy3PriorityToHttp2Weight(
+                          ConvertRequestPriorityToSpdyPriority(priority)));
+}
+
+}  // namespace
+
+SpdyWriteQueue::PendingWrite::PendingWrite()
+    : frame_producer(NULL), has_stream(false), size(0), sequence_number(0) {}
 
 SpdyWriteQueue::PendingWrite::PendingWrite(
     SpdyFrameType frame_type,
@@ -24,13 +52,23 @@ SpdyWriteQueue::PendingWrite::PendingWrite(
     : frame_type(frame_type),
       frame_producer(frame_producer),
       stream(stream),
-      has_stream(stream.get() != NULL) {}
+      has_stream(stream.get() != NULL),
+      size(frame_producer->EstimateBufferSize()),
+      sequence_number(0) {}
 
 SpdyWriteQueue::PendingWrite::PendingWrite(const PendingWrite& other) = default;
 
 SpdyWriteQueue::PendingWrite::~PendingWrite() {}
 
-SpdyWriteQueue::SpdyWriteQueue() : removing_writes_(false) {}
+SpdyWriteQueue::Sender::Sender(SpdyStream* stream)
+    : stream(stream), deficit(0), in_turn(false) {}
+
+SpdyWriteQueue::Sender::Sender(const Sender& other) = default;
+
+SpdyWriteQueue::Sender::~Sender() {}
+
+SpdyWriteQueue::SpdyWriteQueue()
+    : removing_writes_(false), next_sequence_number_(0) {}
 
 SpdyWriteQueue::~SpdyWriteQueue() {
   Clear();
@@ -38,7 +76,7 @@ SpdyWriteQueue::~SpdyWriteQueue() {
 
 bool SpdyWriteQueue::IsEmpty() const {
   for (int i = MINIMUM_PRIORITY; i <= MAXIMUM_PRIORITY; i++) {
-    if (!queue_[i].empty())
+    if (!senders_[i].empty() || !streamless_writes_[i].empty())
       return false;
   }
   return true;
@@ -53,8 +91,24 @@ void SpdyWriteQueue::Enqueue(RequestPriority priority,
   CHECK_LE(priority, MAXIMUM_PRIORITY);
   if (stream.get())
     DCHECK_EQ(stream->priority(), priority);
-  queue_[priority].push_back(
-      PendingWrite(frame_type, frame_producer.release(), stream));
+  PendingWrite pending_write(frame_type, frame_producer.release(), stream);
+  pending_write.sequence_number = next_sequence_number_++;
+
+  if (!stream.get()) {
+    streamless_writes_[priority].push_back(pending_write);
+    return;
+  }
+
+  auto it = stream_senders_.find(stream.get());
+  if (it != stream_senders_.end()) {
+    it->second->writes.push_back(pending_write);
+    return;
+  }
+
+  SenderList* senders = &senders_[priority];
+  senders->push_back(Sender(stream.get()));
+  senders->back().writes.push_back(pending_write);
+  stream_senders_[stream.get()] = std::prev(senders->end());
 }
 
 bool SpdyWriteQueue::Dequeue(
@@ -63,16 +117,66 @@ bool SpdyWriteQueue::Dequeue(
     base::WeakPtr<SpdyStream>* stream) {
   CHECK(!removing_writes_);
   for (int i = MAXIMUM_PRIORITY; i >= MINIMUM_PRIORITY; --i) {
-    if (!queue_[i].empty()) {
-      PendingWrite pending_write = queue_[i].front();
-      queue_[i].pop_front();
+    SenderList* senders = &senders_[i];
+    std::deque<PendingWrite>* streamless_writes = &streamless_writes_[i];
+
+    // Only the stream writes enqueued before the first write without a
+    // stream may go ahead of it.
+    const uint64_t barrier = streamless_writes->empty()
+                                 ? std::numeric_limits<uint64_t>::max()
+                                 : streamless_writes->front().sequence_number;
+    bool has_eligible_sender = false;
+    for (const Sender& sender : *senders) {
+      if (sender.writes.front().sequence_number < barrier) {
+        has_eligible_sender = true;
+        break;
+      }
+    }
+    if (!has_eligible_sender) {
+      if (streamless_writes->empty())
+        continue;
+      PendingWrite pending_write = streamless_writes->front();
+      streamless_writes->pop_front();
       *frame_type = pending_write.frame_type;
       frame_producer->reset(pending_write.frame_producer);
       *stream = pending_write.stream;
-      if (pending_write.has_stream)
-        DCHECK(stream->get());
       return true;
     }
+
+    // Hand out turns until an eligible sender can afford its next write.
+    // Every pass over the senders credits each eligible one, so this
+    // terminates.
+    const size_t quantum = GetQuantum(static_cast<RequestPriority>(i));
+    while (true) {
+      Sender& sender = senders->front();
+      if (sender.writes.front().sequence_number >= barrier) {
+        senders->splice(senders->end(), *senders, senders->begin());
+        continue;
+      }
+      if (!sender.in_turn) {
+        sender.deficit += quantum;
+        sender.in_turn = true;
+      }
+      if (sender.deficit >= sender.writes.front().size)
+        break;
+      sender.in_turn = false;
+      senders->splice(senders->end(), *senders, senders->begin());
+    }
+
+    Sender& sender = senders->front();
+    PendingWrite pending_write = sender.writes.front();
+    sender.writes.pop_front();
+    sender.deficit -= pending_write.size;
+    // A sender that runs out of writes gives up the rest of its turn.
+    if (sender.writes.empty())
+      EraseSender(senders, senders->begin());
+
+    *frame_type = pending_write.frame_type;
+    frame_producer->reset(pending_write.frame_producer);
+    *stream = pending_write.stream;
+    if (pending_write.has_stream)
+      DCHECK(stream->get());
+    return true;
   }
   return false;
 }
@@ -92,9 +196,9 @@ void SpdyWriteQueue::RemovePendingWritesForStream(
   for (int i = MINIMUM_PRIORITY; i <= MAXIMUM_PRIORITY; ++i) {
     if (priority == i)
       continue;
-    for (std::deque<PendingWrite>::const_iterator it = queue_[i].begin();
-         it != queue_[i].end(); ++it) {
-      DCHECK_NE(it->stream.get(), stream.get());
+    for (const Sender& sender : senders_[i]) {
+      for (const PendingWrite& pending_write : sender.writes)
+        DCHECK_NE(pending_write.stream.get(), stream.get());
     }
   }
 #endif
@@ -103,19 +207,15 @@ void SpdyWriteQueue::RemovePendingWritesForStream(
   // SpdyBuffer::~SpdyBuffer() can result in callbacks into SpdyWriteQueue.
   std::vector<SpdyBufferProducer*> erased_buffer_producers;
 
-  // Do the actual deletion and removal, preserving FIFO-ness.
-  std::deque<PendingWrite>* queue = &queue_[priority];
-  std::deque<PendingWrite>::iterator out_it = queue->begin();
-  for (std::deque<PendingWrite>::const_iterator it = queue->begin();
-       it != queue->end(); ++it) {
-    if (it->stream.get() == stream.get()) {
-      erased_buffer_producers.push_back(it->frame_producer);
-    } else {
-      *out_it = *it;
-      ++out_it;
-    }
+  // All writes of |stream| are held by its sender.
+  auto it = stream_senders_.find(stream.get());
+  if (it != stream_senders_.end()) {
+    SenderList::iterator sender = it->second;
+    for (const PendingWrite& pending_write : sender->writes)
+      erased_buffer_producers.push_back(pending_write.frame_producer);
+    sender->writes.clear();
+    EraseSender(&senders_[priority], sender);
   }
-  queue->erase(out_it, queue->end());
   removing_writes_ = false;
   STLDeleteElements(&erased_buffer_producers);  // Invokes callbacks.
 }
@@ -127,20 +227,30 @@ void SpdyWriteQueue::RemovePendingWritesForStreamsAfter(
   std::vector<SpdyBufferProducer*> erased_buffer_producers;
 
   for (int i = MINIMUM_PRIORITY; i <= MAXIMUM_PRIORITY; ++i) {
-    // Do the actual deletion and removal, preserving FIFO-ness.
-    std::deque<PendingWrite>* queue = &queue_[i];
-    std::deque<PendingWrite>::iterator out_it = queue->begin();
-    for (std::deque<PendingWrite>::const_iterator it = queue->begin();
-         it != queue->end(); ++it) {
-      if (it->stream.get() && (it->stream->stream_id() > last_good_stream_id ||
-                               it->stream->stream_id() == 0)) {
-        erased_buffer_producers.push_back(it->frame_producer);
-      } else {
-        *out_it = *it;
-        ++out_it;
+    SenderList* senders = &senders_[i];
+    for (SenderList::iterator sender = senders->begin();
+         sender != senders->end();) {
+      // Do the actual deletion and removal, preserving FIFO-ness.
+      std::deque<PendingWrite>* writes = &sender->writes;
+      std::deque<PendingWrite>::iterator out_it = writes->begin();
+      for (std::deque<PendingWrite>::const_iterator it = writes->begin();
+           it != writes->end(); ++it) {
+        if (it->stream.get() &&
+            (it->stream->stream_id() > last_good_stream_id ||
+             it->stream->stream_id() == 0)) {
+          erased_buffer_producers.push_back(it->frame_producer);
+        } else {
+          *out_it = *it;
+          ++out_it;
+        }
       }
+      writes->erase(out_it, writes->end());
+
+      SenderList::iterator next = std::next(sender);
+      if (writes->empty())
+        EraseSender(senders, sender);
+      sender = next;
     }
-    queue->erase(out_it, queue->end());
   }
   removing_writes_ = false;
   STLDeleteElements(&erased_buffer_producers);  // Invokes callbacks.
@@ -152,14 +262,25 @@ void SpdyWriteQueue::Clear() {
   std::vector<SpdyBufferProducer*> erased_buffer_producers;
 
   for (int i = MINIMUM_PRIORITY; i <= MAXIMUM_PRIORITY; ++i) {
-    for (std::deque<PendingWrite>::iterator it = queue_[i].begin();
-         it != queue_[i].end(); ++it) {
-      erased_buffer_producers.push_back(it->frame_producer);
+    for (const Sender& sender : senders_[i]) {
+      for (const PendingWrite& pending_write : sender.writes)
+        erased_buffer_producers.push_back(pending_write.frame_producer);
     }
-    queue_[i].clear();
+    senders_[i].clear();
+    for (const PendingWrite& pending_write : streamless_writes_[i])
+      erased_buffer_producers.push_back(pending_write.frame_producer);
+    streamless_writes_[i].clear();
   }
+  stream_senders_.clear();
   removing_writes_ = false;
   STLDeleteElements(&erased_buffer_producers);  // Invokes callbacks.
 }
 
+void SpdyWriteQueue::EraseSender(SenderList* senders,
+                                 SenderList::iterator sender) {
+  DCHECK(sender->writes.empty());
+  stream_senders_.erase(sender->stream);
+  senders->erase(sender);
+}
+
 }  // namespace net
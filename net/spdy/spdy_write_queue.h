@@ -5,7 +5,12 @@
 #ifndef NET_SPDY_SPDY_WRITE_QUEUE_H_
 #define NET_SPDY_SPDY_WRITE_QUEUE_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <deque>
+#include <list>
+#include <map>
 #include <memory>
 
 #include "base/macros.h"
@@ -21,7 +26,14 @@ class SpdyBufferProducer;
 class SpdyStream;
 
 // A queue of SpdyBufferProducers to produce frames to write. Ordered
-// by priority, and then FIFO.
+// by priority. Within a priority, streams take turns in deficit
+// round-robin order: each turn credits a stream with a byte quantum
+// proportional to the HTTP/2 weight of its priority, and the stream
+// writes frames for as long as its credit covers them. A stream sending
+// large frames thus cannot starve streams of the same priority sending
+// small ones. Writes not associated with a stream keep their FIFO place
+// among the writes of their priority: they are dequeued after the writes
+// enqueued before them, and before the writes enqueued after them.
 class NET_EXPORT_PRIVATE SpdyWriteQueue {
  public:
   SpdyWriteQueue();
@@ -41,10 +53,11 @@ class NET_EXPORT_PRIVATE SpdyWriteQueue {
                std::unique_ptr<SpdyBufferProducer> frame_producer,
                const base::WeakPtr<SpdyStream>& stream);
 
-  // Dequeues the frame producer with the highest priority that was
-  // enqueued the earliest and its associated stream. Returns true and
-  // fills in |frame_type|, |frame_producer|, and |stream| if
-  // successful -- otherwise, just returns false.
+  // Dequeues the next frame producer of the highest priority with
+  // pending writes, in the round-robin order described above, and its
+  // associated stream. Writes of a single stream are dequeued FIFO.
+  // Returns true and fills in |frame_type|, |frame_producer|, and
+  // |stream| if successful -- otherwise, just returns false.
   bool Dequeue(SpdyFrameType* frame_type,
                std::unique_ptr<SpdyBufferProducer>* frame_producer,
                base::WeakPtr<SpdyStream>* stream);
@@ -70,6 +83,10 @@ class NET_EXPORT_PRIVATE SpdyWriteQueue {
     base::WeakPtr<SpdyStream> stream;
     // Whether |stream| was non-NULL when enqueued.
     bool has_stream;
+    // Expected size of the frame, or 0 if unknown.
+    size_t size;
+    // The order in which the write was enqueued.
+    uint64_t sequence_number;
 
     PendingWrite();
     PendingWrite(SpdyFrameType frame_type,
@@ -79,10 +96,38 @@ class NET_EXPORT_PRIVATE SpdyWriteQueue {
     ~PendingWrite();
   };
 
+  // The pending writes of one stream.
+  struct Sender {
+    explicit Sender(SpdyStream* stream);
+    Sender(const Sender& other);
+    ~Sender();
+
+    // Only used to look up the sender on Enqueue().
+    SpdyStream* stream;
+    std::deque<PendingWrite> writes;
+    // Bytes that may still be written during the current or next turn.
+    size_t deficit;
+    // Whether the current turn has been credited to |deficit| already.
+    bool in_turn;
+  };
+
+  typedef std::list<Sender> SenderList;
+
+  // Removes |sender|, which must have no writes left, from |senders|.
+  void EraseSender(SenderList* senders, SenderList::iterator sender);
+
   bool removing_writes_;
 
-  // The actual write queue, binned by priority.
-  std::deque<PendingWrite> queue_[NUM_PRIORITIES];
+  uint64_t next_sequence_number_;
+
+  // Senders with pending writes in turn order, binned by priority.
+  SenderList senders_[NUM_PRIORITIES];
+
+  // The pending writes not associated with a stream, binned by priority.
+  std::deque<PendingWrite> streamless_writes_[NUM_PRIORITIES];
+
+  // The senders that have a stream, keyed by that stream.
+  std::map<const SpdyStream*, SenderList::iterator> stream_senders_;
 
   DISALLOW_COPY_AND_ASSIGN(SpdyWriteQueue);
 };
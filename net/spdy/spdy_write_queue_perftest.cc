@@ -0,0 +1,156 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/spdy/spdy_write_queue.h"
+
+#include <stddef.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/test/perf_log.h"
+#include "base/test/perf_time_logger.h"
+#include "net/base/request_priority.h"
+#include "net/log/net_log.h"
+#include "net/spdy/spdy_buffer.h"
+#include "net/spdy/spdy_buffer_producer.h"
+#include "net/spdy/spdy_stream.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/platform_test.h"
+#include "url/gurl.h"
+
+namespace net {
+
+namespace {
+
+const int kNumBulkStreams = 4;
+const int kBulkFramesPerStream = 64;
+const size_t kBulkFrameSize = 16 * 1024;
+const int kNumSmallStreams = 16;
+const size_t kSmallFrameSize = 200;
+
+std::unique_ptr<SpdyBufferProducer> MakeProducer(size_t size) {
+  std::string data(size, 'a');
+  return std::unique_ptr<SpdyBufferProducer>(
+      new SimpleBufferProducer(std::unique_ptr<SpdyBuffer>(
+          new SpdyBuffer(data.data(), data.size()))));
+}
+
+std::unique_ptr<SpdyStream> MakeTestStream(RequestPriority priority) {
+  return std::unique_ptr<SpdyStream>(
+      new SpdyStream(SPDY_BIDIRECTIONAL_STREAM, base::WeakPtr<SpdySession>(),
+                     GURL(), priority, 0, 0, BoundNetLog()));
+}
+
+// Returns Jain's fairness index of |shares|: 1 if all shares are equal, down
+// to 1/n if a single one of n shares got everything.
+double FairnessIndex(const std::vector<size_t>& shares) {
+  double sum = 0;
+  double sum_of_squares = 0;
+  for (size_t share : shares) {
+    sum += share;
+    sum_of_squares += static_cast<double>(share) * share;
+  }
+  return sum * sum / (shares.size() * sum_of_squares);
+}
+
+}  // namespace
+
+class SpdyWriteQueuePerfTest : public PlatformTest {};
+
+// Bulk uploads with many frames queued are joined by small requests of the
+// same priority. Reports how many bytes go on the wire before the first (and
+// only) frame of each small stream, compared to serving the queue FIFO.
+TEST_F(SpdyWriteQueuePerfTest, SmallStreamTimeToFirstByte) {
+  SpdyWriteQueue write_queue;
+  std::vector<std::unique_ptr<SpdyStream>> bulk_streams;
+  std::vector<std::unique_ptr<SpdyStream>> small_streams;
+
+  size_t fifo_bytes_ahead = 0;
+  double fifo_ttfb_sum = 0;
+  for (int i = 0; i < kNumBulkStreams; ++i) {
+    bulk_streams.push_back(MakeTestStream(DEFAULT_PRIORITY));
+    for (int j = 0; j < kBulkFramesPerStream; ++j) {
+      write_queue.Enqueue(DEFAULT_PRIORITY, DATA, MakeProducer(kBulkFrameSize),
+                          bulk_streams.back()->GetWeakPtr());
+      fifo_bytes_ahead += kBulkFrameSize;
+    }
+  }
+  for (int i = 0; i < kNumSmallStreams; ++i) {
+    small_streams.push_back(MakeTestStream(DEFAULT_PRIORITY));
+    write_queue.Enqueue(DEFAULT_PRIORITY, HEADERS,
+                        MakeProducer(kSmallFrameSize),
+                        small_streams.back()->GetWeakPtr());
+    fifo_ttfb_sum += fifo_bytes_ahead;
+    fifo_bytes_ahead += kSmallFrameSize;
+  }
+
+  std::map<SpdyStream*, size_t> ttfb;
+  size_t bytes_written = 0;
+  SpdyFrameType frame_type = DATA;
+  std::unique_ptr<SpdyBufferProducer> producer;
+  base::WeakPtr<SpdyStream> stream;
+  while (write_queue.Dequeue(&frame_type, &producer, &stream)) {
+    if (frame_type == HEADERS)
+      ttfb[stream.get()] = bytes_written;
+    bytes_written += producer->ProduceBuffer()->GetRemainingSize();
+  }
+  ASSERT_EQ(static_cast<size_t>(kNumSmallStreams), ttfb.size());
+
+  double ttfb_sum = 0;
+  for (const auto& entry : ttfb)
+    ttfb_sum += entry.second;
+  base::LogPerfResult("Spdy_write_queue_small_stream_ttfb_fifo",
+                      fifo_ttfb_sum / kNumSmallStreams / 1024, "KB");
+  base::LogPerfResult("Spdy_write_queue_small_stream_ttfb",
+                      ttfb_sum / kNumSmallStreams / 1024, "KB");
+}
+
+// Streams of the same priority writing frames of very different sizes.
+// Reports Jain's fairness index of the bytes each stream got on the wire by
+// the time the first of them finished, and the dequeue rate.
+TEST_F(SpdyWriteQueuePerfTest, BulkStreamFairness) {
+  const size_t kFrameSizes[] = {16 * 1024, 4 * 1024, 1024, 256};
+  const size_t kBytesPerStream = 4 * 1024 * 1024;
+
+  SpdyWriteQueue write_queue;
+  std::vector<std::unique_ptr<SpdyStream>> streams;
+  std::map<SpdyStream*, size_t> stream_index;
+  for (size_t frame_size : kFrameSizes) {
+    streams.push_back(MakeTestStream(DEFAULT_PRIORITY));
+    stream_index[streams.back().get()] = streams.size() - 1;
+    for (size_t i = 0; i < kBytesPerStream / frame_size; ++i) {
+      write_queue.Enqueue(DEFAULT_PRIORITY, DATA, MakeProducer(frame_size),
+                          streams.back()->GetWeakPtr());
+    }
+  }
+
+  std::vector<size_t> bytes(streams.size(), 0);
+  bool finished = false;
+  std::vector<size_t> shares_at_first_finish;
+  int frames = 0;
+  SpdyFrameType frame_type = DATA;
+  std::unique_ptr<SpdyBufferProducer> producer;
+  base::WeakPtr<SpdyStream> stream;
+  base::PerfTimeLogger timer("Spdy_write_queue_dequeue");
+  while (write_queue.Dequeue(&frame_type, &producer, &stream)) {
+    size_t index = stream_index[stream.get()];
+    bytes[index] += producer->EstimateBufferSize();
+    ++frames;
+    if (!finished && bytes[index] == kBytesPerStream) {
+      finished = true;
+      shares_at_first_finish = bytes;
+    }
+  }
+  timer.Done();
+
+  ASSERT_TRUE(finished);
+  base::LogPerfResult("Spdy_write_queue_fairness_index",
+                      FairnessIndex(shares_at_first_finish), "");
+  base::LogPerfResult("Spdy_write_queue_dequeued_frames", frames, "frames");
+}
+
+}  // namespace net
@@ -184,6 +184,118 @@ TEST_F(SpdyWriteQueueTest, DequeuesFIFO) {
   EXPECT_FALSE(write_queue.Dequeue(&frame_type, &frame_producer, &stream));
 }
 
+// Streams of the same priority whose frames are larger than a turn's
+// worth of bytes should alternate, while a small write not associated
+// with a stream keeps its FIFO place after them.
+TEST_F(SpdyWriteQueueTest, DequeuesRoundRobinWithinPriority) {
+  const size_t kLargeFrameSize = 10000;
+  SpdyWriteQueue write_queue;
+
+  std::unique_ptr<SpdyStream> stream1(MakeTestStream(DEFAULT_PRIORITY));
+  std::unique_ptr<SpdyStream> stream2(MakeTestStream(DEFAULT_PRIORITY));
+
+  for (int i = 0; i < 3; ++i) {
+    write_queue.Enqueue(DEFAULT_PRIORITY, DATA,
+                        StringToProducer(std::string(kLargeFrameSize, 'a')),
+                        stream1->GetWeakPtr());
+  }
+  for (int i = 0; i < 2; ++i) {
+    write_queue.Enqueue(DEFAULT_PRIORITY, DATA,
+                        StringToProducer(std::string(kLargeFrameSize, 'b')),
+                        stream2->GetWeakPtr());
+  }
+  write_queue.Enqueue(DEFAULT_PRIORITY, RST_STREAM, StringToProducer("c"),
+                      base::WeakPtr<SpdyStream>());
+
+  const char kExpected[] = "ababac";
+  for (size_t i = 0; i < arraysize(kExpected) - 1; ++i) {
+    SpdyFrameType frame_type = DATA;
+    std::unique_ptr<SpdyBufferProducer> frame_producer;
+    base::WeakPtr<SpdyStream> stream;
+    ASSERT_TRUE(write_queue.Dequeue(&frame_type, &frame_producer, &stream));
+    EXPECT_EQ(kExpected[i], ProducerToString(std::move(frame_producer))[0]);
+  }
+  SpdyFrameType frame_type = DATA;
+  std::unique_ptr<SpdyBufferProducer> frame_producer;
+  base::WeakPtr<SpdyStream> stream;
+  EXPECT_FALSE(write_queue.Dequeue(&frame_type, &frame_producer, &stream));
+}
+
+// Writes of streams enqueued after a write not associated with a stream
+// should wait for it, even when their stream has writes ahead of it.
+TEST_F(SpdyWriteQueueTest, StreamlessWriteKeepsFIFOPlace) {
+  SpdyWriteQueue write_queue;
+
+  std::unique_ptr<SpdyStream> stream1(MakeTestStream(DEFAULT_PRIORITY));
+  std::unique_ptr<SpdyStream> stream2(MakeTestStream(DEFAULT_PRIORITY));
+
+  write_queue.Enqueue(DEFAULT_PRIORITY, DATA, StringToProducer("a"),
+                      stream1->GetWeakPtr());
+  write_queue.Enqueue(DEFAULT_PRIORITY, RST_STREAM, StringToProducer("c"),
+                      base::WeakPtr<SpdyStream>());
+  write_queue.Enqueue(DEFAULT_PRIORITY, DATA, StringToProducer("a"),
+                      stream1->GetWeakPtr());
+  write_queue.Enqueue(DEFAULT_PRIORITY, DATA, StringToProducer("b"),
+                      stream2->GetWeakPtr());
+  write_queue.Enqueue(DEFAULT_PRIORITY, RST_STREAM, StringToProducer("d"),
+                      base::WeakPtr<SpdyStream>());
+
+  const char kExpected[] = "acabd";
+  for (size_t i = 0; i < arraysize(kExpected) - 1; ++i) {
+    SpdyFrameType frame_type = DATA;
+    std::unique_ptr<SpdyBufferProducer> frame_producer;
+    base::WeakPtr<SpdyStream> stream;
+    ASSERT_TRUE(write_queue.Dequeue(&frame_type, &frame_producer, &stream));
+    EXPECT_EQ(kExpected[i], ProducerToString(std::move(frame_producer))[0]);
+  }
+  SpdyFrameType frame_type = DATA;
+  std::unique_ptr<SpdyBufferProducer> frame_producer;
+  base::WeakPtr<SpdyStream> stream;
+  EXPECT_FALSE(write_queue.Dequeue(&frame_type, &frame_producer, &stream));
+}
+
+// A stream writing large frames and a stream writing small frames at the
+// same priority should be served about the same number of bytes.
+TEST_F(SpdyWriteQueueTest, DequeuesByteFair) {
+  const size_t kLargeFrameSize = 10000;
+  const size_t kSmallFrameSize = 100;
+  const size_t kBytesPerStream = 100000;
+  SpdyWriteQueue write_queue;
+
+  std::unique_ptr<SpdyStream> large_stream(MakeTestStream(DEFAULT_PRIORITY));
+  std::unique_ptr<SpdyStream> small_stream(MakeTestStream(DEFAULT_PRIORITY));
+
+  for (size_t i = 0; i < kBytesPerStream / kLargeFrameSize; ++i) {
+    write_queue.Enqueue(DEFAULT_PRIORITY, DATA,
+                        StringToProducer(std::string(kLargeFrameSize, 'a')),
+                        large_stream->GetWeakPtr());
+  }
+  for (size_t i = 0; i < kBytesPerStream / kSmallFrameSize; ++i) {
+    write_queue.Enqueue(DEFAULT_PRIORITY, DATA,
+                        StringToProducer(std::string(kSmallFrameSize, 'b')),
+                        small_stream->GetWeakPtr());
+  }
+
+  size_t large_bytes = 0;
+  size_t small_bytes = 0;
+  while (large_bytes < kBytesPerStream && small_bytes < kBytesPerStream) {
+    SpdyFrameType frame_type = DATA;
+    std::unique_ptr<SpdyBufferProducer> frame_producer;
+    base::WeakPtr<SpdyStream> stream;
+    ASSERT_TRUE(write_queue.Dequeue(&frame_type, &frame_producer, &stream));
+    size_t size = ProducerToString(std::move(frame_producer)).size();
+    if (stream.get() == large_stream.get()) {
+      large_bytes += size;
+    } else {
+      EXPECT_EQ(small_stream.get(), stream.get());
+      small_bytes += size;
+    }
+    // Neither stream gets ahead by more than a large frame and a turn.
+    EXPECT_LE(large_bytes, small_bytes + 2 * kLargeFrameSize);
+    EXPECT_LE(small_bytes, large_bytes + 2 * kLargeFrameSize);
+  }
+}
+
 // Enqueue a bunch of writes and then call
 // RemovePendingWritesForStream() on one of the streams. No dequeued
 // write should be for that stream.
@@ -37,7 +37,8 @@ void PrintHelp() {
   std::cout << "cachetool <cache_path> <cache_backend_type> <subcommand> "
             << std::endl
             << std::endl;
-  std::cout << "Available cache backend types: simple, blockfile" << std::endl;
+  std::cout << "Available cache backend types: simple, blockfile, log"
+            << std::endl;
   std::cout << "Available subcommands:" << std::endl;
   std::cout << "  batch: Starts cachetool to process serialized commands "
             << "passed down by the standard input and return commands output "
@@ -492,6 +493,8 @@ int main(int argc, char* argv[]) {
     backend_type = net::CACHE_BACKEND_SIMPLE;
   } else if (cache_backend_type == "blockfile") {
     backend_type = net::CACHE_BACKEND_BLOCKFILE;
+  } else if (cache_backend_type == "log") {
+    backend_type = net::CACHE_BACKEND_LOG;
   } else {
     std::cerr << "Unknown cache type." << std::endl;
     PrintHelp();
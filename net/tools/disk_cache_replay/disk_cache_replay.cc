@@ -0,0 +1,163 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Replays a disk cache trace, as recorded by net::HttpCacheTraceRecorder,
+// against a new cache of any backend type, and prints the hit ratios,
+// operation latencies and IO sizes.
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/strings/string_number_conversions.h"
+#include "net/base/cache_type.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/disk_cache_trace.h"
+#include "net/disk_cache/disk_cache_trace_replayer.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
+#include "net/disk_cache/simple/simple_index.h"
+
+namespace {
+
+const char kMaxSize[] = "max-size";
+const char kTinyLFU[] = "tiny-lfu";
+
+void PrintHelp() {
+  std::cout << "disk_cache_replay <trace_file> <cache_backend_type> "
+            << "[<cache_path>] [--" << kMaxSize << "=<bytes>] [--" << kTinyLFU
+            << "]" << std::endl
+            << std::endl;
+  std::cout << "Available cache backend types: memory, simple, blockfile, log"
+            << std::endl;
+  std::cout << "<cache_path> is required for all but the memory backend, and "
+            << "must not exist." << std::endl;
+  std::cout << "--" << kTinyLFU << " uses the TinyLFU eviction policy of the "
+            << "simple backend." << std::endl;
+}
+
+double Percent(int64_t part, int64_t total) {
+  return total ? 100.0 * part / total : 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  base::AtExitManager at_exit_manager;
+  base::MessageLoopForIO message_loop;
+  base::CommandLine::Init(argc, argv);
+  const base::CommandLine& command_line =
+      *base::CommandLine::ForCurrentProcess();
+
+  base::CommandLine::StringVector args = command_line.GetArgs();
+  if (args.size() < 2U) {
+    PrintHelp();
+    return 1;
+  }
+
+  std::string contents;
+  std::vector<disk_cache::TraceRecord> records;
+  if (!base::ReadFileToString(base::FilePath(args[0]), &contents) ||
+      !disk_cache::ParseTrace(contents, &records)) {
+    std::cerr << "Invalid trace." << std::endl;
+    return 1;
+  }
+
+  const base::FilePath::StringType& cache_backend_type = args[1];
+  net::CacheType cache_type = net::DISK_CACHE;
+  net::BackendType backend_type = net::CACHE_BACKEND_DEFAULT;
+  if (cache_backend_type == FILE_PATH_LITERAL("memory")) {
+    cache_type = net::MEMORY_CACHE;
+  } else if (cache_backend_type == FILE_PATH_LITERAL("simple")) {
+    backend_type = net::CACHE_BACKEND_SIMPLE;
+  } else if (cache_backend_type == FILE_PATH_LITERAL("blockfile")) {
+    backend_type = net::CACHE_BACKEND_BLOCKFILE;
+  } else if (cache_backend_type == FILE_PATH_LITERAL("log")) {
+    backend_type = net::CACHE_BACKEND_LOG;
+  } else {
+    std::cerr << "Unknown cache type." << std::endl;
+    PrintHelp();
+    return 1;
+  }
+
+  base::FilePath cache_path;
+  if (cache_type != net::MEMORY_CACHE) {
+    if (args.size() < 3U) {
+      PrintHelp();
+      return 1;
+    }
+    cache_path = base::FilePath(args[2]);
+    // Hits only mean anything starting from an empty cache.
+    if (base::PathExists(cache_path)) {
+      std::cerr << "The cache path already exists." << std::endl;
+      return 1;
+    }
+  }
+
+  int max_size = 0;
+  if (command_line.HasSwitch(kMaxSize) &&
+      !base::StringToInt(command_line.GetSwitchValueASCII(kMaxSize),
+                         &max_size)) {
+    std::cerr << "Invalid --" << kMaxSize << "." << std::endl;
+    return 1;
+  }
+
+  std::unique_ptr<disk_cache::Backend> cache_backend;
+  net::TestCompletionCallback cb;
+  int rv = disk_cache::CreateCacheBackend(
+      cache_type, backend_type, cache_path, max_size, false,
+      message_loop.task_runner(), nullptr, &cache_backend, cb.callback());
+  if (cb.GetResult(rv) != net::OK) {
+    std::cerr << "Could not create the cache." << std::endl;
+    return 1;
+  }
+
+  disk_cache::SimpleIndex* simple_index = nullptr;
+  if (backend_type == net::CACHE_BACKEND_SIMPLE) {
+    simple_index = static_cast<disk_cache::SimpleBackendImpl*>(
+                       cache_backend.get())->index();
+    net::TestCompletionCallback index_cb;
+    index_cb.GetResult(simple_index->ExecuteWhenReady(index_cb.callback()));
+    if (command_line.HasSwitch(kTinyLFU)) {
+      simple_index->SetEvictionPolicy(
+          disk_cache::SimpleIndex::EVICTION_POLICY_TINY_LFU);
+    }
+  }
+
+  disk_cache::TraceReplayResult result;
+  disk_cache::ReplayTrace(cache_backend.get(), records,
+                          disk_cache::TRACE_REPLAY_DATA_ANY, &result);
+  base::RunLoop().RunUntilIdle();
+
+  std::cout << "Requests: " << result.requests << std::endl;
+  std::cout << "Hit ratio: " << Percent(result.hits, result.requests) << "%"
+            << std::endl;
+  std::cout << "Byte hit ratio: "
+            << Percent(result.hit_bytes, result.requested_bytes) << "%"
+            << std::endl;
+  std::cout << "Latency p50: " << result.latency_p50.InMicroseconds() << " us"
+            << std::endl;
+  std::cout << "Latency p99: " << result.latency_p99.InMicroseconds() << " us"
+            << std::endl;
+  std::cout << "Bytes read: " << result.bytes_read << std::endl;
+  std::cout << "Bytes written: " << result.bytes_written << std::endl;
+  std::cout << "Errors: " << result.errors << std::endl;
+  std::cout << "Entries: " << cache_backend->GetEntryCount() << std::endl;
+  if (simple_index) {
+    std::cout << "Index memory: " << simple_index->EstimateMemoryUsage()
+              << " bytes" << std::endl;
+  }
+
+  cache_backend = nullptr;
+  base::RunLoop().RunUntilIdle();
+  return 0;
+}
@@ -0,0 +1,23 @@
+# Copyright 2016 The Chromium Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+{
+  'variables': {
+    'chromium_code': 1,
+  },
+  'targets': [
+    {
+      'target_name': 'disk_cache_replay',
+      'type': 'executable',
+      'dependencies': [
+        '../../../base/base.gyp:base',
+        '../../net.gyp:net',
+        '../../net.gyp:net_test_support',
+      ],
+      'sources': [
+        'disk_cache_replay.cc',
+      ],
+    },
+  ],
+}